@@ -385,6 +385,16 @@ if(WITH_CYCLES_EMBREE)
   set(PLATFORM_LINKFLAGS "${PLATFORM_LINKFLAGS} -Xlinker -stack_size -Xlinker 0x100000")
 endif()
 
+if(WITH_ZSTD)
+  set(ZSTD_ROOT_DIR ${LIBDIR}/zstd)
+  find_package(Zstd)
+
+  if(NOT ZSTD_FOUND)
+    set(WITH_ZSTD OFF)
+    message(STATUS "Zstd not found")
+  endif()
+endif()
+
 if(WITH_OPENIMAGEDENOISE)
   find_package(OpenImageDenoise)
 
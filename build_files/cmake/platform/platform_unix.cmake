@@ -209,6 +209,13 @@ if(WITH_MEM_JEMALLOC)
   endif()
 endif()
 
+if(WITH_ZSTD)
+  find_package_wrapper(Zstd)
+  if(NOT ZSTD_FOUND)
+    set(WITH_ZSTD OFF)
+  endif()
+endif()
+
 if(WITH_INPUT_NDOF)
   find_package_wrapper(Spacenav)
   if(SPACENAV_FOUND)
@@ -571,6 +571,15 @@ if(WITH_SYSTEM_AUDASPACE)
   set(AUDASPACE_PY_LIBRARIES ${LIBDIR}/audaspace/lib/audaspace-py.lib)
 endif()
 
+if(WITH_ZSTD)
+  set(ZSTD_INCLUDE_DIRS ${LIBDIR}/zstd/include)
+  set(ZSTD_LIBRARIES ${LIBDIR}/zstd/lib/zstd_static.lib)
+  if(NOT EXISTS ${ZSTD_INCLUDE_DIRS}/zstd.h)
+    set(WITH_ZSTD OFF)
+    message(STATUS "Zstd not found")
+  endif()
+endif()
+
 if(WITH_TBB)
   set(TBB_LIBRARIES optimized ${LIBDIR}/tbb/lib/tbb.lib debug ${LIBDIR}/tbb/lib/tbb_debug.lib)
   set(TBB_INCLUDE_DIR ${LIBDIR}/tbb/include)
@@ -349,6 +349,12 @@ class CyclesRenderSettings(bpy.types.PropertyGroup):
         min=0.0, max=1.0,
         default=0.01,
     )
+    use_light_tree: BoolProperty(
+        name="Light Tree",
+        description="Pick lights based on their distance, orientation and power relative to the shading point, "
+        "rather than uniformly (less noise in scenes with many lights)",
+        default=False,
+    )
 
     use_adaptive_sampling: BoolProperty(
         name="Use Adaptive Sampling",
@@ -622,6 +628,13 @@ class CyclesRenderSettings(bpy.types.PropertyGroup):
         items=enum_bvh_types,
         default='DYNAMIC_BVH',
     )
+    bvh_type_render: EnumProperty(
+        name="Render BVH Type",
+        description="Choose between faster updates of animated objects between frames, or faster render. "
+        "A dynamic BVH needs Persistent Data to be reused between frames",
+        items=enum_bvh_types,
+        default='STATIC_BVH',
+    )
     use_bvh_embree: BoolProperty(
         name="Use Embree",
         description="Use Embree as ray accelerator",
@@ -750,6 +763,52 @@ class CyclesRenderSettings(bpy.types.PropertyGroup):
         items=enum_texture_limit
     )
 
+    use_texture_cache: BoolProperty(
+        name="Texture Cache",
+        description="Load tiles of image textures on demand, at the resolution needed for the "
+        "distance they are seen from, to reduce memory usage (CPU only)",
+        default=False,
+    )
+    texture_cache_size: IntProperty(
+        name="Cache Size",
+        description="Maximum memory used by texture tiles, in megabytes",
+        min=64, max=1024 * 1024,
+        default=1024,
+        subtype='UNSIGNED',
+    )
+    texture_auto_convert: BoolProperty(
+        name="Auto Convert",
+        description="Convert image textures to tiled and mipmapped .tx files stored in the cache "
+        "directory, instead of tiling them in memory on every render",
+        default=False,
+    )
+    texture_cache_path: StringProperty(
+        name="Cache Path",
+        description="Directory for converted .tx files, uses the user cache directory when empty",
+        default="",
+        subtype='DIR_PATH',
+    )
+
+    use_bvh_cache: BoolProperty(
+        name="BVH Cache",
+        description="Store acceleration structures on disk and reuse them in final renders of "
+        "unchanged geometry, instead of building them again",
+        default=False,
+    )
+    bvh_cache_path: StringProperty(
+        name="Cache Path",
+        description="Directory for cached acceleration structures, uses the user cache directory when empty",
+        default="",
+        subtype='DIR_PATH',
+    )
+    bvh_cache_limit: IntProperty(
+        name="Cache Limit",
+        description="Size of the BVH cache directory in megabytes, the least recently used "
+        "acceleration structures are removed beyond it, 0 for no limit",
+        min=0, max=1024 * 1024,
+        default=4096,
+    )
+
     ao_bounces: IntProperty(
         name="AO Bounces",
         default=0,
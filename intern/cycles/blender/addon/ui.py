@@ -286,6 +286,10 @@ class CYCLES_RENDER_PT_sampling_advanced(CyclesButtonsPanel, Panel):
         col.prop(cscene, "min_transparent_bounces")
         col.prop(cscene, "light_sampling_threshold", text="Light Threshold")
 
+        col = layout.column(align=True)
+        col.active = not(use_branched_path(context) and use_sample_all_lights(context))
+        col.prop(cscene, "use_light_tree")
+
         if cscene.progressive != 'PATH' and use_branched_path(context):
             col = layout.column(align=True)
             col.prop(cscene, "sample_all_lights_direct")
@@ -694,6 +698,7 @@ class CYCLES_RENDER_PT_performance_acceleration_structure(CyclesButtonsPanel, Pa
             row = col.row()
             row.active = use_cpu(context)
             row.prop(cscene, "use_bvh_embree")
+        col.prop(cscene, "bvh_type_render")
         col.prop(cscene, "debug_use_spatial_splits")
         sub = col.column()
         sub.active = not cscene.use_bvh_embree or not _cycles.with_embree
@@ -702,6 +707,42 @@ class CYCLES_RENDER_PT_performance_acceleration_structure(CyclesButtonsPanel, Pa
         sub.active = not cscene.debug_use_spatial_splits and not cscene.use_bvh_embree
         sub.prop(cscene, "debug_bvh_time_steps")
 
+        col = layout.column()
+        col.active = not cscene.use_bvh_embree or not _cycles.with_embree
+        col.prop(cscene, "use_bvh_cache")
+        sub = col.column()
+        sub.active = cscene.use_bvh_cache
+        sub.prop(cscene, "bvh_cache_path")
+        sub.prop(cscene, "bvh_cache_limit")
+
+
+class CYCLES_RENDER_PT_performance_texture_cache(CyclesButtonsPanel, Panel):
+    bl_label = "Texture Cache"
+    bl_parent_id = "CYCLES_RENDER_PT_performance"
+    bl_options = {'DEFAULT_CLOSED'}
+
+    def draw_header(self, context):
+        cscene = context.scene.cycles
+
+        self.layout.active = use_cpu(context)
+        self.layout.prop(cscene, "use_texture_cache", text="")
+
+    def draw(self, context):
+        layout = self.layout
+        layout.use_property_split = True
+        layout.use_property_decorate = False
+
+        scene = context.scene
+        cscene = scene.cycles
+
+        col = layout.column()
+        col.active = use_cpu(context) and cscene.use_texture_cache
+        col.prop(cscene, "texture_cache_size")
+        col.prop(cscene, "texture_auto_convert")
+        sub = col.column()
+        sub.active = cscene.texture_auto_convert
+        sub.prop(cscene, "texture_cache_path")
+
 
 class CYCLES_RENDER_PT_performance_final_render(CyclesButtonsPanel, Panel):
     bl_label = "Final Render"
@@ -2295,6 +2336,7 @@ classes = (
     CYCLES_RENDER_PT_performance_threads,
     CYCLES_RENDER_PT_performance_tiles,
     CYCLES_RENDER_PT_performance_acceleration_structure,
+    CYCLES_RENDER_PT_performance_texture_cache,
     CYCLES_RENDER_PT_performance_final_render,
     CYCLES_RENDER_PT_performance_viewport,
     CYCLES_RENDER_PT_passes,
@@ -295,6 +295,7 @@ void BlenderSync::sync_integrator()
   integrator->sample_all_lights_direct = get_boolean(cscene, "sample_all_lights_direct");
   integrator->sample_all_lights_indirect = get_boolean(cscene, "sample_all_lights_indirect");
   integrator->light_sampling_threshold = get_float(cscene, "light_sampling_threshold");
+  integrator->use_light_tree = get_boolean(cscene, "use_light_tree");
 
   if (RNA_boolean_get(&cscene, "use_adaptive_sampling")) {
     integrator->sampling_pattern = SAMPLING_PATTERN_PMJ;
@@ -349,6 +350,14 @@ void BlenderSync::sync_integrator()
 
   if (integrator->modified(previntegrator))
     integrator->tag_update(scene);
+
+  /* The light tree is only used when lights are selected at random. */
+  if (integrator->use_light_tree != previntegrator.use_light_tree ||
+      integrator->method != previntegrator.method ||
+      integrator->sample_all_lights_direct != previntegrator.sample_all_lights_direct ||
+      integrator->sample_all_lights_indirect != previntegrator.sample_all_lights_indirect) {
+    scene->light_manager->tag_update(scene);
+  }
 }
 
 /* Film */
@@ -709,7 +718,9 @@ void BlenderSync::free_data_after_sync(BL::Depsgraph &b_depsgraph)
 
 /* Scene Parameters */
 
-SceneParams BlenderSync::get_scene_params(BL::Scene &b_scene, bool background)
+SceneParams BlenderSync::get_scene_params(BL::BlendData &b_data,
+                                          BL::Scene &b_scene,
+                                          bool background)
 {
   BL::RenderSettings r = b_scene.render();
   SceneParams params;
@@ -721,7 +732,13 @@ SceneParams BlenderSync::get_scene_params(BL::Scene &b_scene, bool background)
   else if (shadingsystem == 1)
     params.shadingsystem = SHADINGSYSTEM_OSL;
 
-  if (background || DebugFlags().viewport_static_bvh)
+  if (background) {
+    /* A dynamic BVH keeps a BVH per geometry, so with persistent data animated objects only
+     * need the top level BVH rebuilt, and deforming meshes refitted between frames. */
+    params.bvh_type = (SceneParams::BVHType)get_enum(
+        cscene, "bvh_type_render", SceneParams::BVH_NUM_TYPES, SceneParams::BVH_STATIC);
+  }
+  else if (DebugFlags().viewport_static_bvh)
     params.bvh_type = SceneParams::BVH_STATIC;
   else
     params.bvh_type = SceneParams::BVH_DYNAMIC;
@@ -749,6 +766,18 @@ SceneParams BlenderSync::get_scene_params(BL::Scene &b_scene, bool background)
     params.texture_limit = 0;
   }
 
+  params.use_texture_cache = get_boolean(cscene, "use_texture_cache");
+  params.texture_cache_size = get_int(cscene, "texture_cache_size");
+  params.texture_auto_convert = get_boolean(cscene, "texture_auto_convert");
+  params.texture_cache_path = blender_absolute_path(
+      b_data, b_scene, get_string(cscene, "texture_cache_path"));
+
+  /* Geometry is edited in the viewport, caching only pays off for repeated final renders. */
+  params.use_bvh_cache = background && get_boolean(cscene, "use_bvh_cache");
+  params.bvh_cache_path = blender_absolute_path(
+      b_data, b_scene, get_string(cscene, "bvh_cache_path"));
+  params.bvh_cache_limit = get_int(cscene, "bvh_cache_limit");
+
   /* TODO(sergey): Once OSL supports per-microarchitecture optimization get
    * rid of this.
    */
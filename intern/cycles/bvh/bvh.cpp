@@ -25,6 +25,7 @@
 #include "bvh/bvh4.h"
 #include "bvh/bvh8.h"
 #include "bvh/bvh_build.h"
+#include "bvh/bvh_cache.h"
 #include "bvh/bvh_node.h"
 
 #ifdef WITH_OPTIX
@@ -142,6 +143,19 @@ BVH *BVH::create(const BVHParams &params,
 
 void BVH::build(Progress &progress, Stats *)
 {
+  string cache_key;
+  bool cache_write = false;
+  if (params.use_cache) {
+    progress.set_substatus("Reading BVH from cache");
+
+    BVHCache cache(params.cache_path, params.cache_limit);
+    cache_key = BVHCache::key(params, objects);
+    if (cache.read(cache_key, pack)) {
+      return;
+    }
+    cache_write = cache.record_miss(cache_key);
+  }
+
   progress.set_substatus("Building BVH");
 
   /* build nodes */
@@ -190,6 +204,11 @@ void BVH::build(Progress &progress, Stats *)
 
   /* free build nodes */
   root->deleteSubtree();
+
+  if (cache_write) {
+    BVHCache cache(params.cache_path, params.cache_limit);
+    cache.write(cache_key, pack);
+  }
 }
 
 /* Refitting */
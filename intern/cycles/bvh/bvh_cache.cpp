@@ -0,0 +1,394 @@
+/*
+ * Copyright 2011-2020 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "bvh/bvh_cache.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <thread>
+
+#include "bvh/bvh.h"
+#include "bvh/bvh_params.h"
+
+#include "render/hair.h"
+#include "render/mesh.h"
+#include "render/object.h"
+
+#include "util/util_foreach.h"
+#include "util/util_logging.h"
+#include "util/util_map.h"
+#include "util/util_md5.h"
+#include "util/util_path.h"
+#include "util/util_system.h"
+
+CCL_NAMESPACE_BEGIN
+
+/* Increase when the packed BVH layout or the hashed data changes. */
+#define BVH_CACHE_VERSION 1
+
+static const char BVH_CACHE_MAGIC[4] = {'C', 'B', 'V', 'H'};
+
+/* Miss markers are empty files, count them as a block on disk so they are pruned too. */
+static const size_t BVH_CACHE_MISS_SIZE = 4096;
+
+/* Hashing */
+
+static void hash_data(MD5Hash &md5, const void *data, size_t size)
+{
+  /* MD5Hash takes the size as int. */
+  const size_t chunk_size = 1 << 30;
+  const uint8_t *bytes = (const uint8_t *)data;
+
+  while (size > 0) {
+    const size_t append_size = std::min(size, chunk_size);
+    md5.append(bytes, (int)append_size);
+    bytes += append_size;
+    size -= append_size;
+  }
+}
+
+template<typename T> static void hash_value(MD5Hash &md5, const T &value)
+{
+  hash_data(md5, &value, sizeof(value));
+}
+
+template<typename T> static void hash_array(MD5Hash &md5, const array<T> &data)
+{
+  hash_value(md5, (uint64_t)data.size());
+  hash_data(md5, data.data(), sizeof(T) * data.size());
+}
+
+/* Only the first three components, the padding of float3 may be uninitialized. */
+static void hash_float3(MD5Hash &md5, const float3 *data, size_t size)
+{
+  hash_value(md5, (uint64_t)size);
+
+  float chunk[3 * 1024];
+  for (size_t i = 0; i < size; i += 1024) {
+    const size_t chunk_size = std::min(size - i, (size_t)1024);
+    for (size_t j = 0; j < chunk_size; j++) {
+      chunk[j * 3 + 0] = data[i + j].x;
+      chunk[j * 3 + 1] = data[i + j].y;
+      chunk[j * 3 + 2] = data[i + j].z;
+    }
+    hash_data(md5, chunk, sizeof(float) * 3 * chunk_size);
+  }
+}
+
+static void hash_bounds(MD5Hash &md5, const BoundBox &bounds)
+{
+  hash_float3(md5, &bounds.min, 1);
+  hash_float3(md5, &bounds.max, 1);
+}
+
+static string geometry_key(const Geometry *geom)
+{
+  MD5Hash md5;
+
+  hash_value(md5, (int)geom->type);
+  hash_value(md5, (uint64_t)geom->prim_offset);
+  hash_value(md5, geom->transform_applied);
+  hash_value(md5, geom->use_motion_blur);
+  hash_value(md5, geom->motion_steps);
+
+  const Attribute *attr_mP = geom->attributes.find(ATTR_STD_MOTION_VERTEX_POSITION);
+
+  if (geom->type == Geometry::MESH) {
+    const Mesh *mesh = static_cast<const Mesh *>(geom);
+    hash_array(md5, mesh->triangles);
+    hash_float3(md5, mesh->verts.data(), mesh->verts.size());
+
+    if (attr_mP) {
+      hash_float3(md5, attr_mP->data_float3(), attr_mP->buffer.size() / sizeof(float3));
+    }
+  }
+  else if (geom->type == Geometry::HAIR) {
+    const Hair *hair = static_cast<const Hair *>(geom);
+    hash_array(md5, hair->curve_first_key);
+    hash_float3(md5, hair->curve_keys.data(), hair->curve_keys.size());
+    hash_array(md5, hair->curve_radius);
+
+    if (attr_mP) {
+      /* Stores the radius in the fourth component. */
+      hash_data(md5, attr_mP->buffer.data(), attr_mP->buffer.size());
+    }
+  }
+
+  return md5.get_hex();
+}
+
+/* BVH Cache */
+
+BVHCache::BVHCache(const string &cache_path, size_t size_limit)
+    : cache_path(cache_path), size_limit(size_limit)
+{
+  if (this->cache_path.empty()) {
+    this->cache_path = path_cache_get("bvh");
+  }
+}
+
+string BVHCache::key(const BVHParams &params, const vector<Object *> &objects)
+{
+  MD5Hash md5;
+
+  hash_value(md5, (int)BVH_CACHE_VERSION);
+
+  hash_value(md5, params.use_spatial_split);
+  hash_value(md5, params.spatial_split_alpha);
+  hash_value(md5, params.unaligned_split_threshold);
+  hash_value(md5, params.sah_node_cost);
+  hash_value(md5, params.sah_primitive_cost);
+  hash_value(md5, params.min_leaf_size);
+  hash_value(md5, params.max_triangle_leaf_size);
+  hash_value(md5, params.max_motion_triangle_leaf_size);
+  hash_value(md5, params.max_curve_leaf_size);
+  hash_value(md5, params.max_motion_curve_leaf_size);
+  hash_value(md5, params.top_level);
+  hash_value(md5, (int)params.bvh_layout);
+  hash_value(md5, params.use_unaligned_nodes);
+  hash_value(md5, params.num_motion_curve_steps);
+  hash_value(md5, params.num_motion_triangle_steps);
+  hash_value(md5, params.bvh_type);
+  hash_value(md5, params.curve_flags);
+  hash_value(md5, params.curve_subdivisions);
+
+  /* Instanced geometry is hashed once. */
+  map<const Geometry *, string> geometry_keys;
+
+  foreach (Object *ob, objects) {
+    const Geometry *geom = ob->geometry;
+
+    hash_value(md5, ob->visibility_for_tracing());
+    hash_value(md5, ob->tfm);
+    hash_array(md5, ob->motion);
+    hash_bounds(md5, ob->bounds);
+
+    map<const Geometry *, string>::iterator it = geometry_keys.find(geom);
+    if (it == geometry_keys.end()) {
+      it = geometry_keys.insert(std::make_pair(geom, geometry_key(geom))).first;
+    }
+    md5.append(it->second);
+  }
+
+  return md5.get_hex();
+}
+
+string BVHCache::filepath(const string &key) const
+{
+  return path_join(cache_path, key + ".bvh");
+}
+
+string BVHCache::miss_filepath(const string &key) const
+{
+  return path_join(cache_path, key + ".miss");
+}
+
+/* File Format
+ *
+ * Magic and version, followed by the root index and every array of the packed BVH as the
+ * number of elements and their data. */
+
+template<typename T> static bool write_array(FILE *f, const array<T> &data)
+{
+  const uint64_t size = data.size();
+  if (fwrite(&size, sizeof(size), 1, f) != 1) {
+    return false;
+  }
+  return size == 0 || fwrite(data.data(), sizeof(T), size, f) == size;
+}
+
+template<typename T> static bool read_array(FILE *f, size_t file_size, array<T> &data)
+{
+  uint64_t size;
+  if (fread(&size, sizeof(size), 1, f) != 1) {
+    return false;
+  }
+  /* Don't allocate for corrupted sizes. */
+  if (size > file_size / sizeof(T)) {
+    return false;
+  }
+  data.resize(size);
+  return size == 0 || fread(data.data(), sizeof(T), size, f) == size;
+}
+
+bool BVHCache::write_pack(FILE *f, const PackedBVH &pack)
+{
+  const int version = BVH_CACHE_VERSION;
+  return fwrite(BVH_CACHE_MAGIC, sizeof(BVH_CACHE_MAGIC), 1, f) == 1 &&
+         fwrite(&version, sizeof(version), 1, f) == 1 &&
+         fwrite(&pack.root_index, sizeof(pack.root_index), 1, f) == 1 &&
+         write_array(f, pack.nodes) && write_array(f, pack.leaf_nodes) &&
+         write_array(f, pack.object_node) && write_array(f, pack.prim_tri_index) &&
+         write_array(f, pack.prim_tri_verts) && write_array(f, pack.prim_type) &&
+         write_array(f, pack.prim_visibility) && write_array(f, pack.prim_index) &&
+         write_array(f, pack.prim_object) && write_array(f, pack.prim_time);
+}
+
+bool BVHCache::read_pack(FILE *f, size_t file_size, PackedBVH &pack)
+{
+  char magic[sizeof(BVH_CACHE_MAGIC)];
+  int version;
+  if (fread(magic, sizeof(magic), 1, f) != 1 || memcmp(magic, BVH_CACHE_MAGIC, sizeof(magic)) ||
+      fread(&version, sizeof(version), 1, f) != 1 || version != BVH_CACHE_VERSION) {
+    return false;
+  }
+
+  return fread(&pack.root_index, sizeof(pack.root_index), 1, f) == 1 &&
+         read_array(f, file_size, pack.nodes) && read_array(f, file_size, pack.leaf_nodes) &&
+         read_array(f, file_size, pack.object_node) &&
+         read_array(f, file_size, pack.prim_tri_index) &&
+         read_array(f, file_size, pack.prim_tri_verts) &&
+         read_array(f, file_size, pack.prim_type) &&
+         read_array(f, file_size, pack.prim_visibility) &&
+         read_array(f, file_size, pack.prim_index) &&
+         read_array(f, file_size, pack.prim_object) && read_array(f, file_size, pack.prim_time);
+}
+
+bool BVHCache::read(const string &key, PackedBVH &pack)
+{
+  const string path = filepath(key);
+  FILE *f = path_fopen(path, "rb");
+
+  if (f == NULL) {
+    return false;
+  }
+
+  const bool success = read_pack(f, path_file_size(path), pack);
+  fclose(f);
+
+  if (!success) {
+    VLOG(1) << "Failed to read cached BVH " << path << ".";
+    pack = PackedBVH();
+    return false;
+  }
+
+  /* Recently used files are kept when pruning. */
+  path_touch(path);
+
+  VLOG(1) << "Read cached BVH " << path << ".";
+  return true;
+}
+
+bool BVHCache::record_miss(const string &key)
+{
+  const string path = miss_filepath(key);
+
+  if (path_exists(path)) {
+    return true;
+  }
+
+  path_create_directories(path);
+
+  FILE *f = path_fopen(path, "wb");
+  if (f != NULL) {
+    fclose(f);
+  }
+  return false;
+}
+
+bool BVHCache::write(const string &key, const PackedBVH &pack)
+{
+  const string path = filepath(key);
+
+  /* Write to a temporary file first, other threads or processes may be building or reading
+   * the same BVH. */
+  const size_t thread_hash = std::hash<std::thread::id>()(std::this_thread::get_id());
+  const string temp_path = string_printf("%s.%d.%llx.tmp",
+                                         path.c_str(),
+                                         system_self_process_id(),
+                                         (unsigned long long)thread_hash);
+
+  path_create_directories(temp_path);
+
+  FILE *f = path_fopen(temp_path, "wb");
+  if (f == NULL) {
+    VLOG(1) << "Failed to create cached BVH " << temp_path << ".";
+    return false;
+  }
+
+  const bool success = write_pack(f, pack);
+  fclose(f);
+
+  if (!success || rename(temp_path.c_str(), path.c_str()) != 0) {
+    VLOG(1) << "Failed to write cached BVH " << path << ".";
+    path_remove(temp_path);
+    return false;
+  }
+
+  VLOG(1) << "Wrote cached BVH " << path << ".";
+
+  path_remove(miss_filepath(key));
+  prune(path);
+  return true;
+}
+
+/* Remove the least recently used files until the cache fits in the size limit. The file which
+ * was just written is kept, even when it exceeds the limit by itself. */
+void BVHCache::prune(const string &keep_path)
+{
+  if (size_limit == 0) {
+    return;
+  }
+
+  struct CacheFile {
+    string path;
+    uint64_t time;
+    size_t size;
+  };
+  vector<CacheFile> files;
+  size_t total_size = 0;
+
+  foreach (const string &path, path_list_directory(cache_path)) {
+    const bool is_miss = string_endswith(path, ".miss");
+    if (!(string_endswith(path, ".bvh") || is_miss)) {
+      continue;
+    }
+
+    CacheFile file;
+    file.path = path;
+    file.time = path_modified_time(path);
+    file.size = is_miss ? BVH_CACHE_MISS_SIZE : path_file_size(path);
+    /* Removed by another process. */
+    if (file.size == (size_t)-1) {
+      continue;
+    }
+
+    files.push_back(file);
+    total_size += file.size;
+  }
+
+  if (total_size <= size_limit) {
+    return;
+  }
+
+  std::sort(files.begin(), files.end(), [](const CacheFile &a, const CacheFile &b) {
+    return a.time < b.time;
+  });
+
+  foreach (const CacheFile &file, files) {
+    if (total_size <= size_limit) {
+      break;
+    }
+    if (file.path == keep_path) {
+      continue;
+    }
+    VLOG(1) << "Removing cached BVH " << file.path << ", cache exceeds size limit.";
+    path_remove(file.path);
+    total_size -= file.size;
+  }
+}
+
+CCL_NAMESPACE_END
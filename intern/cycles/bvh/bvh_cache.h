@@ -0,0 +1,72 @@
+/*
+ * Copyright 2011-2020 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __BVH_CACHE_H__
+#define __BVH_CACHE_H__
+
+#include <cstdio>
+
+#include "util/util_string.h"
+#include "util/util_vector.h"
+
+CCL_NAMESPACE_BEGIN
+
+class BVHParams;
+class Object;
+struct PackedBVH;
+
+/* BVH Cache
+ *
+ * Packed BVHs stored on disk, so renders of unchanged geometry can skip the build. Files are
+ * named after a hash of the build parameters and of all the geometry data the BVH depends on,
+ * so changed geometry gets a new file instead of invalidating the old one.
+ *
+ * Only BVHs which were missed before are written: geometry which changes between renders gets a
+ * new key every time and is never read back. The least recently used files are removed when
+ * the cache grows beyond its size limit. */
+
+class BVHCache {
+ public:
+  /* Uses the user cache directory when the path is empty. The size limit is in bytes, zero for
+   * no limit. */
+  BVHCache(const string &cache_path, size_t size_limit);
+
+  /* Hash identifying the BVH built from the objects with the parameters. */
+  static string key(const BVHParams &params, const vector<Object *> &objects);
+
+  bool read(const string &key, PackedBVH &pack);
+  bool write(const string &key, const PackedBVH &pack);
+
+  /* Record that the BVH is not cached, returns true when it was missed before and is worth
+   * writing. */
+  bool record_miss(const string &key);
+
+  /* File contents, the file size limits the arrays which are read. */
+  static bool write_pack(FILE *f, const PackedBVH &pack);
+  static bool read_pack(FILE *f, size_t file_size, PackedBVH &pack);
+
+ protected:
+  string filepath(const string &key) const;
+  string miss_filepath(const string &key) const;
+  void prune(const string &keep_path);
+
+  string cache_path;
+  size_t size_limit;
+};
+
+CCL_NAMESPACE_END
+
+#endif /* __BVH_CACHE_H__ */
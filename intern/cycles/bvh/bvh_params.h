@@ -19,6 +19,7 @@
 #define __BVH_PARAMS_H__
 
 #include "util/util_boundbox.h"
+#include "util/util_string.h"
 
 #include "kernel/kernel_types.h"
 
@@ -92,6 +93,11 @@ class BVHParams {
   int curve_flags;
   int curve_subdivisions;
 
+  /* Read and write built BVHs in the BVH cache directory, limited to a size in bytes. */
+  bool use_cache;
+  string cache_path;
+  size_t cache_limit;
+
   /* fixed parameters */
   enum { MAX_DEPTH = 64, MAX_SPATIAL_DEPTH = 48, NUM_SPATIAL_BINS = 32 };
 
@@ -124,6 +130,9 @@ class BVHParams {
 
     curve_flags = 0;
     curve_subdivisions = 4;
+
+    use_cache = false;
+    cache_limit = 0;
   }
 
   /* SAH costs */
@@ -431,7 +431,9 @@ class CPUDevice : public Device {
     }
 
     if (mem.device_pointer) {
-      memset((void *)mem.device_pointer, 0, mem.memory_size());
+      /* Render buffers are zeroed before anything else writes them, spread their pages over the
+       * NUMA nodes of the render threads. */
+      task_first_touch_memset((void *)mem.device_pointer, 0, mem.memory_size());
     }
   }
 
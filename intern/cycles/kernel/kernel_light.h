@@ -33,6 +33,30 @@ typedef struct LightSample {
   LightType type; /* type of light */
 } LightSample;
 
+/* Light Selection
+ *
+ * Probability of choosing a lamp when sampling a light, either from the light tree or
+ * from the distribution which picks lamps with equal probability. */
+
+ccl_device_inline float light_select_pdf_lamp(KernelGlobals *kg, int lamp, const float3 P)
+{
+  if (kernel_data.integrator.use_light_tree) {
+    return light_tree_pdf(kg, P, light_tree_lamp_emitter(kg, lamp));
+  }
+  return kernel_data.integrator.pdf_lights;
+}
+
+ccl_device_inline float light_select_pdf_background(KernelGlobals *kg)
+{
+  if (kernel_data.integrator.use_light_tree) {
+    const int num_infinite = kernel_data.integrator.light_tree_num_infinite;
+    return (num_infinite > 0) ?
+               kernel_data.integrator.light_tree_infinite_pdf / num_infinite :
+               0.0f;
+  }
+  return kernel_data.integrator.pdf_lights;
+}
+
 /* Area light sampling */
 
 /* Uses the following paper:
@@ -511,7 +535,7 @@ ccl_device float background_light_pdf(KernelGlobals *kg, float3 P, float3 direct
        * If map sampling is possible, it would be used instead,
        * otherwise fallback sampling is used. */
       if (portal_sampling_pdf == 1.0f) {
-        return kernel_data.integrator.pdf_lights / M_4PI_F;
+        return light_select_pdf_background(kg) / M_4PI_F;
       }
       else {
         /* Force map sampling. */
@@ -523,7 +547,7 @@ ccl_device float background_light_pdf(KernelGlobals *kg, float3 P, float3 direct
     /* Evaluate PDF of sampling this direction by map sampling. */
     map_pdf = background_map_pdf(kg, direction) * (1.0f - portal_sampling_pdf);
   }
-  return (portal_pdf + map_pdf) * kernel_data.integrator.pdf_lights;
+  return (portal_pdf + map_pdf) * light_select_pdf_background(kg);
 }
 #endif
 
@@ -645,8 +669,6 @@ ccl_device_inline bool lamp_light_sample(
     }
   }
 
-  ls->pdf *= kernel_data.integrator.pdf_lights;
-
   return (ls->pdf > 0.0f);
 }
 
@@ -783,7 +805,7 @@ ccl_device bool lamp_light_eval(
     return false;
   }
 
-  ls->pdf *= kernel_data.integrator.pdf_lights;
+  ls->pdf *= light_select_pdf_lamp(kg, lamp, P);
 
   return true;
 }
@@ -822,12 +844,36 @@ ccl_device_inline bool triangle_world_space_vertices(
   return has_motion;
 }
 
+/* Probability of selecting the triangle divided by its area at the center of the motion blur
+ * interval. With the distribution this is the same for all triangles, with the light tree it
+ * depends on the selection probability of the triangle. */
+ccl_device_inline float triangle_light_pdf_triangles(KernelGlobals *kg,
+                                                     int object,
+                                                     int prim,
+                                                     float pdf_select,
+                                                     float area,
+                                                     bool has_motion)
+{
+  if (!kernel_data.integrator.use_light_tree) {
+    return kernel_data.integrator.pdf_triangles;
+  }
+
+  if (has_motion) {
+    float3 V[3];
+    triangle_world_space_vertices(kg, object, prim, -1.0f, V);
+    area = triangle_area(V[0], V[1], V[2]);
+  }
+
+  return (area > 0.0f) ? pdf_select / area : 0.0f;
+}
+
 ccl_device_inline float triangle_light_pdf_area(KernelGlobals *kg,
                                                 const float3 Ng,
                                                 const float3 I,
-                                                float t)
+                                                float t,
+                                                float pdf_triangles)
 {
-  float pdf = kernel_data.integrator.pdf_triangles;
+  float pdf = pdf_triangles;
   float cos_pi = fabsf(dot(Ng, I));
 
   if (cos_pi == 0.0f)
@@ -852,10 +898,18 @@ ccl_device_forceinline float triangle_light_pdf(KernelGlobals *kg, ShaderData *s
   const float3 N = cross(e0, e1);
   const float distance_to_plane = fabsf(dot(N, sd->I * t)) / dot(N, N);
 
+  /* sd contains the point on the light source
+   * calculate Px, the point that we're shading */
+  const float3 Px = sd->P + sd->I * t;
+
+  float pdf_select = 0.0f;
+  if (kernel_data.integrator.use_light_tree) {
+    pdf_select = light_tree_pdf(kg, Px, light_tree_triangle_emitter(kg, sd->object, sd->prim));
+  }
+  const float pdf_triangles = triangle_light_pdf_triangles(
+      kg, sd->object, sd->prim, pdf_select, 0.5f * len(N), has_motion);
+
   if (longest_edge_squared > distance_to_plane * distance_to_plane) {
-    /* sd contains the point on the light source
-     * calculate Px, the point that we're shading */
-    const float3 Px = sd->P + sd->I * t;
     const float3 v0_p = V[0] - Px;
     const float3 v1_p = V[1] - Px;
     const float3 v2_p = V[2] - Px;
@@ -883,12 +937,12 @@ ccl_device_forceinline float triangle_light_pdf(KernelGlobals *kg, ShaderData *s
       else {
         area = 0.5f * len(N);
       }
-      const float pdf = area * kernel_data.integrator.pdf_triangles;
+      const float pdf = area * pdf_triangles;
       return pdf / solid_angle;
     }
   }
   else {
-    float pdf = triangle_light_pdf_area(kg, sd->Ng, sd->I, t);
+    float pdf = triangle_light_pdf_area(kg, sd->Ng, sd->I, t, pdf_triangles);
     if (has_motion) {
       const float area = 0.5f * len(N);
       if (UNLIKELY(area == 0.0f)) {
@@ -912,7 +966,8 @@ ccl_device_forceinline void triangle_light_sample(KernelGlobals *kg,
                                                   float randv,
                                                   float time,
                                                   LightSample *ls,
-                                                  const float3 P)
+                                                  const float3 P,
+                                                  float pdf_select)
 {
   /* A naive heuristic to decide between costly solid angle sampling
    * and simple area sampling, comparing the distance to the triangle plane
@@ -943,6 +998,9 @@ ccl_device_forceinline void triangle_light_sample(KernelGlobals *kg,
   ls->shader |= SHADER_USE_MIS;
   ls->type = LIGHT_TRIANGLE;
 
+  const float pdf_triangles = triangle_light_pdf_triangles(
+      kg, object, prim, pdf_select, area, has_motion);
+
   float distance_to_plane = fabsf(dot(N0, V[0] - P) / dot(N0, N0));
 
   if (longest_edge_squared > distance_to_plane * distance_to_plane) {
@@ -1036,7 +1094,7 @@ ccl_device_forceinline void triangle_light_sample(KernelGlobals *kg,
         triangle_world_space_vertices(kg, object, prim, -1.0f, V);
         area = triangle_area(V[0], V[1], V[2]);
       }
-      const float pdf = area * kernel_data.integrator.pdf_triangles;
+      const float pdf = area * pdf_triangles;
       ls->pdf = pdf / solid_angle;
     }
   }
@@ -1050,7 +1108,7 @@ ccl_device_forceinline void triangle_light_sample(KernelGlobals *kg,
     ls->P = u * V[0] + v * V[1] + t * V[2];
     /* compute incoming direction, distance and pdf */
     ls->D = normalize_len(ls->P - P, &ls->t);
-    ls->pdf = triangle_light_pdf_area(kg, ls->Ng, -ls->D, ls->t);
+    ls->pdf = triangle_light_pdf_area(kg, ls->Ng, -ls->D, ls->t, pdf_triangles);
     if (has_motion && area != 0.0f) {
       /* scale the PDF.
        * area = the area the sample was taken from
@@ -1118,9 +1176,21 @@ ccl_device_noinline bool light_sample(KernelGlobals *kg,
                                       int bounce,
                                       LightSample *ls)
 {
+  float pdf_select = kernel_data.integrator.pdf_lights;
+
   if (lamp < 0) {
     /* sample index */
-    int index = light_distribution_sample(kg, &randu);
+    int index;
+    if (kernel_data.integrator.use_light_tree) {
+      const int emitter = light_tree_sample(kg, P, &randu, &pdf_select);
+      if (emitter == -1) {
+        return false;
+      }
+      index = kernel_tex_fetch(__light_tree_emitters, emitter).distribution_index;
+    }
+    else {
+      index = light_distribution_sample(kg, &randu);
+    }
 
     /* fetch light data */
     const ccl_global KernelLightDistribution *kdistribution = &kernel_tex_fetch(
@@ -1131,7 +1201,7 @@ ccl_device_noinline bool light_sample(KernelGlobals *kg,
       int object = kdistribution->mesh_light.object_id;
       int shader_flag = kdistribution->mesh_light.shader_flag;
 
-      triangle_light_sample(kg, prim, object, randu, randv, time, ls, P);
+      triangle_light_sample(kg, prim, object, randu, randv, time, ls, P, pdf_select);
       ls->shader |= shader_flag;
       return (ls->pdf > 0.0f);
     }
@@ -1143,7 +1213,12 @@ ccl_device_noinline bool light_sample(KernelGlobals *kg,
     return false;
   }
 
-  return lamp_light_sample(kg, lamp, randu, randv, P, ls);
+  if (!lamp_light_sample(kg, lamp, randu, randv, P, ls)) {
+    return false;
+  }
+
+  ls->pdf *= pdf_select;
+  return (ls->pdf > 0.0f);
 }
 
 ccl_device_inline int light_select_num_samples(KernelGlobals *kg, int index)
@@ -0,0 +1,236 @@
+/*
+ * Copyright 2011-2020 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+CCL_NAMESPACE_BEGIN
+
+/* Light Tree
+ *
+ * Lights and emissive triangles are selected by traversing a tree built over their bounds,
+ * at every node choosing a child proportional to an estimate of how much light it contributes
+ * to the shading point. See "Importance Sampling of Many Lights with Adaptive Tree Splitting",
+ * Estevez and Kulla, 2018.
+ *
+ * Distant and background lights have no position, they are the first emitters and are
+ * selected uniformly with a fixed probability instead.
+ *
+ * The estimate only depends on the shading point, so the probability of selecting an emitter
+ * can be evaluated again for multiple importance sampling when it is hit by a ray. */
+
+ccl_device float light_tree_importance(const float3 P,
+                                       const ccl_global KernelLightTreeBounds *bounds)
+{
+  const float3 bbox_min = make_float3(
+      bounds->bbox_min[0], bounds->bbox_min[1], bounds->bbox_min[2]);
+  const float3 bbox_max = make_float3(
+      bounds->bbox_max[0], bounds->bbox_max[1], bounds->bbox_max[2]);
+  const float3 centroid = 0.5f * (bbox_min + bbox_max);
+  const float radius_squared = 0.25f * len_squared(bbox_max - bbox_min);
+
+  const float3 centroid_to_P = P - centroid;
+  const float distance_squared = len_squared(centroid_to_P);
+
+  if (distance_squared <= radius_squared) {
+    /* Inside the bounding sphere light can arrive from any emitter in any direction. */
+    return bounds->energy / max(radius_squared, 1e-8f);
+  }
+
+  /* Smallest angle between an emitter normal and the direction to the point, using the angle
+   * the bounding sphere subtends to bound the directions from all emitter positions. */
+  const float distance = sqrtf(distance_squared);
+  const float3 axis = make_float3(bounds->axis[0], bounds->axis[1], bounds->axis[2]);
+  const float theta = safe_acosf(dot(axis, centroid_to_P) / distance);
+  const float theta_u = safe_asinf(sqrtf(radius_squared) / distance);
+  const float theta_prime = max(theta - bounds->theta_o - theta_u, 0.0f);
+
+  if (theta_prime >= bounds->theta_e) {
+    return 0.0f;
+  }
+
+  return bounds->energy * cosf(theta_prime) / distance_squared;
+}
+
+ccl_device_inline float light_tree_node_importance(KernelGlobals *kg, const float3 P, int index)
+{
+  return light_tree_importance(P, &kernel_tex_fetch(__light_tree_nodes, index).bounds);
+}
+
+ccl_device_inline float light_tree_emitter_importance(KernelGlobals *kg,
+                                                      const float3 P,
+                                                      int index)
+{
+  return light_tree_importance(P, &kernel_tex_fetch(__light_tree_emitters, index).bounds);
+}
+
+/* Select an emitter, returning its index in __light_tree_emitters or -1 if no emitter can light
+ * the point. randu is rescaled to be reused for sampling a position on the emitter. */
+ccl_device int light_tree_sample(KernelGlobals *kg, const float3 P, float *randu, float *pdf)
+{
+  const int num_infinite = kernel_data.integrator.light_tree_num_infinite;
+  const float infinite_pdf = kernel_data.integrator.light_tree_infinite_pdf;
+  float r = *randu;
+
+  if (r < infinite_pdf) {
+    /* Distant and background lights. */
+    r = r / infinite_pdf * num_infinite;
+    const int index = min((int)r, num_infinite - 1);
+    *randu = r - index;
+    *pdf = infinite_pdf / num_infinite;
+    return index;
+  }
+
+  r = (r - infinite_pdf) / (1.0f - infinite_pdf);
+  float tree_pdf = 1.0f - infinite_pdf;
+
+  /* Traverse to a leaf, choosing children proportional to their importance. */
+  int node_index = 0;
+  const ccl_global KernelLightTreeNode *knode = &kernel_tex_fetch(__light_tree_nodes, 0);
+
+  while (knode->num_emitters == 0) {
+    const int left = node_index + 1;
+    const int right = knode->child_index;
+    const float importance_left = light_tree_node_importance(kg, P, left);
+    const float importance_right = light_tree_node_importance(kg, P, right);
+    const float importance_total = importance_left + importance_right;
+
+    if (importance_total == 0.0f) {
+      return -1;
+    }
+
+    const float probability_left = importance_left / importance_total;
+    if (r < probability_left) {
+      r = r / probability_left;
+      tree_pdf *= probability_left;
+      node_index = left;
+    }
+    else {
+      r = (r - probability_left) / (1.0f - probability_left);
+      tree_pdf *= 1.0f - probability_left;
+      node_index = right;
+    }
+
+    knode = &kernel_tex_fetch(__light_tree_nodes, node_index);
+  }
+
+  /* Choose an emitter in the leaf the same way. */
+  const int first = knode->child_index;
+  const int last = first + knode->num_emitters;
+
+  float importance_total = 0.0f;
+  for (int i = first; i < last; i++) {
+    importance_total += light_tree_emitter_importance(kg, P, i);
+  }
+
+  if (importance_total == 0.0f) {
+    return -1;
+  }
+
+  r *= importance_total;
+  for (int i = first; i < last; i++) {
+    const float importance = light_tree_emitter_importance(kg, P, i);
+    if (r < importance || i == last - 1) {
+      if (importance == 0.0f) {
+        return -1;
+      }
+      *randu = clamp(r / importance, 0.0f, 1.0f - 1e-7f);
+      *pdf = tree_pdf * importance / importance_total;
+      return i;
+    }
+    r -= importance;
+  }
+
+  return -1;
+}
+
+/* Probability of light_tree_sample selecting the emitter, or zero for -1. */
+ccl_device float light_tree_pdf(KernelGlobals *kg, const float3 P, int emitter_index)
+{
+  const int num_infinite = kernel_data.integrator.light_tree_num_infinite;
+  const float infinite_pdf = kernel_data.integrator.light_tree_infinite_pdf;
+
+  if (emitter_index < 0) {
+    return 0.0f;
+  }
+  if (emitter_index < num_infinite) {
+    return infinite_pdf / num_infinite;
+  }
+
+  /* Emitter in its leaf. */
+  const int leaf_index = kernel_tex_fetch(__light_tree_emitters, emitter_index).leaf_index;
+  const ccl_global KernelLightTreeNode *kleaf = &kernel_tex_fetch(__light_tree_nodes,
+                                                                   leaf_index);
+  const int first = kleaf->child_index;
+  const int last = first + kleaf->num_emitters;
+
+  float importance_total = 0.0f;
+  for (int i = first; i < last; i++) {
+    importance_total += light_tree_emitter_importance(kg, P, i);
+  }
+
+  if (importance_total == 0.0f) {
+    return 0.0f;
+  }
+
+  float pdf = (1.0f - infinite_pdf) * light_tree_emitter_importance(kg, P, emitter_index) /
+              importance_total;
+
+  /* Nodes from the leaf up to the root. */
+  int node_index = leaf_index;
+  int parent_index = kleaf->parent_index;
+
+  while (parent_index != -1) {
+    const ccl_global KernelLightTreeNode *kparent = &kernel_tex_fetch(__light_tree_nodes,
+                                                                      parent_index);
+    const int sibling_index = (node_index == parent_index + 1) ? kparent->child_index :
+                                                                 parent_index + 1;
+    const float importance = light_tree_node_importance(kg, P, node_index);
+    const float importance_sibling = light_tree_node_importance(kg, P, sibling_index);
+
+    if (importance == 0.0f) {
+      return 0.0f;
+    }
+
+    pdf *= importance / (importance + importance_sibling);
+
+    node_index = parent_index;
+    parent_index = kparent->parent_index;
+  }
+
+  return pdf;
+}
+
+/* __light_tree_map contains the emitter index of every lamp, followed by two entries per
+ * object: the offset of the emitter indices of its triangles in the map, or -1 if it has no
+ * emissive triangles, and the primitive offset of its mesh. */
+
+ccl_device_inline int light_tree_lamp_emitter(KernelGlobals *kg, int lamp)
+{
+  return kernel_tex_fetch(__light_tree_map, lamp);
+}
+
+ccl_device_inline int light_tree_triangle_emitter(KernelGlobals *kg, int object, int prim)
+{
+  const int object_offset = kernel_data.integrator.num_all_lights + 2 * object;
+  const int offset = kernel_tex_fetch(__light_tree_map, object_offset);
+
+  if (offset == -1) {
+    return -1;
+  }
+
+  const int prim_offset = kernel_tex_fetch(__light_tree_map, object_offset + 1);
+  return kernel_tex_fetch(__light_tree_map, offset + prim - prim_offset);
+}
+
+CCL_NAMESPACE_END
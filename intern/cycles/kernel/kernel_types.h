@@ -1362,7 +1362,10 @@ typedef struct KernelIntegrator {
 
   int max_closures;
 
-  int pad1, pad2, pad3;
+  /* light tree */
+  int use_light_tree;
+  int light_tree_num_infinite;
+  float light_tree_infinite_pdf;
 } KernelIntegrator;
 static_assert_align(KernelIntegrator, 16);
 
@@ -1531,6 +1534,39 @@ typedef struct KernelLightDistribution {
 } KernelLightDistribution;
 static_assert_align(KernelLightDistribution, 16);
 
+/* Bounds of the emitters in a light tree node, or of a single emitter. The cone around axis
+ * with angle theta_o contains the emitter normals, light is emitted up to theta_e away from
+ * them. */
+typedef struct KernelLightTreeBounds {
+  float bbox_min[3];
+  float energy;
+  float bbox_max[3];
+  float theta_o;
+  float axis[3];
+  float theta_e;
+} KernelLightTreeBounds;
+
+typedef struct KernelLightTreeNode {
+  KernelLightTreeBounds bounds;
+  /* Interior nodes: index of the second child, the first child follows the node.
+   * Leaves: index of the first emitter. */
+  int child_index;
+  /* Zero for interior nodes. */
+  int num_emitters;
+  int parent_index;
+  int pad;
+} KernelLightTreeNode;
+static_assert_align(KernelLightTreeNode, 16);
+
+typedef struct KernelLightTreeEmitter {
+  KernelLightTreeBounds bounds;
+  /* Index in __light_distribution. */
+  int distribution_index;
+  int leaf_index;
+  int pad1, pad2;
+} KernelLightTreeEmitter;
+static_assert_align(KernelLightTreeEmitter, 16);
+
 typedef struct KernelParticle {
   int index;
   float age;
@@ -17,6 +17,8 @@
 #ifndef __KERNEL_CPU_IMAGE_H__
 #define __KERNEL_CPU_IMAGE_H__
 
+#include "util/util_texture_cache.h"
+
 CCL_NAMESPACE_BEGIN
 
 /* Make template functions private so symbols don't conflict between kernels with different
@@ -470,10 +472,32 @@ template<typename T> struct TextureInterpolator {
 #undef SET_CUBIC_SPLINE_WEIGHTS
 };
 
+/* Lookup in an image loaded through the texture cache, the derivatives select the mipmap
+ * level. */
+ccl_device float4 kernel_tex_image_interp_cache(
+    const TextureInfo &info, float x, float y, float2 dx, float2 dy)
+{
+  const TextureCacheImage *image = (const TextureCacheImage *)info.data;
+  float r[4];
+
+  if (!image->cache->lookup(
+          image, x, y, dx.x, dx.y, dy.x, dy.y, info.interpolation, info.extension, r)) {
+    return make_float4(
+        TEX_IMAGE_MISSING_R, TEX_IMAGE_MISSING_G, TEX_IMAGE_MISSING_B, TEX_IMAGE_MISSING_A);
+  }
+
+  return make_float4(r[0], r[1], r[2], r[3]);
+}
+
 ccl_device float4 kernel_tex_image_interp(KernelGlobals *kg, int id, float x, float y)
 {
   const TextureInfo &info = kernel_tex_fetch(__texture_info, id);
 
+  if (info.use_texture_cache) {
+    const float2 zero = make_float2(0.0f, 0.0f);
+    return kernel_tex_image_interp_cache(info, x, y, zero, zero);
+  }
+
   switch (info.data_type) {
     case IMAGE_DATA_TYPE_HALF:
       return TextureInterpolator<half>::interp(info, x, y);
@@ -498,6 +522,20 @@ ccl_device float4 kernel_tex_image_interp(KernelGlobals *kg, int id, float x, fl
   }
 }
 
+/* Same as kernel_tex_image_interp, with the derivatives of the texture coordinates for
+ * filtering images from the texture cache. */
+ccl_device float4
+kernel_tex_image_interp_diff(KernelGlobals *kg, int id, float x, float y, float2 dx, float2 dy)
+{
+  const TextureInfo &info = kernel_tex_fetch(__texture_info, id);
+
+  if (info.use_texture_cache) {
+    return kernel_tex_image_interp_cache(info, x, y, dx, dy);
+  }
+
+  return kernel_tex_image_interp(kg, id, x, y);
+}
+
 ccl_device float4 kernel_tex_image_interp_3d(
     KernelGlobals *kg, int id, float x, float y, float z, InterpolationType interp)
 {
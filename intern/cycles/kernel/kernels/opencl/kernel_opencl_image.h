@@ -202,6 +202,13 @@ ccl_device float4 kernel_tex_image_interp(KernelGlobals *kg, int id, float x, fl
   }
 }
 
+/* The texture cache is CPU only, derivatives are not used. */
+ccl_device float4
+kernel_tex_image_interp_diff(KernelGlobals *kg, int id, float x, float y, float2 dx, float2 dy)
+{
+  return kernel_tex_image_interp(kg, id, x, y);
+}
+
 ccl_device float4
 kernel_tex_image_interp_3d(KernelGlobals *kg, int id, float x, float y, float z, int interp)
 {
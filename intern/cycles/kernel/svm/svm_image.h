@@ -18,14 +18,15 @@ CCL_NAMESPACE_BEGIN
 
 #ifdef __TEXTURES__
 
-ccl_device float4 svm_image_texture(KernelGlobals *kg, int id, float x, float y, uint flags)
+ccl_device float4 svm_image_texture(
+    KernelGlobals *kg, int id, float x, float y, float2 dx, float2 dy, uint flags)
 {
   if (id == -1) {
     return make_float4(
         TEX_IMAGE_MISSING_R, TEX_IMAGE_MISSING_G, TEX_IMAGE_MISSING_B, TEX_IMAGE_MISSING_A);
   }
 
-  float4 r = kernel_tex_image_interp(kg, id, x, y);
+  float4 r = kernel_tex_image_interp_diff(kg, id, x, y, dx, dy);
   const float alpha = r.w;
 
   if ((flags & NODE_IMAGE_ALPHA_UNASSOCIATE) && alpha != 1.0f && alpha != 0.0f) {
@@ -46,6 +47,54 @@ ccl_device_inline float3 texco_remap_square(float3 co)
   return (co - make_float3(0.5f, 0.5f, 0.5f)) * 2.0f;
 }
 
+ccl_device_inline float2 svm_image_projection(float3 co, uint projection)
+{
+  if (projection == NODE_IMAGE_PROJ_SPHERE) {
+    return map_to_sphere(texco_remap_square(co));
+  }
+  else if (projection == NODE_IMAGE_PROJ_TUBE) {
+    return map_to_tube(texco_remap_square(co));
+  }
+  else {
+    return make_float2(co.x, co.y);
+  }
+}
+
+/* Texture coordinates at the neighboring pixels, computed by copies of the nodes before the
+ * image node. Without them the derivatives are zero and the full resolution is used. */
+ccl_device_inline void svm_image_coordinate_differentials(KernelGlobals *kg,
+                                                          float *stack,
+                                                          uint flags,
+                                                          float3 co,
+                                                          float3 *co_dx,
+                                                          float3 *co_dy,
+                                                          int *offset)
+{
+  if (flags & NODE_IMAGE_DERIVATIVES) {
+    uint4 node = read_node(kg, offset);
+    *co_dx = stack_load_float3(stack, node.x);
+    *co_dy = stack_load_float3(stack, node.y);
+  }
+  else {
+    *co_dx = co;
+    *co_dy = co;
+  }
+}
+
+ccl_device_inline float2 svm_image_projection_differential(float2 tex_co,
+                                                           float3 co_d,
+                                                           uint projection)
+{
+  float2 d = svm_image_projection(co_d, projection) - tex_co;
+
+  /* Angles wrap around at the seam. */
+  if (projection == NODE_IMAGE_PROJ_SPHERE || projection == NODE_IMAGE_PROJ_TUBE) {
+    d.x -= floorf(d.x + 0.5f);
+  }
+
+  return d;
+}
+
 ccl_device void svm_node_tex_image(
     KernelGlobals *kg, ShaderData *sd, float *stack, uint4 node, int *offset)
 {
@@ -54,18 +103,12 @@ ccl_device void svm_node_tex_image(
   svm_unpack_node_uchar4(node.z, &co_offset, &out_offset, &alpha_offset, &flags);
 
   float3 co = stack_load_float3(stack, co_offset);
-  float2 tex_co;
-  if (node.w == NODE_IMAGE_PROJ_SPHERE) {
-    co = texco_remap_square(co);
-    tex_co = map_to_sphere(co);
-  }
-  else if (node.w == NODE_IMAGE_PROJ_TUBE) {
-    co = texco_remap_square(co);
-    tex_co = map_to_tube(co);
-  }
-  else {
-    tex_co = make_float2(co.x, co.y);
-  }
+  float2 tex_co = svm_image_projection(co, node.w);
+
+  float3 co_dx, co_dy;
+  svm_image_coordinate_differentials(kg, stack, flags, co, &co_dx, &co_dy, offset);
+  const float2 dx = svm_image_projection_differential(tex_co, co_dx, node.w);
+  const float2 dy = svm_image_projection_differential(tex_co, co_dy, node.w);
 
   /* TODO(lukas): Consider moving tile information out of the SVM node.
    * TextureInfo seems a reasonable candidate. */
@@ -110,7 +153,7 @@ ccl_device void svm_node_tex_image(
     id = -num_nodes;
   }
 
-  float4 f = svm_image_texture(kg, id, tex_co.x, tex_co.y, flags);
+  float4 f = svm_image_texture(kg, id, tex_co.x, tex_co.y, dx, dy, flags);
 
   if (stack_valid(out_offset))
     stack_store_float3(stack, out_offset, make_float3(f.x, f.y, f.z));
@@ -118,7 +161,8 @@ ccl_device void svm_node_tex_image(
     stack_store_float(stack, alpha_offset, f.w);
 }
 
-ccl_device void svm_node_tex_image_box(KernelGlobals *kg, ShaderData *sd, float *stack, uint4 node)
+ccl_device void svm_node_tex_image_box(
+    KernelGlobals *kg, ShaderData *sd, float *stack, uint4 node, int *offset)
 {
   /* get object space normal */
   float3 N = sd->N;
@@ -195,20 +239,46 @@ ccl_device void svm_node_tex_image_box(KernelGlobals *kg, ShaderData *sd, float
   float3 co = stack_load_float3(stack, co_offset);
   uint id = node.y;
 
+  float3 co_dx, co_dy;
+  svm_image_coordinate_differentials(kg, stack, flags, co, &co_dx, &co_dy, offset);
+  const float3 dx = co_dx - co;
+  const float3 dy = co_dy - co;
+
   float4 f = make_float4(0.0f, 0.0f, 0.0f, 0.0f);
 
   /* Map so that no textures are flipped, rotation is somewhat arbitrary. */
   if (weight.x > 0.0f) {
+    const float s = (signed_N.x < 0.0f) ? -1.0f : 1.0f;
     float2 uv = make_float2((signed_N.x < 0.0f) ? 1.0f - co.y : co.y, co.z);
-    f += weight.x * svm_image_texture(kg, id, uv.x, uv.y, flags);
+    f += weight.x * svm_image_texture(kg,
+                                      id,
+                                      uv.x,
+                                      uv.y,
+                                      make_float2(s * dx.y, dx.z),
+                                      make_float2(s * dy.y, dy.z),
+                                      flags);
   }
   if (weight.y > 0.0f) {
+    const float s = (signed_N.y > 0.0f) ? -1.0f : 1.0f;
     float2 uv = make_float2((signed_N.y > 0.0f) ? 1.0f - co.x : co.x, co.z);
-    f += weight.y * svm_image_texture(kg, id, uv.x, uv.y, flags);
+    f += weight.y * svm_image_texture(kg,
+                                      id,
+                                      uv.x,
+                                      uv.y,
+                                      make_float2(s * dx.x, dx.z),
+                                      make_float2(s * dy.x, dy.z),
+                                      flags);
   }
   if (weight.z > 0.0f) {
+    const float s = (signed_N.z > 0.0f) ? -1.0f : 1.0f;
     float2 uv = make_float2((signed_N.z > 0.0f) ? 1.0f - co.y : co.y, co.x);
-    f += weight.z * svm_image_texture(kg, id, uv.x, uv.y, flags);
+    f += weight.z * svm_image_texture(kg,
+                                      id,
+                                      uv.x,
+                                      uv.y,
+                                      make_float2(s * dx.y, dx.x),
+                                      make_float2(s * dy.y, dy.x),
+                                      flags);
   }
 
   if (stack_valid(out_offset))
@@ -238,7 +308,10 @@ ccl_device void svm_node_tex_environment(KernelGlobals *kg,
   else
     uv = direction_to_mirrorball(co);
 
-  float4 f = svm_image_texture(kg, id, uv.x, uv.y, flags);
+  /* Environment lookups don't have ray differentials for the direction here, use the full
+   * resolution. */
+  const float2 zero = make_float2(0.0f, 0.0f);
+  float4 f = svm_image_texture(kg, id, uv.x, uv.y, zero, zero, flags);
 
   if (stack_valid(out_offset))
     stack_store_float3(stack, out_offset, make_float3(f.x, f.y, f.z));
@@ -474,6 +474,8 @@ typedef enum NodeImageProjection {
 typedef enum NodeImageFlags {
   NODE_IMAGE_COMPRESS_AS_SRGB = 1,
   NODE_IMAGE_ALPHA_UNASSOCIATE = 2,
+  /* Stack offsets of the coordinates at the neighboring pixels follow the node. */
+  NODE_IMAGE_DERIVATIVES = 4,
 } NodeImageFlags;
 
 typedef enum NodeEnvironmentProjection {
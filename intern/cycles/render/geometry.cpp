@@ -41,6 +41,7 @@
 #include "util/util_foreach.h"
 #include "util/util_logging.h"
 #include "util/util_progress.h"
+#include "util/util_task.h"
 
 CCL_NAMESPACE_BEGIN
 
@@ -214,6 +215,9 @@ void Geometry::compute_bvh(
       bparams.bvh_type = params->bvh_type;
       bparams.curve_flags = dscene->data.curve.curveflags;
       bparams.curve_subdivisions = dscene->data.curve.subdivisions;
+      bparams.use_cache = params->use_bvh_cache;
+      bparams.cache_path = params->bvh_cache_path;
+      bparams.cache_limit = (size_t)params->bvh_cache_limit * 1024 * 1024;
 
       delete bvh;
       bvh = BVH::create(bparams, geometry, objects);
@@ -1009,6 +1013,24 @@ void GeometryManager::device_update_mesh(
   }
 }
 
+/* On the CPU the device arrays are the host arrays, which were written by the thread building the
+ * BVH. On NUMA systems copy them from the worker threads instead of taking them over, so their
+ * pages are spread over the nodes of the render threads which all read them. */
+template<typename T>
+static void device_bvh_array_take(Device *device, device_vector<T> &dst, array<T> &src)
+{
+  const size_t size = src.size() * sizeof(T);
+  if (device->info.type == DEVICE_CPU && task_first_touch_is_spread(size)) {
+    T *data = dst.alloc(src.size());
+    task_first_touch_memcpy(data, src.data(), size);
+    src.clear();
+  }
+  else {
+    dst.steal_data(src);
+  }
+  dst.copy_to_device();
+}
+
 void GeometryManager::device_update_bvh(Device *device,
                                         DeviceScene *dscene,
                                         Scene *scene,
@@ -1029,6 +1051,11 @@ void GeometryManager::device_update_bvh(Device *device,
   bparams.bvh_type = scene->params.bvh_type;
   bparams.curve_flags = dscene->data.curve.curveflags;
   bparams.curve_subdivisions = dscene->data.curve.subdivisions;
+  /* The top level of a dynamic BVH only contains instances and is quick to build. */
+  bparams.use_cache = scene->params.use_bvh_cache &&
+                      scene->params.bvh_type == SceneParams::BVH_STATIC;
+  bparams.cache_path = scene->params.bvh_cache_path;
+  bparams.cache_limit = (size_t)scene->params.bvh_cache_limit * 1024 * 1024;
 
   VLOG(1) << "Using " << bvh_layout_name(bparams.bvh_layout) << " layout.";
 
@@ -1061,44 +1088,34 @@ void GeometryManager::device_update_bvh(Device *device,
   PackedBVH &pack = bvh->pack;
 
   if (pack.nodes.size()) {
-    dscene->bvh_nodes.steal_data(pack.nodes);
-    dscene->bvh_nodes.copy_to_device();
+    device_bvh_array_take(device, dscene->bvh_nodes, pack.nodes);
   }
   if (pack.leaf_nodes.size()) {
-    dscene->bvh_leaf_nodes.steal_data(pack.leaf_nodes);
-    dscene->bvh_leaf_nodes.copy_to_device();
+    device_bvh_array_take(device, dscene->bvh_leaf_nodes, pack.leaf_nodes);
   }
   if (pack.object_node.size()) {
-    dscene->object_node.steal_data(pack.object_node);
-    dscene->object_node.copy_to_device();
+    device_bvh_array_take(device, dscene->object_node, pack.object_node);
   }
   if (pack.prim_tri_index.size()) {
-    dscene->prim_tri_index.steal_data(pack.prim_tri_index);
-    dscene->prim_tri_index.copy_to_device();
+    device_bvh_array_take(device, dscene->prim_tri_index, pack.prim_tri_index);
   }
   if (pack.prim_tri_verts.size()) {
-    dscene->prim_tri_verts.steal_data(pack.prim_tri_verts);
-    dscene->prim_tri_verts.copy_to_device();
+    device_bvh_array_take(device, dscene->prim_tri_verts, pack.prim_tri_verts);
   }
   if (pack.prim_type.size()) {
-    dscene->prim_type.steal_data(pack.prim_type);
-    dscene->prim_type.copy_to_device();
+    device_bvh_array_take(device, dscene->prim_type, pack.prim_type);
   }
   if (pack.prim_visibility.size()) {
-    dscene->prim_visibility.steal_data(pack.prim_visibility);
-    dscene->prim_visibility.copy_to_device();
+    device_bvh_array_take(device, dscene->prim_visibility, pack.prim_visibility);
   }
   if (pack.prim_index.size()) {
-    dscene->prim_index.steal_data(pack.prim_index);
-    dscene->prim_index.copy_to_device();
+    device_bvh_array_take(device, dscene->prim_index, pack.prim_index);
   }
   if (pack.prim_object.size()) {
-    dscene->prim_object.steal_data(pack.prim_object);
-    dscene->prim_object.copy_to_device();
+    device_bvh_array_take(device, dscene->prim_object, pack.prim_object);
   }
   if (pack.prim_time.size()) {
-    dscene->prim_time.steal_data(pack.prim_time);
-    dscene->prim_time.copy_to_device();
+    device_bvh_array_take(device, dscene->prim_time, pack.prim_time);
   }
 
   dscene->data.bvh.root = pack.root_index;
@@ -383,6 +383,9 @@ void ShaderGraph::finalize(Scene *scene, bool do_bump, bool do_simplify, bool bu
     if (do_bump)
       bump_from_displacement(bump_in_object_space);
 
+    if (scene->image_manager->use_texture_cache() && !scene->shader_manager->use_osl())
+      refine_texture_derivatives();
+
     ShaderInput *surface_in = output()->input("Surface");
     ShaderInput *volume_in = output()->input("Volume");
 
@@ -953,6 +956,58 @@ void ShaderGraph::refine_bump_nodes()
   }
 }
 
+void ShaderGraph::refine_texture_derivatives()
+{
+  /* the texture cache picks the mipmap level from the texture coordinate
+   * derivatives. like for bump nodes, we copy the sub-graph defined from the
+   * image "Vector" input twice, and evaluate the copies shifted by dx and dy
+   * to get the coordinates at the neighboring pixels. */
+
+  vector<ShaderNode *> image_nodes;
+
+  foreach (ShaderNode *node, nodes) {
+    ShaderInput *vector_in = node->input("Vector");
+    if (vector_in && vector_in->link && node->input("VectorDx")) {
+      image_nodes.push_back(node);
+    }
+  }
+
+  foreach (ShaderNode *node, image_nodes) {
+    ShaderInput *vector_in = node->input("Vector");
+    ShaderNodeSet nodes_vector;
+    ShaderNodeMap nodes_dx;
+    ShaderNodeMap nodes_dy;
+
+    find_dependencies(nodes_vector, vector_in);
+
+    copy_nodes(nodes_vector, nodes_dx);
+    copy_nodes(nodes_vector, nodes_dy);
+
+    /* nodes already evaluated at a shifted position for bump mapping use
+     * the center as the other neighbor. */
+    ShaderBump bump_dx = SHADER_BUMP_DX;
+    ShaderBump bump_dy = SHADER_BUMP_DY;
+    if (node->bump == SHADER_BUMP_DX)
+      bump_dx = SHADER_BUMP_CENTER;
+    else if (node->bump == SHADER_BUMP_DY)
+      bump_dy = SHADER_BUMP_CENTER;
+
+    foreach (NodePair &pair, nodes_dx)
+      pair.second->bump = bump_dx;
+    foreach (NodePair &pair, nodes_dy)
+      pair.second->bump = bump_dy;
+
+    ShaderOutput *out = vector_in->link;
+    connect(nodes_dx[out->parent]->output(out->name()), node->input("VectorDx"));
+    connect(nodes_dy[out->parent]->output(out->name()), node->input("VectorDy"));
+
+    foreach (NodePair &pair, nodes_dx)
+      add(pair.second);
+    foreach (NodePair &pair, nodes_dy)
+      add(pair.second);
+  }
+}
+
 void ShaderGraph::bump_from_displacement(bool use_object_space)
 {
   /* generate bump mapping automatically from displacement. bump mapping is
@@ -28,6 +28,7 @@
 #include "util/util_path.h"
 #include "util/util_progress.h"
 #include "util/util_texture.h"
+#include "util/util_texture_cache.h"
 #include "util/util_unique_ptr.h"
 
 #ifdef WITH_OSL
@@ -258,6 +259,7 @@ ImageManager::ImageManager(const DeviceInfo &info)
 {
   need_update = true;
   osl_texture_system = NULL;
+  texture_cache = NULL;
   animation_frame = 0;
 
   /* Set image limits */
@@ -268,6 +270,8 @@ ImageManager::~ImageManager()
 {
   for (size_t slot = 0; slot < images.size(); slot++)
     assert(!images[slot]);
+
+  delete texture_cache;
 }
 
 void ImageManager::set_osl_texture_system(void *texture_system)
@@ -275,6 +279,27 @@ void ImageManager::set_osl_texture_system(void *texture_system)
   osl_texture_system = texture_system;
 }
 
+void ImageManager::set_texture_cache(TextureCache *cache)
+{
+  if (cache != texture_cache) {
+    delete texture_cache;
+    texture_cache = cache;
+
+    /* Reload images to get handles from the new cache, or their pixels. */
+    foreach (Image *img, images) {
+      if (img) {
+        img->need_load = true;
+      }
+    }
+    need_update = true;
+  }
+}
+
+bool ImageManager::use_texture_cache() const
+{
+  return texture_cache != NULL;
+}
+
 bool ImageManager::set_animation_frame_update(int frame)
 {
   if (frame != animation_frame) {
@@ -594,6 +619,46 @@ bool ImageManager::file_load_image(Image *img, int texture_limit)
   return true;
 }
 
+bool ImageManager::texture_cache_load_image(Image *img)
+{
+  /* Only images stored in files, without conversions the texture system can't do. */
+  const ustring filepath = img->loader->osl_filepath();
+  if (filepath.empty() || img->metadata.depth > 1) {
+    return false;
+  }
+  if (img->metadata.colorspace != u_colorspace_raw &&
+      img->metadata.colorspace != u_colorspace_srgb) {
+    return false;
+  }
+  /* The texture system always associates alpha. */
+  if (img->metadata.channels == 4 && !image_associate_alpha(img)) {
+    return false;
+  }
+
+  TextureCacheImage cache_image;
+  if (!texture_cache->get_image(filepath.string(), &cache_image)) {
+    return false;
+  }
+
+  /* Store the image handle instead of pixels. */
+  thread_scoped_lock device_lock(device_mutex);
+  Device *device = img->mem->device;
+  const int slot = img->mem->slot;
+  delete img->mem;
+  img->mem = new device_texture(device,
+                                img->mem_name.c_str(),
+                                slot,
+                                IMAGE_DATA_TYPE_BYTE,
+                                img->params.interpolation,
+                                img->params.extension);
+
+  uchar *data = (uchar *)img->mem->alloc(sizeof(TextureCacheImage), 1);
+  memcpy(data, &cache_image, sizeof(TextureCacheImage));
+  img->mem->info.use_texture_cache = 1;
+
+  return true;
+}
+
 void ImageManager::device_load_image(Device *device, Scene *scene, int slot, Progress *progress)
 {
   if (progress->get_cancel()) {
@@ -623,7 +688,10 @@ void ImageManager::device_load_image(Device *device, Scene *scene, int slot, Pro
       device, img->mem_name.c_str(), slot, type, img->params.interpolation, img->params.extension);
 
   /* Create new texture. */
-  if (type == IMAGE_DATA_TYPE_FLOAT4) {
+  if (texture_cache && texture_cache_load_image(img)) {
+    /* Tiles are loaded on demand during rendering. */
+  }
+  else if (type == IMAGE_DATA_TYPE_FLOAT4) {
     if (!file_load_image<TypeDesc::FLOAT, float>(img, texture_limit)) {
       /* on failure to load, we set a 1x1 pixels pink image */
       thread_scoped_lock device_lock(device_mutex);
@@ -734,6 +802,10 @@ void ImageManager::device_free_image(Device *, int slot)
 #endif
   }
 
+  if (img->mem && img->mem->info.use_texture_cache) {
+    texture_cache->invalidate((const TextureCacheImage *)img->mem->host_pointer);
+  }
+
   if (img->mem) {
     thread_scoped_lock device_lock(device_mutex);
     delete img->mem;
@@ -38,6 +38,7 @@ class Progress;
 class RenderStats;
 class Scene;
 class ColorSpaceProcessor;
+class TextureCache;
 
 /* Image Parameters */
 class ImageParams {
@@ -174,6 +175,9 @@ class ImageManager {
   void device_free_builtin(Device *device);
 
   void set_osl_texture_system(void *texture_system);
+  /* Takes ownership of the cache, NULL to load all images fully. */
+  void set_texture_cache(TextureCache *cache);
+  bool use_texture_cache() const;
   bool set_animation_frame_update(int frame);
 
   void collect_statistics(RenderStats *stats);
@@ -205,6 +209,7 @@ class ImageManager {
 
   vector<Image *> images;
   void *osl_texture_system;
+  TextureCache *texture_cache;
 
   int add_image_slot(ImageLoader *loader, const ImageParams &params, const bool builtin);
   void add_image_user(int slot);
@@ -214,6 +219,7 @@ class ImageManager {
 
   template<TypeDesc::BASETYPE FileFormat, typename StorageType>
   bool file_load_image(Image *img, int texture_limit);
+  bool texture_cache_load_image(Image *img);
 
   void device_load_image(Device *device, Scene *scene, int slot, Progress *progress);
   void device_free_image(Device *device, int slot);
@@ -20,6 +20,7 @@
 #include "render/film.h"
 #include "render/graph.h"
 #include "render/light.h"
+#include "render/light_tree.h"
 #include "render/mesh.h"
 #include "render/nodes.h"
 #include "render/object.h"
@@ -475,6 +476,9 @@ void LightManager::device_update_distribution(Device *,
     /* CDF */
     dscene->light_distribution.copy_to_device();
 
+    /* Light tree, selecting lights from the CDF based on the shading point. */
+    device_update_tree(dscene, scene, progress);
+
     /* Portals */
     if (num_portals > 0) {
       kintegrator->portal_offset = light_index;
@@ -489,6 +493,9 @@ void LightManager::device_update_distribution(Device *,
   }
   else {
     dscene->light_distribution.free();
+    dscene->light_tree_nodes.free();
+    dscene->light_tree_emitters.free();
+    dscene->light_tree_map.free();
 
     kintegrator->num_distribution = 0;
     kintegrator->num_all_lights = 0;
@@ -498,11 +505,224 @@ void LightManager::device_update_distribution(Device *,
     kintegrator->num_portals = 0;
     kintegrator->portal_offset = 0;
     kintegrator->portal_pdf = 0.0f;
+    kintegrator->use_light_tree = false;
+    kintegrator->light_tree_num_infinite = 0;
+    kintegrator->light_tree_infinite_pdf = 0.0f;
 
     kfilm->pass_shadow_scale = 1.0f;
   }
 }
 
+void LightManager::device_update_tree(DeviceScene *dscene, Scene *scene, Progress &progress)
+{
+  KernelIntegrator *kintegrator = &dscene->data.integrator;
+  Integrator *integrator = scene->integrator;
+
+  dscene->light_tree_nodes.free();
+  dscene->light_tree_emitters.free();
+  dscene->light_tree_map.free();
+
+  kintegrator->use_light_tree = false;
+  kintegrator->light_tree_num_infinite = 0;
+  kintegrator->light_tree_infinite_pdf = 0.0f;
+
+  /* Branched path tracing sampling all lights does not select lights at random. */
+  const bool sample_all_lights = (integrator->method == Integrator::BRANCHED_PATH &&
+                                  (integrator->sample_all_lights_direct ||
+                                   integrator->sample_all_lights_indirect));
+
+  if (!integrator->use_light_tree || sample_all_lights) {
+    return;
+  }
+
+  progress.set_status("Updating Lights", "Building light tree");
+
+  vector<LightTreePrimitive> infinite_prims;
+  vector<LightTreePrimitive> local_prims;
+
+  /* Map from lamps and triangles to distribution indices, replaced by emitter indices once the
+   * tree is built. See light_tree_triangle_emitter() for the layout. */
+  const int num_lights = kintegrator->num_all_lights;
+  const int num_objects = scene->objects.size();
+  vector<int> emitter_map(num_lights + 2 * num_objects, -1);
+  vector<int> object_offsets;
+
+  /* Triangles, in the same order as the distribution. */
+  int distribution_index = 0;
+  int object_index = 0;
+
+  foreach (Object *object, scene->objects) {
+    if (progress.get_cancel())
+      return;
+
+    if (!object_usable_as_light(object)) {
+      object_index++;
+      continue;
+    }
+
+    Mesh *mesh = static_cast<Mesh *>(object->geometry);
+    bool transform_applied = mesh->transform_applied;
+    Transform tfm = object->tfm;
+    size_t mesh_num_triangles = mesh->num_triangles();
+    int offset = -1;
+
+    /* Estimate the emitted power from constant emission, other shaders are assumed to emit
+     * the same amount of light per area. */
+    vector<float> shader_emission(mesh->used_shaders.size() + 1);
+    for (size_t i = 0; i <= mesh->used_shaders.size(); i++) {
+      Shader *shader = (i < mesh->used_shaders.size()) ? mesh->used_shaders[i] :
+                                                         scene->default_surface;
+      float3 emission;
+      shader_emission[i] = shader->is_constant_emission(&emission) ? average(emission) : 1.0f;
+    }
+
+    for (size_t i = 0; i < mesh_num_triangles; i++) {
+      int shader_index = mesh->shader[i];
+      Shader *shader = (shader_index < mesh->used_shaders.size()) ?
+                           mesh->used_shaders[shader_index] :
+                           scene->default_surface;
+
+      if (!(shader->use_mis && shader->has_surface_emission)) {
+        continue;
+      }
+
+      if (offset == -1) {
+        offset = emitter_map.size();
+        emitter_map[num_lights + 2 * object_index] = offset;
+        emitter_map[num_lights + 2 * object_index + 1] = mesh->prim_offset;
+        emitter_map.resize(offset + mesh_num_triangles, -1);
+        object_offsets.push_back(offset);
+      }
+
+      Mesh::Triangle t = mesh->get_triangle(i);
+      if (t.valid(&mesh->verts[0])) {
+        float3 p1 = mesh->verts[t.v[0]];
+        float3 p2 = mesh->verts[t.v[1]];
+        float3 p3 = mesh->verts[t.v[2]];
+
+        if (!transform_applied) {
+          p1 = transform_point(&tfm, p1);
+          p2 = transform_point(&tfm, p2);
+          p3 = transform_point(&tfm, p3);
+        }
+
+        float3 N = cross(p2 - p1, p3 - p1);
+        const float area = 0.5f * len(N);
+
+        if (area > 0.0f) {
+          /* Emission is two sided, so the normal only bounds the position. */
+          LightTreePrimitive prim;
+          prim.bbox.grow(p1);
+          prim.bbox.grow(p2);
+          prim.bbox.grow(p3);
+          prim.orientation = LightTreeOrientation(normalize(N), M_PI_F, M_PI_2_F);
+          prim.energy = area * shader_emission[min(shader_index, (int)mesh->used_shaders.size())];
+          prim.distribution_index = distribution_index;
+          local_prims.push_back(prim);
+
+          emitter_map[offset + i] = distribution_index;
+        }
+      }
+
+      distribution_index++;
+    }
+
+    object_index++;
+  }
+
+  /* Lamps, with their intensity as seen from the front. */
+  int light_index = 0;
+  foreach (Light *light, scene->lights) {
+    if (!light->is_enabled)
+      continue;
+
+    LightTreePrimitive prim;
+    prim.distribution_index = distribution_index;
+    prim.energy = average(light->strength) * (0.25f * M_1_PI_F);
+
+    if (light->type == LIGHT_DISTANT || light->type == LIGHT_BACKGROUND) {
+      infinite_prims.push_back(prim);
+    }
+    else {
+      if (light->type == LIGHT_AREA) {
+        float3 axisu = light->axisu * (light->sizeu * light->size);
+        float3 axisv = light->axisv * (light->sizev * light->size);
+        prim.bbox.grow(light->co + 0.5f * (axisu + axisv));
+        prim.bbox.grow(light->co + 0.5f * (axisu - axisv));
+        prim.bbox.grow(light->co - 0.5f * (axisu + axisv));
+        prim.bbox.grow(light->co - 0.5f * (axisu - axisv));
+        prim.orientation = LightTreeOrientation(safe_normalize(light->dir), 0.0f, M_PI_2_F);
+        prim.energy *= M_PI_F;
+      }
+      else {
+        prim.bbox.grow(light->co, light->size);
+        if (light->type == LIGHT_SPOT) {
+          prim.orientation = LightTreeOrientation(
+              safe_normalize(light->dir), 0.0f, 0.5f * light->spot_angle);
+        }
+        else {
+          prim.orientation = LightTreeOrientation(
+              make_float3(0.0f, 0.0f, 1.0f), M_PI_F, M_PI_2_F);
+        }
+      }
+
+      local_prims.push_back(prim);
+    }
+
+    emitter_map[light_index] = distribution_index;
+
+    light_index++;
+    distribution_index++;
+  }
+
+  if (local_prims.empty()) {
+    /* Nothing to gain over the distribution. */
+    return;
+  }
+
+  LightTree tree(infinite_prims, local_prims);
+  const vector<KernelLightTreeNode> &nodes = tree.get_nodes();
+  const vector<KernelLightTreeEmitter> &emitters = tree.get_emitters();
+
+  VLOG(1) << "Light tree with " << nodes.size() << " nodes and " << emitters.size()
+          << " emitters.";
+
+  /* Replace distribution indices by emitter indices. */
+  vector<int> distribution_emitter(distribution_index, -1);
+  for (size_t i = 0; i < emitters.size(); i++) {
+    distribution_emitter[emitters[i].distribution_index] = i;
+  }
+
+  for (int i = 0; i < num_lights; i++) {
+    emitter_map[i] = distribution_emitter[emitter_map[i]];
+  }
+  for (size_t i = 0; i < object_offsets.size(); i++) {
+    const int end = (i + 1 < object_offsets.size()) ? object_offsets[i + 1] : emitter_map.size();
+    for (int j = object_offsets[i]; j < end; j++) {
+      if (emitter_map[j] != -1) {
+        emitter_map[j] = distribution_emitter[emitter_map[j]];
+      }
+    }
+  }
+
+  KernelLightTreeNode *knodes = dscene->light_tree_nodes.alloc(nodes.size());
+  memcpy(knodes, &nodes[0], sizeof(KernelLightTreeNode) * nodes.size());
+  dscene->light_tree_nodes.copy_to_device();
+
+  KernelLightTreeEmitter *kemitters = dscene->light_tree_emitters.alloc(emitters.size());
+  memcpy(kemitters, &emitters[0], sizeof(KernelLightTreeEmitter) * emitters.size());
+  dscene->light_tree_emitters.copy_to_device();
+
+  int *kmap = dscene->light_tree_map.alloc(emitter_map.size());
+  memcpy(kmap, &emitter_map[0], sizeof(int) * emitter_map.size());
+  dscene->light_tree_map.copy_to_device();
+
+  /* Split samples between infinite and local emitters when there are both. */
+  kintegrator->use_light_tree = true;
+  kintegrator->light_tree_num_infinite = infinite_prims.size();
+  kintegrator->light_tree_infinite_pdf = infinite_prims.empty() ? 0.0f : 0.5f;
+}
+
 static void background_cdf(
     int start, int end, int res_x, int res_y, const vector<float3> *pixels, float2 *cond_cdf)
 {
@@ -937,6 +1157,9 @@ void LightManager::device_free(Device *, DeviceScene *dscene)
   dscene->lights.free();
   dscene->light_background_marginal_cdf.free();
   dscene->light_background_conditional_cdf.free();
+  dscene->light_tree_nodes.free();
+  dscene->light_tree_emitters.free();
+  dscene->light_tree_map.free();
   dscene->ies_lights.free();
 }
 
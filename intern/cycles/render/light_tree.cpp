@@ -0,0 +1,303 @@
+/*
+ * Copyright 2011-2020 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "render/light_tree.h"
+
+#include "util/util_algorithm.h"
+#include "util/util_math.h"
+#include "util/util_transform.h"
+
+CCL_NAMESPACE_BEGIN
+
+/* Orientation Bounds */
+
+float LightTreeOrientation::measure() const
+{
+  const float theta_w = min(theta_o + theta_e, M_PI_F);
+  const float sin_theta_o = sinf(theta_o);
+  const float cos_theta_o = cosf(theta_o);
+
+  return M_2PI_F * (1.0f - cos_theta_o) +
+         M_PI_2_F * (2.0f * theta_w * sin_theta_o - cosf(theta_o - 2.0f * theta_w) -
+                     2.0f * theta_o * sin_theta_o + cos_theta_o);
+}
+
+LightTreeOrientation merge(const LightTreeOrientation &cone_a, const LightTreeOrientation &cone_b)
+{
+  /* Smallest cone containing both, grown from the wider one. */
+  const bool swap = (cone_b.theta_o > cone_a.theta_o);
+  const LightTreeOrientation &a = swap ? cone_b : cone_a;
+  const LightTreeOrientation &b = swap ? cone_a : cone_b;
+
+  const float theta_d = safe_acosf(dot(a.axis, b.axis));
+  const float theta_e = max(a.theta_e, b.theta_e);
+
+  if (min(theta_d + b.theta_o, M_PI_F) <= a.theta_o) {
+    return LightTreeOrientation(a.axis, a.theta_o, theta_e);
+  }
+
+  const float theta_o = 0.5f * (a.theta_o + theta_d + b.theta_o);
+  if (theta_o >= M_PI_F) {
+    return LightTreeOrientation(a.axis, M_PI_F, theta_e);
+  }
+
+  /* Rotate the axis towards the other cone. */
+  float3 rotation_axis = cross(a.axis, b.axis);
+  if (len_squared(rotation_axis) < 1e-12f) {
+    float3 unused;
+    make_orthonormals(a.axis, &rotation_axis, &unused);
+  }
+
+  const Transform rotation = transform_rotate(theta_o - a.theta_o, rotation_axis);
+  const float3 axis = normalize(transform_direction(&rotation, a.axis));
+
+  return LightTreeOrientation(axis, theta_o, theta_e);
+}
+
+/* Light Tree */
+
+static void light_tree_bounds_pack(KernelLightTreeBounds *kbounds,
+                                   const BoundBox &bbox,
+                                   const LightTreeOrientation &orientation,
+                                   float energy)
+{
+  kbounds->bbox_min[0] = bbox.min.x;
+  kbounds->bbox_min[1] = bbox.min.y;
+  kbounds->bbox_min[2] = bbox.min.z;
+  kbounds->energy = energy;
+  kbounds->bbox_max[0] = bbox.max.x;
+  kbounds->bbox_max[1] = bbox.max.y;
+  kbounds->bbox_max[2] = bbox.max.z;
+  kbounds->theta_o = orientation.theta_o;
+  kbounds->axis[0] = orientation.axis.x;
+  kbounds->axis[1] = orientation.axis.y;
+  kbounds->axis[2] = orientation.axis.z;
+  kbounds->theta_e = orientation.theta_e;
+}
+
+LightTree::LightTree(const vector<LightTreePrimitive> &infinite_prims,
+                     const vector<LightTreePrimitive> &local_prims,
+                     int max_prims_in_leaf)
+    : prims(local_prims),
+      num_infinite(infinite_prims.size()),
+      max_prims_in_leaf(max_prims_in_leaf)
+{
+  emitters.resize(num_infinite + prims.size());
+
+  /* Infinite emitters are not part of the tree and have no bounds. */
+  for (int i = 0; i < num_infinite; i++) {
+    KernelLightTreeEmitter &kemitter = emitters[i];
+    kemitter.bounds.energy = infinite_prims[i].energy;
+    kemitter.distribution_index = infinite_prims[i].distribution_index;
+    kemitter.leaf_index = -1;
+  }
+
+  if (prims.empty()) {
+    return;
+  }
+
+  /* Reorders prims, and sets the leaf index of their emitters. */
+  nodes.reserve(2 * prims.size() / max_prims_in_leaf + 1);
+  recursive_build(-1, 0, prims.size());
+
+  for (int i = 0; i < prims.size(); i++) {
+    const LightTreePrimitive &prim = prims[i];
+    KernelLightTreeEmitter &kemitter = emitters[num_infinite + i];
+    light_tree_bounds_pack(&kemitter.bounds, prim.bbox, prim.orientation, prim.energy);
+    kemitter.distribution_index = prim.distribution_index;
+  }
+}
+
+int LightTree::recursive_build(int parent_index, int start, int end)
+{
+  BoundBox bbox = BoundBox::empty;
+  BoundBox centroid_bbox = BoundBox::empty;
+  LightTreeOrientation orientation = prims[start].orientation;
+  float energy = 0.0f;
+
+  for (int i = start; i < end; i++) {
+    const LightTreePrimitive &prim = prims[i];
+    bbox.grow(prim.bbox);
+    centroid_bbox.grow(prim.bbox.center());
+    orientation = merge(orientation, prim.orientation);
+    energy += prim.energy;
+  }
+
+  const int node_index = nodes.size();
+  nodes.push_back(KernelLightTreeNode());
+  light_tree_bounds_pack(&nodes[node_index].bounds, bbox, orientation, energy);
+  nodes[node_index].parent_index = parent_index;
+
+  if (end - start > max_prims_in_leaf) {
+    int middle;
+    if (!find_split(start, end, bbox, centroid_bbox, &middle)) {
+      /* All centroids in the same place, any split is as good. */
+      middle = (start + end) / 2;
+    }
+
+    recursive_build(node_index, start, middle);
+    const int right_index = recursive_build(node_index, middle, end);
+
+    /* Note: nodes may have been reallocated by the recursion. */
+    nodes[node_index].child_index = right_index;
+    nodes[node_index].num_emitters = 0;
+  }
+  else {
+    nodes[node_index].child_index = num_infinite + start;
+    nodes[node_index].num_emitters = end - start;
+
+    for (int i = start; i < end; i++) {
+      emitters[num_infinite + i].leaf_index = node_index;
+    }
+  }
+
+  return node_index;
+}
+
+/* Bucket of a primitive centroid along an axis of the node centroid bounds. */
+struct LightTreeBucketIndex {
+  int axis;
+  float offset;
+  float scale;
+  int num_buckets;
+
+  LightTreeBucketIndex(int axis, const BoundBox &centroid_bbox, int num_buckets)
+      : axis(axis),
+        offset(centroid_bbox.min[axis]),
+        scale(num_buckets / centroid_bbox.size()[axis]),
+        num_buckets(num_buckets)
+  {
+  }
+
+  int operator()(const LightTreePrimitive &prim) const
+  {
+    const int bucket = (int)((prim.bbox.center()[axis] - offset) * scale);
+    return clamp(bucket, 0, num_buckets - 1);
+  }
+};
+
+struct LightTreeBucketCompare {
+  LightTreeBucketIndex bucket_index;
+  int split_bucket;
+
+  LightTreeBucketCompare(const LightTreeBucketIndex &bucket_index, int split_bucket)
+      : bucket_index(bucket_index), split_bucket(split_bucket)
+  {
+  }
+
+  bool operator()(const LightTreePrimitive &prim) const
+  {
+    return bucket_index(prim) < split_bucket;
+  }
+};
+
+bool LightTree::find_split(
+    int start, int end, const BoundBox &bbox, const BoundBox &centroid_bbox, int *r_middle)
+{
+  struct Bucket {
+    int count;
+    float energy;
+    BoundBox bbox;
+    LightTreeOrientation orientation;
+
+    Bucket() : count(0), energy(0.0f), bbox(BoundBox::empty)
+    {
+    }
+
+    void add(const LightTreePrimitive &prim)
+    {
+      orientation = (count == 0) ? prim.orientation : merge(orientation, prim.orientation);
+      bbox.grow(prim.bbox);
+      energy += prim.energy;
+      count++;
+    }
+
+    void add(const Bucket &other)
+    {
+      if (other.count > 0) {
+        orientation = (count == 0) ? other.orientation : merge(orientation, other.orientation);
+        bbox.grow(other.bbox);
+        energy += other.energy;
+        count += other.count;
+      }
+    }
+
+    float cost() const
+    {
+      return energy * bbox.area() * orientation.measure();
+    }
+  };
+
+  const int num_buckets = 12;
+  const float3 extent = bbox.size();
+  const float3 centroid_extent = centroid_bbox.size();
+  const float max_extent = max3(extent);
+
+  float min_cost = FLT_MAX;
+  int min_axis = -1;
+  int min_bucket = 0;
+
+  for (int axis = 0; axis < 3; axis++) {
+    if (centroid_extent[axis] == 0.0f) {
+      continue;
+    }
+
+    const LightTreeBucketIndex bucket_index(axis, centroid_bbox, num_buckets);
+    Bucket buckets[num_buckets];
+    for (int i = start; i < end; i++) {
+      buckets[bucket_index(prims[i])].add(prims[i]);
+    }
+
+    /* Regularization against thin long nodes, the area does not penalize them. */
+    const float regularization = max_extent / extent[axis];
+
+    for (int split = 1; split < num_buckets; split++) {
+      Bucket left, right;
+      for (int i = 0; i < split; i++) {
+        left.add(buckets[i]);
+      }
+      for (int i = split; i < num_buckets; i++) {
+        right.add(buckets[i]);
+      }
+
+      if (left.count == 0 || right.count == 0) {
+        continue;
+      }
+
+      const float cost = regularization * (left.cost() + right.cost());
+      if (cost < min_cost) {
+        min_cost = cost;
+        min_axis = axis;
+        min_bucket = split;
+      }
+    }
+  }
+
+  if (min_axis == -1) {
+    return false;
+  }
+
+  vector<LightTreePrimitive>::iterator middle = std::partition(
+      prims.begin() + start,
+      prims.begin() + end,
+      LightTreeBucketCompare(LightTreeBucketIndex(min_axis, centroid_bbox, num_buckets),
+                             min_bucket));
+
+  *r_middle = middle - prims.begin();
+  return (*r_middle != start && *r_middle != end);
+}
+
+CCL_NAMESPACE_END
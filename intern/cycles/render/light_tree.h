@@ -0,0 +1,102 @@
+/*
+ * Copyright 2011-2020 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __LIGHT_TREE_H__
+#define __LIGHT_TREE_H__
+
+#include "kernel/kernel_types.h"
+
+#include "util/util_boundbox.h"
+#include "util/util_types.h"
+#include "util/util_vector.h"
+
+CCL_NAMESPACE_BEGIN
+
+/* Bounds on the directions an emitter sends light in: a cone of normals around axis with
+ * spread theta_o, each emitting within theta_e of the normal. */
+struct LightTreeOrientation {
+  float3 axis;
+  float theta_o;
+  float theta_e;
+
+  LightTreeOrientation() : axis(make_float3(0.0f, 0.0f, 1.0f)), theta_o(0.0f), theta_e(0.0f)
+  {
+  }
+
+  LightTreeOrientation(const float3 &axis_, float theta_o_, float theta_e_)
+      : axis(axis_), theta_o(theta_o_), theta_e(theta_e_)
+  {
+  }
+
+  /* Measure of the orientation bounds, used in the split cost. */
+  float measure() const;
+};
+
+LightTreeOrientation merge(const LightTreeOrientation &a, const LightTreeOrientation &b);
+
+/* Lamp or emissive triangle with an estimate of its power, referencing its entry in the
+ * light distribution. */
+struct LightTreePrimitive {
+  BoundBox bbox;
+  LightTreeOrientation orientation;
+  float energy;
+  int distribution_index;
+
+  LightTreePrimitive() : bbox(BoundBox::empty), energy(0.0f), distribution_index(-1)
+  {
+  }
+};
+
+/* Light Tree
+ *
+ * Binary tree over the bounds of local emitters, built with the surface area orientation
+ * heuristic from "Importance Sampling of Many Lights with Adaptive Tree Splitting". Nodes are
+ * stored depth first so the left child directly follows its parent. Distant and background
+ * lights can not be bounded and are stored in front of the local emitters. */
+class LightTree {
+ public:
+  LightTree(const vector<LightTreePrimitive> &infinite_prims,
+            const vector<LightTreePrimitive> &local_prims,
+            int max_prims_in_leaf = 8);
+
+  const vector<KernelLightTreeNode> &get_nodes() const
+  {
+    return nodes;
+  }
+
+  const vector<KernelLightTreeEmitter> &get_emitters() const
+  {
+    return emitters;
+  }
+
+ protected:
+  int recursive_build(int parent_index, int start, int end);
+  bool find_split(int start,
+                  int end,
+                  const BoundBox &bbox,
+                  const BoundBox &centroid_bbox,
+                  int *r_middle);
+
+  vector<LightTreePrimitive> prims;
+  vector<KernelLightTreeNode> nodes;
+  vector<KernelLightTreeEmitter> emitters;
+  int num_infinite;
+  int max_prims_in_leaf;
+};
+
+CCL_NAMESPACE_END
+
+#endif /* __LIGHT_TREE_H__ */
@@ -246,6 +246,10 @@ NODE_DEFINE(ImageTextureNode)
   SOCKET_FLOAT(projection_blend, "Projection Blend", 0.0f);
 
   SOCKET_IN_POINT(vector, "Vector", make_float3(0.0f, 0.0f, 0.0f), SocketType::LINK_TEXTURE_UV);
+  SOCKET_IN_POINT(
+      vector_dx, "VectorDx", make_float3(0.0f, 0.0f, 0.0f), SocketType::SVM_INTERNAL);
+  SOCKET_IN_POINT(
+      vector_dy, "VectorDy", make_float3(0.0f, 0.0f, 0.0f), SocketType::SVM_INTERNAL);
 
   SOCKET_OUT_COLOR(color, "Color");
   SOCKET_OUT_FLOAT(alpha, "Alpha");
@@ -387,6 +391,18 @@ void ImageTextureNode::compile(SVMCompiler &compiler)
     }
   }
 
+  /* Only linked when the graph was refined for the texture cache. */
+  ShaderInput *vector_dx_in = input("VectorDx");
+  ShaderInput *vector_dy_in = input("VectorDy");
+  const bool use_derivatives = (vector_dx_in->link && vector_dy_in->link);
+  int vector_dx_offset = SVM_STACK_INVALID, vector_dy_offset = SVM_STACK_INVALID;
+
+  if (use_derivatives) {
+    vector_dx_offset = tex_mapping.compile_begin(compiler, vector_dx_in);
+    vector_dy_offset = tex_mapping.compile_begin(compiler, vector_dy_in);
+    flags |= NODE_IMAGE_DERIVATIVES;
+  }
+
   if (projection != NODE_IMAGE_PROJ_BOX) {
     /* If there only is one image (a very common case), we encode it as a negative value. */
     int num_nodes;
@@ -405,6 +421,10 @@ void ImageTextureNode::compile(SVMCompiler &compiler)
                                              flags),
                       projection);
 
+    if (use_derivatives) {
+      compiler.add_node(vector_dx_offset, vector_dy_offset);
+    }
+
     if (num_nodes > 0) {
       for (int i = 0; i < num_nodes; i++) {
         int4 node;
@@ -431,8 +451,16 @@ void ImageTextureNode::compile(SVMCompiler &compiler)
                                              compiler.stack_assign_if_linked(alpha_out),
                                              flags),
                       __float_as_int(projection_blend));
+
+    if (use_derivatives) {
+      compiler.add_node(vector_dx_offset, vector_dy_offset);
+    }
   }
 
+  if (use_derivatives) {
+    tex_mapping.compile_end(compiler, vector_dx_in, vector_dx_offset);
+    tex_mapping.compile_end(compiler, vector_dy_in, vector_dy_offset);
+  }
   tex_mapping.compile_end(compiler, vector_in, vector_offset);
 }
 
@@ -117,6 +117,8 @@ class ImageTextureNode : public ImageSlotTextureNode {
   float projection_blend;
   bool animated;
   float3 vector;
+  /* Coordinates at the neighboring pixels, see ShaderGraph::refine_texture_derivatives. */
+  float3 vector_dx, vector_dy;
   ccl::vector<int> tiles;
 
  protected:
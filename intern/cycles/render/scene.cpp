@@ -37,6 +37,7 @@
 #include "util/util_guarded_allocator.h"
 #include "util/util_logging.h"
 #include "util/util_progress.h"
+#include "util/util_texture_cache.h"
 
 CCL_NAMESPACE_BEGIN
 
@@ -73,6 +74,9 @@ DeviceScene::DeviceScene(Device *device)
       lights(device, "__lights", MEM_GLOBAL),
       light_background_marginal_cdf(device, "__light_background_marginal_cdf", MEM_GLOBAL),
       light_background_conditional_cdf(device, "__light_background_conditional_cdf", MEM_GLOBAL),
+      light_tree_nodes(device, "__light_tree_nodes", MEM_GLOBAL),
+      light_tree_emitters(device, "__light_tree_emitters", MEM_GLOBAL),
+      light_tree_map(device, "__light_tree_map", MEM_GLOBAL),
       particles(device, "__particles", MEM_GLOBAL),
       svm_nodes(device, "__svm_nodes", MEM_GLOBAL),
       shaders(device, "__shaders", MEM_GLOBAL),
@@ -108,6 +112,15 @@ Scene::Scene(const SceneParams &params_, Device *device)
   else
     shader_manager = ShaderManager::create(SHADINGSYSTEM_SVM);
 
+  /* Texture cache lookups are only implemented in the CPU kernel, OSL has its own. */
+  if (params.use_texture_cache && device->info.type == DEVICE_CPU &&
+      !shader_manager->use_osl()) {
+    image_manager->set_texture_cache(new TextureCache(
+        (size_t)params.texture_cache_size * 1024 * 1024,
+        params.texture_auto_convert,
+        params.texture_cache_path));
+  }
+
   shader_manager->add_default(this);
 }
 
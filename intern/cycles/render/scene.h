@@ -107,6 +107,9 @@ class DeviceScene {
   device_vector<KernelLight> lights;
   device_vector<float2> light_background_marginal_cdf;
   device_vector<float2> light_background_conditional_cdf;
+  device_vector<KernelLightTreeNode> light_tree_nodes;
+  device_vector<KernelLightTreeEmitter> light_tree_emitters;
+  device_vector<int> light_tree_map;
 
   /* particles */
   device_vector<KernelParticle> particles;
@@ -170,6 +173,22 @@ class SceneParams {
   bool persistent_data;
   int texture_limit;
 
+  /* Tiled and mipmapped image textures loaded on demand, CPU and SVM only. */
+  bool use_texture_cache;
+  /* Texture cache memory limit in megabytes. */
+  int texture_cache_size;
+  /* Convert images to .tx files in the texture cache directory. */
+  bool texture_auto_convert;
+  /* Directory for converted images, user cache directory when empty. */
+  string texture_cache_path;
+
+  /* Store built BVHs on disk and load them for unchanged geometry. */
+  bool use_bvh_cache;
+  /* Directory for cached BVHs, user cache directory when empty. */
+  string bvh_cache_path;
+  /* BVH cache size limit in megabytes, no limit when zero. */
+  int bvh_cache_limit;
+
   bool background;
 
   SceneParams()
@@ -182,6 +201,11 @@ class SceneParams {
     num_bvh_time_steps = 0;
     persistent_data = false;
     texture_limit = 0;
+    use_texture_cache = false;
+    texture_cache_size = 1024;
+    texture_auto_convert = false;
+    use_bvh_cache = false;
+    bvh_cache_limit = 0;
     background = true;
   }
 
@@ -192,7 +216,13 @@ class SceneParams {
              use_bvh_spatial_split == params.use_bvh_spatial_split &&
              use_bvh_unaligned_nodes == params.use_bvh_unaligned_nodes &&
              num_bvh_time_steps == params.num_bvh_time_steps &&
-             persistent_data == params.persistent_data && texture_limit == params.texture_limit);
+             persistent_data == params.persistent_data && texture_limit == params.texture_limit &&
+             use_texture_cache == params.use_texture_cache &&
+             texture_cache_size == params.texture_cache_size &&
+             texture_auto_convert == params.texture_auto_convert &&
+             texture_cache_path == params.texture_cache_path &&
+             use_bvh_cache == params.use_bvh_cache && bvh_cache_path == params.bvh_cache_path &&
+             bvh_cache_limit == params.bvh_cache_limit);
   }
 };
 
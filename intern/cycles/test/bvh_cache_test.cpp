@@ -0,0 +1,311 @@
+/*
+ * Copyright 2011-2020 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "testing/testing.h"
+
+#include <OpenImageIO/filesystem.h>
+
+#include "bvh/bvh.h"
+#include "bvh/bvh_cache.h"
+#include "bvh/bvh_params.h"
+
+#include "render/mesh.h"
+#include "render/object.h"
+
+#include "util/util_path.h"
+#include "util/util_system.h"
+
+CCL_NAMESPACE_BEGIN
+
+static PackedBVH test_pack()
+{
+  PackedBVH pack;
+  pack.root_index = 3;
+  for (int i = 0; i < 5; i++) {
+    pack.nodes.push_back_slow(make_int4(i, i + 1, -i, 7 * i));
+    pack.leaf_nodes.push_back_slow(make_int4(-i, i, 3 * i, 0));
+    pack.prim_tri_verts.push_back_slow(make_float4(0.5f * i, 1.0f, -2.0f * i, 0.0f));
+    pack.prim_type.push_back_slow(PRIMITIVE_TRIANGLE);
+    pack.prim_visibility.push_back_slow(PATH_RAY_ALL_VISIBILITY);
+    pack.prim_index.push_back_slow(i);
+    pack.prim_object.push_back_slow(0);
+    pack.prim_tri_index.push_back_slow(i * 3);
+  }
+  pack.object_node.push_back_slow(0);
+  /* prim_time is left empty, empty arrays are stored too. */
+  return pack;
+}
+
+static void expect_pack_eq(const PackedBVH &a, const PackedBVH &b)
+{
+  EXPECT_EQ(a.root_index, b.root_index);
+  EXPECT_TRUE(a.nodes == b.nodes);
+  EXPECT_TRUE(a.leaf_nodes == b.leaf_nodes);
+  EXPECT_TRUE(a.object_node == b.object_node);
+  EXPECT_TRUE(a.prim_tri_index == b.prim_tri_index);
+  EXPECT_TRUE(a.prim_tri_verts == b.prim_tri_verts);
+  EXPECT_TRUE(a.prim_type == b.prim_type);
+  EXPECT_TRUE(a.prim_visibility == b.prim_visibility);
+  EXPECT_TRUE(a.prim_index == b.prim_index);
+  EXPECT_TRUE(a.prim_object == b.prim_object);
+  EXPECT_TRUE(a.prim_time == b.prim_time);
+}
+
+/* ******** Tests for the file contents ******** */
+
+TEST(bvh_cache_pack, round_trip)
+{
+  const PackedBVH pack = test_pack();
+
+  FILE *f = tmpfile();
+  ASSERT_NE(f, (FILE *)NULL);
+  EXPECT_TRUE(BVHCache::write_pack(f, pack));
+  const size_t file_size = ftell(f);
+  rewind(f);
+
+  PackedBVH pack_read;
+  EXPECT_TRUE(BVHCache::read_pack(f, file_size, pack_read));
+  expect_pack_eq(pack, pack_read);
+
+  /* Array sizes beyond the file size are rejected without allocating them. */
+  rewind(f);
+  EXPECT_FALSE(BVHCache::read_pack(f, 16, pack_read));
+
+  fclose(f);
+}
+
+TEST(bvh_cache_pack, invalid_magic)
+{
+  FILE *f = tmpfile();
+  ASSERT_NE(f, (FILE *)NULL);
+  EXPECT_TRUE(BVHCache::write_pack(f, test_pack()));
+  const size_t file_size = ftell(f);
+  rewind(f);
+  fputc('X', f);
+  rewind(f);
+
+  PackedBVH pack_read;
+  EXPECT_FALSE(BVHCache::read_pack(f, file_size, pack_read));
+
+  fclose(f);
+}
+
+TEST(bvh_cache_pack, truncated)
+{
+  PackedBVH pack = test_pack();
+  pack.prim_time.push_back_slow(make_float2(0.0f, 1.0f));
+
+  FILE *f = tmpfile();
+  ASSERT_NE(f, (FILE *)NULL);
+  EXPECT_TRUE(BVHCache::write_pack(f, pack));
+  const size_t file_size = ftell(f);
+  rewind(f);
+  vector<char> data(file_size);
+  ASSERT_EQ(fread(data.data(), 1, file_size, f), file_size);
+  fclose(f);
+
+  /* Same data without the last element. */
+  const size_t truncated_size = file_size - sizeof(float2);
+  f = tmpfile();
+  ASSERT_NE(f, (FILE *)NULL);
+  fwrite(data.data(), 1, truncated_size, f);
+  rewind(f);
+
+  PackedBVH pack_read;
+  EXPECT_FALSE(BVHCache::read_pack(f, truncated_size, pack_read));
+
+  fclose(f);
+}
+
+/* ******** Tests for the cache directory ******** */
+
+class BVHCacheTest : public testing::Test {
+ protected:
+  string cache_path;
+
+  void SetUp() override
+  {
+    cache_path = path_join(OIIO::Filesystem::temp_directory_path(),
+                           string_printf("cycles_bvh_cache_test_%d", system_self_process_id()));
+  }
+
+  void TearDown() override
+  {
+    std::string error;
+    OIIO::Filesystem::remove_all(cache_path, error);
+  }
+
+  /* Write the BVH, missing it twice first. */
+  void write(BVHCache &cache, const string &key, const PackedBVH &pack)
+  {
+    EXPECT_FALSE(cache.record_miss(key));
+    EXPECT_TRUE(cache.record_miss(key));
+    EXPECT_TRUE(cache.write(key, pack));
+  }
+};
+
+TEST_F(BVHCacheTest, write_missed_before)
+{
+  BVHCache cache(cache_path, 0);
+  const PackedBVH pack = test_pack();
+  PackedBVH pack_read;
+
+  EXPECT_FALSE(cache.read("a", pack_read));
+  EXPECT_FALSE(cache.record_miss("a"));
+  EXPECT_FALSE(cache.read("a", pack_read));
+  EXPECT_TRUE(cache.record_miss("a"));
+  EXPECT_TRUE(cache.write("a", pack));
+
+  EXPECT_TRUE(cache.read("a", pack_read));
+  expect_pack_eq(pack, pack_read);
+
+  /* The miss is forgotten once written. */
+  EXPECT_FALSE(path_exists(path_join(cache_path, "a.miss")));
+}
+
+TEST_F(BVHCacheTest, prune_least_recently_used)
+{
+  const PackedBVH pack = test_pack();
+  const string path_a = path_join(cache_path, "a.bvh");
+  const string path_b = path_join(cache_path, "b.bvh");
+  const string path_c = path_join(cache_path, "c.bvh");
+
+  BVHCache cache(cache_path, 0);
+  write(cache, "a", pack);
+  write(cache, "b", pack);
+  const size_t file_size = path_file_size(path_a);
+
+  /* Modified times are in seconds, make the order explicit. */
+  OIIO::Filesystem::last_write_time(path_a, time(NULL) - 100);
+  OIIO::Filesystem::last_write_time(path_b, time(NULL) - 50);
+
+  /* Reading makes a the most recently used. */
+  PackedBVH pack_read;
+  EXPECT_TRUE(cache.read("a", pack_read));
+
+  BVHCache cache_limited(cache_path, file_size * 2 + file_size / 2);
+  write(cache_limited, "c", pack);
+
+  EXPECT_TRUE(path_exists(path_a));
+  EXPECT_FALSE(path_exists(path_b));
+  EXPECT_TRUE(path_exists(path_c));
+}
+
+TEST_F(BVHCacheTest, prune_keeps_written)
+{
+  BVHCache cache(cache_path, 1);
+  write(cache, "a", test_pack());
+  EXPECT_TRUE(path_exists(path_join(cache_path, "a.bvh")));
+
+  write(cache, "b", test_pack());
+  EXPECT_FALSE(path_exists(path_join(cache_path, "a.bvh")));
+  EXPECT_TRUE(path_exists(path_join(cache_path, "b.bvh")));
+}
+
+/* ******** Tests for the key ******** */
+
+class BVHCacheKeyTest : public testing::Test {
+ protected:
+  Mesh *mesh;
+  Object *object;
+  BVHParams params;
+
+  void SetUp() override
+  {
+    mesh = new Mesh();
+    mesh->reserve_mesh(4, 2);
+    mesh->add_vertex(make_float3(0.0f, 0.0f, 0.0f));
+    mesh->add_vertex(make_float3(1.0f, 0.0f, 0.0f));
+    mesh->add_vertex(make_float3(1.0f, 1.0f, 0.0f));
+    mesh->add_vertex(make_float3(0.0f, 1.0f, 0.5f));
+    mesh->add_triangle(0, 1, 2, 0, false);
+    mesh->add_triangle(0, 2, 3, 0, false);
+
+    object = new Object();
+    object->geometry = mesh;
+    object->tfm = transform_identity();
+    object->bounds = BoundBox(make_float3(0.0f, 0.0f, 0.0f), make_float3(1.0f, 1.0f, 0.5f));
+  }
+
+  void TearDown() override
+  {
+    delete object;
+    delete mesh;
+  }
+
+  string key()
+  {
+    return BVHCache::key(params, vector<Object *>(1, object));
+  }
+};
+
+TEST_F(BVHCacheKeyTest, stable)
+{
+  const string key_a = key();
+  EXPECT_EQ(key_a.size(), (size_t)32);
+  EXPECT_EQ(key_a, key());
+
+  /* Only the used components of positions are hashed. */
+  mesh->verts[1].w = 12.0f;
+  EXPECT_EQ(key_a, key());
+
+  /* Cache settings don't change the BVH. */
+  params.use_cache = true;
+  params.cache_limit = 1024;
+  EXPECT_EQ(key_a, key());
+}
+
+TEST_F(BVHCacheKeyTest, changes)
+{
+  const string key_a = key();
+
+  mesh->verts[1].x = 2.0f;
+  const string key_verts = key();
+  EXPECT_NE(key_a, key_verts);
+
+  mesh->triangles[4] = 3;
+  const string key_triangles = key();
+  EXPECT_NE(key_verts, key_triangles);
+
+  object->tfm = transform_translate(1.0f, 0.0f, 0.0f);
+  const string key_tfm = key();
+  EXPECT_NE(key_triangles, key_tfm);
+
+  params.use_spatial_split = !params.use_spatial_split;
+  EXPECT_NE(key_tfm, key());
+}
+
+TEST_F(BVHCacheKeyTest, instances)
+{
+  /* Instanced geometry is hashed per object. */
+  Object *instance = new Object();
+  instance->geometry = mesh;
+  instance->tfm = transform_translate(0.0f, 0.0f, 2.0f);
+  instance->bounds = object->bounds;
+
+  vector<Object *> objects;
+  objects.push_back(object);
+  objects.push_back(instance);
+  const string key_instances = BVHCache::key(params, objects);
+  EXPECT_NE(key(), key_instances);
+
+  instance->tfm = transform_translate(0.0f, 0.0f, 3.0f);
+  EXPECT_NE(key_instances, BVHCache::key(params, objects));
+
+  delete instance;
+}
+
+CCL_NAMESPACE_END
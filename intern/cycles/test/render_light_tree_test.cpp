@@ -0,0 +1,192 @@
+/*
+ * Copyright 2011-2020 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "testing/testing.h"
+
+#include "render/light_tree.h"
+
+#include "util/util_hash.h"
+#include "util/util_math.h"
+
+/* Kernel functions are evaluated on the CPU. */
+// clang-format off
+#include "kernel/kernel_compat_cpu.h"
+#include "kernel/split/kernel_split_data.h"
+#include "kernel/kernel_globals.h"
+#include "kernel/kernel_light_tree.h"
+// clang-format on
+
+CCL_NAMESPACE_BEGIN
+
+#define NUM_POINTS 200
+#define NUM_SAMPLES 64
+
+static float random_float(uint i, uint seed)
+{
+  return hash_uint2_to_float(i, seed);
+}
+
+static float3 random_float3(uint i, uint seed)
+{
+  return make_float3(
+      random_float(i, seed), random_float(i, seed + 1), random_float(i, seed + 2));
+}
+
+static float3 random_direction(uint i, uint seed)
+{
+  const float z = 1.0f - 2.0f * random_float(i, seed);
+  const float r = safe_sqrtf(1.0f - z * z);
+  const float phi = M_2PI_F * random_float(i, seed + 1);
+  return make_float3(r * cosf(phi), r * sinf(phi), z);
+}
+
+class LightTreeTest : public testing::Test {
+ protected:
+  vector<KernelLightTreeNode> nodes;
+  vector<KernelLightTreeEmitter> emitters;
+  KernelGlobals kg;
+
+  /* Emitters spread over a box around the origin. Directional ones emit in a cone around their
+   * axis, otherwise in all directions. */
+  void build(int num_infinite, int num_local, bool directional)
+  {
+    vector<LightTreePrimitive> infinite_prims(num_infinite);
+    for (int i = 0; i < num_infinite; i++) {
+      infinite_prims[i].energy = 1.0f;
+      infinite_prims[i].distribution_index = i;
+    }
+
+    vector<LightTreePrimitive> local_prims(num_local);
+    for (int i = 0; i < num_local; i++) {
+      LightTreePrimitive &prim = local_prims[i];
+      const float3 center = 20.0f * random_float3(i, 0) - make_float3(10.0f, 10.0f, 10.0f);
+      /* Some emitters are points, like point lights. */
+      const float size = (i % 4 == 0) ? 0.0f : random_float(i, 3);
+      prim.bbox = BoundBox(center - make_float3(size, size, size) * 0.5f,
+                           center + make_float3(size, size, size) * 0.5f);
+      prim.orientation = LightTreeOrientation(random_direction(i, 4),
+                                              directional ? M_PI_F * random_float(i, 6) : M_PI_F,
+                                              M_PI_2_F);
+      prim.energy = 0.1f + random_float(i, 7);
+      prim.distribution_index = num_infinite + i;
+    }
+
+    LightTree tree(infinite_prims, local_prims, 4);
+    nodes = tree.get_nodes();
+    emitters = tree.get_emitters();
+
+    kg.__light_tree_nodes.data = nodes.data();
+    kg.__light_tree_nodes.width = nodes.size();
+    kg.__light_tree_emitters.data = emitters.data();
+    kg.__light_tree_emitters.width = emitters.size();
+    kg.__data.integrator.light_tree_num_infinite = num_infinite;
+    kg.__data.integrator.light_tree_infinite_pdf = (num_infinite > 0) ? 0.5f : 0.0f;
+  }
+
+  static float3 random_point(int i)
+  {
+    return 30.0f * random_float3(i, 100) - make_float3(15.0f, 15.0f, 15.0f);
+  }
+
+  /* The pdf of every sampled emitter equals its pdf evaluated again. */
+  void expect_sample_pdf_match()
+  {
+    int num_sampled = 0;
+
+    for (int i = 0; i < NUM_POINTS; i++) {
+      const float3 P = random_point(i);
+
+      for (int j = 0; j < NUM_SAMPLES; j++) {
+        float randu = (j + random_float(i, 200)) / NUM_SAMPLES;
+        float pdf = 0.0f;
+        const int index = light_tree_sample(&kg, P, &randu, &pdf);
+
+        if (index == -1) {
+          continue;
+        }
+
+        ASSERT_GE(index, 0);
+        ASSERT_LT(index, (int)emitters.size());
+        EXPECT_GT(pdf, 0.0f);
+        EXPECT_GE(randu, 0.0f);
+        EXPECT_LT(randu, 1.0f);
+        EXPECT_NEAR(pdf, light_tree_pdf(&kg, P, index), 1e-4f * pdf)
+            << "emitter " << index << " at point " << i;
+        num_sampled++;
+      }
+    }
+
+    EXPECT_GT(num_sampled, 0);
+  }
+
+  /* Sum of the pdfs of all emitters. */
+  float pdf_sum(const float3 P)
+  {
+    float sum = 0.0f;
+    for (size_t i = 0; i < emitters.size(); i++) {
+      sum += light_tree_pdf(&kg, P, i);
+    }
+    return sum;
+  }
+};
+
+TEST_F(LightTreeTest, sample_pdf_match)
+{
+  build(0, 300, true);
+  expect_sample_pdf_match();
+}
+
+TEST_F(LightTreeTest, sample_pdf_match_infinite)
+{
+  build(3, 300, true);
+  expect_sample_pdf_match();
+
+  /* Infinite emitters are selected uniformly. */
+  float randu = 0.2f;
+  float pdf = 0.0f;
+  EXPECT_EQ(light_tree_sample(&kg, make_float3(0.0f, 0.0f, 0.0f), &randu, &pdf), 1);
+  EXPECT_FLOAT_EQ(pdf, 0.5f / 3.0f);
+  EXPECT_NEAR(randu, 0.2f, 1e-6f);
+}
+
+TEST_F(LightTreeTest, single_emitter)
+{
+  build(0, 1, false);
+  expect_sample_pdf_match();
+  EXPECT_EQ(light_tree_pdf(&kg, random_point(0), -1), 0.0f);
+}
+
+/* Emitters lighting the point in all directions are always selected with some probability. */
+TEST_F(LightTreeTest, pdf_normalized)
+{
+  build(3, 300, false);
+
+  for (int i = 0; i < NUM_POINTS; i++) {
+    EXPECT_NEAR(pdf_sum(random_point(i)), 1.0f, 1e-3f) << "at point " << i;
+  }
+}
+
+/* Directional emitters can't light some points, the pdf of the others doesn't grow. */
+TEST_F(LightTreeTest, pdf_directional_bounded)
+{
+  build(0, 300, true);
+
+  for (int i = 0; i < NUM_POINTS; i++) {
+    EXPECT_LE(pdf_sum(random_point(i)), 1.0f + 1e-3f) << "at point " << i;
+  }
+}
+
+CCL_NAMESPACE_END
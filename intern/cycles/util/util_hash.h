@@ -17,6 +17,7 @@
 #ifndef __UTIL_HASH_H__
 #define __UTIL_HASH_H__
 
+#include "util/util_math.h"
 #include "util/util_types.h"
 
 CCL_NAMESPACE_BEGIN
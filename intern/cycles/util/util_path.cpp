@@ -25,6 +25,7 @@
 OIIO_NAMESPACE_USING
 
 #include <stdio.h>
+#include <time.h>
 
 #include <sys/stat.h>
 
@@ -739,6 +740,11 @@ bool path_remove(const string &path)
   return remove(path.c_str()) == 0;
 }
 
+void path_touch(const string &path)
+{
+  OIIO::Filesystem::last_write_time(path, time(NULL));
+}
+
 struct SourceReplaceState {
   typedef map<string, string> ProcessedMapping;
   /* Base director for all relative include headers. */
@@ -921,6 +927,21 @@ FILE *path_fopen(const string &path, const string &mode)
 #endif
 }
 
+vector<string> path_list_directory(const string &dir)
+{
+  vector<string> paths;
+
+  if (path_exists(dir)) {
+    directory_iterator it(dir), it_end;
+
+    for (; it != it_end; ++it) {
+      paths.push_back(it->path());
+    }
+  }
+
+  return paths;
+}
+
 void path_cache_clear_except(const string &name, const set<string> &except)
 {
   string dir = path_user_get("cache");
@@ -53,6 +53,8 @@ uint64_t path_modified_time(const string &path);
 
 /* directory utility */
 void path_create_directories(const string &path);
+/* Paths of the files and directories in the directory. */
+vector<string> path_list_directory(const string &dir);
 
 /* file read/write utilities */
 FILE *path_fopen(const string &path, const string &mode);
@@ -64,6 +66,8 @@ bool path_read_text(const string &path, string &text);
 
 /* File manipulation. */
 bool path_remove(const string &path);
+/* Set the modified time to the current time. */
+void path_touch(const string &path);
 
 /* source code utility */
 string path_source_replace_includes(const string &source,
@@ -34,6 +34,7 @@ OIIO_NAMESPACE_USING
 #  include <sys/ioctl.h>
 #  include <sys/sysctl.h>
 #  include <sys/types.h>
+#  include <unistd.h>
 #else
 #  include <unistd.h>
 #  include <sys/ioctl.h>
@@ -372,4 +373,13 @@ size_t system_physical_ram()
 #endif
 }
 
+int system_self_process_id()
+{
+#ifdef _WIN32
+  return GetCurrentProcessId();
+#else
+  return getpid();
+#endif
+}
+
 CCL_NAMESPACE_END
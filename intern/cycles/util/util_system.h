@@ -62,6 +62,9 @@ bool system_cpu_support_avx2();
 
 size_t system_physical_ram();
 
+/* Identifier of the current process. */
+int system_self_process_id();
+
 /* Start a new process of the current application with the given arguments. */
 bool system_call_self(const vector<string> &args);
 
@@ -302,6 +302,7 @@ vector<int> distribute_threads_on_nodes(const int num_threads)
       current_node_index = (current_node_index + 1) % num_nodes;
     }
     VLOG(1) << "Scheduling thread " << thread_index << " to node " << current_node_index << ".";
+    thread_nodes[thread_index] = current_node_index;
     ++thread_index;
     current_node_index = (current_node_index + 1) % num_nodes;
   }
@@ -591,6 +592,62 @@ void DedicatedTaskPool::clear()
   num_decrease(done);
 }
 
+/* First Touch */
+
+/* Smaller buffers are not worth the tasks. */
+#define FIRST_TOUCH_MIN_SIZE (8 * 1024 * 1024)
+#define FIRST_TOUCH_CHUNK_SIZE (1024 * 1024)
+
+bool task_first_touch_is_spread(size_t size)
+{
+  return size >= FIRST_TOUCH_MIN_SIZE && TaskScheduler::active() &&
+         TaskScheduler::num_threads() > 1 && system_cpu_num_numa_nodes() > 1;
+}
+
+static void first_touch_memset_chunk(uchar *dst, int value, size_t size)
+{
+  memset(dst, value, size);
+}
+
+static void first_touch_memcpy_chunk(uchar *dst, const uchar *src, size_t size)
+{
+  memcpy(dst, src, size);
+}
+
+void task_first_touch_memset(void *dst, int value, size_t size)
+{
+  if (!task_first_touch_is_spread(size)) {
+    memset(dst, value, size);
+    return;
+  }
+
+  TaskPool pool;
+  for (size_t offset = 0; offset < size; offset += FIRST_TOUCH_CHUNK_SIZE) {
+    pool.push(function_bind(&first_touch_memset_chunk,
+                            (uchar *)dst + offset,
+                            value,
+                            std::min(size - offset, (size_t)FIRST_TOUCH_CHUNK_SIZE)));
+  }
+  pool.wait_work();
+}
+
+void task_first_touch_memcpy(void *dst, const void *src, size_t size)
+{
+  if (!task_first_touch_is_spread(size)) {
+    memcpy(dst, src, size);
+    return;
+  }
+
+  TaskPool pool;
+  for (size_t offset = 0; offset < size; offset += FIRST_TOUCH_CHUNK_SIZE) {
+    pool.push(function_bind(&first_touch_memcpy_chunk,
+                            (uchar *)dst + offset,
+                            (const uchar *)src + offset,
+                            std::min(size - offset, (size_t)FIRST_TOUCH_CHUNK_SIZE)));
+  }
+  pool.wait_work();
+}
+
 string TaskPool::Summary::full_report() const
 {
   string report = "";
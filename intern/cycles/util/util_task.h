@@ -211,6 +211,19 @@ class DedicatedTaskPool {
   thread *worker_thread;
 };
 
+/* First Touch
+ *
+ * Memory pages are placed on the NUMA node of the thread which first writes
+ * them. Large buffers used by all render threads are written from the worker
+ * threads of the scheduler, so their pages are spread over the nodes of the
+ * workers instead of all being placed on the node of one thread. On systems
+ * with a single node, or without running scheduler, these are a plain memset
+ * and memcpy. The destination must not have been written to yet. */
+
+bool task_first_touch_is_spread(size_t size);
+void task_first_touch_memset(void *dst, int value, size_t size);
+void task_first_touch_memcpy(void *dst, const void *src, size_t size);
+
 CCL_NAMESPACE_END
 
 #endif
@@ -99,7 +99,9 @@ typedef struct TextureInfo {
   uint interpolation, extension;
   /* Dimensions. */
   uint width, height, depth;
-  uint pad[3];
+  /* Data is a TextureCacheImage, CPU only. */
+  uint use_texture_cache;
+  uint pad[2];
 } TextureInfo;
 
 CCL_NAMESPACE_END
@@ -0,0 +1,253 @@
+/*
+ * Copyright 2011-2020 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "util/util_texture_cache.h"
+
+#include <cstdio>
+#include <sstream>
+#include <thread>
+
+#include <OpenImageIO/imagebufalgo.h>
+#include <OpenImageIO/texture.h>
+
+#include "util/util_hash.h"
+#include "util/util_logging.h"
+#include "util/util_math.h"
+#include "util/util_path.h"
+#include "util/util_system.h"
+#include "util/util_texture.h"
+
+CCL_NAMESPACE_BEGIN
+
+OIIO_NAMESPACE_USING
+
+/* Tile size used for images which are not tiled, and for converted files. */
+#define TEXTURE_CACHE_TILE_SIZE 64
+
+TextureCache::TextureCache(size_t max_memory, bool auto_convert, const string &cache_path)
+    : auto_convert(auto_convert), cache_path(cache_path)
+{
+  /* Not shared with OSL, which may use different settings. */
+  TextureSystem *ts = TextureSystem::create(false);
+  ts->attribute("max_memory_MB", (float)(max_memory / (1024 * 1024)));
+  ts->attribute("autotile", TEXTURE_CACHE_TILE_SIZE);
+  ts->attribute("automip", 1);
+  ts->attribute("accept_untiled", 1);
+  ts->attribute("accept_unmipped", 1);
+  texture_system = ts;
+
+  if (this->cache_path.empty()) {
+    this->cache_path = path_cache_get("textures");
+  }
+}
+
+TextureCache::~TextureCache()
+{
+  TextureSystem *ts = (TextureSystem *)texture_system;
+  VLOG(2) << "Texture cache statistics:\n" << ts->getstats();
+  TextureSystem::destroy(ts);
+}
+
+string TextureCache::find_tx_file(const string &filepath)
+{
+  if (string_endswith(filepath, ".tx") || string_endswith(filepath, ".TX")) {
+    return filepath;
+  }
+
+  const string filename = path_filename(filepath);
+  const string stem = filename.substr(0, filename.rfind('.'));
+  const uint64_t modified_time = path_modified_time(filepath);
+
+  /* File converted by the user, named like maketx does by default. */
+  string tx_filepath = path_join(path_dirname(filepath), stem + ".tx");
+  if (path_exists(tx_filepath) && path_modified_time(tx_filepath) >= modified_time) {
+    return tx_filepath;
+  }
+
+  if (!auto_convert) {
+    return filepath;
+  }
+
+  /* The hash of the path keeps files with the same name apart. */
+  tx_filepath = path_join(cache_path,
+                          string_printf("%s_%08x.tx", stem.c_str(), hash_string(filepath.c_str())));
+  if (path_exists(tx_filepath) && path_modified_time(tx_filepath) >= modified_time) {
+    return tx_filepath;
+  }
+
+  if (convert_to_tx(filepath, tx_filepath)) {
+    return tx_filepath;
+  }
+
+  return filepath;
+}
+
+bool TextureCache::convert_to_tx(const string &filepath, const string &tx_filepath)
+{
+  VLOG(1) << "Converting " << filepath << " to " << tx_filepath << ".";
+
+  ImageSpec config;
+  config.tile_width = TEXTURE_CACHE_TILE_SIZE;
+  config.tile_height = TEXTURE_CACHE_TILE_SIZE;
+  config.tile_depth = 1;
+  config.attribute("maketx:fileformatname", "tiff");
+  config.attribute("maketx:filtername", "lanczos3");
+
+  /* Write to a temporary file first, images of several slots may be converted at the same time
+   * and other processes may read the cache. */
+  const size_t thread_hash = std::hash<std::thread::id>()(std::this_thread::get_id());
+  const string temp_filepath = string_printf("%s.%d.%llx.tmp",
+                                             tx_filepath.c_str(),
+                                             system_self_process_id(),
+                                             (unsigned long long)thread_hash);
+
+  path_create_directories(tx_filepath);
+
+  std::stringstream log;
+  if (!ImageBufAlgo::make_texture(
+          ImageBufAlgo::MakeTxTexture, filepath, temp_filepath, config, &log)) {
+    VLOG(1) << "Failed to convert " << filepath << ": " << log.str();
+    path_remove(temp_filepath);
+    return false;
+  }
+
+  if (rename(temp_filepath.c_str(), tx_filepath.c_str()) != 0) {
+    path_remove(temp_filepath);
+    /* Converted by another thread or process in the meantime. */
+    return path_exists(tx_filepath);
+  }
+
+  return true;
+}
+
+bool TextureCache::get_image(const string &filepath, TextureCacheImage *r_image)
+{
+  TextureSystem *ts = (TextureSystem *)texture_system;
+  const ustring read_filepath(find_tx_file(filepath));
+
+  TextureSystem::TextureHandle *handle = ts->get_texture_handle(read_filepath);
+  if (handle == NULL || !ts->good(handle)) {
+    VLOG(1) << "Texture cache can't read " << read_filepath.string() << ": " << ts->geterror();
+    return false;
+  }
+
+  int channels = 0;
+  if (!ts->get_texture_info(handle, NULL, 0, ustring("channels"), TypeDesc::INT, &channels) ||
+      channels < 1) {
+    return false;
+  }
+
+  r_image->cache = this;
+  r_image->handle = handle;
+  r_image->read_filepath = read_filepath.c_str();
+  r_image->channels = channels;
+
+  return true;
+}
+
+void TextureCache::invalidate(const TextureCacheImage *image)
+{
+  TextureSystem *ts = (TextureSystem *)texture_system;
+  ts->invalidate(ustring(image->read_filepath));
+}
+
+bool TextureCache::lookup(const TextureCacheImage *image,
+                          float x,
+                          float y,
+                          float dxdx,
+                          float dydx,
+                          float dxdy,
+                          float dydy,
+                          int interpolation,
+                          int extension,
+                          float result[4]) const
+{
+  TextureSystem *ts = (TextureSystem *)texture_system;
+  TextureOpt options;
+
+  switch (extension) {
+    case EXTENSION_REPEAT:
+      options.swrap = options.twrap = TextureOpt::WrapPeriodic;
+      break;
+    case EXTENSION_EXTEND:
+      options.swrap = options.twrap = TextureOpt::WrapClamp;
+      break;
+    default:
+      options.swrap = options.twrap = TextureOpt::WrapBlack;
+      break;
+  }
+
+  switch (interpolation) {
+    case INTERPOLATION_CLOSEST:
+      options.interpmode = TextureOpt::InterpClosest;
+      break;
+    case INTERPOLATION_LINEAR:
+      options.interpmode = TextureOpt::InterpBilinear;
+      break;
+    case INTERPOLATION_CUBIC:
+      options.interpmode = TextureOpt::InterpBicubic;
+      break;
+    default:
+      options.interpmode = TextureOpt::InterpSmartBicubic;
+      break;
+  }
+  options.mipmode = TextureOpt::MipModeTrilinear;
+
+  /* Images have the origin at the top left in OpenImageIO. */
+  const int channels = min(image->channels, 4);
+  float pixel[4];
+  if (!ts->texture((TextureSystem::TextureHandle *)image->handle,
+                   NULL,
+                   options,
+                   x,
+                   1.0f - y,
+                   dxdx,
+                   -dydx,
+                   dxdy,
+                   -dydy,
+                   channels,
+                   pixel)) {
+    ts->geterror();
+    return false;
+  }
+
+  switch (channels) {
+    case 1:
+      result[0] = result[1] = result[2] = pixel[0];
+      result[3] = 1.0f;
+      break;
+    case 2:
+      result[0] = result[1] = result[2] = pixel[0];
+      result[3] = pixel[1];
+      break;
+    case 3:
+      result[0] = pixel[0];
+      result[1] = pixel[1];
+      result[2] = pixel[2];
+      result[3] = 1.0f;
+      break;
+    default:
+      result[0] = pixel[0];
+      result[1] = pixel[1];
+      result[2] = pixel[2];
+      result[3] = pixel[3];
+      break;
+  }
+
+  return true;
+}
+
+CCL_NAMESPACE_END
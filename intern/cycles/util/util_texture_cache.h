@@ -0,0 +1,79 @@
+/*
+ * Copyright 2011-2020 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __UTIL_TEXTURE_CACHE_H__
+#define __UTIL_TEXTURE_CACHE_H__
+
+#include "util/util_string.h"
+#include "util/util_types.h"
+
+CCL_NAMESPACE_BEGIN
+
+class TextureCache;
+
+/* Image read through the texture cache. On the CPU device it is stored in place of the pixels
+ * of the device texture. */
+struct TextureCacheImage {
+  TextureCache *cache;
+  /* OpenImageIO texture handle. */
+  void *handle;
+  /* File the handle reads, interned in the OpenImageIO string table so it stays valid. */
+  const char *read_filepath;
+  int channels;
+};
+
+/* Texture Cache
+ *
+ * Tiled and mipmapped image cache for CPU rendering, using the OpenImageIO texture system.
+ * Tiles are read from the files when first accessed, least recently used tiles are freed when
+ * the cache exceeds its memory limit. Tiled and mipmapped .tx files are read directly. Other
+ * images are either converted to .tx files once, or tiled and mipmapped in memory. */
+class TextureCache {
+ public:
+  TextureCache(size_t max_memory, bool auto_convert, const string &cache_path);
+  ~TextureCache();
+
+  /* Open the image for lookups, false if the file can't be read. */
+  bool get_image(const string &filepath, TextureCacheImage *r_image);
+  /* Free the tiles of the image, without looking up or converting its file again. */
+  void invalidate(const TextureCacheImage *image);
+
+  /* Filtered lookup with the origin at the bottom left. The mipmap level is chosen from the
+   * derivatives of the texture coordinates, zero derivatives use the full resolution. Single
+   * channel and RGB images are expanded to RGBA. */
+  bool lookup(const TextureCacheImage *image,
+              float x,
+              float y,
+              float dxdx,
+              float dydx,
+              float dxdy,
+              float dydy,
+              int interpolation,
+              int extension,
+              float result[4]) const;
+
+ protected:
+  string find_tx_file(const string &filepath);
+  bool convert_to_tx(const string &filepath, const string &tx_filepath);
+
+  void *texture_system;
+  bool auto_convert;
+  string cache_path;
+};
+
+CCL_NAMESPACE_END
+
+#endif /* __UTIL_TEXTURE_CACHE_H__ */
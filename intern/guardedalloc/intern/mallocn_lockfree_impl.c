@@ -25,6 +25,12 @@
 #include <stdarg.h>
 #include <sys/types.h>
 
+#if defined(WIN32)
+#  include <windows.h>
+#else
+#  include <pthread.h>
+#endif
+
 #include "MEM_guardedalloc.h"
 
 /* to ensure strict conversions */
@@ -43,6 +49,8 @@ typedef struct MemHeadAligned {
   size_t len;
 } MemHeadAligned;
 
+/* Counters of threads which don't have a thread cache (see #MemThreadCache),
+ * the totals also include the counters of all thread caches. */
 static unsigned int totblock = 0;
 static size_t mem_in_use = 0, mmap_in_use = 0, peak_mem = 0;
 static bool malloc_debug_memset = false;
@@ -74,6 +82,292 @@ MEM_INLINE void update_maximum(size_t *maximum_value, size_t value)
 #endif
 }
 
+/* -------------------------------------------------------------------- */
+/** \name Thread Caches
+ *
+ * Every thread gets a cache with free lists of small blocks binned by size class, so most small
+ * allocations are served without going to the system allocator. Block and memory counters are
+ * also kept per thread, and only summed over all threads when they are queried, so allocating
+ * doesn't need atomic operations on cache lines shared between threads.
+ *
+ * Caches of threads which exited are kept (their counters are part of the totals) and handed
+ * to new threads. Threads without a cache use the global atomic counters instead.
+ * \{ */
+
+#if defined(_MSC_VER)
+#  define MEM_THREAD_LOCAL __declspec(thread)
+#else
+#  define MEM_THREAD_LOCAL __thread
+#endif
+
+/* Small blocks are allocated with a length rounded up to a multiple of the size class step,
+ * so blocks of the same size class are interchangeable. */
+#define MEM_SIZE_CLASS_SHIFT 4
+#define MEM_NUM_SIZE_CLASSES 32
+#define MEM_SMALL_BLOCK_MAX_LEN ((size_t)MEM_NUM_SIZE_CLASSES << MEM_SIZE_CLASS_SHIFT)
+
+/* Maximum amount of memory kept in the free list of one size class, when it's exceeded half of
+ * the free blocks are given back to the system allocator. */
+#define MEM_SIZE_CLASS_MAX_CACHED (16 * 1024)
+
+/* Amount of memory a thread allocates before the peak memory is updated. */
+#define MEM_PEAK_UPDATE_LEN (256 * 1024)
+
+#define MEM_CACHE_ALIGNMENT 64
+
+typedef struct MemFreeBlock {
+  struct MemFreeBlock *next;
+} MemFreeBlock;
+
+typedef struct MemThreadCache {
+  /* Next cache in #thread_caches, caches are never removed from the list. */
+  struct MemThreadCache *next;
+  /* Non-zero while the cache is owned by a thread. */
+  unsigned int in_use;
+
+  /* Counters of blocks allocated and freed by the owning threads. They wrap around when more is
+   * freed than allocated, which is fine since only their sum over all caches is meaningful. */
+  unsigned int totblock;
+  size_t mem_in_use;
+  size_t mem_since_peak_update;
+
+  MemFreeBlock *free_blocks[MEM_NUM_SIZE_CLASSES];
+  unsigned int num_free_blocks[MEM_NUM_SIZE_CLASSES];
+} MemThreadCache;
+
+static MemThreadCache *thread_caches = NULL;
+
+static MEM_THREAD_LOCAL MemThreadCache *thread_cache = NULL;
+/* Set once the thread cache has been released on thread exit, to avoid creating a new one
+ * for allocations done by other thread exit handlers. */
+static MEM_THREAD_LOCAL bool thread_cache_released = false;
+
+#if defined(WIN32)
+static DWORD thread_cache_key = FLS_OUT_OF_INDEXES;
+static INIT_ONCE thread_cache_key_once = INIT_ONCE_STATIC_INIT;
+#else
+static pthread_key_t thread_cache_key;
+static bool thread_cache_key_valid = false;
+static pthread_once_t thread_cache_key_once = PTHREAD_ONCE_INIT;
+#endif
+
+MEM_INLINE unsigned int mem_size_class(size_t len)
+{
+  return (len != 0) ? (unsigned int)((len - 1) >> MEM_SIZE_CLASS_SHIFT) : 0;
+}
+
+MEM_INLINE size_t mem_size_class_len(unsigned int size_class)
+{
+  return (size_t)(size_class + 1) << MEM_SIZE_CLASS_SHIFT;
+}
+
+static void thread_cache_release(MemThreadCache *cache)
+{
+  for (unsigned int size_class = 0; size_class < MEM_NUM_SIZE_CLASSES; size_class++) {
+    MemFreeBlock *block = cache->free_blocks[size_class];
+    while (block) {
+      MemFreeBlock *next = block->next;
+      free(MEMHEAD_FROM_PTR(block));
+      block = next;
+    }
+    cache->free_blocks[size_class] = NULL;
+    cache->num_free_blocks[size_class] = 0;
+  }
+
+  thread_cache = NULL;
+  thread_cache_released = true;
+
+  /* Counters are kept, the cache is only marked as available for other threads. */
+  atomic_sub_and_fetch_u(&cache->in_use, 1);
+}
+
+#if defined(WIN32)
+static void WINAPI thread_cache_release_cb(void *cache)
+{
+  if (cache) {
+    thread_cache_release((MemThreadCache *)cache);
+  }
+}
+
+static BOOL CALLBACK thread_cache_key_init(PINIT_ONCE UNUSED(once),
+                                           void *UNUSED(param),
+                                           void **UNUSED(context))
+{
+  thread_cache_key = FlsAlloc(thread_cache_release_cb);
+  return TRUE;
+}
+#else
+static void thread_cache_release_cb(void *cache)
+{
+  thread_cache_release((MemThreadCache *)cache);
+}
+
+static void thread_cache_key_init(void)
+{
+  thread_cache_key_valid = (pthread_key_create(&thread_cache_key, thread_cache_release_cb) == 0);
+}
+#endif
+
+static MemThreadCache *thread_cache_create(void)
+{
+  MemThreadCache *cache;
+
+  if (thread_cache_released) {
+    return NULL;
+  }
+
+  /* The cache must be released on thread exit, don't use one if that can't be done. */
+#if defined(WIN32)
+  InitOnceExecuteOnce(&thread_cache_key_once, thread_cache_key_init, NULL, NULL);
+  if (thread_cache_key == FLS_OUT_OF_INDEXES) {
+    return NULL;
+  }
+#else
+  pthread_once(&thread_cache_key_once, thread_cache_key_init);
+  if (!thread_cache_key_valid) {
+    return NULL;
+  }
+#endif
+
+  /* Reuse the cache of a thread that exited. */
+  for (cache = thread_caches; cache; cache = cache->next) {
+    if (cache->in_use == 0 && atomic_cas_u(&cache->in_use, 0, 1) == 0) {
+      break;
+    }
+  }
+
+  if (cache == NULL) {
+    /* Aligned to avoid false sharing of counters between threads. */
+    cache = (MemThreadCache *)aligned_malloc(sizeof(MemThreadCache), MEM_CACHE_ALIGNMENT);
+    if (cache == NULL) {
+      return NULL;
+    }
+    memset(cache, 0, sizeof(MemThreadCache));
+    cache->in_use = 1;
+
+    MemThreadCache *first;
+    do {
+      first = thread_caches;
+      cache->next = first;
+    } while (atomic_cas_ptr((void **)&thread_caches, first, cache) != first);
+  }
+
+#if defined(WIN32)
+  FlsSetValue(thread_cache_key, cache);
+#else
+  pthread_setspecific(thread_cache_key, cache);
+#endif
+
+  thread_cache = cache;
+  return cache;
+}
+
+MEM_INLINE MemThreadCache *thread_cache_get(void)
+{
+  MemThreadCache *cache = thread_cache;
+  if (LIKELY(cache)) {
+    return cache;
+  }
+  return thread_cache_create();
+}
+
+/* Totals of the counters over all threads. */
+static void mem_counters_get(unsigned int *r_totblock, size_t *r_mem_in_use)
+{
+  unsigned int blocks = totblock;
+  size_t mem = mem_in_use;
+  for (MemThreadCache *cache = thread_caches; cache; cache = cache->next) {
+    blocks += cache->totblock;
+    mem += cache->mem_in_use;
+  }
+  if (r_totblock) {
+    *r_totblock = blocks;
+  }
+  if (r_mem_in_use) {
+    *r_mem_in_use = mem;
+  }
+}
+
+static size_t mem_in_use_get(void)
+{
+  size_t mem;
+  mem_counters_get(NULL, &mem);
+  return mem;
+}
+
+MEM_INLINE void mem_counters_add(MemThreadCache *cache, size_t len)
+{
+  if (LIKELY(cache)) {
+    cache->totblock++;
+    cache->mem_in_use += len;
+    cache->mem_since_peak_update += len;
+    if (UNLIKELY(cache->mem_since_peak_update >= MEM_PEAK_UPDATE_LEN)) {
+      cache->mem_since_peak_update = 0;
+      update_maximum(&peak_mem, mem_in_use_get());
+    }
+  }
+  else {
+    atomic_add_and_fetch_u(&totblock, 1);
+    atomic_add_and_fetch_z(&mem_in_use, len);
+    update_maximum(&peak_mem, mem_in_use_get());
+  }
+}
+
+MEM_INLINE void mem_counters_sub(MemThreadCache *cache, size_t len)
+{
+  if (LIKELY(cache)) {
+    cache->totblock--;
+    cache->mem_in_use -= len;
+  }
+  else {
+    atomic_sub_and_fetch_u(&totblock, 1);
+    atomic_sub_and_fetch_z(&mem_in_use, len);
+  }
+}
+
+/* Allocate a block of at most #MEM_SMALL_BLOCK_MAX_LEN bytes, without initializing its head. */
+MEM_INLINE MemHead *mem_small_block_alloc(MemThreadCache *cache, size_t len)
+{
+  const unsigned int size_class = mem_size_class(len);
+  if (cache) {
+    MemFreeBlock *block = cache->free_blocks[size_class];
+    if (block) {
+      cache->free_blocks[size_class] = block->next;
+      cache->num_free_blocks[size_class]--;
+      return MEMHEAD_FROM_PTR(block);
+    }
+  }
+  return (MemHead *)malloc(mem_size_class_len(size_class) + sizeof(MemHead));
+}
+
+MEM_INLINE void mem_small_block_free(MemThreadCache *cache, MemHead *memh, size_t len)
+{
+  if (cache == NULL) {
+    free(memh);
+    return;
+  }
+
+  const unsigned int size_class = mem_size_class(len);
+  const unsigned int max_blocks = (unsigned int)(MEM_SIZE_CLASS_MAX_CACHED /
+                                                 (mem_size_class_len(size_class) +
+                                                  sizeof(MemHead)));
+  if (UNLIKELY(cache->num_free_blocks[size_class] >= max_blocks)) {
+    while (cache->num_free_blocks[size_class] > max_blocks / 2) {
+      MemFreeBlock *block = cache->free_blocks[size_class];
+      cache->free_blocks[size_class] = block->next;
+      cache->num_free_blocks[size_class]--;
+      free(MEMHEAD_FROM_PTR(block));
+    }
+  }
+
+  MemFreeBlock *block = (MemFreeBlock *)PTR_FROM_MEMHEAD(memh);
+  block->next = cache->free_blocks[size_class];
+  cache->free_blocks[size_class] = block;
+  cache->num_free_blocks[size_class]++;
+}
+
+/** \} */
+
 #ifdef __GNUC__
 __attribute__((format(printf, 1, 2)))
 #endif
@@ -130,8 +424,8 @@ void MEM_lockfree_freeN(void *vmemh)
     return;
   }
 
-  atomic_sub_and_fetch_u(&totblock, 1);
-  atomic_sub_and_fetch_z(&mem_in_use, len);
+  MemThreadCache *cache = thread_cache_get();
+  mem_counters_sub(cache, len);
 
   if (MEMHEAD_IS_MMAP(memh)) {
     atomic_sub_and_fetch_z(&mmap_in_use, len);
@@ -153,6 +447,9 @@ void MEM_lockfree_freeN(void *vmemh)
       MemHeadAligned *memh_aligned = MEMHEAD_ALIGNED_FROM_PTR(vmemh);
       aligned_free(MEMHEAD_REAL_PTR(memh_aligned));
     }
+    else if (len <= MEM_SMALL_BLOCK_MAX_LEN) {
+      mem_small_block_free(cache, memh, len);
+    }
     else {
       free(memh);
     }
@@ -260,24 +557,31 @@ void *MEM_lockfree_recallocN_id(void *vmemh, size_t len, const char *str)
 
 void *MEM_lockfree_callocN(size_t len, const char *str)
 {
+  MemThreadCache *cache = thread_cache_get();
   MemHead *memh;
 
   len = SIZET_ALIGN_4(len);
 
-  memh = (MemHead *)calloc(1, len + sizeof(MemHead));
+  if (len <= MEM_SMALL_BLOCK_MAX_LEN) {
+    memh = mem_small_block_alloc(cache, len);
+    if (LIKELY(memh)) {
+      memset(memh + 1, 0, len);
+    }
+  }
+  else {
+    memh = (MemHead *)calloc(1, len + sizeof(MemHead));
+  }
 
   if (LIKELY(memh)) {
     memh->len = len;
-    atomic_add_and_fetch_u(&totblock, 1);
-    atomic_add_and_fetch_z(&mem_in_use, len);
-    update_maximum(&peak_mem, mem_in_use);
+    mem_counters_add(cache, len);
 
     return PTR_FROM_MEMHEAD(memh);
   }
   print_error("Calloc returns null: len=" SIZET_FORMAT " in %s, total %u\n",
               SIZET_ARG(len),
               str,
-              (unsigned int)mem_in_use);
+              (unsigned int)mem_in_use_get());
   return NULL;
 }
 
@@ -291,7 +595,7 @@ void *MEM_lockfree_calloc_arrayN(size_t len, size_t size, const char *str)
         SIZET_ARG(len),
         SIZET_ARG(size),
         str,
-        (unsigned int)mem_in_use);
+        (unsigned int)mem_in_use_get());
     abort();
     return NULL;
   }
@@ -301,11 +605,17 @@ void *MEM_lockfree_calloc_arrayN(size_t len, size_t size, const char *str)
 
 void *MEM_lockfree_mallocN(size_t len, const char *str)
 {
+  MemThreadCache *cache = thread_cache_get();
   MemHead *memh;
 
   len = SIZET_ALIGN_4(len);
 
-  memh = (MemHead *)malloc(len + sizeof(MemHead));
+  if (len <= MEM_SMALL_BLOCK_MAX_LEN) {
+    memh = mem_small_block_alloc(cache, len);
+  }
+  else {
+    memh = (MemHead *)malloc(len + sizeof(MemHead));
+  }
 
   if (LIKELY(memh)) {
     if (UNLIKELY(malloc_debug_memset && len)) {
@@ -313,16 +623,14 @@ void *MEM_lockfree_mallocN(size_t len, const char *str)
     }
 
     memh->len = len;
-    atomic_add_and_fetch_u(&totblock, 1);
-    atomic_add_and_fetch_z(&mem_in_use, len);
-    update_maximum(&peak_mem, mem_in_use);
+    mem_counters_add(cache, len);
 
     return PTR_FROM_MEMHEAD(memh);
   }
   print_error("Malloc returns null: len=" SIZET_FORMAT " in %s, total %u\n",
               SIZET_ARG(len),
               str,
-              (unsigned int)mem_in_use);
+              (unsigned int)mem_in_use_get());
   return NULL;
 }
 
@@ -336,7 +644,7 @@ void *MEM_lockfree_malloc_arrayN(size_t len, size_t size, const char *str)
         SIZET_ARG(len),
         SIZET_ARG(size),
         str,
-        (unsigned int)mem_in_use);
+        (unsigned int)mem_in_use_get());
     abort();
     return NULL;
   }
@@ -384,16 +692,14 @@ void *MEM_lockfree_mallocN_aligned(size_t len, size_t alignment, const char *str
 
     memh->len = len | (size_t)MEMHEAD_ALIGN_FLAG;
     memh->alignment = (short)alignment;
-    atomic_add_and_fetch_u(&totblock, 1);
-    atomic_add_and_fetch_z(&mem_in_use, len);
-    update_maximum(&peak_mem, mem_in_use);
+    mem_counters_add(thread_cache_get(), len);
 
     return PTR_FROM_MEMHEAD(memh);
   }
   print_error("Malloc returns null: len=" SIZET_FORMAT " in %s, total %u\n",
               SIZET_ARG(len),
               str,
-              (unsigned int)mem_in_use);
+              (unsigned int)mem_in_use_get());
   return NULL;
 }
 
@@ -420,11 +726,9 @@ void *MEM_lockfree_mapallocN(size_t len, const char *str)
 
   if (memh != (MemHead *)-1) {
     memh->len = len | (size_t)MEMHEAD_MMAP_FLAG;
-    atomic_add_and_fetch_u(&totblock, 1);
-    atomic_add_and_fetch_z(&mem_in_use, len);
+    mem_counters_add(thread_cache_get(), len);
     atomic_add_and_fetch_z(&mmap_in_use, len);
 
-    update_maximum(&peak_mem, mem_in_use);
     update_maximum(&peak_mem, mmap_in_use);
 
     return PTR_FROM_MEMHEAD(memh);
@@ -454,8 +758,10 @@ void MEM_lockfree_callbackmemlist(void (*func)(void *))
 
 void MEM_lockfree_printmemlist_stats(void)
 {
-  printf("\ntotal memory len: %.3f MB\n", (double)mem_in_use / (double)(1024 * 1024));
-  printf("peak memory len: %.3f MB\n", (double)peak_mem / (double)(1024 * 1024));
+  printf("\ntotal memory len: %.3f MB\n",
+         (double)MEM_lockfree_get_memory_in_use() / (double)(1024 * 1024));
+  printf("peak memory len: %.3f MB\n",
+         (double)MEM_lockfree_get_peak_memory() / (double)(1024 * 1024));
   printf(
       "\nFor more detailed per-block statistics run Blender with memory debugging command line "
       "argument.\n");
@@ -489,7 +795,7 @@ void MEM_lockfree_set_memory_debug(void)
 
 size_t MEM_lockfree_get_memory_in_use(void)
 {
-  return mem_in_use;
+  return mem_in_use_get();
 }
 
 size_t MEM_lockfree_get_mapped_memory_in_use(void)
@@ -499,17 +805,21 @@ size_t MEM_lockfree_get_mapped_memory_in_use(void)
 
 unsigned int MEM_lockfree_get_memory_blocks_in_use(void)
 {
-  return totblock;
+  unsigned int blocks;
+  mem_counters_get(&blocks, NULL);
+  return blocks;
 }
 
 /* dummy */
 void MEM_lockfree_reset_peak_memory(void)
 {
-  peak_mem = mem_in_use;
+  peak_mem = mem_in_use_get();
 }
 
 size_t MEM_lockfree_get_peak_memory(void)
 {
+  /* Threads only update the peak memory every #MEM_PEAK_UPDATE_LEN bytes. */
+  update_maximum(&peak_mem, mem_in_use_get());
   return peak_mem;
 }
 
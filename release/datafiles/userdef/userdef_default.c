@@ -128,6 +128,7 @@ const UserDef U_default = {
 
     /** Clamped by half the systems memory. */
     .memcachelimit = 4096,
+    .compositor_cache_limit = 1024,
 
     .prefetchframes = 0,
     .pad_rot_angle = 15,
@@ -192,6 +193,10 @@ const UserDef U_default = {
     .filebrowser_display_type = USER_TEMP_SPACE_DISPLAY_WINDOW,
     .viewport_aa = 8,
 
+    .sequencer_disk_cache_dir = "",
+    .sequencer_disk_cache_size_limit = 100,
+    .sequencer_disk_cache_compression = USER_SEQ_DISK_CACHE_COMPRESSION_LOW,
+
     .walk_navigation =
         {
             .mouse_speed = 1,
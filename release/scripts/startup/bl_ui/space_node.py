@@ -638,6 +638,12 @@ class NODE_PT_quality(bpy.types.Panel):
 
         col = layout.column()
         col.prop(tree, "use_opencl")
+        col.prop(tree, "use_full_frame")
+        sub = col.column()
+        sub.active = tree.use_full_frame
+        sub.prop(tree, "memory_limit")
+        sub.prop(tree, "precision")
+        col.prop(tree, "use_buffer_cache")
         col.prop(tree, "use_groupnode_buffer")
         col.prop(tree, "use_two_pass")
         col.prop(tree, "use_viewer_border")
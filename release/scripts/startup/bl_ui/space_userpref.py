@@ -617,6 +617,9 @@ class USERPREF_PT_system_memory(SystemPanel, CenterAlignMixIn, Panel):
         flow = layout.grid_flow(row_major=False, columns=0, even_columns=True, even_rows=False, align=False)
 
         flow.prop(system, "memory_cache_limit", text="Sequencer Cache Limit")
+        flow.prop(system, "compositor_cache_limit", text="Compositor Cache Limit")
+        flow.prop(system, "sequencer_disk_cache_size_limit", text="Sequencer Disk Cache Limit")
+        flow.prop(system, "sequencer_disk_cache_compression", text="Disk Cache Compression")
         flow.prop(system, "scrollback", text="Console Scrollback Lines")
 
         layout.separator()
@@ -1219,6 +1222,7 @@ class USERPREF_PT_file_paths_render(FilePathsPanel, Panel):
         col = self.layout.column()
         col.prop(paths, "render_output_directory", text="Render Output")
         col.prop(paths, "render_cache_directory", text="Render Cache")
+        col.prop(paths, "sequencer_disk_cache_directory", text="Sequencer Disk Cache")
 
 
 class USERPREF_PT_file_paths_applications(FilePathsPanel, Panel):
@@ -184,6 +184,8 @@ enum {
   /** On write, restore paths after editing them (G_FILE_RELATIVE_REMAP) */
   G_FILE_SAVE_COPY = (1 << 27),
   /* #define G_FILE_GLSL_NO_ENV_LIGHTING (1 << 28) */ /* deprecated */
+  /** On write, use Zstandard instead of zlib when #G_FILE_COMPRESS is set. */
+  G_FILE_COMPRESS_ZSTD = (1 << 29),
 };
 
 /** Don't overwrite these flags when reading a file. */
@@ -100,6 +100,12 @@ typedef struct Main {
    */
   char is_memfile_undo_flush_needed;
 
+  /**
+   * #MemFile.serial of the last memfile undo step written from or read into this main, 0 when
+   * there is none. IDs untouched since (see #ID.recalc_after_undo_push) match their data in it.
+   */
+  unsigned int memfile_undo_serial;
+
   BlendThumbnail *blen_thumb;
 
   struct Library *curlib;
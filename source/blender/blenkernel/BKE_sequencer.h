@@ -88,6 +88,7 @@ void BKE_sequence_iterator_end(SeqIterator *iter);
 
 typedef enum eSeqTaskId {
   SEQ_TASK_MAIN_RENDER,
+  /* Prefetch workers use consecutive IDs starting with this one. */
   SEQ_TASK_PREFETCH_RENDER,
 } eSeqTaskId;
 
@@ -330,6 +331,8 @@ void BKE_sequencer_cache_free_temp_cache(struct Scene *scene, short id, int cfra
 void BKE_sequencer_cache_destruct(struct Scene *scene);
 void BKE_sequencer_cache_cleanup_all(struct Main *bmain);
 void BKE_sequencer_cache_cleanup(struct Scene *scene);
+void BKE_sequencer_cache_cleanup_disk(struct Scene *scene);
+void BKE_sequencer_cache_disk_flush(struct Scene *scene);
 void BKE_sequencer_cache_cleanup_sequence(struct Scene *scene,
                                           struct Sequence *seq,
                                           struct Sequence *seq_changed,
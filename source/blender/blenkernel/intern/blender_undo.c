@@ -61,7 +61,13 @@
 
 #define UNDO_DISK 0
 
-bool BKE_memfile_undo_decode(MemFileUndoData *mfu, bContext *C)
+/**
+ * \param mfu_reference: Undo data last written from or read into the current main, or NULL.
+ * Untouched data-blocks sharing their data with it are kept instead of being read again.
+ */
+bool BKE_memfile_undo_decode(MemFileUndoData *mfu,
+                             const MemFileUndoData *mfu_reference,
+                             bContext *C)
 {
   Main *bmain = CTX_data_main(C);
   char mainstr[sizeof(bmain->name)];
@@ -76,8 +82,11 @@ bool BKE_memfile_undo_decode(MemFileUndoData *mfu, bContext *C)
     success = BKE_blendfile_read(C, mfu->filename, &(const struct BlendFileReadParams){0}, NULL);
   }
   else {
-    success = BKE_blendfile_read_from_memfile(
-        C, &mfu->memfile, &(const struct BlendFileReadParams){0}, NULL);
+    success = BKE_blendfile_read_from_memfile(C,
+                                              &mfu->memfile,
+                                              mfu_reference ? &mfu_reference->memfile : NULL,
+                                              &(const struct BlendFileReadParams){0},
+                                              NULL);
   }
 
   /* Restore, bmain has been re-allocated. */
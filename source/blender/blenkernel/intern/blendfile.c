@@ -467,14 +467,19 @@ bool BKE_blendfile_read_from_memory(bContext *C,
 /* memfile is the undo buffer */
 bool BKE_blendfile_read_from_memfile(bContext *C,
                                      struct MemFile *memfile,
+                                     const struct MemFile *reference_memfile,
                                      const struct BlendFileReadParams *params,
                                      ReportList *reports)
 {
   Main *bmain = CTX_data_main(C);
   BlendFileData *bfd;
 
-  bfd = BLO_read_from_memfile(
-      bmain, BKE_main_blendfile_path(bmain), memfile, params->skip_flags, reports);
+  bfd = BLO_read_from_memfile(bmain,
+                              BKE_main_blendfile_path(bmain),
+                              memfile,
+                              reference_memfile,
+                              params->skip_flags,
+                              reports);
   if (bfd) {
     /* remove the unused screens and wm */
     while (bfd->main->wm.first) {
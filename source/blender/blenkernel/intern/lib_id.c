@@ -1104,6 +1104,36 @@ void BKE_lib_libblock_session_uuid_ensure(ID *id)
   }
 }
 
+/* ********** ID changes since the last memfile undo push. ********** */
+
+/**
+ * Accumulate changes made to \a id since the last memfile undo push, see
+ * #ID.recalc_after_undo_push. Called for dependency graph tagging of user edits, and for edits
+ * which don't tag the dependency graph (RNA and Python property assignment).
+ *
+ * Sculpt and paint modes modify object data in place while only tagging the object, so anything
+ * beyond a transform or selection change of an object is also considered to modify its data.
+ */
+void BKE_lib_id_tag_undo_push(ID *id, const int flag)
+{
+  id->recalc_after_undo_push |= flag;
+  if (GS(id->name) != ID_OB) {
+    return;
+  }
+  if ((flag & ~(ID_RECALC_TRANSFORM | ID_RECALC_SELECT | ID_RECALC_BASE_FLAGS)) == 0) {
+    return;
+  }
+  Object *object = (Object *)id;
+  if (object->data != NULL) {
+    ID *object_data = (ID *)object->data;
+    object_data->recalc_after_undo_push |= flag;
+  }
+  Key *key = BKE_key_from_object(object);
+  if (key != NULL) {
+    key->id.recalc_after_undo_push |= flag;
+  }
+}
+
 /**
  * Generic helper to create a new empty data-block of given type in given \a bmain database.
  *
@@ -2111,6 +2141,7 @@ void BKE_libblock_rename(Main *bmain, ID *id, const char *name)
   if (BKE_id_new_name_validate(lb, id, name)) {
     bmain->is_memfile_undo_written = false;
   }
+  BKE_lib_id_tag_undo_push(id, ID_RECALC_COPY_ON_WRITE);
 }
 
 /**
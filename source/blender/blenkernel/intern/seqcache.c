@@ -21,13 +21,18 @@
  */
 
 #include <stddef.h>
+#include <stdio.h>
 #include <memory.h>
+#include <time.h>
+#include <zlib.h>
 
 #include "MEM_guardedalloc.h"
 
 #include "DNA_sequence_types.h"
 #include "DNA_scene_types.h"
+#include "DNA_userdef_types.h"
 
+#include "IMB_colormanagement.h"
 #include "IMB_imbuf.h"
 #include "IMB_imbuf_types.h"
 
@@ -35,7 +40,12 @@
 #include "BLI_threads.h"
 #include "BLI_listbase.h"
 #include "BLI_ghash.h"
+#include "BLI_fileops.h"
+#include "BLI_fileops_types.h"
+#include "BLI_path_util.h"
+#include "BLI_string.h"
 
+#include "BKE_appdir.h"
 #include "BKE_sequencer.h"
 #include "BKE_scene.h"
 #include "BKE_main.h"
@@ -63,8 +73,70 @@
  * entries one by one in reverse order to their creation.
  *
  * User can exclude caching of some images. Such entries will have is_temp_cache set.
+ *
+ * Disk cache:
+ * When enabled, permanent entries are also written to disk, and entries missing in memory are
+ * read from disk before rendering them. Files are stored per blend file, scene and strip in the
+ * sequencer disk cache directory, and named after the key. Each scene directory holds a version
+ * file matching #Editing.disk_cache_timestamp, which is changed whenever cached images are
+ * invalidated. Opening a blend file which was not saved after an invalidation finds a version
+ * mismatch, and the scene directory is cleared instead of showing outdated images.
+ *
+ * Strips rendering scenes are never cached on disk, as changes to the scene don't invalidate
+ * the cache.
+ *
+ * Files are written by a thread of the disk cache, so rendering doesn't wait for compression
+ * and disk access. Images waiting to be written are referenced by the queue and served from
+ * there when read. Writes queued before an invalidation are discarded.
  */
 
+typedef struct DiskCacheFile {
+  struct DiskCacheFile *next, *prev;
+  char path[FILE_MAX];
+  /** Name of the strip directory. */
+  char seq_dir[FILE_MAXFILE];
+  int type;
+  float nfra;
+  size_t size;
+  int64_t mtime;
+} DiskCacheFile;
+
+/* Images which are written to disk, rendering waits for the queue to get shorter before
+ * adding more. */
+#define DCACHE_WRITES_MAX 16
+
+typedef struct DiskCacheWrite {
+  struct DiskCacheWrite *next, *prev;
+  char path[FILE_MAX];
+  /** #SeqDiskCache.timestamp when the image was queued. */
+  int64_t timestamp;
+  ImBuf *ibuf;
+  float cost;
+} DiskCacheWrite;
+
+typedef struct SeqDiskCache {
+  ThreadMutex mutex;
+  /** Directory of the scene, empty until files are scanned. */
+  char dir[FILE_MAX];
+  /** #Editing.disk_cache_timestamp the files were written for. */
+  int64_t timestamp;
+  /** All files in the directory, oldest first. */
+  ListBase files;
+  size_t size_total;
+
+  /** Images waiting to be written, oldest first. */
+  ListBase writes;
+  int num_writes;
+  /** An image was taken from the queue and is being written. */
+  bool is_writing;
+  bool stop_writing;
+  ListBase write_thread;
+  /** Notified when images are queued, or the thread must stop. */
+  ThreadCondition write_cond;
+  /** Notified when an image was written. */
+  ThreadCondition write_done_cond;
+} SeqDiskCache;
+
 typedef struct SeqCache {
   struct GHash *hash;
   ThreadMutex iterator_mutex;
@@ -72,6 +144,7 @@ typedef struct SeqCache {
   struct BLI_mempool *items_pool;
   struct SeqCacheKey *last_key;
   size_t memory_used;
+  SeqDiskCache *disk_cache;
 } SeqCache;
 
 typedef struct SeqCacheItem {
@@ -442,11 +515,756 @@ static void BKE_sequencer_cache_create(Scene *scene)
     cache->hash = BLI_ghash_new(seq_cache_hashhash, seq_cache_hashcmp, "SeqCache hash");
     cache->last_key = NULL;
     BLI_mutex_init(&cache->iterator_mutex);
+    cache->disk_cache = MEM_callocN(sizeof(SeqDiskCache), "SeqDiskCache");
+    BLI_mutex_init(&cache->disk_cache->mutex);
+    BLI_condition_init(&cache->disk_cache->write_cond);
+    BLI_condition_init(&cache->disk_cache->write_done_cond);
     scene->ed->cache = cache;
   }
   BLI_mutex_unlock(&cache_create_lock);
 }
 
+/* ***************************** Disk cache ****************************** */
+
+#define DCACHE_FILE_EXTENSION ".dcf"
+#define DCACHE_VERSION_FILE "version"
+#define DCACHE_MAGIC "BSDC"
+#define DCACHE_FORMAT_VERSION 1
+
+enum {
+  DCACHE_HAS_RECT = (1 << 0),
+  DCACHE_HAS_RECT_FLOAT = (1 << 1),
+};
+
+typedef struct DiskCacheHeader {
+  char magic[4];
+  int version;
+  int x, y;
+  int planes, channels;
+  int flag;
+  int alpha_flags;
+  float cost;
+  char rect_colorspace[64];
+  char float_colorspace[64];
+} DiskCacheHeader;
+
+typedef struct DiskCacheBufferHeader {
+  uint64_t size;
+  uint64_t size_compressed;
+} DiskCacheBufferHeader;
+
+static bool seq_disk_cache_is_enabled(Scene *scene)
+{
+  return (scene->ed->cache_flag & SEQ_CACHE_DISK_CACHE_ENABLE) &&
+         BKE_main_blendfile_path_from_global()[0] != '\0';
+}
+
+static size_t seq_disk_cache_get_size_limit(void)
+{
+  return ((size_t)U.sequencer_disk_cache_size_limit) * 1024 * 1024 * 1024;
+}
+
+/* Images of scene strips can't be kept between sessions, changes to the scene don't invalidate
+ * them. Neither can anything composited from them. */
+static bool seq_disk_cache_frame_uses_scene(ListBase *seqbase, int cfra)
+{
+  for (Sequence *seq = seqbase->first; seq; seq = seq->next) {
+    if (cfra < seq->startdisp || cfra >= seq->enddisp) {
+      continue;
+    }
+    if (seq->type == SEQ_TYPE_SCENE) {
+      return true;
+    }
+    if (seq->type == SEQ_TYPE_META && seq_disk_cache_frame_uses_scene(&seq->seqbase, cfra)) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+static int64_t seq_disk_cache_new_timestamp(int64_t timestamp)
+{
+  return MAX2((int64_t)time(NULL), timestamp + 1);
+}
+
+/* Directory names are made safe for the file system, the hash of the original name keeps them
+ * unique. */
+static void seq_disk_cache_dir_name(char *r_name, const char *name)
+{
+  char safe_name[FILE_MAXFILE - 16];
+
+  BLI_strncpy(safe_name, name, sizeof(safe_name));
+  BLI_filename_make_safe(safe_name);
+  BLI_snprintf(r_name, FILE_MAXFILE, "%s-%08x", safe_name, BLI_ghashutil_strhash_p(name));
+}
+
+static void seq_disk_cache_get_scene_dir(Scene *scene, char *r_dir)
+{
+  char project_name[FILE_MAXFILE], project_dir[FILE_MAXFILE], scene_dir[FILE_MAXFILE];
+  const char *blendfile_path = BKE_main_blendfile_path_from_global();
+  const char *base_dir = U.sequencer_disk_cache_dir;
+
+  if (base_dir[0] == '\0') {
+    base_dir = BKE_tempdir_base();
+  }
+
+  /* The hash of the path keeps directories of blend files with the same name apart. */
+  BLI_split_file_part(blendfile_path, project_name, sizeof(project_name));
+  BLI_path_extension_replace(project_name, sizeof(project_name), "");
+  BLI_snprintf(project_dir,
+               sizeof(project_dir),
+               "%s-%08x_seq_cache",
+               project_name,
+               BLI_ghashutil_strhash_p(blendfile_path));
+  BLI_filename_make_safe(project_dir);
+  seq_disk_cache_dir_name(scene_dir, scene->id.name + 2);
+
+  BLI_path_join(r_dir, FILE_MAX, base_dir, project_dir, scene_dir, NULL);
+}
+
+static void seq_disk_cache_get_file_path(SeqDiskCache *disk_cache,
+                                         const SeqRenderData *context,
+                                         Sequence *seq,
+                                         float nfra,
+                                         int type,
+                                         char *r_path)
+{
+  char seq_dir[FILE_MAXFILE], filename[FILE_MAXFILE];
+
+  seq_disk_cache_dir_name(seq_dir, seq->name + 2);
+  BLI_snprintf(filename,
+               sizeof(filename),
+               "%d-%dx%d-%d-%d-%d-%d-%.2f" DCACHE_FILE_EXTENSION,
+               type,
+               context->rectx,
+               context->recty,
+               context->preview_render_size,
+               context->scene->r.views_format * 2 + context->view_id,
+               context->motion_blur_samples,
+               (int)(context->motion_blur_shutter * 100.0f),
+               nfra);
+  BLI_path_join(r_path, FILE_MAX, disk_cache->dir, seq_dir, filename, NULL);
+}
+
+static DiskCacheFile *seq_disk_cache_file_add(SeqDiskCache *disk_cache,
+                                              const char *path,
+                                              size_t size,
+                                              int64_t mtime)
+{
+  char seq_dir[FILE_MAX], filename[FILE_MAXFILE];
+  int type;
+  float nfra;
+
+  BLI_split_dirfile(path, seq_dir, filename, sizeof(seq_dir), sizeof(filename));
+  BLI_del_slash(seq_dir);
+
+  if (sscanf(filename, "%d-%*dx%*d-%*d-%*d-%*d-%*d-%f" DCACHE_FILE_EXTENSION, &type, &nfra) != 2) {
+    return NULL;
+  }
+
+  DiskCacheFile *file = MEM_callocN(sizeof(DiskCacheFile), "DiskCacheFile");
+  BLI_strncpy(file->path, path, sizeof(file->path));
+  BLI_strncpy(file->seq_dir, BLI_path_basename(seq_dir), sizeof(file->seq_dir));
+  file->type = type;
+  file->nfra = nfra;
+  file->size = size;
+  file->mtime = mtime;
+  BLI_addtail(&disk_cache->files, file);
+  disk_cache->size_total += size;
+
+  return file;
+}
+
+static void seq_disk_cache_file_remove(SeqDiskCache *disk_cache, DiskCacheFile *file)
+{
+  BLI_delete(file->path, false, false);
+  disk_cache->size_total -= file->size;
+  BLI_freelinkN(&disk_cache->files, file);
+}
+
+static int seq_disk_cache_file_cmp_mtime(const void *a_, const void *b_)
+{
+  const DiskCacheFile *a = a_;
+  const DiskCacheFile *b = b_;
+
+  return a->mtime > b->mtime;
+}
+
+static void seq_disk_cache_scan(SeqDiskCache *disk_cache)
+{
+  struct direntry *seq_dirs;
+  const unsigned int num_seq_dirs = BLI_filelist_dir_contents(disk_cache->dir, &seq_dirs);
+
+  /* Paths of entries are only valid for directories ending with a slash, join them here. */
+  for (unsigned int i = 0; i < num_seq_dirs; i++) {
+    if (!S_ISDIR(seq_dirs[i].type) || FILENAME_IS_CURRPAR(seq_dirs[i].relname)) {
+      continue;
+    }
+
+    char seq_dir[FILE_MAX];
+    BLI_join_dirfile(seq_dir, sizeof(seq_dir), disk_cache->dir, seq_dirs[i].relname);
+
+    struct direntry *files;
+    const unsigned int num_files = BLI_filelist_dir_contents(seq_dir, &files);
+
+    for (unsigned int j = 0; j < num_files; j++) {
+      if (S_ISREG(files[j].type)) {
+        char path[FILE_MAX];
+        BLI_join_dirfile(path, sizeof(path), seq_dir, files[j].relname);
+        seq_disk_cache_file_add(
+            disk_cache, path, (size_t)files[j].s.st_size, (int64_t)files[j].s.st_mtime);
+      }
+    }
+
+    BLI_filelist_free(files, num_files);
+  }
+
+  BLI_filelist_free(seq_dirs, num_seq_dirs);
+
+  BLI_listbase_sort(&disk_cache->files, seq_disk_cache_file_cmp_mtime);
+}
+
+static int64_t seq_disk_cache_read_version(const char *dir)
+{
+  char path[FILE_MAX];
+  int64_t timestamp = 0;
+
+  BLI_join_dirfile(path, sizeof(path), dir, DCACHE_VERSION_FILE);
+  FILE *f = BLI_fopen(path, "rb");
+
+  if (f) {
+    if (fread(&timestamp, sizeof(timestamp), 1, f) != 1) {
+      timestamp = 0;
+    }
+    fclose(f);
+  }
+
+  return timestamp;
+}
+
+static void seq_disk_cache_write_version(const char *dir, int64_t timestamp)
+{
+  char path[FILE_MAX];
+
+  BLI_join_dirfile(path, sizeof(path), dir, DCACHE_VERSION_FILE);
+  BLI_make_existing_file(path);
+  FILE *f = BLI_fopen(path, "wb");
+
+  if (f) {
+    fwrite(&timestamp, sizeof(timestamp), 1, f);
+    fclose(f);
+  }
+}
+
+static void seq_disk_cache_free_files(SeqDiskCache *disk_cache)
+{
+  BLI_freelistN(&disk_cache->files);
+  disk_cache->size_total = 0;
+}
+
+/* Make sure the files of the scene directory are known and valid for the current state of the
+ * scene, must be called with the disk cache mutex locked. */
+static void seq_disk_cache_ensure(SeqDiskCache *disk_cache, Scene *scene)
+{
+  Editing *ed = scene->ed;
+  char dir[FILE_MAX];
+
+  seq_disk_cache_get_scene_dir(scene, dir);
+
+  if (STREQ(dir, disk_cache->dir) && disk_cache->timestamp == ed->disk_cache_timestamp) {
+    return;
+  }
+
+  seq_disk_cache_free_files(disk_cache);
+  BLI_strncpy(disk_cache->dir, dir, sizeof(disk_cache->dir));
+
+  if (ed->disk_cache_timestamp == 0) {
+    ed->disk_cache_timestamp = seq_disk_cache_new_timestamp(0);
+  }
+
+  if (seq_disk_cache_read_version(dir) != ed->disk_cache_timestamp) {
+    /* Written for another state of the scene, which was not saved. */
+    if (BLI_is_dir(dir)) {
+      BLI_delete(dir, true, true);
+    }
+    seq_disk_cache_write_version(dir, ed->disk_cache_timestamp);
+  }
+  else {
+    seq_disk_cache_scan(disk_cache);
+  }
+
+  disk_cache->timestamp = ed->disk_cache_timestamp;
+}
+
+/* Free oldest files until the cache fits in the limit. */
+static void seq_disk_cache_enforce_limit(SeqDiskCache *disk_cache)
+{
+  const size_t size_limit = seq_disk_cache_get_size_limit();
+
+  while (disk_cache->size_total > size_limit && disk_cache->files.first) {
+    seq_disk_cache_file_remove(disk_cache, disk_cache->files.first);
+  }
+}
+
+static bool seq_disk_cache_write_buffer(FILE *f, const void *data, size_t size, int level)
+{
+  DiskCacheBufferHeader header = {size, size};
+  void *data_compressed = NULL;
+
+  if (level != 0) {
+    uLongf size_compressed = compressBound(size);
+    data_compressed = MEM_mallocN(size_compressed, "seq disk cache compressed");
+
+    if (compress2(data_compressed, &size_compressed, data, size, level) == Z_OK &&
+        size_compressed < size) {
+      header.size_compressed = size_compressed;
+      data = data_compressed;
+    }
+  }
+
+  bool ok = (fwrite(&header, sizeof(header), 1, f) == 1 &&
+             fwrite(data, header.size_compressed, 1, f) == 1);
+
+  if (data_compressed) {
+    MEM_freeN(data_compressed);
+  }
+
+  return ok;
+}
+
+static bool seq_disk_cache_read_buffer(FILE *f, void *data, size_t size)
+{
+  DiskCacheBufferHeader header;
+
+  if (fread(&header, sizeof(header), 1, f) != 1 || header.size != size) {
+    return false;
+  }
+
+  if (header.size_compressed == header.size) {
+    return fread(data, size, 1, f) == 1;
+  }
+
+  void *data_compressed = MEM_mallocN(header.size_compressed, "seq disk cache compressed");
+  uLongf size_uncompressed = size;
+  bool ok = (fread(data_compressed, header.size_compressed, 1, f) == 1 &&
+             uncompress(data, &size_uncompressed, data_compressed, header.size_compressed) ==
+                 Z_OK &&
+             size_uncompressed == size);
+  MEM_freeN(data_compressed);
+
+  return ok;
+}
+
+static int seq_disk_cache_compression_level(void)
+{
+  switch (U.sequencer_disk_cache_compression) {
+    case USER_SEQ_DISK_CACHE_COMPRESSION_LOW:
+      return 1;
+    case USER_SEQ_DISK_CACHE_COMPRESSION_HIGH:
+      return 9;
+    default:
+      return 0;
+  }
+}
+
+/* Write the image to its file, must be called without the disk cache mutex locked. */
+static void seq_disk_cache_write_file(SeqDiskCache *disk_cache, const DiskCacheWrite *write)
+{
+  ImBuf *ibuf = write->ibuf;
+  char path_temp[FILE_MAX];
+
+  /* Write to a temporary file first, so other threads never read incomplete files. */
+  BLI_snprintf(path_temp, sizeof(path_temp), "%s.%p", write->path, (void *)ibuf);
+  BLI_make_existing_file(path_temp);
+
+  FILE *f = BLI_fopen(path_temp, "wb");
+  if (f == NULL) {
+    return;
+  }
+
+  DiskCacheHeader header = {DCACHE_MAGIC};
+  const int level = seq_disk_cache_compression_level();
+  const size_t num_pixels = ((size_t)ibuf->x) * ibuf->y;
+
+  header.version = DCACHE_FORMAT_VERSION;
+  header.x = ibuf->x;
+  header.y = ibuf->y;
+  header.planes = ibuf->planes;
+  header.channels = ibuf->channels;
+  header.alpha_flags = ibuf->flags & (IB_alphamode_premul | IB_alphamode_ignore);
+  header.cost = write->cost;
+  if (ibuf->rect) {
+    header.flag |= DCACHE_HAS_RECT;
+    if (ibuf->rect_colorspace) {
+      BLI_strncpy(header.rect_colorspace,
+                  IMB_colormanagement_get_rect_colorspace(ibuf),
+                  sizeof(header.rect_colorspace));
+    }
+  }
+  if (ibuf->rect_float) {
+    header.flag |= DCACHE_HAS_RECT_FLOAT;
+    if (ibuf->float_colorspace) {
+      BLI_strncpy(header.float_colorspace,
+                  IMB_colormanagement_get_float_colorspace(ibuf),
+                  sizeof(header.float_colorspace));
+    }
+  }
+
+  bool ok = (fwrite(&header, sizeof(header), 1, f) == 1);
+  if (ok && ibuf->rect) {
+    ok = seq_disk_cache_write_buffer(f, ibuf->rect, num_pixels * 4, level);
+  }
+  if (ok && ibuf->rect_float) {
+    ok = seq_disk_cache_write_buffer(
+        f, ibuf->rect_float, num_pixels * ibuf->channels * sizeof(float), level);
+  }
+  ok &= (fclose(f) == 0);
+
+  if (!ok) {
+    BLI_delete(path_temp, false, false);
+    return;
+  }
+
+  BLI_mutex_lock(&disk_cache->mutex);
+
+  /* Images rendered before an invalidation are outdated, the directory may be cleared already. */
+  if (disk_cache->timestamp == write->timestamp && BLI_rename(path_temp, write->path) == 0) {
+    LISTBASE_FOREACH (DiskCacheFile *, file, &disk_cache->files) {
+      if (STREQ(file->path, write->path)) {
+        disk_cache->size_total -= file->size;
+        BLI_freelinkN(&disk_cache->files, file);
+        break;
+      }
+    }
+
+    seq_disk_cache_file_add(
+        disk_cache, write->path, BLI_file_size(write->path), (int64_t)time(NULL));
+    seq_disk_cache_enforce_limit(disk_cache);
+  }
+  else {
+    BLI_delete(path_temp, false, false);
+  }
+
+  BLI_mutex_unlock(&disk_cache->mutex);
+}
+
+static void seq_disk_cache_write_free(DiskCacheWrite *write)
+{
+  IMB_freeImBuf(write->ibuf);
+  MEM_freeN(write);
+}
+
+static void *seq_disk_cache_write_thread(void *disk_cache_v)
+{
+  SeqDiskCache *disk_cache = disk_cache_v;
+
+  BLI_mutex_lock(&disk_cache->mutex);
+
+  while (true) {
+    while (disk_cache->writes.first == NULL && !disk_cache->stop_writing) {
+      BLI_condition_wait(&disk_cache->write_cond, &disk_cache->mutex);
+    }
+    if (disk_cache->stop_writing) {
+      break;
+    }
+
+    DiskCacheWrite *write = BLI_pophead(&disk_cache->writes);
+    disk_cache->num_writes--;
+    disk_cache->is_writing = true;
+    BLI_mutex_unlock(&disk_cache->mutex);
+
+    seq_disk_cache_write_file(disk_cache, write);
+    seq_disk_cache_write_free(write);
+
+    BLI_mutex_lock(&disk_cache->mutex);
+    disk_cache->is_writing = false;
+    BLI_condition_notify_all(&disk_cache->write_done_cond);
+  }
+
+  BLI_mutex_unlock(&disk_cache->mutex);
+
+  return NULL;
+}
+
+/* Queued images are outdated after an invalidation, must be called with the disk cache mutex
+ * locked. */
+static void seq_disk_cache_discard_writes(SeqDiskCache *disk_cache)
+{
+  LISTBASE_FOREACH_MUTABLE (DiskCacheWrite *, write, &disk_cache->writes) {
+    seq_disk_cache_write_free(write);
+  }
+  BLI_listbase_clear(&disk_cache->writes);
+  disk_cache->num_writes = 0;
+  BLI_condition_notify_all(&disk_cache->write_done_cond);
+}
+
+static void seq_disk_cache_write(
+    const SeqRenderData *context, Sequence *seq, float cfra, int type, ImBuf *ibuf, float cost)
+{
+  Scene *scene = context->scene;
+  SeqDiskCache *disk_cache = scene->ed->cache->disk_cache;
+
+  if (seq_disk_cache_frame_uses_scene(&scene->ed->seqbase, (int)cfra)) {
+    return;
+  }
+
+  DiskCacheWrite *write = MEM_callocN(sizeof(DiskCacheWrite), "DiskCacheWrite");
+  IMB_refImBuf(ibuf);
+  write->ibuf = ibuf;
+  write->cost = cost;
+
+  BLI_mutex_lock(&disk_cache->mutex);
+
+  /* Wait when images are rendered faster than they are written, instead of keeping all of them
+   * in memory. */
+  while (disk_cache->num_writes >= DCACHE_WRITES_MAX) {
+    BLI_condition_wait(&disk_cache->write_done_cond, &disk_cache->mutex);
+  }
+
+  seq_disk_cache_ensure(disk_cache, scene);
+  seq_disk_cache_get_file_path(disk_cache, context, seq, cfra - seq->start, type, write->path);
+  write->timestamp = disk_cache->timestamp;
+
+  if (BLI_listbase_is_empty(&disk_cache->write_thread)) {
+    BLI_threadpool_init(&disk_cache->write_thread, seq_disk_cache_write_thread, 1);
+    BLI_threadpool_insert(&disk_cache->write_thread, disk_cache);
+  }
+
+  BLI_addtail(&disk_cache->writes, write);
+  disk_cache->num_writes++;
+  BLI_condition_notify_all(&disk_cache->write_cond);
+
+  BLI_mutex_unlock(&disk_cache->mutex);
+}
+
+/* Image of the file which is still waiting to be written, must be called with the disk cache
+ * mutex locked. */
+static ImBuf *seq_disk_cache_get_queued(SeqDiskCache *disk_cache, const char *path, float *r_cost)
+{
+  LISTBASE_FOREACH (DiskCacheWrite *, write, &disk_cache->writes) {
+    if (STREQ(write->path, path)) {
+      IMB_refImBuf(write->ibuf);
+      *r_cost = write->cost;
+      return write->ibuf;
+    }
+  }
+
+  return NULL;
+}
+
+/* Stop writing, the image being written is finished first. */
+static void seq_disk_cache_free(SeqDiskCache *disk_cache)
+{
+  BLI_mutex_lock(&disk_cache->mutex);
+  seq_disk_cache_discard_writes(disk_cache);
+  disk_cache->stop_writing = true;
+  BLI_condition_notify_all(&disk_cache->write_cond);
+  BLI_mutex_unlock(&disk_cache->mutex);
+
+  /* The thread is started with the first write. */
+  if (!BLI_listbase_is_empty(&disk_cache->write_thread)) {
+    BLI_threadpool_end(&disk_cache->write_thread);
+  }
+
+  seq_disk_cache_free_files(disk_cache);
+  BLI_condition_end(&disk_cache->write_done_cond);
+  BLI_condition_end(&disk_cache->write_cond);
+  BLI_mutex_end(&disk_cache->mutex);
+  MEM_freeN(disk_cache);
+}
+
+static ImBuf *seq_disk_cache_read(
+    const SeqRenderData *context, Sequence *seq, float cfra, int type, float *r_cost)
+{
+  Scene *scene = context->scene;
+  SeqDiskCache *disk_cache = scene->ed->cache->disk_cache;
+  char path[FILE_MAX];
+
+  if (seq_disk_cache_frame_uses_scene(&scene->ed->seqbase, (int)cfra)) {
+    return NULL;
+  }
+
+  BLI_mutex_lock(&disk_cache->mutex);
+  seq_disk_cache_ensure(disk_cache, scene);
+  seq_disk_cache_get_file_path(disk_cache, context, seq, cfra - seq->start, type, path);
+  ImBuf *ibuf_queued = seq_disk_cache_get_queued(disk_cache, path, r_cost);
+  BLI_mutex_unlock(&disk_cache->mutex);
+
+  if (ibuf_queued) {
+    return ibuf_queued;
+  }
+
+  FILE *f = BLI_fopen(path, "rb");
+  if (f == NULL) {
+    return NULL;
+  }
+
+  DiskCacheHeader header;
+  ImBuf *ibuf = NULL;
+
+  if (fread(&header, sizeof(header), 1, f) == 1 &&
+      memcmp(header.magic, DCACHE_MAGIC, sizeof(header.magic)) == 0 &&
+      header.version == DCACHE_FORMAT_VERSION && header.x > 0 && header.y > 0) {
+    const size_t num_pixels = ((size_t)header.x) * header.y;
+    bool ok = true;
+
+    ibuf = IMB_allocImBuf(header.x, header.y, header.planes, 0);
+    ibuf->channels = header.channels;
+    ibuf->flags |= header.alpha_flags;
+
+    if (header.flag & DCACHE_HAS_RECT) {
+      ok &= imb_addrectImBuf(ibuf) && seq_disk_cache_read_buffer(f, ibuf->rect, num_pixels * 4);
+      if (header.rect_colorspace[0]) {
+        IMB_colormanagement_assign_rect_colorspace(ibuf, header.rect_colorspace);
+      }
+    }
+    if (ok && (header.flag & DCACHE_HAS_RECT_FLOAT)) {
+      ok &= imb_addrectfloatImBuf(ibuf) &&
+            seq_disk_cache_read_buffer(
+                f, ibuf->rect_float, num_pixels * ibuf->channels * sizeof(float));
+      if (header.float_colorspace[0]) {
+        IMB_colormanagement_assign_float_colorspace(ibuf, header.float_colorspace);
+      }
+    }
+
+    if (!ok) {
+      IMB_freeImBuf(ibuf);
+      ibuf = NULL;
+    }
+    else {
+      *r_cost = header.cost;
+    }
+  }
+
+  fclose(f);
+
+  return ibuf;
+}
+
+/* Delete files of the changed images, the same way #BKE_sequencer_cache_cleanup_sequence frees
+ * them from memory. Files of strips which don't exist anymore are deleted as well. */
+static void seq_disk_cache_invalidate(Scene *scene,
+                                      Sequence *seq,
+                                      Sequence *seq_changed,
+                                      int invalidate_types,
+                                      int range_start,
+                                      int range_end)
+{
+  Editing *ed = scene->ed;
+  SeqDiskCache *disk_cache = ed->cache ? ed->cache->disk_cache : NULL;
+  const bool use_files = disk_cache && disk_cache->timestamp == ed->disk_cache_timestamp &&
+                         disk_cache->dir[0] != '\0';
+
+  /* Images on disk written for the previous state are outdated now, even if the new state is
+   * never saved. */
+  ed->disk_cache_timestamp = seq_disk_cache_new_timestamp(ed->disk_cache_timestamp);
+
+  if (disk_cache == NULL) {
+    return;
+  }
+
+  BLI_mutex_lock(&disk_cache->mutex);
+  seq_disk_cache_discard_writes(disk_cache);
+
+  if (!use_files) {
+    BLI_mutex_unlock(&disk_cache->mutex);
+    return;
+  }
+
+  GHash *seq_dirs = BLI_ghash_str_new(__func__);
+  SeqIterator iter;
+  for (BKE_sequence_iterator_begin(ed, &iter, false); iter.valid;
+       BKE_sequence_iterator_next(&iter)) {
+    char *seq_dir = MEM_mallocN(FILE_MAXFILE, __func__);
+    seq_disk_cache_dir_name(seq_dir, iter.seq->name + 2);
+    BLI_ghash_insert(seq_dirs, seq_dir, iter.seq);
+  }
+  BKE_sequence_iterator_end(&iter);
+
+  const int invalidate_composite = invalidate_types & SEQ_CACHE_STORE_FINAL_OUT;
+  const int invalidate_source = invalidate_types &
+                                (SEQ_CACHE_STORE_RAW | SEQ_CACHE_STORE_PREPROCESSED |
+                                 SEQ_CACHE_STORE_COMPOSITE);
+
+  LISTBASE_FOREACH_MUTABLE (DiskCacheFile *, file, &disk_cache->files) {
+    Sequence *file_seq = BLI_ghash_lookup(seq_dirs, file->seq_dir);
+
+    if (file_seq == NULL) {
+      seq_disk_cache_file_remove(disk_cache, file);
+      continue;
+    }
+
+    const int file_cfra = file_seq->start + file->nfra;
+
+    if ((file->type & invalidate_composite && file_cfra >= range_start &&
+         file_cfra <= range_end) ||
+        (file->type & invalidate_source && file_seq == seq &&
+         file_cfra >= seq_changed->startdisp && file_cfra <= seq_changed->enddisp)) {
+      seq_disk_cache_file_remove(disk_cache, file);
+    }
+  }
+
+  BLI_ghash_free(seq_dirs, MEM_freeN, NULL);
+
+  seq_disk_cache_write_version(disk_cache->dir, ed->disk_cache_timestamp);
+  disk_cache->timestamp = ed->disk_cache_timestamp;
+
+  BLI_mutex_unlock(&disk_cache->mutex);
+}
+
+static int seq_cache_get_flag(Scene *scene, Sequence *seq)
+{
+  if (seq->cache_flag & SEQ_CACHE_OVERRIDE) {
+    return seq->cache_flag | (scene->ed->cache_flag & SEQ_CACHE_STORE_FINAL_OUT);
+  }
+
+  return scene->ed->cache_flag;
+}
+
+/* Only images stored for later use are kept on disk. */
+static bool seq_cache_use_disk(const SeqRenderData *context, Sequence *seq, int type)
+{
+  Scene *scene = context->scene;
+
+  return !context->skip_cache && !context->is_proxy_render && seq_disk_cache_is_enabled(scene) &&
+         (seq_cache_get_flag(scene, seq) & type);
+}
+
+static ImBuf *seq_cache_get_from_memory(const SeqRenderData *context,
+                                        Sequence *seq,
+                                        float cfra,
+                                        int type)
+{
+  Scene *scene = context->scene;
+  ImBuf *ibuf = NULL;
+
+  seq_cache_lock(scene);
+  SeqCache *cache = seq_cache_get_from_scene(scene);
+
+  if (cache && seq) {
+    SeqCacheKey key;
+
+    key.seq = seq;
+    key.context = *context;
+    key.nfra = cfra - seq->start;
+    key.type = type;
+
+    ibuf = seq_cache_get(cache, &key);
+  }
+  seq_cache_unlock(scene);
+
+  return ibuf;
+}
+
+static void seq_cache_put_ex(const SeqRenderData *context,
+                             Sequence *seq,
+                             float cfra,
+                             int type,
+                             ImBuf *i,
+                             float cost,
+                             bool write_disk);
+
 /* ***************************** API ****************************** */
 
 void BKE_sequencer_cache_free_temp_cache(Scene *scene, short id, int cfra)
@@ -482,6 +1300,7 @@ void BKE_sequencer_cache_destruct(Scene *scene)
   BLI_mempool_destroy(cache->keys_pool);
   BLI_mempool_destroy(cache->items_pool);
   BLI_mutex_end(&cache->iterator_mutex);
+  seq_disk_cache_free(cache->disk_cache);
   MEM_freeN(cache);
   scene->ed->cache = NULL;
 }
@@ -515,18 +1334,54 @@ void BKE_sequencer_cache_cleanup(Scene *scene)
   seq_cache_unlock(scene);
 }
 
-void BKE_sequencer_cache_cleanup_sequence(Scene *scene,
-                                          Sequence *seq,
-                                          Sequence *seq_changed,
-                                          int invalidate_types)
+void BKE_sequencer_cache_cleanup_disk(Scene *scene)
 {
+  if (scene->ed == NULL) {
+    return;
+  }
+
+  Editing *ed = scene->ed;
+  ed->disk_cache_timestamp = seq_disk_cache_new_timestamp(ed->disk_cache_timestamp);
+
   SeqCache *cache = seq_cache_get_from_scene(scene);
   if (!cache) {
+    /* The directory is cleared on first use, when its version doesn't match. */
     return;
   }
 
-  seq_cache_lock(scene);
+  SeqDiskCache *disk_cache = cache->disk_cache;
+  BLI_mutex_lock(&disk_cache->mutex);
+  seq_disk_cache_discard_writes(disk_cache);
+  if (disk_cache->dir[0] != '\0') {
+    seq_disk_cache_free_files(disk_cache);
+    BLI_delete(disk_cache->dir, true, true);
+    seq_disk_cache_write_version(disk_cache->dir, ed->disk_cache_timestamp);
+    disk_cache->timestamp = ed->disk_cache_timestamp;
+  }
+  BLI_mutex_unlock(&disk_cache->mutex);
+}
+
+/* Wait until the images queued for the disk cache are written. */
+void BKE_sequencer_cache_disk_flush(Scene *scene)
+{
+  SeqCache *cache = seq_cache_get_from_scene(scene);
+  if (!cache) {
+    return;
+  }
 
+  SeqDiskCache *disk_cache = cache->disk_cache;
+  BLI_mutex_lock(&disk_cache->mutex);
+  while (disk_cache->writes.first || disk_cache->is_writing) {
+    BLI_condition_wait(&disk_cache->write_done_cond, &disk_cache->mutex);
+  }
+  BLI_mutex_unlock(&disk_cache->mutex);
+}
+
+void BKE_sequencer_cache_cleanup_sequence(Scene *scene,
+                                          Sequence *seq,
+                                          Sequence *seq_changed,
+                                          int invalidate_types)
+{
   int range_start = seq_changed->startdisp;
   int range_end = seq_changed->enddisp;
 
@@ -538,6 +1393,18 @@ void BKE_sequencer_cache_cleanup_sequence(Scene *scene,
     range_end = seq->enddisp;
   }
 
+  if (scene->ed) {
+    seq_disk_cache_invalidate(
+        scene, seq, seq_changed, invalidate_types, range_start, range_end);
+  }
+
+  SeqCache *cache = seq_cache_get_from_scene(scene);
+  if (!cache) {
+    return;
+  }
+
+  seq_cache_lock(scene);
+
   int invalidate_composite = invalidate_types & SEQ_CACHE_STORE_FINAL_OUT;
   int invalidate_source = invalidate_types & (SEQ_CACHE_STORE_RAW | SEQ_CACHE_STORE_PREPROCESSED |
                                               SEQ_CACHE_STORE_COMPOSITE);
@@ -587,24 +1454,18 @@ struct ImBuf *BKE_sequencer_cache_get(const SeqRenderData *context,
 
   if (!scene->ed->cache) {
     BKE_sequencer_cache_create(scene);
-    return NULL;
   }
 
-  seq_cache_lock(scene);
-  SeqCache *cache = seq_cache_get_from_scene(scene);
-  ImBuf *ibuf = NULL;
-
-  if (cache && seq) {
-    SeqCacheKey key;
+  ImBuf *ibuf = seq_cache_get_from_memory(context, seq, cfra, type);
 
-    key.seq = seq;
-    key.context = *context;
-    key.nfra = cfra - seq->start;
-    key.type = type;
+  if (ibuf == NULL && seq && seq_cache_use_disk(context, seq, type)) {
+    float cost;
+    ibuf = seq_disk_cache_read(context, seq, cfra, type, &cost);
 
-    ibuf = seq_cache_get(cache, &key);
+    if (ibuf) {
+      seq_cache_put_ex(context, seq, cfra, type, ibuf, cost, false);
+    }
   }
-  seq_cache_unlock(scene);
 
   return ibuf;
 }
@@ -627,27 +1488,32 @@ bool BKE_sequencer_cache_put_if_possible(
   else {
     seq_cache_set_temp_cache_linked(scene, scene->ed->cache->last_key);
     scene->ed->cache->last_key = NULL;
+
+    /* The disk cache is not limited by memory. */
+    if (ibuf && seq && seq_cache_use_disk(context, seq, type)) {
+      seq_disk_cache_write(context, seq, cfra, type, ibuf, cost);
+    }
     return false;
   }
 }
 
-void BKE_sequencer_cache_put(
-    const SeqRenderData *context, Sequence *seq, float cfra, int type, ImBuf *i, float cost)
+/* Context and strip must be the original ones, not prefetch copies. */
+static void seq_cache_put_ex(const SeqRenderData *context,
+                             Sequence *seq,
+                             float cfra,
+                             int type,
+                             ImBuf *i,
+                             float cost,
+                             bool write_disk)
 {
   Scene *scene = context->scene;
 
-  if (context->is_prefetch_render) {
-    context = BKE_sequencer_prefetch_get_original_context(context);
-    scene = context->scene;
-    seq = BKE_sequencer_prefetch_get_original_sequence(seq, scene);
-  }
-
   if (i == NULL || context->skip_cache || context->is_proxy_render || !seq) {
     return;
   }
 
   /* Prevent reinserting, it breaks cache key linking */
-  ImBuf *test = BKE_sequencer_cache_get(context, seq, cfra, type);
+  ImBuf *test = seq_cache_get_from_memory(context, seq, cfra, type);
   if (test) {
     IMB_freeImBuf(test);
     return;
@@ -660,15 +1526,7 @@ void BKE_sequencer_cache_put(
   seq_cache_lock(scene);
 
   SeqCache *cache = seq_cache_get_from_scene(scene);
-  int flag;
-
-  if (seq->cache_flag & SEQ_CACHE_OVERRIDE) {
-    flag = seq->cache_flag;
-    flag |= scene->ed->cache_flag & SEQ_CACHE_STORE_FINAL_OUT;
-  }
-  else {
-    flag = scene->ed->cache_flag;
-  }
+  int flag = seq_cache_get_flag(scene, seq);
 
   if (cost > SEQ_CACHE_COST_MAX) {
     cost = SEQ_CACHE_COST_MAX;
@@ -715,6 +1573,21 @@ void BKE_sequencer_cache_put(
   }
 
   seq_cache_unlock(scene);
+
+  if (write_disk && seq_cache_use_disk(context, seq, type)) {
+    seq_disk_cache_write(context, seq, cfra, type, i, cost);
+  }
+}
+
+void BKE_sequencer_cache_put(
+    const SeqRenderData *context, Sequence *seq, float cfra, int type, ImBuf *i, float cost)
+{
+  if (context->is_prefetch_render) {
+    context = BKE_sequencer_prefetch_get_original_context(context);
+    seq = BKE_sequencer_prefetch_get_original_sequence(seq, context->scene);
+  }
+
+  seq_cache_put_ex(context, seq, cfra, type, i, cost, true);
 }
 
 size_t BKE_sequencer_cache_get_num_items(struct Scene *scene)
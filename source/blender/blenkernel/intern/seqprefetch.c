@@ -34,6 +34,7 @@
 #include "DNA_anim_types.h"
 
 #include "BLI_listbase.h"
+#include "BLI_math_base.h"
 #include "BLI_threads.h"
 
 #include "IMB_imbuf.h"
@@ -52,33 +53,41 @@
 #include "DEG_depsgraph_debug.h"
 #include "DEG_depsgraph_query.h"
 
+#include "seqprefetch_intern.h"
+
+typedef struct PrefetchWorker {
+  struct PrefetchJob *pfjob;
+  int index;
+
+  struct Main *bmain_eval;
+  struct Scene *scene_eval;
+  struct Depsgraph *depsgraph;
+
+  /* context */
+  struct SeqRenderData context;
+  struct SeqRenderData context_cpy;
+} PrefetchWorker;
+
 typedef struct PrefetchJob {
   struct PrefetchJob *next, *prev;
 
   struct Main *bmain;
-  struct Main *bmain_eval;
   struct Scene *scene;
-  struct Scene *scene_eval;
-  struct Depsgraph *depsgraph;
 
+  /* Also protects the prefetch area. */
   ThreadMutex prefetch_suspend_mutex;
   ThreadCondition prefetch_suspend_cond;
 
   ListBase threads;
+  PrefetchWorker *workers;
+  int num_workers;
+  int num_workers_running;
+  int num_workers_waiting;
 
-  /* context */
-  struct SeqRenderData context;
-  struct SeqRenderData context_cpy;
-  struct ListBase *seqbasep;
-  struct ListBase *seqbasep_cpy;
-
-  /* prefetch area */
-  float cfra;
-  int num_frames_prefetched;
+  SeqPrefetchArea area;
 
   /* control */
   bool running;
-  bool waiting;
   bool stop;
 } PrefetchJob;
 
@@ -130,7 +139,7 @@ static bool seq_prefetch_job_is_waiting(Scene *scene)
     return false;
   }
 
-  return pfjob->waiting;
+  return pfjob->num_workers_waiting > 0;
 }
 
 /* for cache context swapping */
@@ -153,7 +162,14 @@ SeqRenderData *BKE_sequencer_prefetch_get_original_context(const SeqRenderData *
 {
   PrefetchJob *pfjob = seq_prefetch_job_get(context->scene);
 
-  return &pfjob->context;
+  for (int i = 0; i < pfjob->num_workers; i++) {
+    if (pfjob->workers[i].depsgraph == context->depsgraph) {
+      return &pfjob->workers[i].context;
+    }
+  }
+
+  BLI_assert(!"Prefetch context of unknown worker");
+  return &pfjob->workers[0].context;
 }
 
 static bool seq_prefetch_is_cache_full(Scene *scene)
@@ -171,64 +187,112 @@ void BKE_sequencer_prefetch_get_time_range(Scene *scene, int *start, int *end)
 {
   PrefetchJob *pfjob = seq_prefetch_job_get(scene);
 
-  *start = pfjob->cfra;
-  *end = pfjob->cfra + pfjob->num_frames_prefetched;
+  *start = pfjob->area.cfra;
+  *end = pfjob->area.cfra + pfjob->area.num_frames_prefetched;
 }
 
-static void seq_prefetch_free_depsgraph(PrefetchJob *pfjob)
+static void seq_prefetch_free_depsgraph(PrefetchWorker *worker)
 {
-  if (pfjob->depsgraph != NULL) {
-    DEG_graph_free(pfjob->depsgraph);
+  if (worker->depsgraph != NULL) {
+    DEG_graph_free(worker->depsgraph);
   }
-  pfjob->depsgraph = NULL;
-  pfjob->scene_eval = NULL;
+  worker->depsgraph = NULL;
+  worker->scene_eval = NULL;
 }
 
-static void seq_prefetch_update_depsgraph(PrefetchJob *pfjob)
+static void seq_prefetch_update_depsgraph(PrefetchWorker *worker, float cfra)
 {
-  DEG_evaluate_on_framechange(
-      pfjob->bmain_eval, pfjob->depsgraph, pfjob->cfra + pfjob->num_frames_prefetched);
+  DEG_evaluate_on_framechange(worker->bmain_eval, worker->depsgraph, cfra);
 }
 
-static void seq_prefetch_init_depsgraph(PrefetchJob *pfjob)
+static void seq_prefetch_init_depsgraph(PrefetchWorker *worker)
 {
-  Main *bmain = pfjob->bmain_eval;
+  PrefetchJob *pfjob = worker->pfjob;
+  Main *bmain = worker->bmain_eval;
   Scene *scene = pfjob->scene;
   ViewLayer *view_layer = BKE_view_layer_default_render(scene);
 
-  pfjob->depsgraph = DEG_graph_new(bmain, scene, view_layer, DAG_EVAL_RENDER);
-  DEG_debug_name_set(pfjob->depsgraph, "SEQUENCER PREFETCH");
+  worker->depsgraph = DEG_graph_new(bmain, scene, view_layer, DAG_EVAL_RENDER);
+  DEG_debug_name_set(worker->depsgraph, "SEQUENCER PREFETCH");
 
   /* Make sure there is a correct evaluated scene pointer. */
-  DEG_graph_build_for_render_pipeline(pfjob->depsgraph, bmain, scene, view_layer);
+  DEG_graph_build_for_render_pipeline(worker->depsgraph, bmain, scene, view_layer);
 
   /* Update immediately so we have proper evaluated scene. */
-  seq_prefetch_update_depsgraph(pfjob);
+  seq_prefetch_update_depsgraph(worker, pfjob->area.cfra + pfjob->area.num_frames_prefetched);
 
-  pfjob->scene_eval = DEG_get_evaluated_scene(pfjob->depsgraph);
-  pfjob->scene_eval->ed->cache_flag = 0;
+  worker->scene_eval = DEG_get_evaluated_scene(worker->depsgraph);
+  worker->scene_eval->ed->cache_flag = 0;
 }
 
-static void seq_prefetch_update_area(PrefetchJob *pfjob)
+void seq_prefetch_area_init(SeqPrefetchArea *area, float cfra)
 {
-  int cfra = pfjob->scene->r.cfra;
-
-  /* rebase */
-  if (cfra > pfjob->cfra) {
-    int delta = cfra - pfjob->cfra;
-    pfjob->cfra = cfra;
-    pfjob->num_frames_prefetched -= delta;
+  area->cfra = cfra;
+  area->num_frames_prefetched = 1;
+  for (int i = 0; i < SEQ_PREFETCH_MAX_WORKERS; i++) {
+    area->is_rendering[i] = false;
+  }
+}
 
-    if (pfjob->num_frames_prefetched <= 1) {
-      pfjob->num_frames_prefetched = 1;
+/* Follow the playhead, which is at cfra now. */
+void seq_prefetch_area_update(SeqPrefetchArea *area, int cfra)
+{
+  /* rebase, the end of the area stays where it is as long as it is ahead of the playhead */
+  if (cfra > area->cfra) {
+    int delta = cfra - area->cfra;
+    area->cfra = cfra;
+    area->num_frames_prefetched -= delta;
+
+    if (area->num_frames_prefetched <= 1) {
+      area->num_frames_prefetched = 1;
     }
   }
 
   /* reset */
-  if (cfra < pfjob->cfra) {
-    pfjob->cfra = cfra;
-    pfjob->num_frames_prefetched = 1;
+  if (cfra < area->cfra) {
+    area->cfra = cfra;
+    area->num_frames_prefetched = 1;
+  }
+}
+
+static bool seq_prefetch_area_is_rendering(const SeqPrefetchArea *area, float cfra)
+{
+  for (int i = 0; i < SEQ_PREFETCH_MAX_WORKERS; i++) {
+    if (area->is_rendering[i] && area->frame_rendering[i] == cfra) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/* Claim the nearest frame after the area for the worker, until it's released. After a reset,
+ * frames which other workers are still rendering are skipped. */
+bool seq_prefetch_area_claim(SeqPrefetchArea *area, int worker_index, int efra, float *r_cfra)
+{
+  float cfra = area->cfra + area->num_frames_prefetched;
+
+  while (seq_prefetch_area_is_rendering(area, cfra)) {
+    cfra++;
   }
+  if (cfra > efra) {
+    return false;
+  }
+
+  area->num_frames_prefetched = (int)(cfra - area->cfra) + 1;
+  area->frame_rendering[worker_index] = cfra;
+  area->is_rendering[worker_index] = true;
+  *r_cfra = cfra;
+  return true;
+}
+
+void seq_prefetch_area_release(SeqPrefetchArea *area, int worker_index)
+{
+  area->is_rendering[worker_index] = false;
+}
+
+static void seq_prefetch_update_area(PrefetchJob *pfjob)
+{
+  seq_prefetch_area_update(&pfjob->area, pfjob->scene->r.cfra);
 }
 
 /* Use also to update scene and context changes
@@ -246,7 +310,7 @@ void BKE_sequencer_prefetch_stop(Scene *scene)
   pfjob->stop = true;
 
   while (pfjob->running) {
-    BLI_condition_notify_one(&pfjob->prefetch_suspend_cond);
+    BLI_condition_notify_all(&pfjob->prefetch_suspend_cond);
   }
 }
 
@@ -255,32 +319,36 @@ static void seq_prefetch_update_context(const SeqRenderData *context)
   PrefetchJob *pfjob;
   pfjob = seq_prefetch_job_get(context->scene);
 
-  BKE_sequencer_new_render_data(pfjob->bmain_eval,
-                                pfjob->depsgraph,
-                                pfjob->scene_eval,
-                                context->rectx,
-                                context->recty,
-                                context->preview_render_size,
-                                false,
-                                &pfjob->context_cpy);
-  pfjob->context_cpy.is_prefetch_render = true;
-  pfjob->context_cpy.task_id = SEQ_TASK_PREFETCH_RENDER;
-
-  BKE_sequencer_new_render_data(pfjob->bmain,
-                                pfjob->depsgraph,
-                                pfjob->scene,
-                                context->rectx,
-                                context->recty,
-                                context->preview_render_size,
-                                false,
-                                &pfjob->context);
-  pfjob->context.is_prefetch_render = false;
-
-  /* Same ID as prefetch context, because context will be swapped, but we still
-   * want to assign this ID to cache entries created in this thread.
-   * This is to allow "temp cache" work correctly for both threads.
-   */
-  pfjob->context.task_id = SEQ_TASK_PREFETCH_RENDER;
+  for (int i = 0; i < pfjob->num_workers; i++) {
+    PrefetchWorker *worker = &pfjob->workers[i];
+
+    BKE_sequencer_new_render_data(worker->bmain_eval,
+                                  worker->depsgraph,
+                                  worker->scene_eval,
+                                  context->rectx,
+                                  context->recty,
+                                  context->preview_render_size,
+                                  false,
+                                  &worker->context_cpy);
+    worker->context_cpy.is_prefetch_render = true;
+    worker->context_cpy.task_id = SEQ_TASK_PREFETCH_RENDER + i;
+
+    BKE_sequencer_new_render_data(pfjob->bmain,
+                                  worker->depsgraph,
+                                  pfjob->scene,
+                                  context->rectx,
+                                  context->recty,
+                                  context->preview_render_size,
+                                  false,
+                                  &worker->context);
+    worker->context.is_prefetch_render = false;
+
+    /* Same ID as prefetch context, because context will be swapped, but we still
+     * want to assign this ID to cache entries created in this thread.
+     * This is to allow "temp cache" work correctly for all threads.
+     */
+    worker->context.task_id = worker->context_cpy.task_id;
+  }
 }
 
 static void seq_prefetch_update_scene(Scene *scene)
@@ -291,16 +359,18 @@ static void seq_prefetch_update_scene(Scene *scene)
     return;
   }
 
-  seq_prefetch_free_depsgraph(pfjob);
-  seq_prefetch_init_depsgraph(pfjob);
+  for (int i = 0; i < pfjob->num_workers; i++) {
+    seq_prefetch_free_depsgraph(&pfjob->workers[i]);
+    seq_prefetch_init_depsgraph(&pfjob->workers[i]);
+  }
 }
 
 static void seq_prefetch_resume(Scene *scene)
 {
   PrefetchJob *pfjob = seq_prefetch_job_get(scene);
 
-  if (pfjob && pfjob->waiting) {
-    BLI_condition_notify_one(&pfjob->prefetch_suspend_cond);
+  if (pfjob && pfjob->num_workers_waiting > 0) {
+    BLI_condition_notify_all(&pfjob->prefetch_suspend_cond);
   }
 }
 
@@ -313,75 +383,102 @@ void BKE_sequencer_prefetch_free(Scene *scene)
 
   BKE_sequencer_prefetch_stop(scene);
 
-  BLI_threadpool_remove(&pfjob->threads, pfjob);
   BLI_threadpool_end(&pfjob->threads);
   BLI_mutex_end(&pfjob->prefetch_suspend_mutex);
   BLI_condition_end(&pfjob->prefetch_suspend_cond);
-  seq_prefetch_free_depsgraph(pfjob);
-  BKE_main_free(pfjob->bmain_eval);
+  for (int i = 0; i < pfjob->num_workers; i++) {
+    seq_prefetch_free_depsgraph(&pfjob->workers[i]);
+    BKE_main_free(pfjob->workers[i].bmain_eval);
+  }
+  MEM_freeN(pfjob->workers);
   MEM_freeN(pfjob);
   scene->ed->prefetch_job = NULL;
 }
 
-static void *seq_prefetch_frames(void *job)
+static void seq_prefetch_frame(PrefetchWorker *worker, float cfra)
 {
-  PrefetchJob *pfjob = (PrefetchJob *)job;
-
-  while (pfjob->cfra + pfjob->num_frames_prefetched <= pfjob->scene->r.efra) {
-    pfjob->scene_eval->ed->prefetch_job = NULL;
-
-    AnimData *adt = BKE_animdata_from_id(&pfjob->context_cpy.scene->id);
-    BKE_animsys_evaluate_animdata(pfjob->context_cpy.scene,
-                                  &pfjob->context_cpy.scene->id,
-                                  adt,
-                                  pfjob->cfra + pfjob->num_frames_prefetched,
-                                  ADT_RECALC_ALL,
-                                  false);
-    seq_prefetch_update_depsgraph(pfjob);
-
-    /* This is quite hacky solution:
-     * We need cross-reference original scene with copy for cache.
-     * However depsgraph must not have this data, because it will try to kill this job.
-     * Scene copy don't reference original scene. Perhaps, this could be done by depsgraph.
-     * Set to NULL before return!
-     */
-    pfjob->scene_eval->ed->prefetch_job = pfjob;
+  PrefetchJob *pfjob = worker->pfjob;
 
-    ImBuf *ibuf = BKE_sequencer_give_ibuf(
-        &pfjob->context_cpy, pfjob->cfra + pfjob->num_frames_prefetched, 0);
-    BKE_sequencer_cache_free_temp_cache(
-        pfjob->scene, pfjob->context.task_id, pfjob->cfra + pfjob->num_frames_prefetched);
-    IMB_freeImBuf(ibuf);
+  worker->scene_eval->ed->prefetch_job = NULL;
+
+  AnimData *adt = BKE_animdata_from_id(&worker->context_cpy.scene->id);
+  BKE_animsys_evaluate_animdata(
+      worker->context_cpy.scene, &worker->context_cpy.scene->id, adt, cfra, ADT_RECALC_ALL, false);
+  seq_prefetch_update_depsgraph(worker, cfra);
+
+  /* This is quite hacky solution:
+   * We need cross-reference original scene with copy for cache.
+   * However depsgraph must not have this data, because it will try to kill this job.
+   * Scene copy don't reference original scene. Perhaps, this could be done by depsgraph.
+   * Set to NULL before return!
+   */
+  worker->scene_eval->ed->prefetch_job = pfjob;
+
+  ImBuf *ibuf = BKE_sequencer_give_ibuf(&worker->context_cpy, cfra, 0);
+  BKE_sequencer_cache_free_temp_cache(pfjob->scene, worker->context.task_id, cfra);
+  IMB_freeImBuf(ibuf);
+}
+
+static bool seq_prefetch_is_enabled(PrefetchJob *pfjob)
+{
+  return (pfjob->scene->ed->cache_flag & SEQ_CACHE_PREFETCH_ENABLE) && !pfjob->stop;
+}
+
+static void *seq_prefetch_frames(void *worker_v)
+{
+  PrefetchWorker *worker = (PrefetchWorker *)worker_v;
+  PrefetchJob *pfjob = worker->pfjob;
+
+  BLI_mutex_lock(&pfjob->prefetch_suspend_mutex);
+
+  while (seq_prefetch_is_enabled(pfjob)) {
+    /* The first frame is always rendered, then the worker is suspended as long as there is no
+     * room in cache. */
+    if (pfjob->area.num_frames_prefetched > 1) {
+      while ((seq_prefetch_is_cache_full(pfjob->scene) ||
+              seq_prefetch_is_scrubbing(pfjob->bmain)) &&
+             seq_prefetch_is_enabled(pfjob)) {
+        pfjob->num_workers_waiting++;
+        BLI_condition_wait(&pfjob->prefetch_suspend_cond, &pfjob->prefetch_suspend_mutex);
+        pfjob->num_workers_waiting--;
+        seq_prefetch_update_area(pfjob);
+      }
+
+      /* Avoid "collision" with main thread, but make sure to fetch at least few frames */
+      if (pfjob->area.num_frames_prefetched > 5 &&
+          (pfjob->area.cfra + pfjob->area.num_frames_prefetched - pfjob->scene->r.cfra) < 2) {
+        break;
+      }
+
+      if (!seq_prefetch_is_enabled(pfjob)) {
+        break;
+      }
 
-    /* suspend thread */
-    BLI_mutex_lock(&pfjob->prefetch_suspend_mutex);
-    while ((seq_prefetch_is_cache_full(pfjob->scene) || seq_prefetch_is_scrubbing(pfjob->bmain)) &&
-           pfjob->scene->ed->cache_flag & SEQ_CACHE_PREFETCH_ENABLE && !pfjob->stop) {
-      pfjob->waiting = true;
-      BLI_condition_wait(&pfjob->prefetch_suspend_cond, &pfjob->prefetch_suspend_mutex);
       seq_prefetch_update_area(pfjob);
     }
-    pfjob->waiting = false;
-    BLI_mutex_unlock(&pfjob->prefetch_suspend_mutex);
 
-    /* Avoid "collision" with main thread, but make sure to fetch at least few frames */
-    if (pfjob->num_frames_prefetched > 5 &&
-        (pfjob->cfra + pfjob->num_frames_prefetched - pfjob->scene->r.cfra) < 2) {
+    float cfra;
+    if (!seq_prefetch_area_claim(&pfjob->area, worker->index, pfjob->scene->r.efra, &cfra)) {
       break;
     }
 
-    if (!(pfjob->scene->ed->cache_flag & SEQ_CACHE_PREFETCH_ENABLE) || pfjob->stop) {
-      break;
-    }
+    BLI_mutex_unlock(&pfjob->prefetch_suspend_mutex);
+    seq_prefetch_frame(worker, cfra);
+    BLI_mutex_lock(&pfjob->prefetch_suspend_mutex);
 
-    seq_prefetch_update_area(pfjob);
-    pfjob->num_frames_prefetched++;
+    seq_prefetch_area_release(&pfjob->area, worker->index);
   }
 
-  BKE_sequencer_cache_free_temp_cache(
-      pfjob->scene, pfjob->context.task_id, pfjob->cfra + pfjob->num_frames_prefetched);
-  pfjob->running = false;
-  pfjob->scene_eval->ed->prefetch_job = NULL;
+  BKE_sequencer_cache_free_temp_cache(pfjob->scene,
+                                      worker->context.task_id,
+                                      pfjob->area.cfra + pfjob->area.num_frames_prefetched);
+  worker->scene_eval->ed->prefetch_job = NULL;
+
+  pfjob->num_workers_running--;
+  if (pfjob->num_workers_running == 0) {
+    pfjob->running = false;
+  }
+  BLI_mutex_unlock(&pfjob->prefetch_suspend_mutex);
 
   return 0;
 }
@@ -395,29 +492,45 @@ static PrefetchJob *seq_prefetch_start(const SeqRenderData *context, float cfra)
       pfjob = (PrefetchJob *)MEM_callocN(sizeof(PrefetchJob), "PrefetchJob");
       context->scene->ed->prefetch_job = pfjob;
 
-      BLI_threadpool_init(&pfjob->threads, seq_prefetch_frames, 1);
+      /* Rendering a frame is multi-threaded already, leave threads for it. */
+      pfjob->num_workers = clamp_i(BLI_system_thread_count() / 4, 1, SEQ_PREFETCH_MAX_WORKERS);
+      pfjob->workers = MEM_callocN(sizeof(PrefetchWorker) * pfjob->num_workers,
+                                   "PrefetchWorker");
+
+      BLI_threadpool_init(&pfjob->threads, seq_prefetch_frames, pfjob->num_workers);
       BLI_mutex_init(&pfjob->prefetch_suspend_mutex);
       BLI_condition_init(&pfjob->prefetch_suspend_cond);
 
       pfjob->bmain = context->bmain;
-      pfjob->bmain_eval = BKE_main_new();
-
       pfjob->scene = context->scene;
-      seq_prefetch_init_depsgraph(pfjob);
+      seq_prefetch_area_init(&pfjob->area, cfra);
+
+      for (int i = 0; i < pfjob->num_workers; i++) {
+        pfjob->workers[i].pfjob = pfjob;
+        pfjob->workers[i].index = i;
+        pfjob->workers[i].bmain_eval = BKE_main_new();
+      }
     }
   }
+
+  /* Wait for all workers of the previous run to finish. */
+  for (int i = 0; i < pfjob->num_workers; i++) {
+    BLI_threadpool_remove(&pfjob->threads, &pfjob->workers[i]);
+  }
+
+  seq_prefetch_area_init(&pfjob->area, cfra);
+
   seq_prefetch_update_scene(context->scene);
   seq_prefetch_update_context(context);
 
-  pfjob->cfra = cfra;
-  pfjob->num_frames_prefetched = 1;
-
-  pfjob->waiting = false;
+  pfjob->num_workers_waiting = 0;
+  pfjob->num_workers_running = pfjob->num_workers;
   pfjob->stop = false;
   pfjob->running = true;
 
-  BLI_threadpool_remove(&pfjob->threads, pfjob);
-  BLI_threadpool_insert(&pfjob->threads, pfjob);
+  for (int i = 0; i < pfjob->num_workers; i++) {
+    BLI_threadpool_insert(&pfjob->threads, &pfjob->workers[i]);
+  }
 
   return pfjob;
 }
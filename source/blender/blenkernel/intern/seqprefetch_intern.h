@@ -0,0 +1,58 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * The Original Code is Copyright (C) 2020 by Blender Foundation.
+ * All rights reserved.
+ */
+
+/** \file
+ * \ingroup bke
+ */
+
+#ifndef __SEQPREFETCH_INTERN_H__
+#define __SEQPREFETCH_INTERN_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Frames are rendered by several workers concurrently, each has its own depsgraph to evaluate the
+ * scene at the frame it renders. */
+#define SEQ_PREFETCH_MAX_WORKERS 8
+
+/**
+ * Frames ahead of the playhead which are claimed by prefetch workers. Workers claim frames in
+ * order of distance from the playhead, so each frame is rendered once. Access must be protected
+ * by the mutex of the prefetch job.
+ */
+typedef struct SeqPrefetchArea {
+  /** Frames before cfra + num_frames_prefetched are claimed by workers. */
+  float cfra;
+  int num_frames_prefetched;
+  /** Frame rendered by each worker, when it renders one. */
+  float frame_rendering[SEQ_PREFETCH_MAX_WORKERS];
+  bool is_rendering[SEQ_PREFETCH_MAX_WORKERS];
+} SeqPrefetchArea;
+
+void seq_prefetch_area_init(SeqPrefetchArea *area, float cfra);
+void seq_prefetch_area_update(SeqPrefetchArea *area, int cfra);
+bool seq_prefetch_area_claim(SeqPrefetchArea *area, int worker_index, int efra, float *r_cfra);
+void seq_prefetch_area_release(SeqPrefetchArea *area, int worker_index);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __SEQPREFETCH_INTERN_H__ */
@@ -36,8 +36,10 @@ struct BLI_mempool;
 
 /* Task Scheduler
  *
- * Central scheduler that holds running threads ready to execute tasks. A single
- * queue holds the task from all pools.
+ * Central scheduler that holds running threads ready to execute tasks. Each thread
+ * known to the scheduler pushes tasks to its own deque, idle threads steal tasks
+ * from the deques of others. Tasks pushed from other threads go to a single
+ * global queue.
  *
  * Init/exit must be called before/after any task pools are created/freed, and
  * must be called from the main threads. All other scheduler and pool functions
@@ -62,8 +64,15 @@ int BLI_task_scheduler_num_threads(TaskScheduler *scheduler);
  * pool with smaller tasks. When other threads are busy they will continue
  * working on their own tasks, if not they will join in, no new threads will
  * be launched.
+ *
+ * Such a pool is nested in the pool of the task creating it: a thread waiting
+ * for the outer pool also runs tasks of nested pools, rather than sleeping
+ * while the remaining tasks of the outer pool wait for them.
  */
 
+/* Priority only orders tasks in the global queue, used for pushes from threads
+ * the scheduler doesn't manage. Threads of the scheduler push to their own
+ * deque and run the newest task first, TASK_PRIORITY_HIGH is ignored there. */
 typedef enum TaskPriority {
   TASK_PRIORITY_LOW,
   TASK_PRIORITY_HIGH,
@@ -112,9 +121,8 @@ void *BLI_task_pool_userdata(TaskPool *pool);
 /* optional mutex to use from run function */
 ThreadMutex *BLI_task_pool_user_mutex(TaskPool *pool);
 
-/* Delayed push, use that to reduce thread overhead by accumulating
- * all new tasks into local queue first and pushing it to scheduler
- * from within a single mutex lock.
+/* Delayed push, use that to reduce thread overhead when pushing many tasks
+ * at once: sleeping threads are only woken up once all tasks are pushed.
  */
 void BLI_task_pool_delayed_push_begin(TaskPool *pool, int thread_id);
 void BLI_task_pool_delayed_push_end(TaskPool *pool, int thread_id);
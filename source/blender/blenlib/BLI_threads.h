@@ -202,6 +202,10 @@ void BLI_thread_queue_nowait(ThreadQueue *queue);
 void BLI_thread_put_process_on_fast_node(void);
 void BLI_thread_put_thread_on_fast_node(void);
 
+/* Spread threads of a pool over NUMA nodes, see BLI_thread_numa_node_for_thread(). */
+int BLI_thread_numa_node_for_thread(int thread_index, int num_threads);
+bool BLI_thread_put_thread_on_numa_node(int node);
+
 #ifdef __cplusplus
 }
 #endif
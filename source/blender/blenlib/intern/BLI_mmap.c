@@ -0,0 +1,257 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * The Original Code is Copyright (C) 2020 Blender Foundation.
+ * All rights reserved.
+ */
+
+/** \file
+ * \ingroup bli
+ */
+
+#include <stddef.h>
+#include <string.h>
+
+#include "MEM_guardedalloc.h"
+
+#include "BLI_listbase.h"
+#include "BLI_mmap.h"
+#include "BLI_threads.h"
+
+#ifndef WIN32
+#  include <signal.h>
+#  include <stdio.h>
+#  include <stdlib.h>
+#  include <sys/mman.h>  // for mmap
+#  include <unistd.h>    // for read close
+#else
+#  include <io.h>  // for open close read
+#  include <windows.h>
+#endif
+
+struct BLI_mmap_file {
+  /* The address to which the file was mapped. */
+  char *memory;
+
+  /* The length of the file (and therefore the mapped region). */
+  size_t length;
+
+  /* Platform-specific handle for the mapping. */
+  void *handle;
+
+  /* Flag to indicate IO errors. Needs to be volatile since it's being set from
+   * within the signal handler, which is not part of the normal execution flow. */
+  volatile bool io_error;
+};
+
+#ifndef WIN32
+/* When the memory-mapped file is read but can't be accessed (a file on a network drive
+ * going away, or the file being truncated), the OS signals SIGBUS.
+ * To avoid crashing, the mapping is replaced by zeros and the error is reported to the caller
+ * through #BLI_mmap_any_io_error. */
+
+/* Open mapped files, protected by #mmap_lock (the handler only reads it). */
+static ListBase open_mmaps = {NULL, NULL};
+static ThreadMutex mmap_lock = BLI_MUTEX_INITIALIZER;
+
+/* Handler that was installed before ours, to pass on errors we don't handle. */
+static struct sigaction next_handler = {{0}};
+static bool sigbus_handler_installed = false;
+
+static void sigbus_handler(int sig, siginfo_t *siginfo, void *ptr)
+{
+  /* We only handle SIGBUS here for now. */
+  BLI_assert(sig == SIGBUS);
+
+  const char *error_addr = (const char *)siginfo->si_addr;
+
+  /* Find the file that this error belongs to. */
+  LISTBASE_FOREACH (LinkData *, link, &open_mmaps) {
+    BLI_mmap_file *file = link->data;
+
+    /* Is the address where the error occurred in this file's mapped range? */
+    if (error_addr >= file->memory && error_addr < file->memory + file->length) {
+      file->io_error = true;
+
+      /* Replace the mapped memory with zeroes. */
+      const void *mapped_memory = mmap(
+          file->memory, file->length, PROT_READ, MAP_FIXED | MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if (mapped_memory == MAP_FAILED) {
+        fprintf(stderr, "SIGBUS handler: Error replacing mapped file with zeros\n");
+      }
+
+      return;
+    }
+  }
+
+  /* Fall back to other handler if there was one. */
+  if (next_handler.sa_flags & SA_SIGINFO) {
+    if (next_handler.sa_sigaction) {
+      next_handler.sa_sigaction(sig, siginfo, ptr);
+      return;
+    }
+  }
+  else if (!ELEM(next_handler.sa_handler, SIG_DFL, SIG_IGN)) {
+    next_handler.sa_handler(sig);
+    return;
+  }
+
+  /* No other handler, trigger default behavior. */
+  signal(sig, SIG_DFL);
+  raise(sig);
+}
+
+/* Installs the SIGBUS handler, must be called with #mmap_lock held. */
+static bool sigbus_handler_setup(void)
+{
+  if (!sigbus_handler_installed) {
+    struct sigaction newact = {{0}};
+
+    newact.sa_flags = SA_SIGINFO;
+    newact.sa_sigaction = sigbus_handler;
+
+    if (sigaction(SIGBUS, &newact, &next_handler)) {
+      return false;
+    }
+
+    sigbus_handler_installed = true;
+  }
+
+  return true;
+}
+
+/* Adds a file to the list that the signal handler checks. */
+static void sigbus_handler_add(BLI_mmap_file *file)
+{
+  BLI_addtail(&open_mmaps, BLI_genericNodeN(file));
+}
+
+/* Removes a file from the list that the signal handler checks. */
+static void sigbus_handler_remove(BLI_mmap_file *file)
+{
+  LinkData *link = BLI_findptr(&open_mmaps, file, offsetof(LinkData, data));
+  BLI_freelinkN(&open_mmaps, link);
+}
+#endif
+
+BLI_mmap_file *BLI_mmap_open(int fd)
+{
+  void *memory, *handle = NULL;
+#ifndef WIN32
+  const int64_t file_size = lseek(fd, 0, SEEK_END);
+#else
+  const int64_t file_size = _lseeki64(fd, 0, SEEK_END);
+#endif
+  if (UNLIKELY(file_size < 0)) {
+    return NULL;
+  }
+  const size_t length = (size_t)file_size;
+
+#ifndef WIN32
+  /* Ensure that the SIGBUS handler is configured. */
+  BLI_mutex_lock(&mmap_lock);
+  const bool handler_ok = sigbus_handler_setup();
+  BLI_mutex_unlock(&mmap_lock);
+  if (!handler_ok) {
+    return NULL;
+  }
+
+  /* Map the given file to memory. */
+  memory = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (memory == MAP_FAILED) {
+    return NULL;
+  }
+#else
+  /* Convert the POSIX-style file descriptor to a Windows handle. */
+  void *file_handle = (void *)_get_osfhandle(fd);
+  /* Memory mapping fails if the file is empty. */
+  if (length == 0) {
+    return NULL;
+  }
+  /* Assume that the mapping object is the same size as the file. */
+  handle = CreateFileMapping(file_handle, NULL, PAGE_READONLY, 0, 0, NULL);
+  if (handle == NULL) {
+    return NULL;
+  }
+  memory = MapViewOfFile(handle, FILE_MAP_READ, 0, 0, 0);
+  if (memory == NULL) {
+    CloseHandle(handle);
+    return NULL;
+  }
+#endif
+
+  /* Now that the mapping was successful, allocate memory and set up the BLI_mmap_file. */
+  BLI_mmap_file *file = MEM_callocN(sizeof(BLI_mmap_file), __func__);
+  file->memory = memory;
+  file->handle = handle;
+  file->length = length;
+
+#ifndef WIN32
+  /* Register the file with the error handler. */
+  BLI_mutex_lock(&mmap_lock);
+  sigbus_handler_add(file);
+  BLI_mutex_unlock(&mmap_lock);
+#endif
+
+  return file;
+}
+
+bool BLI_mmap_read(BLI_mmap_file *file, void *dest, size_t offset, size_t length)
+{
+  /* If a previous read has already failed or we try to read past the end,
+   * don't even attempt to read any further. */
+  if (file->io_error || (offset + length > file->length) || (offset + length < offset)) {
+    return false;
+  }
+
+  memcpy(dest, file->memory + offset, length);
+
+  /* Check whether the SIGBUS handler was triggered while reading. */
+  return !file->io_error;
+}
+
+void *BLI_mmap_get_pointer(BLI_mmap_file *file)
+{
+  return file->memory;
+}
+
+size_t BLI_mmap_get_length(const BLI_mmap_file *file)
+{
+  return file->length;
+}
+
+bool BLI_mmap_any_io_error(const BLI_mmap_file *file)
+{
+  return file->io_error;
+}
+
+void BLI_mmap_free(BLI_mmap_file *file)
+{
+#ifndef WIN32
+  munmap((void *)file->memory, file->length);
+  BLI_mutex_lock(&mmap_lock);
+  sigbus_handler_remove(file);
+  BLI_mutex_unlock(&mmap_lock);
+#else
+  if (file->memory) {
+    UnmapViewOfFile(file->memory);
+  }
+  if (file->handle) {
+    CloseHandle(file->handle);
+  }
+#endif
+
+  MEM_freeN(file);
+}
@@ -45,18 +45,18 @@
  */
 #define MEMPOOL_SIZE 256
 
-/* Number of tasks which are pushed directly to local thread queue.
+/* Number of tasks which fit into a newly created per-thread deque.
  *
- * This allows thread to fetch next task without locking the whole queue.
+ * The deque grows when more tasks are pushed, see TaskDeque.
  */
-#define LOCAL_QUEUE_SIZE 1
+#define DEQUE_INITIAL_SIZE 256
 
-/* Number of tasks which are allowed to be scheduled in a delayed manner.
+/* Number of pool IDs tracked per pool: the pool itself and its closest ancestors.
  *
- * This allows to use less locks per graph node children schedule. More details
- * could be found at TaskThreadLocalStorage::do_delayed_push.
+ * A thread waiting for a pool also runs tasks of pools nested in it up to this
+ * depth, deeper nested tasks are left to other threads.
  */
-#define DELAYED_QUEUE_SIZE 4096
+#define POOL_MAX_NESTING 4
 
 #ifndef NDEBUG
 #  define ASSERT_THREAD_ID(scheduler, thread_id) \
@@ -137,32 +137,52 @@ typedef struct TaskThreadLocalStorage {
    * The idea is to re-use memory of finished/discarded tasks by this thread.
    */
   TaskMemPool task_mempool;
-
-  /* Local queue keeps thread alive by keeping small amount of tasks ready
-   * to be picked up without causing global thread locks for synchronization.
-   */
-  int num_local_queue;
-  Task *local_queue[LOCAL_QUEUE_SIZE];
-
-  /* Thread can be marked for delayed tasks push. This is helpful when it's
-   * know that lots of subsequent task pushed will happen from the same thread
-   * without "interrupting" for task execution.
-   *
-   * We try to accumulate as much tasks as possible in a local queue without
-   * any locks first, and then we push all of them into a scheduler's queue
-   * from within a single mutex lock.
-   */
-  bool do_delayed_push;
-  int num_delayed_queue;
-  Task *delayed_queue[DELAYED_QUEUE_SIZE];
 } TaskThreadLocalStorage;
 
+/* Work-stealing deque of tasks (Chase-Lev).
+ *
+ * Every thread known to the scheduler (main thread and worker threads) owns one
+ * deque. The owner pushes and pops tasks at the bottom without any locks, so
+ * the most recently pushed task, whose data is most likely still in the cache,
+ * runs first. Other threads steal from the top, which holds the oldest tasks.
+ *
+ * Only the owner changes bottom and the array, thieves only advance top. When
+ * the deque is full the owner switches to an array of twice the size. Old arrays
+ * are kept until the scheduler is freed, since thieves might still read them.
+ */
+typedef struct TaskDequeItem {
+  Task *task;
+  /* Copy of task->pool->ancestor_ids, so thieves can check the pool of a task
+   * before owning it, without touching memory which might be freed already. */
+  uint64_t pool_ids[POOL_MAX_NESTING];
+} TaskDequeItem;
+
+typedef struct TaskDequeArray {
+  struct TaskDequeArray *prev;
+  int64_t mask;
+  TaskDequeItem *items;
+} TaskDequeArray;
+
+typedef struct TaskDeque {
+  int64_t top;
+  int64_t bottom;
+  TaskDequeArray *array;
+} TaskDeque;
+
 struct TaskPool {
   TaskScheduler *scheduler;
 
-  volatile size_t num;
-  ThreadMutex num_mutex;
-  ThreadCondition num_cond;
+  /* Number of pushed tasks which are not done yet, only modified atomically.
+   * The decrease to zero happens with the scheduler's queue_mutex locked. */
+  size_t num;
+
+  /* Unique ID of this pool followed by the IDs of the pools it is nested in,
+   * zero terminated if there are less ancestors than POOL_MAX_NESTING.
+   *
+   * A pool created from within a running task is nested in the pool of that
+   * task. Waiting for a pool also runs the tasks of nested pools, since the
+   * pool can't be done before them anyway. */
+  uint64_t ancestor_ids[POOL_MAX_NESTING];
 
   void *userdata;
   ThreadMutex user_mutex;
@@ -207,10 +227,24 @@ struct TaskScheduler {
   int num_threads;
   bool background_thread_only;
 
+  /* Queue for tasks pushed from threads which don't own a deque, and for all
+   * tasks when only the background thread is available. */
   ListBase queue;
   ThreadMutex queue_mutex;
   ThreadCondition queue_cond;
 
+  /* Threads waiting for a pool to be done sleep on this condition, with
+   * queue_mutex locked. */
+  ThreadCondition wait_cond;
+
+  /* Number of worker threads sleeping on queue_cond. */
+  int num_sleeping;
+  /* Number of threads sleeping on wait_cond. */
+  int num_sleeping_waiters;
+
+  /* Last used TaskPool.ancestor_ids value. */
+  uint64_t last_pool_id;
+
   ThreadMutex startup_mutex;
   ThreadCondition startup_cond;
   volatile int num_thread_started;
@@ -225,6 +259,26 @@ typedef struct TaskThread {
   TaskScheduler *scheduler;
   int id;
   TaskThreadLocalStorage tls;
+
+  /* Tasks pushed from this thread. */
+  TaskDeque deque;
+
+  /* Number of pools this thread is doing work_and_wait() for. While waiting it
+   * only runs tasks of the pool, the rest of its deque is left to others. */
+  int num_waiting_pools;
+
+  /* Pool of the task this thread is running, parent of the pools it creates. */
+  TaskPool *current_pool;
+
+  /* Delay waking up sleeping threads until delayed_push_end(). */
+  bool do_delayed_push;
+  int num_delayed_push;
+
+  /* State of the random generator used to pick a thread to steal from. */
+  uint32_t steal_rng;
+
+  /* NUMA node the thread runs on, -1 if it's up to the operating system. */
+  int numa_node;
 } TaskThread;
 
 /* Helper */
@@ -257,8 +311,9 @@ BLI_INLINE TaskThreadLocalStorage *get_task_tls(TaskPool *pool, const int thread
     return &pool->local_tls;
   }
   if (thread_id == 0) {
+    /* Main thread might run tasks of pools created by other threads. */
     BLI_assert(BLI_thread_is_main());
-    return &scheduler->task_threads[pool->thread_id].tls;
+    return &scheduler->task_threads[0].tls;
   }
   return &scheduler->task_threads[thread_id].tls;
 }
@@ -326,113 +381,459 @@ static void task_free(TaskPool *pool, Task *task, const int thread_id)
   }
 }
 
-/* Task Scheduler */
+/* Task Deque */
 
-static void task_pool_num_decrease(TaskPool *pool, size_t done)
+/* Check whether a task of the pool with the given ancestor IDs is part of the
+ * work of the given pool, directly or through a nested pool. */
+BLI_INLINE bool task_pool_ids_match(const uint64_t *pool_ids,
+                                    const TaskPool *pool,
+                                    const bool use_nested)
+{
+  const uint64_t pool_id = pool->ancestor_ids[0];
+  if (!use_nested) {
+    return pool_ids[0] == pool_id;
+  }
+  for (int i = 0; i < POOL_MAX_NESTING && pool_ids[i] != 0; i++) {
+    if (pool_ids[i] == pool_id) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/* Read with a full memory barrier, atomic_ops has no plain atomic load. */
+BLI_INLINE int64_t task_deque_load(int64_t *value)
+{
+  return atomic_fetch_and_add_int64(value, 0);
+}
+
+static TaskDequeArray *task_deque_array_alloc(const int64_t size, TaskDequeArray *prev)
+{
+  TaskDequeArray *array = MEM_mallocN(sizeof(TaskDequeArray), "TaskDequeArray");
+  array->prev = prev;
+  array->mask = size - 1;
+  array->items = MEM_mallocN(sizeof(TaskDequeItem) * (size_t)size, "TaskDequeArray items");
+  return array;
+}
+
+static void task_deque_init(TaskDeque *deque)
 {
-  BLI_mutex_lock(&pool->num_mutex);
+  deque->top = 0;
+  deque->bottom = 0;
+  deque->array = task_deque_array_alloc(DEQUE_INITIAL_SIZE, NULL);
+}
+
+static void task_deque_free(TaskDeque *deque)
+{
+  TaskDequeArray *array = deque->array;
+  while (array != NULL) {
+    TaskDequeArray *prev = array->prev;
+    MEM_freeN(array->items);
+    MEM_freeN(array);
+    array = prev;
+  }
+  deque->array = NULL;
+}
+
+BLI_INLINE bool task_deque_is_empty(TaskDeque *deque)
+{
+  return task_deque_load(&deque->top) >= task_deque_load(&deque->bottom);
+}
+
+/* Only to be called by the owner thread. */
+static void task_deque_push(TaskDeque *deque, Task *task)
+{
+  const int64_t bottom = deque->bottom;
+  const int64_t top = task_deque_load(&deque->top);
+  TaskDequeArray *array = deque->array;
+
+  if (bottom - top > array->mask) {
+    TaskDequeArray *new_array = task_deque_array_alloc((array->mask + 1) * 2, array);
+    for (int64_t i = top; i < bottom; i++) {
+      new_array->items[i & new_array->mask] = array->items[i & array->mask];
+    }
+    atomic_cas_ptr((void **)&deque->array, array, new_array);
+    array = new_array;
+  }
+
+  TaskDequeItem *item = &array->items[bottom & array->mask];
+  item->task = task;
+  memcpy(item->pool_ids, task->pool->ancestor_ids, sizeof(item->pool_ids));
+  /* Make the task visible to thieves, the atomic operation is a full barrier. */
+  atomic_add_and_fetch_int64(&deque->bottom, 1);
+}
+
+/* Only to be called by the owner thread.
+ * When pool is not NULL the bottom task is only popped if it belongs to it. */
+static Task *task_deque_pop(TaskDeque *deque, const TaskPool *pool, const bool use_nested)
+{
+  TaskDequeArray *array = deque->array;
+  const int64_t bottom = deque->bottom - 1;
+
+  if (pool != NULL) {
+    if (bottom < task_deque_load(&deque->top) ||
+        !task_pool_ids_match(array->items[bottom & array->mask].pool_ids, pool, use_nested)) {
+      return NULL;
+    }
+  }
+
+  /* Reserve the bottom task before checking for thieves racing for it. */
+  atomic_sub_and_fetch_int64(&deque->bottom, 1);
+  const int64_t top = task_deque_load(&deque->top);
+
+  if (top > bottom) {
+    /* Deque is empty. */
+    atomic_add_and_fetch_int64(&deque->bottom, 1);
+    return NULL;
+  }
+
+  Task *task = array->items[bottom & array->mask].task;
+  if (top == bottom) {
+    /* Last task in the deque, a thief might be taking it at the same time. */
+    if (atomic_cas_int64(&deque->top, top, top + 1) != top) {
+      task = NULL;
+    }
+    atomic_add_and_fetch_int64(&deque->bottom, 1);
+  }
+  return task;
+}
+
+/* Can be called from any thread.
+ * When pool is not NULL the top task is only stolen if it belongs to it. */
+static Task *task_deque_steal(TaskDeque *deque, const TaskPool *pool, const bool use_nested)
+{
+  const int64_t top = task_deque_load(&deque->top);
+  const int64_t bottom = task_deque_load(&deque->bottom);
+
+  if (top >= bottom) {
+    return NULL;
+  }
+
+  TaskDequeArray *array = atomic_cas_ptr((void **)&deque->array, NULL, NULL);
+  const TaskDequeItem *item = &array->items[top & array->mask];
+  Task *task = item->task;
+  if (pool != NULL && !task_pool_ids_match(item->pool_ids, pool, use_nested)) {
+    return NULL;
+  }
+  if (atomic_cas_int64(&deque->top, top, top + 1) != top) {
+    /* Another thread took the task first. */
+    return NULL;
+  }
+  return task;
+}
+
+/* Hint whether the top task of the deque belongs to the pool. */
+static bool task_deque_top_is_pool(TaskDeque *deque, const TaskPool *pool, const bool use_nested)
+{
+  const int64_t top = task_deque_load(&deque->top);
+  if (top >= task_deque_load(&deque->bottom)) {
+    return false;
+  }
+  TaskDequeArray *array = atomic_cas_ptr((void **)&deque->array, NULL, NULL);
+  return task_pool_ids_match(array->items[top & array->mask].pool_ids, pool, use_nested);
+}
 
-  BLI_assert(pool->num >= done);
+/* Task Scheduler */
 
-  pool->num -= done;
+/* Get scheduler's thread of the caller, NULL if the caller is not managed by it. */
+BLI_INLINE TaskThread *task_scheduler_current_thread(TaskScheduler *scheduler)
+{
+  if (BLI_thread_is_main()) {
+    return &scheduler->task_threads[0];
+  }
+  return pthread_getspecific(scheduler->tls_id_key);
+}
 
-  if (pool->num == 0) {
-    BLI_condition_notify_all(&pool->num_cond);
+/* Get thread whose deque receives tasks pushed by the caller, NULL if tasks are
+ * to be pushed to the global queue.
+ *
+ * When there is only the background thread, non-background pools must be
+ * handled by work_and_wait() alone, which is easiest with a single queue. */
+BLI_INLINE TaskThread *task_scheduler_deque_thread(TaskScheduler *scheduler)
+{
+  if (scheduler->background_thread_only) {
+    return NULL;
   }
+  return task_scheduler_current_thread(scheduler);
+}
 
-  BLI_mutex_unlock(&pool->num_mutex);
+static void task_pool_num_decrease(TaskPool *pool, size_t done)
+{
+  TaskScheduler *scheduler = pool->scheduler;
+  size_t num = pool->num;
+
+  while (true) {
+    BLI_assert(num >= done);
+    if (num == done) {
+      /* The pool can be freed as soon as a waiting thread sees it being done,
+       * so the last decrease happens within the lock such thread synchronizes
+       * with before returning. */
+      BLI_mutex_lock(&scheduler->queue_mutex);
+      if (atomic_sub_and_fetch_z(&pool->num, done) == 0 && scheduler->num_sleeping_waiters != 0) {
+        BLI_condition_notify_all(&scheduler->wait_cond);
+      }
+      BLI_mutex_unlock(&scheduler->queue_mutex);
+      return;
+    }
+    const size_t prev_num = atomic_cas_z(&pool->num, num, num - done);
+    if (prev_num == num) {
+      return;
+    }
+    num = prev_num;
+  }
 }
 
 static void task_pool_num_increase(TaskPool *pool, size_t new)
 {
-  BLI_mutex_lock(&pool->num_mutex);
+  atomic_add_and_fetch_z(&pool->num, new);
+}
 
-  pool->num += new;
-  BLI_condition_notify_all(&pool->num_cond);
+/* Wake up sleeping threads after tasks were pushed to a deque. */
+static void task_scheduler_wake(TaskScheduler *scheduler, const bool wake_all)
+{
+  /* Counters are read after the task was published, while sleeping threads
+   * increase them before looking for tasks, so one of both sides sees the other. */
+  const int num_sleeping = atomic_fetch_and_add_int32(&scheduler->num_sleeping, 0);
+  const int num_sleeping_waiters = atomic_fetch_and_add_int32(&scheduler->num_sleeping_waiters,
+                                                              0);
+  if (num_sleeping == 0 && num_sleeping_waiters == 0) {
+    return;
+  }
 
-  BLI_mutex_unlock(&pool->num_mutex);
+  BLI_mutex_lock(&scheduler->queue_mutex);
+  if (wake_all) {
+    BLI_condition_notify_all(&scheduler->queue_cond);
+  }
+  else {
+    BLI_condition_notify_one(&scheduler->queue_cond);
+  }
+  if (num_sleeping_waiters != 0) {
+    BLI_condition_notify_all(&scheduler->wait_cond);
+  }
+  BLI_mutex_unlock(&scheduler->queue_mutex);
 }
 
-static bool task_scheduler_thread_wait_pop(TaskScheduler *scheduler, Task **task)
+/* Pop a task from the global queue, for a worker thread when pool is NULL. */
+static Task *task_scheduler_queue_pop(TaskScheduler *scheduler,
+                                      const TaskPool *pool,
+                                      const bool use_nested)
 {
-  bool found_task = false;
+  Task *task;
+
+  /* Avoid the lock in the common case of tasks going through deques. */
+  if (scheduler->queue.first == NULL) {
+    return NULL;
+  }
+
   BLI_mutex_lock(&scheduler->queue_mutex);
+  for (task = scheduler->queue.first; task != NULL; task = task->next) {
+    if (pool != NULL) {
+      if (task_pool_ids_match(task->pool->ancestor_ids, pool, use_nested)) {
+        break;
+      }
+    }
+    else if (!scheduler->background_thread_only || task->pool->run_in_background) {
+      break;
+    }
+  }
+  if (task != NULL) {
+    BLI_remlink(&scheduler->queue, task);
+  }
+  BLI_mutex_unlock(&scheduler->queue_mutex);
 
-  while (!scheduler->queue.first && !scheduler->do_exit) {
-    BLI_condition_wait(&scheduler->queue_cond, &scheduler->queue_mutex);
+  return task;
+}
+
+/* Steal a task from other threads, starting at a random one so thieves don't
+ * all compete for the same deque. Threads on the same NUMA node as the thief
+ * are tried first, their tasks likely use memory local to it. */
+static Task *task_scheduler_steal(TaskScheduler *scheduler,
+                                  TaskThread *thread,
+                                  const TaskPool *pool,
+                                  const bool use_nested)
+{
+  const int num_deques = scheduler->num_threads + 1;
+  const int numa_node = (thread != NULL) ? thread->numa_node : -1;
+  int start = 0;
+
+  if (thread != NULL) {
+    /* Xorshift. */
+    uint32_t rng = thread->steal_rng;
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    thread->steal_rng = rng;
+    start = (int)(rng % (uint32_t)num_deques);
+  }
+
+  for (int pass = (numa_node != -1) ? 0 : 1; pass < 2; pass++) {
+    for (int i = 0; i < num_deques; i++) {
+      TaskThread *victim = &scheduler->task_threads[(start + i) % num_deques];
+      if (victim == thread || (pass == 0 && victim->numa_node != numa_node)) {
+        continue;
+      }
+      Task *task = task_deque_steal(&victim->deque, pool, use_nested);
+      if (task != NULL) {
+        return task;
+      }
+    }
   }
+  return NULL;
+}
 
-  do {
-    Task *current_task;
+/* Move a task stuck in the deque of a waiting thread to the global queue.
+ *
+ * Waiting threads only run tasks of their pool, tasks of other pools in their
+ * deque are left to thieves. When all threads are waiting nobody would reach the
+ * tasks in the middle of such deques, moving them one by one to the global queue
+ * lets every waiting thread find its tasks there. */
+static bool task_scheduler_relocate_task(TaskScheduler *scheduler)
+{
+  if (scheduler->background_thread_only) {
+    return false;
+  }
 
-    /* Assuming we can only have a void queue in 'exit' case here seems logical
-     * (we should only be here after our worker thread has been woken up from a
-     * condition_wait(), which only happens after a new task was added to the queue),
-     * but it is wrong.
-     * Waiting on condition may wake up the thread even if condition is not signaled
-     * (spurious wake-ups), and some race condition may also empty the queue **after**
-     * condition has been signaled, but **before** awoken thread reaches this point...
-     * See http://stackoverflow.com/questions/8594591
-     *
-     * So we only abort here if do_exit is set.
-     */
-    if (scheduler->do_exit) {
+  for (int i = 0; i < scheduler->num_threads + 1; i++) {
+    TaskThread *thread = &scheduler->task_threads[i];
+    if (atomic_fetch_and_add_int32(&thread->num_waiting_pools, 0) == 0) {
+      continue;
+    }
+    Task *task = task_deque_steal(&thread->deque, NULL, false);
+    if (task != NULL) {
+      BLI_mutex_lock(&scheduler->queue_mutex);
+      BLI_addtail(&scheduler->queue, task);
+      BLI_condition_notify_one(&scheduler->queue_cond);
+      if (scheduler->num_sleeping_waiters != 0) {
+        BLI_condition_notify_all(&scheduler->wait_cond);
+      }
       BLI_mutex_unlock(&scheduler->queue_mutex);
-      return false;
+      return true;
+    }
+  }
+  return false;
+}
+
+/* Check whether a worker thread has anything to do, with queue_mutex locked. */
+static bool task_scheduler_has_work(TaskScheduler *scheduler)
+{
+  if (scheduler->background_thread_only) {
+    LISTBASE_FOREACH (Task *, task, &scheduler->queue) {
+      if (task->pool->run_in_background) {
+        return true;
+      }
     }
+    return false;
+  }
 
-    for (current_task = scheduler->queue.first; current_task != NULL;
-         current_task = current_task->next) {
-      TaskPool *pool = current_task->pool;
+  if (scheduler->queue.first != NULL) {
+    return true;
+  }
+  for (int i = 0; i < scheduler->num_threads + 1; i++) {
+    if (!task_deque_is_empty(&scheduler->task_threads[i].deque)) {
+      return true;
+    }
+  }
+  return false;
+}
 
-      if (scheduler->background_thread_only && !pool->run_in_background) {
-        continue;
+/* Check whether a thread waiting for the pool has anything to do, with
+ * queue_mutex locked. */
+static bool task_pool_has_work(const TaskPool *pool, const bool use_nested)
+{
+  TaskScheduler *scheduler = pool->scheduler;
+
+  LISTBASE_FOREACH (Task *, task, &scheduler->queue) {
+    if (task_pool_ids_match(task->pool->ancestor_ids, pool, use_nested)) {
+      return true;
+    }
+  }
+
+  if (scheduler->background_thread_only) {
+    return false;
+  }
+
+  for (int i = 0; i < scheduler->num_threads + 1; i++) {
+    TaskThread *thread = &scheduler->task_threads[i];
+    if (atomic_fetch_and_add_int32(&thread->num_waiting_pools, 0) != 0) {
+      /* Might need relocation. */
+      if (!task_deque_is_empty(&thread->deque)) {
+        return true;
       }
+    }
+    else if (task_deque_top_is_pool(&thread->deque, pool, use_nested)) {
+      return true;
+    }
+  }
+  return false;
+}
 
-      *task = current_task;
-      found_task = true;
-      BLI_remlink(&scheduler->queue, *task);
-      break;
+static Task *task_scheduler_thread_wait_pop(TaskScheduler *scheduler, TaskThread *thread)
+{
+  while (true) {
+    /* Own tasks first, then other threads' tasks, then the global queue. */
+    Task *task = task_deque_pop(&thread->deque, NULL, false);
+    if (task == NULL && !scheduler->background_thread_only) {
+      task = task_scheduler_steal(scheduler, thread, NULL, false);
     }
-    if (!found_task) {
-      BLI_condition_wait(&scheduler->queue_cond, &scheduler->queue_mutex);
+    if (task == NULL) {
+      task = task_scheduler_queue_pop(scheduler, NULL, false);
+    }
+    if (task != NULL) {
+      return task;
     }
-  } while (!found_task);
 
-  BLI_mutex_unlock(&scheduler->queue_mutex);
+    BLI_mutex_lock(&scheduler->queue_mutex);
+    atomic_add_and_fetch_int32(&scheduler->num_sleeping, 1);
+    /* NOTE: Use loop here to handle spurious wake-ups. */
+    while (!scheduler->do_exit && !task_scheduler_has_work(scheduler)) {
+      BLI_condition_wait(&scheduler->queue_cond, &scheduler->queue_mutex);
+    }
+    atomic_sub_and_fetch_int32(&scheduler->num_sleeping, 1);
+    BLI_mutex_unlock(&scheduler->queue_mutex);
 
-  return true;
+    if (scheduler->do_exit) {
+      return NULL;
+    }
+  }
 }
 
-BLI_INLINE void handle_local_queue(TaskThreadLocalStorage *tls, const int thread_id)
+BLI_INLINE void task_run_and_free(Task *task, TaskThread *thread, const int thread_id)
 {
-  BLI_assert(!tls->do_delayed_push);
-  while (tls->num_local_queue > 0) {
-    /* We pop task from queue before handling it so handler of the task can
-     * push next job to the local queue.
-     */
-    tls->num_local_queue--;
-    Task *local_task = tls->local_queue[tls->num_local_queue];
-    /* TODO(sergey): Double-check work_and_wait() doesn't handle other's
-     * pool tasks.
-     */
-    TaskPool *local_pool = local_task->pool;
-    local_task->run(local_pool, local_task->taskdata, thread_id);
-    task_free(local_pool, local_task, thread_id);
+  TaskPool *pool = task->pool;
+
+  /* Tasks of canceled pools are only freed. */
+  if (!pool->do_cancel) {
+    /* Pools created by the task get nested in its pool. */
+    TaskPool *prev_pool = NULL;
+    if (thread != NULL) {
+      prev_pool = thread->current_pool;
+      thread->current_pool = pool;
+    }
+
+    task->run(pool, task->taskdata, thread_id);
+
+    if (thread != NULL) {
+      thread->current_pool = prev_pool;
+    }
   }
-  BLI_assert(!tls->do_delayed_push);
+
+  task_free(pool, task, thread_id);
+
+  /* notify pool task was done */
+  task_pool_num_decrease(pool, 1);
 }
 
 static void *task_scheduler_thread_run(void *thread_p)
 {
   TaskThread *thread = (TaskThread *)thread_p;
-  TaskThreadLocalStorage *tls = &thread->tls;
   TaskScheduler *scheduler = thread->scheduler;
   int thread_id = thread->id;
   Task *task;
 
   pthread_setspecific(scheduler->tls_id_key, thread);
 
+  BLI_thread_put_thread_on_numa_node(thread->numa_node);
+
   /* signal the main thread when all threads have started */
   BLI_mutex_lock(&scheduler->startup_mutex);
   scheduler->num_thread_started++;
@@ -442,27 +843,33 @@ static void *task_scheduler_thread_run(void *thread_p)
   BLI_mutex_unlock(&scheduler->startup_mutex);
 
   /* keep popping off tasks */
-  while (task_scheduler_thread_wait_pop(scheduler, &task)) {
-    TaskPool *pool = task->pool;
-
-    /* run task */
-    BLI_assert(!tls->do_delayed_push);
-    task->run(pool, task->taskdata, thread_id);
-    BLI_assert(!tls->do_delayed_push);
-
-    /* delete task */
-    task_free(pool, task, thread_id);
-
-    /* Handle all tasks from local queue. */
-    handle_local_queue(tls, thread_id);
-
-    /* notify pool task was done */
-    task_pool_num_decrease(pool, 1);
+  while ((task = task_scheduler_thread_wait_pop(scheduler, thread)) != NULL) {
+    BLI_assert(!thread->do_delayed_push);
+    task_run_and_free(task, thread, thread_id);
+    BLI_assert(!thread->do_delayed_push);
   }
 
   return NULL;
 }
 
+static void task_thread_init(TaskScheduler *scheduler,
+                             TaskThread *thread,
+                             const int id,
+                             const int numa_node)
+{
+  thread->scheduler = scheduler;
+  thread->id = id;
+  initialize_task_tls(&thread->tls);
+  task_deque_init(&thread->deque);
+  thread->num_waiting_pools = 0;
+  thread->current_pool = NULL;
+  thread->do_delayed_push = false;
+  thread->num_delayed_push = 0;
+  /* Any non-zero seed works for xorshift. */
+  thread->steal_rng = 0x9E3779B9u * (uint32_t)(id + 1);
+  thread->numa_node = numa_node;
+}
+
 TaskScheduler *BLI_task_scheduler_create(int num_threads)
 {
   TaskScheduler *scheduler = MEM_callocN(sizeof(TaskScheduler), "TaskScheduler");
@@ -474,6 +881,7 @@ TaskScheduler *BLI_task_scheduler_create(int num_threads)
   BLI_listbase_clear(&scheduler->queue);
   BLI_mutex_init(&scheduler->queue_mutex);
   BLI_condition_init(&scheduler->queue_cond);
+  BLI_condition_init(&scheduler->wait_cond);
 
   BLI_mutex_init(&scheduler->startup_mutex);
   BLI_condition_init(&scheduler->startup_cond);
@@ -496,8 +904,8 @@ TaskScheduler *BLI_task_scheduler_create(int num_threads)
   scheduler->task_threads = MEM_mallocN(sizeof(TaskThread) * (num_threads + 1),
                                         "TaskScheduler task threads");
 
-  /* Initialize TLS for main thread. */
-  initialize_task_tls(&scheduler->task_threads[0].tls);
+  /* Initialize deque and TLS for main thread. */
+  task_thread_init(scheduler, &scheduler->task_threads[0], 0, -1);
 
   pthread_key_create(&scheduler->tls_id_key, NULL);
 
@@ -508,12 +916,17 @@ TaskScheduler *BLI_task_scheduler_create(int num_threads)
     scheduler->num_threads = num_threads;
     scheduler->threads = MEM_callocN(sizeof(pthread_t) * num_threads, "TaskScheduler threads");
 
+    /* All deques must exist before any thread starts stealing. Workers are
+     * spread over NUMA nodes, the background-only thread is left alone. */
     for (i = 0; i < num_threads; i++) {
-      TaskThread *thread = &scheduler->task_threads[i + 1];
-      thread->scheduler = scheduler;
-      thread->id = i + 1;
-      initialize_task_tls(&thread->tls);
+      const int numa_node = scheduler->background_thread_only ?
+                                -1 :
+                                BLI_thread_numa_node_for_thread(i, num_threads);
+      task_thread_init(scheduler, &scheduler->task_threads[i + 1], i + 1, numa_node);
+    }
 
+    for (i = 0; i < num_threads; i++) {
+      TaskThread *thread = &scheduler->task_threads[i + 1];
       if (pthread_create(&scheduler->threads[i], NULL, task_scheduler_thread_run, thread) != 0) {
         fprintf(stderr, "TaskScheduler failed to launch thread %d/%d\n", i, num_threads);
       }
@@ -559,11 +972,16 @@ void BLI_task_scheduler_free(TaskScheduler *scheduler)
     MEM_freeN(scheduler->threads);
   }
 
-  /* Delete task thread data */
+  /* Delete task thread data and leftover tasks in deques. */
   if (scheduler->task_threads) {
     for (int i = 0; i < scheduler->num_threads + 1; i++) {
-      TaskThreadLocalStorage *tls = &scheduler->task_threads[i].tls;
-      free_task_tls(tls);
+      TaskThread *thread = &scheduler->task_threads[i];
+      while ((task = task_deque_steal(&thread->deque, NULL, false)) != NULL) {
+        task_data_free(task, 0);
+        MEM_freeN(task);
+      }
+      task_deque_free(&thread->deque);
+      free_task_tls(&thread->tls);
     }
 
     MEM_freeN(scheduler->task_threads);
@@ -578,6 +996,7 @@ void BLI_task_scheduler_free(TaskScheduler *scheduler)
   /* delete mutex/condition */
   BLI_mutex_end(&scheduler->queue_mutex);
   BLI_condition_end(&scheduler->queue_cond);
+  BLI_condition_end(&scheduler->wait_cond);
   BLI_mutex_end(&scheduler->startup_mutex);
   BLI_condition_end(&scheduler->startup_cond);
 
@@ -591,8 +1010,23 @@ int BLI_task_scheduler_num_threads(TaskScheduler *scheduler)
 
 static void task_scheduler_push(TaskScheduler *scheduler, Task *task, TaskPriority priority)
 {
+  TaskThread *thread = task_scheduler_deque_thread(scheduler);
+
   task_pool_num_increase(task->pool, 1);
 
+  /* Threads known to the scheduler push to their own deque, priority has no
+   * meaning there since the owner runs the newest task first anyway. */
+  if (thread != NULL) {
+    task_deque_push(&thread->deque, task);
+    if (thread->do_delayed_push) {
+      thread->num_delayed_push++;
+    }
+    else {
+      task_scheduler_wake(scheduler, false);
+    }
+    return;
+  }
+
   /* add task to queue */
   BLI_mutex_lock(&scheduler->queue_mutex);
 
@@ -604,27 +1038,9 @@ static void task_scheduler_push(TaskScheduler *scheduler, Task *task, TaskPriori
   }
 
   BLI_condition_notify_one(&scheduler->queue_cond);
-  BLI_mutex_unlock(&scheduler->queue_mutex);
-}
-
-static void task_scheduler_push_all(TaskScheduler *scheduler,
-                                    TaskPool *pool,
-                                    Task **tasks,
-                                    int num_tasks)
-{
-  if (num_tasks == 0) {
-    return;
-  }
-
-  task_pool_num_increase(pool, num_tasks);
-
-  BLI_mutex_lock(&scheduler->queue_mutex);
-
-  for (int i = 0; i < num_tasks; i++) {
-    BLI_addhead(&scheduler->queue, tasks[i]);
+  if (scheduler->num_sleeping_waiters != 0) {
+    BLI_condition_notify_all(&scheduler->wait_cond);
   }
-
-  BLI_condition_notify_all(&scheduler->queue_cond);
   BLI_mutex_unlock(&scheduler->queue_mutex);
 }
 
@@ -686,9 +1102,6 @@ static TaskPool *task_pool_create_ex(TaskScheduler *scheduler,
   pool->run_in_background = is_background;
   pool->use_local_tls = false;
 
-  BLI_mutex_init(&pool->num_mutex);
-  BLI_condition_init(&pool->num_cond);
-
   pool->userdata = userdata;
   BLI_mutex_init(&pool->user_mutex);
 
@@ -715,6 +1128,18 @@ static TaskPool *task_pool_create_ex(TaskScheduler *scheduler,
     }
   }
 
+  /* Nest the pool in the pool of the task running on this thread, background
+   * pools are never waited for from there. */
+  TaskThread *thread = task_scheduler_current_thread(scheduler);
+  TaskPool *parent = (thread != NULL && !is_background) ? thread->current_pool : NULL;
+  memset(pool->ancestor_ids, 0, sizeof(pool->ancestor_ids));
+  pool->ancestor_ids[0] = atomic_add_and_fetch_uint64(&scheduler->last_pool_id, 1);
+  if (parent != NULL) {
+    memcpy(&pool->ancestor_ids[1],
+           parent->ancestor_ids,
+           sizeof(*pool->ancestor_ids) * (POOL_MAX_NESTING - 1));
+  }
+
 #ifdef DEBUG_STATS
   pool->mempool_stats = MEM_callocN(sizeof(*pool->mempool_stats) * (scheduler->num_threads + 1),
                                     "per-taskpool mempool stats");
@@ -770,9 +1195,6 @@ void BLI_task_pool_free(TaskPool *pool)
 {
   BLI_task_pool_cancel(pool);
 
-  BLI_mutex_end(&pool->num_mutex);
-  BLI_condition_end(&pool->num_cond);
-
   BLI_mutex_end(&pool->user_mutex);
 
 #ifdef DEBUG_STATS
@@ -796,11 +1218,6 @@ void BLI_task_pool_free(TaskPool *pool)
   BLI_threaded_malloc_end();
 }
 
-BLI_INLINE bool task_can_use_local_queues(TaskPool *pool, int thread_id)
-{
-  return (thread_id != -1 && (thread_id != pool->thread_id || pool->do_work));
-}
-
 static void task_pool_push(TaskPool *pool,
                            TaskRunFunction run,
                            void *taskdata,
@@ -827,31 +1244,6 @@ static void task_pool_push(TaskPool *pool,
     atomic_fetch_and_add_z(&pool->num_suspended, 1);
     return;
   }
-  /* Populate to any local queue first, this is cheapest push ever. */
-  if (task_can_use_local_queues(pool, thread_id)) {
-    ASSERT_THREAD_ID(pool->scheduler, thread_id);
-    TaskThreadLocalStorage *tls = get_task_tls(pool, thread_id);
-    /* Try to push to a local execution queue.
-     * These tasks will be picked up next.
-     */
-    if (tls->num_local_queue < LOCAL_QUEUE_SIZE) {
-      tls->local_queue[tls->num_local_queue] = task;
-      tls->num_local_queue++;
-      return;
-    }
-    /* If we are in the delayed tasks push mode, we push tasks to a
-     * temporary local queue first without any locks, and then move them
-     * to global execution queue with a single lock.
-     */
-    if (tls->do_delayed_push && tls->num_delayed_queue < DELAYED_QUEUE_SIZE) {
-      tls->delayed_queue[tls->num_delayed_queue] = task;
-      tls->num_delayed_queue++;
-      return;
-    }
-  }
-  /* Do push to a global execution pool, slowest possible method,
-   * causes quite reasonable amount of threading overhead.
-   */
   task_scheduler_push(pool->scheduler, task, priority);
 }
 
@@ -881,85 +1273,123 @@ void BLI_task_pool_push_from_thread(TaskPool *pool,
   task_pool_push(pool, run, taskdata, free_taskdata, NULL, priority, thread_id);
 }
 
-void BLI_task_pool_work_and_wait(TaskPool *pool)
+/* Find a task of the pool for the waiting thread. */
+static Task *task_pool_find_task(TaskPool *pool, TaskThread *thread, const bool use_nested)
 {
-  TaskThreadLocalStorage *tls = get_task_tls(pool, pool->thread_id);
   TaskScheduler *scheduler = pool->scheduler;
+  Task *task = NULL;
 
-  if (atomic_fetch_and_and_uint8((uint8_t *)&pool->is_suspended, 0)) {
-    if (pool->num_suspended) {
-      task_pool_num_increase(pool, pool->num_suspended);
-      BLI_mutex_lock(&scheduler->queue_mutex);
-
-      BLI_movelisttolist(&scheduler->queue, &pool->suspended_queue);
-
-      BLI_condition_notify_all(&scheduler->queue_cond);
-      BLI_mutex_unlock(&scheduler->queue_mutex);
-
-      pool->num_suspended = 0;
+  if (!scheduler->background_thread_only) {
+    if (thread != NULL) {
+      task = task_deque_pop(&thread->deque, pool, use_nested);
+    }
+    if (task == NULL) {
+      task = task_scheduler_steal(scheduler, thread, pool, use_nested);
     }
   }
+  if (task == NULL) {
+    task = task_scheduler_queue_pop(scheduler, pool, use_nested);
+  }
+  return task;
+}
 
-  pool->do_work = true;
-
-  ASSERT_THREAD_ID(pool->scheduler, pool->thread_id);
+/* Work on tasks of the pool until all of them are done.
+ *
+ * Only tasks from this pool and pools nested in it are handled, if we get a
+ * task from another pool, we can get into deadlock. Running nested tasks keeps
+ * the waiting thread busy when the pool is only waiting for tasks which in
+ * turn wait for their own pools, e.g. parallel ranges inside tasks. */
+static void task_pool_work_until_done(TaskPool *pool)
+{
+  TaskScheduler *scheduler = pool->scheduler;
+  TaskThread *thread = task_scheduler_current_thread(scheduler);
+  /* Threads the scheduler doesn't know about have no valid thread ID to run
+   * tasks of other pools with, and canceling only frees tasks of this pool. */
+  const bool use_nested = (thread != NULL) && !pool->do_cancel;
+  const int thread_id = (thread != NULL) ? thread->id : pool->thread_id;
 
-  handle_local_queue(tls, pool->thread_id);
+  if (thread != NULL) {
+    atomic_add_and_fetch_int32(&thread->num_waiting_pools, 1);
+  }
 
-  BLI_mutex_lock(&pool->num_mutex);
+  while (atomic_fetch_and_add_z(&pool->num, 0) != 0) {
+    Task *task = task_pool_find_task(pool, thread, use_nested);
 
-  while (pool->num != 0) {
-    Task *task, *work_task = NULL;
-    bool found_task = false;
+    /* if found task, do it, otherwise wait until other tasks are done */
+    if (task != NULL) {
+      if (pool->do_cancel) {
+        /* Might be called from a thread other than the creator, don't touch
+         * thread local storage. */
+        task_data_free(task, pool->thread_id);
+        MEM_freeN(task);
+        task_pool_num_decrease(pool, 1);
+      }
+      else {
+        task_run_and_free(task, thread, thread_id);
+      }
+      continue;
+    }
 
-    BLI_mutex_unlock(&pool->num_mutex);
+    if (task_scheduler_relocate_task(scheduler)) {
+      continue;
+    }
 
     BLI_mutex_lock(&scheduler->queue_mutex);
+    atomic_add_and_fetch_int32(&scheduler->num_sleeping_waiters, 1);
+    while (atomic_fetch_and_add_z(&pool->num, 0) != 0 && !task_pool_has_work(pool, use_nested)) {
+      BLI_condition_wait(&scheduler->wait_cond, &scheduler->queue_mutex);
+    }
+    atomic_sub_and_fetch_int32(&scheduler->num_sleeping_waiters, 1);
+    BLI_mutex_unlock(&scheduler->queue_mutex);
+  }
 
-    /* find task from this pool. if we get a task from another pool,
-     * we can get into deadlock */
+  /* Wait for the thread which did the last decrease to release the lock, the
+   * pool might be freed as soon as we return. */
+  BLI_mutex_lock(&scheduler->queue_mutex);
+  BLI_mutex_unlock(&scheduler->queue_mutex);
 
-    for (task = scheduler->queue.first; task; task = task->next) {
-      if (task->pool == pool) {
-        work_task = task;
-        found_task = true;
-        BLI_remlink(&scheduler->queue, task);
-        break;
-      }
-    }
+  if (thread != NULL) {
+    atomic_sub_and_fetch_int32(&thread->num_waiting_pools, 1);
+  }
+}
 
-    BLI_mutex_unlock(&scheduler->queue_mutex);
+void BLI_task_pool_work_and_wait(TaskPool *pool)
+{
+  TaskScheduler *scheduler = pool->scheduler;
 
-    /* if found task, do it, otherwise wait until other tasks are done */
-    if (found_task) {
-      /* run task */
-      BLI_assert(!tls->do_delayed_push);
-      work_task->run(pool, work_task->taskdata, pool->thread_id);
-      BLI_assert(!tls->do_delayed_push);
+  if (atomic_fetch_and_and_uint8((uint8_t *)&pool->is_suspended, 0)) {
+    if (pool->num_suspended) {
+      TaskThread *thread = task_scheduler_deque_thread(scheduler);
 
-      /* delete task */
-      task_free(pool, task, pool->thread_id);
+      task_pool_num_increase(pool, pool->num_suspended);
 
-      /* Handle all tasks from local queue. */
-      handle_local_queue(tls, pool->thread_id);
+      if (thread != NULL) {
+        Task *task, *nexttask;
+        for (task = pool->suspended_queue.first; task; task = nexttask) {
+          nexttask = task->next;
+          task_deque_push(&thread->deque, task);
+        }
+        BLI_listbase_clear(&pool->suspended_queue);
+        task_scheduler_wake(scheduler, true);
+      }
+      else {
+        BLI_mutex_lock(&scheduler->queue_mutex);
 
-      /* notify pool task was done */
-      task_pool_num_decrease(pool, 1);
-    }
+        BLI_movelisttolist(&scheduler->queue, &pool->suspended_queue);
 
-    BLI_mutex_lock(&pool->num_mutex);
-    if (pool->num == 0) {
-      break;
-    }
+        BLI_condition_notify_all(&scheduler->queue_cond);
+        BLI_mutex_unlock(&scheduler->queue_mutex);
+      }
 
-    if (!found_task) {
-      BLI_condition_wait(&pool->num_cond, &pool->num_mutex);
+      pool->num_suspended = 0;
     }
   }
 
-  BLI_mutex_unlock(&pool->num_mutex);
+  pool->do_work = true;
+
+  ASSERT_THREAD_ID(pool->scheduler, pool->thread_id);
 
-  BLI_assert(tls->num_local_queue == 0);
+  task_pool_work_until_done(pool);
 }
 
 void BLI_task_pool_work_wait_and_reset(TaskPool *pool)
@@ -976,12 +1406,9 @@ void BLI_task_pool_cancel(TaskPool *pool)
 
   task_scheduler_clear(pool->scheduler, pool);
 
-  /* wait until all entries are cleared */
-  BLI_mutex_lock(&pool->num_mutex);
-  while (pool->num) {
-    BLI_condition_wait(&pool->num_cond, &pool->num_mutex);
-  }
-  BLI_mutex_unlock(&pool->num_mutex);
+  /* Wait until all entries are cleared, tasks still in deques are freed
+   * without being run. */
+  task_pool_work_until_done(pool);
 
   pool->do_cancel = false;
 }
@@ -1003,23 +1430,32 @@ ThreadMutex *BLI_task_pool_user_mutex(TaskPool *pool)
 
 void BLI_task_pool_delayed_push_begin(TaskPool *pool, int thread_id)
 {
-  if (task_can_use_local_queues(pool, thread_id)) {
-    ASSERT_THREAD_ID(pool->scheduler, thread_id);
-    TaskThreadLocalStorage *tls = get_task_tls(pool, thread_id);
-    tls->do_delayed_push = true;
+  TaskThread *thread = task_scheduler_deque_thread(pool->scheduler);
+  if (thread != NULL) {
+    if (thread_id != -1) {
+      ASSERT_THREAD_ID(pool->scheduler, thread_id);
+    }
+    BLI_assert(!thread->do_delayed_push);
+    thread->do_delayed_push = true;
   }
+  UNUSED_VARS_NDEBUG(thread_id);
 }
 
 void BLI_task_pool_delayed_push_end(TaskPool *pool, int thread_id)
 {
-  if (task_can_use_local_queues(pool, thread_id)) {
-    ASSERT_THREAD_ID(pool->scheduler, thread_id);
-    TaskThreadLocalStorage *tls = get_task_tls(pool, thread_id);
-    BLI_assert(tls->do_delayed_push);
-    task_scheduler_push_all(pool->scheduler, pool, tls->delayed_queue, tls->num_delayed_queue);
-    tls->do_delayed_push = false;
-    tls->num_delayed_queue = 0;
+  TaskThread *thread = task_scheduler_deque_thread(pool->scheduler);
+  if (thread != NULL) {
+    if (thread_id != -1) {
+      ASSERT_THREAD_ID(pool->scheduler, thread_id);
+    }
+    BLI_assert(thread->do_delayed_push);
+    thread->do_delayed_push = false;
+    if (thread->num_delayed_push != 0) {
+      task_scheduler_wake(pool->scheduler, thread->num_delayed_push > 1);
+      thread->num_delayed_push = 0;
+    }
   }
+  UNUSED_VARS_NDEBUG(thread_id);
 }
 
 /* Parallel range routines */
@@ -966,3 +966,57 @@ void BLI_thread_put_thread_on_fast_node(void)
   }
 #endif
 }
+
+/**
+ * Get NUMA node to run the thread with the given index out of a pool of
+ * \a num_threads threads on. Nodes are filled with threads in order, each up
+ * to its number of processors, extra threads wrap around.
+ *
+ * Unlike putting all threads on a single fast node, this keeps all processors
+ * in use while threads stay close to the memory they allocate and touch first.
+ *
+ * \return -1 when the thread affinity is best left to the operating system:
+ * NUMA is not available, there is a single node, or the process is already
+ * restricted to some of the nodes (for example by the user with numactl).
+ */
+int BLI_thread_numa_node_for_thread(int thread_index, int num_threads)
+{
+  if (!is_numa_available || num_threads < 2) {
+    return -1;
+  }
+
+  const int num_nodes = numaAPI_GetNumNodes();
+  int num_available_nodes = 0;
+  int num_total_processors = 0;
+  for (int node = 0; node < num_nodes; node++) {
+    const int num_node_processors = numaAPI_GetNumNodeProcessors(node);
+    if (num_node_processors > 0) {
+      num_available_nodes++;
+      num_total_processors += num_node_processors;
+    }
+  }
+  if (num_available_nodes < 2 ||
+      numaAPI_GetNumCurrentNodesProcessors() < num_total_processors) {
+    return -1;
+  }
+
+  int processor_index = thread_index % num_total_processors;
+  for (int node = 0; node < num_nodes; node++) {
+    const int num_node_processors = numaAPI_GetNumNodeProcessors(node);
+    if (processor_index < num_node_processors) {
+      return node;
+    }
+    processor_index -= num_node_processors;
+  }
+  return -1;
+}
+
+/* Restrict the calling thread to the processors of the given NUMA node,
+ * does nothing for node -1. */
+bool BLI_thread_put_thread_on_numa_node(int node)
+{
+  if (!is_numa_available || node < 0) {
+    return false;
+  }
+  return numaAPI_RunThreadOnNode(node);
+}
@@ -69,6 +69,11 @@ enum {
    * Terminate reading (no data).
    */
   ENDB = BLEND_MAKE_ID('E', 'N', 'D', 'B'),
+  /**
+   * Offsets of all blocks but #DATA, to read only the blocks needed (when linking for example).
+   * Written after #ENDB so it's ignored by versions which don't support it.
+   */
+  INDX = BLEND_MAKE_ID('I', 'N', 'D', 'X'),
 };
 
 #define BLEN_THUMB_MEMSIZE_FILE(_x, _y) (sizeof(int) * (2 + (size_t)(_x) * (size_t)(_y)))
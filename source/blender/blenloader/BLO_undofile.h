@@ -25,6 +25,8 @@
  * \ingroup blenloader
  */
 
+struct GHash;
+struct GSet;
 struct Scene;
 
 typedef struct {
@@ -34,11 +36,18 @@ typedef struct {
   unsigned int size;
   /** When true, this chunk doesn't own the memory, it's shared with a previous #MemFileChunk */
   bool is_identical;
+  /** #ID.session_uuid of the data-block this chunk belongs to (0 for non-ID data). */
+  unsigned int id_session_uuid;
 } MemFileChunk;
 
 typedef struct MemFile {
   ListBase chunks;
   size_t size;
+  /**
+   * Unique number of this memfile in the session, set when writing it.
+   * See #Main.memfile_undo_serial.
+   */
+  unsigned int serial;
 } MemFile;
 
 typedef struct MemFileUndoData {
@@ -47,11 +56,35 @@ typedef struct MemFileUndoData {
   size_t undo_size;
 } MemFileUndoData;
 
+/** State used while writing a #MemFile, de-duplicating against a previous one. */
+typedef struct MemFileWriteData {
+  MemFile *written_memfile;
+  MemFile *reference_memfile;
+
+  /** #ID.session_uuid of the data-block being written (0 for non-ID data). */
+  unsigned int current_id_session_uuid;
+  /** Next chunk of the current ID in #reference_memfile to compare written data with. */
+  MemFileChunk *reference_current_chunk;
+  /** Next chunk in #reference_memfile to compare written non-ID data with. */
+  MemFileChunk *reference_non_id_chunk;
+
+  /** Maps an #ID.session_uuid to its first chunk in #reference_memfile. */
+  struct GHash *id_session_uuid_mapping;
+} MemFileWriteData;
+
 /* actually only used writefile.c */
-extern void memfile_chunk_add(MemFile *memfile,
-                              const char *buf,
-                              unsigned int size,
-                              MemFileChunk **compchunk_step);
+extern void memfile_write_init(MemFileWriteData *mem_data,
+                               MemFile *written_memfile,
+                               MemFile *reference_memfile);
+extern void memfile_write_finalize(MemFileWriteData *mem_data);
+extern void memfile_write_id_begin(MemFileWriteData *mem_data, unsigned int id_session_uuid);
+extern void memfile_write_id_end(MemFileWriteData *mem_data);
+extern bool memfile_write_id_reuse(MemFileWriteData *mem_data, unsigned int id_session_uuid);
+extern void memfile_chunk_add(MemFileWriteData *mem_data, const char *buf, unsigned int size);
+
+/* actually only used readfile.c */
+extern struct GSet *memfile_shared_id_session_uuids_get(const MemFile *memfile,
+                                                        const MemFile *reference_memfile);
 
 /* exports */
 extern void BLO_memfile_free(MemFile *memfile);
@@ -144,7 +144,7 @@ LinkNode *BLO_blendhandle_get_datablock_names(BlendHandle *bh, int ofblocktype,
   BHead *bhead;
   int tot = 0;
 
-  for (bhead = blo_bhead_first(fd); bhead; bhead = blo_bhead_next(fd, bhead)) {
+  for (bhead = blo_bhead_first(fd); bhead; bhead = blo_bhead_next_skip_data(fd, bhead)) {
     if (bhead->code == ofblocktype) {
       const char *idname = blo_bhead_id_name(fd, bhead);
 
@@ -264,7 +264,7 @@ LinkNode *BLO_blendhandle_get_linkable_groups(BlendHandle *bh)
   LinkNode *names = NULL;
   BHead *bhead;
 
-  for (bhead = blo_bhead_first(fd); bhead; bhead = blo_bhead_next(fd, bhead)) {
+  for (bhead = blo_bhead_first(fd); bhead; bhead = blo_bhead_next_skip_data(fd, bhead)) {
     if (bhead->code == ENDB) {
       break;
     }
@@ -359,10 +359,13 @@ BlendFileData *BLO_read_from_memory(const void *mem,
  * \param oldmain: old main,
  * from which we will keep libraries and other data-blocks that should not have changed.
  * \param filename: current file, only for retrieving library data.
+ * \param reference_memfile: memfile last written from or read into \a oldmain, or NULL.
+ * IDs of \a oldmain untouched since then and sharing their data with it are kept as is.
  */
 BlendFileData *BLO_read_from_memfile(Main *oldmain,
                                      const char *filename,
                                      MemFile *memfile,
+                                     const MemFile *reference_memfile,
                                      eBLOReadSkip skip_flags,
                                      ReportList *reports)
 {
@@ -396,6 +399,9 @@ BlendFileData *BLO_read_from_memfile(Main *oldmain,
     /* make lookups of existing sound data in old main */
     blo_make_sound_pointer_map(fd, oldmain);
 
+    /* makes lookup of untouched IDs in old main, kept instead of being read again */
+    blo_make_undo_reuse_id_map(fd, oldmain, reference_memfile);
+
     /* removed packed data from this trick - it's internal data that needs saves */
 
     bfd = blo_read_file_internal(fd, filename);
@@ -412,6 +418,12 @@ BlendFileData *BLO_read_from_memfile(Main *oldmain,
     /* ensures relinked sounds are not freed */
     blo_end_sound_pointer_map(fd, oldmain);
 
+    if (bfd) {
+      /* tags kept IDs using IDs which were read again */
+      blo_end_undo_reuse_id_map(fd, bfd->main);
+      bfd->main->memfile_undo_serial = memfile->serial;
+    }
+
     /* Still in-use libraries have already been moved from oldmain to new mainlist,
      * but oldmain itself shall *never* be 'transferred' to new mainlist! */
     BLI_assert(old_mainlist.first == oldmain);
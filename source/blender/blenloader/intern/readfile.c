@@ -23,6 +23,10 @@
 
 #include "zlib.h"
 
+#ifdef WITH_ZSTD
+#  include <zstd.h>
+#endif
+
 #include <limits.h>
 #include <stdlib.h> /* for atoi. */
 #include <stddef.h> /* for offsetof. */
@@ -101,6 +105,8 @@
 #include "BLI_threads.h"
 #include "BLI_mempool.h"
 #include "BLI_ghash.h"
+#include "BLI_mmap.h"
+#include "BLI_task.h"
 
 #include "BLT_translation.h"
 
@@ -220,11 +226,23 @@
  * Delay reading blocks we might not use (especially applies to library linking).
  * which keeps large arrays in memory from data-blocks we may not even use.
  *
- * \note This is disabled when using compression,
+ * \note This is disabled when using zlib compression,
  * while zlib supports seek it's unusably slow, see: T61880.
+ * Zstd compressed files written with a seek table support it.
  */
 #define USE_BHEAD_READ_ON_DEMAND
 
+/**
+ * Use the index of block offsets stored at the end of files (see #INDX),
+ * so only the blocks actually needed are read, instead of walking over the whole file.
+ * Blocks between indexed ones (#DATA) are read as they are reached, see #blo_bhead_next.
+ *
+ * \note Requires seeking, so it's only used for uncompressed and zstd compressed files.
+ */
+#ifdef USE_BHEAD_READ_ON_DEMAND
+#  define USE_BHEAD_INDEX
+#endif
+
 /* use GHash for BHead name-based lookups (speeds up linking) */
 #define USE_GHASH_BHEAD
 
@@ -589,7 +607,7 @@ static void read_file_version(FileData *fd, Main *main)
 {
   BHead *bhead;
 
-  for (bhead = blo_bhead_first(fd); bhead; bhead = blo_bhead_next(fd, bhead)) {
+  for (bhead = blo_bhead_first(fd); bhead; bhead = blo_bhead_next_skip_data(fd, bhead)) {
     if (bhead->code == GLOB) {
       FileGlobal *fg = read_struct(fd, bhead, "Global");
       if (fg) {
@@ -619,7 +637,7 @@ static void read_file_bhead_idname_map_create(FileData *fd)
   int code_prev = ENDB;
   uint reserve = 0;
 
-  for (bhead = blo_bhead_first(fd); bhead; bhead = blo_bhead_next(fd, bhead)) {
+  for (bhead = blo_bhead_first(fd); bhead; bhead = blo_bhead_next_skip_data(fd, bhead)) {
     if (code_prev != bhead->code) {
       code_prev = bhead->code;
       is_link = BKE_idcode_is_valid(code_prev) ? BKE_idcode_is_linkable(code_prev) : false;
@@ -634,7 +652,7 @@ static void read_file_bhead_idname_map_create(FileData *fd)
 
   fd->bhead_idname_hash = BLI_ghash_str_new_ex(__func__, reserve);
 
-  for (bhead = blo_bhead_first(fd); bhead; bhead = blo_bhead_next(fd, bhead)) {
+  for (bhead = blo_bhead_first(fd); bhead; bhead = blo_bhead_next_skip_data(fd, bhead)) {
     if (code_prev != bhead->code) {
       code_prev = bhead->code;
       is_link = BKE_idcode_is_valid(code_prev) ? BKE_idcode_is_linkable(code_prev) : false;
@@ -772,7 +790,10 @@ static void bh8_from_bh4(BHead *bhead, BHead4 *bhead4)
   }
 }
 
-static BHeadN *get_bhead(FileData *fd)
+/**
+ * Read the block at the current file position, without adding it to #FileData.bhead_list.
+ */
+static BHeadN *read_bhead(FileData *fd)
 {
   BHeadN *new_bhead = NULL;
   int readsize;
@@ -877,7 +898,7 @@ static BHeadN *get_bhead(FileData *fd)
         if (new_bhead) {
           new_bhead->next = new_bhead->prev = NULL;
 #ifdef USE_BHEAD_READ_ON_DEMAND
-          new_bhead->file_offset = 0; /* don't seek. */
+          new_bhead->file_offset = fd->file_offset;
           new_bhead->has_data = true;
 #endif
           new_bhead->bhead = bhead;
@@ -897,6 +918,13 @@ static BHeadN *get_bhead(FileData *fd)
     }
   }
 
+  return new_bhead;
+}
+
+static BHeadN *get_bhead(FileData *fd)
+{
+  BHeadN *new_bhead = read_bhead(fd);
+
   /* We've read a new block. Now add it to the list
    * of blocks.
    */
@@ -907,6 +935,117 @@ static BHeadN *get_bhead(FileData *fd)
   return new_bhead;
 }
 
+#ifdef USE_BHEAD_INDEX
+
+/** Size of a block header in the file, which may differ from `sizeof(BHead)`. */
+static off64_t bhead_file_size(const FileData *fd)
+{
+  return (fd->flags & FD_FLAGS_FILE_POINTSIZE_IS_4) ? sizeof(BHead4) : sizeof(BHead8);
+}
+
+/**
+ * Read the block at \a offset and insert it after \a bheadn_prev (at the start when NULL),
+ * used to fill in blocks not stored in the index.
+ */
+static BHeadN *bhead_index_read_at(FileData *fd, BHeadN *bheadn_prev, off64_t offset)
+{
+  if (fd->seek(fd, offset, SEEK_SET) == -1) {
+    return NULL;
+  }
+  BHeadN *new_bhead = read_bhead(fd);
+  if (new_bhead) {
+    BLI_insertlinkafter(&fd->bhead_list, bheadn_prev, new_bhead);
+  }
+  return new_bhead;
+}
+
+/**
+ * Load the blocks listed in the index at the end of the file (see #INDX),
+ * files without an index are read sequentially.
+ *
+ * \return true when the index was found and all blocks in it could be read.
+ */
+static bool read_bhead_index(FileData *fd)
+{
+  const bool do_endian_swap = (fd->flags & FD_FLAGS_SWITCH_ENDIAN) != 0;
+  const off64_t offset_backup = fd->file_offset;
+  bool ok = false;
+
+  BLI_assert(fd->seek != NULL && BLI_listbase_is_empty(&fd->bhead_list));
+
+  /* The index block ends with its own offset and #BLEND_BHEAD_INDEX_MAGIC. */
+  struct {
+    int64_t offset;
+    char magic[8];
+  } footer;
+  BLI_STATIC_ASSERT(sizeof(footer) == BLEND_BHEAD_INDEX_FOOTER_SIZE, "Invalid footer size")
+
+  if ((fd->seek(fd, -(off64_t)sizeof(footer), SEEK_END) != -1) &&
+      (fd->read(fd, &footer, sizeof(footer)) == sizeof(footer)) &&
+      (memcmp(footer.magic, BLEND_BHEAD_INDEX_MAGIC, sizeof(footer.magic)) == 0)) {
+    if (do_endian_swap) {
+      BLI_endian_switch_int64(&footer.offset);
+    }
+
+    BHeadN *index_bhead = NULL;
+    if (fd->seek(fd, footer.offset, SEEK_SET) != -1) {
+      index_bhead = read_bhead(fd);
+    }
+
+    if (index_bhead && index_bhead->bhead.code == INDX &&
+        index_bhead->bhead.len >= (int)sizeof(footer) &&
+        (index_bhead->bhead.len - sizeof(footer)) % sizeof(int64_t) == 0) {
+      const int64_t *offsets = (const int64_t *)(index_bhead + 1);
+      const int offsets_len = (int)((index_bhead->bhead.len - sizeof(footer)) /
+                                    sizeof(int64_t));
+      /* Blocks start after the file header and don't overlap,
+       * catching offsets which don't point to the start of a block in most cases. */
+      int64_t offset_min = SIZEOFBLENDERHEADER;
+
+      ok = (offsets_len != 0);
+      for (int i = 0; ok && i < offsets_len; i++) {
+        int64_t offset = offsets[i];
+        if (do_endian_swap) {
+          BLI_endian_switch_int64(&offset);
+        }
+
+        BHeadN *new_bhead = (offset >= offset_min) ?
+                                bhead_index_read_at(fd, fd->bhead_list.last, offset) :
+                                NULL;
+        if (new_bhead == NULL || new_bhead->bhead.code == DATA) {
+          ok = false;
+        }
+        else {
+          offset_min = offset + bhead_file_size(fd) + new_bhead->bhead.len;
+        }
+      }
+
+      /* The index always ends with the #ENDB block. */
+      if (ok && ((BHeadN *)fd->bhead_list.last)->bhead.code != ENDB) {
+        ok = false;
+      }
+    }
+
+    if (index_bhead) {
+      MEM_freeN(index_bhead);
+    }
+  }
+
+  if (ok) {
+    fd->flags |= FD_FLAGS_USE_BHEAD_INDEX;
+  }
+  else {
+    BLI_freelistN(&fd->bhead_list);
+  }
+
+  fd->is_eof = false;
+  fd->seek(fd, offset_backup, SEEK_SET);
+
+  return ok;
+}
+
+#endif /* USE_BHEAD_INDEX */
+
 BHead *blo_bhead_first(FileData *fd)
 {
   BHeadN *new_bhead;
@@ -916,7 +1055,16 @@ BHead *blo_bhead_first(FileData *fd)
    * Read in a new block if necessary
    */
   new_bhead = fd->bhead_list.first;
-  if (new_bhead == NULL) {
+#ifdef USE_BHEAD_INDEX
+  if (fd->flags & FD_FLAGS_USE_BHEAD_INDEX) {
+    /* Blocks before the first indexed one are not in the list yet. */
+    if (new_bhead->file_offset - bhead_file_size(fd) != SIZEOFBLENDERHEADER) {
+      new_bhead = bhead_index_read_at(fd, NULL, SIZEOFBLENDERHEADER);
+    }
+  }
+  else
+#endif
+      if (new_bhead == NULL) {
     new_bhead = get_bhead(fd);
   }
 
@@ -945,10 +1093,29 @@ BHead *blo_bhead_next(FileData *fd, BHead *thisblock)
      * We calculate the BHeadN pointer from the BHead pointer below */
     new_bhead = BHEADN_FROM_BHEAD(thisblock);
 
-    /* get the next BHeadN. If it doesn't exist we read in the next one */
-    new_bhead = new_bhead->next;
-    if (new_bhead == NULL) {
-      new_bhead = get_bhead(fd);
+#ifdef USE_BHEAD_INDEX
+    if (fd->flags & FD_FLAGS_USE_BHEAD_INDEX) {
+      /* Only indexed blocks and the ones read so far are in the list,
+       * read the next one when there is a gap. */
+      if (new_bhead->bhead.code == ENDB) {
+        return NULL;
+      }
+      const off64_t offset_next = new_bhead->file_offset + new_bhead->bhead.len;
+      BHeadN *new_bhead_next = new_bhead->next;
+      if ((new_bhead_next == NULL) ||
+          (new_bhead_next->file_offset - bhead_file_size(fd) != offset_next)) {
+        new_bhead_next = bhead_index_read_at(fd, new_bhead, offset_next);
+      }
+      new_bhead = new_bhead_next;
+    }
+    else
+#endif
+    {
+      /* get the next BHeadN. If it doesn't exist we read in the next one */
+      new_bhead = new_bhead->next;
+      if (new_bhead == NULL) {
+        new_bhead = get_bhead(fd);
+      }
     }
   }
 
@@ -961,6 +1128,35 @@ BHead *blo_bhead_next(FileData *fd, BHead *thisblock)
   return bhead;
 }
 
+/**
+ * Same as #blo_bhead_next, skipping #DATA blocks.
+ * When the file has an index, this doesn't need to read them at all.
+ */
+BHead *blo_bhead_next_skip_data(FileData *fd, BHead *thisblock)
+{
+  BHead *bhead = thisblock;
+
+#ifdef USE_BHEAD_INDEX
+  if (fd->flags & FD_FLAGS_USE_BHEAD_INDEX) {
+    /* All blocks other than #DATA are in the list. */
+    if (bhead->code == ENDB) {
+      return NULL;
+    }
+    BHeadN *new_bhead = BHEADN_FROM_BHEAD(bhead)->next;
+    while (new_bhead && new_bhead->bhead.code == DATA) {
+      new_bhead = new_bhead->next;
+    }
+    return new_bhead ? &new_bhead->bhead : NULL;
+  }
+#endif
+
+  do {
+    bhead = blo_bhead_next(fd, bhead);
+  } while (bhead && bhead->code == DATA);
+
+  return bhead;
+}
+
 #ifdef USE_BHEAD_READ_ON_DEMAND
 static bool blo_bhead_read_data(FileData *fd, BHead *thisblock, void *buf)
 {
@@ -982,6 +1178,20 @@ static bool blo_bhead_read_data(FileData *fd, BHead *thisblock, void *buf)
   return success;
 }
 
+/**
+ * \return The data of a block which wasn't read yet, directly in the memory mapped file,
+ * NULL when the file isn't mapped.
+ */
+static const void *blo_bhead_data_mapped(FileData *fd, BHead *thisblock)
+{
+  BHeadN *new_bhead = BHEADN_FROM_BHEAD(thisblock);
+  BLI_assert(new_bhead->has_data == false && new_bhead->file_offset != 0);
+  if (fd->mmap_file == NULL || BLI_mmap_any_io_error(fd->mmap_file)) {
+    return NULL;
+  }
+  return POINTER_OFFSET(BLI_mmap_get_pointer(fd->mmap_file), new_bhead->file_offset);
+}
+
 static BHead *blo_bhead_read_full(FileData *fd, BHead *thisblock)
 {
   BHeadN *new_bhead = BHEADN_FROM_BHEAD(thisblock);
@@ -1051,7 +1261,7 @@ static bool read_file_dna(FileData *fd, const char **r_error_message)
   BHead *bhead;
   int subversion = 0;
 
-  for (bhead = blo_bhead_first(fd); bhead; bhead = blo_bhead_next(fd, bhead)) {
+  for (bhead = blo_bhead_first(fd); bhead; bhead = blo_bhead_next_skip_data(fd, bhead)) {
     if (bhead->code == GLOB) {
       /* Before this, the subversion didn't exist in 'FileGlobal' so the subversion
        * value isn't accessible for the purpose of DNA versioning in this case. */
@@ -1075,6 +1285,8 @@ static bool read_file_dna(FileData *fd, const char **r_error_message)
       if (fd->filesdna) {
         blo_do_versions_dna(fd->filesdna, fd->fileversion, subversion);
         fd->compflags = DNA_struct_get_compareflags(fd->filesdna, fd->memsdna);
+        fd->reconstruct_info = DNA_reconstruct_info_create(
+            fd->filesdna, fd->memsdna, fd->compflags);
         /* used to retrieve ID names from (bhead+1) */
         fd->id_name_offs = DNA_elem_offset(fd->filesdna, "ID", "char", "name[]");
 
@@ -1098,7 +1310,7 @@ static int *read_file_thumbnail(FileData *fd)
   BHead *bhead;
   int *blend_thumb = NULL;
 
-  for (bhead = blo_bhead_first(fd); bhead; bhead = blo_bhead_next(fd, bhead)) {
+  for (bhead = blo_bhead_first(fd); bhead; bhead = blo_bhead_next_skip_data(fd, bhead)) {
     if (bhead->code == TEST) {
       const bool do_endian_swap = (fd->flags & FD_FLAGS_SWITCH_ENDIAN) != 0;
       int *data = (int *)(bhead + 1);
@@ -1161,6 +1373,49 @@ static off64_t fd_seek_data_from_file(FileData *filedata, off64_t offset, int wh
   return filedata->file_offset;
 }
 
+/* Memory mapped file reading. */
+
+static int fd_read_from_mmap(FileData *filedata, void *buffer, uint size)
+{
+  /* Don't read more bytes than there are available in the file. */
+  const size_t length = BLI_mmap_get_length(filedata->mmap_file);
+  const uint readsize = (uint)MIN2((uint64_t)size, length - (uint64_t)filedata->file_offset);
+
+  if (!BLI_mmap_read(filedata->mmap_file, buffer, filedata->file_offset, readsize)) {
+    return EOF;
+  }
+  filedata->file_offset += readsize;
+
+  return (int)readsize;
+}
+
+static off64_t fd_seek_from_mmap(FileData *filedata, off64_t offset, int whence)
+{
+  const off64_t length = (off64_t)BLI_mmap_get_length(filedata->mmap_file);
+  off64_t new_offset;
+
+  switch (whence) {
+    case SEEK_SET:
+      new_offset = offset;
+      break;
+    case SEEK_CUR:
+      new_offset = filedata->file_offset + offset;
+      break;
+    case SEEK_END:
+      new_offset = length + offset;
+      break;
+    default:
+      return -1;
+  }
+
+  if (new_offset < 0 || new_offset > length) {
+    return -1;
+  }
+
+  filedata->file_offset = new_offset;
+  return new_offset;
+}
+
 /* GZip file reading. */
 
 static int fd_read_gzip_from_file(FileData *filedata, void *buffer, uint size)
@@ -1177,132 +1432,491 @@ static int fd_read_gzip_from_file(FileData *filedata, void *buffer, uint size)
   return (readsize);
 }
 
-/* Memory reading. */
+#ifdef WITH_ZSTD
 
-static int fd_read_from_memory(FileData *filedata, void *buffer, uint size)
-{
-  /* don't read more bytes then there are available in the buffer */
-  int readsize = (int)MIN2(size, (uint)(filedata->buffersize - filedata->file_offset));
+/* Zstd file reading.
+ *
+ * Files with a seek table (as written by #BLO_write_file) are decompressed
+ * a batch of frames at a time, in parallel, and support seeking.
+ * Other zstd streams are decompressed sequentially. */
 
-  memcpy(buffer, filedata->buffer + filedata->file_offset, readsize);
-  filedata->file_offset += readsize;
+/** Maximum number of frames decompressed at once when reading sequentially. */
+#  define ZSTD_READ_BATCH_FRAMES_MAX 64
 
-  return (readsize);
-}
+typedef struct ZstdReadFrame {
+  int64_t compressed_offset;
+  int64_t uncompressed_offset;
+  uint32_t compressed_size;
+  uint32_t uncompressed_size;
+} ZstdReadFrame;
 
-/* MemFile reading. */
+typedef struct ZstdReader {
+  /** Seek table, NULL when the stream doesn't have one. */
+  ZstdReadFrame *frames;
+  int frames_num;
+  int64_t uncompressed_size;
 
-static int fd_read_from_memfile(FileData *filedata, void *buffer, uint size)
-{
-  static size_t seek = SIZE_MAX; /* the current position */
-  static size_t offset = 0;      /* size of previous chunks */
-  static MemFileChunk *chunk = NULL;
-  size_t chunkoffset, readsize, totread;
+  /** Decompressed data of frames `[batch_frame_first, batch_frame_first + batch_frames_num)`. */
+  char *batch_buf;
+  int batch_frame_first;
+  int batch_frames_num;
 
-  if (size == 0) {
-    return 0;
-  }
+  /** Streaming decompression, when there is no seek table. */
+  ZSTD_DCtx *dctx;
+  ZSTD_inBuffer in;
+  void *in_buf;
+  size_t in_buf_size;
+} ZstdReader;
 
-  if (seek != (size_t)filedata->file_offset) {
-    chunk = filedata->memfile->chunks.first;
-    seek = 0;
+static uint32_t zstd_uint32_from_le(const uchar *data)
+{
+  return ((uint32_t)data[0]) | ((uint32_t)data[1] << 8) | ((uint32_t)data[2] << 16) |
+         ((uint32_t)data[3] << 24);
+}
 
-    while (chunk) {
-      if (seek + chunk->size > (size_t)filedata->file_offset) {
-        break;
-      }
-      seek += chunk->size;
-      chunk = chunk->next;
-    }
-    offset = seek;
-    seek = filedata->file_offset;
+static bool zstd_read_exact(int file, off64_t offset, void *buf, size_t len)
+{
+  if (lseek(file, offset, SEEK_SET) != offset) {
+    return false;
   }
+  return ((size_t)read(file, buf, len) == len);
+}
 
-  if (chunk) {
-    totread = 0;
-
-    do {
-      /* first check if it's on the end if current chunk */
-      if (seek - offset == chunk->size) {
-        offset += chunk->size;
-        chunk = chunk->next;
-      }
+/**
+ * Read the seek table at the end of the file.
+ * \return false when the file has no (valid) seek table.
+ */
+static bool zstd_read_seek_table(ZstdReader *zr, int file)
+{
+  uchar footer[BLEND_ZSTD_SEEK_TABLE_FOOTER_SIZE];
+  const off64_t file_size = lseek(file, 0, SEEK_END);
+  if (file_size < (off64_t)(sizeof(footer) + 8)) {
+    return false;
+  }
+  if (!zstd_read_exact(file, file_size - (off64_t)sizeof(footer), footer, sizeof(footer))) {
+    return false;
+  }
+  if (zstd_uint32_from_le(&footer[5]) != BLEND_ZSTD_SEEKABLE_MAGIC) {
+    return false;
+  }
 
-      /* debug, should never happen */
-      if (chunk == NULL) {
-        printf("illegal read, chunk zero\n");
-        return 0;
-      }
+  const uint32_t frames_num = zstd_uint32_from_le(&footer[0]);
+  const uchar descriptor = footer[4];
+  /* Reserved bits must be zero. */
+  if (descriptor & 0x7c) {
+    return false;
+  }
+  const size_t entry_size = (descriptor & 0x80) ? 12 : 8;
+  const size_t table_size = (size_t)frames_num * entry_size + sizeof(footer);
+  const off64_t table_offset = file_size - (off64_t)table_size - 8;
+  if (frames_num == 0 || table_offset < 0) {
+    return false;
+  }
 
-      chunkoffset = seek - offset;
-      readsize = size - totread;
+  uchar header[8];
+  if (!zstd_read_exact(file, table_offset, header, sizeof(header)) ||
+      zstd_uint32_from_le(&header[0]) != BLEND_ZSTD_SKIPPABLE_MAGIC ||
+      zstd_uint32_from_le(&header[4]) != table_size) {
+    return false;
+  }
 
-      /* data can be spread over multiple chunks, so clamp size
-       * to within this chunk, and then it will read further in
-       * the next chunk */
-      if (chunkoffset + readsize > chunk->size) {
-        readsize = chunk->size - chunkoffset;
-      }
+  uchar *entries = MEM_mallocN(table_size, __func__);
+  if (!zstd_read_exact(file, table_offset + 8, entries, table_size)) {
+    MEM_freeN(entries);
+    return false;
+  }
 
-      memcpy(POINTER_OFFSET(buffer, totread), chunk->buf + chunkoffset, readsize);
-      totread += readsize;
-      filedata->file_offset += readsize;
-      seek += readsize;
-    } while (totread < size);
+  ZstdReadFrame *frames = MEM_mallocN(sizeof(*frames) * frames_num, __func__);
+  int64_t compressed_offset = 0, uncompressed_offset = 0;
+  for (uint32_t i = 0; i < frames_num; i++) {
+    const uchar *entry = &entries[i * entry_size];
+    frames[i].compressed_offset = compressed_offset;
+    frames[i].uncompressed_offset = uncompressed_offset;
+    frames[i].compressed_size = zstd_uint32_from_le(&entry[0]);
+    frames[i].uncompressed_size = zstd_uint32_from_le(&entry[4]);
+    compressed_offset += frames[i].compressed_size;
+    uncompressed_offset += frames[i].uncompressed_size;
+  }
+  MEM_freeN(entries);
 
-    return totread;
+  if (compressed_offset != table_offset) {
+    MEM_freeN(frames);
+    return false;
   }
 
-  return 0;
+  zr->frames = frames;
+  zr->frames_num = (int)frames_num;
+  zr->uncompressed_size = uncompressed_offset;
+  return true;
 }
 
-static FileData *filedata_new(void)
+/** \return The index of the frame containing \a offset, -1 when past the end. */
+static int zstd_frame_find(const ZstdReader *zr, int64_t offset)
 {
-  FileData *fd = MEM_callocN(sizeof(FileData), "FileData");
+  if (offset < 0 || offset >= zr->uncompressed_size) {
+    return -1;
+  }
+  int low = 0, high = zr->frames_num;
+  while (high - low > 1) {
+    const int mid = (low + high) / 2;
+    if (zr->frames[mid].uncompressed_offset <= offset) {
+      low = mid;
+    }
+    else {
+      high = mid;
+    }
+  }
+  return low;
+}
 
-  fd->filedes = -1;
-  fd->gzfiledes = NULL;
+typedef struct ZstdBatchData {
+  const ZstdReader *zr;
+  const char *compressed_buf;
+  bool error;
+} ZstdBatchData;
 
-  fd->memsdna = DNA_sdna_current_get();
+static void zstd_decompress_frame_cb(void *__restrict userdata,
+                                     const int iter,
+                                     const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  ZstdBatchData *data = userdata;
+  const ZstdReader *zr = data->zr;
+  const ZstdReadFrame *frame_first = &zr->frames[zr->batch_frame_first];
+  const ZstdReadFrame *frame = &frame_first[iter];
 
-  fd->datamap = oldnewmap_new();
-  fd->globmap = oldnewmap_new();
-  fd->libmap = oldnewmap_new();
+  const size_t len = ZSTD_decompress(
+      zr->batch_buf + (frame->uncompressed_offset - frame_first->uncompressed_offset),
+      frame->uncompressed_size,
+      data->compressed_buf + (frame->compressed_offset - frame_first->compressed_offset),
+      frame->compressed_size);
 
-  return fd;
+  if (ZSTD_isError(len) || len != frame->uncompressed_size) {
+    data->error = true;
+  }
 }
 
-static FileData *blo_decode_and_check(FileData *fd, ReportList *reports)
+/**
+ * Decompress the frames starting at \a frame_index. When reading sequentially,
+ * a batch of frames is decompressed in parallel, otherwise only the frame needed is.
+ */
+static bool zstd_read_batch(FileData *fd, int frame_index)
 {
-  decode_blender_header(fd);
+  ZstdReader *zr = fd->zstd;
 
-  if (fd->flags & FD_FLAGS_FILE_OK) {
-    const char *error_message = NULL;
-    if (read_file_dna(fd, &error_message) == false) {
-      BKE_reportf(
-          reports, RPT_ERROR, "Failed to read blend file '%s': %s", fd->relabase, error_message);
-      blo_filedata_free(fd);
-      fd = NULL;
-    }
-  }
-  else {
-    BKE_reportf(
-        reports, RPT_ERROR, "Failed to read blend file '%s', not a blend file", fd->relabase);
-    blo_filedata_free(fd);
-    fd = NULL;
+  int frames_num = 1;
+  if (frame_index == zr->batch_frame_first + zr->batch_frames_num) {
+    frames_num = min_ii(BLI_system_thread_count(), ZSTD_READ_BATCH_FRAMES_MAX);
+    frames_num = min_ii(frames_num, zr->frames_num - frame_index);
   }
 
-  return fd;
-}
+  const ZstdReadFrame *frame_first = &zr->frames[frame_index];
+  const ZstdReadFrame *frame_last = &zr->frames[frame_index + frames_num - 1];
+  const size_t compressed_size = (size_t)(frame_last->compressed_offset -
+                                          frame_first->compressed_offset) +
+                                 frame_last->compressed_size;
+  const size_t uncompressed_size = (size_t)(frame_last->uncompressed_offset -
+                                            frame_first->uncompressed_offset) +
+                                   frame_last->uncompressed_size;
 
-static FileData *blo_filedata_from_file_descriptor(const char *filepath,
-                                                   ReportList *reports,
-                                                   int file)
-{
-  FileDataReadFn *read_fn = NULL;
-  FileDataSeekFn *seek_fn = NULL; /* Optional. */
+  MEM_SAFE_FREE(zr->batch_buf);
+  zr->batch_frames_num = 0;
 
-  gzFile gzfile = (gzFile)Z_NULL;
+  char *compressed_buf = MEM_mallocN(compressed_size, __func__);
+  if (!zstd_read_exact(
+          fd->filedes, frame_first->compressed_offset, compressed_buf, compressed_size)) {
+    MEM_freeN(compressed_buf);
+    return false;
+  }
+
+  zr->batch_buf = MEM_mallocN(uncompressed_size, __func__);
+  zr->batch_frame_first = frame_index;
+
+  ZstdBatchData data = {
+      .zr = zr,
+      .compressed_buf = compressed_buf,
+      .error = false,
+  };
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+  settings.use_threading = (frames_num > 1);
+  settings.min_iter_per_thread = 1;
+  BLI_task_parallel_range(0, frames_num, &data, zstd_decompress_frame_cb, &settings);
+
+  MEM_freeN(compressed_buf);
+
+  if (data.error) {
+    MEM_SAFE_FREE(zr->batch_buf);
+    return false;
+  }
+
+  zr->batch_frames_num = frames_num;
+  return true;
+}
+
+static int fd_read_zstd_from_file(FileData *filedata, void *buffer, uint size)
+{
+  ZstdReader *zr = filedata->zstd;
+  uint read_len = 0;
+
+  while (read_len < size) {
+    const int frame_index = zstd_frame_find(zr, filedata->file_offset);
+    if (frame_index == -1) {
+      break;
+    }
+
+    if (frame_index < zr->batch_frame_first ||
+        frame_index >= zr->batch_frame_first + zr->batch_frames_num) {
+      if (!zstd_read_batch(filedata, frame_index)) {
+        return EOF;
+      }
+    }
+
+    const ZstdReadFrame *frame_first = &zr->frames[zr->batch_frame_first];
+    const ZstdReadFrame *frame_last = &zr->frames[zr->batch_frame_first + zr->batch_frames_num -
+                                                  1];
+    const int64_t batch_offset = filedata->file_offset - frame_first->uncompressed_offset;
+    const int64_t batch_size = (frame_last->uncompressed_offset + frame_last->uncompressed_size) -
+                               frame_first->uncompressed_offset;
+    const uint len = (uint)min_ii((int)(size - read_len), (int)(batch_size - batch_offset));
+
+    memcpy(POINTER_OFFSET(buffer, read_len), zr->batch_buf + batch_offset, len);
+    filedata->file_offset += len;
+    read_len += len;
+  }
+
+  return (int)read_len;
+}
+
+static off64_t fd_seek_zstd_from_file(FileData *filedata, off64_t offset, int whence)
+{
+  ZstdReader *zr = filedata->zstd;
+  off64_t new_offset;
+
+  switch (whence) {
+    case SEEK_SET:
+      new_offset = offset;
+      break;
+    case SEEK_CUR:
+      new_offset = filedata->file_offset + offset;
+      break;
+    case SEEK_END:
+      new_offset = zr->uncompressed_size + offset;
+      break;
+    default:
+      return -1;
+  }
+
+  if (new_offset < 0 || new_offset > zr->uncompressed_size) {
+    return -1;
+  }
+
+  filedata->file_offset = new_offset;
+  return new_offset;
+}
+
+/* Streams without seek table, from a file or from memory. */
+static int fd_read_zstd_stream(FileData *filedata, void *buffer, uint size)
+{
+  ZstdReader *zr = filedata->zstd;
+  ZSTD_outBuffer out = {buffer, size, 0};
+
+  while (out.pos < out.size) {
+    if (zr->in.pos == zr->in.size) {
+      if (filedata->filedes == -1) {
+        break;
+      }
+      const int len = read(filedata->filedes, zr->in_buf, zr->in_buf_size);
+      if (len <= 0) {
+        break;
+      }
+      zr->in.src = zr->in_buf;
+      zr->in.size = (size_t)len;
+      zr->in.pos = 0;
+    }
+
+    const size_t ret = ZSTD_decompressStream(zr->dctx, &out, &zr->in);
+    if (ZSTD_isError(ret)) {
+      blo_reportf_wrap(filedata->reports,
+                       RPT_ERROR,
+                       TIP_("Failed to decompress blend file: %s"),
+                       ZSTD_getErrorName(ret));
+      return EOF;
+    }
+  }
+
+  filedata->file_offset += out.pos;
+  return (int)out.pos;
+}
+
+static ZstdReader *zstd_reader_stream_new(const void *mem, size_t memsize)
+{
+  ZstdReader *zr = MEM_callocN(sizeof(*zr), __func__);
+  zr->dctx = ZSTD_createDCtx();
+
+  if (mem != NULL) {
+    zr->in.src = mem;
+    zr->in.size = memsize;
+  }
+  else {
+    zr->in_buf_size = ZSTD_DStreamInSize();
+    zr->in_buf = MEM_mallocN(zr->in_buf_size, __func__);
+  }
+  return zr;
+}
+
+static void zstd_reader_free(ZstdReader *zr)
+{
+  if (zr->dctx) {
+    ZSTD_freeDCtx(zr->dctx);
+  }
+  MEM_SAFE_FREE(zr->in_buf);
+  MEM_SAFE_FREE(zr->frames);
+  MEM_SAFE_FREE(zr->batch_buf);
+  MEM_freeN(zr);
+}
+
+static bool zstd_is_header(const char *header)
+{
+  return (zstd_uint32_from_le((const uchar *)header) == BLEND_ZSTD_FRAME_MAGIC);
+}
+
+#endif /* WITH_ZSTD */
+
+/* Memory reading. */
+
+static int fd_read_from_memory(FileData *filedata, void *buffer, uint size)
+{
+  /* don't read more bytes then there are available in the buffer */
+  int readsize = (int)MIN2(size, (uint)(filedata->buffersize - filedata->file_offset));
+
+  memcpy(buffer, filedata->buffer + filedata->file_offset, readsize);
+  filedata->file_offset += readsize;
+
+  return (readsize);
+}
+
+/* MemFile reading. */
+
+static int fd_read_from_memfile(FileData *filedata, void *buffer, uint size)
+{
+  static size_t seek = SIZE_MAX; /* the current position */
+  static size_t offset = 0;      /* size of previous chunks */
+  static MemFileChunk *chunk = NULL;
+  size_t chunkoffset, readsize, totread;
+
+  if (size == 0) {
+    return 0;
+  }
+
+  if (seek != (size_t)filedata->file_offset) {
+    chunk = filedata->memfile->chunks.first;
+    seek = 0;
+
+    while (chunk) {
+      if (seek + chunk->size > (size_t)filedata->file_offset) {
+        break;
+      }
+      seek += chunk->size;
+      chunk = chunk->next;
+    }
+    offset = seek;
+    seek = filedata->file_offset;
+  }
+
+  if (chunk) {
+    totread = 0;
+
+    do {
+      /* first check if it's on the end if current chunk */
+      if (seek - offset == chunk->size) {
+        offset += chunk->size;
+        chunk = chunk->next;
+      }
+
+      /* debug, should never happen */
+      if (chunk == NULL) {
+        printf("illegal read, chunk zero\n");
+        return 0;
+      }
+
+      chunkoffset = seek - offset;
+      readsize = size - totread;
+
+      /* data can be spread over multiple chunks, so clamp size
+       * to within this chunk, and then it will read further in
+       * the next chunk */
+      if (chunkoffset + readsize > chunk->size) {
+        readsize = chunk->size - chunkoffset;
+      }
+
+      memcpy(POINTER_OFFSET(buffer, totread), chunk->buf + chunkoffset, readsize);
+      totread += readsize;
+      filedata->file_offset += readsize;
+      seek += readsize;
+    } while (totread < size);
+
+    return totread;
+  }
+
+  return 0;
+}
+
+static FileData *filedata_new(void)
+{
+  FileData *fd = MEM_callocN(sizeof(FileData), "FileData");
+
+  fd->filedes = -1;
+  fd->gzfiledes = NULL;
+
+  fd->memsdna = DNA_sdna_current_get();
+
+  fd->datamap = oldnewmap_new();
+  fd->globmap = oldnewmap_new();
+  fd->libmap = oldnewmap_new();
+
+  return fd;
+}
+
+static FileData *blo_decode_and_check(FileData *fd, ReportList *reports)
+{
+  decode_blender_header(fd);
+
+  if (fd->flags & FD_FLAGS_FILE_OK) {
+    const char *error_message = NULL;
+#ifdef USE_BHEAD_INDEX
+    if (fd->seek != NULL) {
+      read_bhead_index(fd);
+    }
+#endif
+    if (read_file_dna(fd, &error_message) == false) {
+      BKE_reportf(
+          reports, RPT_ERROR, "Failed to read blend file '%s': %s", fd->relabase, error_message);
+      blo_filedata_free(fd);
+      fd = NULL;
+    }
+  }
+  else {
+    BKE_reportf(
+        reports, RPT_ERROR, "Failed to read blend file '%s', not a blend file", fd->relabase);
+    blo_filedata_free(fd);
+    fd = NULL;
+  }
+
+  return fd;
+}
+
+static FileData *blo_filedata_from_file_descriptor(const char *filepath,
+                                                   ReportList *reports,
+                                                   int file)
+{
+  FileDataReadFn *read_fn = NULL;
+  FileDataSeekFn *seek_fn = NULL; /* Optional. */
+
+  gzFile gzfile = (gzFile)Z_NULL;
+  BLI_mmap_file *mmap_file = NULL;
+#ifdef WITH_ZSTD
+  ZstdReader *zstd = NULL;
+#endif
 
   char header[7];
 
@@ -1322,8 +1936,17 @@ static FileData *blo_filedata_from_file_descriptor(const char *filepath,
 
   /* Regular file. */
   if (memcmp(header, "BLENDER", sizeof(header)) == 0) {
-    read_fn = fd_read_data_from_file;
-    seek_fn = fd_seek_data_from_file;
+    /* Map the file when possible, avoiding a system call for every read. */
+    mmap_file = BLI_mmap_open(file);
+    if (mmap_file != NULL) {
+      read_fn = fd_read_from_mmap;
+      seek_fn = fd_seek_from_mmap;
+    }
+    else {
+      read_fn = fd_read_data_from_file;
+      seek_fn = fd_seek_data_from_file;
+    }
+    lseek(file, 0, SEEK_SET);
   }
 
   /* Gzip file. */
@@ -1348,6 +1971,23 @@ static FileData *blo_filedata_from_file_descriptor(const char *filepath,
     }
   }
 
+#ifdef WITH_ZSTD
+  /* Zstd file. */
+  if ((read_fn == NULL) && zstd_is_header(header)) {
+    zstd = MEM_callocN(sizeof(*zstd), __func__);
+    if (zstd_read_seek_table(zstd, file)) {
+      read_fn = fd_read_zstd_from_file;
+      seek_fn = fd_seek_zstd_from_file;
+    }
+    else {
+      MEM_freeN(zstd);
+      zstd = zstd_reader_stream_new(NULL, 0);
+      read_fn = fd_read_zstd_stream;
+    }
+    lseek(file, 0, SEEK_SET);
+  }
+#endif
+
   if (read_fn == NULL) {
     BKE_reportf(reports, RPT_WARNING, "Unrecognized file format '%s'", filepath);
     return NULL;
@@ -1356,7 +1996,11 @@ static FileData *blo_filedata_from_file_descriptor(const char *filepath,
   FileData *fd = filedata_new();
 
   fd->filedes = file;
+  fd->mmap_file = mmap_file;
   fd->gzfiledes = gzfile;
+#ifdef WITH_ZSTD
+  fd->zstd = zstd;
+#endif
 
   fd->read = read_fn;
   fd->seek = seek_fn;
@@ -1475,6 +2119,12 @@ FileData *blo_filedata_from_memory(const void *mem, int memsize, ReportList *rep
         return NULL;
       }
     }
+#ifdef WITH_ZSTD
+    else if (zstd_is_header(cp)) {
+      fd->zstd = zstd_reader_stream_new(mem, (size_t)memsize);
+      fd->read = fd_read_zstd_stream;
+    }
+#endif
     else {
       fd->read = fd_read_from_memory;
     }
@@ -1505,6 +2155,10 @@ FileData *blo_filedata_from_memfile(MemFile *memfile, ReportList *reports)
 void blo_filedata_free(FileData *fd)
 {
   if (fd) {
+    if (fd->mmap_file) {
+      BLI_mmap_free(fd->mmap_file);
+    }
+
     if (fd->filedes != -1) {
       close(fd->filedes);
     }
@@ -1519,6 +2173,12 @@ void blo_filedata_free(FileData *fd)
       }
     }
 
+#ifdef WITH_ZSTD
+    if (fd->zstd) {
+      zstd_reader_free(fd->zstd);
+    }
+#endif
+
     if (fd->buffer && !(fd->flags & FD_FLAGS_NOT_MY_BUFFER)) {
       MEM_freeN((void *)fd->buffer);
       fd->buffer = NULL;
@@ -1543,6 +2203,9 @@ void blo_filedata_free(FileData *fd)
     if (fd->compflags) {
       MEM_freeN((void *)fd->compflags);
     }
+    if (fd->reconstruct_info) {
+      DNA_reconstruct_info_free(fd->reconstruct_info);
+    }
 
     if (fd->datamap) {
       oldnewmap_free(fd->datamap);
@@ -1562,6 +2225,9 @@ void blo_filedata_free(FileData *fd)
     if (fd->soundmap) {
       oldnewmap_free(fd->soundmap);
     }
+    if (fd->undo_reuse_id_map) {
+      BLI_ghash_free(fd->undo_reuse_id_map, NULL, NULL);
+    }
     if (fd->packedmap) {
       oldnewmap_free(fd->packedmap);
     }
@@ -2070,43 +2736,131 @@ void blo_end_sound_pointer_map(FileData *fd, Main *oldmain)
   }
 }
 
-/* XXX disabled this feature - packed files also belong in temp saves and quit.blend,
- * to make restore work. */
-
-static void insert_packedmap(FileData *fd, PackedFile *pf)
+/**
+ * Whether an ID of the old main can be kept as is on undo when its data didn't change.
+ *
+ * Limited to ID types whose runtime data doesn't refer to other IDs, pointers to other IDs
+ * stored in the file are restored by the regular lib-linking.
+ */
+static bool undo_reuse_id_is_supported(const ID *id)
 {
-  oldnewmap_insert(fd->packedmap, pf, pf, 0);
-  oldnewmap_insert(fd->packedmap, pf->data, pf->data, 0);
+  if (!ELEM(GS(id->name), ID_ME, ID_CA, ID_LA)) {
+    return false;
+  }
+  if (id->lib != NULL || id->override_library != NULL || id->recalc_after_undo_push != 0) {
+    return false;
+  }
+  const bNodeTree *ntree = ntreeFromID((ID *)id);
+  if (ntree != NULL && ntree->id.recalc_after_undo_push != 0) {
+    return false;
+  }
+  if (GS(id->name) == ID_ME && ((const Mesh *)id)->edit_mesh != NULL) {
+    return false;
+  }
+  return true;
 }
 
-void blo_make_packed_pointer_map(FileData *fd, Main *oldmain)
+/**
+ * Make a lookup of the IDs of the old main which are kept in place on undo, instead of being read
+ * again. Those are untouched since \a reference_memfile was written from the old main, and their
+ * data is shared between \a reference_memfile and the memfile being read.
+ */
+void blo_make_undo_reuse_id_map(FileData *fd, Main *oldmain, const MemFile *reference_memfile)
 {
-  Image *ima;
-  VFont *vfont;
-  bSound *sound;
-  Library *lib;
-
-  fd->packedmap = oldnewmap_new();
+  fd->undo_reuse_id_map = NULL;
 
-  for (ima = oldmain->images.first; ima; ima = ima->id.next) {
-    ImagePackedFile *imapf;
+  if (reference_memfile == NULL || reference_memfile->serial == 0 ||
+      reference_memfile->serial != oldmain->memfile_undo_serial) {
+    return;
+  }
 
-    if (ima->packedfile) {
-      insert_packedmap(fd, ima->packedfile);
-    }
+  GSet *shared_ids = memfile_shared_id_session_uuids_get(fd->memfile, reference_memfile);
+  fd->undo_reuse_id_map = BLI_ghash_int_new(__func__);
 
-    for (imapf = ima->packedfiles.first; imapf; imapf = imapf->next) {
-      if (imapf->packedfile) {
-        insert_packedmap(fd, imapf->packedfile);
+  ListBase *lbarray[] = {&oldmain->meshes, &oldmain->cameras, &oldmain->lights};
+  for (int i = 0; i < ARRAY_SIZE(lbarray); i++) {
+    LISTBASE_FOREACH (ID *, id, lbarray[i]) {
+      if (undo_reuse_id_is_supported(id) &&
+          BLI_gset_haskey(shared_ids, POINTER_FROM_UINT(id->session_uuid))) {
+        BLI_ghash_insert(fd->undo_reuse_id_map, POINTER_FROM_UINT(id->session_uuid), id);
       }
     }
   }
 
-  for (vfont = oldmain->fonts.first; vfont; vfont = vfont->id.next) {
-    if (vfont->packedfile) {
-      insert_packedmap(fd, vfont->packedfile);
-    }
-  }
+  BLI_gset_free(shared_ids, NULL);
+}
+
+static int undo_reuse_id_tag_changed_cb(LibraryIDLinkCallbackData *cb_data)
+{
+  ID *id = *cb_data->id_pointer;
+  if (id != NULL && id->lib == NULL && (cb_data->cb_flag & IDWALK_CB_EMBEDDED) == 0 &&
+      id->recalc_after_undo_push != 0) {
+    cb_data->id_self->recalc_after_undo_push |= ID_RECALC_ALL;
+  }
+  return IDWALK_RET_NOP;
+}
+
+/**
+ * Kept IDs pointing to IDs which were read again now differ from their data in the memfile,
+ * since those IDs got a new address.
+ */
+void blo_end_undo_reuse_id_map(FileData *fd, Main *newmain)
+{
+  if (fd->undo_reuse_id_map == NULL) {
+    return;
+  }
+
+  BLI_ghash_free(fd->undo_reuse_id_map, NULL, NULL);
+  fd->undo_reuse_id_map = NULL;
+
+  ListBase *lbarray[] = {&newmain->meshes, &newmain->cameras, &newmain->lights};
+  for (int i = 0; i < ARRAY_SIZE(lbarray); i++) {
+    LISTBASE_FOREACH (ID *, id, lbarray[i]) {
+      if (id->recalc_after_undo_push == 0) {
+        BKE_library_foreach_ID_link(
+            newmain, id, undo_reuse_id_tag_changed_cb, NULL, IDWALK_READONLY);
+      }
+    }
+  }
+}
+
+/* XXX disabled this feature - packed files also belong in temp saves and quit.blend,
+ * to make restore work. */
+
+static void insert_packedmap(FileData *fd, PackedFile *pf)
+{
+  oldnewmap_insert(fd->packedmap, pf, pf, 0);
+  oldnewmap_insert(fd->packedmap, pf->data, pf->data, 0);
+}
+
+void blo_make_packed_pointer_map(FileData *fd, Main *oldmain)
+{
+  Image *ima;
+  VFont *vfont;
+  bSound *sound;
+  Library *lib;
+
+  fd->packedmap = oldnewmap_new();
+
+  for (ima = oldmain->images.first; ima; ima = ima->id.next) {
+    ImagePackedFile *imapf;
+
+    if (ima->packedfile) {
+      insert_packedmap(fd, ima->packedfile);
+    }
+
+    for (imapf = ima->packedfiles.first; imapf; imapf = imapf->next) {
+      if (imapf->packedfile) {
+        insert_packedmap(fd, imapf->packedfile);
+      }
+    }
+  }
+
+  for (vfont = oldmain->fonts.first; vfont; vfont = vfont->id.next) {
+    if (vfont->packedfile) {
+      insert_packedmap(fd, vfont->packedfile);
+    }
+  }
 
   for (sound = oldmain->sounds.first; sound; sound = sound->id.next) {
     if (sound->packedfile) {
@@ -2203,6 +2957,72 @@ static void switch_endian_structs(const struct SDNA *filesdna, BHead *bhead)
   }
 }
 
+/* Arrays of at least this many structs are converted using multiple threads. */
+#define RECONSTRUCT_PARALLEL_BLOCKS_MIN 1024
+/* Number of structs converted by a single task. */
+#define RECONSTRUCT_PARALLEL_CHUNK_SIZE 256
+
+typedef struct ReconstructParallelData {
+  const struct DNA_ReconstructInfo *reconstruct_info;
+  int old_struct_nr;
+  int blocks;
+  const void *old_blocks;
+  void *new_blocks;
+} ReconstructParallelData;
+
+static void read_struct_reconstruct_cb(void *__restrict userdata,
+                                       const int chunk,
+                                       const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  ReconstructParallelData *data = userdata;
+  const int block_start = chunk * RECONSTRUCT_PARALLEL_CHUNK_SIZE;
+  const int block_end = MIN2(block_start + RECONSTRUCT_PARALLEL_CHUNK_SIZE, data->blocks);
+
+  DNA_struct_reconstruct_range(data->reconstruct_info,
+                               data->old_struct_nr,
+                               block_start,
+                               block_end,
+                               data->old_blocks,
+                               data->new_blocks);
+}
+
+/**
+ * Convert the structs of a block that's #SDNA_CMP_NOT_EQUAL,
+ * large arrays (mesh data for e.g.) are converted in parallel.
+ */
+static void *read_struct_reconstruct(FileData *fd, BHead *bh, const void *data)
+{
+  if (bh->nr < RECONSTRUCT_PARALLEL_BLOCKS_MIN) {
+    return DNA_struct_reconstruct(fd->reconstruct_info, bh->SDNAnr, bh->nr, data);
+  }
+
+  const int curlen = DNA_struct_reconstruct_size(fd->reconstruct_info, bh->SDNAnr);
+  if (curlen == 0) {
+    return NULL;
+  }
+
+  ReconstructParallelData reconstruct_data = {
+      .reconstruct_info = fd->reconstruct_info,
+      .old_struct_nr = bh->SDNAnr,
+      .blocks = bh->nr,
+      .old_blocks = data,
+      .new_blocks = MEM_callocN((size_t)bh->nr * curlen, "reconstruct"),
+  };
+
+  const int chunks = (bh->nr + RECONSTRUCT_PARALLEL_CHUNK_SIZE - 1) /
+                     RECONSTRUCT_PARALLEL_CHUNK_SIZE;
+
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+  BLI_task_parallel_range(0,
+                          chunks,
+                          &reconstruct_data,
+                          read_struct_reconstruct_cb,
+                          &settings);
+
+  return reconstruct_data.new_blocks;
+}
+
 static void *read_struct(FileData *fd, BHead *bh, const char *blockname)
 {
   void *temp = NULL;
@@ -2228,17 +3048,30 @@ static void *read_struct(FileData *fd, BHead *bh, const char *blockname)
 
     if (fd->compflags[bh->SDNAnr] != SDNA_CMP_REMOVED) {
       if (fd->compflags[bh->SDNAnr] == SDNA_CMP_NOT_EQUAL) {
+        const void *data = (bh + 1);
 #ifdef USE_BHEAD_READ_ON_DEMAND
+        const void *data_mapped = NULL;
         if (BHEADN_FROM_BHEAD(bh)->has_data == false) {
-          bh = blo_bhead_read_full(fd, bh);
-          if (UNLIKELY(bh == NULL)) {
-            fd->flags &= ~FD_FLAGS_FILE_OK;
-            return NULL;
+          /* Reconstruct from the mapped file directly, instead of reading into a copy first. */
+          data = data_mapped = blo_bhead_data_mapped(fd, bh);
+          if (data_mapped == NULL) {
+            bh = blo_bhead_read_full(fd, bh);
+            if (UNLIKELY(bh == NULL)) {
+              fd->flags &= ~FD_FLAGS_FILE_OK;
+              return NULL;
+            }
+            data = (bh + 1);
           }
         }
 #endif
-        temp = DNA_struct_reconstruct(
-            fd->memsdna, fd->filesdna, fd->compflags, bh->SDNAnr, bh->nr, (bh + 1));
+        temp = read_struct_reconstruct(fd, bh, data);
+#ifdef USE_BHEAD_READ_ON_DEMAND
+        if (data_mapped && UNLIKELY(BLI_mmap_any_io_error(fd->mmap_file))) {
+          fd->flags &= ~FD_FLAGS_FILE_OK;
+          MEM_freeN(temp);
+          temp = NULL;
+        }
+#endif
       }
       else {
         /* SDNA_CMP_EQUAL */
@@ -2701,6 +3534,8 @@ static void direct_link_id(FileData *fd, ID *id)
   if (!fd->memfile) {
     id->recalc = 0;
   }
+  /* The ID gets a new address, it doesn't match the data of any undo step anymore. */
+  id->recalc_after_undo_push = ID_RECALC_ALL;
 
   /* Link direct data of overrides. */
   if (id->override_library) {
@@ -8962,7 +9797,10 @@ static const char *dataname(short id_code)
   return "Data from Lib Block";
 }
 
-static BHead *read_data_into_oldnewmap(FileData *fd, BHead *bhead, const char *allocname)
+static BHead *read_data_into_oldnewmap(FileData *fd,
+                                       OldNewMap *datamap,
+                                       BHead *bhead,
+                                       const char *allocname)
 {
   bhead = blo_bhead_next(fd, bhead);
 
@@ -8980,7 +9818,7 @@ static BHead *read_data_into_oldnewmap(FileData *fd, BHead *bhead, const char *a
 #endif
 
     if (data) {
-      oldnewmap_insert(fd->datamap, bhead->old, data, 0);
+      oldnewmap_insert(datamap, bhead->old, data, 0);
     }
 
     bhead = blo_bhead_next(fd, bhead);
@@ -8989,6 +9827,210 @@ static BHead *read_data_into_oldnewmap(FileData *fd, BHead *bhead, const char *a
   return bhead;
 }
 
+/**
+ * Whether reading the file failed part way: a block couldn't be read or the memory mapped file
+ * was truncated or became inaccessible. Reading stops and #blo_read_file_internal fails.
+ */
+static bool read_file_has_failed(const FileData *fd)
+{
+  return ((fd->flags & FD_FLAGS_FILE_OK) == 0) ||
+         (fd->mmap_file != NULL && BLI_mmap_any_io_error(fd->mmap_file));
+}
+
+/**
+ * Free an ID of which not all data could be read, its pointers can't be restored.
+ */
+static void read_libblock_discard(
+    FileData *fd, Main *main, OldNewMap *datamap, ID *id, const void *id_old)
+{
+  /* Nothing was looked up yet, this frees all data. */
+  oldnewmap_free_unused(datamap);
+
+  OldNew *entry = oldnewmap_lookup_entry(fd->libmap, id_old);
+  if (entry != NULL) {
+    entry->newp = NULL;
+  }
+  BLI_remlink(which_libbase(main, GS(id->name)), id);
+  MEM_freeN(id);
+}
+
+/**
+ * In undo case, keep the ID of the old main in place if its data is the same in the memfile,
+ * see #blo_make_undo_reuse_id_map.
+ *
+ * \return The next bhead after the data of the ID, or NULL when the ID has to be read.
+ */
+static BHead *read_libblock_undo_reuse(
+    FileData *fd, Main *main, BHead *bhead, const int tag, ID **r_id)
+{
+  /* Memfiles are always written with the current DNA. */
+  const ID *id_file = POINTER_OFFSET(bhead, sizeof(*bhead));
+  ID *id = BLI_ghash_lookup(fd->undo_reuse_id_map, POINTER_FROM_UINT(id_file->session_uuid));
+  if (id == NULL || id != bhead->old) {
+    return NULL;
+  }
+
+  Main *oldmain = fd->old_mainlist->first;
+  BLI_remlink(which_libbase(oldmain, GS(id->name)), id);
+  BLI_addtail(which_libbase(main, GS(id->name)), id);
+  oldnewmap_insert(fd->libmap, bhead->old, id, bhead->code);
+
+  /* Pointers to other IDs still have their value in the file, they are restored by the regular
+   * lib-linking. */
+  id->us = ID_FAKE_USERS(id);
+  id->newid = NULL;
+  id->tag = tag | LIB_TAG_NEED_LINK | LIB_TAG_NEW;
+
+  if (r_id) {
+    *r_id = id;
+  }
+
+  bhead = blo_bhead_next(fd, bhead);
+  while (bhead && bhead->code == DATA) {
+    bhead = blo_bhead_next(fd, bhead);
+  }
+  return bhead;
+}
+
+/**
+ * Restore the pointers of the direct data of an ID, read by #read_data_into_oldnewmap.
+ *
+ * \return false when the ID is invalid and has to be freed.
+ */
+static bool direct_link_libblock(FileData *fd, Main *main, const int tag, ID *id)
+{
+  bool wrong_id = false;
+
+  /* init pointers direct data */
+  direct_link_id(fd, id);
+
+  /* That way, we know which data-lock needs do_versions (required currently for linking). */
+  /* Note: doing this after driect_link_id(), which resets that field. */
+  id->tag = tag | LIB_TAG_NEED_LINK | LIB_TAG_NEW;
+
+  switch (GS(id->name)) {
+    case ID_WM:
+      direct_link_windowmanager(fd, (wmWindowManager *)id);
+      break;
+    case ID_SCR:
+      wrong_id = direct_link_screen(fd, (bScreen *)id);
+      break;
+    case ID_SCE:
+      direct_link_scene(fd, (Scene *)id);
+      break;
+    case ID_OB:
+      direct_link_object(fd, (Object *)id);
+      break;
+    case ID_ME:
+      direct_link_mesh(fd, (Mesh *)id);
+      break;
+    case ID_CU:
+      direct_link_curve(fd, (Curve *)id);
+      break;
+    case ID_MB:
+      direct_link_mball(fd, (MetaBall *)id);
+      break;
+    case ID_MA:
+      direct_link_material(fd, (Material *)id);
+      break;
+    case ID_TE:
+      direct_link_texture(fd, (Tex *)id);
+      break;
+    case ID_IM:
+      direct_link_image(fd, (Image *)id);
+      break;
+    case ID_LA:
+      direct_link_light(fd, (Light *)id);
+      break;
+    case ID_VF:
+      direct_link_vfont(fd, (VFont *)id);
+      break;
+    case ID_TXT:
+      direct_link_text(fd, (Text *)id);
+      break;
+    case ID_IP:
+      direct_link_ipo(fd, (Ipo *)id);
+      break;
+    case ID_KE:
+      direct_link_key(fd, (Key *)id);
+      break;
+    case ID_LT:
+      direct_link_latt(fd, (Lattice *)id);
+      break;
+    case ID_WO:
+      direct_link_world(fd, (World *)id);
+      break;
+    case ID_LI:
+      direct_link_library(fd, (Library *)id, main);
+      break;
+    case ID_CA:
+      direct_link_camera(fd, (Camera *)id);
+      break;
+    case ID_SPK:
+      direct_link_speaker(fd, (Speaker *)id);
+      break;
+    case ID_SO:
+      direct_link_sound(fd, (bSound *)id);
+      break;
+    case ID_LP:
+      direct_link_lightprobe(fd, (LightProbe *)id);
+      break;
+    case ID_GR:
+      direct_link_collection(fd, (Collection *)id);
+      break;
+    case ID_AR:
+      direct_link_armature(fd, (bArmature *)id);
+      break;
+    case ID_AC:
+      direct_link_action(fd, (bAction *)id);
+      break;
+    case ID_NT:
+      direct_link_nodetree(fd, (bNodeTree *)id);
+      break;
+    case ID_BR:
+      direct_link_brush(fd, (Brush *)id);
+      break;
+    case ID_PA:
+      direct_link_particlesettings(fd, (ParticleSettings *)id);
+      break;
+    case ID_GD:
+      direct_link_gpencil(fd, (bGPdata *)id);
+      break;
+    case ID_MC:
+      direct_link_movieclip(fd, (MovieClip *)id);
+      break;
+    case ID_MSK:
+      direct_link_mask(fd, (Mask *)id);
+      break;
+    case ID_LS:
+      direct_link_linestyle(fd, (FreestyleLineStyle *)id);
+      break;
+    case ID_PAL:
+      direct_link_palette(fd, (Palette *)id);
+      break;
+    case ID_PC:
+      direct_link_paint_curve(fd, (PaintCurve *)id);
+      break;
+    case ID_CF:
+      direct_link_cachefile(fd, (CacheFile *)id);
+      break;
+    case ID_WS:
+      direct_link_workspace(fd, (WorkSpace *)id, main);
+      break;
+  }
+
+  return !wrong_id;
+}
+
+static bool direct_link_libblock_is_threadsafe(const short idcode);
+static BHead *read_libblock_direct_link_deferred(FileData *fd,
+                                                 Main *main,
+                                                 BHead *bhead,
+                                                 const int tag,
+                                                 const char *allocname,
+                                                 ID *id,
+                                                 ID **r_id);
+
 static BHead *read_libblock(FileData *fd,
                             Main *main,
                             BHead *bhead,
@@ -9002,10 +10044,6 @@ static BHead *read_libblock(FileData *fd,
   ListBase *lb;
   const char *allocname;
 
-  /* XXX Very weakly handled currently, see comment at the end of this function before trying to
-   * use it for anything new. */
-  bool wrong_id = false;
-
   /* In undo case, most libs and linked data should be kept as is from previous state
    * (see BLO_read_from_memfile).
    * However, some needed by the snapshot being read may have been removed in previous one,
@@ -9068,6 +10106,13 @@ static BHead *read_libblock(FileData *fd,
     }
   }
 
+  if (fd->undo_reuse_id_map && bhead->code != ID_LINK_PLACEHOLDER) {
+    BHead *bhead_next = read_libblock_undo_reuse(fd, main, bhead, tag, r_id);
+    if (bhead_next != NULL) {
+      return bhead_next;
+    }
+  }
+
   /* read libblock */
   id = read_struct(fd, bhead, "lib block");
 
@@ -9130,127 +10175,27 @@ static BHead *read_libblock(FileData *fd,
   /* need a name for the mallocN, just for debugging and sane prints on leaks */
   allocname = dataname(GS(id->name));
 
-  /* read all data into fd->datamap */
-  bhead = read_data_into_oldnewmap(fd, bhead, allocname);
-
-  /* init pointers direct data */
-  direct_link_id(fd, id);
+  if (fd->direct_link_pool && direct_link_libblock_is_threadsafe(GS(id->name))) {
+    return read_libblock_direct_link_deferred(fd, main, bhead, tag, allocname, id, r_id);
+  }
 
-  /* That way, we know which data-lock needs do_versions (required currently for linking). */
-  /* Note: doing this after driect_link_id(), which resets that field. */
-  id->tag = tag | LIB_TAG_NEED_LINK | LIB_TAG_NEW;
+  /* read all data into fd->datamap */
+  const void *id_old = bhead->old;
+  bhead = read_data_into_oldnewmap(fd, fd->datamap, bhead, allocname);
 
-  switch (GS(id->name)) {
-    case ID_WM:
-      direct_link_windowmanager(fd, (wmWindowManager *)id);
-      break;
-    case ID_SCR:
-      wrong_id = direct_link_screen(fd, (bScreen *)id);
-      break;
-    case ID_SCE:
-      direct_link_scene(fd, (Scene *)id);
-      break;
-    case ID_OB:
-      direct_link_object(fd, (Object *)id);
-      break;
-    case ID_ME:
-      direct_link_mesh(fd, (Mesh *)id);
-      break;
-    case ID_CU:
-      direct_link_curve(fd, (Curve *)id);
-      break;
-    case ID_MB:
-      direct_link_mball(fd, (MetaBall *)id);
-      break;
-    case ID_MA:
-      direct_link_material(fd, (Material *)id);
-      break;
-    case ID_TE:
-      direct_link_texture(fd, (Tex *)id);
-      break;
-    case ID_IM:
-      direct_link_image(fd, (Image *)id);
-      break;
-    case ID_LA:
-      direct_link_light(fd, (Light *)id);
-      break;
-    case ID_VF:
-      direct_link_vfont(fd, (VFont *)id);
-      break;
-    case ID_TXT:
-      direct_link_text(fd, (Text *)id);
-      break;
-    case ID_IP:
-      direct_link_ipo(fd, (Ipo *)id);
-      break;
-    case ID_KE:
-      direct_link_key(fd, (Key *)id);
-      break;
-    case ID_LT:
-      direct_link_latt(fd, (Lattice *)id);
-      break;
-    case ID_WO:
-      direct_link_world(fd, (World *)id);
-      break;
-    case ID_LI:
-      direct_link_library(fd, (Library *)id, main);
-      break;
-    case ID_CA:
-      direct_link_camera(fd, (Camera *)id);
-      break;
-    case ID_SPK:
-      direct_link_speaker(fd, (Speaker *)id);
-      break;
-    case ID_SO:
-      direct_link_sound(fd, (bSound *)id);
-      break;
-    case ID_LP:
-      direct_link_lightprobe(fd, (LightProbe *)id);
-      break;
-    case ID_GR:
-      direct_link_collection(fd, (Collection *)id);
-      break;
-    case ID_AR:
-      direct_link_armature(fd, (bArmature *)id);
-      break;
-    case ID_AC:
-      direct_link_action(fd, (bAction *)id);
-      break;
-    case ID_NT:
-      direct_link_nodetree(fd, (bNodeTree *)id);
-      break;
-    case ID_BR:
-      direct_link_brush(fd, (Brush *)id);
-      break;
-    case ID_PA:
-      direct_link_particlesettings(fd, (ParticleSettings *)id);
-      break;
-    case ID_GD:
-      direct_link_gpencil(fd, (bGPdata *)id);
-      break;
-    case ID_MC:
-      direct_link_movieclip(fd, (MovieClip *)id);
-      break;
-    case ID_MSK:
-      direct_link_mask(fd, (Mask *)id);
-      break;
-    case ID_LS:
-      direct_link_linestyle(fd, (FreestyleLineStyle *)id);
-      break;
-    case ID_PAL:
-      direct_link_palette(fd, (Palette *)id);
-      break;
-    case ID_PC:
-      direct_link_paint_curve(fd, (PaintCurve *)id);
-      break;
-    case ID_CF:
-      direct_link_cachefile(fd, (CacheFile *)id);
-      break;
-    case ID_WS:
-      direct_link_workspace(fd, (WorkSpace *)id, main);
-      break;
+  if (UNLIKELY(read_file_has_failed(fd))) {
+    read_libblock_discard(fd, main, fd->datamap, id, id_old);
+    oldnewmap_clear(fd->datamap);
+    if (r_id != NULL) {
+      *r_id = NULL;
+    }
+    return NULL;
   }
 
+  /* XXX Very weakly handled currently, see comment at the end of this function before trying to
+   * use it for anything new. */
+  const bool wrong_id = !direct_link_libblock(fd, main, tag, id);
+
   oldnewmap_free_unused(fd->datamap);
   oldnewmap_clear(fd->datamap);
 
@@ -9270,6 +10215,148 @@ static BHead *read_libblock(FileData *fd,
 
 /** \} */
 
+/* -------------------------------------------------------------------- */
+/** \name Read Library Data Block (Threaded)
+ *
+ * Once the data of an ID has been read into its own #OldNewMap, restoring its pointers only
+ * touches the data of that ID for most ID types. When reading a file, this is done by a task
+ * pool while the main thread reads the next blocks from the file.
+ *
+ * Linking ID pointers (#lib_link_all) remains single threaded,
+ * since it changes user counts and versioning there may modify other ID's.
+ * \{ */
+
+/** Reports of a task, moved to #FileData.reports on the main thread once all tasks are done. */
+typedef struct DirectLinkReports {
+  struct DirectLinkReports *next, *prev;
+  ReportList reports;
+} DirectLinkReports;
+
+typedef struct DirectLinkPool {
+  TaskPool *task_pool;
+  /** #DirectLinkReports of all tasks, in the order of the ID's in the file. */
+  ListBase reports;
+} DirectLinkPool;
+
+typedef struct DirectLinkTaskData {
+  /** Copy of the file data, using its own #FileData.datamap and #FileData.reports. */
+  FileData fd;
+  Main *main;
+  ID *id;
+  int tag;
+} DirectLinkTaskData;
+
+/**
+ * ID types which add to #Main, use the global #OldNewMap's of #FileData
+ * or may free the ID are linked on the main thread.
+ */
+static bool direct_link_libblock_is_threadsafe(const short idcode)
+{
+  return !ELEM(idcode, ID_LI, ID_WM, ID_SCR, ID_WS, ID_SCE);
+}
+
+static void direct_link_pool_begin(FileData *fd)
+{
+  BLI_assert(fd->direct_link_pool == NULL);
+
+  /* Undo reuses data from the previous state, which isn't thread-safe. */
+  if (fd->memfile != NULL || BLI_system_thread_count() == 1) {
+    return;
+  }
+
+  DirectLinkPool *direct_link_pool = MEM_callocN(sizeof(*direct_link_pool), __func__);
+  direct_link_pool->task_pool = BLI_task_pool_create(BLI_task_scheduler_get(), fd);
+  fd->direct_link_pool = direct_link_pool;
+}
+
+/**
+ * Wait for all ID's to be linked, must be called before anything accesses their data.
+ */
+static void direct_link_pool_end(FileData *fd)
+{
+  DirectLinkPool *direct_link_pool = fd->direct_link_pool;
+  if (direct_link_pool == NULL) {
+    return;
+  }
+
+  BLI_task_pool_work_and_wait(direct_link_pool->task_pool);
+  BLI_task_pool_free(direct_link_pool->task_pool);
+
+  LISTBASE_FOREACH_MUTABLE (DirectLinkReports *, task_reports, &direct_link_pool->reports) {
+    BLI_movelisttolist(&fd->reports->list, &task_reports->reports.list);
+    MEM_freeN(task_reports);
+  }
+
+  MEM_freeN(direct_link_pool);
+  fd->direct_link_pool = NULL;
+}
+
+static void read_libblock_direct_link_task(TaskPool *__restrict UNUSED(pool),
+                                           void *taskdata,
+                                           int UNUSED(threadid))
+{
+  DirectLinkTaskData *task_data = taskdata;
+  FileData *fd = &task_data->fd;
+
+  const bool ok = direct_link_libblock(fd, task_data->main, task_data->tag, task_data->id);
+  BLI_assert(ok);
+  UNUSED_VARS_NDEBUG(ok);
+
+  oldnewmap_free_unused(fd->datamap);
+  oldnewmap_free(fd->datamap);
+}
+
+/**
+ * Read the direct data of an ID into its own #OldNewMap,
+ * restoring its pointers is done by #FileData.direct_link_pool.
+ */
+static BHead *read_libblock_direct_link_deferred(FileData *fd,
+                                                 Main *main,
+                                                 BHead *bhead,
+                                                 const int tag,
+                                                 const char *allocname,
+                                                 ID *id,
+                                                 ID **r_id)
+{
+  OldNewMap *datamap = oldnewmap_new();
+
+  const void *id_old = bhead->old;
+  bhead = read_data_into_oldnewmap(fd, datamap, bhead, allocname);
+
+  if (UNLIKELY(read_file_has_failed(fd))) {
+    read_libblock_discard(fd, main, datamap, id, id_old);
+    oldnewmap_free(datamap);
+    if (r_id != NULL) {
+      *r_id = NULL;
+    }
+    return NULL;
+  }
+
+  DirectLinkTaskData *task_data = MEM_mallocN(sizeof(*task_data), __func__);
+  task_data->fd = *fd;
+  task_data->fd.datamap = datamap;
+  if (fd->reports != NULL) {
+    DirectLinkReports *task_reports = MEM_mallocN(sizeof(*task_reports), __func__);
+    task_reports->reports = *fd->reports;
+    BLI_listbase_clear(&task_reports->reports.list);
+    BLI_addtail(&fd->direct_link_pool->reports, task_reports);
+    task_data->fd.reports = &task_reports->reports;
+  }
+  task_data->main = main;
+  task_data->id = id;
+  task_data->tag = tag;
+
+  BLI_task_pool_push(fd->direct_link_pool->task_pool,
+                     read_libblock_direct_link_task,
+                     task_data,
+                     true,
+                     TASK_PRIORITY_LOW);
+
+  return bhead;
+}
+
+/** \} */
+
 /* -------------------------------------------------------------------- */
 /** \name Read Global Data
  * \{ */
@@ -9624,7 +10711,7 @@ static BHead *read_userdef(BlendFileData *bfd, FileData *fd, BHead *bhead)
   user->subversionfile = bfd->main->subversionfile;
 
   /* read all data into fd->datamap */
-  bhead = read_data_into_oldnewmap(fd, bhead, "user def");
+  bhead = read_data_into_oldnewmap(fd, fd->datamap, bhead, "user def");
 
   link_list(fd, &user->themes);
   link_list(fd, &user->user_keymaps);
@@ -9745,6 +10832,10 @@ BlendFileData *blo_read_file_internal(FileData *fd, const char *filepath)
     }
   }
 
+  if ((fd->skip_flags & BLO_READ_SKIP_DATA) == 0) {
+    direct_link_pool_begin(fd);
+  }
+
   while (bhead) {
     switch (bhead->code) {
       case DATA:
@@ -9796,6 +10887,23 @@ BlendFileData *blo_read_file_internal(FileData *fd, const char *filepath)
     }
   }
 
+  direct_link_pool_end(fd);
+
+  if (UNLIKELY(read_file_has_failed(fd))) {
+    /* The file was truncated or became inaccessible while reading it,
+     * the data read so far can't be trusted. */
+    blo_reportf_wrap(fd->reports,
+                     RPT_ERROR,
+                     TIP_("Unable to read '%s': error while reading the file"),
+                     filepath);
+    if (!BLI_listbase_is_empty(&mainlist)) {
+      blo_join_main(&mainlist);
+    }
+    fd->mainlist = NULL;
+    BLO_blendfiledata_free(bfd);
+    return NULL;
+  }
+
   /* do before read_libraries, but skip undo case */
   if (fd->memfile == NULL) {
     if ((fd->skip_flags & BLO_READ_SKIP_DATA) == 0) {
@@ -9892,13 +11000,14 @@ static int verg_bheadsort(const void *v1, const void *v2)
   return 0;
 }
 
+/* Only ID blocks are looked up by their old address, #DATA blocks are skipped. */
 static void sort_bhead_old_map(FileData *fd)
 {
   BHead *bhead;
   struct BHeadSort *bhs;
   int tot = 0;
 
-  for (bhead = blo_bhead_first(fd); bhead; bhead = blo_bhead_next(fd, bhead)) {
+  for (bhead = blo_bhead_first(fd); bhead; bhead = blo_bhead_next_skip_data(fd, bhead)) {
     tot++;
   }
 
@@ -9909,7 +11018,7 @@ static void sort_bhead_old_map(FileData *fd)
 
   bhs = fd->bheadmap = MEM_malloc_arrayN(tot, sizeof(struct BHeadSort), "BHeadSort");
 
-  for (bhead = blo_bhead_first(fd); bhead; bhead = blo_bhead_next(fd, bhead), bhs++) {
+  for (bhead = blo_bhead_first(fd); bhead; bhead = blo_bhead_next_skip_data(fd, bhead), bhs++) {
     bhs->bhead = bhead;
     bhs->old = bhead->old;
   }
@@ -9980,7 +11089,7 @@ static BHead *find_bhead_from_code_name(FileData *fd, const short idcode, const
 #else
   BHead *bhead;
 
-  for (bhead = blo_bhead_first(fd); bhead; bhead = blo_bhead_next(fd, bhead)) {
+  for (bhead = blo_bhead_first(fd); bhead; bhead = blo_bhead_next_skip_data(fd, bhead)) {
     if (bhead->code == idcode) {
       const char *idname_test = blo_bhead_id_name(fd, bhead);
       if (STREQ(idname_test + 2, name)) {
@@ -11335,7 +12444,7 @@ int BLO_library_link_copypaste(Main *mainl, BlendHandle *bh, const uint64_t id_t
   BHead *bhead;
   int num_directly_linked = 0;
 
-  for (bhead = blo_bhead_first(fd); bhead; bhead = blo_bhead_next(fd, bhead)) {
+  for (bhead = blo_bhead_first(fd); bhead; bhead = blo_bhead_next_skip_data(fd, bhead)) {
     ID *id = NULL;
 
     if (bhead->code == ENDB) {
@@ -30,6 +30,9 @@
 #include "DNA_space_types.h"
 #include "DNA_windowmanager_types.h" /* for ReportType */
 
+struct BLI_mmap_file;
+struct DNA_ReconstructInfo;
+struct DirectLinkPool;
 struct Key;
 struct MemFile;
 struct Object;
@@ -46,6 +49,8 @@ enum eFileDataFlag {
   FD_FLAGS_NOT_MY_BUFFER = 1 << 4,
   /* XXX Unused in practice (checked once but never set). */
   FD_FLAGS_NOT_MY_LIBMAP = 1 << 5,
+  /** Blocks are read using the index stored in the file (see #INDX). */
+  FD_FLAGS_USE_BHEAD_INDEX = 1 << 6,
 };
 
 /* Disallow since it's 32bit on ms-windows. */
@@ -73,6 +78,8 @@ typedef struct FileData {
 
   /** Regular file reading. */
   int filedes;
+  /** Memory mapped regular file, when mapping succeeded (#filedes is still open). */
+  struct BLI_mmap_file *mmap_file;
 
   /** Variables needed for reading from memory / stream. */
   const char *buffer;
@@ -83,6 +90,8 @@ typedef struct FileData {
   gzFile gzfiledes;
   /** Gzip stream for memory decompression. */
   z_stream strm;
+  /** Zstd decompression state, see #BLEND_ZSTD_SEEKABLE_MAGIC. */
+  struct ZstdReader *zstd;
 
   /** Now only in use for library appending. */
   char relabase[FILE_MAX];
@@ -92,6 +101,8 @@ typedef struct FileData {
   const struct SDNA *memsdna;
   /** Array of #eSDNA_StructCompare. */
   const char *compflags;
+  /** Steps to convert structs from #filesdna to #memsdna, see #DNA_struct_reconstruct. */
+  struct DNA_ReconstructInfo *reconstruct_info;
 
   int fileversion;
   /** Used to retrieve ID names from (bhead+1). */
@@ -110,6 +121,11 @@ typedef struct FileData {
   struct OldNewMap *scenemap;
   struct OldNewMap *soundmap;
   struct OldNewMap *packedmap;
+  /**
+   * Used for undo, IDs of the old main kept in place instead of being read again,
+   * mapped by their #ID.session_uuid. See #blo_make_undo_reuse_id_map.
+   */
+  struct GHash *undo_reuse_id_map;
 
   struct BHeadSort *bheadmap;
   int tot_bheadmap;
@@ -122,10 +138,31 @@ typedef struct FileData {
   ListBase *old_mainlist;
 
   struct ReportList *reports;
+
+  /** Restores pointers of ID's in parallel while reading, see #direct_link_pool_begin. */
+  struct DirectLinkPool *direct_link_pool;
 } FileData;
 
 #define SIZEOFBLENDERHEADER 12
 
+/**
+ * Zstd compressed files are a sequence of independent frames followed by a seek table,
+ * stored in a skippable frame as defined by the zstd "seekable" format.
+ * All values are little endian.
+ */
+#define BLEND_ZSTD_FRAME_MAGIC 0xFD2FB528
+#define BLEND_ZSTD_SKIPPABLE_MAGIC 0x184D2A5E
+#define BLEND_ZSTD_SEEKABLE_MAGIC 0x8F92EAB1
+/** Number of frames (uint32), descriptor (uint8) and #BLEND_ZSTD_SEEKABLE_MAGIC (uint32). */
+#define BLEND_ZSTD_SEEK_TABLE_FOOTER_SIZE 9
+
+/**
+ * The #INDX block contains the offsets (int64) of all blocks but #DATA,
+ * followed by its own offset (int64) and #BLEND_BHEAD_INDEX_MAGIC, ending the file.
+ */
+#define BLEND_BHEAD_INDEX_MAGIC "BHINDEX"
+#define BLEND_BHEAD_INDEX_FOOTER_SIZE 16
+
 /***/
 struct Main;
 void blo_join_main(ListBase *mainlist);
@@ -146,6 +183,10 @@ void blo_make_movieclip_pointer_map(FileData *fd, struct Main *oldmain);
 void blo_end_movieclip_pointer_map(FileData *fd, struct Main *oldmain);
 void blo_make_sound_pointer_map(FileData *fd, struct Main *oldmain);
 void blo_end_sound_pointer_map(FileData *fd, struct Main *oldmain);
+void blo_make_undo_reuse_id_map(FileData *fd,
+                                struct Main *oldmain,
+                                const struct MemFile *reference_memfile);
+void blo_end_undo_reuse_id_map(FileData *fd, struct Main *newmain);
 void blo_make_packed_pointer_map(FileData *fd, struct Main *oldmain);
 void blo_end_packed_pointer_map(FileData *fd, struct Main *oldmain);
 void blo_add_library_pointer_map(ListBase *old_mainlist, FileData *fd);
@@ -154,6 +195,7 @@ void blo_filedata_free(FileData *fd);
 
 BHead *blo_bhead_first(FileData *fd);
 BHead *blo_bhead_next(FileData *fd, BHead *thisblock);
+BHead *blo_bhead_next_skip_data(FileData *fd, BHead *thisblock);
 BHead *blo_bhead_prev(FileData *fd, BHead *thisblock);
 
 const char *blo_bhead_id_name(const FileData *fd, const BHead *bhead);
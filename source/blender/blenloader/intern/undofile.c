@@ -41,10 +41,12 @@
 #include "DNA_listBase.h"
 
 #include "BLI_blenlib.h"
+#include "BLI_ghash.h"
 
 #include "BLO_undofile.h"
 #include "BLO_readfile.h"
 
+#include "BKE_lib_id.h"
 #include "BKE_main.h"
 
 /* keep last */
@@ -70,46 +72,221 @@ void BLO_memfile_free(MemFile *memfile)
 /* result is that 'first' is being freed */
 void BLO_memfile_merge(MemFile *first, MemFile *second)
 {
-  MemFileChunk *fc, *sc;
+  /* Chunks are shared by buffer, not by position: data-blocks may be added, removed or re-ordered
+   * between steps, and unchanged data-blocks share all their chunks with a previous step. */
+  GHash *buffer_to_second_chunk = BLI_ghash_ptr_new(__func__);
 
-  fc = first->chunks.first;
-  sc = second->chunks.first;
-  while (fc || sc) {
-    if (fc && sc) {
-      if (sc->is_identical) {
+  for (MemFileChunk *sc = second->chunks.first; sc; sc = sc->next) {
+    if (sc->is_identical) {
+      BLI_ghash_insert(buffer_to_second_chunk, (void *)sc->buf, sc);
+    }
+  }
+
+  /* Transfer ownership of the buffers owned by 'first' which are still used by 'second',
+   * the others are freed along with 'first'. */
+  for (MemFileChunk *fc = first->chunks.first; fc; fc = fc->next) {
+    if (fc->is_identical == false) {
+      MemFileChunk *sc = BLI_ghash_lookup(buffer_to_second_chunk, fc->buf);
+      if (sc != NULL) {
         sc->is_identical = false;
         fc->is_identical = true;
       }
     }
-    if (fc) {
-      fc = fc->next;
+  }
+
+  BLI_ghash_free(buffer_to_second_chunk, NULL, NULL);
+
+  BLO_memfile_free(first);
+}
+
+/**
+ * Set of the #ID.session_uuid of the data-blocks which share all their chunks in \a memfile with
+ * \a reference_memfile, their data is identical in both.
+ */
+GSet *memfile_shared_id_session_uuids_get(const MemFile *memfile,
+                                          const MemFile *reference_memfile)
+{
+  GSet *shared_ids = BLI_gset_int_new(__func__);
+
+  /* First chunk of each ID in the reference memfile. */
+  GHash *reference_id_chunks = BLI_ghash_int_new(__func__);
+  uint id_session_uuid_prev = MAIN_ID_SESSION_UUID_UNSET;
+  for (MemFileChunk *chunk = reference_memfile->chunks.first; chunk; chunk = chunk->next) {
+    if (!ELEM(chunk->id_session_uuid, MAIN_ID_SESSION_UUID_UNSET, id_session_uuid_prev)) {
+      BLI_ghash_insert(
+          reference_id_chunks, POINTER_FROM_UINT(chunk->id_session_uuid), (void *)chunk);
+    }
+    id_session_uuid_prev = chunk->id_session_uuid;
+  }
+
+  const MemFileChunk *chunk = memfile->chunks.first;
+  while (chunk != NULL) {
+    const uint id_session_uuid = chunk->id_session_uuid;
+    if (id_session_uuid == MAIN_ID_SESSION_UUID_UNSET) {
+      chunk = chunk->next;
+      continue;
+    }
+
+    const MemFileChunk *refchunk = BLI_ghash_lookup(reference_id_chunks,
+                                                    POINTER_FROM_UINT(id_session_uuid));
+    bool is_shared = (refchunk != NULL);
+    for (; chunk && chunk->id_session_uuid == id_session_uuid; chunk = chunk->next) {
+      if (refchunk == NULL || refchunk->id_session_uuid != id_session_uuid ||
+          refchunk->buf != chunk->buf) {
+        is_shared = false;
+      }
+      refchunk = refchunk ? refchunk->next : NULL;
+    }
+    /* The reference may have more chunks for this ID. */
+    if (refchunk != NULL && refchunk->id_session_uuid == id_session_uuid) {
+      is_shared = false;
     }
-    if (sc) {
-      sc = sc->next;
+
+    if (is_shared) {
+      BLI_gset_add(shared_ids, POINTER_FROM_UINT(id_session_uuid));
     }
   }
 
-  BLO_memfile_free(first);
+  BLI_ghash_free(reference_id_chunks, NULL, NULL);
+
+  return shared_ids;
+}
+
+void memfile_write_init(MemFileWriteData *mem_data,
+                        MemFile *written_memfile,
+                        MemFile *reference_memfile)
+{
+  static uint memfile_serial = 0;
+  written_memfile->serial = ++memfile_serial;
+  if (UNLIKELY(written_memfile->serial == 0)) {
+    written_memfile->serial = ++memfile_serial;
+  }
+
+  mem_data->written_memfile = written_memfile;
+  mem_data->reference_memfile = reference_memfile;
+  mem_data->current_id_session_uuid = MAIN_ID_SESSION_UUID_UNSET;
+  mem_data->reference_current_chunk = NULL;
+  mem_data->reference_non_id_chunk = reference_memfile ? reference_memfile->chunks.first : NULL;
+  mem_data->id_session_uuid_mapping = NULL;
+
+  if (reference_memfile != NULL) {
+    mem_data->id_session_uuid_mapping = BLI_ghash_int_new(__func__);
+    uint id_session_uuid_prev = MAIN_ID_SESSION_UUID_UNSET;
+    for (MemFileChunk *chunk = reference_memfile->chunks.first; chunk; chunk = chunk->next) {
+      if (!ELEM(chunk->id_session_uuid, MAIN_ID_SESSION_UUID_UNSET, id_session_uuid_prev)) {
+        BLI_ghash_insert(mem_data->id_session_uuid_mapping,
+                         POINTER_FROM_UINT(chunk->id_session_uuid),
+                         chunk);
+      }
+      id_session_uuid_prev = chunk->id_session_uuid;
+    }
+  }
+}
+
+void memfile_write_finalize(MemFileWriteData *mem_data)
+{
+  if (mem_data->id_session_uuid_mapping != NULL) {
+    BLI_ghash_free(mem_data->id_session_uuid_mapping, NULL, NULL);
+    mem_data->id_session_uuid_mapping = NULL;
+  }
 }
 
-void memfile_chunk_add(MemFile *memfile, const char *buf, uint size, MemFileChunk **compchunk_step)
+/**
+ * Start writing the data of an ID, compare with the data written for the same ID in the
+ * reference memfile, so adding or removing data-blocks doesn't offset all following chunks.
+ */
+void memfile_write_id_begin(MemFileWriteData *mem_data, uint id_session_uuid)
+{
+  mem_data->current_id_session_uuid = id_session_uuid;
+  mem_data->reference_current_chunk = NULL;
+  if (mem_data->id_session_uuid_mapping != NULL) {
+    mem_data->reference_current_chunk = BLI_ghash_lookup(mem_data->id_session_uuid_mapping,
+                                                         POINTER_FROM_UINT(id_session_uuid));
+  }
+}
+
+void memfile_write_id_end(MemFileWriteData *mem_data)
+{
+  mem_data->current_id_session_uuid = MAIN_ID_SESSION_UUID_UNSET;
+  mem_data->reference_current_chunk = NULL;
+}
+
+/**
+ * Share all chunks written for an ID in the reference memfile, without writing it again.
+ *
+ * \return false when the ID can't be found in the reference memfile.
+ */
+bool memfile_write_id_reuse(MemFileWriteData *mem_data, uint id_session_uuid)
+{
+  if (mem_data->id_session_uuid_mapping == NULL) {
+    return false;
+  }
+
+  MemFileChunk *refchunk = BLI_ghash_lookup(mem_data->id_session_uuid_mapping,
+                                            POINTER_FROM_UINT(id_session_uuid));
+  if (refchunk == NULL) {
+    return false;
+  }
+
+  for (; refchunk && refchunk->id_session_uuid == id_session_uuid; refchunk = refchunk->next) {
+    MemFileChunk *curchunk = MEM_mallocN(sizeof(MemFileChunk), "MemFileChunk");
+    curchunk->buf = refchunk->buf;
+    curchunk->size = refchunk->size;
+    curchunk->is_identical = true;
+    curchunk->id_session_uuid = id_session_uuid;
+    BLI_addtail(&mem_data->written_memfile->chunks, curchunk);
+  }
+
+  return true;
+}
+
+/**
+ * Chunk of the reference memfile to compare the next written chunk with, data of an ID is
+ * compared with the data of the same ID, data outside of IDs with the next chunk outside of IDs.
+ */
+static MemFileChunk *memfile_write_reference_chunk_step(MemFileWriteData *mem_data)
+{
+  MemFileChunk *refchunk;
+
+  if (mem_data->current_id_session_uuid == MAIN_ID_SESSION_UUID_UNSET) {
+    refchunk = mem_data->reference_non_id_chunk;
+    while (refchunk != NULL && refchunk->id_session_uuid != MAIN_ID_SESSION_UUID_UNSET) {
+      refchunk = refchunk->next;
+    }
+    mem_data->reference_non_id_chunk = refchunk ? refchunk->next : NULL;
+  }
+  else {
+    refchunk = mem_data->reference_current_chunk;
+    if (refchunk != NULL && refchunk->id_session_uuid != mem_data->current_id_session_uuid) {
+      /* All chunks of the ID in the reference memfile have been compared. */
+      refchunk = NULL;
+    }
+    mem_data->reference_current_chunk = refchunk ? refchunk->next : NULL;
+  }
+
+  return refchunk;
+}
+
+void memfile_chunk_add(MemFileWriteData *mem_data, const char *buf, uint size)
 {
+  MemFile *memfile = mem_data->written_memfile;
+
   MemFileChunk *curchunk = MEM_mallocN(sizeof(MemFileChunk), "MemFileChunk");
   curchunk->size = size;
   curchunk->buf = NULL;
   curchunk->is_identical = false;
+  curchunk->id_session_uuid = mem_data->current_id_session_uuid;
   BLI_addtail(&memfile->chunks, curchunk);
 
   /* we compare compchunk with buf */
-  if (*compchunk_step != NULL) {
-    MemFileChunk *compchunk = *compchunk_step;
+  MemFileChunk *compchunk = memfile_write_reference_chunk_step(mem_data);
+  if (compchunk != NULL) {
     if (compchunk->size == curchunk->size) {
       if (memcmp(compchunk->buf, buf, size) == 0) {
         curchunk->buf = compchunk->buf;
         curchunk->is_identical = true;
       }
     }
-    *compchunk_step = compchunk->next;
   }
 
   /* not equal... */
@@ -127,7 +304,7 @@ struct Main *BLO_memfile_main_get(struct MemFile *memfile,
 {
   struct Main *bmain_undo = NULL;
   BlendFileData *bfd = BLO_read_from_memfile(
-      oldmain, BKE_main_blendfile_path(oldmain), memfile, BLO_READ_SKIP_NONE, NULL);
+      oldmain, BKE_main_blendfile_path(oldmain), memfile, NULL, BLO_READ_SKIP_NONE, NULL);
 
   if (bfd) {
     bmain_undo = bfd->main;
@@ -88,6 +88,10 @@
 #  include <unistd.h> /* FreeBSD, for write() and close(). */
 #endif
 
+#ifdef WITH_ZSTD
+#  include <zstd.h>
+#endif
+
 #include "BLI_utildefines.h"
 
 /* allow writefile to use deprecated functionality (for forward compatibility code) */
@@ -144,7 +148,9 @@
 #include "MEM_guardedalloc.h"  // MEM_freeN
 #include "BLI_bitmap.h"
 #include "BLI_blenlib.h"
+#include "BLI_endian_switch.h"
 #include "BLI_mempool.h"
+#include "BLI_threads.h"
 
 #include "BKE_action.h"
 #include "BKE_blender_version.h"
@@ -190,9 +196,6 @@
 #define MYWRITE_BUFFER_SIZE (MEM_SIZE_OPTIMAL(1 << 17)) /* 128kb */
 #define MYWRITE_MAX_CHUNK (MEM_SIZE_OPTIMAL(1 << 15))   /* ~32kb */
 
-/** Use if we want to store how many bytes have been written to the file. */
-// #define USE_WRITE_DATA_LEN
-
 /* -------------------------------------------------------------------- */
 /** \name Internal Write Wrapper's (Abstracts Compression)
  * \{ */
@@ -200,6 +203,9 @@
 typedef enum {
   WW_WRAP_NONE = 1,
   WW_WRAP_ZLIB,
+#ifdef WITH_ZSTD
+  WW_WRAP_ZSTD,
+#endif
 } eWriteWrapType;
 
 typedef struct WriteWrap WriteWrap;
@@ -216,6 +222,9 @@ struct WriteWrap {
   union {
     int file_handle;
     gzFile gz_handle;
+#ifdef WITH_ZSTD
+    struct ZstdWriteWrap *zstd_handle;
+#endif
   } _user_data;
 };
 
@@ -273,6 +282,228 @@ static size_t ww_write_zlib(WriteWrap *ww, const char *buf, size_t buf_len)
 }
 #undef FILE_HANDLE
 
+#ifdef WITH_ZSTD
+
+/* zstd
+ *
+ * Data is split into independent frames of #ZSTD_FRAME_SIZE which are compressed on worker
+ * threads and written to the file in order. A seek table (as defined by the zstd "seekable"
+ * format, see #BLEND_ZSTD_SEEKABLE_MAGIC) is appended after the last frame,
+ * so the reader can decompress frames in parallel and seek to any offset. */
+
+/* Large enough for a good compression ratio, small enough to keep all threads busy. */
+#  define ZSTD_FRAME_SIZE (1 << 20) /* 1mb */
+#  define ZSTD_COMPRESSION_LEVEL 3
+
+typedef struct ZstdWriteFrame {
+  struct ZstdWriteFrame *next, *prev;
+  uint32_t compressed_size;
+  uint32_t uncompressed_size;
+} ZstdWriteFrame;
+
+typedef struct ZstdWriteTask {
+  struct ZstdWriteTask *next, *prev;
+  struct ZstdWriteWrap *zww;
+  void *data;
+  size_t size;
+  int frame_nr;
+} ZstdWriteTask;
+
+typedef struct ZstdWriteWrap {
+  int file_handle;
+
+  /** Input not yet handed to a worker thread (up to #ZSTD_FRAME_SIZE). */
+  char *buf;
+  size_t buf_used_len;
+
+  /** Worker threads, one frame each. */
+  ListBase threadpool;
+  /** #ZstdWriteTask, in the order they were queued. */
+  ListBase tasks;
+  ThreadMutex mutex;
+  ThreadCondition condition;
+  /** Number of the next frame that may be written to the file. */
+  int frame_next;
+  /** Number of frames queued so far. */
+  int frame_num;
+  /** #ZstdWriteFrame, sizes of the frames written so far (for the seek table). */
+  ListBase frames;
+
+  bool error;
+} ZstdWriteWrap;
+
+#  define FILE_HANDLE(ww) (ww)->_user_data.zstd_handle
+
+static void *ww_zstd_compress_task(void *task_v)
+{
+  ZstdWriteTask *task = task_v;
+  ZstdWriteWrap *zww = task->zww;
+
+  const size_t out_buf_len = ZSTD_compressBound(task->size);
+  void *out_buf = MEM_mallocN(out_buf_len, __func__);
+  const size_t out_len = ZSTD_compress(
+      out_buf, out_buf_len, task->data, task->size, ZSTD_COMPRESSION_LEVEL);
+
+  MEM_freeN(task->data);
+  task->data = NULL;
+
+  /* Frames are compressed out of order but must be written in order. */
+  BLI_mutex_lock(&zww->mutex);
+  while (zww->frame_next != task->frame_nr) {
+    BLI_condition_wait(&zww->condition, &zww->mutex);
+  }
+
+  if (ZSTD_isError(out_len)) {
+    zww->error = true;
+  }
+  else if (!zww->error) {
+    if ((size_t)write(zww->file_handle, out_buf, out_len) == out_len) {
+      ZstdWriteFrame *frame = MEM_mallocN(sizeof(*frame), __func__);
+      frame->compressed_size = (uint32_t)out_len;
+      frame->uncompressed_size = (uint32_t)task->size;
+      BLI_addtail(&zww->frames, frame);
+    }
+    else {
+      zww->error = true;
+    }
+  }
+
+  zww->frame_next++;
+  BLI_condition_notify_all(&zww->condition);
+  BLI_mutex_unlock(&zww->mutex);
+
+  MEM_freeN(out_buf);
+
+  return NULL;
+}
+
+/**
+ * Hand the buffered data to a worker thread.
+ * When all threads are busy, wait for the oldest one, bounding memory usage.
+ */
+static void ww_zstd_flush_frame(ZstdWriteWrap *zww)
+{
+  if (zww->buf_used_len == 0) {
+    return;
+  }
+
+  ZstdWriteTask *task = MEM_mallocN(sizeof(*task), __func__);
+  task->zww = zww;
+  task->data = zww->buf;
+  task->size = zww->buf_used_len;
+  task->frame_nr = zww->frame_num++;
+
+  zww->buf = MEM_mallocN(ZSTD_FRAME_SIZE, __func__);
+  zww->buf_used_len = 0;
+
+  if (BLI_available_threads(&zww->threadpool) == 0) {
+    /* The oldest task is always able to finish since it doesn't wait on any other frame. */
+    ZstdWriteTask *task_first = zww->tasks.first;
+    BLI_threadpool_remove(&zww->threadpool, task_first);
+    BLI_remlink(&zww->tasks, task_first);
+    MEM_freeN(task_first);
+  }
+
+  BLI_addtail(&zww->tasks, task);
+  BLI_threadpool_insert(&zww->threadpool, task);
+}
+
+static bool ww_zstd_write_uint32_le(int file, uint32_t value)
+{
+  if (ENDIAN_ORDER == B_ENDIAN) {
+    BLI_endian_switch_uint32(&value);
+  }
+  return (write(file, &value, sizeof(value)) == sizeof(value));
+}
+
+static bool ww_zstd_write_seek_table(ZstdWriteWrap *zww)
+{
+  const int file = zww->file_handle;
+  const uint32_t frames_num = (uint32_t)BLI_listbase_count(&zww->frames);
+
+  /* Skippable frame header, the frame size excludes the header itself. */
+  bool ok = ww_zstd_write_uint32_le(file, BLEND_ZSTD_SKIPPABLE_MAGIC) &&
+            ww_zstd_write_uint32_le(file, frames_num * 8 + BLEND_ZSTD_SEEK_TABLE_FOOTER_SIZE);
+
+  LISTBASE_FOREACH (ZstdWriteFrame *, frame, &zww->frames) {
+    ok = ok && ww_zstd_write_uint32_le(file, frame->compressed_size) &&
+         ww_zstd_write_uint32_le(file, frame->uncompressed_size);
+  }
+
+  /* Footer: number of frames, descriptor (no checksums), magic. */
+  const uint8_t descriptor = 0;
+  ok = ok && ww_zstd_write_uint32_le(file, frames_num) &&
+       (write(file, &descriptor, sizeof(descriptor)) == sizeof(descriptor)) &&
+       ww_zstd_write_uint32_le(file, BLEND_ZSTD_SEEKABLE_MAGIC);
+
+  return ok;
+}
+
+static bool ww_open_zstd(WriteWrap *ww, const char *filepath)
+{
+  int file = BLI_open(filepath, O_BINARY + O_WRONLY + O_CREAT + O_TRUNC, 0666);
+
+  if (file == -1) {
+    return false;
+  }
+
+  ZstdWriteWrap *zww = MEM_callocN(sizeof(*zww), __func__);
+  zww->file_handle = file;
+  zww->buf = MEM_mallocN(ZSTD_FRAME_SIZE, __func__);
+  BLI_mutex_init(&zww->mutex);
+  BLI_condition_init(&zww->condition);
+  BLI_threadpool_init(&zww->threadpool, ww_zstd_compress_task, BLI_system_thread_count());
+
+  FILE_HANDLE(ww) = zww;
+  return true;
+}
+static bool ww_close_zstd(WriteWrap *ww)
+{
+  ZstdWriteWrap *zww = FILE_HANDLE(ww);
+
+  ww_zstd_flush_frame(zww);
+
+  BLI_threadpool_end(&zww->threadpool);
+  BLI_freelistN(&zww->tasks);
+
+  bool ok = !zww->error && ww_zstd_write_seek_table(zww);
+  ok = (close(zww->file_handle) != -1) && ok;
+
+  BLI_freelistN(&zww->frames);
+  BLI_mutex_end(&zww->mutex);
+  BLI_condition_end(&zww->condition);
+  MEM_freeN(zww->buf);
+  MEM_freeN(zww);
+
+  return ok;
+}
+static size_t ww_write_zstd(WriteWrap *ww, const char *buf, size_t buf_len)
+{
+  ZstdWriteWrap *zww = FILE_HANDLE(ww);
+
+  if (zww->error) {
+    return 0;
+  }
+
+  size_t buf_remain_len = buf_len;
+  while (buf_remain_len != 0) {
+    const size_t len = MIN2(buf_remain_len, ZSTD_FRAME_SIZE - zww->buf_used_len);
+    memcpy(&zww->buf[zww->buf_used_len], buf, len);
+    zww->buf_used_len += len;
+    buf += len;
+    buf_remain_len -= len;
+
+    if (zww->buf_used_len == ZSTD_FRAME_SIZE) {
+      ww_zstd_flush_frame(zww);
+    }
+  }
+
+  return buf_len;
+}
+#  undef FILE_HANDLE
+
+#endif /* WITH_ZSTD */
+
 /* --- end compression types --- */
 
 static void ww_handle_init(eWriteWrapType ww_type, WriteWrap *r_ww)
@@ -287,6 +518,16 @@ static void ww_handle_init(eWriteWrapType ww_type, WriteWrap *r_ww)
       r_ww->use_buf = false;
       break;
     }
+#ifdef WITH_ZSTD
+    case WW_WRAP_ZSTD: {
+      r_ww->open = ww_open_zstd;
+      r_ww->close = ww_close_zstd;
+      r_ww->write = ww_write_zstd;
+      /* Buffered per frame by the wrapper. */
+      r_ww->use_buf = false;
+      break;
+    }
+#endif
     default: {
       r_ww->open = ww_open_none;
       r_ww->close = ww_close_none;
@@ -311,23 +552,28 @@ typedef struct {
   /** Number of bytes used in #WriteData.buf (flushed when exceeded). */
   int buf_used_len;
 
-#ifdef USE_WRITE_DATA_LEN
-  /** Total number of bytes written. */
+  /** Total number of bytes written (before compression), the offset of the next block. */
   size_t write_len;
-#endif
+
+  /** Offsets of all blocks but #DATA, stored in the #INDX block (not used for undo). */
+  struct {
+    int64_t *offsets;
+    int offsets_len;
+    int offsets_len_alloc;
+  } bhead_index;
 
   /** Set on unlikely case of an error (ignores further file writing).  */
   bool error;
 
   /** #MemFile writing (used for undo). */
-  struct {
-    MemFile *current;
-    MemFile *compare;
-    /** Use to de-duplicate chunks when writing. */
-    MemFileChunk *compare_chunk;
-  } mem;
+  MemFileWriteData mem;
   /** When true, write to #WriteData.current, could also call 'is_undo'. */
   bool use_memfile;
+  /**
+   * When true, IDs untouched since the reference memfile was written share its chunks
+   * instead of being written again, see #ID.recalc_after_undo_push.
+   */
+  bool use_memfile_id_reuse;
 
   /**
    * Wrap writing, so we can use zlib or
@@ -364,7 +610,7 @@ static void writedata_do_write(WriteData *wd, const void *mem, int memlen)
 
   /* memory based save */
   if (wd->use_memfile) {
-    memfile_chunk_add(wd->mem.current, mem, memlen, &wd->mem.compare_chunk);
+    memfile_chunk_add(&wd->mem, mem, memlen);
   }
   else {
     if (wd->ww->write(wd->ww, mem, memlen) != memlen) {
@@ -378,6 +624,9 @@ static void writedata_free(WriteData *wd)
   if (wd->buf) {
     MEM_freeN(wd->buf);
   }
+  if (wd->bhead_index.offsets) {
+    MEM_freeN(wd->bhead_index.offsets);
+  }
   MEM_freeN(wd);
 }
 
@@ -415,9 +664,7 @@ static void mywrite(WriteData *wd, const void *adr, int len)
     return;
   }
 
-#ifdef USE_WRITE_DATA_LEN
   wd->write_len += len;
-#endif
 
   if (wd->buf == NULL) {
     writedata_do_write(wd, adr, len);
@@ -453,6 +700,23 @@ static void mywrite(WriteData *wd, const void *adr, int len)
   }
 }
 
+/**
+ * Write a block header, storing its offset for the #INDX block when it's not #DATA.
+ */
+static void mywrite_bhead(WriteData *wd, const BHead *bh)
+{
+  if (bh->code != DATA && !wd->use_memfile) {
+    if (wd->bhead_index.offsets_len == wd->bhead_index.offsets_len_alloc) {
+      wd->bhead_index.offsets_len_alloc = MAX2(1024, wd->bhead_index.offsets_len_alloc * 2);
+      wd->bhead_index.offsets = MEM_reallocN(
+          wd->bhead_index.offsets, sizeof(int64_t) * wd->bhead_index.offsets_len_alloc);
+    }
+    wd->bhead_index.offsets[wd->bhead_index.offsets_len++] = (int64_t)wd->write_len;
+  }
+
+  mywrite(wd, bh, sizeof(*bh));
+}
+
 /**
  * BeGiN initializer for mywrite
  * \param ww: File write wrapper.
@@ -465,9 +729,7 @@ static WriteData *mywrite_begin(WriteWrap *ww, MemFile *compare, MemFile *curren
   WriteData *wd = writedata_new(ww);
 
   if (current != NULL) {
-    wd->mem.current = current;
-    wd->mem.compare = compare;
-    wd->mem.compare_chunk = compare ? compare->chunks.first : NULL;
+    memfile_write_init(&wd->mem, current, compare);
     wd->use_memfile = true;
   }
 
@@ -487,12 +749,84 @@ static bool mywrite_end(WriteData *wd)
     wd->buf_used_len = 0;
   }
 
+  if (wd->use_memfile) {
+    memfile_write_finalize(&wd->mem);
+  }
+
   const bool err = wd->error;
   writedata_free(wd);
 
   return err;
 }
 
+/**
+ * Start writing the data of an ID.
+ *
+ * For undo, each ID is written in its own chunks so it can be compared with
+ * (or shared from) the previous step independently of the other IDs.
+ */
+static void mywrite_id_begin(WriteData *wd, ID *id)
+{
+  if (wd->use_memfile) {
+    mywrite_flush(wd);
+    memfile_write_id_begin(&wd->mem, id->session_uuid);
+
+    /* Cleared before writing, so the written data doesn't depend on how the ID was changed. */
+    id->recalc_after_undo_push = 0;
+    bNodeTree *ntree = ntreeFromID(id);
+    if (ntree != NULL) {
+      ntree->id.recalc_after_undo_push = 0;
+    }
+  }
+}
+
+static void mywrite_id_end(WriteData *wd, ID *UNUSED(id))
+{
+  if (wd->use_memfile) {
+    mywrite_flush(wd);
+    memfile_write_id_end(&wd->mem);
+  }
+}
+
+/**
+ * Changes to some ID types aren't reliably tagged (UI data, text editing, non copy-on-write
+ * types), those are always written. So are library overrides, which are updated from their
+ * reference when writing.
+ */
+static bool mywrite_id_is_unchanged(ID *id)
+{
+  const short id_type = GS(id->name);
+  if (ELEM(id_type, ID_WM, ID_WS, ID_SCR, ID_SCE, ID_TXT, ID_PC) || !ID_TYPE_IS_COW(id_type)) {
+    return false;
+  }
+  if (id->override_library != NULL) {
+    return false;
+  }
+  if (id->recalc_after_undo_push != 0) {
+    return false;
+  }
+  bNodeTree *ntree = ntreeFromID(id);
+  if (ntree != NULL && ntree->id.recalc_after_undo_push != 0) {
+    return false;
+  }
+  return true;
+}
+
+/**
+ * Share the data written for an ID untouched since the previous undo step,
+ * instead of writing and comparing it again.
+ *
+ * \return true when the ID doesn't need to be written.
+ */
+static bool mywrite_id_reuse(WriteData *wd, ID *id)
+{
+  if (!wd->use_memfile_id_reuse || !mywrite_id_is_unchanged(id)) {
+    return false;
+  }
+  mywrite_flush(wd);
+  return memfile_write_id_reuse(&wd->mem, id->session_uuid);
+}
+
 /** \} */
 
 /* -------------------------------------------------------------------- */
@@ -525,7 +859,7 @@ static void writestruct_at_address_nr(
     return;
   }
 
-  mywrite(wd, &bh, sizeof(BHead));
+  mywrite_bhead(wd, &bh);
   mywrite(wd, data, bh.len);
 }
 
@@ -576,7 +910,7 @@ static void writedata(WriteData *wd, int filecode, int len, const void *adr)
   bh.SDNAnr = 0;
   bh.len = len;
 
-  mywrite(wd, &bh, sizeof(BHead));
+  mywrite_bhead(wd, &bh);
   mywrite(wd, adr, len);
 }
 
@@ -3833,6 +4167,41 @@ static void write_thumb(WriteData *wd, const BlendThumbnail *thumb)
 
 /** \} */
 
+/* -------------------------------------------------------------------- */
+/** \name Block Index
+ * \{ */
+
+/**
+ * Write the offsets of all blocks but #DATA after #ENDB,
+ * so readers can load only the blocks they need, see #INDX.
+ */
+static void write_bhead_index(WriteData *wd)
+{
+  struct {
+    int64_t offset;
+    char magic[8];
+  } footer;
+  BLI_STATIC_ASSERT(sizeof(footer) == BLEND_BHEAD_INDEX_FOOTER_SIZE, "Invalid footer size")
+  BLI_STATIC_ASSERT(sizeof(BLEND_BHEAD_INDEX_MAGIC) == sizeof(footer.magic), "Invalid magic size")
+
+  footer.offset = (int64_t)wd->write_len;
+  memcpy(footer.magic, BLEND_BHEAD_INDEX_MAGIC, sizeof(footer.magic));
+
+  BHead bh = {
+      .code = INDX,
+      .len = (int)(sizeof(int64_t) * wd->bhead_index.offsets_len + sizeof(footer)),
+      .old = NULL,
+      .SDNAnr = 0,
+      .nr = 1,
+  };
+
+  mywrite(wd, &bh, sizeof(bh));
+  mywrite(wd, wd->bhead_index.offsets, sizeof(int64_t) * wd->bhead_index.offsets_len);
+  mywrite(wd, &footer, sizeof(footer));
+}
+
+/** \} */
+
 /* -------------------------------------------------------------------- */
 /** \name File Writing (Private)
  * \{ */
@@ -3853,6 +4222,10 @@ static bool write_file_handle(Main *mainvar,
   blo_split_main(&mainlist, mainvar);
 
   wd = mywrite_begin(ww, compare, current);
+  /* The reference must have been written from (or read into) this main,
+   * so untouched IDs are still at the addresses stored in it. */
+  wd->use_memfile_id_reuse = (compare != NULL) && (compare->serial != 0) &&
+                             (compare->serial == mainvar->memfile_undo_serial);
 
   sprintf(buf,
           "BLENDER%c%c%.3d",
@@ -3893,12 +4266,18 @@ static bool write_file_handle(Main *mainvar,
         BLI_assert(
             (id->tag & (LIB_TAG_NO_MAIN | LIB_TAG_NO_USER_REFCOUNT | LIB_TAG_NOT_ALLOCATED)) == 0);
 
+        if (mywrite_id_reuse(wd, id)) {
+          continue;
+        }
+
         const bool do_override = !ELEM(override_storage, NULL, bmain) && id->override_library;
 
         if (do_override) {
           BKE_lib_override_library_operations_store_start(bmain, override_storage, id);
         }
 
+        mywrite_id_begin(wd, id);
+
         switch ((ID_Type)GS(id->name)) {
           case ID_WM:
             write_windowmanager(wd, (wmWindowManager *)id);
@@ -4015,6 +4394,8 @@ static bool write_file_handle(Main *mainvar,
             break;
         }
 
+        mywrite_id_end(wd, id);
+
         if (do_override) {
           BKE_lib_override_library_operations_store_end(override_storage, id);
         }
@@ -4048,10 +4429,18 @@ static bool write_file_handle(Main *mainvar,
   /* end of file */
   memset(&bhead, 0, sizeof(BHead));
   bhead.code = ENDB;
-  mywrite(wd, &bhead, sizeof(BHead));
+  mywrite_bhead(wd, &bhead);
+
+  if (!wd->use_memfile) {
+    write_bhead_index(wd);
+  }
 
   blo_join_main(&mainlist);
 
+  if (wd->use_memfile) {
+    mainvar->memfile_undo_serial = current->serial;
+  }
+
   return mywrite_end(wd);
 }
 
@@ -4130,7 +4519,11 @@ bool BLO_write_file(Main *mainvar,
   BLI_snprintf(tempname, sizeof(tempname), "%s@", filepath);
 
   if (write_flags & G_FILE_COMPRESS) {
+#ifdef WITH_ZSTD
+    ww_type = (write_flags & G_FILE_COMPRESS_ZSTD) ? WW_WRAP_ZSTD : WW_WRAP_ZLIB;
+#else
     ww_type = WW_WRAP_ZLIB;
+#endif
   }
   else {
     ww_type = WW_WRAP_NONE;
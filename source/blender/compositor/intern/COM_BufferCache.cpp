@@ -0,0 +1,488 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * Copyright 2020, Blender Foundation.
+ */
+
+#include "COM_BufferCache.h"
+
+#include <cstring>
+#include <list>
+#include <typeinfo>
+
+#include "COM_NodeOperation.h"
+#include "COM_ReadBufferOperation.h"
+#include "COM_WriteBufferOperation.h"
+
+#include "MEM_guardedalloc.h"
+
+extern "C" {
+#include "BLI_hash_mm2a.h"
+#include "BLI_listbase.h"
+#include "BLI_string.h"
+
+#include "DNA_camera_types.h"
+#include "DNA_color_types.h"
+#include "DNA_image_types.h"
+#include "DNA_object_types.h"
+#include "DNA_userdef_types.h"
+
+#include "BKE_camera.h"
+#include "BKE_image.h"
+#include "BKE_node.h"
+
+#include "IMB_imbuf_types.h"
+}
+
+/* -------------------------------------------------------------------- */
+/** \name Keys
+ * \{ */
+
+/** 64 bit hash from two murmur hashes with different seeds. */
+class KeyHash {
+ private:
+  BLI_HashMurmur2A m_hash[2];
+
+ public:
+  KeyHash()
+  {
+    BLI_hash_mm2a_init(&m_hash[0], 0);
+    BLI_hash_mm2a_init(&m_hash[1], 0x9e3779b9);
+  }
+
+  void add(const void *data, size_t len)
+  {
+    BLI_hash_mm2a_add(&m_hash[0], (const unsigned char *)data, len);
+    BLI_hash_mm2a_add(&m_hash[1], (const unsigned char *)data, len);
+  }
+
+  void add_int(int value)
+  {
+    BLI_hash_mm2a_add_int(&m_hash[0], value);
+    BLI_hash_mm2a_add_int(&m_hash[1], value);
+  }
+
+  void add_float(float value)
+  {
+    add(&value, sizeof(value));
+  }
+
+  void add_pointer(const void *pointer)
+  {
+    add(&pointer, sizeof(pointer));
+  }
+
+  void add_string(const char *str)
+  {
+    add(str, strlen(str) + 1);
+  }
+
+  void add_key(BufferCache::Key key)
+  {
+    add(&key, sizeof(key));
+  }
+
+  /** Data allocated with MEM_mallocN, hashed with its allocated size. */
+  void add_alloc(const void *data)
+  {
+    if (data) {
+      add(data, MEM_allocN_len(data));
+    }
+    else {
+      add_int(0);
+    }
+  }
+
+  BufferCache::Key end()
+  {
+    BufferCache::Key key = ((BufferCache::Key)BLI_hash_mm2a_end(&m_hash[0]) << 32) |
+                           (BufferCache::Key)BLI_hash_mm2a_end(&m_hash[1]);
+    /* Zero is used for operations which can't be cached. */
+    return (key != 0) ? key : 1;
+  }
+};
+
+static void hash_curvemapping(KeyHash &hash, const CurveMapping *cumap)
+{
+  hash.add_int(cumap->flag);
+  hash.add(cumap->black, sizeof(cumap->black));
+  hash.add(cumap->white, sizeof(cumap->white));
+  hash.add_int(cumap->tone);
+  for (int i = 0; i < CM_TOT; i++) {
+    const CurveMap *cuma = &cumap->cm[i];
+    hash.add_int(cuma->totpoint);
+    hash.add(cuma->ext_in, sizeof(cuma->ext_in));
+    hash.add(cuma->ext_out, sizeof(cuma->ext_out));
+    if (cuma->curve) {
+      hash.add(cuma->curve, sizeof(CurveMapPoint) * cuma->totpoint);
+    }
+  }
+}
+
+/**
+ * Images are identified by the change id of their buffer, which changes when the image is
+ * reloaded, another frame is used or the pixels are modified. Buffer pointers can't be used, a
+ * reloaded buffer can get the address of the freed one. Images being painted or written by the
+ * renderer or compositor are not cached.
+ */
+static bool hash_image(KeyHash &hash, bNode *node)
+{
+  Image *image = (Image *)node->id;
+  if (!ELEM(image->type, IMA_TYPE_IMAGE, IMA_TYPE_MULTILAYER) || BKE_image_is_dirty(image)) {
+    return false;
+  }
+  hash.add_int(image->id.session_uuid);
+  hash.add_string(image->name);
+  hash.add_int(image->source);
+  hash.add_int(image->type);
+  hash.add_int(image->alpha_mode);
+  hash.add_string(image->colorspace_settings.name);
+
+  /* The frame number is updated for still images too, only use it when it matters. */
+  ImageUser iuser = *(ImageUser *)node->storage;
+  if (BKE_image_is_animated(image)) {
+    hash.add_int(iuser.framenr);
+  }
+  hash.add_int(iuser.tile);
+  hash.add_int(iuser.pass);
+  hash.add_int(iuser.multi_index);
+  hash.add_int(iuser.view);
+  hash.add_int(iuser.layer);
+
+  ImBuf *ibuf = BKE_image_acquire_ibuf(image, &iuser, NULL);
+  if (ibuf) {
+    hash.add_int(ibuf->change_id);
+    hash.add_int(ibuf->rect != NULL);
+    hash.add_int(ibuf->rect_float != NULL);
+    hash.add_int(ibuf->x);
+    hash.add_int(ibuf->y);
+  }
+  BKE_image_release_ibuf(image, ibuf, NULL);
+  return true;
+}
+
+static bool hash_defocus_camera(KeyHash &hash, const CompositorContext &context, bNode *node)
+{
+  Scene *scene = node->id ? (Scene *)node->id : context.getScene();
+  Object *camob = scene ? scene->camera : NULL;
+  hash.add_pointer(camob);
+  if (camob && camob->type == OB_CAMERA) {
+    Camera *camera = (Camera *)camob->data;
+    hash.add_float(camera->lens);
+    hash.add_int(camera->sensor_fit);
+    hash.add_float(camera->sensor_x);
+    hash.add_float(camera->sensor_y);
+    hash.add_float(BKE_camera_object_dof_distance(camob));
+  }
+  return true;
+}
+
+/**
+ * Hash the settings of a node: its type, buttons, storage, unlinked input values and the data
+ * it reads.
+ * \return false when the result of the node doesn't only depend on these.
+ */
+static bool hash_node(KeyHash &hash, const CompositorContext &context, bNode *node)
+{
+  hash.add_string(node->idname);
+  hash.add_int(node->type);
+  hash.add_int(node->custom1);
+  hash.add_int(node->custom2);
+  hash.add_float(node->custom3);
+  hash.add_float(node->custom4);
+
+  LISTBASE_FOREACH (bNodeSocket *, sock, &node->inputs) {
+    hash.add_int(sock->type);
+    hash.add_alloc(sock->default_value);
+  }
+
+  switch (node->type) {
+    case CMP_NODE_CURVE_VEC:
+    case CMP_NODE_CURVE_RGB:
+    case CMP_NODE_HUECORRECT:
+      hash_curvemapping(hash, (CurveMapping *)node->storage);
+      break;
+    case CMP_NODE_TIME:
+      hash_curvemapping(hash, (CurveMapping *)node->storage);
+      hash.add_int(context.getFramenumber());
+      break;
+    case CMP_NODE_IMAGE:
+      /* Image user, see hash_image. */
+      break;
+    case CMP_NODE_CRYPTOMATTE: {
+      NodeCryptomatte *data = (NodeCryptomatte *)node->storage;
+      hash.add_string(data->matte_id ? data->matte_id : "");
+      break;
+    }
+    default:
+      hash.add_alloc(node->storage);
+      break;
+  }
+
+  switch (node->type) {
+    case CMP_NODE_IMAGE:
+      return (node->id == NULL) || hash_image(hash, node);
+    case CMP_NODE_DEFOCUS:
+      return hash_defocus_camera(hash, context, node);
+    default:
+      /* Render layers, movie clips, masks, textures... */
+      return (node->id == NULL);
+  }
+}
+
+/** Settings of the context used when converting nodes to operations. */
+static BufferCache::Key context_key(const CompositorContext &context)
+{
+  const RenderData *rd = context.getRenderData();
+  KeyHash hash;
+  hash.add_int(context.getQuality());
+  hash.add_int(context.isFastCalculation());
+  hash.add_int(context.isRendering());
+  hash.add_int(context.isFullFrame());
+  hash.add_int(context.useHalfPrecision());
+  hash.add_string(context.getViewName() ? context.getViewName() : "");
+  hash.add_int(rd->size);
+  hash.add_int(rd->xsch);
+  hash.add_int(rd->ysch);
+  hash.add_int(rd->scemode & R_FULL_SAMPLE);
+  return hash.end();
+}
+
+class OperationKeys {
+ private:
+  const CompositorContext &m_context;
+  BufferCache::Key m_context_key;
+  std::map<const bNode *, BufferCache::Key> m_node_keys;
+  std::map<NodeOperation *, BufferCache::Key> m_operation_keys;
+
+  BufferCache::Key node_key(const bNode *node)
+  {
+    std::map<const bNode *, BufferCache::Key>::iterator it = m_node_keys.find(node);
+    if (it != m_node_keys.end()) {
+      return it->second;
+    }
+    KeyHash hash;
+    BufferCache::Key key = hash_node(hash, m_context, (bNode *)node) ? hash.end() : 0;
+    m_node_keys[node] = key;
+    return key;
+  }
+
+ public:
+  OperationKeys(const CompositorContext &context)
+      : m_context(context), m_context_key(context_key(context))
+  {
+  }
+
+  /** \return 0 when the operation can't be cached. */
+  BufferCache::Key operation_key(NodeOperation *operation)
+  {
+    std::map<NodeOperation *, BufferCache::Key>::iterator it = m_operation_keys.find(operation);
+    if (it != m_operation_keys.end()) {
+      return it->second;
+    }
+    /* Guard against cycles. */
+    m_operation_keys[operation] = 0;
+
+    BufferCache::Key key = 0;
+    if (operation->isReadBufferOperation()) {
+      MemoryProxy *proxy = ((ReadBufferOperation *)operation)->getMemoryProxy();
+      key = operation_key(proxy->getWriteBufferOperation());
+    }
+    else {
+      KeyHash hash;
+      bool cacheable = true;
+      hash.add_key(m_context_key);
+      hash.add_string(typeid(*operation).name());
+      hash.add_int(operation->getWidth());
+      hash.add_int(operation->getHeight());
+      if (operation->getNumberOfOutputSockets() > 0) {
+        hash.add_int(operation->getOutputSocket()->getDataType());
+      }
+      if (operation->isSetOperation()) {
+        /* Constants folded by the NodeOperationBuilder don't have a node. */
+        float value[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+        operation->readSampled(value, 0.0f, 0.0f, COM_PS_NEAREST);
+        for (int i = 0; i < 4; i++) {
+          hash.add_float(value[i]);
+        }
+      }
+      if (operation->getbNode()) {
+        BufferCache::Key node = node_key(operation->getbNode());
+        cacheable = (node != 0);
+        hash.add_key(node);
+      }
+      for (unsigned int index = 0; cacheable && index < operation->getNumberOfInputSockets();
+           index++) {
+        NodeOperationInput *input = operation->getInputSocket(index);
+        hash.add_int(input->getDataType());
+        hash.add_int(input->getResizeMode());
+        if (input->isConnected()) {
+          BufferCache::Key input_key = operation_key(&input->getLink()->getOperation());
+          cacheable = (input_key != 0);
+          hash.add_key(input_key);
+        }
+        else {
+          hash.add_int(0);
+        }
+      }
+      key = cacheable ? hash.end() : 0;
+    }
+
+    m_operation_keys[operation] = key;
+    return key;
+  }
+};
+
+void BufferCache::determineKeys(const CompositorContext &context,
+                                const std::vector<NodeOperation *> &operations,
+                                Keys &r_keys)
+{
+  OperationKeys keys(context);
+  for (unsigned int index = 0; index < operations.size(); index++) {
+    NodeOperation *operation = operations[index];
+    if (!operation->isWriteBufferOperation()) {
+      continue;
+    }
+    Key key = keys.operation_key(operation);
+    if (key != 0) {
+      r_keys[(WriteBufferOperation *)operation] = key;
+    }
+  }
+}
+
+/** \} */
+
+/* -------------------------------------------------------------------- */
+/** \name Storage
+ * \{ */
+
+typedef struct CacheEntry {
+  MemoryBuffer *buffer;
+  /** Position in the least recently used list. */
+  std::list<BufferCache::Key>::iterator lru;
+} CacheEntry;
+
+static std::map<BufferCache::Key, CacheEntry> g_entries;
+/** Keys ordered from least to most recently used. */
+static std::list<BufferCache::Key> g_lru;
+static size_t g_memory_in_use = 0;
+
+static size_t cache_limit()
+{
+  return ((size_t)U.compositor_cache_limit) * 1024 * 1024;
+}
+
+static void free_entry(std::map<BufferCache::Key, CacheEntry>::iterator it)
+{
+  CacheEntry &entry = it->second;
+  g_memory_in_use -= entry.buffer->getMemorySize();
+  g_lru.erase(entry.lru);
+  delete entry.buffer;
+  g_entries.erase(it);
+}
+
+static CacheEntry *find_entry(BufferCache::Key key,
+                              DataType datatype,
+                              unsigned int width,
+                              unsigned int height)
+{
+  std::map<BufferCache::Key, CacheEntry>::iterator it = g_entries.find(key);
+  if (it == g_entries.end()) {
+    return NULL;
+  }
+  MemoryBuffer *buffer = it->second.buffer;
+  if (buffer->get_data_type() != datatype || buffer->getWidth() != (int)width ||
+      buffer->getHeight() != (int)height) {
+    return NULL;
+  }
+  return &it->second;
+}
+
+bool BufferCache::contains(Key key, DataType datatype, unsigned int width, unsigned int height)
+{
+  return find_entry(key, datatype, width, height) != NULL;
+}
+
+bool BufferCache::read(Key key, MemoryBuffer *buffer)
+{
+  CacheEntry *entry = find_entry(
+      key, buffer->get_data_type(), buffer->getWidth(), buffer->getHeight());
+  if (entry == NULL) {
+    return false;
+  }
+  MemoryBuffer *cached = entry->buffer;
+  if (cached->isHalf()) {
+    cached->unpackHalf();
+    buffer->copyContentFrom(cached);
+    cached->packHalf();
+  }
+  else {
+    buffer->copyContentFrom(cached);
+  }
+  g_lru.splice(g_lru.end(), g_lru, entry->lru);
+  return true;
+}
+
+void BufferCache::write(Key key, MemoryBuffer *buffer, bool half)
+{
+  const bool packed = buffer->isHalf();
+  if (buffer->isSwappedOut() || (!packed && buffer->getBuffer() == NULL)) {
+    /* Swapped out or freed by the memory limit of full frame execution. */
+    return;
+  }
+  const size_t limit = cache_limit();
+  const size_t size = (half ? sizeof(unsigned short) : sizeof(float)) * buffer->getNumElements();
+  if (size > limit) {
+    return;
+  }
+
+  std::map<Key, CacheEntry>::iterator it = g_entries.find(key);
+  if (it != g_entries.end()) {
+    free_entry(it);
+  }
+  while (!g_lru.empty() && g_memory_in_use + size > limit) {
+    free_entry(g_entries.find(g_lru.front()));
+  }
+
+  if (packed) {
+    buffer->unpackHalf();
+  }
+  CacheEntry entry;
+  entry.buffer = new MemoryBuffer(buffer->get_data_type(), buffer->getRect());
+  entry.buffer->copyContentFrom(buffer);
+  if (packed) {
+    buffer->packHalf();
+  }
+  if (half) {
+    entry.buffer->packHalf();
+  }
+  entry.lru = g_lru.insert(g_lru.end(), key);
+  g_entries[key] = entry;
+  g_memory_in_use += size;
+}
+
+void BufferCache::clear()
+{
+  while (!g_entries.empty()) {
+    free_entry(g_entries.begin());
+  }
+}
+
+size_t BufferCache::getMemoryInUse()
+{
+  return g_memory_in_use;
+}
+
+/** \} */
@@ -0,0 +1,92 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * Copyright 2020, Blender Foundation.
+ */
+
+#ifndef __COM_BUFFERCACHE_H__
+#define __COM_BUFFERCACHE_H__
+
+#include <map>
+#include <vector>
+
+#include "BLI_sys_types.h"
+
+#include "COM_CompositorContext.h"
+#include "COM_MemoryBuffer.h"
+
+class NodeOperation;
+class WriteBufferOperation;
+
+/**
+ * \brief cache of WriteBufferOperation results, kept between executions of the compositor
+ *
+ * A buffer is identified by a key which is a hash of all operations it is calculated from: the
+ * operation types, their resolutions and links, the settings of the nodes they were converted
+ * from and the images these nodes read. When an edit doesn't change any of these, the buffer is
+ * copied from the cache and the operations writing it are not executed.
+ *
+ * Operations depending on data the key can't describe (render layers, movie clips, masks,
+ * textures...) are never cached, neither is anything calculated from them.
+ *
+ * The cache is shared by all node trees. Its size is limited by the compositor cache limit user
+ * preference, least recently used buffers are freed first.
+ *
+ * \note Only accessed from COM_execute, which is serialized by the compositor mutex.
+ * \ingroup Memory
+ */
+class BufferCache {
+ public:
+  typedef uint64_t Key;
+  typedef std::map<WriteBufferOperation *, Key> Keys;
+
+  /**
+   * \brief determine the keys of the write buffer operations which can be cached
+   * \param operations: all operations of the ExecutionSystem, the resolutions must be determined
+   * \param r_keys: keys of the write buffer operations, uncacheable operations are not added
+   */
+  static void determineKeys(const CompositorContext &context,
+                            const std::vector<NodeOperation *> &operations,
+                            Keys &r_keys);
+
+  /**
+   * \brief check if a buffer of the given size is cached
+   */
+  static bool contains(Key key, DataType datatype, unsigned int width, unsigned int height);
+
+  /**
+   * \brief copy the cached buffer to \a buffer
+   * \return false when no buffer with the same size is cached
+   */
+  static bool read(Key key, MemoryBuffer *buffer);
+
+  /**
+   * \brief store a copy of \a buffer, freeing least recently used buffers to stay in the limit
+   * \param half: store the copy as half floats, see MemoryBuffer.packHalf
+   */
+  static void write(Key key, MemoryBuffer *buffer, bool half = false);
+
+  /**
+   * \brief free all cached buffers
+   */
+  static void clear();
+
+  /**
+   * \brief memory used by the cached buffers in bytes
+   */
+  static size_t getMemoryInUse();
+};
+
+#endif /* __COM_BUFFERCACHE_H__ */
@@ -268,6 +268,42 @@ class CompositorContext {
   {
     return (this->getbNodeTree()->flag & NTREE_COM_GROUPNODE_BUFFER) != 0;
   }
+
+  /**
+   * \brief Calculate whole buffers per operation instead of pixels through tiles.
+   * \see FullFrameExecutionModel
+   */
+  bool isFullFrame() const
+  {
+    return (this->getbNodeTree()->flag & NTREE_COM_FULL_FRAME) != 0;
+  }
+
+  /**
+   * \brief Memory limit of the buffers calculated in full frame mode in bytes, 0 if unlimited.
+   * \see FullFrameExecutionModel
+   */
+  size_t getMemoryLimit() const
+  {
+    return (size_t)this->getbNodeTree()->memory_limit * 1024 * 1024;
+  }
+
+  /**
+   * \brief Store intermediate buffers as half floats while they aren't used.
+   * \see MemoryBuffer.packHalf
+   */
+  bool useHalfPrecision() const
+  {
+    return (this->getbNodeTree()->flag & NTREE_COM_HALF_PRECISION) != 0;
+  }
+
+  /**
+   * \brief Reuse buffers of unchanged parts of the node tree from previous executions.
+   * \see BufferCache
+   */
+  bool useBufferCache() const
+  {
+    return (this->getbNodeTree()->flag & NTREE_COM_BUFFER_CACHE) != 0;
+  }
 };
 
 #endif
@@ -150,6 +150,26 @@ void ExecutionGroup::initExecution()
   this->m_cachedMaxReadBufferOffset = maxNumber;
 }
 
+void ExecutionGroup::setChunksExecuted()
+{
+  for (unsigned int index = 0; index < this->m_numberOfChunks; index++) {
+    this->m_chunkExecutionStates[index] = COM_ES_EXECUTED;
+  }
+}
+
+bool ExecutionGroup::isChunksExecuted() const
+{
+  if (this->m_chunkExecutionStates == NULL) {
+    return false;
+  }
+  for (unsigned int index = 0; index < this->m_numberOfChunks; index++) {
+    if (this->m_chunkExecutionStates[index] != COM_ES_EXECUTED) {
+      return false;
+    }
+  }
+  return true;
+}
+
 void ExecutionGroup::deinitExecution()
 {
   if (this->m_chunkExecutionStates != NULL) {
@@ -341,6 +341,18 @@ class ExecutionGroup {
    */
   void initExecution();
 
+  /**
+   * \brief mark all chunks as executed, so they will not be scheduled.
+   * Used when the result is already available in the output MemoryProxy (see BufferCache).
+   * \note must be called after initExecution
+   */
+  void setChunksExecuted();
+
+  /**
+   * \brief check if all chunks are executed
+   */
+  bool isChunksExecuted() const;
+
   /**
    * \brief get all inputbuffers needed to calculate an chunk
    * \note all inputbuffers must be executed
@@ -436,6 +448,15 @@ class ExecutionGroup {
 
   void setRenderBorder(float xmin, float xmax, float ymin, float ymax);
 
+  /**
+   * \brief get the area of the output operation to calculate
+   * \note measured in pixel space
+   */
+  const rcti *getViewerBorder() const
+  {
+    return &this->m_viewerBorder;
+  }
+
   /* allow the DebugInfo class to look at internals */
   friend class DebugInfo;
 
@@ -26,12 +26,15 @@ extern "C" {
 
 #include "BLT_translation.h"
 
+#include "COM_BufferCache.h"
 #include "COM_Converter.h"
 #include "COM_NodeOperationBuilder.h"
 #include "COM_NodeOperation.h"
 #include "COM_ExecutionGroup.h"
+#include "COM_FullFrameExecutionModel.h"
 #include "COM_WorkScheduler.h"
 #include "COM_ReadBufferOperation.h"
+#include "COM_WriteBufferOperation.h"
 #include "COM_Debug.h"
 
 #ifdef WITH_CXX_GUARDEDALLOC
@@ -148,6 +151,38 @@ void ExecutionSystem::execute()
   }
   unsigned int index;
 
+  /* Find the write buffers of which the result is cached, so their inputs can be skipped. */
+  BufferCache::Keys cacheKeys;
+  std::set<NodeOperation *> cachedWriteBuffers;
+  if (this->m_context.useBufferCache()) {
+    BufferCache::determineKeys(this->m_context, this->m_operations, cacheKeys);
+    for (BufferCache::Keys::iterator it = cacheKeys.begin(); it != cacheKeys.end(); ++it) {
+      WriteBufferOperation *operation = it->first;
+      if (BufferCache::contains(it->second,
+                                operation->getMemoryProxy()->getDataType(),
+                                operation->getWidth(),
+                                operation->getHeight())) {
+        cachedWriteBuffers.insert(operation);
+      }
+    }
+  }
+  else {
+    BufferCache::clear();
+  }
+
+  /* Must redirect the socket readers before the operations are initialized. */
+  FullFrameExecutionModel *fullFrameModel = NULL;
+  if (this->m_context.isFullFrame()) {
+    vector<ExecutionGroup *> outputGroups;
+    findOutputExecutionGroup(&outputGroups, COM_PRIORITY_HIGH);
+    if (!this->getContext().isFastCalculation()) {
+      findOutputExecutionGroup(&outputGroups, COM_PRIORITY_MEDIUM);
+      findOutputExecutionGroup(&outputGroups, COM_PRIORITY_LOW);
+    }
+    fullFrameModel = new FullFrameExecutionModel(
+        this->m_context, outputGroups, cachedWriteBuffers);
+  }
+
   // First allocale all write buffer
   for (index = 0; index < this->m_operations.size(); index++) {
     NodeOperation *operation = this->m_operations[index];
@@ -156,6 +191,11 @@ void ExecutionSystem::execute()
       operation->initExecution();
     }
   }
+  for (BufferCache::Keys::iterator it = cacheKeys.begin(); it != cacheKeys.end(); ++it) {
+    if (cachedWriteBuffers.count(it->first)) {
+      BufferCache::read(it->second, it->first->getMemoryProxy()->getBuffer());
+    }
+  }
   // Connect read buffers to their write buffers
   for (index = 0; index < this->m_operations.size(); index++) {
     NodeOperation *operation = this->m_operations[index];
@@ -172,31 +212,75 @@ void ExecutionSystem::execute()
       operation->initExecution();
     }
   }
-  for (index = 0; index < this->m_groups.size(); index++) {
-    ExecutionGroup *executionGroup = this->m_groups[index];
-    executionGroup->setChunksize(this->m_context.getChunksize());
-    executionGroup->initExecution();
+
+  bool failed = false;
+  if (fullFrameModel) {
+    failed = !fullFrameModel->execute();
   }
+  else {
+    for (index = 0; index < this->m_groups.size(); index++) {
+      ExecutionGroup *executionGroup = this->m_groups[index];
+      executionGroup->setChunksize(this->m_context.getChunksize());
+      executionGroup->initExecution();
+    }
+    for (std::set<NodeOperation *>::iterator it = cachedWriteBuffers.begin();
+         it != cachedWriteBuffers.end();
+         ++it) {
+      ExecutionGroup *executor = ((WriteBufferOperation *)*it)->getMemoryProxy()->getExecutor();
+      if (executor) {
+        executor->setChunksExecuted();
+      }
+    }
 
-  WorkScheduler::start(this->m_context);
+    WorkScheduler::start(this->m_context);
+
+    executeGroups(COM_PRIORITY_HIGH);
+    if (!this->getContext().isFastCalculation()) {
+      executeGroups(COM_PRIORITY_MEDIUM);
+      executeGroups(COM_PRIORITY_LOW);
+    }
 
-  executeGroups(COM_PRIORITY_HIGH);
-  if (!this->getContext().isFastCalculation()) {
-    executeGroups(COM_PRIORITY_MEDIUM);
-    executeGroups(COM_PRIORITY_LOW);
+    WorkScheduler::finish();
+    WorkScheduler::stop();
   }
 
-  WorkScheduler::finish();
-  WorkScheduler::stop();
+  /* Cache the write buffers which are completely calculated. */
+  if (!cacheKeys.empty() && !failed && !editingtree->test_break(editingtree->tbh)) {
+    for (BufferCache::Keys::iterator it = cacheKeys.begin(); it != cacheKeys.end(); ++it) {
+      WriteBufferOperation *operation = it->first;
+      if (cachedWriteBuffers.count(operation)) {
+        continue;
+      }
+      MemoryProxy *proxy = operation->getMemoryProxy();
+      bool is_calculated;
+      if (fullFrameModel) {
+        is_calculated = fullFrameModel->isCalculated(operation);
+      }
+      else {
+        is_calculated = proxy->getExecutor() && proxy->getExecutor()->isChunksExecuted();
+      }
+      if (is_calculated) {
+        BufferCache::write(it->second, proxy->getBuffer(), m_context.useHalfPrecision());
+      }
+    }
+  }
 
-  editingtree->stats_draw(editingtree->sdh, TIP_("Compositing | De-initializing execution"));
+  if (!failed) {
+    /* Keep the error in the stats otherwise. */
+    editingtree->stats_draw(editingtree->sdh, TIP_("Compositing | De-initializing execution"));
+  }
   for (index = 0; index < this->m_operations.size(); index++) {
     NodeOperation *operation = this->m_operations[index];
     operation->deinitExecution();
   }
-  for (index = 0; index < this->m_groups.size(); index++) {
-    ExecutionGroup *executionGroup = this->m_groups[index];
-    executionGroup->deinitExecution();
+  if (fullFrameModel) {
+    delete fullFrameModel;
+  }
+  else {
+    for (index = 0; index < this->m_groups.size(); index++) {
+      ExecutionGroup *executionGroup = this->m_groups[index];
+      executionGroup->deinitExecution();
+    }
   }
 }
 
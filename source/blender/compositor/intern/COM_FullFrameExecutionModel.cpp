@@ -0,0 +1,618 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * Copyright 2020, Blender Foundation.
+ */
+
+#include "COM_FullFrameExecutionModel.h"
+
+#include <algorithm>
+#include <limits.h>
+
+#include "COM_BufferOperation.h"
+#include "COM_ReadBufferOperation.h"
+#include "COM_WriteBufferOperation.h"
+
+#include "BLI_path_util.h"
+#include "BLI_string.h"
+#include "BLI_task.h"
+#include "BLI_threads.h"
+#include "BLT_translation.h"
+
+extern "C" {
+#include "BKE_appdir.h"
+}
+
+#ifdef WITH_CXX_GUARDEDALLOC
+#  include "MEM_guardedalloc.h"
+#endif
+
+FullFrameExecutionModel::FullFrameExecutionModel(
+    const CompositorContext &context,
+    const std::vector<ExecutionGroup *> &groups,
+    const std::set<NodeOperation *> &cached_write_buffers)
+    : m_context(context),
+      m_cachedWriteBuffers(cached_write_buffers),
+      m_memoryLimit(context.getMemoryLimit()),
+      m_memoryInUse(0),
+      m_halfPrecision(context.useHalfPrecision())
+{
+  std::set<NodeOperation *> visited;
+  for (unsigned int index = 0; index < groups.size(); index++) {
+    NodeOperation *operation = groups[index]->getOutputOperation();
+    m_outputAreas[operation] = *groups[index]->getViewerBorder();
+    addOperation(operation, visited);
+  }
+
+  /* Every output which is read gets a buffer. */
+  for (unsigned int index = 0; index < m_operations.size(); index++) {
+    NodeOperation *operation = m_operations[index];
+    if (operation->getNumberOfOutputSockets() == 0 || operation->isReadBufferOperation()) {
+      continue;
+    }
+    BLI_assert(operation->getNumberOfOutputSockets() == 1);
+    NodeOperationOutput *output = operation->getOutputSocket();
+    OperationBuffer &buffer = m_buffers[operation];
+    buffer.buffer = NULL;
+    buffer.reader = new BufferOperation(
+        output->getDataType(), operation->getWidth(), operation->getHeight());
+    buffer.write_proxy = NULL;
+    buffer.num_readers_left = 0;
+    output->setBufferReader(buffer.reader);
+  }
+
+  std::map<NodeOperation *, NodeOperation *> last_reader;
+  for (unsigned int index = 0; index < m_operations.size(); index++) {
+    NodeOperation *operation = m_operations[index];
+    for (unsigned int i = 0; i < operation->getNumberOfInputSockets(); i++) {
+      NodeOperation *input = operation->getInputOperation(i);
+      if (input && m_buffers.count(input)) {
+        m_buffers[input].num_readers_left++;
+        last_reader[input] = operation;
+      }
+    }
+  }
+
+  /* Fuse point operations into the point operation reading them. Operations calculating
+   * buffers directly keep their buffers, and so do their inputs: pulling pixels through a fused
+   * operation is slower than a loop over the buffers. */
+  for (int index = m_operations.size() - 1; index >= 0; index--) {
+    NodeOperation *operation = m_operations[index];
+    std::map<NodeOperation *, OperationBuffer>::iterator it = m_buffers.find(operation);
+    if (it == m_buffers.end() || it->second.num_readers_left != 1) {
+      continue;
+    }
+    NodeOperation *reader = last_reader[operation];
+    if (!operation->isPointOperation() || !reader->isPointOperation() ||
+        operation->isFullFrameOperation() || reader->isFullFrameOperation()) {
+      continue;
+    }
+    operation->getOutputSocket()->setBufferReader(NULL);
+    delete it->second.reader;
+    m_buffers.erase(it);
+    m_fused.insert(operation);
+  }
+
+  if (m_memoryLimit || m_halfPrecision) {
+    /* Operations read the inputs of fused operations when they are calculated. */
+    std::map<NodeOperation *, unsigned int> reader_index;
+    for (int index = m_operations.size() - 1; index >= 0; index--) {
+      NodeOperation *operation = m_operations[index];
+      const unsigned int calculate_index = m_fused.count(operation) ?
+                                               reader_index[last_reader[operation]] :
+                                               index;
+      reader_index[operation] = calculate_index;
+      for (unsigned int i = 0; i < operation->getNumberOfInputSockets(); i++) {
+        NodeOperation *input = operation->getInputOperation(i);
+        if (input == NULL || m_fused.count(input)) {
+          continue;
+        }
+        if (input->isReadBufferOperation()) {
+          input = ((ReadBufferOperation *)input)->getMemoryProxy()->getWriteBufferOperation();
+        }
+        m_readers[input].push_back(calculate_index);
+      }
+    }
+  }
+
+  /* Calculate directly into write buffers, unless the result is needed elsewhere too. */
+  for (unsigned int index = 0; index < m_operations.size(); index++) {
+    NodeOperation *operation = m_operations[index];
+    if (!operation->isWriteBufferOperation() || m_cachedWriteBuffers.count(operation)) {
+      continue;
+    }
+    NodeOperation *input = operation->getInputOperation(0);
+    if (input == NULL || !m_buffers.count(input) || input->isSetOperation()) {
+      continue;
+    }
+    OperationBuffer &buffer = m_buffers[input];
+    if (buffer.num_readers_left == 1 && input->getWidth() == operation->getWidth() &&
+        input->getHeight() == operation->getHeight()) {
+      buffer.write_proxy = ((WriteBufferOperation *)operation)->getMemoryProxy();
+    }
+  }
+}
+
+FullFrameExecutionModel::~FullFrameExecutionModel()
+{
+  for (std::map<NodeOperation *, OperationBuffer>::iterator it = m_buffers.begin();
+       it != m_buffers.end();
+       ++it) {
+    OperationBuffer &buffer = it->second;
+    if (buffer.buffer && buffer.write_proxy == NULL) {
+      delete buffer.buffer;
+    }
+    it->first->getOutputSocket()->setBufferReader(NULL);
+    delete buffer.reader;
+  }
+}
+
+void FullFrameExecutionModel::addOperation(NodeOperation *operation,
+                                           std::set<NodeOperation *> &visited)
+{
+  if (!visited.insert(operation).second) {
+    return;
+  }
+  if (m_cachedWriteBuffers.count(operation)) {
+    m_operations.push_back(operation);
+    return;
+  }
+  if (operation->isReadBufferOperation()) {
+    MemoryProxy *proxy = ((ReadBufferOperation *)operation)->getMemoryProxy();
+    addOperation(proxy->getWriteBufferOperation(), visited);
+  }
+  for (unsigned int index = 0; index < operation->getNumberOfInputSockets(); index++) {
+    NodeOperation *input = operation->getInputOperation(index);
+    if (input) {
+      addOperation(input, visited);
+    }
+  }
+  m_operations.push_back(operation);
+}
+
+MemoryBuffer *FullFrameExecutionModel::getOutputBuffer(NodeOperation *operation)
+{
+  if (operation->isReadBufferOperation()) {
+    return ((ReadBufferOperation *)operation)->getMemoryProxy()->getBuffer();
+  }
+  std::map<NodeOperation *, OperationBuffer>::iterator it = m_buffers.find(operation);
+  return (it != m_buffers.end()) ? it->second.buffer : NULL;
+}
+
+void FullFrameExecutionModel::getInputBuffers(NodeOperation *operation,
+                                              std::vector<MemoryBuffer *> &r_inputs)
+{
+  r_inputs.resize(operation->getNumberOfInputSockets() + 1, NULL);
+  for (unsigned int index = 0; index < operation->getNumberOfInputSockets(); index++) {
+    NodeOperation *input = operation->getInputOperation(index);
+    r_inputs[index] = input ? getOutputBuffer(input) : NULL;
+  }
+}
+
+void FullFrameExecutionModel::getReadBuffers(NodeOperation *operation,
+                                             std::vector<MemoryBuffer *> &r_buffers)
+{
+  for (unsigned int index = 0; index < operation->getNumberOfInputSockets(); index++) {
+    NodeOperation *input = operation->getInputOperation(index);
+    if (input == NULL) {
+      continue;
+    }
+    if (m_fused.count(input)) {
+      getReadBuffers(input, r_buffers);
+    }
+    else if (MemoryBuffer *buffer = getOutputBuffer(input)) {
+      r_buffers.push_back(buffer);
+    }
+  }
+}
+
+void FullFrameExecutionModel::releaseInputBuffers(NodeOperation *operation)
+{
+  for (unsigned int index = 0; index < operation->getNumberOfInputSockets(); index++) {
+    NodeOperation *input = operation->getInputOperation(index);
+    if (input && m_fused.count(input)) {
+      releaseInputBuffers(input);
+      continue;
+    }
+    std::map<NodeOperation *, OperationBuffer>::iterator it = m_buffers.find(input);
+    if (it == m_buffers.end()) {
+      continue;
+    }
+    OperationBuffer &buffer = it->second;
+    buffer.num_readers_left--;
+    if (buffer.num_readers_left == 0 && buffer.write_proxy == NULL) {
+      removeSwappable(buffer.buffer);
+      delete buffer.buffer;
+      buffer.buffer = NULL;
+      buffer.reader->setBuffer(NULL);
+    }
+  }
+}
+
+static size_t buffer_size(DataType datatype, unsigned int width, unsigned int height)
+{
+  const size_t num_channels = (datatype == COM_DT_VALUE) ?
+                                  COM_NUM_CHANNELS_VALUE :
+                                  (datatype == COM_DT_VECTOR) ? COM_NUM_CHANNELS_VECTOR :
+                                                                COM_NUM_CHANNELS_COLOR;
+  return sizeof(float) * num_channels * width * height;
+}
+
+/** The data of the buffer is in memory, as floats or half floats. */
+static bool is_resident(MemoryBuffer *buffer)
+{
+  return !buffer->isSwappedOut() && (buffer->getBuffer() || buffer->isHalf());
+}
+
+void FullFrameExecutionModel::addSwappable(MemoryBuffer *buffer, NodeOperation *operation)
+{
+  if (!(m_memoryLimit || m_halfPrecision) || buffer == NULL || buffer->is_single_elem()) {
+    return;
+  }
+  std::map<MemoryBuffer *, std::vector<unsigned int>>::iterator it = m_swappable.find(buffer);
+  if (it == m_swappable.end()) {
+    it = m_swappable.insert(std::make_pair(buffer, std::vector<unsigned int>())).first;
+    m_memoryInUse += buffer->getMemorySize();
+  }
+  const std::vector<unsigned int> &readers = m_readers[operation];
+  it->second.insert(it->second.end(), readers.begin(), readers.end());
+  std::sort(it->second.begin(), it->second.end());
+}
+
+void FullFrameExecutionModel::removeSwappable(MemoryBuffer *buffer)
+{
+  std::map<MemoryBuffer *, std::vector<unsigned int>>::iterator it = m_swappable.find(buffer);
+  if (it == m_swappable.end()) {
+    return;
+  }
+  if (is_resident(buffer)) {
+    m_memoryInUse -= buffer->getMemorySize();
+  }
+  m_swappable.erase(it);
+}
+
+void FullFrameExecutionModel::reportError(const char *message)
+{
+  const bNodeTree *tree = m_context.getbNodeTree();
+  tree->stats_draw(tree->sdh, message);
+}
+
+bool FullFrameExecutionModel::limitMemory(unsigned int index, NodeOperation *operation)
+{
+  if (!(m_memoryLimit || m_halfPrecision)) {
+    return true;
+  }
+
+  /* Buffers the operation reads and writes. */
+  std::vector<MemoryBuffer *> needed;
+  getReadBuffers(operation, needed);
+  size_t required = 0;
+  if (operation->isWriteBufferOperation()) {
+    needed.push_back(((WriteBufferOperation *)operation)->getMemoryProxy()->getBuffer());
+  }
+  else {
+    std::map<NodeOperation *, OperationBuffer>::iterator it = m_buffers.find(operation);
+    if (it != m_buffers.end() && !operation->isSetOperation()) {
+      if (it->second.write_proxy) {
+        needed.push_back(it->second.write_proxy->getBuffer());
+      }
+      else {
+        required += buffer_size(
+            operation->getOutputSocket()->getDataType(), operation->getWidth(), operation->getHeight());
+      }
+    }
+  }
+  for (unsigned int i = 0; i < needed.size(); i++) {
+    MemoryBuffer *buffer = needed[i];
+    if (buffer == NULL) {
+      continue;
+    }
+    const size_t float_size = sizeof(float) * buffer->getNumElements();
+    if (buffer->isSwappedOut() || !m_swappable.count(buffer)) {
+      required += float_size;
+    }
+    else if (buffer->isHalf()) {
+      required += float_size - buffer->getMemorySize();
+    }
+  }
+
+  /* Make room, starting with the buffer which is read last. */
+  while (m_memoryLimit && m_memoryInUse + required > m_memoryLimit) {
+    MemoryBuffer *victim = NULL;
+    unsigned int victim_next_read = 0;
+    for (std::map<MemoryBuffer *, std::vector<unsigned int>>::iterator it = m_swappable.begin();
+         it != m_swappable.end();
+         ++it) {
+      MemoryBuffer *buffer = it->first;
+      if (!is_resident(buffer) || std::find(needed.begin(), needed.end(), buffer) != needed.end()) {
+        continue;
+      }
+      std::vector<unsigned int>::iterator next = std::upper_bound(
+          it->second.begin(), it->second.end(), index);
+      const unsigned int next_read = (next != it->second.end()) ? *next : UINT_MAX;
+      if (victim == NULL || next_read > victim_next_read) {
+        victim = buffer;
+        victim_next_read = next_read;
+      }
+    }
+    if (victim == NULL) {
+      /* The buffers of the operation alone don't fit. */
+      reportError(TIP_("Compositing | Buffers of an operation exceed the memory limit"));
+      return false;
+    }
+
+    if (victim_next_read == UINT_MAX) {
+      /* A write buffer which isn't read anymore. */
+      m_memoryInUse -= victim->getMemorySize();
+      victim->freeData();
+      m_swappable.erase(victim);
+      continue;
+    }
+
+    char name[64], filepath[FILE_MAX];
+    BLI_snprintf(name, sizeof(name), "compositor_%p.swap", (void *)victim);
+    BLI_join_dirfile(filepath, sizeof(filepath), BKE_tempdir_session(), name);
+    if (!victim->swapOut(filepath)) {
+      reportError(TIP_("Compositing | Failed to write a buffer to the temporary directory"));
+      return false;
+    }
+    m_memoryInUse -= victim->getMemorySize();
+  }
+
+  for (unsigned int i = 0; i < needed.size(); i++) {
+    MemoryBuffer *buffer = needed[i];
+    if (buffer && buffer->isSwappedOut()) {
+      if (!buffer->swapIn()) {
+        reportError(TIP_("Compositing | Failed to read a swapped out buffer"));
+        return false;
+      }
+      m_memoryInUse += buffer->getMemorySize();
+    }
+    if (buffer && buffer->isHalf()) {
+      m_memoryInUse -= buffer->getMemorySize();
+      buffer->unpackHalf();
+      m_memoryInUse += buffer->getMemorySize();
+    }
+  }
+  return true;
+}
+
+void FullFrameExecutionModel::packBuffers()
+{
+  if (!m_halfPrecision) {
+    return;
+  }
+  for (std::map<MemoryBuffer *, std::vector<unsigned int>>::iterator it = m_swappable.begin();
+       it != m_swappable.end();
+       ++it) {
+    MemoryBuffer *buffer = it->first;
+    if (buffer->getBuffer()) {
+      m_memoryInUse -= buffer->getMemorySize();
+      buffer->packHalf();
+      m_memoryInUse += buffer->getMemorySize();
+    }
+  }
+}
+
+typedef struct CalculateAreaData {
+  NodeOperation *operation;
+  MemoryBuffer *output;
+  MemoryBuffer **inputs;
+  const rcti *area;
+  int band_height;
+} CalculateAreaData;
+
+static void calculate_area_band(void *__restrict userdata,
+                                const int band,
+                                const TaskParallelTLS *__restrict /*tls*/)
+{
+  CalculateAreaData *data = (CalculateAreaData *)userdata;
+  if (data->operation->isBraked()) {
+    return;
+  }
+
+  rcti rect = *data->area;
+  rect.ymin = data->area->ymin + band * data->band_height;
+  rect.ymax = min(rect.ymin + data->band_height, data->area->ymax);
+
+  if (data->output) {
+    data->operation->update_memory_buffer(data->output, &rect, data->inputs);
+  }
+  else {
+    data->operation->executeRegion(&rect, 0);
+  }
+}
+
+void FullFrameExecutionModel::calculateArea(NodeOperation *operation,
+                                            MemoryBuffer *output,
+                                            const rcti *area,
+                                            MemoryBuffer **inputs)
+{
+  if (BLI_rcti_is_empty(area)) {
+    return;
+  }
+
+  const int height = BLI_rcti_size_y(area);
+  int num_bands = operation->isSingleThreaded() ? 1 : BLI_system_thread_count() * 4;
+  num_bands = max(1, min(num_bands, height));
+
+  CalculateAreaData data;
+  data.operation = operation;
+  data.output = output;
+  data.inputs = inputs;
+  data.area = area;
+  data.band_height = (height + num_bands - 1) / num_bands;
+  num_bands = (height + data.band_height - 1) / data.band_height;
+
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+  settings.use_threading = num_bands > 1;
+  settings.min_iter_per_thread = 1;
+  BLI_task_parallel_range(0, num_bands, &data, calculate_area_band, &settings);
+}
+
+typedef struct CopyWriteBufferData {
+  MemoryBuffer *source;
+  MemoryBuffer *target;
+} CopyWriteBufferData;
+
+static void copy_write_buffer_row(void *__restrict userdata,
+                                  const int y,
+                                  const TaskParallelTLS *__restrict /*tls*/)
+{
+  CopyWriteBufferData *data = (CopyWriteBufferData *)userdata;
+  MemoryBuffer *source = data->source;
+  MemoryBuffer *target = data->target;
+  const unsigned int num_channels = target->get_num_channels();
+  float *dst = target->getBuffer() + (size_t)y * target->getWidth() * num_channels;
+
+  if (source->is_single_elem()) {
+    for (int x = 0; x < target->getWidth(); x++, dst += num_channels) {
+      memcpy(dst, source->getBuffer(), sizeof(float) * num_channels);
+    }
+    return;
+  }
+
+  /* Same as MemoryBuffer::copyContentFrom, for one row of the target. */
+  const rcti *source_rect = source->getRect();
+  const rcti *target_rect = target->getRect();
+  const int other_y = target_rect->ymin + y;
+  if (other_y < source_rect->ymin || other_y >= source_rect->ymax) {
+    return;
+  }
+  const int min_x = max(source_rect->xmin, target_rect->xmin);
+  const int max_x = min(source_rect->xmax, target_rect->xmax);
+  if (min_x >= max_x) {
+    return;
+  }
+  const float *src = source->getBuffer() +
+                     ((size_t)(other_y - source_rect->ymin) * source->getWidth() + min_x -
+                      source_rect->xmin) *
+                         num_channels;
+  memcpy(dst + (size_t)(min_x - target_rect->xmin) * num_channels,
+         src,
+         sizeof(float) * (max_x - min_x) * num_channels);
+}
+
+void FullFrameExecutionModel::calculateWriteBuffer(NodeOperation *operation)
+{
+  MemoryBuffer *target = ((WriteBufferOperation *)operation)->getMemoryProxy()->getBuffer();
+  NodeOperation *input = operation->getInputOperation(0);
+  if (input == NULL || m_cachedWriteBuffers.count(operation)) {
+    return;
+  }
+  std::map<NodeOperation *, OperationBuffer>::iterator it = m_buffers.find(input);
+  if (it != m_buffers.end() && it->second.write_proxy != NULL) {
+    /* Already calculated into the write buffer. */
+    return;
+  }
+
+  MemoryBuffer *source = getOutputBuffer(input);
+  if (source == NULL || source == target) {
+    return;
+  }
+
+  /* Copy from the worker threads, the write buffer isn't touched yet and its pages get placed on
+   * the NUMA nodes of the threads writing them, like buffers calculated by the operations. */
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+  settings.min_iter_per_thread = 16;
+  CopyWriteBufferData data = {source, target};
+  BLI_task_parallel_range(0, target->getHeight(), &data, copy_write_buffer_row, &settings);
+}
+
+void FullFrameExecutionModel::calculateOperation(NodeOperation *operation)
+{
+  std::vector<MemoryBuffer *> inputs;
+  getInputBuffers(operation, inputs);
+
+  std::map<NodeOperation *, rcti>::iterator output_it = m_outputAreas.find(operation);
+  if (output_it != m_outputAreas.end() && operation->getNumberOfOutputSockets() == 0) {
+    calculateArea(operation, NULL, &output_it->second, &inputs[0]);
+    operation->updateDraw();
+    return;
+  }
+
+  std::map<NodeOperation *, OperationBuffer>::iterator it = m_buffers.find(operation);
+  if (it == m_buffers.end()) {
+    return;
+  }
+  OperationBuffer &buffer = it->second;
+  const DataType datatype = operation->getOutputSocket()->getDataType();
+  rcti area;
+  BLI_rcti_init(&area, 0, operation->getWidth(), 0, operation->getHeight());
+
+  if (operation->isSetOperation()) {
+    float color[4];
+    buffer.buffer = new MemoryBuffer(datatype, &area, true);
+    operation->readSampled(color, 0, 0, COM_PS_NEAREST);
+    memcpy(buffer.buffer->getBuffer(), color, sizeof(float) * buffer.buffer->get_num_channels());
+  }
+  else {
+    if (buffer.write_proxy) {
+      buffer.buffer = buffer.write_proxy->getBuffer();
+    }
+    else {
+      buffer.buffer = new MemoryBuffer(datatype, &area, false);
+    }
+    calculateArea(operation, buffer.buffer, &area, &inputs[0]);
+    addSwappable(buffer.buffer, operation);
+    if (buffer.write_proxy) {
+      addSwappable(buffer.buffer, buffer.write_proxy->getWriteBufferOperation());
+    }
+  }
+  buffer.reader->setBuffer(buffer.buffer);
+}
+
+bool FullFrameExecutionModel::execute()
+{
+  const bNodeTree *tree = m_context.getbNodeTree();
+  const unsigned int num_operations = m_operations.size();
+
+  for (unsigned int index = 0; index < num_operations; index++) {
+    NodeOperation *operation = m_operations[index];
+    if (tree->test_break && tree->test_break(tree->tbh)) {
+      break;
+    }
+    if (m_fused.count(operation)) {
+      /* Calculated by the operation reading it. */
+      continue;
+    }
+
+    if (!limitMemory(index, operation)) {
+      return false;
+    }
+    if (operation->isWriteBufferOperation()) {
+      calculateWriteBuffer(operation);
+      addSwappable(((WriteBufferOperation *)operation)->getMemoryProxy()->getBuffer(), operation);
+    }
+    else if (!operation->isReadBufferOperation()) {
+      calculateOperation(operation);
+    }
+    releaseInputBuffers(operation);
+    packBuffers();
+    m_calculated.insert(operation);
+
+    tree->progress(tree->prh, (float)(index + 1) / (float)num_operations);
+    char buf[128];
+    BLI_snprintf(buf,
+                 sizeof(buf),
+                 TIP_("Compositing | Operation %u-%u"),
+                 index + 1,
+                 num_operations);
+    tree->stats_draw(tree->sdh, buf);
+  }
+  return true;
+}
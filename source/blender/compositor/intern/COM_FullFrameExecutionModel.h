@@ -0,0 +1,154 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * Copyright 2020, Blender Foundation.
+ */
+
+#ifndef __COM_FULLFRAMEEXECUTIONMODEL_H__
+#define __COM_FULLFRAMEEXECUTIONMODEL_H__
+
+#include <map>
+#include <set>
+#include <vector>
+
+#include "COM_CompositorContext.h"
+#include "COM_ExecutionGroup.h"
+#include "COM_NodeOperation.h"
+
+class BufferOperation;
+
+/**
+ * \brief executes operations one at a time on whole buffers
+ *
+ * Instead of pulling pixels through the operations of an ExecutionGroup chunk by chunk, every
+ * operation is calculated into a MemoryBuffer covering its whole resolution, after the
+ * operations it reads from. Operations implementing NodeOperation::update_memory_buffer read
+ * their inputs from these buffers directly, other operations read them pixel by pixel through
+ * their socket readers, which are redirected to the buffers (see BufferOperation).
+ *
+ * Buffers are freed once all operations reading them are calculated. Constant operations are
+ * stored as single element buffers.
+ *
+ * Chains of point operations (see NodeOperation.isPointOperation) are fused: a point operation
+ * read only by another point operation doesn't get a buffer, its reader pulls the pixels through
+ * it like in tiled execution. Operations implementing update_memory_buffer are not fused, and
+ * neither are their inputs (see NodeOperation.isFullFrameOperation).
+ *
+ * With a memory limit, buffers are written to temporary files when the buffers needed by the
+ * next operation don't fit, starting with the buffers which are read last. Write buffers which
+ * aren't read anymore are freed instead. With half precision, buffers are stored as half floats
+ * while no operation is using them.
+ *
+ * \note OpenCL devices are not used in this mode.
+ * \ingroup Execution
+ */
+class FullFrameExecutionModel {
+ private:
+  typedef struct OperationBuffer {
+    /** Result of the operation, NULL until it is calculated. */
+    MemoryBuffer *buffer;
+    /** Socket reader of the output, reading from #buffer. */
+    BufferOperation *reader;
+    /** Proxy of the WriteBufferOperation which is the only reader, calculated directly into. */
+    MemoryProxy *write_proxy;
+    /** Number of operations reading the buffer which aren't calculated yet. */
+    int num_readers_left;
+  } OperationBuffer;
+
+  const CompositorContext &m_context;
+
+  /** Operations in the order they are calculated, operations come after their inputs. */
+  std::vector<NodeOperation *> m_operations;
+
+  /** Areas to calculate of the output operations. */
+  std::map<NodeOperation *, rcti> m_outputAreas;
+
+  std::map<NodeOperation *, OperationBuffer> m_buffers;
+
+  /** Write buffer operations of which the memory proxy is filled from the BufferCache. */
+  const std::set<NodeOperation *> &m_cachedWriteBuffers;
+
+  /** Operations which are calculated. */
+  std::set<NodeOperation *> m_calculated;
+
+  /** Point operations without buffer, calculated by the operation reading them. */
+  std::set<NodeOperation *> m_fused;
+
+  /** Memory limit of the buffers in bytes, 0 when unlimited. */
+  size_t m_memoryLimit;
+
+  /** Size of the buffers in memory, only counted with a memory limit or half precision. */
+  size_t m_memoryInUse;
+
+  /** Store buffers as half floats while they aren't used by the current operation. */
+  bool m_halfPrecision;
+
+  /** Indices in #m_operations of the operations reading the output of an operation. */
+  std::map<NodeOperation *, std::vector<unsigned int>> m_readers;
+
+  /** Buffers which can be swapped out, with the indices of the operations reading them. */
+  std::map<MemoryBuffer *, std::vector<unsigned int>> m_swappable;
+
+  void addSwappable(MemoryBuffer *buffer, NodeOperation *operation);
+  void removeSwappable(MemoryBuffer *buffer);
+  void reportError(const char *message);
+  bool limitMemory(unsigned int index, NodeOperation *operation);
+  void packBuffers();
+
+  void addOperation(NodeOperation *operation, std::set<NodeOperation *> &visited);
+  MemoryBuffer *getOutputBuffer(NodeOperation *operation);
+  void getInputBuffers(NodeOperation *operation, std::vector<MemoryBuffer *> &r_inputs);
+  void getReadBuffers(NodeOperation *operation, std::vector<MemoryBuffer *> &r_buffers);
+  void releaseInputBuffers(NodeOperation *operation);
+  void calculateOperation(NodeOperation *operation);
+  void calculateWriteBuffer(NodeOperation *operation);
+  void calculateArea(NodeOperation *operation,
+                     MemoryBuffer *output,
+                     const rcti *area,
+                     MemoryBuffer **inputs);
+
+ public:
+  /**
+   * \brief prepare the execution of the outputs of \a groups
+   *
+   * Redirects socket readers to buffers, so it must happen before initExecution of the
+   * operations. The inputs of \a cached_write_buffers are not calculated.
+   */
+  FullFrameExecutionModel(const CompositorContext &context,
+                          const std::vector<ExecutionGroup *> &groups,
+                          const std::set<NodeOperation *> &cached_write_buffers);
+  ~FullFrameExecutionModel();
+
+  /**
+   * \brief calculate all operations, after they were initialized
+   * \return false when the buffers don't fit in the memory limit, because they can't be swapped
+   * out or read back, execution stops then and the error is shown in the stats of the node tree
+   */
+  bool execute();
+
+  /**
+   * \brief check if the operation was calculated by #execute
+   */
+  bool isCalculated(NodeOperation *operation) const
+  {
+    return m_calculated.count(operation) != 0;
+  }
+
+#ifdef WITH_CXX_GUARDEDALLOC
+  MEM_CXX_CLASS_ALLOC_FUNCS("COM:FullFrameExecutionModel")
+#endif
+};
+
+#endif /* __COM_FULLFRAMEEXECUTIONMODEL_H__ */
@@ -18,8 +18,19 @@
 
 #include "COM_MemoryBuffer.h"
 
+#include <stdio.h>
+
+#ifdef __SSE2__
+#  include <emmintrin.h>
+#endif
+
 #include "MEM_guardedalloc.h"
 
+extern "C" {
+#include "BLI_fileops.h"
+#include "BLI_string.h"
+}
+
 using std::max;
 using std::min;
 
@@ -38,7 +49,7 @@ static unsigned int determine_num_channels(DataType datatype)
 
 unsigned int MemoryBuffer::determineBufferSize()
 {
-  return getWidth() * getHeight();
+  return this->m_is_single_elem ? 1 : getWidth() * getHeight();
 }
 
 int MemoryBuffer::getWidth() const
@@ -58,10 +69,14 @@ MemoryBuffer::MemoryBuffer(MemoryProxy *memoryProxy, unsigned int chunkNumber, r
   this->m_memoryProxy = memoryProxy;
   this->m_chunkNumber = chunkNumber;
   this->m_num_channels = determine_num_channels(memoryProxy->getDataType());
+  this->m_is_single_elem = false;
   this->m_buffer = (float *)MEM_mallocN_aligned(
       sizeof(float) * determineBufferSize() * this->m_num_channels, 16, "COM_MemoryBuffer");
   this->m_state = COM_MB_ALLOCATED;
   this->m_datatype = memoryProxy->getDataType();
+  this->m_swapFilepath = NULL;
+  this->m_halfBuffer = NULL;
+  this->m_isHalf = false;
 }
 
 MemoryBuffer::MemoryBuffer(MemoryProxy *memoryProxy, rcti *rect)
@@ -72,10 +87,14 @@ MemoryBuffer::MemoryBuffer(MemoryProxy *memoryProxy, rcti *rect)
   this->m_memoryProxy = memoryProxy;
   this->m_chunkNumber = -1;
   this->m_num_channels = determine_num_channels(memoryProxy->getDataType());
+  this->m_is_single_elem = false;
   this->m_buffer = (float *)MEM_mallocN_aligned(
       sizeof(float) * determineBufferSize() * this->m_num_channels, 16, "COM_MemoryBuffer");
   this->m_state = COM_MB_TEMPORARILY;
   this->m_datatype = memoryProxy->getDataType();
+  this->m_swapFilepath = NULL;
+  this->m_halfBuffer = NULL;
+  this->m_isHalf = false;
 }
 MemoryBuffer::MemoryBuffer(DataType dataType, rcti *rect)
 {
@@ -86,10 +105,31 @@ MemoryBuffer::MemoryBuffer(DataType dataType, rcti *rect)
   this->m_memoryProxy = NULL;
   this->m_chunkNumber = -1;
   this->m_num_channels = determine_num_channels(dataType);
+  this->m_is_single_elem = false;
+  this->m_buffer = (float *)MEM_mallocN_aligned(
+      sizeof(float) * determineBufferSize() * this->m_num_channels, 16, "COM_MemoryBuffer");
+  this->m_state = COM_MB_TEMPORARILY;
+  this->m_datatype = dataType;
+  this->m_swapFilepath = NULL;
+  this->m_halfBuffer = NULL;
+  this->m_isHalf = false;
+}
+MemoryBuffer::MemoryBuffer(DataType dataType, rcti *rect, bool is_single_elem)
+{
+  BLI_rcti_init(&this->m_rect, rect->xmin, rect->xmax, rect->ymin, rect->ymax);
+  this->m_width = BLI_rcti_size_x(&this->m_rect);
+  this->m_height = BLI_rcti_size_y(&this->m_rect);
+  this->m_memoryProxy = NULL;
+  this->m_chunkNumber = -1;
+  this->m_num_channels = determine_num_channels(dataType);
+  this->m_is_single_elem = is_single_elem;
   this->m_buffer = (float *)MEM_mallocN_aligned(
       sizeof(float) * determineBufferSize() * this->m_num_channels, 16, "COM_MemoryBuffer");
   this->m_state = COM_MB_TEMPORARILY;
   this->m_datatype = dataType;
+  this->m_swapFilepath = NULL;
+  this->m_halfBuffer = NULL;
+  this->m_isHalf = false;
 }
 MemoryBuffer *MemoryBuffer::duplicate()
 {
@@ -143,11 +183,202 @@ float MemoryBuffer::getMaximumValue(rcti *rect)
 }
 
 MemoryBuffer::~MemoryBuffer()
+{
+  freeData();
+  if (this->m_swapFilepath) {
+    BLI_delete(this->m_swapFilepath, false, false);
+    MEM_freeN(this->m_swapFilepath);
+    this->m_swapFilepath = NULL;
+  }
+}
+
+bool MemoryBuffer::swapOut(const char *filepath)
+{
+  void *data = this->m_isHalf ? (void *)this->m_halfBuffer : (void *)this->m_buffer;
+  BLI_assert(data && !this->m_swapFilepath);
+
+  FILE *file = BLI_fopen(filepath, "wb");
+  if (file == NULL) {
+    return false;
+  }
+  const size_t size = getMemorySize();
+  const bool ok = fwrite(data, 1, size, file) == size;
+  fclose(file);
+  if (!ok) {
+    BLI_delete(filepath, false, false);
+    return false;
+  }
+
+  /* Keep #m_isHalf, #swapIn reads the data back in the same representation. */
+  MEM_freeN(data);
+  this->m_buffer = NULL;
+  this->m_halfBuffer = NULL;
+  this->m_swapFilepath = BLI_strdup(filepath);
+  return true;
+}
+
+bool MemoryBuffer::swapIn()
+{
+  BLI_assert(!this->m_buffer && !this->m_halfBuffer && this->m_swapFilepath);
+
+  const size_t size = getMemorySize();
+  void *data = MEM_mallocN_aligned(size, 16, "COM_MemoryBuffer");
+  FILE *file = BLI_fopen(this->m_swapFilepath, "rb");
+  bool ok = false;
+  if (file) {
+    ok = fread(data, 1, size, file) == size;
+    fclose(file);
+  }
+  if (ok) {
+    if (this->m_isHalf) {
+      this->m_halfBuffer = (unsigned short *)data;
+    }
+    else {
+      this->m_buffer = (float *)data;
+    }
+  }
+  else {
+    MEM_freeN(data);
+    this->m_isHalf = false;
+  }
+
+  BLI_delete(this->m_swapFilepath, false, false);
+  MEM_freeN(this->m_swapFilepath);
+  this->m_swapFilepath = NULL;
+  return ok;
+}
+
+void MemoryBuffer::freeData()
 {
   if (this->m_buffer) {
     MEM_freeN(this->m_buffer);
     this->m_buffer = NULL;
   }
+  if (this->m_halfBuffer) {
+    MEM_freeN(this->m_halfBuffer);
+    this->m_halfBuffer = NULL;
+  }
+  this->m_isHalf = false;
+}
+
+/* Half floats without denormals, infinity and NaN: values are clamped to the largest half float
+ * and small values are flushed to zero, which is fine for pixels. */
+
+#define HALF_MAX_BITS 0x7bff
+/** Float bits of the smallest normalized half float. */
+#define HALF_MIN_FLOAT_BITS 0x38800000
+/** Float bits from which values round to a half float larger than #HALF_MAX_BITS. */
+#define HALF_OVERFLOW_FLOAT_BITS 0x477ff000
+
+static inline unsigned short float_to_half(float f)
+{
+  union {
+    float f;
+    unsigned int i;
+  } u;
+  u.f = f;
+  const unsigned int sign = (u.i >> 16) & 0x8000;
+  const unsigned int absolute = u.i & 0x7fffffff;
+  unsigned int bits;
+  if (absolute < HALF_MIN_FLOAT_BITS) {
+    bits = 0;
+  }
+  else if (absolute >= HALF_OVERFLOW_FLOAT_BITS) {
+    bits = HALF_MAX_BITS;
+  }
+  else {
+    /* Round to nearest and rebias the exponent. */
+    bits = ((absolute + 0x1000) >> 13) - 0x1c000;
+  }
+  return (unsigned short)(sign | bits);
+}
+
+static inline float half_to_float(unsigned short h)
+{
+  union {
+    float f;
+    unsigned int i;
+  } u;
+  const unsigned int absolute = h & 0x7fff;
+  u.i = ((h & 0x8000) << 16) | (absolute ? (absolute << 13) + 0x38000000 : 0);
+  return u.f;
+}
+
+static void float_to_half_array(const float *src, unsigned short *dst, size_t num)
+{
+  size_t i = 0;
+#ifdef __SSE2__
+  const __m128i sign_mask = _mm_set1_epi32(0x8000);
+  const __m128i absolute_mask = _mm_set1_epi32(0x7fffffff);
+  const __m128i min_bits = _mm_set1_epi32(HALF_MIN_FLOAT_BITS);
+  const __m128i overflow_bits = _mm_set1_epi32(HALF_OVERFLOW_FLOAT_BITS - 1);
+  const __m128i max_bits = _mm_set1_epi32(HALF_MAX_BITS);
+  const __m128i round = _mm_set1_epi32(0x1000);
+  const __m128i rebias = _mm_set1_epi32(0x1c000);
+  for (; i + 4 <= num; i += 4) {
+    const __m128i u = _mm_castps_si128(_mm_loadu_ps(src + i));
+    const __m128i sign = _mm_and_si128(_mm_srli_epi32(u, 16), sign_mask);
+    const __m128i absolute = _mm_and_si128(u, absolute_mask);
+    __m128i bits = _mm_sub_epi32(_mm_srli_epi32(_mm_add_epi32(absolute, round), 13), rebias);
+    bits = _mm_andnot_si128(_mm_cmplt_epi32(absolute, min_bits), bits);
+    const __m128i overflow = _mm_cmpgt_epi32(absolute, overflow_bits);
+    bits = _mm_or_si128(_mm_andnot_si128(overflow, bits), _mm_and_si128(overflow, max_bits));
+    bits = _mm_or_si128(bits, sign);
+    /* Sign extend the 16 bits so the saturating pack keeps them unchanged. */
+    bits = _mm_srai_epi32(_mm_slli_epi32(bits, 16), 16);
+    _mm_storel_epi64((__m128i *)(dst + i), _mm_packs_epi32(bits, bits));
+  }
+#endif
+  for (; i < num; i++) {
+    dst[i] = float_to_half(src[i]);
+  }
+}
+
+static void half_to_float_array(const unsigned short *src, float *dst, size_t num)
+{
+  size_t i = 0;
+#ifdef __SSE2__
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i sign_mask = _mm_set1_epi32(0x8000);
+  const __m128i absolute_mask = _mm_set1_epi32(0x7fff);
+  const __m128i rebias = _mm_set1_epi32(0x38000000);
+  for (; i + 4 <= num; i += 4) {
+    const __m128i h = _mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i *)(src + i)), zero);
+    const __m128i sign = _mm_slli_epi32(_mm_and_si128(h, sign_mask), 16);
+    const __m128i absolute = _mm_and_si128(h, absolute_mask);
+    __m128i bits = _mm_add_epi32(_mm_slli_epi32(absolute, 13), rebias);
+    bits = _mm_andnot_si128(_mm_cmpeq_epi32(absolute, zero), bits);
+    _mm_storeu_ps(dst + i, _mm_castsi128_ps(_mm_or_si128(bits, sign)));
+  }
+#endif
+  for (; i < num; i++) {
+    dst[i] = half_to_float(src[i]);
+  }
+}
+
+void MemoryBuffer::packHalf()
+{
+  BLI_assert(this->m_buffer && !this->m_isHalf);
+
+  const size_t num = getNumElements();
+  this->m_halfBuffer = (unsigned short *)MEM_mallocN_aligned(
+      sizeof(unsigned short) * num, 16, "COM_MemoryBuffer half");
+  float_to_half_array(this->m_buffer, this->m_halfBuffer, num);
+  MEM_freeN(this->m_buffer);
+  this->m_buffer = NULL;
+  this->m_isHalf = true;
+}
+
+void MemoryBuffer::unpackHalf()
+{
+  BLI_assert(this->m_halfBuffer && this->m_isHalf);
+
+  const size_t num = getNumElements();
+  this->m_buffer = (float *)MEM_mallocN_aligned(sizeof(float) * num, 16, "COM_MemoryBuffer");
+  half_to_float_array(this->m_halfBuffer, this->m_buffer, num);
+  MEM_freeN(this->m_halfBuffer);
+  this->m_halfBuffer = NULL;
+  this->m_isHalf = false;
 }
 
 void MemoryBuffer::copyContentFrom(MemoryBuffer *otherBuffer)
@@ -97,6 +97,26 @@ class MemoryBuffer {
   int m_width;
   int m_height;
 
+  /**
+   * \brief the buffer stores a single element, which is the value of every pixel of its rect
+   */
+  bool m_is_single_elem;
+
+  /**
+   * \brief file the data is written to while it is swapped out, NULL otherwise
+   */
+  char *m_swapFilepath;
+
+  /**
+   * \brief the data stored as half floats, see #packHalf
+   */
+  unsigned short *m_halfBuffer;
+
+  /**
+   * \brief the data is stored in #m_halfBuffer instead of #m_buffer
+   */
+  bool m_isHalf;
+
  public:
   /**
    * \brief construct new MemoryBuffer for a chunk
@@ -113,6 +133,12 @@ class MemoryBuffer {
    */
   MemoryBuffer(DataType datatype, rcti *rect);
 
+  /**
+   * \brief construct new temporarily MemoryBuffer for an area
+   * \param is_single_elem: only store a single element, used for the whole area
+   */
+  MemoryBuffer(DataType datatype, rcti *rect, bool is_single_elem);
+
   /**
    * \brief destructor
    */
@@ -131,6 +157,38 @@ class MemoryBuffer {
     return this->m_num_channels;
   }
 
+  DataType get_data_type() const
+  {
+    return this->m_datatype;
+  }
+
+  bool is_single_elem() const
+  {
+    return this->m_is_single_elem;
+  }
+
+  /**
+   * \brief number of floats between two horizontally adjacent elements,
+   * zero for single element buffers so the same element is read for the whole row
+   */
+  int elem_stride() const
+  {
+    return this->m_is_single_elem ? 0 : this->m_num_channels;
+  }
+
+  /**
+   * \brief get the element at \a x, \a y, which must be inside the rect of the buffer
+   */
+  inline float *get_elem(int x, int y)
+  {
+    BLI_assert(x >= m_rect.xmin && x < m_rect.xmax && y >= m_rect.ymin && y < m_rect.ymax);
+    if (this->m_is_single_elem) {
+      return this->m_buffer;
+    }
+    return &this->m_buffer[((y - m_rect.ymin) * this->m_width + (x - m_rect.xmin)) *
+                           this->m_num_channels];
+  }
+
   /**
    * \brief get the data of this MemoryBuffer
    * \note buffer should already be available in memory
@@ -140,6 +198,63 @@ class MemoryBuffer {
     return this->m_buffer;
   }
 
+  /**
+   * \brief size of the data in bytes, as it is currently stored (float or half)
+   */
+  size_t getMemorySize() const
+  {
+    return (this->m_isHalf ? sizeof(unsigned short) : sizeof(float)) * getNumElements();
+  }
+
+  /**
+   * \brief number of floats in the data
+   */
+  size_t getNumElements() const
+  {
+    return this->m_num_channels *
+           (this->m_is_single_elem ? 1 : (size_t)this->m_width * this->m_height);
+  }
+
+  /**
+   * \brief write the data to \a filepath and free it, #getBuffer returns NULL until #swapIn
+   * \return false when the file can't be written, the data stays in memory then
+   */
+  bool swapOut(const char *filepath);
+
+  /**
+   * \brief read the data back from the file written by #swapOut, and remove the file
+   * \return false when the file can't be read, the buffer has no data then
+   */
+  bool swapIn();
+
+  bool isSwappedOut() const
+  {
+    return this->m_swapFilepath != NULL;
+  }
+
+  /**
+   * \brief free the data when it isn't needed anymore, #getBuffer returns NULL afterwards
+   */
+  void freeData();
+
+  /**
+   * \brief convert the data to half floats, halving its memory
+   *
+   * #getBuffer returns NULL until #unpackHalf. Values are clamped to the half float range
+   * (65504) and values smaller than 6.1e-5 are flushed to zero.
+   */
+  void packHalf();
+
+  /**
+   * \brief convert the data stored by #packHalf back to floats
+   */
+  void unpackHalf();
+
+  bool isHalf() const
+  {
+    return this->m_isHalf;
+  }
+
   /**
    * \brief after execution the state will be set to available by calling this method
    */
@@ -36,7 +36,10 @@ NodeOperation::NodeOperation()
   this->m_height = 0;
   this->m_isResolutionSet = false;
   this->m_openCL = false;
+  this->m_point = false;
+  this->m_fullFrame = false;
   this->m_btree = NULL;
+  this->m_bnode = NULL;
 }
 
 NodeOperation::~NodeOperation()
@@ -134,6 +137,60 @@ void NodeOperation::deinitExecution()
 {
   /* pass */
 }
+
+void NodeOperation::update_memory_buffer(MemoryBuffer *output,
+                                         const rcti *area,
+                                         MemoryBuffer ** /*inputs*/)
+{
+  const int num_channels = output->get_num_channels();
+  rcti rect = *area;
+  float color[4];
+
+  if (isComplex()) {
+    void *data = initializeTileData(&rect);
+    for (int y = area->ymin; y < area->ymax; y++) {
+      float *out = output->get_elem(area->xmin, y);
+      for (int x = area->xmin; x < area->xmax; x++) {
+        read(color, x, y, data);
+        memcpy(out, color, sizeof(float) * num_channels);
+        out += num_channels;
+      }
+    }
+    if (data) {
+      deinitializeTileData(&rect, data);
+    }
+  }
+  else {
+    for (int y = area->ymin; y < area->ymax; y++) {
+      float *out = output->get_elem(area->xmin, y);
+      for (int x = area->xmin; x < area->xmax; x++) {
+        readSampled(color, x, y, COM_PS_NEAREST);
+        memcpy(out, color, sizeof(float) * num_channels);
+        out += num_channels;
+      }
+    }
+  }
+}
+
+bool NodeOperation::inputBuffersContainArea(MemoryBuffer **inputs, const rcti *area) const
+{
+  for (unsigned int index = 0; index < m_inputs.size(); index++) {
+    MemoryBuffer *buffer = inputs[index];
+    if (buffer == NULL) {
+      if (m_inputs[index]->isConnected()) {
+        return false;
+      }
+      continue;
+    }
+    if (buffer->get_data_type() != m_inputs[index]->getDataType()) {
+      return false;
+    }
+    if (!buffer->is_single_elem() && !BLI_rcti_inside_rcti(buffer->getRect(), area)) {
+      return false;
+    }
+  }
+  return true;
+}
 SocketReader *NodeOperation::getInputSocketReader(unsigned int inputSocketIndex)
 {
   return this->getInputSocket(inputSocketIndex)->getReader();
@@ -208,7 +265,7 @@ NodeOperationInput::NodeOperationInput(NodeOperation *op,
 SocketReader *NodeOperationInput::getReader()
 {
   if (isConnected()) {
-    return &m_link->getOperation();
+    return m_link->getReader();
   }
   else {
     return NULL;
@@ -228,7 +285,7 @@ void NodeOperationInput::determineResolution(unsigned int resolution[2],
  ******************/
 
 NodeOperationOutput::NodeOperationOutput(NodeOperation *op, DataType datatype)
-    : m_operation(op), m_datatype(datatype)
+    : m_operation(op), m_datatype(datatype), m_bufferReader(NULL)
 {
 }
 
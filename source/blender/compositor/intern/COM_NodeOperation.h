@@ -105,6 +105,23 @@ class NodeOperation : public SocketReader {
    */
   bool m_openCL;
 
+  /**
+   * \brief is this a point operation.
+   *
+   * The output of a point operation at a pixel only depends on its inputs at the same pixel,
+   * not on the position or the resolution. When all inputs are constant the output is constant
+   * too, see NodeOperationBuilder.fold_constant_operations.
+   */
+  bool m_point;
+
+  /**
+   * \brief does this operation implement update_memory_buffer.
+   *
+   * It reads the buffers of its inputs directly in full frame execution, instead of reading them
+   * pixel by pixel, see FullFrameExecutionModel.
+   */
+  bool m_fullFrame;
+
   /**
    * \brief mutex reference for very special node initializations
    * \note only use when you really know what you are doing.
@@ -121,6 +138,13 @@ class NodeOperation : public SocketReader {
    */
   const bNodeTree *m_btree;
 
+  /**
+   * \brief the node this operation was converted from, NULL for operations added by the
+   * NodeOperationBuilder itself (conversions, buffers, constants)
+   * \see BufferCache
+   */
+  const bNode *m_bnode;
+
   /**
    * \brief set to truth when resolution for this operation is set
    */
@@ -190,6 +214,14 @@ class NodeOperation : public SocketReader {
   {
     this->m_btree = tree;
   }
+  void setbNode(const bNode *node)
+  {
+    this->m_bnode = node;
+  }
+  const bNode *getbNode() const
+  {
+    return this->m_bnode;
+  }
   virtual void initExecution();
 
   /**
@@ -248,6 +280,21 @@ class NodeOperation : public SocketReader {
   }
   virtual void deinitExecution();
 
+  /**
+   * \brief calculate the \a area of \a output in full frame execution
+   * \ingroup execution
+   * \see FullFrameExecutionModel
+   *
+   * Operations implementing this read whole rows from the input buffers, instead of reading
+   * pixels one at a time through their socket readers. The default implementation evaluates
+   * executePixel for every pixel, with the socket readers reading from the input buffers.
+   *
+   * \param output: buffer of the output socket
+   * \param area: the area of \a output to calculate
+   * \param inputs: buffers of the input sockets, NULL for unconnected sockets
+   */
+  virtual void update_memory_buffer(MemoryBuffer *output, const rcti *area, MemoryBuffer **inputs);
+
   bool isResolutionSet()
   {
     return this->m_isResolutionSet;
@@ -284,6 +331,24 @@ class NodeOperation : public SocketReader {
     return false;
   }
 
+  /**
+   * \brief is this a point operation
+   * \see NodeOperation.m_point
+   */
+  bool isPointOperation() const
+  {
+    return this->m_point;
+  }
+
+  /**
+   * \brief does this operation implement update_memory_buffer
+   * \see NodeOperation.m_fullFrame
+   */
+  bool isFullFrameOperation() const
+  {
+    return this->m_fullFrame;
+  }
+
   /**
    * \brief is this operation of type ReadBufferOperation
    * \return [true:false]
@@ -404,6 +469,15 @@ class NodeOperation : public SocketReader {
   void lockMutex();
   void unlockMutex();
 
+  /**
+   * \brief can \a inputs be read directly for all pixels of \a area
+   *
+   * True when every connected input buffer has the data type of its socket and is a single
+   * element or contains \a area, otherwise update_memory_buffer implementations should fall back
+   * to NodeOperation::update_memory_buffer.
+   */
+  bool inputBuffersContainArea(MemoryBuffer **inputs, const rcti *area) const;
+
   /**
    * \brief set whether this operation is complex
    *
@@ -423,8 +497,28 @@ class NodeOperation : public SocketReader {
     this->m_openCL = openCL;
   }
 
+  /**
+   * \brief set whether this operation is a point operation
+   * \see NodeOperation.m_point
+   */
+  void setPointOperation(bool point)
+  {
+    this->m_point = point;
+  }
+
+  /**
+   * \brief set whether this operation implements update_memory_buffer
+   * \see NodeOperation.m_fullFrame
+   */
+  void setFullFrameOperation(bool full_frame)
+  {
+    this->m_fullFrame = full_frame;
+  }
+
   /* allow the DebugInfo class to look at internals */
   friend class DebugInfo;
+  /* allow the FullFrameExecutionModel to walk the inputs */
+  friend class FullFrameExecutionModel;
 
 #ifdef WITH_CXX_GUARDEDALLOC
   MEM_CXX_CLASS_ALLOC_FUNCS("COM:NodeOperation")
@@ -500,6 +594,9 @@ class NodeOperationOutput {
    */
   DataType m_datatype;
 
+  /** Reader of the buffer the output was calculated into, in full frame execution. */
+  SocketReader *m_bufferReader;
+
  public:
   NodeOperationOutput(NodeOperation *op, DataType datatype);
 
@@ -512,6 +609,22 @@ class NodeOperationOutput {
     return m_datatype;
   }
 
+  /**
+   * \brief let linked inputs read from \a reader instead of the operation
+   * \note must be set before initExecution of the linked operations, which get their readers.
+   */
+  void setBufferReader(SocketReader *reader)
+  {
+    m_bufferReader = reader;
+  }
+  SocketReader *getReader()
+  {
+    if (m_bufferReader) {
+      return m_bufferReader;
+    }
+    return m_operation;
+  }
+
   /**
    * \brief determine the resolution of this data going through this socket
    * \param resolution: the result of this operation
@@ -106,6 +106,8 @@ void NodeOperationBuilder::convertToOperations(ExecutionSystem *system)
 
   determineResolutions();
 
+  fold_constant_operations();
+
   /* surround complex ops with read/write buffer */
   add_complex_operation_buffers();
 
@@ -127,6 +129,9 @@ void NodeOperationBuilder::convertToOperations(ExecutionSystem *system)
 
 void NodeOperationBuilder::addOperation(NodeOperation *operation)
 {
+  if (m_current_node) {
+    operation->setbNode(m_current_node->getbNode());
+  }
   m_operations.push_back(operation);
 }
 
@@ -407,6 +412,83 @@ void NodeOperationBuilder::resolve_proxies()
   }
 }
 
+static bool is_constant_foldable(NodeOperation *operation)
+{
+  if (!operation->isPointOperation() || operation->getNumberOfInputSockets() == 0 ||
+      operation->getNumberOfOutputSockets() != 1) {
+    return false;
+  }
+  for (int k = 0; k < operation->getNumberOfInputSockets(); ++k) {
+    NodeOperationInput *input = operation->getInputSocket(k);
+    if (!input->isConnected() || !input->getLink()->getOperation().isSetOperation()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+NodeOperation *NodeOperationBuilder::make_constant_operation(NodeOperation *operation)
+{
+  float color[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+  operation->initExecution();
+  operation->readSampled(color, 0.0f, 0.0f, COM_PS_NEAREST);
+  operation->deinitExecution();
+
+  switch (operation->getOutputSocket()->getDataType()) {
+    case COM_DT_VALUE: {
+      SetValueOperation *constant = new SetValueOperation();
+      constant->setValue(color[0]);
+      return constant;
+    }
+    case COM_DT_VECTOR: {
+      SetVectorOperation *constant = new SetVectorOperation();
+      constant->setVector(color);
+      return constant;
+    }
+    case COM_DT_COLOR:
+    default: {
+      SetColorOperation *constant = new SetColorOperation();
+      constant->setChannels(color);
+      return constant;
+    }
+  }
+}
+
+void NodeOperationBuilder::fold_constant_operations()
+{
+  /* Folding an operation can make the operations reading it foldable too,
+   * repeat until nothing changes. The replaced operations are pruned later.
+   * Resolutions are determined first, operations are read with the resolution they are
+   * executed with, which the constants keep.
+   */
+  bool folded;
+  do {
+    folded = false;
+    Operations operations = m_operations;
+    for (Operations::const_iterator it = operations.begin(); it != operations.end(); ++it) {
+      NodeOperation *op = *it;
+      if (!is_constant_foldable(op)) {
+        continue;
+      }
+      OpInputs readers = cache_output_links(op->getOutputSocket());
+      if (readers.empty()) {
+        continue;
+      }
+
+      NodeOperation *constant = make_constant_operation(op);
+      unsigned int resolution[2] = {op->getWidth(), op->getHeight()};
+      constant->setResolution(resolution);
+      addOperation(constant);
+      for (OpInputs::const_iterator it_reader = readers.begin(); it_reader != readers.end();
+           ++it_reader) {
+        removeInputLink(*it_reader);
+        addLink(constant->getOutputSocket(), *it_reader);
+      }
+      folded = true;
+    }
+  } while (folded);
+}
+
 void NodeOperationBuilder::determineResolutions()
 {
   /* determine all resolutions of the operations (Width/Height) */
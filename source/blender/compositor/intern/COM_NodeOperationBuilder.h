@@ -147,6 +147,10 @@ class NodeOperationBuilder {
   /** Replace proxy operations with direct links */
   void resolve_proxies();
 
+  /** Replace point operations reading only constants by a constant operation */
+  void fold_constant_operations();
+  NodeOperation *make_constant_operation(NodeOperation *operation);
+
   /** Calculate resolution for each operation */
   void determineResolutions();
 
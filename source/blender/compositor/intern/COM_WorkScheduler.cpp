@@ -77,6 +77,11 @@ void *WorkScheduler::thread_execute_cpu(void *data)
   CPUDevice *device = (CPUDevice *)data;
   WorkPackage *work;
   BLI_thread_local_set(g_thread_device, device);
+  /* Spread devices over NUMA nodes. Write buffers are allocated without being
+   * touched, so the pages of each tile get placed on the node of the device
+   * thread which calculates it. */
+  BLI_thread_put_thread_on_numa_node(
+      BLI_thread_numa_node_for_thread(device->thread_id(), (int)g_cpudevices.size()));
   while ((work = (WorkPackage *)BLI_thread_queue_pop(g_cpuqueue))) {
     device->execute(work);
     delete work;
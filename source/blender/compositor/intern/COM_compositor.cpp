@@ -26,6 +26,7 @@ extern "C" {
 #include "BKE_scene.h"
 
 #include "COM_compositor.h"
+#include "COM_BufferCache.h"
 #include "COM_ExecutionSystem.h"
 #include "COM_WorkScheduler.h"
 #include "clew.h"
@@ -115,6 +116,7 @@ void COM_deinitialize()
   if (is_compositorMutex_init) {
     BLI_mutex_lock(&s_compositorMutex);
     WorkScheduler::deinitialize();
+    BufferCache::clear();
     is_compositorMutex_init = false;
     BLI_mutex_unlock(&s_compositorMutex);
     BLI_mutex_end(&s_compositorMutex);
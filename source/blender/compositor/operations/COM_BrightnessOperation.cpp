@@ -26,6 +26,7 @@ BrightnessOperation::BrightnessOperation() : NodeOperation()
   this->addOutputSocket(COM_DT_COLOR);
   this->m_inputProgram = NULL;
   this->m_use_premultiply = false;
+  this->setFullFrameOperation(true);
 }
 
 void BrightnessOperation::setUsePremultiply(bool use_premultiply)
@@ -40,20 +41,14 @@ void BrightnessOperation::initExecution()
   this->m_inputContrastProgram = this->getInputSocketReader(2);
 }
 
-void BrightnessOperation::executePixelSampled(float output[4],
-                                              float x,
-                                              float y,
-                                              PixelSampler sampler)
+inline void BrightnessOperation::applyBrightness(float output[4],
+                                                 const float input[4],
+                                                 float brightness,
+                                                 const float contrast)
 {
   float inputValue[4];
   float a, b;
-  float inputBrightness[4];
-  float inputContrast[4];
-  this->m_inputProgram->readSampled(inputValue, x, y, sampler);
-  this->m_inputBrightnessProgram->readSampled(inputBrightness, x, y, sampler);
-  this->m_inputContrastProgram->readSampled(inputContrast, x, y, sampler);
-  float brightness = inputBrightness[0];
-  float contrast = inputContrast[0];
+  copy_v4_v4(inputValue, input);
   brightness /= 100.0f;
   float delta = contrast / 200.0f;
   /*
@@ -83,6 +78,47 @@ void BrightnessOperation::executePixelSampled(float output[4],
   }
 }
 
+void BrightnessOperation::executePixelSampled(float output[4],
+                                              float x,
+                                              float y,
+                                              PixelSampler sampler)
+{
+  float inputValue[4];
+  float inputBrightness[4];
+  float inputContrast[4];
+  this->m_inputProgram->readSampled(inputValue, x, y, sampler);
+  this->m_inputBrightnessProgram->readSampled(inputBrightness, x, y, sampler);
+  this->m_inputContrastProgram->readSampled(inputContrast, x, y, sampler);
+  applyBrightness(output, inputValue, inputBrightness[0], inputContrast[0]);
+}
+
+void BrightnessOperation::update_memory_buffer(MemoryBuffer *output,
+                                               const rcti *area,
+                                               MemoryBuffer **inputs)
+{
+  if (!inputBuffersContainArea(inputs, area)) {
+    NodeOperation::update_memory_buffer(output, area, inputs);
+    return;
+  }
+
+  const int color_stride = inputs[0]->elem_stride();
+  const int brightness_stride = inputs[1]->elem_stride();
+  const int contrast_stride = inputs[2]->elem_stride();
+  for (int y = area->ymin; y < area->ymax; y++) {
+    float *out = output->get_elem(area->xmin, y);
+    const float *color = inputs[0]->get_elem(area->xmin, y);
+    const float *brightness = inputs[1]->get_elem(area->xmin, y);
+    const float *contrast = inputs[2]->get_elem(area->xmin, y);
+    for (int x = area->xmin; x < area->xmax; x++) {
+      applyBrightness(out, color, brightness[0], contrast[0]);
+      out += COM_NUM_CHANNELS_COLOR;
+      color += color_stride;
+      brightness += brightness_stride;
+      contrast += contrast_stride;
+    }
+  }
+}
+
 void BrightnessOperation::deinitExecution()
 {
   this->m_inputProgram = NULL;
@@ -31,6 +31,11 @@ class BrightnessOperation : public NodeOperation {
 
   bool m_use_premultiply;
 
+  void applyBrightness(float output[4],
+                       const float input[4],
+                       float brightness,
+                       const float contrast);
+
  public:
   BrightnessOperation();
 
@@ -49,6 +54,8 @@ class BrightnessOperation : public NodeOperation {
    */
   void deinitExecution();
 
+  void update_memory_buffer(MemoryBuffer *output, const rcti *area, MemoryBuffer **inputs);
+
   void setUsePremultiply(bool use_premultiply);
 };
 #endif
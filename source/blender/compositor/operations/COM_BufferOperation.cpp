@@ -0,0 +1,62 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * Copyright 2020, Blender Foundation.
+ */
+
+#include "COM_BufferOperation.h"
+
+BufferOperation::BufferOperation(DataType datatype, unsigned int width, unsigned int height)
+    : NodeOperation()
+{
+  this->addOutputSocket(datatype);
+  this->setWidth(width);
+  this->setHeight(height);
+  this->m_buffer = NULL;
+}
+
+void *BufferOperation::initializeTileData(rcti * /*rect*/)
+{
+  return m_buffer;
+}
+
+void BufferOperation::executePixelSampled(float output[4],
+                                          float x,
+                                          float y,
+                                          PixelSampler sampler)
+{
+  if (m_buffer->is_single_elem()) {
+    memcpy(output, m_buffer->getBuffer(), sizeof(float) * m_buffer->get_num_channels());
+  }
+  else if (sampler == COM_PS_NEAREST) {
+    m_buffer->read(output, x, y);
+  }
+  else {
+    m_buffer->readBilinear(output, x, y);
+  }
+}
+
+void BufferOperation::executePixelFiltered(
+    float output[4], float x, float y, float dx[2], float dy[2])
+{
+  if (m_buffer->is_single_elem()) {
+    memcpy(output, m_buffer->getBuffer(), sizeof(float) * m_buffer->get_num_channels());
+  }
+  else {
+    const float uv[2] = {x, y};
+    const float deriv[2][2] = {{dx[0], dx[1]}, {dy[0], dy[1]}};
+    m_buffer->readEWA(output, uv, deriv);
+  }
+}
@@ -0,0 +1,52 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * Copyright 2020, Blender Foundation.
+ */
+
+#ifndef __COM_BUFFEROPERATION_H__
+#define __COM_BUFFEROPERATION_H__
+
+#include "COM_NodeOperation.h"
+
+/**
+ * \brief reads the result of an operation that was calculated into a MemoryBuffer
+ *
+ * Used as socket reader of outputs in full frame execution, so operations that read their
+ * inputs pixel by pixel read from buffers instead of evaluating the input operations again.
+ * \see FullFrameExecutionModel
+ */
+class BufferOperation : public NodeOperation {
+ private:
+  MemoryBuffer *m_buffer;
+
+ public:
+  BufferOperation(DataType datatype, unsigned int width, unsigned int height);
+
+  void setBuffer(MemoryBuffer *buffer)
+  {
+    this->m_buffer = buffer;
+  }
+  MemoryBuffer *getBuffer() const
+  {
+    return this->m_buffer;
+  }
+
+  void *initializeTileData(rcti *rect);
+  void executePixelSampled(float output[4], float x, float y, PixelSampler sampler);
+  void executePixelFiltered(float output[4], float x, float y, float dx[2], float dy[2]);
+};
+
+#endif
@@ -33,6 +33,7 @@ ColorRampOperation::ColorRampOperation() : NodeOperation()
 
   this->m_inputProgram = NULL;
   this->m_colorBand = NULL;
+  this->setPointOperation(true);
 }
 void ColorRampOperation::initExecution()
 {
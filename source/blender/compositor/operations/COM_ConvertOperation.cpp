@@ -25,6 +25,7 @@ extern "C" {
 ConvertBaseOperation::ConvertBaseOperation()
 {
   this->m_inputOperation = NULL;
+  this->setPointOperation(true);
 }
 
 void ConvertBaseOperation::initExecution()
@@ -404,6 +405,7 @@ SeparateChannelOperation::SeparateChannelOperation() : NodeOperation()
   this->addInputSocket(COM_DT_COLOR);
   this->addOutputSocket(COM_DT_VALUE);
   this->m_inputOperation = NULL;
+  this->setPointOperation(true);
 }
 void SeparateChannelOperation::initExecution()
 {
@@ -439,6 +441,7 @@ CombineChannelsOperation::CombineChannelsOperation() : NodeOperation()
   this->m_inputChannel2Operation = NULL;
   this->m_inputChannel3Operation = NULL;
   this->m_inputChannel4Operation = NULL;
+  this->setPointOperation(true);
 }
 
 void CombineChannelsOperation::initExecution()
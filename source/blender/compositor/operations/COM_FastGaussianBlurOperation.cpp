@@ -22,6 +22,10 @@
 #include "MEM_guardedalloc.h"
 #include "BLI_utildefines.h"
 
+#ifdef __SSE2__
+#  include <emmintrin.h>
+#endif
+
 FastGaussianBlurOperation::FastGaussianBlurOperation() : BlurBaseOperation(COM_DT_COLOR)
 {
   this->m_iirgaus = NULL;
@@ -84,25 +88,18 @@ void *FastGaussianBlurOperation::initializeTileData(rcti *rect)
     MemoryBuffer *copy = newBuf->duplicate();
     updateSize();
 
-    int c;
     this->m_sx = this->m_data.sizex * this->m_size / 2.0f;
     this->m_sy = this->m_data.sizey * this->m_size / 2.0f;
 
     if ((this->m_sx == this->m_sy) && (this->m_sx > 0.0f)) {
-      for (c = 0; c < COM_NUM_CHANNELS_COLOR; c++) {
-        IIR_gauss(copy, this->m_sx, c, 3);
-      }
+      IIR_gauss_color(copy, this->m_sx, 3);
     }
     else {
       if (this->m_sx > 0.0f) {
-        for (c = 0; c < COM_NUM_CHANNELS_COLOR; c++) {
-          IIR_gauss(copy, this->m_sx, c, 1);
-        }
+        IIR_gauss_color(copy, this->m_sx, 1);
       }
       if (this->m_sy > 0.0f) {
-        for (c = 0; c < COM_NUM_CHANNELS_COLOR; c++) {
-          IIR_gauss(copy, this->m_sy, c, 2);
-        }
+        IIR_gauss_color(copy, this->m_sy, 2);
       }
     }
     this->m_iirgaus = copy;
@@ -111,39 +108,113 @@ void *FastGaussianBlurOperation::initializeTileData(rcti *rect)
   return this->m_iirgaus;
 }
 
-void FastGaussianBlurOperation::IIR_gauss(MemoryBuffer *src,
-                                          float sigma,
-                                          unsigned int chan,
-                                          unsigned int xy)
+/* Four doubles, one per color channel, so the recursive filter runs on all channels at once. */
+struct IIRColor {
+#ifdef __SSE2__
+  __m128d rg, ba;
+
+  IIRColor()
+  {
+  }
+  IIRColor(const __m128d a, const __m128d b) : rg(a), ba(b)
+  {
+  }
+  explicit IIRColor(const float *color)
+  {
+    const __m128 c = _mm_loadu_ps(color);
+    rg = _mm_cvtps_pd(c);
+    ba = _mm_cvtps_pd(_mm_movehl_ps(c, c));
+  }
+  void store(float *color) const
+  {
+    _mm_storeu_ps(color, _mm_movelh_ps(_mm_cvtpd_ps(rg), _mm_cvtpd_ps(ba)));
+  }
+  friend IIRColor operator+(const IIRColor &a, const IIRColor &b)
+  {
+    return IIRColor(_mm_add_pd(a.rg, b.rg), _mm_add_pd(a.ba, b.ba));
+  }
+  friend IIRColor operator-(const IIRColor &a, const IIRColor &b)
+  {
+    return IIRColor(_mm_sub_pd(a.rg, b.rg), _mm_sub_pd(a.ba, b.ba));
+  }
+  friend IIRColor operator*(const double f, const IIRColor &a)
+  {
+    const __m128d fac = _mm_set1_pd(f);
+    return IIRColor(_mm_mul_pd(fac, a.rg), _mm_mul_pd(fac, a.ba));
+  }
+#else
+  double v[4];
+
+  IIRColor()
+  {
+  }
+  explicit IIRColor(const float *color)
+  {
+    for (int i = 0; i < 4; i++) {
+      v[i] = color[i];
+    }
+  }
+  void store(float *color) const
+  {
+    for (int i = 0; i < 4; i++) {
+      color[i] = v[i];
+    }
+  }
+  friend IIRColor operator+(const IIRColor &a, const IIRColor &b)
+  {
+    IIRColor r;
+    for (int i = 0; i < 4; i++) {
+      r.v[i] = a.v[i] + b.v[i];
+    }
+    return r;
+  }
+  friend IIRColor operator-(const IIRColor &a, const IIRColor &b)
+  {
+    IIRColor r;
+    for (int i = 0; i < 4; i++) {
+      r.v[i] = a.v[i] - b.v[i];
+    }
+    return r;
+  }
+  friend IIRColor operator*(const double f, const IIRColor &a)
+  {
+    IIRColor r;
+    for (int i = 0; i < 4; i++) {
+      r.v[i] = f * a.v[i];
+    }
+    return r;
+  }
+#endif
+};
+
+/**
+ * Compute the filter coefficients for \a sigma, returns the directions which can be blurred,
+ * zero when there's nothing to do.
+ */
+static unsigned int iir_gauss_coefficients(
+    float sigma, unsigned int xy, int width, int height, double cf[4], double tsM[9])
 {
-  double q, q2, sc, cf[4], tsM[9], tsu[3], tsv[3];
-  double *X, *Y, *W;
-  const unsigned int src_width = src->getWidth();
-  const unsigned int src_height = src->getHeight();
-  unsigned int x, y, sz;
-  unsigned int i;
-  float *buffer = src->getBuffer();
-  const unsigned int num_channels = src->get_num_channels();
+  double q, q2, sc;
 
   // <0.5 not valid, though can have a possibly useful sort of sharpening effect
   if (sigma < 0.5f) {
-    return;
+    return 0;
   }
 
   if ((xy < 1) || (xy > 3)) {
     xy = 3;
   }
 
-  // XXX The YVV macro defined below explicitly expects sources of at least 3x3 pixels,
+  // XXX The YVV filter below explicitly expects sources of at least 3x3 pixels,
   //     so just skipping blur along faulty direction if src's def is below that limit!
-  if (src_width < 3) {
+  if (width < 3) {
     xy &= ~1;
   }
-  if (src_height < 3) {
+  if (height < 3) {
     xy &= ~2;
   }
   if (xy < 1) {
-    return;
+    return 0;
   }
 
   // see "Recursive Gabor Filtering" by Young/VanVliet
@@ -185,29 +256,58 @@ void FastGaussianBlurOperation::IIR_gauss(MemoryBuffer *src,
                  cf[3] * cf[3] * cf[3] - cf[3] * cf[2] + cf[3]);
   tsM[8] = sc * (cf[3] * (cf[1] + cf[3] * cf[2]));
 
-#define YVV(L) \
-  { \
-    W[0] = cf[0] * X[0] + cf[1] * X[0] + cf[2] * X[0] + cf[3] * X[0]; \
-    W[1] = cf[0] * X[1] + cf[1] * W[0] + cf[2] * X[0] + cf[3] * X[0]; \
-    W[2] = cf[0] * X[2] + cf[1] * W[1] + cf[2] * W[0] + cf[3] * X[0]; \
-    for (i = 3; i < L; i++) { \
-      W[i] = cf[0] * X[i] + cf[1] * W[i - 1] + cf[2] * W[i - 2] + cf[3] * W[i - 3]; \
-    } \
-    tsu[0] = W[L - 1] - X[L - 1]; \
-    tsu[1] = W[L - 2] - X[L - 1]; \
-    tsu[2] = W[L - 3] - X[L - 1]; \
-    tsv[0] = tsM[0] * tsu[0] + tsM[1] * tsu[1] + tsM[2] * tsu[2] + X[L - 1]; \
-    tsv[1] = tsM[3] * tsu[0] + tsM[4] * tsu[1] + tsM[5] * tsu[2] + X[L - 1]; \
-    tsv[2] = tsM[6] * tsu[0] + tsM[7] * tsu[1] + tsM[8] * tsu[2] + X[L - 1]; \
-    Y[L - 1] = cf[0] * W[L - 1] + cf[1] * tsv[0] + cf[2] * tsv[1] + cf[3] * tsv[2]; \
-    Y[L - 2] = cf[0] * W[L - 2] + cf[1] * Y[L - 1] + cf[2] * tsv[0] + cf[3] * tsv[1]; \
-    Y[L - 3] = cf[0] * W[L - 3] + cf[1] * Y[L - 2] + cf[2] * Y[L - 1] + cf[3] * tsv[0]; \
-    /* 'i != UINT_MAX' is really 'i >= 0', but necessary for unsigned int wrapping */ \
-    for (i = L - 4; i != UINT_MAX; i--) { \
-      Y[i] = cf[0] * W[i] + cf[1] * Y[i + 1] + cf[2] * Y[i + 2] + cf[3] * Y[i + 3]; \
-    } \
-  } \
-  (void)0
+  return xy;
+}
+
+/**
+ * Young/VanVliet recursive filter of the \a L samples in \a X, forward pass into \a W and
+ * backward pass into \a Y. \a T is a double or an #IIRColor.
+ */
+template<typename T>
+static void iir_gauss_yvv(
+    const T *X, T *W, T *Y, const unsigned int L, const double cf[4], const double tsM[9])
+{
+  T tsu[3], tsv[3];
+  unsigned int i;
+
+  W[0] = cf[0] * X[0] + cf[1] * X[0] + cf[2] * X[0] + cf[3] * X[0];
+  W[1] = cf[0] * X[1] + cf[1] * W[0] + cf[2] * X[0] + cf[3] * X[0];
+  W[2] = cf[0] * X[2] + cf[1] * W[1] + cf[2] * W[0] + cf[3] * X[0];
+  for (i = 3; i < L; i++) {
+    W[i] = cf[0] * X[i] + cf[1] * W[i - 1] + cf[2] * W[i - 2] + cf[3] * W[i - 3];
+  }
+  tsu[0] = W[L - 1] - X[L - 1];
+  tsu[1] = W[L - 2] - X[L - 1];
+  tsu[2] = W[L - 3] - X[L - 1];
+  tsv[0] = tsM[0] * tsu[0] + tsM[1] * tsu[1] + tsM[2] * tsu[2] + X[L - 1];
+  tsv[1] = tsM[3] * tsu[0] + tsM[4] * tsu[1] + tsM[5] * tsu[2] + X[L - 1];
+  tsv[2] = tsM[6] * tsu[0] + tsM[7] * tsu[1] + tsM[8] * tsu[2] + X[L - 1];
+  Y[L - 1] = cf[0] * W[L - 1] + cf[1] * tsv[0] + cf[2] * tsv[1] + cf[3] * tsv[2];
+  Y[L - 2] = cf[0] * W[L - 2] + cf[1] * Y[L - 1] + cf[2] * tsv[0] + cf[3] * tsv[1];
+  Y[L - 3] = cf[0] * W[L - 3] + cf[1] * Y[L - 2] + cf[2] * Y[L - 1] + cf[3] * tsv[0];
+  /* 'i != UINT_MAX' is really 'i >= 0', but necessary for unsigned int wrapping */
+  for (i = L - 4; i != UINT_MAX; i--) {
+    Y[i] = cf[0] * W[i] + cf[1] * Y[i + 1] + cf[2] * Y[i + 2] + cf[3] * Y[i + 3];
+  }
+}
+
+void FastGaussianBlurOperation::IIR_gauss(MemoryBuffer *src,
+                                          float sigma,
+                                          unsigned int chan,
+                                          unsigned int xy)
+{
+  double cf[4], tsM[9];
+  double *X, *Y, *W;
+  const unsigned int src_width = src->getWidth();
+  const unsigned int src_height = src->getHeight();
+  unsigned int x, y, sz;
+  float *buffer = src->getBuffer();
+  const unsigned int num_channels = src->get_num_channels();
+
+  xy = iir_gauss_coefficients(sigma, xy, src_width, src_height, cf, tsM);
+  if (xy == 0) {
+    return;
+  }
 
   // intermediate buffers
   sz = max(src_width, src_height);
@@ -223,7 +323,7 @@ void FastGaussianBlurOperation::IIR_gauss(MemoryBuffer *src,
         X[x] = buffer[offset];
         offset += num_channels;
       }
-      YVV(src_width);
+      iir_gauss_yvv(X, W, Y, src_width, cf, tsM);
       offset = yx * num_channels + chan;
       for (x = 0; x < src_width; x++) {
         buffer[offset] = Y[x];
@@ -241,7 +341,7 @@ void FastGaussianBlurOperation::IIR_gauss(MemoryBuffer *src,
         X[y] = buffer[offset];
         offset += add;
       }
-      YVV(src_height);
+      iir_gauss_yvv(X, W, Y, src_height, cf, tsM);
       offset = x * num_channels + chan;
       for (y = 0; y < src_height; y++) {
         buffer[offset] = Y[y];
@@ -253,7 +353,59 @@ void FastGaussianBlurOperation::IIR_gauss(MemoryBuffer *src,
   MEM_freeN(X);
   MEM_freeN(W);
   MEM_freeN(Y);
-#undef YVV
+}
+
+void FastGaussianBlurOperation::IIR_gauss_color(MemoryBuffer *src, float sigma, unsigned int xy)
+{
+  double cf[4], tsM[9];
+  IIRColor *X, *Y, *W;
+  const unsigned int src_width = src->getWidth();
+  const unsigned int src_height = src->getHeight();
+  unsigned int x, y, sz;
+  float *buffer = src->getBuffer();
+
+  BLI_assert(src->get_num_channels() == COM_NUM_CHANNELS_COLOR);
+
+  xy = iir_gauss_coefficients(sigma, xy, src_width, src_height, cf, tsM);
+  if (xy == 0) {
+    return;
+  }
+
+  // intermediate buffers
+  sz = max(src_width, src_height);
+  X = (IIRColor *)MEM_mallocN_aligned(sz * sizeof(IIRColor), 16, "IIR_gauss X buf");
+  Y = (IIRColor *)MEM_mallocN_aligned(sz * sizeof(IIRColor), 16, "IIR_gauss Y buf");
+  W = (IIRColor *)MEM_mallocN_aligned(sz * sizeof(IIRColor), 16, "IIR_gauss W buf");
+  if (xy & 1) {  // H
+    for (y = 0; y < src_height; y++) {
+      float *row = buffer + y * src_width * COM_NUM_CHANNELS_COLOR;
+      for (x = 0; x < src_width; x++) {
+        X[x] = IIRColor(row + x * COM_NUM_CHANNELS_COLOR);
+      }
+      iir_gauss_yvv(X, W, Y, src_width, cf, tsM);
+      for (x = 0; x < src_width; x++) {
+        Y[x].store(row + x * COM_NUM_CHANNELS_COLOR);
+      }
+    }
+  }
+  if (xy & 2) {  // V
+    const int add = src_width * COM_NUM_CHANNELS_COLOR;
+
+    for (x = 0; x < src_width; x++) {
+      float *column = buffer + x * COM_NUM_CHANNELS_COLOR;
+      for (y = 0; y < src_height; y++) {
+        X[y] = IIRColor(column + y * add);
+      }
+      iir_gauss_yvv(X, W, Y, src_height, cf, tsM);
+      for (y = 0; y < src_height; y++) {
+        Y[y].store(column + y * add);
+      }
+    }
+  }
+
+  MEM_freeN(X);
+  MEM_freeN(W);
+  MEM_freeN(Y);
 }
 
 ///
@@ -36,6 +36,8 @@ class FastGaussianBlurOperation : public BlurBaseOperation {
   void executePixel(float output[4], int x, int y, void *data);
 
   static void IIR_gauss(MemoryBuffer *src, float sigma, unsigned int channel, unsigned int xy);
+  /** Same as #IIR_gauss, blurring all channels of a color buffer in a single pass. */
+  static void IIR_gauss_color(MemoryBuffer *src, float sigma, unsigned int xy);
   void *initializeTileData(rcti *rect);
   void deinitExecution();
   void initExecution();
@@ -26,6 +26,7 @@ GammaOperation::GammaOperation() : NodeOperation()
   this->addOutputSocket(COM_DT_COLOR);
   this->m_inputProgram = NULL;
   this->m_inputGammaProgram = NULL;
+  this->setFullFrameOperation(true);
 }
 void GammaOperation::initExecution()
 {
@@ -33,6 +34,16 @@ void GammaOperation::initExecution()
   this->m_inputGammaProgram = this->getInputSocketReader(1);
 }
 
+inline void GammaOperation::applyGamma(float output[4], const float input[4], const float gamma)
+{
+  /* check for negative to avoid nan's */
+  output[0] = input[0] > 0.0f ? powf(input[0], gamma) : input[0];
+  output[1] = input[1] > 0.0f ? powf(input[1], gamma) : input[1];
+  output[2] = input[2] > 0.0f ? powf(input[2], gamma) : input[2];
+
+  output[3] = input[3];
+}
+
 void GammaOperation::executePixelSampled(float output[4], float x, float y, PixelSampler sampler)
 {
   float inputValue[4];
@@ -40,13 +51,31 @@ void GammaOperation::executePixelSampled(float output[4], float x, float y, Pixe
 
   this->m_inputProgram->readSampled(inputValue, x, y, sampler);
   this->m_inputGammaProgram->readSampled(inputGamma, x, y, sampler);
-  const float gamma = inputGamma[0];
-  /* check for negative to avoid nan's */
-  output[0] = inputValue[0] > 0.0f ? powf(inputValue[0], gamma) : inputValue[0];
-  output[1] = inputValue[1] > 0.0f ? powf(inputValue[1], gamma) : inputValue[1];
-  output[2] = inputValue[2] > 0.0f ? powf(inputValue[2], gamma) : inputValue[2];
+  applyGamma(output, inputValue, inputGamma[0]);
+}
+
+void GammaOperation::update_memory_buffer(MemoryBuffer *output,
+                                          const rcti *area,
+                                          MemoryBuffer **inputs)
+{
+  if (!inputBuffersContainArea(inputs, area)) {
+    NodeOperation::update_memory_buffer(output, area, inputs);
+    return;
+  }
 
-  output[3] = inputValue[3];
+  const int color_stride = inputs[0]->elem_stride();
+  const int gamma_stride = inputs[1]->elem_stride();
+  for (int y = area->ymin; y < area->ymax; y++) {
+    float *out = output->get_elem(area->xmin, y);
+    const float *color = inputs[0]->get_elem(area->xmin, y);
+    const float *gamma = inputs[1]->get_elem(area->xmin, y);
+    for (int x = area->xmin; x < area->xmax; x++) {
+      applyGamma(out, color, gamma[0]);
+      out += COM_NUM_CHANNELS_COLOR;
+      color += color_stride;
+      gamma += gamma_stride;
+    }
+  }
 }
 
 void GammaOperation::deinitExecution()
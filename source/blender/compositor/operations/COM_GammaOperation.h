@@ -28,6 +28,8 @@ class GammaOperation : public NodeOperation {
   SocketReader *m_inputProgram;
   SocketReader *m_inputGammaProgram;
 
+  void applyGamma(float output[4], const float input[4], const float gamma);
+
  public:
   GammaOperation();
 
@@ -45,5 +47,7 @@ class GammaOperation : public NodeOperation {
    * Deinitialize the execution
    */
   void deinitExecution();
+
+  void update_memory_buffer(MemoryBuffer *output, const rcti *area, MemoryBuffer **inputs);
 };
 #endif
@@ -136,6 +136,24 @@ void GaussianBokehBlurOperation::executePixel(float output[4], int x, int y, voi
   int offsetadd = QualityStepHelper::getOffsetAdd();
   const int addConst = (xmin - x + this->m_radx);
   const int mulConst = (this->m_radx * 2 + 1);
+#ifdef __SSE2__
+  /* Input buffers are 16 byte aligned, accumulate all channels of a pixel at once. */
+  __m128 accum_r = _mm_setzero_ps();
+  for (int ny = ymin; ny < ymax; ny += step) {
+    index = ((ny - y) + this->m_rady) * mulConst + addConst;
+    int bufferindex = ((xmin - bufferstartx) * 4) + ((ny - bufferstarty) * 4 * bufferwidth);
+    for (int nx = xmin; nx < xmax; nx += step) {
+      const float multiplier = this->m_gausstab[index];
+      __m128 reg_a = _mm_load_ps(&buffer[bufferindex]);
+      reg_a = _mm_mul_ps(reg_a, _mm_set1_ps(multiplier));
+      accum_r = _mm_add_ps(accum_r, reg_a);
+      multiplier_accum += multiplier;
+      index += step;
+      bufferindex += offsetadd;
+    }
+  }
+  _mm_storeu_ps(tempColor, accum_r);
+#else
   for (int ny = ymin; ny < ymax; ny += step) {
     index = ((ny - y) + this->m_rady) * mulConst + addConst;
     int bufferindex = ((xmin - bufferstartx) * 4) + ((ny - bufferstarty) * 4 * bufferwidth);
@@ -147,6 +165,7 @@ void GaussianBokehBlurOperation::executePixel(float output[4], int x, int y, voi
       bufferindex += offsetadd;
     }
   }
+#endif
 
   mul_v4_v4fl(output, tempColor, 1.0f / multiplier_accum);
 }
@@ -38,6 +38,8 @@ class GaussianXBlurOperation : public BlurBaseOperation {
    */
   void executePixel(float output[4], int x, int y, void *data);
 
+  void update_memory_buffer(MemoryBuffer *output, const rcti *area, MemoryBuffer **inputs);
+
   void executeOpenCL(OpenCLDevice *device,
                      MemoryBuffer *outputMemoryBuffer,
                      cl_mem clOutputBuffer,
@@ -32,6 +32,7 @@ GaussianYBlurOperation::GaussianYBlurOperation() : BlurBaseOperation(COM_DT_COLO
   this->m_gausstab_sse = NULL;
 #endif
   this->m_filtersize = 0;
+  this->setFullFrameOperation(true);
 }
 
 void *GaussianYBlurOperation::initializeTileData(rcti * /*rect*/)
@@ -119,6 +120,32 @@ void GaussianYBlurOperation::executePixel(float output[4], int x, int y, void *d
   mul_v4_v4fl(output, color_accum, 1.0f / multiplier_accum);
 }
 
+void GaussianYBlurOperation::update_memory_buffer(MemoryBuffer *output,
+                                                  const rcti *area,
+                                                  MemoryBuffer **inputs)
+{
+  /* The filter reads around the area, clamped to the input buffer. */
+  MemoryBuffer *input = inputs[0];
+  if (!inputBuffersContainArea(inputs, area) || input == NULL || input->is_single_elem()) {
+    NodeOperation::update_memory_buffer(output, area, inputs);
+    return;
+  }
+
+  lockMutex();
+  if (!this->m_sizeavailable) {
+    updateGauss();
+  }
+  unlockMutex();
+
+  for (int y = area->ymin; y < area->ymax; y++) {
+    float *out = output->get_elem(area->xmin, y);
+    for (int x = area->xmin; x < area->xmax; x++) {
+      GaussianYBlurOperation::executePixel(out, x, y, input);
+      out += COM_NUM_CHANNELS_COLOR;
+    }
+  }
+}
+
 void GaussianYBlurOperation::executeOpenCL(OpenCLDevice *device,
                                            MemoryBuffer *outputMemoryBuffer,
                                            cl_mem clOutputBuffer,
@@ -28,6 +28,7 @@ InvertOperation::InvertOperation() : NodeOperation()
   this->m_color = true;
   this->m_alpha = false;
   setResolutionInputSocketIndex(1);
+  this->setFullFrameOperation(true);
 }
 void InvertOperation::initExecution()
 {
@@ -35,14 +36,8 @@ void InvertOperation::initExecution()
   this->m_inputColorProgram = this->getInputSocketReader(1);
 }
 
-void InvertOperation::executePixelSampled(float output[4], float x, float y, PixelSampler sampler)
+inline void InvertOperation::invert(float output[4], const float value, const float inputColor[4])
 {
-  float inputValue[4];
-  float inputColor[4];
-  this->m_inputValueProgram->readSampled(inputValue, x, y, sampler);
-  this->m_inputColorProgram->readSampled(inputColor, x, y, sampler);
-
-  const float value = inputValue[0];
   const float invertedValue = 1.0f - value;
 
   if (this->m_color) {
@@ -62,6 +57,40 @@ void InvertOperation::executePixelSampled(float output[4], float x, float y, Pix
   }
 }
 
+void InvertOperation::executePixelSampled(float output[4], float x, float y, PixelSampler sampler)
+{
+  float inputValue[4];
+  float inputColor[4];
+  this->m_inputValueProgram->readSampled(inputValue, x, y, sampler);
+  this->m_inputColorProgram->readSampled(inputColor, x, y, sampler);
+
+  invert(output, inputValue[0], inputColor);
+}
+
+void InvertOperation::update_memory_buffer(MemoryBuffer *output,
+                                           const rcti *area,
+                                           MemoryBuffer **inputs)
+{
+  if (!inputBuffersContainArea(inputs, area)) {
+    NodeOperation::update_memory_buffer(output, area, inputs);
+    return;
+  }
+
+  const int value_stride = inputs[0]->elem_stride();
+  const int color_stride = inputs[1]->elem_stride();
+  for (int y = area->ymin; y < area->ymax; y++) {
+    float *out = output->get_elem(area->xmin, y);
+    const float *value = inputs[0]->get_elem(area->xmin, y);
+    const float *color = inputs[1]->get_elem(area->xmin, y);
+    for (int x = area->xmin; x < area->xmax; x++) {
+      invert(out, value[0], color);
+      out += COM_NUM_CHANNELS_COLOR;
+      value += value_stride;
+      color += color_stride;
+    }
+  }
+}
+
 void InvertOperation::deinitExecution()
 {
   this->m_inputValueProgram = NULL;
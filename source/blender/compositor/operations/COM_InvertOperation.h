@@ -31,6 +31,8 @@ class InvertOperation : public NodeOperation {
   bool m_alpha;
   bool m_color;
 
+  void invert(float output[4], const float value, const float inputColor[4]);
+
  public:
   InvertOperation();
 
@@ -49,6 +51,8 @@ class InvertOperation : public NodeOperation {
    */
   void deinitExecution();
 
+  void update_memory_buffer(MemoryBuffer *output, const rcti *area, MemoryBuffer **inputs);
+
   void setColor(bool color)
   {
     this->m_color = color;
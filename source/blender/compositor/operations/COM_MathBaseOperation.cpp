@@ -31,6 +31,7 @@ MathBaseOperation::MathBaseOperation() : NodeOperation()
   this->m_inputValue2Operation = NULL;
   this->m_inputValue3Operation = NULL;
   this->m_useClamp = false;
+  this->setPointOperation(true);
 }
 
 void MathBaseOperation::initExecution()
@@ -72,6 +73,38 @@ void MathBaseOperation::clampIfNeeded(float *color)
   }
 }
 
+template<typename MathFunc>
+void MathBaseOperation::updateMemoryBufferMath(MemoryBuffer *output,
+                                               const rcti *area,
+                                               MemoryBuffer **inputs,
+                                               MathFunc func)
+{
+  if (!inputBuffersContainArea(inputs, area)) {
+    NodeOperation::update_memory_buffer(output, area, inputs);
+    return;
+  }
+
+  const int value1_stride = inputs[0]->elem_stride();
+  const int value2_stride = inputs[1]->elem_stride();
+  for (int y = area->ymin; y < area->ymax; y++) {
+    float *out = output->get_elem(area->xmin, y);
+    const float *value1 = inputs[0]->get_elem(area->xmin, y);
+    const float *value2 = inputs[1]->get_elem(area->xmin, y);
+    for (int x = area->xmin; x < area->xmax; x++) {
+      out[0] = func(value1[0], value2[0]);
+      clampIfNeeded(out);
+      out += COM_NUM_CHANNELS_VALUE;
+      value1 += value1_stride;
+      value2 += value2_stride;
+    }
+  }
+}
+
+static inline float math_add(const float a, const float b)
+{
+  return a + b;
+}
+
 void MathAddOperation::executePixelSampled(float output[4], float x, float y, PixelSampler sampler)
 {
   float inputValue1[4];
@@ -80,11 +113,23 @@ void MathAddOperation::executePixelSampled(float output[4], float x, float y, Pi
   this->m_inputValue1Operation->readSampled(inputValue1, x, y, sampler);
   this->m_inputValue2Operation->readSampled(inputValue2, x, y, sampler);
 
-  output[0] = inputValue1[0] + inputValue2[0];
+  output[0] = math_add(inputValue1[0], inputValue2[0]);
 
   clampIfNeeded(output);
 }
 
+void MathAddOperation::update_memory_buffer(MemoryBuffer *output,
+                                            const rcti *area,
+                                            MemoryBuffer **inputs)
+{
+  updateMemoryBufferMath(output, area, inputs, math_add);
+}
+
+static inline float math_subtract(const float a, const float b)
+{
+  return a - b;
+}
+
 void MathSubtractOperation::executePixelSampled(float output[4],
                                                 float x,
                                                 float y,
@@ -96,11 +141,23 @@ void MathSubtractOperation::executePixelSampled(float output[4],
   this->m_inputValue1Operation->readSampled(inputValue1, x, y, sampler);
   this->m_inputValue2Operation->readSampled(inputValue2, x, y, sampler);
 
-  output[0] = inputValue1[0] - inputValue2[0];
+  output[0] = math_subtract(inputValue1[0], inputValue2[0]);
 
   clampIfNeeded(output);
 }
 
+void MathSubtractOperation::update_memory_buffer(MemoryBuffer *output,
+                                                 const rcti *area,
+                                                 MemoryBuffer **inputs)
+{
+  updateMemoryBufferMath(output, area, inputs, math_subtract);
+}
+
+static inline float math_multiply(const float a, const float b)
+{
+  return a * b;
+}
+
 void MathMultiplyOperation::executePixelSampled(float output[4],
                                                 float x,
                                                 float y,
@@ -112,11 +169,24 @@ void MathMultiplyOperation::executePixelSampled(float output[4],
   this->m_inputValue1Operation->readSampled(inputValue1, x, y, sampler);
   this->m_inputValue2Operation->readSampled(inputValue2, x, y, sampler);
 
-  output[0] = inputValue1[0] * inputValue2[0];
+  output[0] = math_multiply(inputValue1[0], inputValue2[0]);
 
   clampIfNeeded(output);
 }
 
+void MathMultiplyOperation::update_memory_buffer(MemoryBuffer *output,
+                                                 const rcti *area,
+                                                 MemoryBuffer **inputs)
+{
+  updateMemoryBufferMath(output, area, inputs, math_multiply);
+}
+
+static inline float math_divide(const float a, const float b)
+{
+  /* We don't want to divide by zero. */
+  return (b == 0.0f) ? 0.0f : a / b;
+}
+
 void MathDivideOperation::executePixelSampled(float output[4],
                                               float x,
                                               float y,
@@ -128,16 +198,18 @@ void MathDivideOperation::executePixelSampled(float output[4],
   this->m_inputValue1Operation->readSampled(inputValue1, x, y, sampler);
   this->m_inputValue2Operation->readSampled(inputValue2, x, y, sampler);
 
-  if (inputValue2[0] == 0) { /* We don't want to divide by zero. */
-    output[0] = 0.0;
-  }
-  else {
-    output[0] = inputValue1[0] / inputValue2[0];
-  }
+  output[0] = math_divide(inputValue1[0], inputValue2[0]);
 
   clampIfNeeded(output);
 }
 
+void MathDivideOperation::update_memory_buffer(MemoryBuffer *output,
+                                               const rcti *area,
+                                               MemoryBuffer **inputs)
+{
+  updateMemoryBufferMath(output, area, inputs, math_divide);
+}
+
 void MathSineOperation::executePixelSampled(float output[4],
                                             float x,
                                             float y,
@@ -341,6 +413,11 @@ void MathLogarithmOperation::executePixelSampled(float output[4],
   clampIfNeeded(output);
 }
 
+static inline float math_minimum(const float a, const float b)
+{
+  return min(a, b);
+}
+
 void MathMinimumOperation::executePixelSampled(float output[4],
                                                float x,
                                                float y,
@@ -352,11 +429,23 @@ void MathMinimumOperation::executePixelSampled(float output[4],
   this->m_inputValue1Operation->readSampled(inputValue1, x, y, sampler);
   this->m_inputValue2Operation->readSampled(inputValue2, x, y, sampler);
 
-  output[0] = min(inputValue1[0], inputValue2[0]);
+  output[0] = math_minimum(inputValue1[0], inputValue2[0]);
 
   clampIfNeeded(output);
 }
 
+void MathMinimumOperation::update_memory_buffer(MemoryBuffer *output,
+                                                const rcti *area,
+                                                MemoryBuffer **inputs)
+{
+  updateMemoryBufferMath(output, area, inputs, math_minimum);
+}
+
+static inline float math_maximum(const float a, const float b)
+{
+  return max(a, b);
+}
+
 void MathMaximumOperation::executePixelSampled(float output[4],
                                                float x,
                                                float y,
@@ -368,11 +457,18 @@ void MathMaximumOperation::executePixelSampled(float output[4],
   this->m_inputValue1Operation->readSampled(inputValue1, x, y, sampler);
   this->m_inputValue2Operation->readSampled(inputValue2, x, y, sampler);
 
-  output[0] = max(inputValue1[0], inputValue2[0]);
+  output[0] = math_maximum(inputValue1[0], inputValue2[0]);
 
   clampIfNeeded(output);
 }
 
+void MathMaximumOperation::update_memory_buffer(MemoryBuffer *output,
+                                                const rcti *area,
+                                                MemoryBuffer **inputs)
+{
+  updateMemoryBufferMath(output, area, inputs, math_maximum);
+}
+
 void MathRoundOperation::executePixelSampled(float output[4],
                                              float x,
                                              float y,
@@ -43,6 +43,15 @@ class MathBaseOperation : public NodeOperation {
 
   void clampIfNeeded(float color[4]);
 
+  /**
+   * \brief calculate \a area of \a output applying \a func to whole input buffers
+   */
+  template<typename MathFunc>
+  void updateMemoryBufferMath(MemoryBuffer *output,
+                              const rcti *area,
+                              MemoryBuffer **inputs,
+                              MathFunc func);
+
  public:
   /**
    * the inner loop of this program
@@ -74,29 +83,37 @@ class MathAddOperation : public MathBaseOperation {
  public:
   MathAddOperation() : MathBaseOperation()
   {
+    this->setFullFrameOperation(true);
   }
   void executePixelSampled(float output[4], float x, float y, PixelSampler sampler);
+  void update_memory_buffer(MemoryBuffer *output, const rcti *area, MemoryBuffer **inputs);
 };
 class MathSubtractOperation : public MathBaseOperation {
  public:
   MathSubtractOperation() : MathBaseOperation()
   {
+    this->setFullFrameOperation(true);
   }
   void executePixelSampled(float output[4], float x, float y, PixelSampler sampler);
+  void update_memory_buffer(MemoryBuffer *output, const rcti *area, MemoryBuffer **inputs);
 };
 class MathMultiplyOperation : public MathBaseOperation {
  public:
   MathMultiplyOperation() : MathBaseOperation()
   {
+    this->setFullFrameOperation(true);
   }
   void executePixelSampled(float output[4], float x, float y, PixelSampler sampler);
+  void update_memory_buffer(MemoryBuffer *output, const rcti *area, MemoryBuffer **inputs);
 };
 class MathDivideOperation : public MathBaseOperation {
  public:
   MathDivideOperation() : MathBaseOperation()
   {
+    this->setFullFrameOperation(true);
   }
   void executePixelSampled(float output[4], float x, float y, PixelSampler sampler);
+  void update_memory_buffer(MemoryBuffer *output, const rcti *area, MemoryBuffer **inputs);
 };
 class MathSineOperation : public MathBaseOperation {
  public:
@@ -181,15 +198,19 @@ class MathMinimumOperation : public MathBaseOperation {
  public:
   MathMinimumOperation() : MathBaseOperation()
   {
+    this->setFullFrameOperation(true);
   }
   void executePixelSampled(float output[4], float x, float y, PixelSampler sampler);
+  void update_memory_buffer(MemoryBuffer *output, const rcti *area, MemoryBuffer **inputs);
 };
 class MathMaximumOperation : public MathBaseOperation {
  public:
   MathMaximumOperation() : MathBaseOperation()
   {
+    this->setFullFrameOperation(true);
   }
   void executePixelSampled(float output[4], float x, float y, PixelSampler sampler);
+  void update_memory_buffer(MemoryBuffer *output, const rcti *area, MemoryBuffer **inputs);
 };
 class MathRoundOperation : public MathBaseOperation {
  public:
@@ -35,6 +35,7 @@ MixBaseOperation::MixBaseOperation() : NodeOperation()
   this->m_inputColor2Operation = NULL;
   this->setUseValueAlphaMultiply(false);
   this->setUseClamp(false);
+  this->setPointOperation(true);
 }
 
 void MixBaseOperation::initExecution()
@@ -97,11 +98,52 @@ void MixBaseOperation::deinitExecution()
   this->m_inputColor2Operation = NULL;
 }
 
+template<typename MixFunc>
+void MixBaseOperation::updateMemoryBufferMix(MemoryBuffer *output,
+                                             const rcti *area,
+                                             MemoryBuffer **inputs,
+                                             MixFunc mix)
+{
+  if (!inputBuffersContainArea(inputs, area)) {
+    NodeOperation::update_memory_buffer(output, area, inputs);
+    return;
+  }
+
+  const int value_stride = inputs[0]->elem_stride();
+  const int color1_stride = inputs[1]->elem_stride();
+  const int color2_stride = inputs[2]->elem_stride();
+  for (int y = area->ymin; y < area->ymax; y++) {
+    float *out = output->get_elem(area->xmin, y);
+    const float *value = inputs[0]->get_elem(area->xmin, y);
+    const float *color1 = inputs[1]->get_elem(area->xmin, y);
+    const float *color2 = inputs[2]->get_elem(area->xmin, y);
+    for (int x = area->xmin; x < area->xmax; x++) {
+      mix(out, color1, color2, mixFactor(value, color2));
+      clampIfNeeded(out);
+      out += COM_NUM_CHANNELS_COLOR;
+      value += value_stride;
+      color1 += color1_stride;
+      color2 += color2_stride;
+    }
+  }
+}
+
 /* ******** Mix Add Operation ******** */
 
 MixAddOperation::MixAddOperation() : MixBaseOperation()
 {
-  /* pass */
+  this->setFullFrameOperation(true);
+}
+
+static inline void mix_add(float output[4],
+                           const float color1[4],
+                           const float color2[4],
+                           const float value)
+{
+  output[0] = color1[0] + value * color2[0];
+  output[1] = color1[1] + value * color2[1];
+  output[2] = color1[2] + value * color2[2];
+  output[3] = color1[3];
 }
 
 void MixAddOperation::executePixelSampled(float output[4], float x, float y, PixelSampler sampler)
@@ -114,23 +156,34 @@ void MixAddOperation::executePixelSampled(float output[4], float x, float y, Pix
   this->m_inputColor1Operation->readSampled(inputColor1, x, y, sampler);
   this->m_inputColor2Operation->readSampled(inputColor2, x, y, sampler);
 
-  float value = inputValue[0];
-  if (this->useValueAlphaMultiply()) {
-    value *= inputColor2[3];
-  }
-  output[0] = inputColor1[0] + value * inputColor2[0];
-  output[1] = inputColor1[1] + value * inputColor2[1];
-  output[2] = inputColor1[2] + value * inputColor2[2];
-  output[3] = inputColor1[3];
-
+  mix_add(output, inputColor1, inputColor2, mixFactor(inputValue, inputColor2));
   clampIfNeeded(output);
 }
 
+void MixAddOperation::update_memory_buffer(MemoryBuffer *output,
+                                           const rcti *area,
+                                           MemoryBuffer **inputs)
+{
+  updateMemoryBufferMix(output, area, inputs, mix_add);
+}
+
 /* ******** Mix Blend Operation ******** */
 
 MixBlendOperation::MixBlendOperation() : MixBaseOperation()
 {
-  /* pass */
+  this->setFullFrameOperation(true);
+}
+
+static inline void mix_blend(float output[4],
+                             const float color1[4],
+                             const float color2[4],
+                             const float value)
+{
+  const float valuem = 1.0f - value;
+  output[0] = valuem * color1[0] + value * color2[0];
+  output[1] = valuem * color1[1] + value * color2[1];
+  output[2] = valuem * color1[2] + value * color2[2];
+  output[3] = color1[3];
 }
 
 void MixBlendOperation::executePixelSampled(float output[4],
@@ -141,25 +194,22 @@ void MixBlendOperation::executePixelSampled(float output[4],
   float inputColor1[4];
   float inputColor2[4];
   float inputValue[4];
-  float value;
 
   this->m_inputValueOperation->readSampled(inputValue, x, y, sampler);
   this->m_inputColor1Operation->readSampled(inputColor1, x, y, sampler);
   this->m_inputColor2Operation->readSampled(inputColor2, x, y, sampler);
-  value = inputValue[0];
-
-  if (this->useValueAlphaMultiply()) {
-    value *= inputColor2[3];
-  }
-  float valuem = 1.0f - value;
-  output[0] = valuem * (inputColor1[0]) + value * (inputColor2[0]);
-  output[1] = valuem * (inputColor1[1]) + value * (inputColor2[1]);
-  output[2] = valuem * (inputColor1[2]) + value * (inputColor2[2]);
-  output[3] = inputColor1[3];
 
+  mix_blend(output, inputColor1, inputColor2, mixFactor(inputValue, inputColor2));
   clampIfNeeded(output);
 }
 
+void MixBlendOperation::update_memory_buffer(MemoryBuffer *output,
+                                             const rcti *area,
+                                             MemoryBuffer **inputs)
+{
+  updateMemoryBufferMix(output, area, inputs, mix_blend);
+}
+
 /* ******** Mix Burn Operation ******** */
 
 MixColorBurnOperation::MixColorBurnOperation() : MixBaseOperation()
@@ -292,7 +342,19 @@ void MixColorOperation::executePixelSampled(float output[4],
 
 MixDarkenOperation::MixDarkenOperation() : MixBaseOperation()
 {
-  /* pass */
+  this->setFullFrameOperation(true);
+}
+
+static inline void mix_darken(float output[4],
+                              const float color1[4],
+                              const float color2[4],
+                              const float value)
+{
+  const float valuem = 1.0f - value;
+  output[0] = min_ff(color1[0], color2[0]) * value + color1[0] * valuem;
+  output[1] = min_ff(color1[1], color2[1]) * value + color1[1] * valuem;
+  output[2] = min_ff(color1[2], color2[2]) * value + color1[2] * valuem;
+  output[3] = color1[3];
 }
 
 void MixDarkenOperation::executePixelSampled(float output[4],
@@ -308,24 +370,34 @@ void MixDarkenOperation::executePixelSampled(float output[4],
   this->m_inputColor1Operation->readSampled(inputColor1, x, y, sampler);
   this->m_inputColor2Operation->readSampled(inputColor2, x, y, sampler);
 
-  float value = inputValue[0];
-  if (this->useValueAlphaMultiply()) {
-    value *= inputColor2[3];
-  }
-  float valuem = 1.0f - value;
-  output[0] = min_ff(inputColor1[0], inputColor2[0]) * value + inputColor1[0] * valuem;
-  output[1] = min_ff(inputColor1[1], inputColor2[1]) * value + inputColor1[1] * valuem;
-  output[2] = min_ff(inputColor1[2], inputColor2[2]) * value + inputColor1[2] * valuem;
-  output[3] = inputColor1[3];
-
+  mix_darken(output, inputColor1, inputColor2, mixFactor(inputValue, inputColor2));
   clampIfNeeded(output);
 }
 
+void MixDarkenOperation::update_memory_buffer(MemoryBuffer *output,
+                                              const rcti *area,
+                                              MemoryBuffer **inputs)
+{
+  updateMemoryBufferMix(output, area, inputs, mix_darken);
+}
+
 /* ******** Mix Difference Operation ******** */
 
 MixDifferenceOperation::MixDifferenceOperation() : MixBaseOperation()
 {
-  /* pass */
+  this->setFullFrameOperation(true);
+}
+
+static inline void mix_difference(float output[4],
+                                  const float color1[4],
+                                  const float color2[4],
+                                  const float value)
+{
+  const float valuem = 1.0f - value;
+  output[0] = valuem * color1[0] + value * fabsf(color1[0] - color2[0]);
+  output[1] = valuem * color1[1] + value * fabsf(color1[1] - color2[1]);
+  output[2] = valuem * color1[2] + value * fabsf(color1[2] - color2[2]);
+  output[3] = color1[3];
 }
 
 void MixDifferenceOperation::executePixelSampled(float output[4],
@@ -341,24 +413,34 @@ void MixDifferenceOperation::executePixelSampled(float output[4],
   this->m_inputColor1Operation->readSampled(inputColor1, x, y, sampler);
   this->m_inputColor2Operation->readSampled(inputColor2, x, y, sampler);
 
-  float value = inputValue[0];
-  if (this->useValueAlphaMultiply()) {
-    value *= inputColor2[3];
-  }
-  float valuem = 1.0f - value;
-  output[0] = valuem * inputColor1[0] + value * fabsf(inputColor1[0] - inputColor2[0]);
-  output[1] = valuem * inputColor1[1] + value * fabsf(inputColor1[1] - inputColor2[1]);
-  output[2] = valuem * inputColor1[2] + value * fabsf(inputColor1[2] - inputColor2[2]);
-  output[3] = inputColor1[3];
-
+  mix_difference(output, inputColor1, inputColor2, mixFactor(inputValue, inputColor2));
   clampIfNeeded(output);
 }
 
+void MixDifferenceOperation::update_memory_buffer(MemoryBuffer *output,
+                                                  const rcti *area,
+                                                  MemoryBuffer **inputs)
+{
+  updateMemoryBufferMix(output, area, inputs, mix_difference);
+}
+
 /* ******** Mix Difference Operation ******** */
 
 MixDivideOperation::MixDivideOperation() : MixBaseOperation()
 {
-  /* pass */
+  this->setFullFrameOperation(true);
+}
+
+static inline void mix_divide(float output[4],
+                              const float color1[4],
+                              const float color2[4],
+                              const float value)
+{
+  const float valuem = 1.0f - value;
+  for (int i = 0; i < 3; i++) {
+    output[i] = (color2[i] != 0.0f) ? valuem * color1[i] + value * color1[i] / color2[i] : 0.0f;
+  }
+  output[3] = color1[3];
 }
 
 void MixDivideOperation::executePixelSampled(float output[4],
@@ -374,36 +456,17 @@ void MixDivideOperation::executePixelSampled(float output[4],
   this->m_inputColor1Operation->readSampled(inputColor1, x, y, sampler);
   this->m_inputColor2Operation->readSampled(inputColor2, x, y, sampler);
 
-  float value = inputValue[0];
-  if (this->useValueAlphaMultiply()) {
-    value *= inputColor2[3];
-  }
-  float valuem = 1.0f - value;
-
-  if (inputColor2[0] != 0.0f) {
-    output[0] = valuem * (inputColor1[0]) + value * (inputColor1[0]) / inputColor2[0];
-  }
-  else {
-    output[0] = 0.0f;
-  }
-  if (inputColor2[1] != 0.0f) {
-    output[1] = valuem * (inputColor1[1]) + value * (inputColor1[1]) / inputColor2[1];
-  }
-  else {
-    output[1] = 0.0f;
-  }
-  if (inputColor2[2] != 0.0f) {
-    output[2] = valuem * (inputColor1[2]) + value * (inputColor1[2]) / inputColor2[2];
-  }
-  else {
-    output[2] = 0.0f;
-  }
-
-  output[3] = inputColor1[3];
-
+  mix_divide(output, inputColor1, inputColor2, mixFactor(inputValue, inputColor2));
   clampIfNeeded(output);
 }
 
+void MixDivideOperation::update_memory_buffer(MemoryBuffer *output,
+                                              const rcti *area,
+                                              MemoryBuffer **inputs)
+{
+  updateMemoryBufferMix(output, area, inputs, mix_divide);
+}
+
 /* ******** Mix Dodge Operation ******** */
 
 MixDodgeOperation::MixDodgeOperation() : MixBaseOperation()
@@ -579,7 +642,19 @@ void MixHueOperation::executePixelSampled(float output[4], float x, float y, Pix
 
 MixLightenOperation::MixLightenOperation() : MixBaseOperation()
 {
-  /* pass */
+  this->setFullFrameOperation(true);
+}
+
+static inline void mix_lighten(float output[4],
+                               const float color1[4],
+                               const float color2[4],
+                               const float value)
+{
+  for (int i = 0; i < 3; i++) {
+    const float tmp = value * color2[i];
+    output[i] = (tmp > color1[i]) ? tmp : color1[i];
+  }
+  output[3] = color1[3];
 }
 
 void MixLightenOperation::executePixelSampled(float output[4],
@@ -595,37 +670,17 @@ void MixLightenOperation::executePixelSampled(float output[4],
   this->m_inputColor1Operation->readSampled(inputColor1, x, y, sampler);
   this->m_inputColor2Operation->readSampled(inputColor2, x, y, sampler);
 
-  float value = inputValue[0];
-  if (this->useValueAlphaMultiply()) {
-    value *= inputColor2[3];
-  }
-  float tmp;
-  tmp = value * inputColor2[0];
-  if (tmp > inputColor1[0]) {
-    output[0] = tmp;
-  }
-  else {
-    output[0] = inputColor1[0];
-  }
-  tmp = value * inputColor2[1];
-  if (tmp > inputColor1[1]) {
-    output[1] = tmp;
-  }
-  else {
-    output[1] = inputColor1[1];
-  }
-  tmp = value * inputColor2[2];
-  if (tmp > inputColor1[2]) {
-    output[2] = tmp;
-  }
-  else {
-    output[2] = inputColor1[2];
-  }
-  output[3] = inputColor1[3];
-
+  mix_lighten(output, inputColor1, inputColor2, mixFactor(inputValue, inputColor2));
   clampIfNeeded(output);
 }
 
+void MixLightenOperation::update_memory_buffer(MemoryBuffer *output,
+                                               const rcti *area,
+                                               MemoryBuffer **inputs)
+{
+  updateMemoryBufferMix(output, area, inputs, mix_lighten);
+}
+
 /* ******** Mix Linear Light Operation ******** */
 
 MixLinearLightOperation::MixLinearLightOperation() : MixBaseOperation()
@@ -678,7 +733,19 @@ void MixLinearLightOperation::executePixelSampled(float output[4],
 
 MixMultiplyOperation::MixMultiplyOperation() : MixBaseOperation()
 {
-  /* pass */
+  this->setFullFrameOperation(true);
+}
+
+static inline void mix_multiply(float output[4],
+                                const float color1[4],
+                                const float color2[4],
+                                const float value)
+{
+  const float valuem = 1.0f - value;
+  output[0] = color1[0] * (valuem + value * color2[0]);
+  output[1] = color1[1] * (valuem + value * color2[1]);
+  output[2] = color1[2] * (valuem + value * color2[2]);
+  output[3] = color1[3];
 }
 
 void MixMultiplyOperation::executePixelSampled(float output[4],
@@ -694,19 +761,17 @@ void MixMultiplyOperation::executePixelSampled(float output[4],
   this->m_inputColor1Operation->readSampled(inputColor1, x, y, sampler);
   this->m_inputColor2Operation->readSampled(inputColor2, x, y, sampler);
 
-  float value = inputValue[0];
-  if (this->useValueAlphaMultiply()) {
-    value *= inputColor2[3];
-  }
-  float valuem = 1.0f - value;
-  output[0] = inputColor1[0] * (valuem + value * inputColor2[0]);
-  output[1] = inputColor1[1] * (valuem + value * inputColor2[1]);
-  output[2] = inputColor1[2] * (valuem + value * inputColor2[2]);
-  output[3] = inputColor1[3];
-
+  mix_multiply(output, inputColor1, inputColor2, mixFactor(inputValue, inputColor2));
   clampIfNeeded(output);
 }
 
+void MixMultiplyOperation::update_memory_buffer(MemoryBuffer *output,
+                                                const rcti *area,
+                                                MemoryBuffer **inputs)
+{
+  updateMemoryBufferMix(output, area, inputs, mix_multiply);
+}
+
 /* ******** Mix Ovelray Operation ******** */
 
 MixOverlayOperation::MixOverlayOperation() : MixBaseOperation()
@@ -803,7 +868,19 @@ void MixSaturationOperation::executePixelSampled(float output[4],
 
 MixScreenOperation::MixScreenOperation() : MixBaseOperation()
 {
-  /* pass */
+  this->setFullFrameOperation(true);
+}
+
+static inline void mix_screen(float output[4],
+                              const float color1[4],
+                              const float color2[4],
+                              const float value)
+{
+  const float valuem = 1.0f - value;
+  output[0] = 1.0f - (valuem + value * (1.0f - color2[0])) * (1.0f - color1[0]);
+  output[1] = 1.0f - (valuem + value * (1.0f - color2[1])) * (1.0f - color1[1]);
+  output[2] = 1.0f - (valuem + value * (1.0f - color2[2])) * (1.0f - color1[2]);
+  output[3] = color1[3];
 }
 
 void MixScreenOperation::executePixelSampled(float output[4],
@@ -819,20 +896,17 @@ void MixScreenOperation::executePixelSampled(float output[4],
   this->m_inputColor1Operation->readSampled(inputColor1, x, y, sampler);
   this->m_inputColor2Operation->readSampled(inputColor2, x, y, sampler);
 
-  float value = inputValue[0];
-  if (this->useValueAlphaMultiply()) {
-    value *= inputColor2[3];
-  }
-  float valuem = 1.0f - value;
-
-  output[0] = 1.0f - (valuem + value * (1.0f - inputColor2[0])) * (1.0f - inputColor1[0]);
-  output[1] = 1.0f - (valuem + value * (1.0f - inputColor2[1])) * (1.0f - inputColor1[1]);
-  output[2] = 1.0f - (valuem + value * (1.0f - inputColor2[2])) * (1.0f - inputColor1[2]);
-  output[3] = inputColor1[3];
-
+  mix_screen(output, inputColor1, inputColor2, mixFactor(inputValue, inputColor2));
   clampIfNeeded(output);
 }
 
+void MixScreenOperation::update_memory_buffer(MemoryBuffer *output,
+                                              const rcti *area,
+                                              MemoryBuffer **inputs)
+{
+  updateMemoryBufferMix(output, area, inputs, mix_screen);
+}
+
 /* ******** Mix Soft Light Operation ******** */
 
 MixSoftLightOperation::MixSoftLightOperation() : MixBaseOperation()
@@ -883,7 +957,18 @@ void MixSoftLightOperation::executePixelSampled(float output[4],
 
 MixSubtractOperation::MixSubtractOperation() : MixBaseOperation()
 {
-  /* pass */
+  this->setFullFrameOperation(true);
+}
+
+static inline void mix_subtract(float output[4],
+                                const float color1[4],
+                                const float color2[4],
+                                const float value)
+{
+  output[0] = color1[0] - value * color2[0];
+  output[1] = color1[1] - value * color2[1];
+  output[2] = color1[2] - value * color2[2];
+  output[3] = color1[3];
 }
 
 void MixSubtractOperation::executePixelSampled(float output[4],
@@ -899,18 +984,17 @@ void MixSubtractOperation::executePixelSampled(float output[4],
   this->m_inputColor1Operation->readSampled(inputColor1, x, y, sampler);
   this->m_inputColor2Operation->readSampled(inputColor2, x, y, sampler);
 
-  float value = inputValue[0];
-  if (this->useValueAlphaMultiply()) {
-    value *= inputColor2[3];
-  }
-  output[0] = inputColor1[0] - value * (inputColor2[0]);
-  output[1] = inputColor1[1] - value * (inputColor2[1]);
-  output[2] = inputColor1[2] - value * (inputColor2[2]);
-  output[3] = inputColor1[3];
-
+  mix_subtract(output, inputColor1, inputColor2, mixFactor(inputValue, inputColor2));
   clampIfNeeded(output);
 }
 
+void MixSubtractOperation::update_memory_buffer(MemoryBuffer *output,
+                                                const rcti *area,
+                                                MemoryBuffer **inputs)
+{
+  updateMemoryBufferMix(output, area, inputs, mix_subtract);
+}
+
 /* ******** Mix Value Operation ******** */
 
 MixValueOperation::MixValueOperation() : MixBaseOperation()
@@ -43,6 +43,20 @@ class MixBaseOperation : public NodeOperation {
     }
   }
 
+  inline float mixFactor(const float inputValue[4], const float inputColor2[4])
+  {
+    return this->m_valueAlphaMultiply ? inputValue[0] * inputColor2[3] : inputValue[0];
+  }
+
+  /**
+   * \brief calculate \a area of \a output mixing whole input buffers with \a mix
+   */
+  template<typename MixFunc>
+  void updateMemoryBufferMix(MemoryBuffer *output,
+                             const rcti *area,
+                             MemoryBuffer **inputs,
+                             MixFunc mix);
+
  public:
   /**
    * Default constructor
@@ -84,12 +98,14 @@ class MixAddOperation : public MixBaseOperation {
  public:
   MixAddOperation();
   void executePixelSampled(float output[4], float x, float y, PixelSampler sampler);
+  void update_memory_buffer(MemoryBuffer *output, const rcti *area, MemoryBuffer **inputs);
 };
 
 class MixBlendOperation : public MixBaseOperation {
  public:
   MixBlendOperation();
   void executePixelSampled(float output[4], float x, float y, PixelSampler sampler);
+  void update_memory_buffer(MemoryBuffer *output, const rcti *area, MemoryBuffer **inputs);
 };
 
 class MixColorBurnOperation : public MixBaseOperation {
@@ -108,18 +124,21 @@ class MixDarkenOperation : public MixBaseOperation {
  public:
   MixDarkenOperation();
   void executePixelSampled(float output[4], float x, float y, PixelSampler sampler);
+  void update_memory_buffer(MemoryBuffer *output, const rcti *area, MemoryBuffer **inputs);
 };
 
 class MixDifferenceOperation : public MixBaseOperation {
  public:
   MixDifferenceOperation();
   void executePixelSampled(float output[4], float x, float y, PixelSampler sampler);
+  void update_memory_buffer(MemoryBuffer *output, const rcti *area, MemoryBuffer **inputs);
 };
 
 class MixDivideOperation : public MixBaseOperation {
  public:
   MixDivideOperation();
   void executePixelSampled(float output[4], float x, float y, PixelSampler sampler);
+  void update_memory_buffer(MemoryBuffer *output, const rcti *area, MemoryBuffer **inputs);
 };
 
 class MixDodgeOperation : public MixBaseOperation {
@@ -144,6 +163,7 @@ class MixLightenOperation : public MixBaseOperation {
  public:
   MixLightenOperation();
   void executePixelSampled(float output[4], float x, float y, PixelSampler sampler);
+  void update_memory_buffer(MemoryBuffer *output, const rcti *area, MemoryBuffer **inputs);
 };
 
 class MixLinearLightOperation : public MixBaseOperation {
@@ -156,6 +176,7 @@ class MixMultiplyOperation : public MixBaseOperation {
  public:
   MixMultiplyOperation();
   void executePixelSampled(float output[4], float x, float y, PixelSampler sampler);
+  void update_memory_buffer(MemoryBuffer *output, const rcti *area, MemoryBuffer **inputs);
 };
 
 class MixOverlayOperation : public MixBaseOperation {
@@ -174,6 +195,7 @@ class MixScreenOperation : public MixBaseOperation {
  public:
   MixScreenOperation();
   void executePixelSampled(float output[4], float x, float y, PixelSampler sampler);
+  void update_memory_buffer(MemoryBuffer *output, const rcti *area, MemoryBuffer **inputs);
 };
 
 class MixSoftLightOperation : public MixBaseOperation {
@@ -186,6 +208,7 @@ class MixSubtractOperation : public MixBaseOperation {
  public:
   MixSubtractOperation();
   void executePixelSampled(float output[4], float x, float y, PixelSampler sampler);
+  void update_memory_buffer(MemoryBuffer *output, const rcti *area, MemoryBuffer **inputs);
 };
 
 class MixValueOperation : public MixBaseOperation {
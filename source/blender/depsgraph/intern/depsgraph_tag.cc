@@ -47,6 +47,7 @@ extern "C" {
 #include "BKE_animsys.h"
 #include "BKE_global.h"
 #include "BKE_idcode.h"
+#include "BKE_lib_id.h"
 #include "BKE_node.h"
 #include "BKE_scene.h"
 #include "BKE_workspace.h"
@@ -656,6 +657,9 @@ void graph_id_tag_update(
    * changes). */
   if (update_source == DEG_UPDATE_SOURCE_USER_EDIT) {
     id->recalc |= deg_recalc_flags_effective(graph, flag);
+    /* Also accumulated regardless of the dependency graph being active, so the undo system knows
+     * which IDs are untouched since the last undo push. */
+    BKE_lib_id_tag_undo_push(id, deg_recalc_flags_effective(nullptr, flag));
   }
   int current_flag = flag;
   while (current_flag != 0) {
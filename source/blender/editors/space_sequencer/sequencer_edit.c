@@ -2050,6 +2050,7 @@ static int sequencer_refresh_all_exec(bContext *C, wmOperator *UNUSED(op))
   Editing *ed = BKE_sequencer_editing_get(scene, false);
 
   BKE_sequencer_free_imbuf(scene, &ed->seqbase, false);
+  BKE_sequencer_cache_cleanup_disk(scene);
 
   WM_event_add_notifier(C, NC_SCENE | ND_SEQUENCER, scene);
 
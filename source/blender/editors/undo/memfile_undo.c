@@ -20,6 +20,7 @@
  * Wrapper between 'ED_undo.h' and 'BKE_undo_system.h' API's.
  */
 
+#include "BLI_listbase.h"
 #include "BLI_utildefines.h"
 #include "BLI_sys_types.h"
 
@@ -88,13 +89,33 @@ static bool memfile_undosys_step_encode(struct bContext *UNUSED(C),
   return true;
 }
 
+/**
+ * The undo data matching the current state of \a bmain, if it's still in the undo stack.
+ */
+static const MemFileUndoData *memfile_undosys_step_find_by_serial(const Main *bmain)
+{
+  if (bmain->memfile_undo_serial == 0) {
+    return NULL;
+  }
+  UndoStack *ustack = ED_undo_stack_get();
+  LISTBASE_FOREACH (UndoStep *, us_iter, &ustack->steps) {
+    if (us_iter->type == BKE_UNDOSYS_TYPE_MEMFILE) {
+      const MemFileUndoData *data = ((MemFileUndoStep *)us_iter)->data;
+      if (data != NULL && data->memfile.serial == bmain->memfile_undo_serial) {
+        return data;
+      }
+    }
+  }
+  return NULL;
+}
+
 static void memfile_undosys_step_decode(
     struct bContext *C, struct Main *bmain, UndoStep *us_p, int UNUSED(dir), bool UNUSED(is_final))
 {
   ED_editors_exit(bmain, false);
 
   MemFileUndoStep *us = (MemFileUndoStep *)us_p;
-  BKE_memfile_undo_decode(us->data, C);
+  BKE_memfile_undo_decode(us->data, memfile_undosys_step_find_by_serial(bmain), C);
 
   for (UndoStep *us_iter = us_p->next; us_iter; us_iter = us_iter->next) {
     if (BKE_UNDOSYS_TYPE_IS_MEMFILE_SKIP(us_iter->type)) {
@@ -164,6 +164,13 @@ struct ImBuf *IMB_allocFromBuffer(const unsigned int *rect,
 void IMB_refImBuf(struct ImBuf *ibuf);
 struct ImBuf *IMB_makeSingleUser(struct ImBuf *ibuf);
 
+/**
+ * Give the buffer a new change_id, after its pixels were modified.
+ *
+ * \attention Defined in allocimbuf.c
+ */
+void IMB_mark_changed(struct ImBuf *ibuf);
+
 /**
  *
  * \attention Defined in allocimbuf.c
@@ -450,6 +457,26 @@ bool IMB_scaleImBuf(struct ImBuf *ibuf, unsigned int newx, unsigned int newy);
  */
 bool IMB_scalefastImBuf(struct ImBuf *ibuf, unsigned int newx, unsigned int newy);
 
+typedef enum IMB_ScaleFilter {
+  /** Nearest pixel when scaling up, average of the covered pixels when scaling down. */
+  IMB_SCALE_FILTER_BOX = 0,
+  IMB_SCALE_FILTER_BILINEAR = 1,
+  /** Catmull-Rom spline, sharper than bilinear. */
+  IMB_SCALE_FILTER_BICUBIC = 2,
+  /** Lanczos with 3 lobes, sharpest, may ring around edges. */
+  IMB_SCALE_FILTER_LANCZOS = 3,
+} IMB_ScaleFilter;
+
+/**
+ * Separable and multi-threaded scaling of the byte and float buffers with \a filter.
+ *
+ * \attention Defined in scaling.c
+ */
+bool IMB_scaleImBuf_filter(struct ImBuf *ibuf,
+                           unsigned int newx,
+                           unsigned int newy,
+                           IMB_ScaleFilter filter);
+
 /**
  *
  * \attention Defined in scaling.c
@@ -237,6 +237,9 @@ typedef struct ImBuf {
   int index;
   /** used to set imbuf to dirty and other stuff */
   int userflags;
+  /** unique among all buffers, changed when the pixels are allocated or modified, caches can
+   * compare it instead of buffer pointers which get reused (see IMB_mark_changed) */
+  unsigned int change_id;
   /** image metadata */
   struct IDProperty *metadata;
   /** temporary storage */
@@ -41,8 +41,13 @@
 #include "BLI_utildefines.h"
 #include "BLI_threads.h"
 
+#include "atomic_ops.h"
+
 static SpinLock refcounter_spin;
 
+/* Last change_id given to a buffer. */
+static uint32_t last_change_id = 0;
+
 void imb_refcounter_lock_init(void)
 {
   BLI_spin_init(&refcounter_spin);
@@ -243,6 +248,11 @@ void IMB_refImBuf(ImBuf *ibuf)
   BLI_spin_unlock(&refcounter_spin);
 }
 
+void IMB_mark_changed(ImBuf *ibuf)
+{
+  ibuf->change_id = atomic_add_and_fetch_uint32(&last_change_id, 1);
+}
+
 ImBuf *IMB_makeSingleUser(ImBuf *ibuf)
 {
   ImBuf *rval;
@@ -397,6 +407,7 @@ bool imb_addrectfloatImBuf(ImBuf *ibuf)
   if ((ibuf->rect_float = imb_alloc_pixels(ibuf->x, ibuf->y, 4, sizeof(float), __func__))) {
     ibuf->mall |= IB_rectfloat;
     ibuf->flags |= IB_rectfloat;
+    IMB_mark_changed(ibuf);
     return true;
   }
 
@@ -420,6 +431,7 @@ bool imb_addrectImBuf(ImBuf *ibuf)
   if ((ibuf->rect = imb_alloc_pixels(ibuf->x, ibuf->y, 4, sizeof(unsigned char), __func__))) {
     ibuf->mall |= IB_rect;
     ibuf->flags |= IB_rect;
+    IMB_mark_changed(ibuf);
     if (ibuf->planes > 32) {
       return (addzbufImBuf(ibuf));
     }
@@ -507,6 +519,7 @@ bool IMB_initImBuf(
   ibuf->channels = 4;
   /* IMB_DPI_DEFAULT -> pixels-per-meter. */
   ibuf->ppm[0] = ibuf->ppm[1] = IMB_DPI_DEFAULT / 0.0254f;
+  IMB_mark_changed(ibuf);
 
   if (flags & IB_rect) {
     if (imb_addrectImBuf(ibuf) == false) {
@@ -606,6 +619,7 @@ ImBuf *IMB_dupImBuf(const ImBuf *ibuf1)
   tbuf.encodedbuffer = ibuf2->encodedbuffer;
   tbuf.zbuf = ibuf2->zbuf;
   tbuf.zbuf_float = ibuf2->zbuf_float;
+  tbuf.change_id = ibuf2->change_id;
   for (a = 0; a < IMB_MIPMAP_LEVELS; a++) {
     tbuf.mipmap[a] = NULL;
   }
@@ -46,6 +46,7 @@
 #include "BLI_math.h"
 #include "BLI_math_color.h"
 #include "BLI_string.h"
+#include "BLI_task.h"
 #include "BLI_threads.h"
 #include "BLI_rect.h"
 
@@ -60,6 +61,10 @@
 
 #include <ocio_capi.h>
 
+#ifdef __SSE2__
+#  include <emmintrin.h>
+#endif
+
 /*********************** Global declarations *************************/
 
 #define DISPLAY_BUFFER_CHANNELS 4
@@ -101,8 +106,37 @@ typedef struct ColormanageProcessor {
   OCIO_ConstProcessorRcPtr *processor;
   CurveMapping *curve_mapping;
   bool is_data_result;
+
+  /* Processor is owned by the display processor cache, which counts its users. */
+  bool is_cached;
+  int users;
 } ColormanageProcessor;
 
+/* Display processors are cached, so drawing every image or sequencer frame with the same
+ * view settings doesn't create a new OCIO processor. */
+#define DISPLAY_PROCESSOR_CACHE_SIZE 8
+
+typedef struct DisplayProcessorCacheItem {
+  ColormanageProcessor *cm_processor;
+
+  /* Settings of processor for comparison. */
+  char look[MAX_COLORSPACE_NAME];
+  char view[MAX_COLORSPACE_NAME];
+  char display[MAX_COLORSPACE_NAME];
+  float exposure, gamma;
+  const CurveMapping *curve_mapping;
+  int curve_mapping_timestamp;
+
+  int last_used;
+} DisplayProcessorCacheItem;
+
+static struct global_display_processor_cache {
+  DisplayProcessorCacheItem items[DISPLAY_PROCESSOR_CACHE_SIZE];
+  int timestamp;
+} global_display_processor_cache = {{{NULL}}};
+
+static pthread_mutex_t display_processor_cache_lock = BLI_MUTEX_INITIALIZER;
+
 static struct global_glsl_state {
   /* Actual processor used for GLSL baked LUTs. */
   /* UI colorspace here refers to the display linear color space,
@@ -646,6 +680,46 @@ static void colormanage_free_config(void)
   OCIO_exit();
 }
 
+static void colormanage_processor_release(ColormanageProcessor *cm_processor)
+{
+  if (cm_processor->curve_mapping) {
+    BKE_curvemapping_free(cm_processor->curve_mapping);
+  }
+  if (cm_processor->processor) {
+    OCIO_processorRelease(cm_processor->processor);
+  }
+
+  MEM_freeN(cm_processor);
+}
+
+/* Remove the cache's reference to the processor, it's freed once no one else uses it. */
+static void display_processor_cache_item_free(DisplayProcessorCacheItem *item)
+{
+  ColormanageProcessor *cm_processor = item->cm_processor;
+
+  if (--cm_processor->users == 0) {
+    colormanage_processor_release(cm_processor);
+  }
+
+  memset(item, 0, sizeof(*item));
+}
+
+static void display_processor_cache_free(void)
+{
+  BLI_mutex_lock(&display_processor_cache_lock);
+
+  for (int i = 0; i < DISPLAY_PROCESSOR_CACHE_SIZE; i++) {
+    DisplayProcessorCacheItem *item = &global_display_processor_cache.items[i];
+
+    if (item->cm_processor) {
+      display_processor_cache_item_free(item);
+    }
+  }
+  global_display_processor_cache.timestamp = 0;
+
+  BLI_mutex_unlock(&display_processor_cache_lock);
+}
+
 void colormanagement_init(void)
 {
   const char *ocio_env;
@@ -746,6 +820,8 @@ void colormanagement_exit(void)
   memset(&global_glsl_state, 0, sizeof(global_glsl_state));
   memset(&global_color_picking_state, 0, sizeof(global_color_picking_state));
 
+  display_processor_cache_free();
+
   colormanage_free_config();
 }
 
@@ -1119,6 +1195,133 @@ void colormanage_imbuf_make_linear(ImBuf *ibuf, const char *from_colorspace)
   }
 }
 
+/* Divide color by alpha the same way as OCIO_processorApplyRGBA_predivide, so the processor can
+ * be applied to the whole buffer at once instead of pixel by pixel. */
+static void colormanage_buffer_unpremultiply(float *buffer, size_t num_pixels)
+{
+  float *fp = buffer;
+  size_t i = 0;
+
+#ifdef __SSE2__
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 one = _mm_set1_ps(1.0f);
+  const __m128 rgb_mask = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+  const __m128 alpha_one = _mm_set_ps(1.0f, 0.0f, 0.0f, 0.0f);
+
+  for (; i < num_pixels; i++, fp += 4) {
+    const __m128 pixel = _mm_loadu_ps(fp);
+    const __m128 alpha = _mm_shuffle_ps(pixel, pixel, _MM_SHUFFLE(3, 3, 3, 3));
+    const __m128 valid = _mm_cmpneq_ps(alpha, zero);
+    __m128 alpha_inv = _mm_div_ps(one, alpha);
+    alpha_inv = _mm_or_ps(_mm_and_ps(valid, alpha_inv), _mm_andnot_ps(valid, one));
+    alpha_inv = _mm_or_ps(_mm_and_ps(rgb_mask, alpha_inv), alpha_one);
+    _mm_storeu_ps(fp, _mm_mul_ps(pixel, alpha_inv));
+  }
+#endif
+
+  for (; i < num_pixels; i++, fp += 4) {
+    if (fp[3] != 0.0f && fp[3] != 1.0f) {
+      const float alpha_inv = 1.0f / fp[3];
+      mul_v3_fl(fp, alpha_inv);
+    }
+  }
+}
+
+static void colormanage_buffer_premultiply(float *buffer, size_t num_pixels)
+{
+  float *fp = buffer;
+  size_t i = 0;
+
+#ifdef __SSE2__
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 one = _mm_set1_ps(1.0f);
+  const __m128 rgb_mask = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+  const __m128 alpha_one = _mm_set_ps(1.0f, 0.0f, 0.0f, 0.0f);
+
+  for (; i < num_pixels; i++, fp += 4) {
+    const __m128 pixel = _mm_loadu_ps(fp);
+    const __m128 alpha = _mm_shuffle_ps(pixel, pixel, _MM_SHUFFLE(3, 3, 3, 3));
+    const __m128 valid = _mm_cmpneq_ps(alpha, zero);
+    __m128 factor = _mm_or_ps(_mm_and_ps(valid, alpha), _mm_andnot_ps(valid, one));
+    factor = _mm_or_ps(_mm_and_ps(rgb_mask, factor), alpha_one);
+    _mm_storeu_ps(fp, _mm_mul_ps(pixel, factor));
+  }
+#endif
+
+  for (; i < num_pixels; i++, fp += 4) {
+    if (fp[3] != 0.0f && fp[3] != 1.0f) {
+      mul_v3_fl(fp, fp[3]);
+    }
+  }
+}
+
+/* When keep_straight is set, predivided buffers are left with straight alpha after applying the
+ * processor, saving the multiplication for callers which need straight alpha anyway. */
+static void colormanage_processor_apply_ex(ColormanageProcessor *cm_processor,
+                                           float *buffer,
+                                           int width,
+                                           int height,
+                                           int channels,
+                                           bool predivide,
+                                           bool keep_straight)
+{
+  /* apply curve mapping */
+  if (cm_processor->curve_mapping) {
+    int x, y;
+
+    for (y = 0; y < height; y++) {
+      for (x = 0; x < width; x++) {
+        float *pixel = buffer + channels * (((size_t)y) * width + x);
+
+        curve_mapping_apply_pixel(cm_processor->curve_mapping, pixel, channels);
+      }
+    }
+  }
+
+  if (predivide && channels == 4 && (cm_processor->processor || keep_straight)) {
+    const size_t num_pixels = ((size_t)width) * height;
+
+    colormanage_buffer_unpremultiply(buffer, num_pixels);
+
+    if (cm_processor->processor) {
+      OCIO_PackedImageDesc *img = OCIO_createOCIO_PackedImageDesc(buffer,
+                                                                  width,
+                                                                  height,
+                                                                  channels,
+                                                                  sizeof(float),
+                                                                  4 * sizeof(float),
+                                                                  4 * sizeof(float) * width);
+      OCIO_processorApply(cm_processor->processor, img);
+      OCIO_PackedImageDescRelease(img);
+    }
+
+    if (!keep_straight) {
+      colormanage_buffer_premultiply(buffer, num_pixels);
+    }
+  }
+  else if (cm_processor->processor && channels >= 3) {
+    OCIO_PackedImageDesc *img;
+
+    /* apply OCIO processor */
+    img = OCIO_createOCIO_PackedImageDesc(buffer,
+                                          width,
+                                          height,
+                                          channels,
+                                          sizeof(float),
+                                          (size_t)channels * sizeof(float),
+                                          (size_t)channels * sizeof(float) * width);
+
+    if (predivide) {
+      OCIO_processorApply_predivide(cm_processor->processor, img);
+    }
+    else {
+      OCIO_processorApply(cm_processor->processor, img);
+    }
+
+    OCIO_PackedImageDescRelease(img);
+  }
+}
+
 /*********************** Generic functions *************************/
 
 static void colormanage_check_display_settings(ColorManagedDisplaySettings *display_settings,
@@ -1441,6 +1644,28 @@ bool IMB_colormanagement_space_name_is_data(const char *name)
 
 /*********************** Threaded display buffer transform routines *************************/
 
+/* Buffers are transformed in tiles of rows, small enough for the intermediate float buffer of
+ * a tile to stay in cache between the processor and the byte conversion. */
+#define COLORMANAGE_TILE_PIXELS 65536
+
+static int colormanage_tile_rows(int width)
+{
+  return max_ii(1, COLORMANAGE_TILE_PIXELS / max_ii(1, width));
+}
+
+static void colormanage_tiles_apply(int height,
+                                    int tile_rows,
+                                    void *userdata,
+                                    TaskParallelRangeFunc func)
+{
+  const int tot_tiles = (height + tile_rows - 1) / tile_rows;
+  TaskParallelSettings settings;
+
+  BLI_parallel_range_settings_defaults(&settings);
+  settings.use_threading = (tot_tiles > 1);
+  BLI_task_parallel_range(0, tot_tiles, userdata, func, &settings);
+}
+
 typedef struct DisplayBufferThread {
   ColormanageProcessor *cm_processor;
 
@@ -1476,6 +1701,8 @@ typedef struct DisplayBufferInitData {
 
   const char *byte_colorspace;
   const char *float_colorspace;
+
+  int tile_rows;
 } DisplayBufferInitData;
 
 static void display_buffer_init_handle(void *handle_v,
@@ -1607,6 +1834,49 @@ static void display_buffer_apply_get_linear_buffer(DisplayBufferThread *handle,
   }
 }
 
+/* Same as IMB_buffer_byte_from_float for RGBA buffers without dither and color space
+ * conversion, which is what most display buffers are converted with. */
+static void display_buffer_byte_from_float_rgba(unsigned char *byte_buffer,
+                                                const float *buffer,
+                                                size_t num_pixels,
+                                                bool predivide)
+{
+  const float *fp = buffer;
+  unsigned char *cp = byte_buffer;
+  size_t i = 0;
+
+#ifdef __SSE2__
+  if (!predivide) {
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 scale = _mm_set1_ps(255.0f);
+    const __m128 half = _mm_set1_ps(0.5f);
+
+    for (; i + 4 <= num_pixels; i += 4, fp += 16, cp += 16) {
+      __m128i c[4];
+
+      for (int j = 0; j < 4; j++) {
+        __m128 v = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(fp + 4 * j), scale), half);
+        v = _mm_min_ps(_mm_max_ps(v, zero), scale);
+        c[j] = _mm_cvttps_epi32(v);
+      }
+
+      const __m128i c01 = _mm_packs_epi32(c[0], c[1]);
+      const __m128i c23 = _mm_packs_epi32(c[2], c[3]);
+      _mm_storeu_si128((__m128i *)cp, _mm_packus_epi16(c01, c23));
+    }
+  }
+#endif
+
+  for (; i < num_pixels; i++, fp += 4, cp += 4) {
+    if (predivide) {
+      premul_float_to_straight_uchar(cp, fp);
+    }
+    else {
+      rgba_float_to_uchar(cp, fp);
+    }
+  }
+}
+
 static void *do_display_buffer_apply_thread(void *handle_v)
 {
   DisplayBufferThread *handle = (DisplayBufferThread *)handle_v;
@@ -1659,13 +1929,24 @@ static void *do_display_buffer_apply_thread(void *handle_v)
        */
     }
     else {
-      /* apply processor */
-      IMB_colormanagement_processor_apply(
-          cm_processor, linear_buffer, width, height, channels, predivide);
+      /* apply processor, when only bytes are needed keep the result in straight alpha
+       * instead of multiplying and dividing it again */
+      const bool keep_straight = predivide && channels == 4 && display_buffer == NULL;
+
+      colormanage_processor_apply_ex(
+          cm_processor, linear_buffer, width, height, channels, predivide, keep_straight);
+
+      if (keep_straight) {
+        predivide = false;
+      }
     }
 
     /* copy result to output buffers */
-    if (display_buffer_byte) {
+    if (display_buffer_byte && channels == 4 && dither == 0.0f) {
+      display_buffer_byte_from_float_rgba(
+          display_buffer_byte, linear_buffer, ((size_t)width) * height, predivide);
+    }
+    else if (display_buffer_byte) {
       /* do conversion */
       IMB_buffer_byte_from_float(display_buffer_byte,
                                  linear_buffer,
@@ -1700,6 +1981,19 @@ static void *do_display_buffer_apply_thread(void *handle_v)
   return NULL;
 }
 
+static void display_buffer_apply_tile(void *__restrict userdata,
+                                      const int tile,
+                                      const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  DisplayBufferInitData *init_data = (DisplayBufferInitData *)userdata;
+  DisplayBufferThread handle;
+  const int start_line = tile * init_data->tile_rows;
+  const int tot_line = min_ii(init_data->tile_rows, init_data->ibuf->y - start_line);
+
+  display_buffer_init_handle(&handle, start_line, tot_line, init_data);
+  do_display_buffer_apply_thread(&handle);
+}
+
 static void display_buffer_apply_threaded(ImBuf *ibuf,
                                           float *buffer,
                                           unsigned char *byte_buffer,
@@ -1734,11 +2028,9 @@ static void display_buffer_apply_threaded(ImBuf *ibuf,
     init_data.float_colorspace = NULL;
   }
 
-  IMB_processor_apply_threaded(ibuf->y,
-                               sizeof(DisplayBufferThread),
-                               &init_data,
-                               display_buffer_init_handle,
-                               do_display_buffer_apply_thread);
+  init_data.tile_rows = colormanage_tile_rows(ibuf->x);
+
+  colormanage_tiles_apply(ibuf->y, init_data.tile_rows, &init_data, display_buffer_apply_tile);
 }
 
 static bool is_ibuf_rect_in_display_space(ImBuf *ibuf,
@@ -1830,6 +2122,7 @@ typedef struct ProcessorTransformInit {
   int channels;
   bool predivide;
   bool float_from_byte;
+  int tile_rows;
 } ProcessorTransformInitData;
 
 static void processor_transform_init_handle(void *handle_v,
@@ -1908,6 +2201,19 @@ static void *do_processor_transform_thread(void *handle_v)
   return NULL;
 }
 
+static void processor_transform_apply_tile(void *__restrict userdata,
+                                           const int tile,
+                                           const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  ProcessorTransformInitData *init_data = (ProcessorTransformInitData *)userdata;
+  ProcessorTransformThread handle;
+  const int start_line = tile * init_data->tile_rows;
+  const int tot_line = min_ii(init_data->tile_rows, init_data->height - start_line);
+
+  processor_transform_init_handle(&handle, start_line, tot_line, init_data);
+  do_processor_transform_thread(&handle);
+}
+
 static void processor_transform_apply_threaded(unsigned char *byte_buffer,
                                                float *float_buffer,
                                                const int width,
@@ -1928,11 +2234,9 @@ static void processor_transform_apply_threaded(unsigned char *byte_buffer,
   init_data.predivide = predivide;
   init_data.float_from_byte = float_from_byte;
 
-  IMB_processor_apply_threaded(height,
-                               sizeof(ProcessorTransformThread),
-                               &init_data,
-                               processor_transform_init_handle,
-                               do_processor_transform_thread);
+  init_data.tile_rows = colormanage_tile_rows(width);
+
+  colormanage_tiles_apply(height, init_data.tile_rows, &init_data, processor_transform_apply_tile);
 }
 
 /*********************** Color space transformation functions *************************/
@@ -3732,17 +4036,60 @@ void IMB_partial_display_buffer_update_delayed(ImBuf *ibuf, int xmin, int ymin,
 
 /*********************** Pixel processor functions *************************/
 
-ColormanageProcessor *IMB_colormanagement_display_processor_new(
+static bool display_processor_cache_item_matches(const DisplayProcessorCacheItem *item,
+                                                 const ColorManagedViewSettings *view_settings,
+                                                 const ColorManagedDisplaySettings *display_settings,
+                                                 const CurveMapping *curve_mapping)
+{
+  return (item->exposure == view_settings->exposure && item->gamma == view_settings->gamma &&
+          STREQ(item->look, view_settings->look) &&
+          STREQ(item->view, view_settings->view_transform) &&
+          STREQ(item->display, display_settings->display_device) &&
+          item->curve_mapping == curve_mapping &&
+          (curve_mapping == NULL ||
+           item->curve_mapping_timestamp == curve_mapping->changed_timestamp));
+}
+
+static ColormanageProcessor *display_processor_create(
     const ColorManagedViewSettings *view_settings,
     const ColorManagedDisplaySettings *display_settings)
 {
   ColormanageProcessor *cm_processor;
-  ColorManagedViewSettings default_view_settings;
-  const ColorManagedViewSettings *applied_view_settings;
   ColorSpace *display_space;
 
   cm_processor = MEM_callocN(sizeof(ColormanageProcessor), "colormanagement processor");
 
+  display_space = display_transform_get_colorspace(view_settings, display_settings);
+  if (display_space) {
+    cm_processor->is_data_result = display_space->is_data;
+  }
+
+  cm_processor->processor = create_display_buffer_processor(view_settings->look,
+                                                            view_settings->view_transform,
+                                                            display_settings->display_device,
+                                                            view_settings->exposure,
+                                                            view_settings->gamma,
+                                                            global_role_scene_linear,
+                                                            false);
+
+  if (view_settings->flag & COLORMANAGE_VIEW_USE_CURVES) {
+    cm_processor->curve_mapping = BKE_curvemapping_copy(view_settings->curve_mapping);
+    BKE_curvemapping_premultiply(cm_processor->curve_mapping, false);
+  }
+
+  return cm_processor;
+}
+
+ColormanageProcessor *IMB_colormanagement_display_processor_new(
+    const ColorManagedViewSettings *view_settings,
+    const ColorManagedDisplaySettings *display_settings)
+{
+  ColormanageProcessor *cm_processor;
+  ColorManagedViewSettings default_view_settings;
+  const ColorManagedViewSettings *applied_view_settings;
+  const CurveMapping *curve_mapping = NULL;
+  DisplayProcessorCacheItem *item = NULL;
+
   if (view_settings) {
     applied_view_settings = view_settings;
   }
@@ -3751,24 +4098,59 @@ ColormanageProcessor *IMB_colormanagement_display_processor_new(
     applied_view_settings = &default_view_settings;
   }
 
-  display_space = display_transform_get_colorspace(applied_view_settings, display_settings);
-  if (display_space) {
-    cm_processor->is_data_result = display_space->is_data;
+  if (applied_view_settings->flag & COLORMANAGE_VIEW_USE_CURVES) {
+    curve_mapping = applied_view_settings->curve_mapping;
   }
 
-  cm_processor->processor = create_display_buffer_processor(applied_view_settings->look,
-                                                            applied_view_settings->view_transform,
-                                                            display_settings->display_device,
-                                                            applied_view_settings->exposure,
-                                                            applied_view_settings->gamma,
-                                                            global_role_scene_linear,
-                                                            false);
+  BLI_mutex_lock(&display_processor_cache_lock);
 
-  if (applied_view_settings->flag & COLORMANAGE_VIEW_USE_CURVES) {
-    cm_processor->curve_mapping = BKE_curvemapping_copy(applied_view_settings->curve_mapping);
-    BKE_curvemapping_premultiply(cm_processor->curve_mapping, false);
+  for (int i = 0; i < DISPLAY_PROCESSOR_CACHE_SIZE; i++) {
+    DisplayProcessorCacheItem *cache_item = &global_display_processor_cache.items[i];
+
+    if (cache_item->cm_processor &&
+        display_processor_cache_item_matches(
+            cache_item, applied_view_settings, display_settings, curve_mapping)) {
+      item = cache_item;
+      break;
+    }
+  }
+
+  if (item == NULL) {
+    /* Use an empty slot, or replace the least recently used processor. */
+    item = &global_display_processor_cache.items[0];
+
+    for (int i = 0; i < DISPLAY_PROCESSOR_CACHE_SIZE && item->cm_processor; i++) {
+      DisplayProcessorCacheItem *cache_item = &global_display_processor_cache.items[i];
+
+      if (cache_item->cm_processor == NULL || cache_item->last_used < item->last_used) {
+        item = cache_item;
+      }
+    }
+
+    if (item->cm_processor) {
+      display_processor_cache_item_free(item);
+    }
+
+    item->cm_processor = display_processor_create(applied_view_settings, display_settings);
+    item->cm_processor->is_cached = true;
+    item->cm_processor->users = 1;
+
+    BLI_strncpy(item->look, applied_view_settings->look, sizeof(item->look));
+    BLI_strncpy(item->view, applied_view_settings->view_transform, sizeof(item->view));
+    BLI_strncpy(item->display, display_settings->display_device, sizeof(item->display));
+    item->exposure = applied_view_settings->exposure;
+    item->gamma = applied_view_settings->gamma;
+    item->curve_mapping = curve_mapping;
+    item->curve_mapping_timestamp = curve_mapping ? curve_mapping->changed_timestamp : 0;
   }
 
+  item->last_used = ++global_display_processor_cache.timestamp;
+
+  cm_processor = item->cm_processor;
+  cm_processor->users++;
+
+  BLI_mutex_unlock(&display_processor_cache_lock);
+
   return cm_processor;
 }
 
@@ -3850,40 +4232,7 @@ void IMB_colormanagement_processor_apply(ColormanageProcessor *cm_processor,
                                          int channels,
                                          bool predivide)
 {
-  /* apply curve mapping */
-  if (cm_processor->curve_mapping) {
-    int x, y;
-
-    for (y = 0; y < height; y++) {
-      for (x = 0; x < width; x++) {
-        float *pixel = buffer + channels * (((size_t)y) * width + x);
-
-        curve_mapping_apply_pixel(cm_processor->curve_mapping, pixel, channels);
-      }
-    }
-  }
-
-  if (cm_processor->processor && channels >= 3) {
-    OCIO_PackedImageDesc *img;
-
-    /* apply OCIO processor */
-    img = OCIO_createOCIO_PackedImageDesc(buffer,
-                                          width,
-                                          height,
-                                          channels,
-                                          sizeof(float),
-                                          (size_t)channels * sizeof(float),
-                                          (size_t)channels * sizeof(float) * width);
-
-    if (predivide) {
-      OCIO_processorApply_predivide(cm_processor->processor, img);
-    }
-    else {
-      OCIO_processorApply(cm_processor->processor, img);
-    }
-
-    OCIO_PackedImageDescRelease(img);
-  }
+  colormanage_processor_apply_ex(cm_processor, buffer, width, height, channels, predivide, false);
 }
 
 void IMB_colormanagement_processor_apply_byte(
@@ -3906,14 +4255,19 @@ void IMB_colormanagement_processor_apply_byte(
 
 void IMB_colormanagement_processor_free(ColormanageProcessor *cm_processor)
 {
-  if (cm_processor->curve_mapping) {
-    BKE_curvemapping_free(cm_processor->curve_mapping);
-  }
-  if (cm_processor->processor) {
-    OCIO_processorRelease(cm_processor->processor);
+  if (cm_processor->is_cached) {
+    bool is_unused;
+
+    BLI_mutex_lock(&display_processor_cache_lock);
+    is_unused = (--cm_processor->users == 0);
+    BLI_mutex_unlock(&display_processor_cache_lock);
+
+    if (!is_unused) {
+      return;
+    }
   }
 
-  MEM_freeN(cm_processor);
+  colormanage_processor_release(cm_processor);
 }
 
 /* **** OpenGL drawing routines using GLSL for color space transform ***** */
@@ -22,11 +22,21 @@
  * \ingroup imbuf
  */
 
+#include <math.h>
+#include <string.h>
+
 #include "BLI_utildefines.h"
+#include "BLI_math_base.h"
 #include "BLI_math_color.h"
 #include "BLI_math_interp.h"
+#include "BLI_math_vector.h"
+#include "BLI_task.h"
 #include "MEM_guardedalloc.h"
 
+#ifdef __SSE2__
+#  include <emmintrin.h>
+#endif
+
 #include "imbuf.h"
 #include "IMB_imbuf_types.h"
 #include "IMB_imbuf.h"
@@ -906,646 +916,508 @@ static bool q_scale_linear_interpolation(struct ImBuf *ibuf, int newx, int newy)
   return true;
 }
 
-static ImBuf *scaledownx(struct ImBuf *ibuf, int newx)
-{
-  const int do_rect = (ibuf->rect != NULL);
-  const int do_float = (ibuf->rect_float != NULL);
-  const size_t rect_size = ibuf->x * ibuf->y * 4;
-
-  uchar *rect, *_newrect, *newrect;
-  float *rectf, *_newrectf, *newrectf;
-  float sample, add, val[4], nval[4], valf[4], nvalf[4];
-  int x, y;
+/* ******** filtered scaling ******** */
 
-  rectf = _newrectf = newrectf = NULL;
-  rect = _newrect = newrect = NULL;
-  nval[0] = nval[1] = nval[2] = nval[3] = 0.0f;
-  nvalf[0] = nvalf[1] = nvalf[2] = nvalf[3] = 0.0f;
+/* Separable resampling: the image is first filtered along x into a float buffer, then along y.
+ * Each destination pixel is the normalized weighted sum of the source pixels in the support of
+ * the filter, which is widened by the scale factor when downscaling so all source pixels
+ * contribute. Box weights are the covered area of the source pixels then, so the result is the
+ * average of the covered area. Axes which don't change size are skipped.
+ *
+ * #IMB_scaleImBuf matches the previous scaling code: it averages the covered area when scaling
+ * down and interpolates between the first and last pixels (instead of pixel centers) when
+ * scaling up.
+ *
+ * Byte images are filtered with straight alpha like the previous scaling code, so the color of
+ * transparent pixels is kept (channel packed images for example). */
 
-  if (!do_rect && !do_float) {
-    return (ibuf);
-  }
+/** Number of rows filtered by a task. */
+#define SCALE_BLOCK_ROWS 16
 
-  if (do_rect) {
-    _newrect = MEM_mallocN(newx * ibuf->y * sizeof(uchar) * 4, "scaledownx");
-    if (_newrect == NULL) {
-      return (ibuf);
-    }
-  }
-  if (do_float) {
-    _newrectf = MEM_mallocN(newx * ibuf->y * sizeof(float) * 4, "scaledownxf");
-    if (_newrectf == NULL) {
-      if (_newrect) {
-        MEM_freeN(_newrect);
-      }
-      return (ibuf);
-    }
-  }
+static float scale_filter_box(float x)
+{
+  return (x >= -0.5f && x < 0.5f) ? 1.0f : 0.0f;
+}
 
-  add = (ibuf->x - 0.01) / newx;
+static float scale_filter_bilinear(float x)
+{
+  x = fabsf(x);
+  return (x < 1.0f) ? 1.0f - x : 0.0f;
+}
 
-  if (do_rect) {
-    rect = (uchar *)ibuf->rect;
-    newrect = _newrect;
+static float scale_filter_bicubic(float x)
+{
+  /* Catmull-Rom spline. */
+  const float a = -0.5f;
+  x = fabsf(x);
+  if (x < 1.0f) {
+    return ((a + 2.0f) * x - (a + 3.0f)) * x * x + 1.0f;
   }
-  if (do_float) {
-    rectf = ibuf->rect_float;
-    newrectf = _newrectf;
+  if (x < 2.0f) {
+    return (((x - 5.0f) * x + 8.0f) * x - 4.0f) * a;
   }
+  return 0.0f;
+}
 
-  for (y = ibuf->y; y > 0; y--) {
-    sample = 0.0f;
-    val[0] = val[1] = val[2] = val[3] = 0.0f;
-    valf[0] = valf[1] = valf[2] = valf[3] = 0.0f;
-
-    for (x = newx; x > 0; x--) {
-      if (do_rect) {
-        nval[0] = -val[0] * sample;
-        nval[1] = -val[1] * sample;
-        nval[2] = -val[2] * sample;
-        nval[3] = -val[3] * sample;
-      }
-      if (do_float) {
-        nvalf[0] = -valf[0] * sample;
-        nvalf[1] = -valf[1] * sample;
-        nvalf[2] = -valf[2] * sample;
-        nvalf[3] = -valf[3] * sample;
-      }
-
-      sample += add;
-
-      while (sample >= 1.0f) {
-        sample -= 1.0f;
-
-        if (do_rect) {
-          nval[0] += rect[0];
-          nval[1] += rect[1];
-          nval[2] += rect[2];
-          nval[3] += rect[3];
-          rect += 4;
-        }
-        if (do_float) {
-          nvalf[0] += rectf[0];
-          nvalf[1] += rectf[1];
-          nvalf[2] += rectf[2];
-          nvalf[3] += rectf[3];
-          rectf += 4;
-        }
-      }
-
-      if (do_rect) {
-        val[0] = rect[0];
-        val[1] = rect[1];
-        val[2] = rect[2];
-        val[3] = rect[3];
-        rect += 4;
-
-        newrect[0] = ((nval[0] + sample * val[0]) / add + 0.5f);
-        newrect[1] = ((nval[1] + sample * val[1]) / add + 0.5f);
-        newrect[2] = ((nval[2] + sample * val[2]) / add + 0.5f);
-        newrect[3] = ((nval[3] + sample * val[3]) / add + 0.5f);
-
-        newrect += 4;
-      }
-      if (do_float) {
-
-        valf[0] = rectf[0];
-        valf[1] = rectf[1];
-        valf[2] = rectf[2];
-        valf[3] = rectf[3];
-        rectf += 4;
+static float scale_sinc(float x)
+{
+  if (x == 0.0f) {
+    return 1.0f;
+  }
+  x *= (float)M_PI;
+  return sinf(x) / x;
+}
 
-        newrectf[0] = ((nvalf[0] + sample * valf[0]) / add);
-        newrectf[1] = ((nvalf[1] + sample * valf[1]) / add);
-        newrectf[2] = ((nvalf[2] + sample * valf[2]) / add);
-        newrectf[3] = ((nvalf[3] + sample * valf[3]) / add);
+static float scale_filter_lanczos(float x)
+{
+  /* Three lobes. */
+  if (x > -3.0f && x < 3.0f) {
+    return scale_sinc(x) * scale_sinc(x / 3.0f);
+  }
+  return 0.0f;
+}
 
-        newrectf += 4;
-      }
+typedef struct ScaleCoefficients {
+  /** First source pixel and number of source pixels of every destination pixel. */
+  int *bounds;
+  /** Normalized weights, #max_taps per destination pixel. */
+  float *weights;
+  int max_taps;
+} ScaleCoefficients;
 
-      sample -= 1.0f;
+/** Linear interpolation where the first and last pixels of both sizes are aligned. */
+static void scale_coefficients_init_corners(ScaleCoefficients *coeffs, int src_size, int dst_size)
+{
+  const float scale = (dst_size > 1) ? (float)(src_size - 1) / (float)(dst_size - 1) : 0.0f;
+
+  coeffs->max_taps = 2;
+  coeffs->bounds = MEM_mallocN(sizeof(int) * 2 * dst_size, __func__);
+  coeffs->weights = MEM_mallocN(sizeof(float) * coeffs->max_taps * dst_size, __func__);
+
+  for (int i = 0; i < dst_size; i++) {
+    const float position = (float)i * scale;
+    const int min = min_ii((int)position, src_size - 1);
+    const float factor = position - (float)min;
+    float *weights = coeffs->weights + i * coeffs->max_taps;
+
+    coeffs->bounds[i * 2] = min;
+    if (min + 1 < src_size && factor > 0.0f) {
+      weights[0] = 1.0f - factor;
+      weights[1] = factor;
+      coeffs->bounds[i * 2 + 1] = 2;
+    }
+    else {
+      weights[0] = 1.0f;
+      coeffs->bounds[i * 2 + 1] = 1;
     }
   }
-
-  if (do_rect) {
-    // printf("%ld %ld\n", (uchar *)rect - ((uchar *)ibuf->rect), rect_size);
-    BLI_assert((uchar *)rect - ((uchar *)ibuf->rect) == rect_size); /* see bug [#26502] */
-    imb_freerectImBuf(ibuf);
-    ibuf->mall |= IB_rect;
-    ibuf->rect = (unsigned int *)_newrect;
-  }
-  if (do_float) {
-    // printf("%ld %ld\n", rectf - ibuf->rect_float, rect_size);
-    BLI_assert((rectf - ibuf->rect_float) == rect_size); /* see bug [#26502] */
-    imb_freerectfloatImBuf(ibuf);
-    ibuf->mall |= IB_rectfloat;
-    ibuf->rect_float = _newrectf;
-  }
-  (void)rect_size; /* UNUSED in release builds */
-
-  ibuf->x = newx;
-  return (ibuf);
 }
 
-static ImBuf *scaledowny(struct ImBuf *ibuf, int newy)
+/** Area of the source pixel \a x covered by the destination pixel from \a min to \a max. */
+static float scale_box_coverage(int x, float min, float max)
 {
-  const int do_rect = (ibuf->rect != NULL);
-  const int do_float = (ibuf->rect_float != NULL);
-  const size_t rect_size = ibuf->x * ibuf->y * 4;
-
-  uchar *rect, *_newrect, *newrect;
-  float *rectf, *_newrectf, *newrectf;
-  float sample, add, val[4], nval[4], valf[4], nvalf[4];
-  int x, y, skipx;
-
-  rectf = _newrectf = newrectf = NULL;
-  rect = _newrect = newrect = NULL;
-  nval[0] = nval[1] = nval[2] = nval[3] = 0.0f;
-  nvalf[0] = nvalf[1] = nvalf[2] = nvalf[3] = 0.0f;
+  return max_ff(min_ff((float)(x + 1), max) - max_ff((float)x, min), 0.0f);
+}
 
-  if (!do_rect && !do_float) {
-    return (ibuf);
+/**
+ * \param keep_corners: Interpolate linearly between the first and last pixels when enlarging
+ * instead of using \a filter, like #IMB_scaleImBuf always did.
+ */
+static void scale_coefficients_init(ScaleCoefficients *coeffs,
+                                    int src_size,
+                                    int dst_size,
+                                    IMB_ScaleFilter filter,
+                                    bool keep_corners)
+{
+  if (keep_corners && dst_size > src_size) {
+    scale_coefficients_init_corners(coeffs, src_size, dst_size);
+    return;
   }
 
-  if (do_rect) {
-    _newrect = MEM_mallocN(newy * ibuf->x * sizeof(uchar) * 4, "scaledowny");
-    if (_newrect == NULL) {
-      return (ibuf);
-    }
-  }
-  if (do_float) {
-    _newrectf = MEM_mallocN(newy * ibuf->x * sizeof(float) * 4, "scaledownyf");
-    if (_newrectf == NULL) {
-      if (_newrect) {
-        MEM_freeN(_newrect);
+  float (*kernel)(float);
+  float support;
+
+  switch (filter) {
+    case IMB_SCALE_FILTER_BILINEAR:
+      kernel = scale_filter_bilinear;
+      support = 1.0f;
+      break;
+    case IMB_SCALE_FILTER_BICUBIC:
+      kernel = scale_filter_bicubic;
+      support = 2.0f;
+      break;
+    case IMB_SCALE_FILTER_LANCZOS:
+      kernel = scale_filter_lanczos;
+      support = 3.0f;
+      break;
+    case IMB_SCALE_FILTER_BOX:
+    default:
+      kernel = scale_filter_box;
+      support = 0.5f;
+      break;
+  }
+
+  const float scale = (float)src_size / (float)dst_size;
+  const float filterscale = max_ff(scale, 1.0f);
+  const float radius = support * filterscale;
+  /* Sampling the box at pixel centers would drop or fully count partly covered pixels. */
+  const bool use_coverage = (filter == IMB_SCALE_FILTER_BOX && scale > 1.0f);
+
+  coeffs->max_taps = (int)ceilf(radius) * 2 + 1;
+  coeffs->bounds = MEM_mallocN(sizeof(int) * 2 * dst_size, __func__);
+  coeffs->weights = MEM_mallocN(sizeof(float) * coeffs->max_taps * dst_size, __func__);
+
+  for (int i = 0; i < dst_size; i++) {
+    const float center = ((float)i + 0.5f) * scale;
+    const int min = max_ii((int)floorf(center - radius + (use_coverage ? 0.0f : 0.5f)), 0);
+    const int max = min_ii((int)floorf(center + radius + (use_coverage ? 1.0f : 0.5f)),
+                           src_size);
+    const int num = min_ii(max - min, coeffs->max_taps);
+    float *weights = coeffs->weights + i * coeffs->max_taps;
+    float total = 0.0f;
+
+    for (int k = 0; k < num; k++) {
+      if (use_coverage) {
+        weights[k] = scale_box_coverage(min + k, center - radius, center + radius);
+      }
+      else {
+        weights[k] = kernel(((float)(min + k) + 0.5f - center) / filterscale);
       }
-      return (ibuf);
+      total += weights[k];
     }
-  }
-
-  add = (ibuf->y - 0.01) / newy;
-  skipx = 4 * ibuf->x;
 
-  for (x = skipx - 4; x >= 0; x -= 4) {
-    if (do_rect) {
-      rect = ((uchar *)ibuf->rect) + x;
-      newrect = _newrect + x;
+    if (total != 0.0f) {
+      const float inv_total = 1.0f / total;
+      for (int k = 0; k < num; k++) {
+        weights[k] *= inv_total;
+      }
+      coeffs->bounds[i * 2] = min;
+      coeffs->bounds[i * 2 + 1] = num;
     }
-    if (do_float) {
-      rectf = ibuf->rect_float + x;
-      newrectf = _newrectf + x;
+    else {
+      /* Nearest pixel. */
+      weights[0] = 1.0f;
+      coeffs->bounds[i * 2] = min_ii((int)center, src_size - 1);
+      coeffs->bounds[i * 2 + 1] = 1;
     }
+  }
+}
 
-    sample = 0.0f;
-    val[0] = val[1] = val[2] = val[3] = 0.0f;
-    valf[0] = valf[1] = valf[2] = valf[3] = 0.0f;
+static void scale_coefficients_free(ScaleCoefficients *coeffs)
+{
+  MEM_freeN(coeffs->bounds);
+  MEM_freeN(coeffs->weights);
+}
 
-    for (y = newy; y > 0; y--) {
-      if (do_rect) {
-        nval[0] = -val[0] * sample;
-        nval[1] = -val[1] * sample;
-        nval[2] = -val[2] * sample;
-        nval[3] = -val[3] * sample;
+/** Filter a row of \a channels floats per pixel along x. */
+static void scale_filter_row_x(const ScaleCoefficients *coeffs,
+                               const float *src,
+                               float *dst,
+                               int dst_width,
+                               int channels)
+{
+  for (int x = 0; x < dst_width; x++) {
+    const int min = coeffs->bounds[x * 2];
+    const int num = coeffs->bounds[x * 2 + 1];
+    const float *weights = coeffs->weights + x * coeffs->max_taps;
+    const float *pixel = src + min * channels;
+
+    if (channels == 4) {
+#ifdef __SSE2__
+      __m128 sum = _mm_setzero_ps();
+      for (int k = 0; k < num; k++, pixel += 4) {
+        sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weights[k]), _mm_loadu_ps(pixel)));
       }
-      if (do_float) {
-        nvalf[0] = -valf[0] * sample;
-        nvalf[1] = -valf[1] * sample;
-        nvalf[2] = -valf[2] * sample;
-        nvalf[3] = -valf[3] * sample;
+      _mm_storeu_ps(dst, sum);
+#else
+      float sum[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+      for (int k = 0; k < num; k++, pixel += 4) {
+        madd_v4_v4fl(sum, pixel, weights[k]);
       }
-
-      sample += add;
-
-      while (sample >= 1.0f) {
-        sample -= 1.0f;
-
-        if (do_rect) {
-          nval[0] += rect[0];
-          nval[1] += rect[1];
-          nval[2] += rect[2];
-          nval[3] += rect[3];
-          rect += skipx;
-        }
-        if (do_float) {
-          nvalf[0] += rectf[0];
-          nvalf[1] += rectf[1];
-          nvalf[2] += rectf[2];
-          nvalf[3] += rectf[3];
-          rectf += skipx;
+      copy_v4_v4(dst, sum);
+#endif
+    }
+    else {
+      for (int c = 0; c < channels; c++) {
+        float sum = 0.0f;
+        for (int k = 0; k < num; k++) {
+          sum += weights[k] * pixel[k * channels + c];
         }
+        dst[c] = sum;
       }
+    }
+    dst += channels;
+  }
+}
 
-      if (do_rect) {
-        val[0] = rect[0];
-        val[1] = rect[1];
-        val[2] = rect[2];
-        val[3] = rect[3];
-        rect += skipx;
-
-        newrect[0] = ((nval[0] + sample * val[0]) / add + 0.5f);
-        newrect[1] = ((nval[1] + sample * val[1]) / add + 0.5f);
-        newrect[2] = ((nval[2] + sample * val[2]) / add + 0.5f);
-        newrect[3] = ((nval[3] + sample * val[3]) / add + 0.5f);
-
-        newrect += skipx;
-      }
-      if (do_float) {
-
-        valf[0] = rectf[0];
-        valf[1] = rectf[1];
-        valf[2] = rectf[2];
-        valf[3] = rectf[3];
-        rectf += skipx;
-
-        newrectf[0] = ((nvalf[0] + sample * valf[0]) / add);
-        newrectf[1] = ((nvalf[1] + sample * valf[1]) / add);
-        newrectf[2] = ((nvalf[2] + sample * valf[2]) / add);
-        newrectf[3] = ((nvalf[3] + sample * valf[3]) / add);
-
-        newrectf += skipx;
+/** Weighted sum of source rows into \a dst, for filtering along y. */
+static void scale_filter_rows_y(const ScaleCoefficients *coeffs,
+                                int y,
+                                const float *src,
+                                const unsigned char *src_byte,
+                                size_t row_size,
+                                float *dst)
+{
+  const int min = coeffs->bounds[y * 2];
+  const int num = coeffs->bounds[y * 2 + 1];
+  const float *weights = coeffs->weights + y * coeffs->max_taps;
+
+  memset(dst, 0, sizeof(float) * row_size);
+  for (int k = 0; k < num; k++) {
+    const float weight = weights[k];
+
+    if (src_byte) {
+      const unsigned char *src_row = src_byte + (size_t)(min + k) * row_size;
+      for (size_t i = 0; i < row_size; i++) {
+        dst[i] += weight * (float)src_row[i];
       }
-
-      sample -= 1.0f;
+      continue;
     }
-  }
 
-  if (do_rect) {
-    // printf("%ld %ld\n", (uchar *)rect - ((uchar *)ibuf->rect), rect_size);
-    BLI_assert((uchar *)rect - ((uchar *)ibuf->rect) == rect_size); /* see bug [#26502] */
-    imb_freerectImBuf(ibuf);
-    ibuf->mall |= IB_rect;
-    ibuf->rect = (unsigned int *)_newrect;
-  }
-  if (do_float) {
-    // printf("%ld %ld\n", rectf - ibuf->rect_float, rect_size);
-    BLI_assert((rectf - ibuf->rect_float) == rect_size); /* see bug [#26502] */
-    imb_freerectfloatImBuf(ibuf);
-    ibuf->mall |= IB_rectfloat;
-    ibuf->rect_float = (float *)_newrectf;
+    const float *src_row = src + (size_t)(min + k) * row_size;
+    size_t i = 0;
+#ifdef __SSE2__
+    const __m128 weight4 = _mm_set1_ps(weight);
+    for (; i + 4 <= row_size; i += 4) {
+      _mm_storeu_ps(dst + i,
+                    _mm_add_ps(_mm_loadu_ps(dst + i),
+                               _mm_mul_ps(weight4, _mm_loadu_ps(src_row + i))));
+    }
+#endif
+    for (; i < row_size; i++) {
+      dst[i] += weight * src_row[i];
+    }
   }
-  (void)rect_size; /* UNUSED in release builds */
-
-  ibuf->y = newy;
-  return (ibuf);
 }
 
-static ImBuf *scaleupx(struct ImBuf *ibuf, int newx)
+/** Round to bytes, filters with negative lobes can overshoot. */
+static void scale_float_row_to_uchar(unsigned char *dst, const float *src, size_t size)
 {
-  uchar *rect, *_newrect = NULL, *newrect;
-  float *rectf, *_newrectf = NULL, *newrectf;
-  float sample, add;
-  float val_a, nval_a, diff_a;
-  float val_b, nval_b, diff_b;
-  float val_g, nval_g, diff_g;
-  float val_r, nval_r, diff_r;
-  float val_af, nval_af, diff_af;
-  float val_bf, nval_bf, diff_bf;
-  float val_gf, nval_gf, diff_gf;
-  float val_rf, nval_rf, diff_rf;
-  int x, y;
-  bool do_rect = false, do_float = false;
-
-  val_a = nval_a = diff_a = val_b = nval_b = diff_b = 0;
-  val_g = nval_g = diff_g = val_r = nval_r = diff_r = 0;
-  val_af = nval_af = diff_af = val_bf = nval_bf = diff_bf = 0;
-  val_gf = nval_gf = diff_gf = val_rf = nval_rf = diff_rf = 0;
-  if (ibuf == NULL) {
-    return (NULL);
-  }
-  if (ibuf->rect == NULL && ibuf->rect_float == NULL) {
-    return (ibuf);
+  for (size_t i = 0; i < size; i++) {
+    const float value = src[i];
+    dst[i] = (value <= 0.0f) ? 0 : (value >= 255.0f) ? 255 : (unsigned char)(value + 0.5f);
   }
+}
 
-  if (ibuf->rect) {
-    do_rect = true;
-    _newrect = MEM_mallocN(newx * ibuf->y * sizeof(int), "scaleupx");
-    if (_newrect == NULL) {
-      return (ibuf);
-    }
-  }
-  if (ibuf->rect_float) {
-    do_float = true;
-    _newrectf = MEM_mallocN(newx * ibuf->y * sizeof(float) * 4, "scaleupxf");
-    if (_newrectf == NULL) {
-      if (_newrect) {
-        MEM_freeN(_newrect);
+typedef struct ScaleFilterData {
+  const ScaleCoefficients *coeffs;
+  int channels;
+  int src_width;
+  int dst_width;
+  int num_rows;
+  /* Source, either bytes or floats. */
+  const unsigned char *src_byte;
+  const float *src_float;
+  /* Destination, either bytes or floats. */
+  unsigned char *dst_byte;
+  float *dst_float;
+} ScaleFilterData;
+
+static void scale_filter_x_task(void *__restrict userdata,
+                                const int block,
+                                const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  ScaleFilterData *data = userdata;
+  const int channels = data->channels;
+  const size_t src_row_size = (size_t)data->src_width * channels;
+  const size_t dst_row_size = (size_t)data->dst_width * channels;
+  const int ymin = block * SCALE_BLOCK_ROWS;
+  const int ymax = min_ii(ymin + SCALE_BLOCK_ROWS, data->num_rows);
+  float *src_row = NULL;
+  float *dst_row = NULL;
+
+  if (data->src_byte) {
+    src_row = MEM_mallocN(sizeof(float) * src_row_size, __func__);
+  }
+  if (data->dst_byte) {
+    dst_row = MEM_mallocN(sizeof(float) * dst_row_size, __func__);
+  }
+
+  for (int y = ymin; y < ymax; y++) {
+    const float *src;
+    if (data->src_byte) {
+      const unsigned char *src_byte = data->src_byte + y * src_row_size;
+      for (size_t i = 0; i < src_row_size; i++) {
+        src_row[i] = (float)src_byte[i];
       }
-      return (ibuf);
+      src = src_row;
     }
-  }
-
-  add = (ibuf->x - 1.001) / (newx - 1.0);
-
-  rect = (uchar *)ibuf->rect;
-  rectf = (float *)ibuf->rect_float;
-  newrect = _newrect;
-  newrectf = _newrectf;
-
-  for (y = ibuf->y; y > 0; y--) {
-
-    sample = 0;
-
-    if (do_rect) {
-      val_a = rect[0];
-      nval_a = rect[4];
-      diff_a = nval_a - val_a;
-      val_a += 0.5f;
-
-      val_b = rect[1];
-      nval_b = rect[5];
-      diff_b = nval_b - val_b;
-      val_b += 0.5f;
-
-      val_g = rect[2];
-      nval_g = rect[6];
-      diff_g = nval_g - val_g;
-      val_g += 0.5f;
-
-      val_r = rect[3];
-      nval_r = rect[7];
-      diff_r = nval_r - val_r;
-      val_r += 0.5f;
-
-      rect += 8;
+    else {
+      src = data->src_float + y * src_row_size;
     }
-    if (do_float) {
-      val_af = rectf[0];
-      nval_af = rectf[4];
-      diff_af = nval_af - val_af;
 
-      val_bf = rectf[1];
-      nval_bf = rectf[5];
-      diff_bf = nval_bf - val_bf;
-
-      val_gf = rectf[2];
-      nval_gf = rectf[6];
-      diff_gf = nval_gf - val_gf;
-
-      val_rf = rectf[3];
-      nval_rf = rectf[7];
-      diff_rf = nval_rf - val_rf;
-
-      rectf += 8;
+    if (data->dst_byte) {
+      scale_filter_row_x(data->coeffs, src, dst_row, data->dst_width, channels);
+      scale_float_row_to_uchar(data->dst_byte + y * dst_row_size, dst_row, dst_row_size);
     }
-    for (x = newx; x > 0; x--) {
-      if (sample >= 1.0f) {
-        sample -= 1.0f;
-
-        if (do_rect) {
-          val_a = nval_a;
-          nval_a = rect[0];
-          diff_a = nval_a - val_a;
-          val_a += 0.5f;
-
-          val_b = nval_b;
-          nval_b = rect[1];
-          diff_b = nval_b - val_b;
-          val_b += 0.5f;
-
-          val_g = nval_g;
-          nval_g = rect[2];
-          diff_g = nval_g - val_g;
-          val_g += 0.5f;
-
-          val_r = nval_r;
-          nval_r = rect[3];
-          diff_r = nval_r - val_r;
-          val_r += 0.5f;
-          rect += 4;
-        }
-        if (do_float) {
-          val_af = nval_af;
-          nval_af = rectf[0];
-          diff_af = nval_af - val_af;
-
-          val_bf = nval_bf;
-          nval_bf = rectf[1];
-          diff_bf = nval_bf - val_bf;
-
-          val_gf = nval_gf;
-          nval_gf = rectf[2];
-          diff_gf = nval_gf - val_gf;
-
-          val_rf = nval_rf;
-          nval_rf = rectf[3];
-          diff_rf = nval_rf - val_rf;
-          rectf += 4;
-        }
-      }
-      if (do_rect) {
-        newrect[0] = val_a + sample * diff_a;
-        newrect[1] = val_b + sample * diff_b;
-        newrect[2] = val_g + sample * diff_g;
-        newrect[3] = val_r + sample * diff_r;
-        newrect += 4;
-      }
-      if (do_float) {
-        newrectf[0] = val_af + sample * diff_af;
-        newrectf[1] = val_bf + sample * diff_bf;
-        newrectf[2] = val_gf + sample * diff_gf;
-        newrectf[3] = val_rf + sample * diff_rf;
-        newrectf += 4;
-      }
-      sample += add;
+    else {
+      scale_filter_row_x(
+          data->coeffs, src, data->dst_float + y * dst_row_size, data->dst_width, channels);
     }
   }
 
-  if (do_rect) {
-    imb_freerectImBuf(ibuf);
-    ibuf->mall |= IB_rect;
-    ibuf->rect = (unsigned int *)_newrect;
+  if (src_row) {
+    MEM_freeN(src_row);
   }
-  if (do_float) {
-    imb_freerectfloatImBuf(ibuf);
-    ibuf->mall |= IB_rectfloat;
-    ibuf->rect_float = (float *)_newrectf;
+  if (dst_row) {
+    MEM_freeN(dst_row);
   }
-
-  ibuf->x = newx;
-  return (ibuf);
 }
 
-static ImBuf *scaleupy(struct ImBuf *ibuf, int newy)
+static void scale_filter_y_task(void *__restrict userdata,
+                                const int block,
+                                const TaskParallelTLS *__restrict UNUSED(tls))
 {
-  uchar *rect, *_newrect = NULL, *newrect;
-  float *rectf, *_newrectf = NULL, *newrectf;
-  float sample, add;
-  float val_a, nval_a, diff_a;
-  float val_b, nval_b, diff_b;
-  float val_g, nval_g, diff_g;
-  float val_r, nval_r, diff_r;
-  float val_af, nval_af, diff_af;
-  float val_bf, nval_bf, diff_bf;
-  float val_gf, nval_gf, diff_gf;
-  float val_rf, nval_rf, diff_rf;
-  int x, y, skipx;
-  bool do_rect = false, do_float = false;
-
-  val_a = nval_a = diff_a = val_b = nval_b = diff_b = 0;
-  val_g = nval_g = diff_g = val_r = nval_r = diff_r = 0;
-  val_af = nval_af = diff_af = val_bf = nval_bf = diff_bf = 0;
-  val_gf = nval_gf = diff_gf = val_rf = nval_rf = diff_rf = 0;
-  if (ibuf == NULL) {
-    return (NULL);
-  }
-  if (ibuf->rect == NULL && ibuf->rect_float == NULL) {
-    return (ibuf);
+  ScaleFilterData *data = userdata;
+  const size_t row_size = (size_t)data->dst_width * data->channels;
+  const int ymin = block * SCALE_BLOCK_ROWS;
+  const int ymax = min_ii(ymin + SCALE_BLOCK_ROWS, data->num_rows);
+  float *row = NULL;
+
+  if (data->dst_byte) {
+    row = MEM_mallocN(sizeof(float) * row_size, __func__);
   }
 
-  if (ibuf->rect) {
-    do_rect = true;
-    _newrect = MEM_mallocN(ibuf->x * newy * sizeof(int), "scaleupy");
-    if (_newrect == NULL) {
-      return (ibuf);
+  for (int y = ymin; y < ymax; y++) {
+    if (data->dst_byte) {
+      scale_filter_rows_y(data->coeffs, y, data->src_float, data->src_byte, row_size, row);
+      scale_float_row_to_uchar(data->dst_byte + y * row_size, row, row_size);
     }
-  }
-  if (ibuf->rect_float) {
-    do_float = true;
-    _newrectf = MEM_mallocN(ibuf->x * newy * sizeof(float) * 4, "scaleupyf");
-    if (_newrectf == NULL) {
-      if (_newrect) {
-        MEM_freeN(_newrect);
-      }
-      return (ibuf);
+    else {
+      scale_filter_rows_y(data->coeffs,
+                          y,
+                          data->src_float,
+                          data->src_byte,
+                          row_size,
+                          data->dst_float + y * row_size);
     }
   }
 
-  add = (ibuf->y - 1.001) / (newy - 1.0);
-  skipx = 4 * ibuf->x;
-
-  rect = (uchar *)ibuf->rect;
-  rectf = (float *)ibuf->rect_float;
-  newrect = _newrect;
-  newrectf = _newrectf;
+  if (row) {
+    MEM_freeN(row);
+  }
+}
 
-  for (x = ibuf->x; x > 0; x--) {
+static void scale_filter_run(ScaleFilterData *data, TaskParallelRangeFunc func)
+{
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+  settings.use_threading = ((size_t)data->dst_width * data->num_rows > 64 * 64);
+  BLI_task_parallel_range(
+      0, (data->num_rows + SCALE_BLOCK_ROWS - 1) / SCALE_BLOCK_ROWS, data, func, &settings);
+}
 
-    sample = 0;
-    if (do_rect) {
-      rect = ((uchar *)ibuf->rect) + 4 * (x - 1);
-      newrect = _newrect + 4 * (x - 1);
-
-      val_a = rect[0];
-      nval_a = rect[skipx];
-      diff_a = nval_a - val_a;
-      val_a += 0.5f;
-
-      val_b = rect[1];
-      nval_b = rect[skipx + 1];
-      diff_b = nval_b - val_b;
-      val_b += 0.5f;
-
-      val_g = rect[2];
-      nval_g = rect[skipx + 2];
-      diff_g = nval_g - val_g;
-      val_g += 0.5f;
-
-      val_r = rect[3];
-      nval_r = rect[skipx + 3];
-      diff_r = nval_r - val_r;
-      val_r += 0.5f;
-
-      rect += 2 * skipx;
+/**
+ * Scale the byte or float buffer of \a ibuf along x then y, as a float buffer of \a channels
+ * channels of which the rows are filtered by \a coeffs_x and the columns by \a coeffs_y.
+ * Axes without coefficients keep their size and aren't filtered.
+ */
+static void *scale_filter_buffer(const ScaleCoefficients *coeffs_x,
+                                 const ScaleCoefficients *coeffs_y,
+                                 const void *src,
+                                 bool is_byte,
+                                 int channels,
+                                 int width,
+                                 int height,
+                                 int newx,
+                                 int newy)
+{
+  void *dst = MEM_mallocN((is_byte ? sizeof(unsigned char) : sizeof(float)) * channels * newx *
+                              newy,
+                          __func__);
+  float *tmp = NULL;
+  ScaleFilterData data = {NULL};
+
+  data.channels = channels;
+
+  if (coeffs_x) {
+    /* Keep the intermediate result in float when filtering along y as well. */
+    if (coeffs_y) {
+      tmp = MEM_mallocN(sizeof(float) * channels * newx * height, __func__);
     }
-    if (do_float) {
-      rectf = ibuf->rect_float + 4 * (x - 1);
-      newrectf = _newrectf + 4 * (x - 1);
-
-      val_af = rectf[0];
-      nval_af = rectf[skipx];
-      diff_af = nval_af - val_af;
 
-      val_bf = rectf[1];
-      nval_bf = rectf[skipx + 1];
-      diff_bf = nval_bf - val_bf;
-
-      val_gf = rectf[2];
-      nval_gf = rectf[skipx + 2];
-      diff_gf = nval_gf - val_gf;
-
-      val_rf = rectf[3];
-      nval_rf = rectf[skipx + 3];
-      diff_rf = nval_rf - val_rf;
+    data.coeffs = coeffs_x;
+    data.src_width = width;
+    data.dst_width = newx;
+    data.num_rows = height;
+    data.src_byte = is_byte ? src : NULL;
+    data.src_float = is_byte ? NULL : src;
+    data.dst_byte = (is_byte && !tmp) ? dst : NULL;
+    data.dst_float = tmp ? tmp : (is_byte ? NULL : dst);
+    scale_filter_run(&data, scale_filter_x_task);
+  }
+
+  if (coeffs_y) {
+    data.coeffs = coeffs_y;
+    data.src_width = newx;
+    data.dst_width = newx;
+    data.num_rows = newy;
+    data.src_byte = (is_byte && !tmp) ? src : NULL;
+    data.src_float = tmp ? tmp : (is_byte ? NULL : src);
+    data.dst_byte = is_byte ? dst : NULL;
+    data.dst_float = is_byte ? NULL : dst;
+    scale_filter_run(&data, scale_filter_y_task);
+  }
+
+  if (tmp) {
+    MEM_freeN(tmp);
+  }
+  return dst;
+}
 
-      rectf += 2 * skipx;
-    }
+static void scale_filtered(struct ImBuf *ibuf,
+                           int newx,
+                           int newy,
+                           IMB_ScaleFilter filter,
+                           bool keep_corners)
+{
+  if (newx == ibuf->x && newy == ibuf->y) {
+    return;
+  }
 
-    for (y = newy; y > 0; y--) {
-      if (sample >= 1.0f) {
-        sample -= 1.0f;
-
-        if (do_rect) {
-          val_a = nval_a;
-          nval_a = rect[0];
-          diff_a = nval_a - val_a;
-          val_a += 0.5f;
-
-          val_b = nval_b;
-          nval_b = rect[1];
-          diff_b = nval_b - val_b;
-          val_b += 0.5f;
-
-          val_g = nval_g;
-          nval_g = rect[2];
-          diff_g = nval_g - val_g;
-          val_g += 0.5f;
-
-          val_r = nval_r;
-          nval_r = rect[3];
-          diff_r = nval_r - val_r;
-          val_r += 0.5f;
-          rect += skipx;
-        }
-        if (do_float) {
-          val_af = nval_af;
-          nval_af = rectf[0];
-          diff_af = nval_af - val_af;
-
-          val_bf = nval_bf;
-          nval_bf = rectf[1];
-          diff_bf = nval_bf - val_bf;
-
-          val_gf = nval_gf;
-          nval_gf = rectf[2];
-          diff_gf = nval_gf - val_gf;
-
-          val_rf = nval_rf;
-          nval_rf = rectf[3];
-          diff_rf = nval_rf - val_rf;
-          rectf += skipx;
-        }
-      }
-      if (do_rect) {
-        newrect[0] = val_a + sample * diff_a;
-        newrect[1] = val_b + sample * diff_b;
-        newrect[2] = val_g + sample * diff_g;
-        newrect[3] = val_r + sample * diff_r;
-        newrect += skipx;
-      }
-      if (do_float) {
-        newrectf[0] = val_af + sample * diff_af;
-        newrectf[1] = val_bf + sample * diff_bf;
-        newrectf[2] = val_gf + sample * diff_gf;
-        newrectf[3] = val_rf + sample * diff_rf;
-        newrectf += skipx;
-      }
-      sample += add;
-    }
+  ScaleCoefficients coeffs_x, coeffs_y;
+  ScaleCoefficients *coeffs_x_p = NULL, *coeffs_y_p = NULL;
+  if (newx != ibuf->x) {
+    scale_coefficients_init(&coeffs_x, ibuf->x, newx, filter, keep_corners);
+    coeffs_x_p = &coeffs_x;
+  }
+  if (newy != ibuf->y) {
+    scale_coefficients_init(&coeffs_y, ibuf->y, newy, filter, keep_corners);
+    coeffs_y_p = &coeffs_y;
   }
 
-  if (do_rect) {
+  if (ibuf->rect) {
+    unsigned int *rect = scale_filter_buffer(
+        coeffs_x_p, coeffs_y_p, ibuf->rect, true, 4, ibuf->x, ibuf->y, newx, newy);
     imb_freerectImBuf(ibuf);
     ibuf->mall |= IB_rect;
-    ibuf->rect = (unsigned int *)_newrect;
+    ibuf->rect = rect;
   }
-  if (do_float) {
+
+  if (ibuf->rect_float) {
+    float *rect_float = scale_filter_buffer(coeffs_x_p,
+                                            coeffs_y_p,
+                                            ibuf->rect_float,
+                                            false,
+                                            ibuf->channels,
+                                            ibuf->x,
+                                            ibuf->y,
+                                            newx,
+                                            newy);
     imb_freerectfloatImBuf(ibuf);
     ibuf->mall |= IB_rectfloat;
-    ibuf->rect_float = (float *)_newrectf;
+    ibuf->rect_float = rect_float;
+  }
+
+  if (coeffs_x_p) {
+    scale_coefficients_free(coeffs_x_p);
+  }
+  if (coeffs_y_p) {
+    scale_coefficients_free(coeffs_y_p);
   }
 
+  ibuf->x = newx;
   ibuf->y = newy;
-  return (ibuf);
 }
 
 static void scalefast_Z_ImBuf(ImBuf *ibuf, int newx, int newy)
@@ -1629,6 +1501,13 @@ bool IMB_scaleImBuf(struct ImBuf *ibuf, unsigned int newx, unsigned int newy)
     return false;
   }
 
+  if (newx == 0) {
+    newx = ibuf->x;
+  }
+  if (newy == 0) {
+    newy = ibuf->y;
+  }
+
   /* Scale-up / scale-down functions below change ibuf->x and ibuf->y
    * so we first scale the Z-buffer (if any). */
   scalefast_Z_ImBuf(ibuf, newx, newy);
@@ -1639,19 +1518,33 @@ bool IMB_scaleImBuf(struct ImBuf *ibuf, unsigned int newx, unsigned int newy)
     return true;
   }
 
-  if (newx && (newx < ibuf->x)) {
-    scaledownx(ibuf, newx);
-  }
-  if (newy && (newy < ibuf->y)) {
-    scaledowny(ibuf, newy);
+  /* Average the covered pixels when scaling down, interpolate when scaling up. */
+  scale_filtered(ibuf, newx, newy, IMB_SCALE_FILTER_BOX, true);
+
+  return true;
+}
+
+/**
+ * Scale with \a filter, multi-threaded.
+ * Return true if \a ibuf is modified.
+ */
+bool IMB_scaleImBuf_filter(struct ImBuf *ibuf,
+                           unsigned int newx,
+                           unsigned int newy,
+                           IMB_ScaleFilter filter)
+{
+  if (ibuf == NULL) {
+    return false;
   }
-  if (newx && (newx > ibuf->x)) {
-    scaleupx(ibuf, newx);
+  if (ibuf->rect == NULL && ibuf->rect_float == NULL) {
+    return false;
   }
-  if (newy && (newy > ibuf->y)) {
-    scaleupy(ibuf, newy);
+  if (newx == 0 || newy == 0 || (newx == ibuf->x && newy == ibuf->y)) {
+    return false;
   }
 
+  scalefast_Z_ImBuf(ibuf, newx, newy);
+  scale_filtered(ibuf, newx, newy, filter, false);
   return true;
 }
 
@@ -1758,119 +1651,10 @@ bool IMB_scalefastImBuf(struct ImBuf *ibuf, unsigned int newx, unsigned int newy
   return true;
 }
 
-/* ******** threaded scaling ******** */
-
-typedef struct ScaleTreadInitData {
-  ImBuf *ibuf;
-
-  unsigned int newx;
-  unsigned int newy;
-
-  unsigned char *byte_buffer;
-  float *float_buffer;
-} ScaleTreadInitData;
-
-typedef struct ScaleThreadData {
-  ImBuf *ibuf;
-
-  unsigned int newx;
-  unsigned int newy;
-
-  int start_line;
-  int tot_line;
-
-  unsigned char *byte_buffer;
-  float *float_buffer;
-} ScaleThreadData;
-
-static void scale_thread_init(void *data_v, int start_line, int tot_line, void *init_data_v)
-{
-  ScaleThreadData *data = (ScaleThreadData *)data_v;
-  ScaleTreadInitData *init_data = (ScaleTreadInitData *)init_data_v;
-
-  data->ibuf = init_data->ibuf;
-
-  data->newx = init_data->newx;
-  data->newy = init_data->newy;
-
-  data->start_line = start_line;
-  data->tot_line = tot_line;
-
-  data->byte_buffer = init_data->byte_buffer;
-  data->float_buffer = init_data->float_buffer;
-}
-
-static void *do_scale_thread(void *data_v)
-{
-  ScaleThreadData *data = (ScaleThreadData *)data_v;
-  ImBuf *ibuf = data->ibuf;
-  int i;
-  float factor_x = (float)ibuf->x / data->newx;
-  float factor_y = (float)ibuf->y / data->newy;
-
-  for (i = 0; i < data->tot_line; i++) {
-    int y = data->start_line + i;
-    int x;
-
-    for (x = 0; x < data->newx; x++) {
-      float u = (float)x * factor_x;
-      float v = (float)y * factor_y;
-      int offset = y * data->newx + x;
-
-      if (data->byte_buffer) {
-        unsigned char *pixel = data->byte_buffer + 4 * offset;
-        BLI_bilinear_interpolation_char(
-            (unsigned char *)ibuf->rect, pixel, ibuf->x, ibuf->y, 4, u, v);
-      }
-
-      if (data->float_buffer) {
-        float *pixel = data->float_buffer + ibuf->channels * offset;
-        BLI_bilinear_interpolation_fl(
-            ibuf->rect_float, pixel, ibuf->x, ibuf->y, ibuf->channels, u, v);
-      }
-    }
-  }
-
-  return NULL;
-}
-
 void IMB_scaleImBuf_threaded(ImBuf *ibuf, unsigned int newx, unsigned int newy)
 {
-  ScaleTreadInitData init_data = {NULL};
-
-  /* prepare initialization data */
-  init_data.ibuf = ibuf;
-
-  init_data.newx = newx;
-  init_data.newy = newy;
-
-  if (ibuf->rect) {
-    init_data.byte_buffer = MEM_mallocN(4 * newx * newy * sizeof(char),
-                                        "threaded scale byte buffer");
-  }
-
-  if (ibuf->rect_float) {
-    init_data.float_buffer = MEM_mallocN(ibuf->channels * newx * newy * sizeof(float),
-                                         "threaded scale float buffer");
-  }
-
-  /* actual scaling threads */
-  IMB_processor_apply_threaded(
-      newy, sizeof(ScaleThreadData), &init_data, scale_thread_init, do_scale_thread);
-
-  /* alter image buffer */
-  ibuf->x = newx;
-  ibuf->y = newy;
-
-  if (ibuf->rect) {
-    imb_freerectImBuf(ibuf);
-    ibuf->mall |= IB_rect;
-    ibuf->rect = (unsigned int *)init_data.byte_buffer;
-  }
-
-  if (ibuf->rect_float) {
-    imb_freerectfloatImBuf(ibuf);
-    ibuf->mall |= IB_rectfloat;
-    ibuf->rect_float = init_data.float_buffer;
+  if (ibuf->rect == NULL && ibuf->rect_float == NULL) {
+    return;
   }
+  scale_filtered(ibuf, newx, newy, IMB_SCALE_FILTER_BILINEAR, false);
 }
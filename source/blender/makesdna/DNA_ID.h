@@ -245,12 +245,19 @@ typedef struct ID {
   int us;
   int icon_id;
   int recalc;
+  /**
+   * Changes made since the last memfile undo push, accumulated as the ID is tagged for update
+   * and cleared when writing the undo step. Untouched IDs share the data of the previous undo
+   * step instead of being written again, and are kept in place on undo instead of re-read.
+   */
+  int recalc_after_undo_push;
 
   /**
    * A session-wide unique identifier for a given ID, that remain the same across potential
    * re-allocations (e.g. due to undo/redo steps).
    */
   unsigned int session_uuid;
+  char _pad1[4];
 
   IDProperty *properties;
 
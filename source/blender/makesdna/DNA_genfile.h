@@ -27,6 +27,7 @@
 
 #include "intern/dna_utils.h"
 
+struct DNA_ReconstructInfo;
 struct SDNA;
 
 /**
@@ -94,10 +95,19 @@ int DNA_struct_find_nr_ex(const struct SDNA *sdna, const char *str, unsigned int
 int DNA_struct_find_nr(const struct SDNA *sdna, const char *str);
 void DNA_struct_switch_endian(const struct SDNA *oldsdna, int oldSDNAnr, char *data);
 const char *DNA_struct_get_compareflags(const struct SDNA *sdna, const struct SDNA *newsdna);
-void *DNA_struct_reconstruct(const struct SDNA *newsdna,
-                             const struct SDNA *oldsdna,
-                             const char *compflags,
-                             int oldSDNAnr,
+struct DNA_ReconstructInfo *DNA_reconstruct_info_create(const struct SDNA *oldsdna,
+                                                        const struct SDNA *newsdna,
+                                                        const char *compflags);
+void DNA_reconstruct_info_free(struct DNA_ReconstructInfo *info);
+int DNA_struct_reconstruct_size(const struct DNA_ReconstructInfo *info, int old_struct_nr);
+void DNA_struct_reconstruct_range(const struct DNA_ReconstructInfo *info,
+                                  int old_struct_nr,
+                                  int block_start,
+                                  int block_end,
+                                  const void *old_blocks,
+                                  void *new_blocks);
+void *DNA_struct_reconstruct(const struct DNA_ReconstructInfo *info,
+                             int old_struct_nr,
                              int blocks,
                              const void *data);
 
@@ -443,7 +443,8 @@ typedef struct bNodeTree {
   short is_updating;
   /** Generic temporary flag for recursion check (DFS/BFS). */
   short done;
-  char _pad2[4];
+  /** Compositor memory limit of full frame buffers in megabytes, 0 for unlimited. */
+  int memory_limit;
 
   /** Specific node type this tree is used for. */
   int nodetype DNA_DEPRECATED;
@@ -512,6 +513,9 @@ typedef struct bNodeTree {
 
 /* tree is localized copy, free when deleting node groups */
 /* #define NTREE_IS_LOCALIZED           (1 << 5) */
+#define NTREE_COM_FULL_FRAME (1 << 6) /* compositor processes whole buffers per operation */
+#define NTREE_COM_BUFFER_CACHE (1 << 7) /* keep buffers of unchanged nodes between executions */
+#define NTREE_COM_HALF_PRECISION (1 << 8) /* store intermediate buffers as half floats */
 
 /* ntree->update */
 typedef enum eNodeTreeUpdate {
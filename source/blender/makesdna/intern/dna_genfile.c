@@ -796,27 +796,24 @@ static eSDNA_Type sdna_type_nr(const char *dna_type)
 
 /**
  * Converts a value of one primitive type to another.
- * Note there is no optimization for the case where otype and ctype are the same:
+ * Note there is no optimization for the case where otypenr and ctypenr are the same:
  * assumption is that caller will handle this case.
  *
- * \param ctype: Name of type to convert to
- * \param otype: Name of type to convert from
+ * \param ctypenr: Type to convert to
+ * \param otypenr: Type to convert from
  * \param name_array_len: Result of #DNA_elem_array_size for this element.
  * \param curdata: Where to put converted data
- * \param olddata: Data of type otype to convert
+ * \param olddata: Data of type otypenr to convert
  */
-static void cast_elem(
-    const char *ctype, const char *otype, int name_array_len, char *curdata, const char *olddata)
+static void cast_elem(eSDNA_Type ctypenr,
+                      eSDNA_Type otypenr,
+                      int name_array_len,
+                      char *curdata,
+                      const char *olddata)
 {
   double val = 0.0;
   int curlen = 1, oldlen = 1;
 
-  eSDNA_Type ctypenr, otypenr;
-
-  if ((otypenr = sdna_type_nr(otype)) == -1 || (ctypenr = sdna_type_nr(ctype)) == -1) {
-    return;
-  }
-
   /* define lengths */
   oldlen = DNA_elem_type_size(otypenr);
   curlen = DNA_elem_type_size(ctypenr);
@@ -1023,30 +1020,20 @@ static bool elem_exists_alias(const SDNA *sdna,
 }
 
 /**
- * Returns the address of the data for the specified field within olddata
- * according to the struct format pointed to by old, or NULL if no such
- * field can be found.
- *
- * Passing olddata=NULL doesn't work reliably for existence checks; it will
- * return NULL both when the field is found at offset 0 and when it is not
- * found at all. For field existence checks, use #elem_exists() instead.
+ * Returns the offset of the specified field within the struct format pointed to by old,
+ * or -1 if no such field can be found.
  *
  * \param sdna: Old SDNA
  * \param type: Current field type name
  * \param name: Current field name
  * \param old: Pointer to struct information in sdna
- * \param olddata: Struct data
  * \param sppo: Optional place to return pointer to field info in sdna
- * \return Data address.
+ * \return Field offset.
  */
-static const char *find_elem(const SDNA *sdna,
-                             const char *type,
-                             const char *name,
-                             const short *old,
-                             const char *olddata,
-                             const short **sppo)
+static int find_elem_offset(
+    const SDNA *sdna, const char *type, const char *name, const short *old, const short **sppo)
 {
-  int a, elemcount, len;
+  int a, elemcount, offset = 0;
   const char *otype, *oname;
 
   /* without arraypart, so names can differ: return old namenr and type */
@@ -1059,43 +1046,214 @@ static const char *find_elem(const SDNA *sdna,
     otype = sdna->types[old[0]];
     oname = sdna->names[old[1]];
 
-    len = DNA_elem_size_nr(sdna, old[0], old[1]);
-
     if (elem_strcmp(name, oname) == 0) { /* name equal */
       if (strcmp(type, otype) == 0) {    /* type equal */
         if (sppo) {
           *sppo = old;
         }
-        return olddata;
+        return offset;
       }
 
-      return NULL;
+      return -1;
     }
 
-    olddata += len;
+    offset += DNA_elem_size_nr(sdna, old[0], old[1]);
   }
-  return NULL;
+  return -1;
 }
 
 /**
- * Converts the contents of a single field of a struct, of a non-struct type,
+ * Returns the address of the data for the specified field within olddata
+ * according to the struct format pointed to by old, or NULL if no such
+ * field can be found.
+ *
+ * \param sdna: Old SDNA
+ * \param type: Current field type name
+ * \param name: Current field name
+ * \param old: Pointer to struct information in sdna
+ * \param olddata: Struct data
+ * \param sppo: Optional place to return pointer to field info in sdna
+ * \return Data address.
+ */
+static const char *find_elem(const SDNA *sdna,
+                             const char *type,
+                             const char *name,
+                             const short *old,
+                             const char *olddata,
+                             const short **sppo)
+{
+  const int offset = find_elem_offset(sdna, type, name, old, sppo);
+  return (offset != -1) ? olddata + offset : NULL;
+}
+
+/**
+ * Does endian swapping on the fields of a struct value.
+ *
+ * \param oldsdna: SDNA of Blender that saved file
+ * \param oldSDNAnr: Index of struct info within oldsdna
+ * \param data: Struct data
+ */
+void DNA_struct_switch_endian(const SDNA *oldsdna, int oldSDNAnr, char *data)
+{
+  /* Recursive!
+   * If element is a struct, call recursive.
+   */
+  int a, mul, elemcount, elen, elena, firststructtypenr;
+  const short *spo, *spc;
+  char *cur;
+  const char *type, *name;
+  unsigned int oldsdna_index_last = UINT_MAX;
+
+  if (oldSDNAnr == -1) {
+    return;
+  }
+  firststructtypenr = *(oldsdna->structs[0]);
+
+  spo = spc = oldsdna->structs[oldSDNAnr];
+
+  elemcount = spo[1];
+
+  spc += 2;
+  cur = data;
+
+  for (a = 0; a < elemcount; a++, spc += 2) {
+    type = oldsdna->types[spc[0]];
+    name = oldsdna->names[spc[1]];
+    const int old_name_array_len = oldsdna->names_array_len[spc[1]];
+
+    /* DNA_elem_size_nr = including arraysize */
+    elen = DNA_elem_size_nr(oldsdna, spc[0], spc[1]);
+
+    /* test: is type a struct? */
+    if (spc[0] >= firststructtypenr && !ispointer(name)) {
+      /* struct field type */
+      /* where does the old data start (is there one?) */
+      char *cpo = (char *)find_elem(oldsdna, type, name, spo, data, NULL);
+      if (cpo) {
+        oldSDNAnr = DNA_struct_find_nr_ex(oldsdna, type, &oldsdna_index_last);
+
+        mul = old_name_array_len;
+        elena = elen / mul;
+
+        while (mul--) {
+          DNA_struct_switch_endian(oldsdna, oldSDNAnr, cpo);
+          cpo += elena;
+        }
+      }
+    }
+    else {
+      /* non-struct field type */
+      if (ispointer(name)) {
+        if (oldsdna->pointer_size == 8) {
+          BLI_endian_switch_int64_array((int64_t *)cur, old_name_array_len);
+        }
+      }
+      else {
+        if (ELEM(spc[0], SDNA_TYPE_SHORT, SDNA_TYPE_USHORT)) {
+
+          /* exception: variable called blocktype: derived from ID_  */
+          bool skip = false;
+          if (name[0] == 'b' && name[1] == 'l') {
+            if (strcmp(name, "blocktype") == 0) {
+              skip = true;
+            }
+          }
+
+          if (skip == false) {
+            BLI_endian_switch_int16_array((int16_t *)cur, old_name_array_len);
+          }
+        }
+        else if (ELEM(spc[0], SDNA_TYPE_INT, SDNA_TYPE_FLOAT)) {
+          /* note, intentionally ignore long/ulong here these could be 4 or 8 bits,
+           * but turns out we only used for runtime vars and
+           * only once for a struct type that's no longer used. */
+
+          BLI_endian_switch_int32_array((int32_t *)cur, old_name_array_len);
+        }
+        else if (ELEM(spc[0], SDNA_TYPE_INT64, SDNA_TYPE_UINT64, SDNA_TYPE_DOUBLE)) {
+          BLI_endian_switch_int64_array((int64_t *)cur, old_name_array_len);
+        }
+      }
+    }
+    cur += elen;
+  }
+}
+
+/* -------------------------------------------------------------------- */
+/** \name Struct Reconstruction
+ *
+ * Structs that differ between the SDNA of the file and the current SDNA are converted
+ * field by field. Matching the fields by name is slow, so this is only done once per
+ * struct when the file is opened, resulting in a list of steps that is replayed
+ * for every struct that is read.
+ * \{ */
+
+typedef enum eReconstructStepType {
+  /** Copy data that has the same layout in both SDNA's. */
+  RECONSTRUCT_STEP_MEMCPY,
+  /** Convert an array of primitive values, e.g. `short` to `int`. */
+  RECONSTRUCT_STEP_CAST_PRIMITIVE,
+  /** Convert an array of pointers to a different pointer size. */
+  RECONSTRUCT_STEP_CAST_POINTER,
+  /** Reconstruct an array of nested structs that are #SDNA_CMP_NOT_EQUAL. */
+  RECONSTRUCT_STEP_SUBSTRUCT,
+} eReconstructStepType;
+
+typedef struct ReconstructStep {
+  eReconstructStepType type;
+  /** Offset of the field in the old and the current struct. */
+  int old_offset;
+  int new_offset;
+  union {
+    struct {
+      int size;
+    } memcpy;
+    struct {
+      int array_len;
+      eSDNA_Type old_type;
+      eSDNA_Type new_type;
+    } cast_primitive;
+    struct {
+      int array_len;
+    } cast_pointer;
+    struct {
+      int array_len;
+      int old_struct_nr;
+    } substruct;
+  } data;
+} ReconstructStep;
+
+typedef struct DNA_ReconstructInfo {
+  const SDNA *oldsdna;
+  const SDNA *newsdna;
+  /** Result from #DNA_struct_get_compareflags. */
+  const char *compflags;
+
+  /** Index of the matching struct in newsdna for every struct in oldsdna, or -1. */
+  int *new_struct_nrs;
+  /** Steps for every struct in oldsdna that is #SDNA_CMP_NOT_EQUAL, otherwise NULL. */
+  ReconstructStep **steps;
+  int *steps_len;
+} DNA_ReconstructInfo;
+
+/**
+ * Initializes the step converting a single field of a struct, of a non-struct type,
  * from oldsdna to newsdna format.
  *
  * \param newsdna: SDNA of current Blender
  * \param oldsdna: SDNA of Blender that saved file
  * \param type: current field type name
  * \param new_name_nr: current field name number.
- * \param curdata: put field data converted to newsdna here
  * \param old: pointer to struct info in oldsdna
- * \param olddata: struct contents laid out according to oldsdna
+ * \param r_step: The step to initialize, its `new_offset` is set by the caller.
+ * \return false when the field doesn't exist in oldsdna (or can't be converted).
  */
-static void reconstruct_elem(const SDNA *newsdna,
-                             const SDNA *oldsdna,
-                             const char *type,
-                             const int new_name_nr,
-                             char *curdata,
-                             const short *old,
-                             const char *olddata)
+static bool reconstruct_step_init_elem(const SDNA *newsdna,
+                                       const SDNA *oldsdna,
+                                       const char *type,
+                                       const int new_name_nr,
+                                       const short *old,
+                                       ReconstructStep *r_step)
 {
   /* rules: test for NAME:
    *      - name equal:
@@ -1106,7 +1264,7 @@ static void reconstruct_elem(const SDNA *newsdna,
    * (nzc 2-4-2001 I want the 'unsigned' bit to be parsed as well. Where
    * can I force this?)
    */
-  int a, elemcount, len, countpos, mul;
+  int a, elemcount, len, countpos, old_offset = 0;
   const char *otype, *oname, *cp;
 
   /* is 'name' an array? */
@@ -1121,327 +1279,393 @@ static void reconstruct_elem(const SDNA *newsdna,
     countpos = 0;
   }
 
+  const int new_name_array_len = newsdna->names_array_len[new_name_nr];
+
   /* in old is the old struct */
   elemcount = old[1];
   old += 2;
   for (a = 0; a < elemcount; a++, old += 2) {
     const int old_name_nr = old[1];
+    const int old_name_array_len = oldsdna->names_array_len[old_name_nr];
+    int array_len = 0;
+
     otype = oldsdna->types[old[0]];
     oname = oldsdna->names[old[1]];
     len = DNA_elem_size_nr(oldsdna, old[0], old[1]);
 
     if (strcmp(name, oname) == 0) { /* name equal */
-
-      if (ispointer(name)) { /* pointer of functionpointer afhandelen */
-        cast_pointer(newsdna->pointer_size,
-                     oldsdna->pointer_size,
-                     newsdna->names_array_len[new_name_nr],
-                     curdata,
-                     olddata);
-      }
-      else if (strcmp(type, otype) == 0) { /* type equal */
-        memcpy(curdata, olddata, len);
-      }
-      else {
-        cast_elem(type, otype, newsdna->names_array_len[new_name_nr], curdata, olddata);
-      }
-
-      return;
+      array_len = new_name_array_len;
     }
     else if (countpos != 0) { /* name is an array */
-
       if (oname[countpos] == '[' && strncmp(name, oname, countpos) == 0) { /* basis equal */
-        const int new_name_array_len = newsdna->names_array_len[new_name_nr];
-        const int old_name_array_len = oldsdna->names_array_len[old_name_nr];
-        const int min_name_array_len = MIN2(new_name_array_len, old_name_array_len);
+        array_len = MIN2(new_name_array_len, old_name_array_len);
+      }
+    }
 
-        if (ispointer(name)) { /* handle pointer or functionpointer */
-          cast_pointer(
-              newsdna->pointer_size, oldsdna->pointer_size, min_name_array_len, curdata, olddata);
-        }
-        else if (strcmp(type, otype) == 0) { /* type equal */
-          /* size of single old array element */
-          mul = len / old_name_array_len;
-          /* smaller of sizes of old and new arrays */
-          mul *= min_name_array_len;
+    if (array_len == 0) {
+      old_offset += len;
+      continue;
+    }
 
-          memcpy(curdata, olddata, mul);
+    r_step->old_offset = old_offset;
 
-          if (old_name_array_len > new_name_array_len && strcmp(type, "char") == 0) {
-            /* string had to be truncated, ensure it's still null-terminated */
-            curdata[mul - 1] = '\0';
-          }
-        }
-        else {
-          cast_elem(type, otype, min_name_array_len, curdata, olddata);
-        }
-        return;
+    if (ispointer(name)) { /* handle pointer or functionpointer */
+      if (newsdna->pointer_size == oldsdna->pointer_size) {
+        r_step->type = RECONSTRUCT_STEP_MEMCPY;
+        r_step->data.memcpy.size = newsdna->pointer_size * array_len;
+      }
+      else {
+        r_step->type = RECONSTRUCT_STEP_CAST_POINTER;
+        r_step->data.cast_pointer.array_len = array_len;
+      }
+    }
+    else if (strcmp(type, otype) == 0) { /* type equal */
+      /* size of single old array element, times the smaller of sizes of old and new arrays */
+      int size = (len / old_name_array_len) * array_len;
+
+      if (old_name_array_len > new_name_array_len && strcmp(type, "char") == 0) {
+        /* String had to be truncated, leave the last byte of the (zero initialized)
+         * destination untouched so it's still null-terminated. */
+        size -= 1;
+      }
+      if (size <= 0) {
+        return false;
+      }
+      r_step->type = RECONSTRUCT_STEP_MEMCPY;
+      r_step->data.memcpy.size = size;
+    }
+    else {
+      const eSDNA_Type new_type = sdna_type_nr(type);
+      const eSDNA_Type old_type = sdna_type_nr(otype);
+      if (new_type == -1 || old_type == -1) {
+        return false;
       }
+      r_step->type = RECONSTRUCT_STEP_CAST_PRIMITIVE;
+      r_step->data.cast_primitive.array_len = array_len;
+      r_step->data.cast_primitive.old_type = old_type;
+      r_step->data.cast_primitive.new_type = new_type;
     }
-    olddata += len;
+    return true;
   }
+  return false;
 }
 
 /**
- * Converts the contents of an entire struct from oldsdna to newsdna format.
- *
- * \param newsdna: SDNA of current Blender
- * \param oldsdna: SDNA of Blender that saved file
- * \param compflags:
+ * Initializes the step converting a field of a struct type (or an array of those).
  *
- * Result from DNA_struct_get_compareflags to avoid needless conversions.
- * \param oldSDNAnr: Index of old struct definition in oldsdna
- * \param data: Struct contents laid out according to oldsdna
- * \param curSDNAnr: Index of current struct definition in newsdna
- * \param cur: Where to put converted struct contents
+ * \param info: The reconstruct info, only `new_struct_nrs` has to be initialized.
+ * \param type: current field type name
+ * \param new_name_nr: current field name number.
+ * \param old: pointer to struct info in oldsdna
+ * \param oldsdna_index_last: Optimization for #DNA_struct_find_nr_ex.
+ * \param r_step: The step to initialize, its `new_offset` is set by the caller.
+ * \return false when the field doesn't exist in oldsdna.
  */
-static void reconstruct_struct(const SDNA *newsdna,
-                               const SDNA *oldsdna,
-                               const char *compflags,
-
-                               int oldSDNAnr,
-                               const char *data,
-                               int curSDNAnr,
-                               char *cur)
+static bool reconstruct_step_init_substruct(const DNA_ReconstructInfo *info,
+                                            const char *type,
+                                            const int new_name_nr,
+                                            const short *old,
+                                            unsigned int *oldsdna_index_last,
+                                            ReconstructStep *r_step)
 {
-  /* Recursive!
-   * Per element from cur_struct, read data from old_struct.
-   * If element is a struct, call recursive.
-   */
-  int a, elemcount, elen, eleno, mul, mulo, firststructtypenr;
-  const short *spo, *spc, *sppo;
-  const char *type;
-  const char *cpo;
-  char *cpc;
-  const char *name;
-
-  unsigned int oldsdna_index_last = UINT_MAX;
-  unsigned int cursdna_index_last = UINT_MAX;
+  const SDNA *oldsdna = info->oldsdna;
+  const SDNA *newsdna = info->newsdna;
+  const short *sppo;
 
-  if (oldSDNAnr == -1) {
-    return;
+  /* where does the old struct data start (and is there an old one?) */
+  const int old_offset = find_elem_offset(oldsdna, type, newsdna->names[new_name_nr], old, &sppo);
+  if (old_offset == -1) {
+    return false;
   }
-  if (curSDNAnr == -1) {
-    return;
+
+  const int old_struct_nr = DNA_struct_find_nr_ex(oldsdna, type, oldsdna_index_last);
+  if (old_struct_nr == -1 || info->new_struct_nrs[old_struct_nr] == -1) {
+    return false;
   }
 
-  if (compflags[oldSDNAnr] == SDNA_CMP_EQUAL) {
-    /* if recursive: test for equal */
-    spo = oldsdna->structs[oldSDNAnr];
-    elen = oldsdna->types_size[spo[0]];
-    memcpy(cur, data, elen);
+  /* array! new struct array may be larger than old */
+  const int array_len = MIN2(newsdna->names_array_len[new_name_nr],
+                             oldsdna->names_array_len[sppo[1]]);
 
-    return;
+  r_step->old_offset = old_offset;
+
+  if (info->compflags[old_struct_nr] == SDNA_CMP_EQUAL) {
+    r_step->type = RECONSTRUCT_STEP_MEMCPY;
+    r_step->data.memcpy.size = oldsdna->types_size[oldsdna->structs[old_struct_nr][0]] *
+                               array_len;
   }
+  else {
+    r_step->type = RECONSTRUCT_STEP_SUBSTRUCT;
+    r_step->data.substruct.array_len = array_len;
+    r_step->data.substruct.old_struct_nr = old_struct_nr;
+  }
+  return true;
+}
 
-  firststructtypenr = *(newsdna->structs[0]);
+/**
+ * Add a step, merging adjacent copies into a single one.
+ */
+static void reconstruct_steps_append(ReconstructStep *steps,
+                                     int *steps_len,
+                                     const ReconstructStep *step)
+{
+  if (step->type == RECONSTRUCT_STEP_MEMCPY && *steps_len != 0) {
+    ReconstructStep *step_prev = &steps[*steps_len - 1];
+    if ((step_prev->type == RECONSTRUCT_STEP_MEMCPY) &&
+        (step_prev->old_offset + step_prev->data.memcpy.size == step->old_offset) &&
+        (step_prev->new_offset + step_prev->data.memcpy.size == step->new_offset)) {
+      step_prev->data.memcpy.size += step->data.memcpy.size;
+      return;
+    }
+  }
+  steps[(*steps_len)++] = *step;
+}
 
-  spo = oldsdna->structs[oldSDNAnr];
-  spc = newsdna->structs[curSDNAnr];
+/**
+ * Create the steps converting a struct from oldsdna to newsdna format,
+ * at most one for every field of the current struct.
+ */
+static ReconstructStep *reconstruct_steps_create(const DNA_ReconstructInfo *info,
+                                                 const int old_struct_nr,
+                                                 int *r_steps_len)
+{
+  const SDNA *oldsdna = info->oldsdna;
+  const SDNA *newsdna = info->newsdna;
+  const int new_struct_nr = info->new_struct_nrs[old_struct_nr];
+  const int firststructtypenr = *(newsdna->structs[0]);
+  unsigned int oldsdna_index_last = UINT_MAX;
 
-  elemcount = spc[1];
+  const short *spo = oldsdna->structs[old_struct_nr];
+  const short *spc = newsdna->structs[new_struct_nr];
+  const int elemcount = spc[1];
 
-  spc += 2;
-  cpc = cur;
-  for (a = 0; a < elemcount; a++, spc += 2) { /* convert each field */
-    type = newsdna->types[spc[0]];
-    name = newsdna->names[spc[1]];
+  ReconstructStep *steps = MEM_malloc_arrayN(MAX2(elemcount, 1), sizeof(*steps), __func__);
+  int steps_len = 0;
+  int new_offset = 0;
 
-    elen = DNA_elem_size_nr(newsdna, spc[0], spc[1]);
+  spc += 2;
+  for (int a = 0; a < elemcount; a++, spc += 2) { /* convert each field */
+    const char *type = newsdna->types[spc[0]];
+    const char *name = newsdna->names[spc[1]];
+    const int elen = DNA_elem_size_nr(newsdna, spc[0], spc[1]);
+    ReconstructStep step;
+    bool has_step;
 
     /* Skip pad bytes which must start with '_pad', see makesdna.c 'is_name_legal'.
      * for exact rules. Note that if we fail to skip a pad byte it's harmless,
      * this just avoids unnecessary reconstruction. */
     if (name[0] == '_' || (name[0] == '*' && name[1] == '_')) {
-      cpc += elen;
+      has_step = false;
     }
     else if (spc[0] >= firststructtypenr && !ispointer(name)) {
       /* struct field type */
+      has_step = reconstruct_step_init_substruct(
+          info, type, spc[1], spo, &oldsdna_index_last, &step);
+    }
+    else {
+      /* non-struct field type */
+      has_step = reconstruct_step_init_elem(newsdna, oldsdna, type, spc[1], spo, &step);
+    }
 
-      /* where does the old struct data start (and is there an old one?) */
-      cpo = (char *)find_elem(oldsdna, type, name, spo, data, &sppo);
-
-      if (cpo) {
-        oldSDNAnr = DNA_struct_find_nr_ex(oldsdna, type, &oldsdna_index_last);
-        curSDNAnr = DNA_struct_find_nr_ex(newsdna, type, &cursdna_index_last);
+    if (has_step) {
+      step.new_offset = new_offset;
+      reconstruct_steps_append(steps, &steps_len, &step);
+    }
+    new_offset += elen;
+  }
 
-        /* array! */
-        mul = newsdna->names_array_len[spc[1]];
-        mulo = oldsdna->names_array_len[sppo[1]];
+  *r_steps_len = steps_len;
+  return steps;
+}
 
-        eleno = DNA_elem_size_nr(oldsdna, sppo[0], sppo[1]);
+/**
+ * Pre-compute how structs are converted from oldsdna to newsdna format,
+ * this is needed by #DNA_struct_reconstruct.
+ *
+ * \param compflags: Result from #DNA_struct_get_compareflags,
+ * must remain valid while the returned info is used.
+ */
+DNA_ReconstructInfo *DNA_reconstruct_info_create(const SDNA *oldsdna,
+                                                 const SDNA *newsdna,
+                                                 const char *compflags)
+{
+  DNA_ReconstructInfo *info = MEM_callocN(sizeof(*info), __func__);
+  const int structs_len = oldsdna->structs_len;
 
-        elen /= mul;
-        eleno /= mulo;
+  info->oldsdna = oldsdna;
+  info->newsdna = newsdna;
+  info->compflags = compflags;
+  info->new_struct_nrs = MEM_malloc_arrayN(structs_len, sizeof(*info->new_struct_nrs), __func__);
+  info->steps = MEM_calloc_arrayN(structs_len, sizeof(*info->steps), __func__);
+  info->steps_len = MEM_calloc_arrayN(structs_len, sizeof(*info->steps_len), __func__);
 
-        while (mul--) {
-          reconstruct_struct(newsdna, oldsdna, compflags, oldSDNAnr, cpo, curSDNAnr, cpc);
-          cpo += eleno;
-          cpc += elen;
+  unsigned int newsdna_index_last = 0;
+  for (int a = 0; a < structs_len; a++) {
+    const short *spo = oldsdna->structs[a];
+    info->new_struct_nrs[a] = DNA_struct_find_nr_ex(
+        newsdna, oldsdna->types[spo[0]], &newsdna_index_last);
+    /* The next indices will almost always match */
+    newsdna_index_last++;
+  }
 
-          /* new struct array larger than old */
-          mulo--;
-          if (mulo <= 0) {
-            break;
-          }
-        }
-      }
-      else {
-        cpc += elen; /* skip field no longer present */
-      }
+  /* All lookups are done, so the steps can reference any struct. */
+  for (int a = 0; a < structs_len; a++) {
+    if (compflags[a] == SDNA_CMP_NOT_EQUAL && info->new_struct_nrs[a] != -1) {
+      info->steps[a] = reconstruct_steps_create(info, a, &info->steps_len[a]);
     }
-    else {
-      /* non-struct field type */
-      reconstruct_elem(newsdna, oldsdna, type, spc[1], cpc, spo, data);
-      cpc += elen;
+  }
+
+  return info;
+}
+
+void DNA_reconstruct_info_free(DNA_ReconstructInfo *info)
+{
+  for (int a = 0; a < info->oldsdna->structs_len; a++) {
+    if (info->steps[a]) {
+      MEM_freeN(info->steps[a]);
     }
   }
+  MEM_freeN(info->steps);
+  MEM_freeN(info->steps_len);
+  MEM_freeN(info->new_struct_nrs);
+  MEM_freeN(info);
 }
 
 /**
- * Does endian swapping on the fields of a struct value.
+ * Converts the contents of an entire struct from oldsdna to newsdna format,
+ * by replaying the steps computed by #DNA_reconstruct_info_create.
  *
- * \param oldsdna: SDNA of Blender that saved file
- * \param oldSDNAnr: Index of struct info within oldsdna
- * \param data: Struct data
+ * \param old_struct_nr: Index of old struct definition in oldsdna
+ * \param data: Struct contents laid out according to oldsdna
+ * \param cur: Where to put converted struct contents, must be zero initialized.
  */
-void DNA_struct_switch_endian(const SDNA *oldsdna, int oldSDNAnr, char *data)
+static void reconstruct_struct(const DNA_ReconstructInfo *info,
+                               const int old_struct_nr,
+                               const char *data,
+                               char *cur)
 {
   /* Recursive!
-   * If element is a struct, call recursive.
+   * If a step is a struct, call recursive.
    */
-  int a, mul, elemcount, elen, elena, firststructtypenr;
-  const short *spo, *spc;
-  char *cur;
-  const char *type, *name;
-  unsigned int oldsdna_index_last = UINT_MAX;
+  const SDNA *oldsdna = info->oldsdna;
+  const SDNA *newsdna = info->newsdna;
 
-  if (oldSDNAnr == -1) {
+  if (info->compflags[old_struct_nr] == SDNA_CMP_EQUAL) {
+    /* if recursive: test for equal */
+    memcpy(cur, data, oldsdna->types_size[oldsdna->structs[old_struct_nr][0]]);
     return;
   }
-  firststructtypenr = *(oldsdna->structs[0]);
 
-  spo = spc = oldsdna->structs[oldSDNAnr];
+  const ReconstructStep *step = info->steps[old_struct_nr];
+  const ReconstructStep *step_end = step + info->steps_len[old_struct_nr];
 
-  elemcount = spo[1];
+  for (; step != step_end; step++) {
+    const char *cpo = data + step->old_offset;
+    char *cpc = cur + step->new_offset;
 
-  spc += 2;
-  cur = data;
-
-  for (a = 0; a < elemcount; a++, spc += 2) {
-    type = oldsdna->types[spc[0]];
-    name = oldsdna->names[spc[1]];
-    const int old_name_array_len = oldsdna->names_array_len[spc[1]];
-
-    /* DNA_elem_size_nr = including arraysize */
-    elen = DNA_elem_size_nr(oldsdna, spc[0], spc[1]);
-
-    /* test: is type a struct? */
-    if (spc[0] >= firststructtypenr && !ispointer(name)) {
-      /* struct field type */
-      /* where does the old data start (is there one?) */
-      char *cpo = (char *)find_elem(oldsdna, type, name, spo, data, NULL);
-      if (cpo) {
-        oldSDNAnr = DNA_struct_find_nr_ex(oldsdna, type, &oldsdna_index_last);
-
-        mul = old_name_array_len;
-        elena = elen / mul;
-
-        while (mul--) {
-          DNA_struct_switch_endian(oldsdna, oldSDNAnr, cpo);
-          cpo += elena;
+    switch (step->type) {
+      case RECONSTRUCT_STEP_MEMCPY:
+        memcpy(cpc, cpo, step->data.memcpy.size);
+        break;
+      case RECONSTRUCT_STEP_CAST_PRIMITIVE:
+        cast_elem(step->data.cast_primitive.new_type,
+                  step->data.cast_primitive.old_type,
+                  step->data.cast_primitive.array_len,
+                  cpc,
+                  cpo);
+        break;
+      case RECONSTRUCT_STEP_CAST_POINTER:
+        cast_pointer(newsdna->pointer_size,
+                     oldsdna->pointer_size,
+                     step->data.cast_pointer.array_len,
+                     cpc,
+                     cpo);
+        break;
+      case RECONSTRUCT_STEP_SUBSTRUCT: {
+        const int sub_old_struct_nr = step->data.substruct.old_struct_nr;
+        const int sub_new_struct_nr = info->new_struct_nrs[sub_old_struct_nr];
+        const int eleno = oldsdna->types_size[oldsdna->structs[sub_old_struct_nr][0]];
+        const int elen = newsdna->types_size[newsdna->structs[sub_new_struct_nr][0]];
+
+        for (int i = 0; i < step->data.substruct.array_len; i++) {
+          reconstruct_struct(info, sub_old_struct_nr, cpo, cpc);
+          cpo += eleno;
+          cpc += elen;
         }
+        break;
       }
     }
-    else {
-      /* non-struct field type */
-      if (ispointer(name)) {
-        if (oldsdna->pointer_size == 8) {
-          BLI_endian_switch_int64_array((int64_t *)cur, old_name_array_len);
-        }
-      }
-      else {
-        if (ELEM(spc[0], SDNA_TYPE_SHORT, SDNA_TYPE_USHORT)) {
+  }
+}
 
-          /* exception: variable called blocktype: derived from ID_  */
-          bool skip = false;
-          if (name[0] == 'b' && name[1] == 'l') {
-            if (strcmp(name, "blocktype") == 0) {
-              skip = true;
-            }
-          }
+/**
+ * \return The size of the struct in newsdna that \a old_struct_nr is converted to,
+ * zero when it doesn't exist anymore.
+ */
+int DNA_struct_reconstruct_size(const DNA_ReconstructInfo *info, int old_struct_nr)
+{
+  const int new_struct_nr = info->new_struct_nrs[old_struct_nr];
+  if (new_struct_nr == -1) {
+    return 0;
+  }
+  return info->newsdna->types_size[info->newsdna->structs[new_struct_nr][0]];
+}
 
-          if (skip == false) {
-            BLI_endian_switch_int16_array((int16_t *)cur, old_name_array_len);
-          }
-        }
-        else if (ELEM(spc[0], SDNA_TYPE_INT, SDNA_TYPE_FLOAT)) {
-          /* note, intentionally ignore long/ulong here these could be 4 or 8 bits,
-           * but turns out we only used for runtime vars and
-           * only once for a struct type that's no longer used. */
+/**
+ * Converts a range of structs within an array, so large arrays can be converted in parallel.
+ *
+ * \param old_struct_nr: Index of struct info within oldsdna
+ * \param block_start, block_end: The range of array elements to convert.
+ * \param old_blocks: Array of struct data laid out according to oldsdna.
+ * \param new_blocks: Zero initialized array of #DNA_struct_reconstruct_size sized elements.
+ */
+void DNA_struct_reconstruct_range(const DNA_ReconstructInfo *info,
+                                  int old_struct_nr,
+                                  int block_start,
+                                  int block_end,
+                                  const void *old_blocks,
+                                  void *new_blocks)
+{
+  const SDNA *oldsdna = info->oldsdna;
+  const int oldlen = oldsdna->types_size[oldsdna->structs[old_struct_nr][0]];
+  const int curlen = DNA_struct_reconstruct_size(info, old_struct_nr);
+  const char *cpo = (const char *)old_blocks + (size_t)oldlen * block_start;
+  char *cpc = (char *)new_blocks + (size_t)curlen * block_start;
 
-          BLI_endian_switch_int32_array((int32_t *)cur, old_name_array_len);
-        }
-        else if (ELEM(spc[0], SDNA_TYPE_INT64, SDNA_TYPE_UINT64, SDNA_TYPE_DOUBLE)) {
-          BLI_endian_switch_int64_array((int64_t *)cur, old_name_array_len);
-        }
-      }
-    }
-    cur += elen;
+  BLI_assert(curlen != 0);
+
+  for (int a = block_start; a < block_end; a++) {
+    reconstruct_struct(info, old_struct_nr, cpo, cpc);
+    cpc += curlen;
+    cpo += oldlen;
   }
 }
 
 /**
- * \param newsdna: SDNA of current Blender
- * \param oldsdna: SDNA of Blender that saved file
- * \param compflags:
- *
- * Result from DNA_struct_get_compareflags to avoid needless conversions
- * \param oldSDNAnr: Index of struct info within oldsdna
+ * \param info: Result from #DNA_reconstruct_info_create.
+ * \param old_struct_nr: Index of struct info within oldsdna
  * \param blocks: The number of array elements
  * \param data: Array of struct data
  * \return An allocated reconstructed struct
  */
-void *DNA_struct_reconstruct(const SDNA *newsdna,
-                             const SDNA *oldsdna,
-                             const char *compflags,
-                             int oldSDNAnr,
+void *DNA_struct_reconstruct(const DNA_ReconstructInfo *info,
+                             int old_struct_nr,
                              int blocks,
                              const void *data)
 {
-  int a, curSDNAnr, curlen = 0, oldlen;
-  const short *spo, *spc;
-  char *cur, *cpc;
-  const char *cpo;
-  const char *type;
-
-  /* oldSDNAnr == structnr, we're looking for the corresponding 'cur' number */
-  spo = oldsdna->structs[oldSDNAnr];
-  type = oldsdna->types[spo[0]];
-  oldlen = oldsdna->types_size[spo[0]];
-  curSDNAnr = DNA_struct_find_nr(newsdna, type);
-
-  /* init data and alloc */
-  if (curSDNAnr != -1) {
-    spc = newsdna->structs[curSDNAnr];
-    curlen = newsdna->types_size[spc[0]];
-  }
+  const int curlen = DNA_struct_reconstruct_size(info, old_struct_nr);
   if (curlen == 0) {
     return NULL;
   }
 
-  cur = MEM_callocN(blocks * curlen, "reconstruct");
-  cpc = cur;
-  cpo = data;
-  for (a = 0; a < blocks; a++) {
-    reconstruct_struct(newsdna, oldsdna, compflags, oldSDNAnr, cpo, curSDNAnr, cpc);
-    cpc += curlen;
-    cpo += oldlen;
-  }
-
+  /* init data and alloc */
+  void *cur = MEM_callocN((size_t)blocks * curlen, "reconstruct");
+  DNA_struct_reconstruct_range(info, old_struct_nr, 0, blocks, data, cur);
   return cur;
 }
 
+/** \} */
+
 /**
  * Returns the offset of the field with the specified name and type within the specified
  * struct type in sdna.
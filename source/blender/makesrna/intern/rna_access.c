@@ -46,6 +46,7 @@
 #include "BKE_idcode.h"
 #include "BKE_idprop.h"
 #include "BKE_fcurve.h"
+#include "BKE_lib_id.h"
 #include "BKE_main.h"
 #include "BKE_report.h"
 #include "BKE_node.h"
@@ -2219,6 +2220,12 @@ static void rna_property_update(
   const bool is_rna = (prop->magic == RNA_MAGIC);
   prop = rna_ensure_property(prop);
 
+  /* Not all properties tag the dependency graph, the undo system still needs to know about any
+   * change to skip untouched IDs. */
+  if (ptr->owner_id != NULL) {
+    BKE_lib_id_tag_undo_push(ptr->owner_id, ID_RECALC_COPY_ON_WRITE);
+  }
+
   if (is_rna) {
     if (prop->update) {
       /* ideally no context would be needed for update, but there's some
@@ -91,6 +91,17 @@ static const EnumPropertyItem node_quality_items[] = {
     {0, NULL, 0, NULL, NULL},
 };
 
+static const EnumPropertyItem node_precision_items[] = {
+    {0, "FULL", 0, "Full", "Store intermediate buffers as 32 bit floats"},
+    {NTREE_COM_HALF_PRECISION,
+     "HALF",
+     0,
+     "Half",
+     "Store intermediate buffers as 16 bit floats between full frame operations and in the "
+     "buffer cache, halving their memory (values are limited to 65504, not suitable for depth)"},
+    {0, NULL, 0, NULL, NULL},
+};
+
 static const EnumPropertyItem node_chunksize_items[] = {
     {NTREE_CHUNKSIZE_32, "32", 0, "32x32", "Chunksize of 32x32"},
     {NTREE_CHUNKSIZE_64, "64", 0, "64x64", "Chunksize of 64x64"},
@@ -9421,6 +9432,34 @@ static void rna_def_composite_nodetree(BlenderRNA *brna)
   RNA_def_property_boolean_sdna(prop, NULL, "flag", NTREE_COM_OPENCL);
   RNA_def_property_ui_text(prop, "OpenCL", "Enable GPU calculations");
 
+  prop = RNA_def_property(srna, "use_full_frame", PROP_BOOLEAN, PROP_NONE);
+  RNA_def_property_boolean_sdna(prop, NULL, "flag", NTREE_COM_FULL_FRAME);
+  RNA_def_property_ui_text(prop,
+                           "Full Frame",
+                           "Calculate whole images one operation at a time, instead of "
+                           "evaluating all nodes per pixel in tiles");
+
+  prop = RNA_def_property(srna, "memory_limit", PROP_INT, PROP_NONE);
+  RNA_def_property_int_sdna(prop, NULL, "memory_limit");
+  RNA_def_property_range(prop, 0, INT_MAX);
+  RNA_def_property_ui_text(prop,
+                           "Memory Limit",
+                           "Memory limit of the buffers calculated in full frame mode, "
+                           "buffers are temporarily written to disk above it "
+                           "(in megabytes, 0 for unlimited)");
+
+  prop = RNA_def_property(srna, "precision", PROP_ENUM, PROP_NONE);
+  RNA_def_property_enum_bitflag_sdna(prop, NULL, "flag");
+  RNA_def_property_enum_items(prop, node_precision_items);
+  RNA_def_property_ui_text(prop, "Precision", "Precision of the intermediate buffers");
+
+  prop = RNA_def_property(srna, "use_buffer_cache", PROP_BOOLEAN, PROP_NONE);
+  RNA_def_property_boolean_sdna(prop, NULL, "flag", NTREE_COM_BUFFER_CACHE);
+  RNA_def_property_ui_text(prop,
+                           "Cache Buffers",
+                           "Keep the buffers of nodes between updates, and reuse them while the "
+                           "nodes and their inputs are unchanged");
+
   prop = RNA_def_property(srna, "use_groupnode_buffer", PROP_BOOLEAN, PROP_NONE);
   RNA_def_property_boolean_sdna(prop, NULL, "flag", NTREE_COM_GROUPNODE_BUFFER);
   RNA_def_property_ui_text(prop, "Buffer Groups", "Enable buffering of group nodes");
@@ -566,6 +566,9 @@ static void rna_Sequence_name_set(PointerRNA *ptr, const char *value)
   /* make a copy of the old name first */
   BLI_strncpy(oldname, seq->name + 2, sizeof(seq->name) - 2);
 
+  /* Images cached on disk are stored by strip name. */
+  BKE_sequence_invalidate_cache_raw(scene, seq);
+
   /* copy the new name into the name slot */
   BLI_strncpy_utf8(seq->name + 2, value, sizeof(seq->name) - 2);
 
@@ -1946,6 +1949,14 @@ static void rna_def_editor(BlenderRNA *brna)
                            "Render frames ahead of playhead in background for faster playback");
   RNA_def_property_update(prop, NC_SCENE | ND_SEQUENCER, NULL);
 
+  prop = RNA_def_property(srna, "use_cache_disk", PROP_BOOLEAN, PROP_NONE);
+  RNA_def_property_boolean_sdna(prop, NULL, "cache_flag", SEQ_CACHE_DISK_CACHE_ENABLE);
+  RNA_def_property_ui_text(prop,
+                           "Disk Cache",
+                           "Also store cached frames on disk, to reuse them after the file is "
+                           "reopened (the file must be saved)");
+  RNA_def_property_update(prop, NC_SCENE | ND_SEQUENCER, NULL);
+
   prop = RNA_def_property(srna, "recycle_max_cost", PROP_FLOAT, PROP_NONE);
   RNA_def_property_range(prop, 0.0f, SEQ_CACHE_COST_MAX);
   RNA_def_property_ui_range(prop, 0.0f, SEQ_CACHE_COST_MAX, 0.1f, 1);
@@ -5033,6 +5033,17 @@ static void rna_def_userdef_system(BlenderRNA *brna)
       {0, NULL, 0, NULL, NULL},
   };
 
+  static const EnumPropertyItem seq_disk_cache_compression_levels[] = {
+      {USER_SEQ_DISK_CACHE_COMPRESSION_NONE, "NONE", 0, "None", "Requires fast storage"},
+      {USER_SEQ_DISK_CACHE_COMPRESSION_LOW, "LOW", 0, "Low", "Doesn't impact performance much"},
+      {USER_SEQ_DISK_CACHE_COMPRESSION_HIGH,
+       "HIGH",
+       0,
+       "High",
+       "Slower decoding, for slow storage only"},
+      {0, NULL, 0, NULL, NULL},
+  };
+
   static const EnumPropertyItem audio_mixing_samples_items[] = {
       {256, "SAMPLES_256", 0, "256 Samples", "Set audio mixing buffer size to 256 samples"},
       {512, "SAMPLES_512", 0, "512 Samples", "Set audio mixing buffer size to 512 samples"},
@@ -5151,6 +5162,28 @@ static void rna_def_userdef_system(BlenderRNA *brna)
   RNA_def_property_ui_text(prop, "Memory Cache Limit", "Memory cache limit (in megabytes)");
   RNA_def_property_update(prop, 0, "rna_Userdef_memcache_update");
 
+  prop = RNA_def_property(srna, "compositor_cache_limit", PROP_INT, PROP_NONE);
+  RNA_def_property_int_sdna(prop, NULL, "compositor_cache_limit");
+  RNA_def_property_range(prop, 1, max_memory_in_megabytes_int());
+  RNA_def_property_ui_text(prop,
+                           "Compositor Cache Limit",
+                           "Memory limit of the buffers kept between compositor updates "
+                           "(in megabytes)");
+
+  prop = RNA_def_property(srna, "sequencer_disk_cache_size_limit", PROP_INT, PROP_NONE);
+  RNA_def_property_int_sdna(prop, NULL, "sequencer_disk_cache_size_limit");
+  RNA_def_property_range(prop, 1, INT_MAX);
+  RNA_def_property_ui_text(
+      prop, "Sequencer Disk Cache Limit", "Sequencer disk cache size limit (in gigabytes)");
+
+  prop = RNA_def_property(srna, "sequencer_disk_cache_compression", PROP_ENUM, PROP_NONE);
+  RNA_def_property_enum_sdna(prop, NULL, "sequencer_disk_cache_compression");
+  RNA_def_property_enum_items(prop, seq_disk_cache_compression_levels);
+  RNA_def_property_ui_text(
+      prop,
+      "Sequencer Disk Cache Compression",
+      "Smaller compression will result in larger files, but less decoding overhead");
+
   prop = RNA_def_property(srna, "scrollback", PROP_INT, PROP_UNSIGNED);
   RNA_def_property_int_sdna(prop, NULL, "scrollback");
   RNA_def_property_range(prop, 32, 32768);
@@ -5863,6 +5896,13 @@ static void rna_def_userdef_filepaths(BlenderRNA *brna)
   RNA_def_property_string_sdna(prop, NULL, "render_cachedir");
   RNA_def_property_ui_text(prop, "Render Cache Path", "Where to cache raw render results");
 
+  prop = RNA_def_property(srna, "sequencer_disk_cache_directory", PROP_STRING, PROP_DIRPATH);
+  RNA_def_property_string_sdna(prop, NULL, "sequencer_disk_cache_dir");
+  RNA_def_property_ui_text(prop,
+                           "Sequencer Disk Cache Path",
+                           "Where to cache sequencer frames, the temporary directory is used "
+                           "when empty");
+
   prop = RNA_def_property(srna, "image_editor", PROP_STRING, PROP_FILEPATH);
   RNA_def_property_string_sdna(prop, NULL, "image_editor");
   RNA_def_property_ui_text(prop, "Image Editor", "Path to an image editor");
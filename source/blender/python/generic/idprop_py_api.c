@@ -24,9 +24,12 @@
 
 #include "BLI_utildefines.h"
 
+#include "DNA_ID.h"
+
 #include "idprop_py_api.h"
 
 #include "BKE_idprop.h"
+#include "BKE_lib_id.h"
 
 #define USE_STRING_COERCE
 
@@ -42,6 +45,15 @@ extern bool pyrna_id_CheckPyObject(PyObject *obj);
 
 /*********************** ID Property Main Wrapper Stuff ***************/
 
+/* Editing ID-properties doesn't run updates, the undo system still needs to know the ID changed.
+ * The ID can be NULL for properties which don't belong to an ID. */
+static void idprop_py_id_tag_changed(ID *id)
+{
+  if (id != NULL) {
+    BKE_lib_id_tag_undo_push(id, ID_RECALC_COPY_ON_WRITE);
+  }
+}
+
 /* ----------------------------------------------------------------------------
  * static conversion functions to avoid duplicate code, no type checking.
  */
@@ -256,6 +268,7 @@ static int BPy_IDGroup_SetName(BPy_IDProperty *self, PyObject *value, void *UNUS
   }
 
   memcpy(self->prop->name, name, name_size);
+  idprop_py_id_tag_changed(self->id);
   return 0;
 }
 
@@ -742,6 +755,7 @@ int BPy_Wrap_SetMapItem(IDProperty *prop, PyObject *key, PyObject *val)
 
 static int BPy_IDGroup_Map_SetItem(BPy_IDProperty *self, PyObject *key, PyObject *val)
 {
+  idprop_py_id_tag_changed(self->id);
   return BPy_Wrap_SetMapItem(self->prop, key, val);
 }
 
@@ -904,6 +918,7 @@ static PyObject *BPy_IDGroup_pop(BPy_IDProperty *self, PyObject *args)
   }
 
   IDP_RemoveFromGroup(self->prop, idprop);
+  idprop_py_id_tag_changed(self->id);
   return pyform;
 }
 
@@ -1065,6 +1080,7 @@ static PyObject *BPy_IDGroup_update(BPy_IDProperty *self, PyObject *value)
 
     /* XXX, possible one is inside the other */
     IDP_MergeGroup(self->prop, other->prop, true);
+    idprop_py_id_tag_changed(self->id);
   }
   else if (PyDict_Check(value)) {
     while (PyDict_Next(value, &i, &pkey, &pval)) {
@@ -1100,6 +1116,7 @@ PyDoc_STRVAR(BPy_IDGroup_clear_doc,
 static PyObject *BPy_IDGroup_clear(BPy_IDProperty *self)
 {
   IDP_ClearProperty(self->prop);
+  idprop_py_id_tag_changed(self->id);
   Py_RETURN_NONE;
 }
 
@@ -1352,6 +1369,7 @@ static int BPy_IDArray_SetItem(BPy_IDArray *self, int index, PyObject *value)
       break;
     }
   }
+  idprop_py_id_tag_changed(self->id);
   return 0;
 }
 
@@ -1438,6 +1456,7 @@ static int BPy_IDArray_ass_slice(BPy_IDArray *self, int begin, int end, PyObject
   }
 
   memcpy((void *)(((char *)IDP_Array(prop)) + (begin * elem_size)), vec, alloc_len);
+  idprop_py_id_tag_changed(self->id);
 
   MEM_freeN(vec);
   return 0;
@@ -1546,6 +1565,9 @@ static int BPy_IDArray_getbuffer(BPy_IDArray *self, Py_buffer *view, int flags)
   if (PyBuffer_FillInfo(view, (PyObject *)self, IDP_Array(prop), length, false, flags) == -1) {
     return -1;
   }
+  if (flags & PyBUF_WRITABLE) {
+    idprop_py_id_tag_changed(self->id);
+  }
 
   view->itemsize = itemsize;
   view->format = (char *)idp_format_from_array_type(prop->subtype);
@@ -66,6 +66,7 @@
 #include "BKE_global.h" /* evil G.* */
 #include "BKE_report.h"
 #include "BKE_idprop.h"
+#include "BKE_lib_id.h"
 
 /* Only for types. */
 #include "BKE_node.h"
@@ -362,6 +363,20 @@ void pyrna_write_set(bool UNUSED(val))
 }
 #endif /* USE_PEDANTIC_WRITE */
 
+/**
+ * Run RNA property update functions after setting a property from Python.
+ * Properties without them still tag their ID as changed for the undo system.
+ */
+static void pyrna_prop_update_after_set(PointerRNA *ptr, PropertyRNA *prop)
+{
+  if (RNA_property_update_check(prop)) {
+    RNA_property_update(BPy_GetContext(), ptr, prop);
+  }
+  else if (ptr->owner_id != NULL) {
+    BKE_lib_id_tag_undo_push(ptr->owner_id, ID_RECALC_COPY_ON_WRITE);
+  }
+}
+
 static Py_ssize_t pyrna_prop_collection_length(BPy_PropertyRNA *self);
 static Py_ssize_t pyrna_prop_array_length(BPy_PropertyArrayRNA *self);
 static int pyrna_py_to_prop(
@@ -456,9 +471,7 @@ static int mathutils_rna_vector_set(BaseMathObject *bmo, int subtype)
   }
 
   RNA_property_float_set_array(&self->ptr, self->prop, bmo->data);
-  if (RNA_property_update_check(self->prop)) {
-    RNA_property_update(BPy_GetContext(), &self->ptr, self->prop);
-  }
+  pyrna_prop_update_after_set(&self->ptr, self->prop);
 
   /* Euler order exception. */
   if (subtype == MATHUTILS_CB_SUBTYPE_EUL) {
@@ -467,9 +480,7 @@ static int mathutils_rna_vector_set(BaseMathObject *bmo, int subtype)
     short order = pyrna_rotation_euler_order_get(&self->ptr, eul->order, &prop_eul_order);
     if (order != eul->order) {
       RNA_property_enum_set(&self->ptr, prop_eul_order, eul->order);
-      if (RNA_property_update_check(prop_eul_order)) {
-        RNA_property_update(BPy_GetContext(), &self->ptr, prop_eul_order);
-      }
+      pyrna_prop_update_after_set(&self->ptr, prop_eul_order);
     }
   }
   return 0;
@@ -516,9 +527,7 @@ static int mathutils_rna_vector_set_index(BaseMathObject *bmo, int UNUSED(subtyp
   RNA_property_float_clamp(&self->ptr, self->prop, &bmo->data[index]);
   RNA_property_float_set_index(&self->ptr, self->prop, index, bmo->data[index]);
 
-  if (RNA_property_update_check(self->prop)) {
-    RNA_property_update(BPy_GetContext(), &self->ptr, self->prop);
-  }
+  pyrna_prop_update_after_set(&self->ptr, self->prop);
 
   return 0;
 }
@@ -575,9 +584,7 @@ static int mathutils_rna_matrix_set(BaseMathObject *bmo, int UNUSED(subtype))
   /* Can ignore clamping here. */
   RNA_property_float_set_array(&self->ptr, self->prop, bmo->data);
 
-  if (RNA_property_update_check(self->prop)) {
-    RNA_property_update(BPy_GetContext(), &self->ptr, self->prop);
-  }
+  pyrna_prop_update_after_set(&self->ptr, self->prop);
   return 0;
 }
 
@@ -2201,9 +2208,7 @@ static int pyrna_py_to_prop(
   }
 
   /* Run RNA property functions. */
-  if (RNA_property_update_check(prop)) {
-    RNA_property_update(BPy_GetContext(), ptr, prop);
-  }
+  pyrna_prop_update_after_set(ptr, prop);
 
   return 0;
 }
@@ -2277,9 +2282,7 @@ static int pyrna_py_to_prop_array_index(BPy_PropertyArrayRNA *self, int index, P
   }
 
   /* Run RNA property functions. */
-  if (RNA_property_update_check(prop)) {
-    RNA_property_update(BPy_GetContext(), ptr, prop);
-  }
+  pyrna_prop_update_after_set(ptr, prop);
 
   return ret;
 }
@@ -3300,9 +3303,7 @@ static int pyrna_prop_array_ass_subscript(BPy_PropertyArrayRNA *self,
   }
 
   if (ret != -1) {
-    if (RNA_property_update_check(self->prop)) {
-      RNA_property_update(BPy_GetContext(), &self->ptr, self->prop);
-    }
+    pyrna_prop_update_after_set(&self->ptr, self->prop);
   }
 
   return ret;
@@ -3518,6 +3519,11 @@ static int pyrna_struct_ass_subscript(BPy_StructRNA *self, PyObject *key, PyObje
     }
   }
 
+  if (self->ptr.owner_id != NULL) {
+    /* ID-properties don't run updates, the undo system still needs to know the ID changed. */
+    BKE_lib_id_tag_undo_push(self->ptr.owner_id, ID_RECALC_COPY_ON_WRITE);
+  }
+
   return BPy_Wrap_SetMapItem(group, key, value);
 }
 
@@ -5318,6 +5324,12 @@ static PyObject *foreach_getset(BPy_PropertyRNA *self, PyObject *args, int set)
       ok = RNA_property_collection_raw_set(
           NULL, &self->ptr, self->prop, attr, array, raw_type, tot);
     }
+
+    /* Raw access doesn't run updates, scripts are expected to tag updates themselves,
+     * the undo system still needs to know the ID changed. */
+    if (ok && self->ptr.owner_id != NULL) {
+      BKE_lib_id_tag_undo_push(self->ptr.owner_id, ID_RECALC_COPY_ON_WRITE);
+    }
   }
   else {
     buffer_is_compat = false;
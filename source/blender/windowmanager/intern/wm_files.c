@@ -1418,6 +1418,7 @@ static bool wm_file_write(bContext *C, const char *filepath, int fileflags, Repo
     }
 
     SET_FLAG_FROM_TEST(G.fileflags, fileflags & G_FILE_COMPRESS, G_FILE_COMPRESS);
+    SET_FLAG_FROM_TEST(G.fileflags, fileflags & G_FILE_COMPRESS_ZSTD, G_FILE_COMPRESS_ZSTD);
 
     /* prevent background mode scripts from clobbering history */
     if (do_history) {
@@ -2552,6 +2553,15 @@ static void save_set_compress(wmOperator *op)
       RNA_property_boolean_set(op->ptr, prop, (U.flag & USER_FILECOMPRESS) != 0);
     }
   }
+
+  /* Zstandard is only used when asked for explicitly, files compressed with it can't be read
+   * by older versions of Blender. */
+  prop = RNA_struct_find_property(op->ptr, "compress_zstd");
+  if (!RNA_property_is_set(op->ptr, prop)) {
+    if (G.save_over) { /* keep flag for existing file */
+      RNA_property_boolean_set(op->ptr, prop, (G.fileflags & G_FILE_COMPRESS_ZSTD) != 0);
+    }
+  }
 }
 
 static void save_set_filepath(bContext *C, wmOperator *op)
@@ -2609,6 +2619,8 @@ static int wm_save_as_mainfile_exec(bContext *C, wmOperator *op)
 
   /* set compression flag */
   SET_FLAG_FROM_TEST(fileflags, RNA_boolean_get(op->ptr, "compress"), G_FILE_COMPRESS);
+  SET_FLAG_FROM_TEST(
+      fileflags, RNA_boolean_get(op->ptr, "compress_zstd"), G_FILE_COMPRESS_ZSTD);
   SET_FLAG_FROM_TEST(fileflags, RNA_boolean_get(op->ptr, "relative_remap"), G_FILE_RELATIVE_REMAP);
   SET_FLAG_FROM_TEST(
       fileflags,
@@ -2673,6 +2685,12 @@ void WM_OT_save_as_mainfile(wmOperatorType *ot)
                                  FILE_DEFAULTDISPLAY,
                                  FILE_SORT_ALPHA);
   RNA_def_boolean(ot->srna, "compress", false, "Compress", "Write compressed .blend file");
+  RNA_def_boolean(ot->srna,
+                  "compress_zstd",
+                  false,
+                  "Zstandard",
+                  "Compress with multi-threaded Zstandard instead of zlib (the file can't be "
+                  "read by Blender versions without Zstandard support)");
   RNA_def_boolean(ot->srna,
                   "relative_remap",
                   true,
@@ -2745,6 +2763,12 @@ void WM_OT_save_mainfile(wmOperatorType *ot)
                                  FILE_DEFAULTDISPLAY,
                                  FILE_SORT_ALPHA);
   RNA_def_boolean(ot->srna, "compress", false, "Compress", "Write compressed .blend file");
+  RNA_def_boolean(ot->srna,
+                  "compress_zstd",
+                  false,
+                  "Zstandard",
+                  "Compress with multi-threaded Zstandard instead of zlib (the file can't be "
+                  "read by Blender versions without Zstandard support)");
   RNA_def_boolean(ot->srna,
                   "relative_remap",
                   false,
@@ -0,0 +1,244 @@
+/* Apache License, Version 2.0 */
+
+#include "blendfile_loading_base_test.h"
+
+#include <cstring>
+
+#include "MEM_guardedalloc.h"
+
+extern "C" {
+#include "BLI_fileops.h"
+#include "BLI_fileops_types.h"
+#include "BLI_path_util.h"
+#include "BLI_string.h"
+
+#include "BKE_appdir.h"
+#include "BKE_global.h"
+#include "BKE_lib_id.h"
+#include "BKE_main.h"
+#include "BKE_scene.h"
+#include "BKE_sequencer.h"
+
+#include "DNA_scene_types.h"
+#include "DNA_sequence_types.h"
+#include "DNA_userdef_types.h"
+
+#include "IMB_imbuf.h"
+#include "IMB_imbuf_types.h"
+}
+
+#define WIDTH 37
+#define HEIGHT 23
+#define FRAME 4
+
+class SequencerDiskCacheTest : public BlendfileLoadingBaseTest {
+ protected:
+  Main *bmain;
+  Scene *scene;
+  Sequence *seq;
+  SeqRenderData context;
+  char cache_dir[FILE_MAX];
+
+  void SetUp() override
+  {
+    BlendfileLoadingBaseTest::SetUp();
+
+    /* The disk cache is only used for saved blend files, the file itself isn't read. */
+    BKE_tempdir_init(NULL);
+    bmain = G.main;
+    BLI_join_dirfile(bmain->name, sizeof(bmain->name), BKE_tempdir_session(), "cache.blend");
+    BLI_join_dirfile(cache_dir, sizeof(cache_dir), BKE_tempdir_session(), "seq_cache");
+    BLI_strncpy(U.sequencer_disk_cache_dir, cache_dir, sizeof(U.sequencer_disk_cache_dir));
+    U.sequencer_disk_cache_size_limit = 1;
+    U.sequencer_disk_cache_compression = USER_SEQ_DISK_CACHE_COMPRESSION_LOW;
+
+    scene = BKE_scene_add(bmain, "Scene");
+    Editing *ed = BKE_sequencer_editing_ensure(scene);
+    ed->cache_flag = SEQ_CACHE_STORE_FINAL_OUT | SEQ_CACHE_DISK_CACHE_ENABLE;
+    seq = BKE_sequence_alloc(ed->seqbasep, 1, 1, SEQ_TYPE_IMAGE);
+    BLI_strncpy(seq->name + 2, "Strip", sizeof(seq->name) - 2);
+    seq->len = 10;
+    BKE_sequence_calc_disp(scene, seq);
+
+    BKE_sequencer_new_render_data(bmain, NULL, scene, WIDTH, HEIGHT, 100, false, &context);
+  }
+
+  void TearDown() override
+  {
+    BKE_id_delete(bmain, scene);
+    BLI_delete(cache_dir, true, true);
+    bmain->name[0] = '\0';
+
+    BlendfileLoadingBaseTest::TearDown();
+  }
+
+  static ImBuf *test_imbuf_create()
+  {
+    ImBuf *ibuf = IMB_allocImBuf(WIDTH, HEIGHT, 32, IB_rect | IB_rectfloat);
+    unsigned char *rect = (unsigned char *)ibuf->rect;
+    for (size_t i = 0; i < (size_t)WIDTH * HEIGHT * 4; i++) {
+      rect[i] = (unsigned char)(i * 7);
+      ibuf->rect_float[i] = (float)(i % 13) / 12.0f;
+    }
+    return ibuf;
+  }
+
+  /* Put the image in the memory cache and write it to disk. */
+  void put(ImBuf *ibuf)
+  {
+    BKE_sequencer_cache_put(&context, seq, FRAME, SEQ_CACHE_STORE_FINAL_OUT, ibuf, 0.5f);
+  }
+
+  /* Image read from disk, the memory cache is freed first. */
+  ImBuf *get_from_disk()
+  {
+    BKE_sequencer_cache_cleanup(scene);
+    return BKE_sequencer_cache_get(&context, seq, FRAME, SEQ_CACHE_STORE_FINAL_OUT);
+  }
+
+  void invalidate()
+  {
+    BKE_sequencer_cache_cleanup_sequence(scene, seq, seq, SEQ_CACHE_STORE_FINAL_OUT);
+  }
+
+  /* Number of images on disk, without the version file of the scene directory. */
+  static int count_files(const char *dir)
+  {
+    struct direntry *files;
+    const unsigned int num_files = BLI_filelist_dir_contents(dir, &files);
+    int count = 0;
+
+    for (unsigned int i = 0; i < num_files; i++) {
+      char path[FILE_MAX];
+      BLI_join_dirfile(path, sizeof(path), dir, files[i].relname);
+      if (S_ISDIR(files[i].type) && !FILENAME_IS_CURRPAR(files[i].relname)) {
+        count += count_files(path);
+      }
+      else if (S_ISREG(files[i].type) && BLI_path_extension_check(path, ".dcf")) {
+        count++;
+      }
+    }
+
+    BLI_filelist_free(files, num_files);
+    return count;
+  }
+
+  static void expect_imbuf_eq(const ImBuf *a, const ImBuf *b)
+  {
+    ASSERT_EQ(a->x, b->x);
+    ASSERT_EQ(a->y, b->y);
+    ASSERT_NE(nullptr, b->rect);
+    ASSERT_NE(nullptr, b->rect_float);
+    EXPECT_EQ(a->planes, b->planes);
+    EXPECT_EQ(a->channels, b->channels);
+    EXPECT_EQ(0, memcmp(a->rect, b->rect, sizeof(int) * a->x * a->y));
+    EXPECT_EQ(0, memcmp(a->rect_float, b->rect_float, sizeof(float) * 4 * a->x * a->y));
+  }
+};
+
+TEST_F(SequencerDiskCacheTest, WriteRead)
+{
+  ImBuf *ibuf = test_imbuf_create();
+  put(ibuf);
+  BKE_sequencer_cache_disk_flush(scene);
+
+  ImBuf *ibuf_read = get_from_disk();
+  ASSERT_NE(nullptr, ibuf_read);
+  EXPECT_NE(ibuf, ibuf_read);
+  expect_imbuf_eq(ibuf, ibuf_read);
+  IMB_freeImBuf(ibuf_read);
+
+  /* Files are found again by the next session, with the same state of the scene. */
+  BKE_sequencer_cache_destruct(scene);
+  ibuf_read = get_from_disk();
+  ASSERT_NE(nullptr, ibuf_read);
+  expect_imbuf_eq(ibuf, ibuf_read);
+  IMB_freeImBuf(ibuf_read);
+
+  IMB_freeImBuf(ibuf);
+}
+
+/* Images waiting to be written are read from the queue, or from their file once written. */
+TEST_F(SequencerDiskCacheTest, ReadQueued)
+{
+  ImBuf *ibuf = test_imbuf_create();
+  put(ibuf);
+
+  ImBuf *ibuf_read = get_from_disk();
+  ASSERT_NE(nullptr, ibuf_read);
+  expect_imbuf_eq(ibuf, ibuf_read);
+  IMB_freeImBuf(ibuf_read);
+
+  BKE_sequencer_cache_disk_flush(scene);
+  IMB_freeImBuf(ibuf);
+}
+
+TEST_F(SequencerDiskCacheTest, InvalidateDeletesFiles)
+{
+  ImBuf *ibuf = test_imbuf_create();
+  put(ibuf);
+  BKE_sequencer_cache_disk_flush(scene);
+  const int64_t timestamp = scene->ed->disk_cache_timestamp;
+
+  invalidate();
+  EXPECT_LT(timestamp, scene->ed->disk_cache_timestamp);
+  EXPECT_EQ(nullptr, get_from_disk());
+
+  /* Written again for the new state. */
+  put(ibuf);
+  BKE_sequencer_cache_disk_flush(scene);
+  ImBuf *ibuf_read = get_from_disk();
+  ASSERT_NE(nullptr, ibuf_read);
+  IMB_freeImBuf(ibuf_read);
+
+  IMB_freeImBuf(ibuf);
+}
+
+/* Files written by a previous session are deleted by invalidations too. */
+TEST_F(SequencerDiskCacheTest, InvalidateFilesOfPreviousSession)
+{
+  ImBuf *ibuf = test_imbuf_create();
+  put(ibuf);
+  BKE_sequencer_cache_disk_flush(scene);
+  EXPECT_EQ(1, count_files(cache_dir));
+
+  BKE_sequencer_cache_destruct(scene);
+  ImBuf *ibuf_read = get_from_disk();
+  ASSERT_NE(nullptr, ibuf_read);
+  IMB_freeImBuf(ibuf_read);
+
+  invalidate();
+  EXPECT_EQ(0, count_files(cache_dir));
+
+  IMB_freeImBuf(ibuf);
+}
+
+/* Images rendered before an invalidation are never written, even when still queued. */
+TEST_F(SequencerDiskCacheTest, InvalidateDiscardsQueued)
+{
+  ImBuf *ibuf = test_imbuf_create();
+  put(ibuf);
+  invalidate();
+  BKE_sequencer_cache_disk_flush(scene);
+
+  EXPECT_EQ(nullptr, get_from_disk());
+  BKE_sequencer_cache_destruct(scene);
+  EXPECT_EQ(nullptr, get_from_disk());
+
+  IMB_freeImBuf(ibuf);
+}
+
+/* A blend file saved before changes which invalidated the cache doesn't read the files written
+ * after them. */
+TEST_F(SequencerDiskCacheTest, OutdatedTimestamp)
+{
+  ImBuf *ibuf = test_imbuf_create();
+  put(ibuf);
+  BKE_sequencer_cache_disk_flush(scene);
+  BKE_sequencer_cache_destruct(scene);
+
+  scene->ed->disk_cache_timestamp -= 1;
+  EXPECT_EQ(nullptr, get_from_disk());
+
+  IMB_freeImBuf(ibuf);
+}
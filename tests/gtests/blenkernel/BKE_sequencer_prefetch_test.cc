@@ -0,0 +1,163 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+extern "C" {
+#include "BLI_utildefines.h"
+
+#include "intern/seqprefetch_intern.h"
+}
+
+#define EFRA 250
+
+static float claim(SeqPrefetchArea *area, int worker_index)
+{
+  float cfra = -1.0f;
+  EXPECT_TRUE(seq_prefetch_area_claim(area, worker_index, EFRA, &cfra));
+  return cfra;
+}
+
+TEST(sequencer_prefetch, ClaimNearestFirst)
+{
+  SeqPrefetchArea area;
+  seq_prefetch_area_init(&area, 10.0f);
+
+  EXPECT_EQ(11.0f, claim(&area, 0));
+  EXPECT_EQ(12.0f, claim(&area, 1));
+  seq_prefetch_area_release(&area, 0);
+  EXPECT_EQ(13.0f, claim(&area, 0));
+  EXPECT_EQ(4, area.num_frames_prefetched);
+}
+
+TEST(sequencer_prefetch, ClaimUntilEnd)
+{
+  SeqPrefetchArea area;
+  seq_prefetch_area_init(&area, EFRA - 2);
+
+  EXPECT_EQ((float)EFRA - 1.0f, claim(&area, 0));
+  EXPECT_EQ((float)EFRA, claim(&area, 1));
+
+  float cfra;
+  EXPECT_FALSE(seq_prefetch_area_claim(&area, 2, EFRA, &cfra));
+}
+
+/* Moving the playhead forward keeps the frames claimed already. */
+TEST(sequencer_prefetch, RebaseKeepsClaimed)
+{
+  SeqPrefetchArea area;
+  seq_prefetch_area_init(&area, 10.0f);
+  for (int i = 0; i < 4; i++) {
+    claim(&area, 0);
+    seq_prefetch_area_release(&area, 0);
+  }
+
+  seq_prefetch_area_update(&area, 12);
+  EXPECT_EQ(12.0f, area.cfra);
+  EXPECT_EQ(15.0f, claim(&area, 0));
+
+  /* Past the claimed frames. */
+  seq_prefetch_area_update(&area, 30);
+  EXPECT_EQ(31.0f, claim(&area, 1));
+}
+
+/* Moving the playhead back claims frames again, except those other workers are rendering. */
+TEST(sequencer_prefetch, ResetSkipsRendering)
+{
+  SeqPrefetchArea area;
+  seq_prefetch_area_init(&area, 10.0f);
+  EXPECT_EQ(11.0f, claim(&area, 0));
+  EXPECT_EQ(12.0f, claim(&area, 1));
+  EXPECT_EQ(13.0f, claim(&area, 2));
+  seq_prefetch_area_release(&area, 1);
+
+  seq_prefetch_area_update(&area, 9);
+  EXPECT_EQ(9.0f, area.cfra);
+  EXPECT_EQ(10.0f, claim(&area, 1));
+  EXPECT_EQ(12.0f, claim(&area, 3));
+  EXPECT_EQ(14.0f, claim(&area, 4));
+}
+
+/* Workers claiming frames concurrently like the prefetch job, while the playhead moves.
+ * Counts how often each frame is rendered, and how often it is rendered by several workers at
+ * once. */
+static void claim_concurrently(int playhead_step_back,
+                               std::vector<int> &r_num_renders,
+                               int &r_num_simultaneous)
+{
+  SeqPrefetchArea area;
+  std::mutex mutex;
+  std::vector<int> num_rendering(EFRA + 1, 0);
+  std::atomic<bool> stop(false);
+
+  r_num_renders.assign(EFRA + 1, 0);
+  r_num_simultaneous = 0;
+  seq_prefetch_area_init(&area, 1.0f);
+
+  std::vector<std::thread> workers;
+  for (int i = 0; i < SEQ_PREFETCH_MAX_WORKERS; i++) {
+    workers.emplace_back([&, i]() {
+      std::unique_lock<std::mutex> lock(mutex);
+      float cfra;
+      while (seq_prefetch_area_claim(&area, i, EFRA, &cfra)) {
+        r_num_renders[(int)cfra]++;
+        if (num_rendering[(int)cfra]++ > 0) {
+          r_num_simultaneous++;
+        }
+        lock.unlock();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        lock.lock();
+        num_rendering[(int)cfra]--;
+        seq_prefetch_area_release(&area, i);
+      }
+    });
+  }
+
+  std::thread playhead([&]() {
+    for (int cfra = 1; cfra <= EFRA && !stop; cfra++) {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        seq_prefetch_area_update(&area, cfra);
+        if (playhead_step_back && cfra % 20 == 0) {
+          seq_prefetch_area_update(&area, cfra - playhead_step_back);
+        }
+      }
+      std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+  });
+
+  for (std::thread &worker : workers) {
+    worker.join();
+  }
+  stop = true;
+  playhead.join();
+}
+
+/* Without the playhead moving back, no frame is rendered twice. */
+TEST(sequencer_prefetch, ConcurrentClaimsUnique)
+{
+  std::vector<int> num_renders;
+  int num_simultaneous;
+  claim_concurrently(0, num_renders, num_simultaneous);
+
+  EXPECT_EQ(0, num_simultaneous);
+  for (int cfra = 0; cfra <= EFRA; cfra++) {
+    EXPECT_GE(1, num_renders[cfra]) << "at frame " << cfra;
+  }
+}
+
+/* Frames are claimed again after the playhead moved back, which reads them from the cache, but
+ * never while another worker renders them. */
+TEST(sequencer_prefetch, ConcurrentResetNotSimultaneous)
+{
+  std::vector<int> num_renders;
+  int num_simultaneous;
+  claim_concurrently(10, num_renders, num_simultaneous);
+
+  EXPECT_EQ(0, num_simultaneous);
+}
@@ -296,3 +296,128 @@ TEST(task, ListBaseIter100k)
 {
   task_listbase_test("ListBase parallel iteration - Threaded - 100000 items", 100000, true);
 }
+
+/* *** Throughput of task pools with many small tasks. *** */
+
+#define POOL_NUM_TASKS 100000
+#define POOL_NUM_SPAWN_TASKS 256
+
+static void task_pool_small_work(int *count, const int index)
+{
+  const uint limit = gen_pseudo_random_number((uint)index) / 64;
+  for (uint i = 0; i < limit;) {
+    i += gen_pseudo_random_number(i) / 64 + 1;
+  }
+  atomic_add_and_fetch_uint32((uint32_t *)count, 1);
+}
+
+static void task_pool_small_func(TaskPool *__restrict pool, void *taskdata, int UNUSED(threadid))
+{
+  task_pool_small_work((int *)BLI_task_pool_userdata(pool), POINTER_AS_INT(taskdata));
+}
+
+static void task_pool_spawn_func(TaskPool *__restrict pool, void *taskdata, int threadid)
+{
+  const int start = POINTER_AS_INT(taskdata);
+  for (int i = 0; i < POOL_NUM_TASKS / POOL_NUM_SPAWN_TASKS; i++) {
+    BLI_task_pool_push_from_thread(pool,
+                                   task_pool_small_func,
+                                   POINTER_FROM_INT(start + i),
+                                   false,
+                                   TASK_PRIORITY_LOW,
+                                   threadid);
+  }
+}
+
+static void task_pool_test_do(const char *id, const int num_threads, const bool spawn_from_tasks)
+{
+  TaskScheduler *scheduler = BLI_task_scheduler_create(num_threads);
+  int count = 0;
+
+  double averaged_timing = 0.0;
+  for (int i = 0; i < NUM_RUN_AVERAGED; i++) {
+    const double init_time = PIL_check_seconds_timer();
+    TaskPool *pool = BLI_task_pool_create(scheduler, &count);
+    if (spawn_from_tasks) {
+      const int num_tasks_per_spawn = POOL_NUM_TASKS / POOL_NUM_SPAWN_TASKS;
+      for (int j = 0; j < POOL_NUM_SPAWN_TASKS; j++) {
+        BLI_task_pool_push(pool,
+                           task_pool_spawn_func,
+                           POINTER_FROM_INT(j * num_tasks_per_spawn),
+                           false,
+                           TASK_PRIORITY_LOW);
+      }
+    }
+    else {
+      for (int j = 0; j < POOL_NUM_TASKS; j++) {
+        BLI_task_pool_push(
+            pool, task_pool_small_func, POINTER_FROM_INT(j), false, TASK_PRIORITY_LOW);
+      }
+    }
+    BLI_task_pool_work_and_wait(pool);
+    BLI_task_pool_free(pool);
+    averaged_timing += PIL_check_seconds_timer() - init_time;
+  }
+
+  const int num_tasks_done = spawn_from_tasks ?
+                                 (POOL_NUM_TASKS / POOL_NUM_SPAWN_TASKS) * POOL_NUM_SPAWN_TASKS :
+                                 POOL_NUM_TASKS;
+  EXPECT_EQ(num_tasks_done * NUM_RUN_AVERAGED, count);
+
+  printf("\t%s: done in %fs on average over %d runs, %.0f tasks per second\n",
+         id,
+         averaged_timing / NUM_RUN_AVERAGED,
+         NUM_RUN_AVERAGED,
+         (double)num_tasks_done * NUM_RUN_AVERAGED / averaged_timing);
+
+  BLI_task_scheduler_free(scheduler);
+}
+
+/* Same work without a pool, as baseline for the scheduler overhead. */
+static void task_pool_serial_test_do(const char *id)
+{
+  int count = 0;
+
+  double averaged_timing = 0.0;
+  for (int i = 0; i < NUM_RUN_AVERAGED; i++) {
+    const double init_time = PIL_check_seconds_timer();
+    for (int j = 0; j < POOL_NUM_TASKS; j++) {
+      task_pool_small_work(&count, j);
+    }
+    averaged_timing += PIL_check_seconds_timer() - init_time;
+  }
+
+  EXPECT_EQ(POOL_NUM_TASKS * NUM_RUN_AVERAGED, count);
+
+  printf("\t%s: done in %fs on average over %d runs, %.0f tasks per second\n",
+         id,
+         averaged_timing / NUM_RUN_AVERAGED,
+         NUM_RUN_AVERAGED,
+         (double)POOL_NUM_TASKS * NUM_RUN_AVERAGED / averaged_timing);
+}
+
+TEST(task, PoolThroughputNoThread)
+{
+  task_pool_serial_test_do("Pool throughput - Single thread without pool");
+}
+
+TEST(task, PoolThroughputFromMain)
+{
+  BLI_threadapi_init();
+  task_pool_test_do("Pool throughput - Pushed from main thread", 0, false);
+  BLI_threadapi_exit();
+}
+
+TEST(task, PoolThroughputFromTasks)
+{
+  BLI_threadapi_init();
+  task_pool_test_do("Pool throughput - Pushed from tasks", 0, true);
+  BLI_threadapi_exit();
+}
+
+TEST(task, PoolThroughputFromTasks8Threads)
+{
+  BLI_threadapi_init();
+  task_pool_test_do("Pool throughput - Pushed from tasks - 8 threads", 8, true);
+  BLI_threadapi_exit();
+}
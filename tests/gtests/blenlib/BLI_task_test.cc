@@ -253,3 +253,135 @@ TEST(task, ListBaseIter)
   MEM_freeN(items_buffer);
   BLI_threadapi_exit();
 }
+
+/* *** Task pools with tasks spawning other tasks. *** */
+
+#define POOL_NUM_THREADS 4
+#define POOL_NUM_ROOT_TASKS 64
+#define POOL_NUM_CHILD_TASKS 64
+
+static TaskScheduler *pool_test_scheduler = NULL;
+
+static void task_pool_child_func(TaskPool *__restrict pool,
+                                 void *UNUSED(taskdata),
+                                 int UNUSED(threadid))
+{
+  int *count = (int *)BLI_task_pool_userdata(pool);
+  atomic_add_and_fetch_uint32((uint32_t *)count, 1);
+}
+
+static void task_pool_root_func(TaskPool *__restrict pool, void *UNUSED(taskdata), int threadid)
+{
+  for (int i = 0; i < POOL_NUM_CHILD_TASKS; i++) {
+    BLI_task_pool_push_from_thread(
+        pool, task_pool_child_func, NULL, false, TASK_PRIORITY_LOW, threadid);
+  }
+  task_pool_child_func(pool, NULL, threadid);
+}
+
+static void task_pool_nested_func(TaskPool *__restrict pool, void *UNUSED(taskdata), int threadid)
+{
+  int *count = (int *)BLI_task_pool_userdata(pool);
+
+  /* Wait for a pool of small tasks from within a task. */
+  int nested_count = 0;
+  TaskPool *nested_pool = BLI_task_pool_create(pool_test_scheduler, &nested_count);
+  for (int i = 0; i < POOL_NUM_CHILD_TASKS; i++) {
+    BLI_task_pool_push_from_thread(
+        nested_pool, task_pool_child_func, NULL, false, TASK_PRIORITY_LOW, threadid);
+  }
+  BLI_task_pool_work_and_wait(nested_pool);
+  BLI_task_pool_free(nested_pool);
+
+  EXPECT_EQ(POOL_NUM_CHILD_TASKS, nested_count);
+  atomic_add_and_fetch_uint32((uint32_t *)count, (uint32_t)nested_count + 1);
+}
+
+static void task_pool_test_do(TaskRunFunction root_func)
+{
+  BLI_threadapi_init();
+  pool_test_scheduler = BLI_task_scheduler_create(POOL_NUM_THREADS);
+
+  int count = 0;
+  TaskPool *pool = BLI_task_pool_create(pool_test_scheduler, &count);
+  for (int i = 0; i < POOL_NUM_ROOT_TASKS; i++) {
+    BLI_task_pool_push(pool, root_func, NULL, false, TASK_PRIORITY_LOW);
+  }
+  BLI_task_pool_work_and_wait(pool);
+  EXPECT_EQ(POOL_NUM_ROOT_TASKS * (POOL_NUM_CHILD_TASKS + 1), count);
+
+  /* A pool can be re-used until it is freed. */
+  count = 0;
+  for (int i = 0; i < POOL_NUM_ROOT_TASKS; i++) {
+    BLI_task_pool_push(pool, root_func, NULL, false, TASK_PRIORITY_HIGH);
+  }
+  BLI_task_pool_work_and_wait(pool);
+  EXPECT_EQ(POOL_NUM_ROOT_TASKS * (POOL_NUM_CHILD_TASKS + 1), count);
+
+  BLI_task_pool_free(pool);
+  BLI_task_scheduler_free(pool_test_scheduler);
+  pool_test_scheduler = NULL;
+  BLI_threadapi_exit();
+}
+
+TEST(task, PoolSpawn)
+{
+  task_pool_test_do(task_pool_root_func);
+}
+
+TEST(task, PoolNested)
+{
+  task_pool_test_do(task_pool_nested_func);
+}
+
+/* Every task waits for a pool of tasks nested one level deeper, deeper than the
+ * nesting tracked for waiting threads. */
+#define POOL_RECURSIVE_DEPTH 6
+#define POOL_RECURSIVE_CHILD_TASKS 3
+
+static void task_pool_recursive_func(TaskPool *__restrict pool, void *taskdata, int threadid)
+{
+  int *count = (int *)BLI_task_pool_userdata(pool);
+  const int depth = POINTER_AS_INT(taskdata);
+
+  if (depth < POOL_RECURSIVE_DEPTH) {
+    int nested_count = 0;
+    TaskPool *nested_pool = BLI_task_pool_create(pool_test_scheduler, &nested_count);
+    for (int i = 0; i < POOL_RECURSIVE_CHILD_TASKS; i++) {
+      BLI_task_pool_push_from_thread(nested_pool,
+                                     task_pool_recursive_func,
+                                     POINTER_FROM_INT(depth + 1),
+                                     false,
+                                     TASK_PRIORITY_LOW,
+                                     threadid);
+    }
+    BLI_task_pool_work_and_wait(nested_pool);
+    BLI_task_pool_free(nested_pool);
+    atomic_add_and_fetch_uint32((uint32_t *)count, (uint32_t)nested_count);
+  }
+  atomic_add_and_fetch_uint32((uint32_t *)count, 1);
+}
+
+TEST(task, PoolNestedRecursive)
+{
+  BLI_threadapi_init();
+  pool_test_scheduler = BLI_task_scheduler_create(POOL_NUM_THREADS);
+
+  int count = 0;
+  TaskPool *pool = BLI_task_pool_create(pool_test_scheduler, &count);
+  BLI_task_pool_push(
+      pool, task_pool_recursive_func, POINTER_FROM_INT(0), false, TASK_PRIORITY_LOW);
+  BLI_task_pool_work_and_wait(pool);
+  BLI_task_pool_free(pool);
+
+  /* 1 + 3 + 9 + ... + 3^6 tasks. */
+  int expected_count = 0;
+  for (int i = 0, num = 1; i <= POOL_RECURSIVE_DEPTH; i++, num *= POOL_RECURSIVE_CHILD_TASKS) {
+    expected_count += num;
+  }
+  EXPECT_EQ(expected_count, count);
+
+  BLI_task_scheduler_free(pool_test_scheduler);
+  pool_test_scheduler = NULL;
+  BLI_threadapi_exit();
+}
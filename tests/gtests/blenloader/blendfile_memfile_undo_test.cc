@@ -0,0 +1,224 @@
+/* Apache License, Version 2.0 */
+
+#include "blendfile_loading_base_test.h"
+
+#include "MEM_guardedalloc.h"
+
+extern "C" {
+#include "BLI_listbase.h"
+
+#include "BKE_customdata.h"
+#include "BKE_global.h"
+#include "BKE_lib_id.h"
+#include "BKE_main.h"
+#include "BKE_mesh.h"
+
+#include "BLO_readfile.h"
+#include "BLO_undofile.h"
+#include "BLO_writefile.h"
+
+#include "DNA_mesh_types.h"
+#include "DNA_meshdata_types.h"
+}
+
+#define MESHES_NUM 8
+#define VERTS_NUM 1000
+
+class BlendfileMemfileUndoTest : public BlendfileLoadingBaseTest {
+ protected:
+  Main *bmain;
+
+  void SetUp() override
+  {
+    BlendfileLoadingBaseTest::SetUp();
+
+    bmain = BKE_main_new();
+    for (int i = 0; i < MESHES_NUM; i++) {
+      Mesh *me = BKE_mesh_add(bmain, "Mesh");
+      me->id.us = 1;
+      me->totvert = VERTS_NUM;
+      me->mvert = (MVert *)CustomData_add_layer(
+          &me->vdata, CD_MVERT, CD_CALLOC, NULL, VERTS_NUM);
+      for (int v = 0; v < VERTS_NUM; v++) {
+        me->mvert[v].co[0] = (float)(i + v);
+      }
+    }
+  }
+
+  void TearDown() override
+  {
+    BKE_main_free(bmain);
+    BlendfileLoadingBaseTest::TearDown();
+  }
+
+  /* Number of bytes of the ID which aren't shared with a previous memfile. */
+  static uint memfile_id_size_written(const MemFile *memfile, const ID *id)
+  {
+    uint size = 0;
+    LISTBASE_FOREACH (MemFileChunk *, chunk, &memfile->chunks) {
+      if (chunk->id_session_uuid == id->session_uuid && !chunk->is_identical) {
+        size += chunk->size;
+      }
+    }
+    return size;
+  }
+
+  /* Number of bytes outside of IDs which aren't shared with a previous memfile. */
+  static uint memfile_non_id_size_written(const MemFile *memfile)
+  {
+    uint size = 0;
+    LISTBASE_FOREACH (MemFileChunk *, chunk, &memfile->chunks) {
+      if (chunk->id_session_uuid == MAIN_ID_SESSION_UUID_UNSET && !chunk->is_identical) {
+        size += chunk->size;
+      }
+    }
+    return size;
+  }
+};
+
+TEST_F(BlendfileMemfileUndoTest, ShareUnchangedIDs)
+{
+  MemFile memfile_a = {{NULL}};
+  MemFile memfile_b = {{NULL}};
+  MemFile memfile_c = {{NULL}};
+
+  ASSERT_TRUE(BLO_write_file_mem(bmain, NULL, &memfile_a, 0));
+  LISTBASE_FOREACH (ID *, id, &bmain->meshes) {
+    EXPECT_LT(0, memfile_id_size_written(&memfile_a, id));
+  }
+
+  /* Nothing changed, all meshes share the data of the previous step. */
+  ASSERT_TRUE(BLO_write_file_mem(bmain, &memfile_a, &memfile_b, 0));
+  LISTBASE_FOREACH (ID *, id, &bmain->meshes) {
+    EXPECT_EQ(0, memfile_id_size_written(&memfile_b, id));
+  }
+
+  /* Only the mesh tagged as changed is stored again. */
+  Mesh *me_changed = (Mesh *)bmain->meshes.first;
+  me_changed->mvert[0].co[1] = 42.0f;
+  BKE_lib_id_tag_undo_push(&me_changed->id, ID_RECALC_GEOMETRY);
+  ASSERT_TRUE(BLO_write_file_mem(bmain, &memfile_b, &memfile_c, 0));
+  LISTBASE_FOREACH (ID *, id, &bmain->meshes) {
+    if (id == &me_changed->id) {
+      EXPECT_LT(0, memfile_id_size_written(&memfile_c, id));
+    }
+    else {
+      EXPECT_EQ(0, memfile_id_size_written(&memfile_c, id));
+    }
+  }
+
+  /* Free older steps first, as the undo stack does. */
+  BLO_memfile_merge(&memfile_a, &memfile_b);
+
+  /* Undo to the previous step: only the changed mesh is read again, the other ones are kept. */
+  Mesh *meshes_old[MESHES_NUM];
+  int i = 0;
+  LISTBASE_FOREACH (Mesh *, me, &bmain->meshes) {
+    meshes_old[i++] = me;
+  }
+
+  BlendFileData *bfd = BLO_read_from_memfile(
+      bmain, BKE_main_blendfile_path(bmain), &memfile_b, &memfile_c, BLO_READ_SKIP_USERDEF, NULL);
+  ASSERT_NE(nullptr, bfd);
+  EXPECT_EQ(MESHES_NUM, BLI_listbase_count(&bfd->main->meshes));
+  EXPECT_EQ(1, BLI_listbase_count(&bmain->meshes));
+  EXPECT_EQ(memfile_b.serial, bfd->main->memfile_undo_serial);
+  i = 0;
+  LISTBASE_FOREACH (Mesh *, me, &bfd->main->meshes) {
+    ASSERT_EQ(VERTS_NUM, me->totvert);
+    EXPECT_EQ((float)i, me->mvert[0].co[0]);
+    EXPECT_EQ((float)(i + VERTS_NUM - 1), me->mvert[VERTS_NUM - 1].co[0]);
+    EXPECT_EQ(0.0f, me->mvert[0].co[1]);
+    if (i == 0) {
+      EXPECT_NE(meshes_old[i], me);
+      EXPECT_NE(0, me->id.recalc_after_undo_push);
+    }
+    else {
+      EXPECT_EQ(meshes_old[i], me);
+      EXPECT_EQ(0, me->id.recalc_after_undo_push);
+    }
+    i++;
+  }
+
+  BKE_main_free(bfd->main);
+  MEM_freeN(bfd);
+  BLO_memfile_merge(&memfile_b, &memfile_c);
+  BLO_memfile_free(&memfile_c);
+}
+
+/* Untouched IDs are neither written nor read again, even when their data changed without being
+ * tagged. */
+TEST_F(BlendfileMemfileUndoTest, KeepUntouchedIDs)
+{
+  MemFile memfile_a = {{NULL}};
+  MemFile memfile_b = {{NULL}};
+
+  ASSERT_TRUE(BLO_write_file_mem(bmain, NULL, &memfile_a, 0));
+  EXPECT_EQ(memfile_a.serial, bmain->memfile_undo_serial);
+
+  Mesh *me_untouched = (Mesh *)bmain->meshes.first;
+  me_untouched->mvert[0].co[1] = 42.0f;
+  ASSERT_TRUE(BLO_write_file_mem(bmain, &memfile_a, &memfile_b, 0));
+  LISTBASE_FOREACH (ID *, id, &bmain->meshes) {
+    EXPECT_EQ(0, memfile_id_size_written(&memfile_b, id));
+  }
+  EXPECT_EQ(memfile_b.serial, bmain->memfile_undo_serial);
+
+  BlendFileData *bfd = BLO_read_from_memfile(
+      bmain, BKE_main_blendfile_path(bmain), &memfile_a, &memfile_b, BLO_READ_SKIP_USERDEF, NULL);
+  ASSERT_NE(nullptr, bfd);
+  EXPECT_EQ(MESHES_NUM, BLI_listbase_count(&bfd->main->meshes));
+  EXPECT_TRUE(BLI_listbase_is_empty(&bmain->meshes));
+  EXPECT_EQ(me_untouched, bfd->main->meshes.first);
+  EXPECT_EQ(42.0f, me_untouched->mvert[0].co[1]);
+
+  /* Without a reference matching the old main, everything is read again. */
+  Main *bmain_undo = bfd->main;
+  MEM_freeN(bfd);
+  bfd = BLO_read_from_memfile(bmain_undo,
+                              BKE_main_blendfile_path(bmain_undo),
+                              &memfile_a,
+                              &memfile_b,
+                              BLO_READ_SKIP_USERDEF,
+                              NULL);
+  ASSERT_NE(nullptr, bfd);
+  EXPECT_EQ(MESHES_NUM, BLI_listbase_count(&bfd->main->meshes));
+  LISTBASE_FOREACH (Mesh *, me, &bfd->main->meshes) {
+    EXPECT_EQ(0.0f, me->mvert[0].co[1]);
+  }
+
+  BKE_main_free(bmain_undo);
+  BKE_main_free(bfd->main);
+  MEM_freeN(bfd);
+  BLO_memfile_merge(&memfile_a, &memfile_b);
+  BLO_memfile_free(&memfile_b);
+}
+
+TEST_F(BlendfileMemfileUndoTest, ShareDataAfterRemovedID)
+{
+  MemFile memfile_a = {{NULL}};
+  MemFile memfile_b = {{NULL}};
+
+  ASSERT_TRUE(BLO_write_file_mem(bmain, NULL, &memfile_a, 0));
+
+  /* Meshes tagged as changed are written again, the data following the removed mesh in the
+   * previous step is still shared. Only the mesh before it is stored again, since its #ID.next
+   * pointer changed. */
+  BKE_id_delete(bmain, bmain->meshes.last);
+  LISTBASE_FOREACH (ID *, id, &bmain->meshes) {
+    BKE_lib_id_tag_undo_push(id, ID_RECALC_GEOMETRY);
+  }
+  ASSERT_TRUE(BLO_write_file_mem(bmain, &memfile_a, &memfile_b, 0));
+  EXPECT_EQ(0, memfile_non_id_size_written(&memfile_b));
+  LISTBASE_FOREACH (ID *, id, &bmain->meshes) {
+    if (id == bmain->meshes.last) {
+      EXPECT_LT(0, memfile_id_size_written(&memfile_b, id));
+    }
+    else {
+      EXPECT_EQ(0, memfile_id_size_written(&memfile_b, id));
+    }
+  }
+
+  BLO_memfile_merge(&memfile_a, &memfile_b);
+  BLO_memfile_free(&memfile_b);
+}
@@ -0,0 +1,81 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * The Original Code is Copyright (C) 2020 by Blender Foundation.
+ */
+#include "blendfile_reconstruct_base_test.h"
+
+#include "MEM_guardedalloc.h"
+
+extern "C" {
+#include "BLI_utildefines.h"
+
+#include "DNA_genfile.h"
+#include "DNA_meshdata_types.h"
+#include "DNA_sdna_types.h"
+}
+
+void BlendfileReconstructBaseTest::SetUp()
+{
+  const char *error_message = NULL;
+  /* Copy the data, so it can be patched. */
+  oldsdna = DNA_sdna_from_data(DNAstr, DNAlen, false, true, &error_message);
+  newsdna = DNA_sdna_from_data(DNAstr, DNAlen, false, false, &error_message);
+  ASSERT_NE(nullptr, oldsdna);
+  ASSERT_NE(nullptr, newsdna);
+  ASSERT_TRUE(sdna_patch_old(oldsdna));
+
+  compflags = DNA_struct_get_compareflags(oldsdna, newsdna);
+  reconstruct_info = DNA_reconstruct_info_create(oldsdna, newsdna, compflags);
+  old_struct_nr = DNA_struct_find_nr(oldsdna, "MVert");
+  ASSERT_EQ(SDNA_CMP_NOT_EQUAL, (int)compflags[old_struct_nr]);
+}
+
+void BlendfileReconstructBaseTest::TearDown()
+{
+  if (reconstruct_info) {
+    DNA_reconstruct_info_free(reconstruct_info);
+  }
+  if (compflags) {
+    MEM_freeN((void *)compflags);
+  }
+  if (oldsdna) {
+    DNA_sdna_free(oldsdna);
+  }
+  if (newsdna) {
+    DNA_sdna_free(newsdna);
+  }
+}
+
+bool BlendfileReconstructBaseTest::sdna_patch_old(SDNA *sdna)
+{
+  return DNA_sdna_patch_struct_member(sdna, "MVert", "flag", "flag_legacy");
+}
+
+MVert *BlendfileReconstructBaseTest::verts_create(const int verts_num)
+{
+  MVert *verts = (MVert *)MEM_malloc_arrayN(verts_num, sizeof(MVert), __func__);
+  for (int i = 0; i < verts_num; i++) {
+    verts[i].co[0] = (float)i;
+    verts[i].co[1] = 1.0f;
+    verts[i].co[2] = -1.0f;
+    verts[i].no[0] = (short)i;
+    verts[i].no[1] = 0;
+    verts[i].no[2] = 32767;
+    verts[i].flag = 1;
+    verts[i].bweight = (char)(i % 128);
+  }
+  return verts;
+}
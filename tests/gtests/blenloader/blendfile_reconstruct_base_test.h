@@ -0,0 +1,48 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * The Original Code is Copyright (C) 2020 by Blender Foundation.
+ */
+#ifndef __BLENDFILE_RECONSTRUCT_BASE_TEST_H__
+#define __BLENDFILE_RECONSTRUCT_BASE_TEST_H__
+
+#include "testing/testing.h"
+
+struct DNA_ReconstructInfo;
+struct MVert;
+struct SDNA;
+
+class BlendfileReconstructBaseTest : public testing::Test {
+ protected:
+  struct SDNA *oldsdna = nullptr;
+  struct SDNA *newsdna = nullptr;
+  const char *compflags = nullptr;
+  struct DNA_ReconstructInfo *reconstruct_info = nullptr;
+  int old_struct_nr = -1;
+
+  /* Simulate a file saved by a Blender version where #MVert.flag had a different name,
+   * so vertices have to be converted field by field when reading. */
+  virtual void SetUp();
+  virtual void TearDown();
+
+ public:
+  /* Rename #MVert.flag in \a sdna, as it's named in the simulated old file. */
+  static bool sdna_patch_old(struct SDNA *sdna);
+
+  /* Vertices with distinct values in all members. */
+  static struct MVert *verts_create(const int verts_num);
+};
+
+#endif /* __BLENDFILE_RECONSTRUCT_BASE_TEST_H__ */
@@ -0,0 +1,140 @@
+/* Apache License, Version 2.0 */
+
+#include "blendfile_loading_base_test.h"
+#include "blendfile_reconstruct_base_test.h"
+
+#include "MEM_guardedalloc.h"
+
+extern "C" {
+#include "BLI_fileops.h"
+#include "BLI_path_util.h"
+#include "BLI_utildefines.h"
+
+#include "BKE_appdir.h"
+#include "BKE_customdata.h"
+#include "BKE_main.h"
+#include "BKE_mesh.h"
+
+#include "BLO_readfile.h"
+#include "BLO_writefile.h"
+
+#include "DNA_genfile.h"
+#include "DNA_mesh_types.h"
+#include "DNA_meshdata_types.h"
+#include "DNA_sdna_types.h"
+
+#include "PIL_time.h"
+
+#include "intern/readfile.h"
+}
+
+#define NUM_RUN_AVERAGED 10
+#define VERTS_NUM 1000000
+
+class BlendfileReconstructPerformanceTest : public BlendfileReconstructBaseTest {
+};
+
+TEST_F(BlendfileReconstructPerformanceTest, ReconstructPerformance)
+{
+  MVert *verts_old = verts_create(VERTS_NUM);
+
+  double averaged_timing = 0.0;
+  for (int i = 0; i < NUM_RUN_AVERAGED; i++) {
+    const double init_time = PIL_check_seconds_timer();
+    void *verts_new = DNA_struct_reconstruct(
+        reconstruct_info, old_struct_nr, VERTS_NUM, verts_old);
+    averaged_timing += PIL_check_seconds_timer() - init_time;
+    MEM_freeN(verts_new);
+  }
+  printf("Reconstructing %d vertices: done in %fs on average over %d runs\n",
+         VERTS_NUM,
+         averaged_timing / NUM_RUN_AVERAGED,
+         NUM_RUN_AVERAGED);
+
+  MEM_freeN(verts_old);
+}
+
+/* Read a file with a large mesh through #blo_read_file_internal, so vertices go through
+ * read_struct() like they do when opening a file saved by another version. */
+class BlendfileReadStructPerformanceTest : public BlendfileLoadingBaseTest {
+ protected:
+  char filepath[FILE_MAX];
+
+  void SetUp() override
+  {
+    BlendfileLoadingBaseTest::SetUp();
+
+    BKE_tempdir_init(NULL);
+    BLI_join_dirfile(
+        filepath, sizeof(filepath), BKE_tempdir_session(), "reconstruct_performance.blend");
+
+    Main *bmain = BKE_main_new();
+    Mesh *me = BKE_mesh_add(bmain, "Mesh");
+    me->id.us = 1;
+    me->totvert = VERTS_NUM;
+    MVert *verts = BlendfileReconstructBaseTest::verts_create(VERTS_NUM);
+    me->mvert = (MVert *)CustomData_add_layer(
+        &me->vdata, CD_MVERT, CD_ASSIGN, verts, VERTS_NUM);
+    ASSERT_TRUE(BLO_write_file(bmain, filepath, 0, NULL, NULL));
+    BKE_main_free(bmain);
+  }
+
+  void TearDown() override
+  {
+    BLI_delete(filepath, false, false);
+    BlendfileLoadingBaseTest::TearDown();
+  }
+
+  /* \return The time spent reading the file. */
+  double read_file(const bool use_reconstruct)
+  {
+    FileData *fd = blo_filedata_from_file(filepath, NULL);
+    EXPECT_NE(nullptr, fd);
+    if (fd == NULL) {
+      return 0.0;
+    }
+    if (use_reconstruct) {
+      /* As if the file was saved by a version where #MVert.flag had a different name. */
+      MEM_freeN((void *)fd->compflags);
+      DNA_reconstruct_info_free(fd->reconstruct_info);
+      EXPECT_TRUE(BlendfileReconstructBaseTest::sdna_patch_old(fd->filesdna));
+      fd->compflags = DNA_struct_get_compareflags(fd->filesdna, fd->memsdna);
+      fd->reconstruct_info = DNA_reconstruct_info_create(
+          fd->filesdna, fd->memsdna, fd->compflags);
+      EXPECT_EQ(SDNA_CMP_NOT_EQUAL,
+                (int)fd->compflags[DNA_struct_find_nr(fd->filesdna, "MVert")]);
+    }
+    fd->skip_flags = BLO_READ_SKIP_USERDEF;
+
+    const double init_time = PIL_check_seconds_timer();
+    bfile = blo_read_file_internal(fd, filepath);
+    const double timing = PIL_check_seconds_timer() - init_time;
+    blo_filedata_free(fd);
+
+    EXPECT_NE(nullptr, bfile);
+    if (bfile != NULL) {
+      const Mesh *me = (const Mesh *)bfile->main->meshes.first;
+      EXPECT_EQ(VERTS_NUM, me->totvert);
+      EXPECT_EQ((float)(VERTS_NUM - 1), me->mvert[VERTS_NUM - 1].co[0]);
+      EXPECT_EQ((char)((VERTS_NUM - 1) % 128), me->mvert[VERTS_NUM - 1].bweight);
+    }
+    blendfile_free();
+
+    return timing;
+  }
+};
+
+TEST_F(BlendfileReadStructPerformanceTest, ReadStructPerformance)
+{
+  for (int use_reconstruct = 0; use_reconstruct < 2; use_reconstruct++) {
+    double averaged_timing = 0.0;
+    for (int i = 0; i < NUM_RUN_AVERAGED; i++) {
+      averaged_timing += read_file(use_reconstruct);
+    }
+    printf("Reading a file with %d %s vertices: done in %fs on average over %d runs\n",
+           VERTS_NUM,
+           use_reconstruct ? "reconstructed" : "unchanged",
+           averaged_timing / NUM_RUN_AVERAGED,
+           NUM_RUN_AVERAGED);
+  }
+}
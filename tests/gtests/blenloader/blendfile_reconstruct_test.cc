@@ -0,0 +1,37 @@
+/* Apache License, Version 2.0 */
+
+#include "blendfile_reconstruct_base_test.h"
+
+#include "MEM_guardedalloc.h"
+
+extern "C" {
+#include "DNA_genfile.h"
+#include "DNA_meshdata_types.h"
+}
+
+class BlendfileReconstructTest : public BlendfileReconstructBaseTest {
+};
+
+TEST_F(BlendfileReconstructTest, ReconstructStruct)
+{
+  const int verts_num = 16;
+  MVert *verts_old = verts_create(verts_num);
+  MVert *verts_new = (MVert *)DNA_struct_reconstruct(
+      reconstruct_info, old_struct_nr, verts_num, verts_old);
+
+  ASSERT_NE(nullptr, verts_new);
+  EXPECT_EQ((int)sizeof(MVert), DNA_struct_reconstruct_size(reconstruct_info, old_struct_nr));
+  for (int i = 0; i < verts_num; i++) {
+    EXPECT_EQ(verts_old[i].co[0], verts_new[i].co[0]);
+    EXPECT_EQ(verts_old[i].co[1], verts_new[i].co[1]);
+    EXPECT_EQ(verts_old[i].co[2], verts_new[i].co[2]);
+    EXPECT_EQ(verts_old[i].no[0], verts_new[i].no[0]);
+    EXPECT_EQ(verts_old[i].no[2], verts_new[i].no[2]);
+    EXPECT_EQ(verts_old[i].bweight, verts_new[i].bweight);
+    /* Renamed field doesn't exist in the old file, so it's left zeroed. */
+    EXPECT_EQ(0, verts_new[i].flag);
+  }
+
+  MEM_freeN(verts_old);
+  MEM_freeN(verts_new);
+}
@@ -0,0 +1,330 @@
+/* Apache License, Version 2.0 */
+
+#include "blendfile_loading_base_test.h"
+
+#include "MEM_guardedalloc.h"
+
+extern "C" {
+#include "BLI_fileops.h"
+#include "BLI_listbase.h"
+#include "BLI_path_util.h"
+#include "BLI_string.h"
+#include "BLI_threads.h"
+
+#include "BKE_appdir.h"
+#include "BKE_customdata.h"
+#include "BKE_global.h"
+#include "BKE_main.h"
+#include "BKE_material.h"
+#include "BKE_mesh.h"
+#include "BKE_report.h"
+
+#include "BLO_readfile.h"
+#include "BLO_writefile.h"
+
+#include "DNA_material_types.h"
+#include "DNA_mesh_types.h"
+#include "DNA_meshdata_types.h"
+
+#include "intern/readfile.h"
+}
+
+#define MESHES_NUM 4
+/* Large enough for the vertices to span several compressed frames. */
+#define VERTS_NUM 100000
+
+class BlendfileWriteReadTest : public BlendfileLoadingBaseTest {
+ protected:
+  Main *bmain;
+  char filepath[FILE_MAX];
+
+  void SetUp() override
+  {
+    BlendfileLoadingBaseTest::SetUp();
+
+    BKE_tempdir_init(NULL);
+    BLI_join_dirfile(filepath, sizeof(filepath), BKE_tempdir_session(), "write_read_test.blend");
+
+    bmain = BKE_main_new();
+    for (int i = 0; i < MESHES_NUM; i++) {
+      Material *ma = BKE_material_add(bmain, "Material");
+      ma->r = (float)i;
+      Mesh *me = BKE_mesh_add(bmain, "Mesh");
+      me->id.us = 1;
+      me->totcol = 1;
+      me->mat = (Material **)MEM_callocN(sizeof(*me->mat), __func__);
+      me->mat[0] = ma;
+      me->totvert = VERTS_NUM;
+      me->mvert = (MVert *)CustomData_add_layer(
+          &me->vdata, CD_MVERT, CD_CALLOC, NULL, VERTS_NUM);
+      for (int v = 0; v < VERTS_NUM; v++) {
+        me->mvert[v].co[0] = (float)(i + v);
+      }
+    }
+  }
+
+  void TearDown() override
+  {
+    BKE_main_free(bmain);
+    BLI_delete(filepath, false, false);
+    BlendfileLoadingBaseTest::TearDown();
+  }
+
+  /* Compare the first bytes of the written file. */
+  bool file_has_magic(const unsigned char *magic, const size_t magic_len)
+  {
+    unsigned char header[8];
+    FILE *file = BLI_fopen(filepath, "rb");
+    if (file == NULL) {
+      return false;
+    }
+    const bool ok = fread(header, 1, magic_len, file) == magic_len &&
+                    memcmp(header, magic, magic_len) == 0;
+    fclose(file);
+    return ok;
+  }
+
+  /* Replace the file with its first \a size bytes, or with its content where the \a len bytes at
+   * \a offset are overwritten by \a data. Rewrites the file in place, as a file being saved by
+   * another process would be. */
+  bool file_rewrite(const size_t size, const size_t offset, const void *data, const size_t len)
+  {
+    size_t file_size = BLI_file_size(filepath);
+    char *content = (char *)MEM_mallocN(file_size, __func__);
+    FILE *file = BLI_fopen(filepath, "rb");
+    bool ok = (file != NULL) && (fread(content, 1, file_size, file) == file_size);
+    if (file != NULL) {
+      fclose(file);
+    }
+    if (ok && len != 0) {
+      ok = (offset + len <= file_size);
+      if (ok) {
+        memcpy(content + offset, data, len);
+      }
+    }
+    if (ok) {
+      file_size = MIN2(file_size, size);
+      file = BLI_fopen(filepath, "wb");
+      ok = (file != NULL) && (fwrite(content, 1, file_size, file) == file_size);
+      if (file != NULL) {
+        fclose(file);
+      }
+    }
+    MEM_freeN(content);
+    return ok;
+  }
+
+  bool file_truncate(const size_t size)
+  {
+    return file_rewrite(size, 0, NULL, 0);
+  }
+
+  bool file_overwrite(const size_t offset, const void *data, const size_t len)
+  {
+    return file_rewrite(SIZE_MAX, offset, data, len);
+  }
+
+  /* Whether reading the file uses the index of block offsets written after #ENDB. */
+  bool file_uses_bhead_index()
+  {
+    FileData *fd = blo_filedata_from_file(filepath, NULL);
+    if (fd == NULL) {
+      return false;
+    }
+    const bool use_index = (fd->flags & FD_FLAGS_USE_BHEAD_INDEX) != 0;
+    blo_filedata_free(fd);
+    return use_index;
+  }
+
+  void read_compare()
+  {
+    bfile = BLO_read_from_file(filepath, BLO_READ_SKIP_USERDEF, NULL);
+    ASSERT_NE(nullptr, bfile);
+    ASSERT_EQ(MESHES_NUM, BLI_listbase_count(&bfile->main->meshes));
+    int i = 0;
+    LISTBASE_FOREACH (Mesh *, me, &bfile->main->meshes) {
+      ASSERT_EQ(VERTS_NUM, me->totvert);
+      ASSERT_NE(nullptr, me->mvert);
+      for (int v = 0; v < VERTS_NUM; v++) {
+        ASSERT_EQ((float)(i + v), me->mvert[v].co[0]);
+      }
+      ASSERT_EQ(1, me->totcol);
+      ASSERT_NE(nullptr, me->mat[0]);
+      EXPECT_EQ((float)i, me->mat[0]->r);
+      i++;
+    }
+  }
+
+  void write_read_compare(const int write_flags)
+  {
+    ASSERT_TRUE(BLO_write_file(bmain, filepath, write_flags, NULL, NULL));
+    read_compare();
+  }
+};
+
+TEST_F(BlendfileWriteReadTest, Uncompressed)
+{
+  const unsigned char magic[] = {'B', 'L', 'E', 'N', 'D', 'E', 'R'};
+  write_read_compare(0);
+  EXPECT_TRUE(file_has_magic(magic, sizeof(magic)));
+}
+
+TEST_F(BlendfileWriteReadTest, CompressedZlib)
+{
+  const unsigned char magic[] = {0x1f, 0x8b};
+  write_read_compare(G_FILE_COMPRESS);
+  EXPECT_TRUE(file_has_magic(magic, sizeof(magic)));
+}
+
+TEST_F(BlendfileWriteReadTest, CompressedZstd)
+{
+  write_read_compare(G_FILE_COMPRESS | G_FILE_COMPRESS_ZSTD);
+#ifdef WITH_ZSTD
+  const unsigned char magic[] = {0x28, 0xb5, 0x2f, 0xfd};
+#else
+  /* Without Zstandard, zlib is used instead. */
+  const unsigned char magic[] = {0x1f, 0x8b};
+#endif
+  EXPECT_TRUE(file_has_magic(magic, sizeof(magic)));
+}
+
+TEST_F(BlendfileWriteReadTest, IndexUsed)
+{
+  ASSERT_TRUE(BLO_write_file(bmain, filepath, 0, NULL, NULL));
+  EXPECT_TRUE(file_uses_bhead_index());
+  read_compare();
+}
+
+TEST_F(BlendfileWriteReadTest, IndexMissingFooter)
+{
+  ASSERT_TRUE(BLO_write_file(bmain, filepath, 0, NULL, NULL));
+  ASSERT_TRUE(file_truncate(BLI_file_size(filepath) - BLEND_BHEAD_INDEX_FOOTER_SIZE));
+  EXPECT_FALSE(file_uses_bhead_index());
+  read_compare();
+}
+
+TEST_F(BlendfileWriteReadTest, IndexCorruptFooterMagic)
+{
+  ASSERT_TRUE(BLO_write_file(bmain, filepath, 0, NULL, NULL));
+  const char magic[] = "XXINDEX";
+  ASSERT_TRUE(file_overwrite(BLI_file_size(filepath) - sizeof(magic), magic, sizeof(magic)));
+  EXPECT_FALSE(file_uses_bhead_index());
+  read_compare();
+}
+
+TEST_F(BlendfileWriteReadTest, IndexCorruptFooterOffset)
+{
+  ASSERT_TRUE(BLO_write_file(bmain, filepath, 0, NULL, NULL));
+  const size_t file_size = BLI_file_size(filepath);
+  const size_t footer_offset = file_size - BLEND_BHEAD_INDEX_FOOTER_SIZE;
+  /* Beyond the end of the file, into the #ENDB block and into the header of the file. */
+  const int64_t offsets[] = {(int64_t)file_size * 2, (int64_t)footer_offset - 40, 4};
+  for (int i = 0; i < ARRAY_SIZE(offsets); i++) {
+    ASSERT_TRUE(BLO_write_file(bmain, filepath, 0, NULL, NULL));
+    ASSERT_TRUE(file_overwrite(footer_offset, &offsets[i], sizeof(offsets[i])));
+    EXPECT_FALSE(file_uses_bhead_index());
+    read_compare();
+    BLO_blendfiledata_free(bfile);
+    bfile = nullptr;
+  }
+}
+
+TEST_F(BlendfileWriteReadTest, IndexCorruptOffsets)
+{
+  ASSERT_TRUE(BLO_write_file(bmain, filepath, 0, NULL, NULL));
+  const size_t footer_offset = BLI_file_size(filepath) - BLEND_BHEAD_INDEX_FOOTER_SIZE;
+  int64_t index_offset;
+  FILE *file = BLI_fopen(filepath, "rb");
+  ASSERT_NE(nullptr, file);
+  ASSERT_EQ(0, fseek(file, (long)footer_offset, SEEK_SET));
+  ASSERT_EQ(1, fread(&index_offset, sizeof(index_offset), 1, file));
+  fclose(file);
+
+  /* The first block offset of the index, after the #BHead of the #INDX block. Point it into the
+   * middle of the first block, into the file header and before the start of the file. */
+  const size_t first_offset = (size_t)index_offset + sizeof(BHead8);
+  const int64_t offsets[] = {SIZEOFBLENDERHEADER + 3, SIZEOFBLENDERHEADER - 1, -1, 0};
+  for (int i = 0; i < ARRAY_SIZE(offsets); i++) {
+    ASSERT_TRUE(BLO_write_file(bmain, filepath, 0, NULL, NULL));
+    ASSERT_TRUE(file_overwrite(first_offset, &offsets[i], sizeof(offsets[i])));
+    EXPECT_FALSE(file_uses_bhead_index());
+    read_compare();
+    BLO_blendfiledata_free(bfile);
+    bfile = nullptr;
+  }
+}
+
+TEST_F(BlendfileWriteReadTest, Truncated)
+{
+  ASSERT_TRUE(BLO_write_file(bmain, filepath, 0, NULL, NULL));
+  ASSERT_TRUE(file_truncate(BLI_file_size(filepath) / 2));
+
+  /* The #DNA1 block at the end of the file is missing, reading fails without crashing. */
+  ReportList reports;
+  BKE_reports_init(&reports, RPT_STORE);
+  bfile = BLO_read_from_file(filepath, BLO_READ_SKIP_USERDEF, &reports);
+  EXPECT_EQ(nullptr, bfile);
+  EXPECT_NE(nullptr, BKE_reports_last_displayable(&reports));
+  BKE_reports_clear(&reports);
+}
+
+#ifndef WIN32
+TEST_F(BlendfileWriteReadTest, TruncatedWhileMapped)
+{
+  ASSERT_TRUE(BLO_write_file(bmain, filepath, 0, NULL, NULL));
+
+  ReportList reports;
+  BKE_reports_init(&reports, RPT_STORE);
+  FileData *fd = blo_filedata_from_file(filepath, &reports);
+  ASSERT_NE(nullptr, fd);
+  ASSERT_NE(nullptr, fd->mmap_file);
+
+  /* Accessing the mapping past the new end of the file raises SIGBUS,
+   * reading must fail instead of crashing or returning zeroed data. */
+  ASSERT_TRUE(file_truncate(BLI_file_size(filepath) / 2));
+  fd->reports = &reports;
+  fd->skip_flags = BLO_READ_SKIP_USERDEF;
+  bfile = blo_read_file_internal(fd, filepath);
+  blo_filedata_free(fd);
+
+  EXPECT_EQ(nullptr, bfile);
+  EXPECT_NE(nullptr, BKE_reports_last_displayable(&reports));
+  BKE_reports_clear(&reports);
+}
+#endif
+
+TEST_F(BlendfileWriteReadTest, DirectLinkParallel)
+{
+  ASSERT_TRUE(BLO_write_file(bmain, filepath, 0, NULL, NULL));
+
+  /* ID's are linked on the reading thread when there is a single thread. */
+  BLI_system_num_threads_override_set(1);
+  BlendFileData *bfd_serial = BLO_read_from_file(filepath, BLO_READ_SKIP_USERDEF, NULL);
+  BLI_system_num_threads_override_set(4);
+  bfile = BLO_read_from_file(filepath, BLO_READ_SKIP_USERDEF, NULL);
+  BLI_system_num_threads_override_set(0);
+
+  ASSERT_NE(nullptr, bfd_serial);
+  ASSERT_NE(nullptr, bfile);
+  ASSERT_EQ(BLI_listbase_count(&bfd_serial->main->meshes),
+            BLI_listbase_count(&bfile->main->meshes));
+  ASSERT_EQ(BLI_listbase_count(&bfd_serial->main->materials),
+            BLI_listbase_count(&bfile->main->materials));
+
+  Mesh *me_serial = (Mesh *)bfd_serial->main->meshes.first;
+  LISTBASE_FOREACH (Mesh *, me, &bfile->main->meshes) {
+    EXPECT_STREQ(me_serial->id.name, me->id.name);
+    EXPECT_EQ(me_serial->id.us, me->id.us);
+    ASSERT_EQ(me_serial->totvert, me->totvert);
+    ASSERT_EQ(me_serial->vdata.totlayer, me->vdata.totlayer);
+    EXPECT_EQ(0, memcmp(me_serial->mvert, me->mvert, sizeof(MVert) * me->totvert));
+    /* The vertex layer is the one the mesh points to, in both cases. */
+    EXPECT_EQ(me->mvert, CustomData_get_layer(&me->vdata, CD_MVERT));
+    ASSERT_EQ(me_serial->totcol, me->totcol);
+    EXPECT_STREQ(me_serial->mat[0]->id.name, me->mat[0]->id.name);
+    EXPECT_NE(-1, BLI_findindex(&bfile->main->materials, me->mat[0]));
+    me_serial = (Mesh *)me_serial->id.next;
+  }
+
+  BLO_blendfiledata_free(bfd_serial);
+}
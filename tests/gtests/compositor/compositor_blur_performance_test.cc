@@ -0,0 +1,73 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include "COM_FastGaussianBlurOperation.h"
+#include "COM_MemoryBuffer.h"
+
+#include "MEM_guardedalloc.h"
+
+extern "C" {
+#include "PIL_time.h"
+}
+
+#define NUM_RUN_AVERAGED 10
+#define WIDTH 1920
+#define HEIGHT 1080
+
+static MemoryBuffer *color_buffer_create(const int width, const int height)
+{
+  rcti rect;
+  BLI_rcti_init(&rect, 0, width, 0, height);
+  MemoryBuffer *buffer = new MemoryBuffer(COM_DT_COLOR, &rect);
+  float *data = buffer->getBuffer();
+  for (int i = 0; i < width * height * COM_NUM_CHANNELS_COLOR; i++) {
+    data[i] = (float)((i * 7919u) % 1013u) / 1013.0f;
+  }
+  return buffer;
+}
+
+static void iir_gauss_performance(const float sigma)
+{
+  MemoryBuffer *buffer = color_buffer_create(WIDTH, HEIGHT);
+
+  double averaged_timing = 0.0;
+  for (int i = 0; i < NUM_RUN_AVERAGED; i++) {
+    const double init_time = PIL_check_seconds_timer();
+    for (int c = 0; c < COM_NUM_CHANNELS_COLOR; c++) {
+      FastGaussianBlurOperation::IIR_gauss(buffer, sigma, c, 3);
+    }
+    averaged_timing += PIL_check_seconds_timer() - init_time;
+  }
+  printf("IIR gauss %dx%d, sigma %.1f, per channel: done in %fs on average over %d runs\n",
+         WIDTH,
+         HEIGHT,
+         sigma,
+         averaged_timing / NUM_RUN_AVERAGED,
+         NUM_RUN_AVERAGED);
+
+  averaged_timing = 0.0;
+  for (int i = 0; i < NUM_RUN_AVERAGED; i++) {
+    const double init_time = PIL_check_seconds_timer();
+    FastGaussianBlurOperation::IIR_gauss_color(buffer, sigma, 3);
+    averaged_timing += PIL_check_seconds_timer() - init_time;
+  }
+  printf("IIR gauss %dx%d, sigma %.1f, all channels: done in %fs on average over %d runs\n",
+         WIDTH,
+         HEIGHT,
+         sigma,
+         averaged_timing / NUM_RUN_AVERAGED,
+         NUM_RUN_AVERAGED);
+
+  delete buffer;
+}
+
+TEST(compositor_blur, IIRGaussSmall)
+{
+  iir_gauss_performance(2.0f);
+}
+
+TEST(compositor_blur, IIRGaussLarge)
+{
+  iir_gauss_performance(50.0f);
+}
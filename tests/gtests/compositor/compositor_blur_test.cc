@@ -0,0 +1,108 @@
+/* Apache License, Version 2.0 */
+
+#include "compositor_execution_base_test.h"
+
+#include "COM_FastGaussianBlurOperation.h"
+#include "COM_GaussianXBlurOperation.h"
+#include "COM_GaussianYBlurOperation.h"
+#include "COM_MemoryBuffer.h"
+#include "COM_ReadBufferOperation.h"
+#include "COM_SetValueOperation.h"
+#include "COM_WriteBufferOperation.h"
+
+#include "MEM_guardedalloc.h"
+
+extern "C" {
+#include "DNA_scene_types.h"
+}
+
+static MemoryBuffer *color_buffer_create(const int width, const int height)
+{
+  rcti rect;
+  BLI_rcti_init(&rect, 0, width, 0, height);
+  MemoryBuffer *buffer = new MemoryBuffer(COM_DT_COLOR, &rect);
+  float *data = buffer->getBuffer();
+  for (int i = 0; i < width * height * COM_NUM_CHANNELS_COLOR; i++) {
+    data[i] = (float)((i * 7919u) % 1013u) / 1013.0f;
+  }
+  return buffer;
+}
+
+static void iir_compare(const int width, const int height, const float sigma, const int xy)
+{
+  MemoryBuffer *per_channel = color_buffer_create(width, height);
+  MemoryBuffer *color = color_buffer_create(width, height);
+
+  for (int c = 0; c < COM_NUM_CHANNELS_COLOR; c++) {
+    FastGaussianBlurOperation::IIR_gauss(per_channel, sigma, c, xy);
+  }
+  FastGaussianBlurOperation::IIR_gauss_color(color, sigma, xy);
+
+  const float *a = per_channel->getBuffer();
+  const float *b = color->getBuffer();
+  for (int i = 0; i < width * height * COM_NUM_CHANNELS_COLOR; i++) {
+    EXPECT_NEAR(a[i], b[i], 1e-6f);
+  }
+
+  delete per_channel;
+  delete color;
+}
+
+TEST(compositor_blur, IIRGaussColorMatchesChannels)
+{
+  iir_compare(64, 48, 4.0f, 3);
+  iir_compare(37, 53, 12.5f, 1);
+  iir_compare(37, 53, 0.7f, 2);
+  /* Too small to blur along X. */
+  iir_compare(2, 17, 3.0f, 3);
+}
+
+class CompositorBlurTest : public CompositorExecutionBaseTest {
+ protected:
+  /* Buffer of the operation, which is read like by complex operations. */
+  ReadBufferOperation *add_buffer(NodeOperation *operation)
+  {
+    WriteBufferOperation *write = add(new WriteBufferOperation(COM_DT_COLOR));
+    ReadBufferOperation *read = add(new ReadBufferOperation(COM_DT_COLOR));
+    link(operation, write, 0);
+    read->setMemoryProxy(write->getMemoryProxy());
+    return read;
+  }
+};
+
+/* The gaussian blur calculates whole buffers in full frame execution, the result is the same as
+ * reading it pixel by pixel. */
+TEST_F(CompositorBlurTest, GaussianFullFrameMatchesTiled)
+{
+  NodeBlurData data = {0};
+  data.sizex = 7;
+  data.sizey = 4;
+  data.filtertype = R_FILTER_GAUSS;
+
+  TestGradientOperation *gradient = add(new TestGradientOperation(COM_DT_COLOR));
+  SetValueOperation *size = add(new SetValueOperation());
+  size->setValue(1.0f);
+  ReadBufferOperation *gradient_buffer = add_buffer(gradient);
+  GaussianXBlurOperation *blur_x = add(new GaussianXBlurOperation());
+  blur_x->setData(&data);
+  link(gradient_buffer, blur_x, 0);
+  link(size, blur_x, 1);
+  ReadBufferOperation *blur_x_buffer = add_buffer(blur_x);
+  GaussianYBlurOperation *blur_y = add(new GaussianYBlurOperation());
+  blur_y->setData(&data);
+  link(blur_x_buffer, blur_y, 0);
+  link(size, blur_y, 1);
+  ReadBufferOperation *blur_y_buffer = add_buffer(blur_y);
+  TestOutputOperation *output = add(new TestOutputOperation(COM_DT_COLOR));
+  link(blur_y_buffer, output, 0);
+
+  std::set<NodeOperation *> calculated;
+  compare_full_frame_to_tiled(output, 61, 37, calculated);
+  EXPECT_TRUE(calculated.count(blur_x));
+  EXPECT_TRUE(calculated.count(blur_y));
+
+  /* Not just copied. */
+  float color[4];
+  gradient->executePixelSampled(color, 0, 10, COM_PS_NEAREST);
+  EXPECT_NE(color[0], output->result[10 * 61 * COM_NUM_CHANNELS_COLOR]);
+}
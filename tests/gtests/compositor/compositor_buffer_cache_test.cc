@@ -0,0 +1,83 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include "COM_BufferCache.h"
+#include "COM_MemoryBuffer.h"
+
+#include "MEM_guardedalloc.h"
+
+extern "C" {
+#include "DNA_userdef_types.h"
+}
+
+static MemoryBuffer *value_buffer_create(const int width, const int height, const float value)
+{
+  rcti rect;
+  BLI_rcti_init(&rect, 0, width, 0, height);
+  MemoryBuffer *buffer = new MemoryBuffer(COM_DT_VALUE, &rect);
+  float *data = buffer->getBuffer();
+  for (int i = 0; i < width * height; i++) {
+    data[i] = value;
+  }
+  return buffer;
+}
+
+TEST(compositor_buffer_cache, ReadWrite)
+{
+  U.compositor_cache_limit = 1;
+  MemoryBuffer *source = value_buffer_create(64, 32, 0.5f);
+  MemoryBuffer *target = value_buffer_create(64, 32, 0.0f);
+
+  EXPECT_FALSE(BufferCache::contains(1, COM_DT_VALUE, 64, 32));
+  EXPECT_FALSE(BufferCache::read(1, target));
+  BufferCache::write(1, source);
+  EXPECT_EQ(sizeof(float) * 64 * 32, BufferCache::getMemoryInUse());
+
+  /* Size and type must match. */
+  EXPECT_TRUE(BufferCache::contains(1, COM_DT_VALUE, 64, 32));
+  EXPECT_FALSE(BufferCache::contains(1, COM_DT_COLOR, 64, 32));
+  EXPECT_FALSE(BufferCache::contains(1, COM_DT_VALUE, 32, 64));
+
+  EXPECT_TRUE(BufferCache::read(1, target));
+  EXPECT_EQ(0.5f, target->getBuffer()[0]);
+  EXPECT_EQ(0.5f, target->getBuffer()[64 * 32 - 1]);
+
+  BufferCache::clear();
+  EXPECT_EQ((size_t)0, BufferCache::getMemoryInUse());
+  EXPECT_FALSE(BufferCache::contains(1, COM_DT_VALUE, 64, 32));
+
+  delete source;
+  delete target;
+}
+
+TEST(compositor_buffer_cache, LeastRecentlyUsedIsFreed)
+{
+  /* Room for three buffers of 320 KB. */
+  U.compositor_cache_limit = 1;
+  MemoryBuffer *buffer = value_buffer_create(320, 256, 1.0f);
+
+  BufferCache::write(1, buffer);
+  BufferCache::write(2, buffer);
+  BufferCache::write(3, buffer);
+  EXPECT_TRUE(BufferCache::read(1, buffer));
+  BufferCache::write(4, buffer);
+  BufferCache::write(5, buffer);
+
+  EXPECT_TRUE(BufferCache::contains(1, COM_DT_VALUE, 320, 256));
+  EXPECT_FALSE(BufferCache::contains(2, COM_DT_VALUE, 320, 256));
+  EXPECT_FALSE(BufferCache::contains(3, COM_DT_VALUE, 320, 256));
+  EXPECT_TRUE(BufferCache::contains(4, COM_DT_VALUE, 320, 256));
+  EXPECT_TRUE(BufferCache::contains(5, COM_DT_VALUE, 320, 256));
+  EXPECT_LE(BufferCache::getMemoryInUse(), (size_t)1024 * 1024);
+
+  /* Buffers larger than the limit are not cached. */
+  MemoryBuffer *large = value_buffer_create(1024, 512, 1.0f);
+  BufferCache::write(6, large);
+  EXPECT_FALSE(BufferCache::contains(6, COM_DT_VALUE, 1024, 512));
+  EXPECT_TRUE(BufferCache::contains(5, COM_DT_VALUE, 320, 256));
+
+  BufferCache::clear();
+  delete buffer;
+  delete large;
+}
@@ -0,0 +1,233 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * The Original Code is Copyright (C) 2020 by Blender Foundation.
+ */
+#include "compositor_execution_base_test.h"
+
+#include <cstring>
+
+#include "COM_ExecutionGroup.h"
+#include "COM_FullFrameExecutionModel.h"
+#include "COM_ReadBufferOperation.h"
+
+#include "MEM_guardedalloc.h"
+
+extern "C" {
+#include "BLI_threads.h"
+}
+
+static int channels_num(DataType datatype)
+{
+  return (datatype == COM_DT_VALUE) ? COM_NUM_CHANNELS_VALUE :
+                                      (datatype == COM_DT_VECTOR) ? COM_NUM_CHANNELS_VECTOR :
+                                                                    COM_NUM_CHANNELS_COLOR;
+}
+
+TestGradientOperation::TestGradientOperation(DataType datatype)
+{
+  this->addOutputSocket(datatype);
+}
+
+void TestGradientOperation::executePixelSampled(float output[4],
+                                                float x,
+                                                float y,
+                                                PixelSampler /*sampler*/)
+{
+  for (int c = 0; c < 4; c++) {
+    const int value = ((int)x * 7 + (int)y * 13 + c * 5) % 31;
+    output[c] = (float)value / 31.0f * 2.0f - 0.5f;
+  }
+}
+
+TestOutputOperation::TestOutputOperation(DataType datatype) : m_input(NULL)
+{
+  this->addInputSocket(datatype);
+}
+
+void TestOutputOperation::initExecution()
+{
+  m_input = this->getInputSocketReader(0);
+  result.assign((size_t)getWidth() * getHeight() * channels_num(getInputSocket(0)->getDataType()),
+                0.0f);
+}
+
+void TestOutputOperation::deinitExecution()
+{
+  m_input = NULL;
+}
+
+void TestOutputOperation::executeRegion(rcti *rect, unsigned int /*tileNumber*/)
+{
+  const int num_channels = channels_num(getInputSocket(0)->getDataType());
+  for (int y = rect->ymin; y < rect->ymax; y++) {
+    for (int x = rect->xmin; x < rect->xmax; x++) {
+      float color[4];
+      m_input->readSampled(color, x, y, COM_PS_NEAREST);
+      memcpy(&result[((size_t)y * getWidth() + x) * num_channels],
+             color,
+             sizeof(float) * num_channels);
+    }
+  }
+}
+
+static void test_progress(void * /*prh*/, float /*progress*/)
+{
+}
+
+static void test_stats_draw(void * /*sdh*/, const char * /*str*/)
+{
+}
+
+static int test_break(void * /*tbh*/)
+{
+  return 0;
+}
+
+void CompositorExecutionBaseTest::SetUpTestCase()
+{
+  BLI_threadapi_init();
+}
+
+void CompositorExecutionBaseTest::TearDownTestCase()
+{
+  BLI_threadapi_exit();
+}
+
+void CompositorExecutionBaseTest::SetUp()
+{
+  memset(&tree, 0, sizeof(tree));
+  tree.progress = test_progress;
+  tree.stats_draw = test_stats_draw;
+  tree.test_break = test_break;
+  context.setbNodeTree(&tree);
+  context.setRendering(false);
+}
+
+void CompositorExecutionBaseTest::TearDown()
+{
+  for (size_t i = 0; i < operations.size(); i++) {
+    delete operations[i];
+  }
+  operations.clear();
+}
+
+void CompositorExecutionBaseTest::link(NodeOperation *from, NodeOperation *to, unsigned int index)
+{
+  to->getInputSocket(index)->setLink(from->getOutputSocket());
+}
+
+void CompositorExecutionBaseTest::link_unconnected(NodeOperation *from, NodeOperation *to)
+{
+  for (unsigned int index = 0; index < to->getNumberOfInputSockets(); index++) {
+    if (!to->getInputSocket(index)->isConnected()) {
+      link(from, to, index);
+    }
+  }
+}
+
+void CompositorExecutionBaseTest::set_resolutions(unsigned int width, unsigned int height)
+{
+  unsigned int resolution[2] = {width, height};
+  for (size_t i = 0; i < operations.size(); i++) {
+    operations[i]->setResolution(resolution);
+  }
+}
+
+void CompositorExecutionBaseTest::init_execution()
+{
+  for (size_t i = 0; i < operations.size(); i++) {
+    if (operations[i]->isWriteBufferOperation()) {
+      operations[i]->setbNodeTree(&tree);
+      operations[i]->initExecution();
+    }
+  }
+  for (size_t i = 0; i < operations.size(); i++) {
+    if (operations[i]->isReadBufferOperation()) {
+      ((ReadBufferOperation *)operations[i])->updateMemoryBuffer();
+    }
+  }
+  for (size_t i = 0; i < operations.size(); i++) {
+    if (!operations[i]->isWriteBufferOperation()) {
+      operations[i]->setbNodeTree(&tree);
+      operations[i]->initExecution();
+    }
+  }
+}
+
+void CompositorExecutionBaseTest::deinit_execution()
+{
+  for (size_t i = 0; i < operations.size(); i++) {
+    operations[i]->deinitExecution();
+  }
+}
+
+void CompositorExecutionBaseTest::execute_tiled(TestOutputOperation *output)
+{
+  init_execution();
+  for (size_t i = 0; i < operations.size(); i++) {
+    if (operations[i]->isWriteBufferOperation()) {
+      rcti rect;
+      BLI_rcti_init(&rect, 0, operations[i]->getWidth(), 0, operations[i]->getHeight());
+      operations[i]->executeRegion(&rect, 0);
+    }
+  }
+  rcti rect;
+  BLI_rcti_init(&rect, 0, output->getWidth(), 0, output->getHeight());
+  output->executeRegion(&rect, 0);
+  deinit_execution();
+}
+
+std::set<NodeOperation *> CompositorExecutionBaseTest::execute_full_frame(
+    TestOutputOperation *output)
+{
+  ExecutionGroup group;
+  group.addOperation(output);
+  unsigned int resolution[2];
+  group.determineResolution(resolution);
+  std::vector<ExecutionGroup *> groups(1, &group);
+  std::set<NodeOperation *> cached_write_buffers;
+
+  FullFrameExecutionModel *model = new FullFrameExecutionModel(
+      context, groups, cached_write_buffers);
+  init_execution();
+  EXPECT_TRUE(model->execute());
+
+  std::set<NodeOperation *> calculated;
+  for (size_t i = 0; i < operations.size(); i++) {
+    if (model->isCalculated(operations[i])) {
+      calculated.insert(operations[i]);
+    }
+  }
+  deinit_execution();
+  delete model;
+  return calculated;
+}
+
+void CompositorExecutionBaseTest::compare_full_frame_to_tiled(
+    TestOutputOperation *output,
+    unsigned int width,
+    unsigned int height,
+    std::set<NodeOperation *> &r_calculated)
+{
+  set_resolutions(width, height);
+  execute_tiled(output);
+  const std::vector<float> expected = output->result;
+  r_calculated = execute_full_frame(output);
+  ASSERT_EQ(expected.size(), output->result.size());
+  for (size_t i = 0; i < expected.size(); i++) {
+    EXPECT_FLOAT_EQ(expected[i], output->result[i]) << "at " << i;
+  }
+}
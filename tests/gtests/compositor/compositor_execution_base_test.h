@@ -0,0 +1,101 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * The Original Code is Copyright (C) 2020 by Blender Foundation.
+ */
+#ifndef __COMPOSITOR_EXECUTION_BASE_TEST_H__
+#define __COMPOSITOR_EXECUTION_BASE_TEST_H__
+
+#include "testing/testing.h"
+
+#include <set>
+#include <vector>
+
+#include "COM_CompositorContext.h"
+#include "COM_NodeOperation.h"
+
+extern "C" {
+#include "DNA_node_types.h"
+}
+
+/* Input which differs at every pixel, not a point operation. */
+class TestGradientOperation : public NodeOperation {
+ public:
+  TestGradientOperation(DataType datatype);
+  void executePixelSampled(float output[4], float x, float y, PixelSampler sampler) override;
+};
+
+/* Output storing the pixels of its input, like a viewer. */
+class TestOutputOperation : public NodeOperation {
+ private:
+  SocketReader *m_input;
+
+ public:
+  std::vector<float> result;
+
+  TestOutputOperation(DataType datatype);
+  bool isOutputOperation(bool /*rendering*/) const override
+  {
+    return true;
+  }
+  void initExecution() override;
+  void deinitExecution() override;
+  void executeRegion(rcti *rect, unsigned int tileNumber) override;
+};
+
+/* Executes operations linked by hand, without node tree. */
+class CompositorExecutionBaseTest : public testing::Test {
+ protected:
+  bNodeTree tree;
+  CompositorContext context;
+  /* Freed after the test. */
+  std::vector<NodeOperation *> operations;
+
+  static void SetUpTestCase();
+  static void TearDownTestCase();
+  void SetUp() override;
+  void TearDown() override;
+
+  template<typename T> T *add(T *operation)
+  {
+    operations.push_back(operation);
+    return operation;
+  }
+  static void link(NodeOperation *from, NodeOperation *to, unsigned int index);
+  /* Link the inputs without link, like the constants of unlinked node sockets. */
+  static void link_unconnected(NodeOperation *from, NodeOperation *to);
+
+  /* Resolution of all operations which don't have one. */
+  void set_resolutions(unsigned int width, unsigned int height);
+
+  /* Initialize write buffers first, like ExecutionSystem, read buffers point to them. */
+  void init_execution();
+  void deinit_execution();
+
+  /* Read the output pixel by pixel through the operations, like a tile. Write buffers are
+   * calculated before, in the order they were added. */
+  void execute_tiled(TestOutputOperation *output);
+
+  /* Calculate the operations into buffers, returns the operations which were calculated. */
+  std::set<NodeOperation *> execute_full_frame(TestOutputOperation *output);
+
+  /* Result of the output with tiled execution, then with full frame execution. */
+  void compare_full_frame_to_tiled(TestOutputOperation *output,
+                                   unsigned int width,
+                                   unsigned int height,
+                                   std::set<NodeOperation *> &r_calculated);
+};
+
+#endif /* __COMPOSITOR_EXECUTION_BASE_TEST_H__ */
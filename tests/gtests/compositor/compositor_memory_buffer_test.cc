@@ -0,0 +1,97 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include "COM_MemoryBuffer.h"
+
+#include "MEM_guardedalloc.h"
+
+extern "C" {
+#include "BKE_appdir.h"
+#include "BLI_fileops.h"
+#include "BLI_path_util.h"
+}
+
+TEST(compositor_memory_buffer, SwapOutIn)
+{
+  BKE_tempdir_init(NULL);
+  char filepath[FILE_MAX];
+  BLI_join_dirfile(filepath, sizeof(filepath), BKE_tempdir_base(), "compositor_test.swap");
+
+  rcti rect;
+  BLI_rcti_init(&rect, 0, 16, 0, 8);
+  MemoryBuffer *buffer = new MemoryBuffer(COM_DT_COLOR, &rect);
+  EXPECT_EQ(sizeof(float) * 4 * 16 * 8, buffer->getMemorySize());
+  float *data = buffer->getBuffer();
+  for (int i = 0; i < 4 * 16 * 8; i++) {
+    data[i] = (float)i;
+  }
+
+  EXPECT_TRUE(buffer->swapOut(filepath));
+  EXPECT_TRUE(buffer->isSwappedOut());
+  EXPECT_EQ(NULL, buffer->getBuffer());
+  EXPECT_TRUE(BLI_exists(filepath));
+
+  EXPECT_TRUE(buffer->swapIn());
+  EXPECT_FALSE(buffer->isSwappedOut());
+  EXPECT_FALSE(BLI_exists(filepath));
+  data = buffer->getBuffer();
+  EXPECT_EQ(0.0f, data[0]);
+  EXPECT_EQ((float)(4 * 16 * 8 - 1), data[4 * 16 * 8 - 1]);
+
+  /* The file is removed when the buffer is freed while swapped out. */
+  EXPECT_TRUE(buffer->swapOut(filepath));
+  delete buffer;
+  EXPECT_FALSE(BLI_exists(filepath));
+}
+
+TEST(compositor_memory_buffer, SwapInMissingFile)
+{
+  BKE_tempdir_init(NULL);
+  char filepath[FILE_MAX];
+  BLI_join_dirfile(filepath, sizeof(filepath), BKE_tempdir_base(), "compositor_test.swap");
+
+  rcti rect;
+  BLI_rcti_init(&rect, 0, 16, 0, 8);
+  MemoryBuffer *buffer = new MemoryBuffer(COM_DT_COLOR, &rect);
+  EXPECT_TRUE(buffer->swapOut(filepath));
+  BLI_delete(filepath, false, false);
+
+  /* The failure is returned, the buffer is left without data. */
+  EXPECT_FALSE(buffer->swapIn());
+  EXPECT_FALSE(buffer->isSwappedOut());
+  EXPECT_EQ(NULL, buffer->getBuffer());
+  delete buffer;
+}
+
+TEST(compositor_memory_buffer, PackHalf)
+{
+  const float values[] = {0.0f, -0.0f, 1.0f, -2.5f, 0.333333f, 1e-5f, 65504.0f, 1e10f, -1e10f};
+  const int num = sizeof(values) / sizeof(*values);
+  rcti rect;
+  BLI_rcti_init(&rect, 0, num, 0, 1);
+  MemoryBuffer *buffer = new MemoryBuffer(COM_DT_VALUE, &rect);
+  memcpy(buffer->getBuffer(), values, sizeof(values));
+
+  buffer->packHalf();
+  EXPECT_TRUE(buffer->isHalf());
+  EXPECT_EQ(NULL, buffer->getBuffer());
+  EXPECT_EQ(sizeof(unsigned short) * num, buffer->getMemorySize());
+
+  buffer->unpackHalf();
+  EXPECT_FALSE(buffer->isHalf());
+  const float *data = buffer->getBuffer();
+  EXPECT_EQ(0.0f, data[0]);
+  EXPECT_EQ(0.0f, data[1]);
+  EXPECT_EQ(1.0f, data[2]);
+  EXPECT_EQ(-2.5f, data[3]);
+  EXPECT_NEAR(0.333333f, data[4], 1e-3f);
+  /* Flushed to zero. */
+  EXPECT_EQ(0.0f, data[5]);
+  /* Clamped to the largest half float. */
+  EXPECT_EQ(65504.0f, data[6]);
+  EXPECT_EQ(65504.0f, data[7]);
+  EXPECT_EQ(-65504.0f, data[8]);
+
+  delete buffer;
+}
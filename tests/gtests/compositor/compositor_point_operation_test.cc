@@ -0,0 +1,162 @@
+/* Apache License, Version 2.0 */
+
+#include "compositor_execution_base_test.h"
+
+#include <cmath>
+
+#include "COM_MathBaseOperation.h"
+#include "COM_MixOperation.h"
+#include "COM_NodeOperationBuilder.h"
+#include "COM_SetValueOperation.h"
+
+#define WIDTH 67
+#define HEIGHT 41
+
+class CompositorPointOperationTest : public CompositorExecutionBaseTest {
+};
+
+/* A point operation only read by another one is calculated by it, without buffer. */
+TEST_F(CompositorPointOperationTest, FuseChain)
+{
+  TestGradientOperation *gradient = add(new TestGradientOperation(COM_DT_VALUE));
+  MathSineOperation *sine = add(new MathSineOperation());
+  MathCosineOperation *cosine = add(new MathCosineOperation());
+  TestOutputOperation *output = add(new TestOutputOperation(COM_DT_VALUE));
+  SetValueOperation *zero = add(new SetValueOperation());
+  zero->setValue(0.0f);
+  link(gradient, sine, 0);
+  link(sine, cosine, 0);
+  link(cosine, output, 0);
+  link_unconnected(zero, sine);
+  link_unconnected(zero, cosine);
+
+  std::set<NodeOperation *> calculated;
+  compare_full_frame_to_tiled(output, WIDTH, HEIGHT, calculated);
+  EXPECT_TRUE(calculated.count(gradient));
+  EXPECT_FALSE(calculated.count(sine));
+  EXPECT_TRUE(calculated.count(cosine));
+  EXPECT_TRUE(calculated.count(output));
+}
+
+/* Operations calculating buffers directly keep their buffers, and so do their inputs. */
+TEST_F(CompositorPointOperationTest, KeepFullFrameOperations)
+{
+  TestGradientOperation *gradient = add(new TestGradientOperation(COM_DT_VALUE));
+  SetValueOperation *value = add(new SetValueOperation());
+  value->setValue(0.25f);
+  MathSineOperation *sine = add(new MathSineOperation());
+  MathAddOperation *math_add = add(new MathAddOperation());
+  MathCosineOperation *cosine = add(new MathCosineOperation());
+  MathMultiplyOperation *multiply = add(new MathMultiplyOperation());
+  TestOutputOperation *output = add(new TestOutputOperation(COM_DT_VALUE));
+  link(gradient, sine, 0);
+  link(sine, math_add, 0);
+  link(value, math_add, 1);
+  link(math_add, cosine, 0);
+  link(cosine, multiply, 0);
+  link(gradient, multiply, 1);
+  link(multiply, output, 0);
+  link_unconnected(value, sine);
+  link_unconnected(value, math_add);
+  link_unconnected(value, cosine);
+  link_unconnected(value, multiply);
+
+  std::set<NodeOperation *> calculated;
+  compare_full_frame_to_tiled(output, WIDTH, HEIGHT, calculated);
+  EXPECT_TRUE(calculated.count(sine));
+  EXPECT_TRUE(calculated.count(math_add));
+  EXPECT_TRUE(calculated.count(cosine));
+  EXPECT_TRUE(calculated.count(multiply));
+}
+
+/* Mixing colors read from fused operations. */
+TEST_F(CompositorPointOperationTest, FuseIntoColorOutput)
+{
+  TestGradientOperation *gradient = add(new TestGradientOperation(COM_DT_COLOR));
+  TestGradientOperation *factor = add(new TestGradientOperation(COM_DT_VALUE));
+  MixColorBurnOperation *burn = add(new MixColorBurnOperation());
+  MixOverlayOperation *overlay = add(new MixOverlayOperation());
+  TestOutputOperation *output = add(new TestOutputOperation(COM_DT_COLOR));
+  link(factor, burn, 0);
+  link(gradient, burn, 1);
+  link(gradient, burn, 2);
+  link(factor, overlay, 0);
+  link(burn, overlay, 1);
+  link(gradient, overlay, 2);
+  link(overlay, output, 0);
+
+  std::set<NodeOperation *> calculated;
+  compare_full_frame_to_tiled(output, WIDTH, HEIGHT, calculated);
+  EXPECT_FALSE(calculated.count(burn));
+  EXPECT_TRUE(calculated.count(overlay));
+}
+
+/* Gives access to the steps of the operation builder, for operations added by hand. */
+class TestOperationBuilder : public NodeOperationBuilder {
+ public:
+  TestOperationBuilder(const CompositorContext *context, bNodeTree *tree)
+      : NodeOperationBuilder(context, tree)
+  {
+  }
+
+  void fold()
+  {
+    determineResolutions();
+    fold_constant_operations();
+  }
+};
+
+static NodeOperation *input_operation(NodeOperation *operation, unsigned int index)
+{
+  return &operation->getInputSocket(index)->getLink()->getOperation();
+}
+
+/* Chains of point operations reading constants become a single constant, with the resolution
+ * of the operation it replaces. */
+TEST_F(CompositorPointOperationTest, FoldConstants)
+{
+  TestOperationBuilder builder(&context, &tree);
+  SetValueOperation *value_a = add(new SetValueOperation());
+  SetValueOperation *value_b = add(new SetValueOperation());
+  SetValueOperation *value_c = add(new SetValueOperation());
+  MathAddOperation *math_add = add(new MathAddOperation());
+  MathSineOperation *sine = add(new MathSineOperation());
+  MathMultiplyOperation *multiply = add(new MathMultiplyOperation());
+  TestGradientOperation *gradient = add(new TestGradientOperation(COM_DT_VALUE));
+  TestOutputOperation *output = add(new TestOutputOperation(COM_DT_VALUE));
+  value_a->setValue(0.5f);
+  value_b->setValue(2.0f);
+  value_c->setValue(0.0f);
+  for (size_t i = 0; i < operations.size(); i++) {
+    builder.addOperation(operations[i]);
+  }
+  builder.addLink(value_a->getOutputSocket(), math_add->getInputSocket(0));
+  builder.addLink(value_b->getOutputSocket(), math_add->getInputSocket(1));
+  builder.addLink(value_c->getOutputSocket(), math_add->getInputSocket(2));
+  builder.addLink(math_add->getOutputSocket(), sine->getInputSocket(0));
+  builder.addLink(value_c->getOutputSocket(), sine->getInputSocket(1));
+  builder.addLink(value_c->getOutputSocket(), sine->getInputSocket(2));
+  builder.addLink(sine->getOutputSocket(), multiply->getInputSocket(0));
+  builder.addLink(gradient->getOutputSocket(), multiply->getInputSocket(1));
+  builder.addLink(value_c->getOutputSocket(), multiply->getInputSocket(2));
+  builder.addLink(multiply->getOutputSocket(), output->getInputSocket(0));
+  set_resolutions(WIDTH, HEIGHT);
+
+  builder.fold();
+
+  /* The multiply reads the gradient, it stays. */
+  EXPECT_EQ(multiply, input_operation(output, 0));
+  EXPECT_EQ(gradient, input_operation(multiply, 1));
+
+  NodeOperation *constant = add(input_operation(multiply, 0));
+  ASSERT_TRUE(constant->isSetOperation());
+  EXPECT_EQ(COM_DT_VALUE, constant->getOutputSocket()->getDataType());
+  EXPECT_FLOAT_EQ(sinf(2.5f), ((SetValueOperation *)constant)->getValue());
+  EXPECT_EQ((unsigned int)WIDTH, constant->getWidth());
+  EXPECT_EQ((unsigned int)HEIGHT, constant->getHeight());
+
+  /* The constant of the first folded operation is left unused, for pruning. */
+  NodeOperation *constant_add = add(input_operation(sine, 0));
+  ASSERT_TRUE(constant_add->isSetOperation());
+  EXPECT_FLOAT_EQ(2.5f, ((SetValueOperation *)constant_add)->getValue());
+}
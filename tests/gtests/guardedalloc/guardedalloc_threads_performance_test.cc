@@ -0,0 +1,95 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#include "MEM_guardedalloc.h"
+
+#define NUM_RUN_AVERAGED 10
+#define NUM_ITERATIONS 2000
+#define NUM_BLOCKS 256
+
+namespace {
+
+typedef void *(*AllocFn)(size_t len);
+typedef void (*FreeFn)(void *mem);
+
+void *mem_alloc(size_t len)
+{
+  return MEM_mallocN(len, "threads_performance");
+}
+
+void *system_alloc(size_t len)
+{
+  return malloc(len);
+}
+
+/* Mix of small sizes, similar to what BMesh or depsgraph allocate. */
+size_t BlockSize(const int index)
+{
+  return (size_t)(8 + (index * 24) % 256);
+}
+
+void AllocFreeLoop(AllocFn alloc_fn, FreeFn free_fn)
+{
+  void *blocks[NUM_BLOCKS];
+  for (int iter = 0; iter < NUM_ITERATIONS; iter++) {
+    for (int i = 0; i < NUM_BLOCKS; i++) {
+      blocks[i] = alloc_fn(BlockSize(iter + i));
+    }
+    for (int i = 0; i < NUM_BLOCKS; i++) {
+      free_fn(blocks[i]);
+    }
+  }
+}
+
+void AllocFreeTestDo(const char *id, const int num_threads, AllocFn alloc_fn, FreeFn free_fn)
+{
+  double averaged_timing = 0.0;
+  for (int run = 0; run < NUM_RUN_AVERAGED; run++) {
+    const auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < num_threads; i++) {
+      threads.push_back(std::thread(AllocFreeLoop, alloc_fn, free_fn));
+    }
+    for (std::thread &thread : threads) {
+      thread.join();
+    }
+
+    const std::chrono::duration<double> duration = std::chrono::steady_clock::now() - start;
+    averaged_timing += duration.count();
+  }
+  averaged_timing /= NUM_RUN_AVERAGED;
+
+  const double num_allocations = (double)num_threads * NUM_ITERATIONS * NUM_BLOCKS;
+  printf("%s (%d threads): %fs on average over %d runs, %.1f M allocations/s\n",
+         id,
+         num_threads,
+         averaged_timing,
+         NUM_RUN_AVERAGED,
+         num_allocations / averaged_timing / 1e6);
+}
+
+void AllocFreeTest(const char *id, AllocFn alloc_fn, FreeFn free_fn)
+{
+  for (int num_threads = 1; num_threads <= 16; num_threads *= 2) {
+    AllocFreeTestDo(id, num_threads, alloc_fn, free_fn);
+  }
+}
+
+}  // namespace
+
+TEST(guardedalloc, ThreadsAllocFreeSystem)
+{
+  AllocFreeTest("System malloc", system_alloc, free);
+}
+
+TEST(guardedalloc, ThreadsAllocFreeLockfree)
+{
+  AllocFreeTest("Lock-free allocator", mem_alloc, MEM_freeN);
+}
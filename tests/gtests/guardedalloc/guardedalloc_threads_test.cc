@@ -0,0 +1,89 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include <thread>
+#include <vector>
+
+#include "MEM_guardedalloc.h"
+
+#define NUM_THREADS 4
+#define NUM_BLOCKS 1000
+
+namespace {
+
+size_t BlockSize(const int index)
+{
+  /* Cover empty blocks, all small size classes and some larger blocks. */
+  return (size_t)((index * 7) % 600);
+}
+
+void AllocBlocks(void **blocks, const int num_blocks)
+{
+  for (int i = 0; i < num_blocks; i++) {
+    blocks[i] = MEM_mallocN(BlockSize(i), __func__);
+    memset(blocks[i], i & 255, BlockSize(i));
+  }
+}
+
+void FreeBlocks(void **blocks, const int num_blocks)
+{
+  for (int i = 0; i < num_blocks; i++) {
+    MEM_freeN(blocks[i]);
+  }
+}
+
+}  // namespace
+
+TEST(guardedalloc, LockfreeThreadsCounters)
+{
+  const unsigned int blocks_in_use = MEM_get_memory_blocks_in_use();
+  const size_t memory_in_use = MEM_get_memory_in_use();
+
+  std::vector<void *> blocks(NUM_THREADS * NUM_BLOCKS);
+  std::vector<std::thread> threads;
+
+  /* Allocate in some threads. */
+  for (int i = 0; i < NUM_THREADS; i++) {
+    threads.push_back(std::thread(AllocBlocks, &blocks[i * NUM_BLOCKS], NUM_BLOCKS));
+  }
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+  threads.clear();
+
+  size_t expected_memory = 0;
+  for (int i = 0; i < NUM_BLOCKS; i++) {
+    expected_memory += MEM_allocN_len(blocks[i]);
+  }
+  EXPECT_EQ(blocks_in_use + NUM_THREADS * NUM_BLOCKS, MEM_get_memory_blocks_in_use());
+  EXPECT_EQ(memory_in_use + NUM_THREADS * expected_memory, MEM_get_memory_in_use());
+  EXPECT_LE(memory_in_use + NUM_THREADS * expected_memory, MEM_get_peak_memory());
+
+  /* Free in other threads, which reuse the caches of the threads that exited. */
+  for (int i = 0; i < NUM_THREADS; i++) {
+    const int other = (i + 1) % NUM_THREADS;
+    threads.push_back(std::thread(FreeBlocks, &blocks[other * NUM_BLOCKS], NUM_BLOCKS));
+  }
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+
+  EXPECT_EQ(blocks_in_use, MEM_get_memory_blocks_in_use());
+  EXPECT_EQ(memory_in_use, MEM_get_memory_in_use());
+}
+
+TEST(guardedalloc, LockfreeCallocReusedBlock)
+{
+  for (size_t len = 0; len < 600; len += 4) {
+    char *mem = (char *)MEM_mallocN(len, __func__);
+    memset(mem, 255, len);
+    MEM_freeN(mem);
+
+    mem = (char *)MEM_callocN(len, __func__);
+    for (size_t i = 0; i < len; i++) {
+      EXPECT_EQ(0, mem[i]);
+    }
+    MEM_freeN(mem);
+  }
+}
@@ -0,0 +1,60 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+extern "C" {
+#include "BLI_utildefines.h"
+
+#include "IMB_imbuf.h"
+#include "IMB_imbuf_types.h"
+}
+
+class ImbufChangeIdTest : public testing::Test {
+ protected:
+  static void SetUpTestCase()
+  {
+    IMB_init();
+  }
+
+  static void TearDownTestCase()
+  {
+    IMB_exit();
+  }
+};
+
+TEST_F(ImbufChangeIdTest, UniquePerBuffer)
+{
+  ImBuf *ibuf_a = IMB_allocImBuf(4, 4, 32, IB_rect);
+  ImBuf *ibuf_b = IMB_allocImBuf(4, 4, 32, IB_rect);
+  EXPECT_NE(ibuf_a->change_id, ibuf_b->change_id);
+
+  ImBuf *ibuf_dup = IMB_dupImBuf(ibuf_a);
+  EXPECT_NE(ibuf_a->change_id, ibuf_dup->change_id);
+  EXPECT_NE(ibuf_b->change_id, ibuf_dup->change_id);
+
+  /* A buffer allocated where a freed one was still gets a new id. */
+  const unsigned int change_id = ibuf_a->change_id;
+  IMB_freeImBuf(ibuf_a);
+  ibuf_a = IMB_allocImBuf(4, 4, 32, IB_rect);
+  EXPECT_NE(change_id, ibuf_a->change_id);
+
+  IMB_freeImBuf(ibuf_a);
+  IMB_freeImBuf(ibuf_b);
+  IMB_freeImBuf(ibuf_dup);
+}
+
+TEST_F(ImbufChangeIdTest, ChangedPixels)
+{
+  ImBuf *ibuf = IMB_allocImBuf(4, 4, 32, IB_rect);
+  unsigned int change_id = ibuf->change_id;
+
+  IMB_mark_changed(ibuf);
+  EXPECT_NE(change_id, ibuf->change_id);
+  change_id = ibuf->change_id;
+
+  /* New pixels. */
+  imb_addrectfloatImBuf(ibuf);
+  EXPECT_NE(change_id, ibuf->change_id);
+
+  IMB_freeImBuf(ibuf);
+}
@@ -0,0 +1,263 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include "MEM_guardedalloc.h"
+
+extern "C" {
+#include "BLI_math_color.h"
+#include "BLI_string.h"
+#include "BLI_utildefines.h"
+
+#include "DNA_color_types.h"
+
+#include "IMB_colormanagement.h"
+#include "IMB_imbuf.h"
+#include "IMB_imbuf_types.h"
+}
+
+/* More pixels than a tile of the display transform, with rows which aren't a multiple of the
+ * 4 pixels the SSE2 code handles at once. */
+#define WIDTH 301
+#define HEIGHT 250
+
+class ImbufColormanagementTest : public testing::Test {
+ protected:
+  ColorManagedViewSettings view_settings;
+  ColorManagedDisplaySettings display_settings;
+
+  static void SetUpTestCase()
+  {
+    IMB_init();
+  }
+
+  static void TearDownTestCase()
+  {
+    IMB_exit();
+  }
+
+  void SetUp() override
+  {
+    BLI_strncpy(display_settings.display_device,
+                IMB_colormanagement_display_get_default_name(),
+                sizeof(display_settings.display_device));
+    IMB_colormanagement_init_default_view_settings(&view_settings, &display_settings);
+    /* So byte buffers aren't already in display space. */
+    view_settings.exposure = 0.5f;
+  }
+
+  /* Colors above one and alphas of zero, one and in between. */
+  static void test_pixel_get(int x, int y, float r_pixel[4])
+  {
+    const int alpha_steps[5] = {0, 1, 2, 3, 4};
+    r_pixel[3] = (float)alpha_steps[(x + y) % 5] / 4.0f;
+    r_pixel[0] = (float)x / WIDTH * 1.2f;
+    r_pixel[1] = (float)y / HEIGHT;
+    r_pixel[2] = (float)((x * 7 + y * 3) % 17) / 16.0f;
+  }
+
+  static ImBuf *test_imbuf_float_create(bool is_straight)
+  {
+    ImBuf *ibuf = IMB_allocImBuf(WIDTH, HEIGHT, 32, IB_rectfloat);
+    if (is_straight) {
+      ibuf->flags |= IB_alphamode_channel_packed;
+    }
+    for (int y = 0; y < HEIGHT; y++) {
+      for (int x = 0; x < WIDTH; x++) {
+        test_pixel_get(x, y, ibuf->rect_float + ((size_t)y * WIDTH + x) * 4);
+      }
+    }
+    return ibuf;
+  }
+
+  static ImBuf *test_imbuf_byte_create()
+  {
+    ImBuf *ibuf = IMB_allocImBuf(WIDTH, HEIGHT, 32, IB_rect);
+    for (int y = 0; y < HEIGHT; y++) {
+      for (int x = 0; x < WIDTH; x++) {
+        float pixel[4];
+        test_pixel_get(x, y, pixel);
+        rgba_float_to_uchar((unsigned char *)ibuf->rect + ((size_t)y * WIDTH + x) * 4, pixel);
+      }
+    }
+    return ibuf;
+  }
+
+  /* Display transform of a float pixel one at a time, like before the tiled transform. */
+  void reference_display_pixel(const float pixel[4], bool predivide, float r_pixel[4])
+  {
+    ColormanageProcessor *cm_processor = IMB_colormanagement_display_processor_new(
+        &view_settings, &display_settings);
+    copy_v4_v4(r_pixel, pixel);
+    if (predivide) {
+      IMB_colormanagement_processor_apply_v4_predivide(cm_processor, r_pixel);
+    }
+    else {
+      IMB_colormanagement_processor_apply_v4(cm_processor, r_pixel);
+    }
+    IMB_colormanagement_processor_free(cm_processor);
+  }
+
+  void test_float_to_byte(bool is_straight)
+  {
+    ImBuf *ibuf = test_imbuf_float_create(is_straight);
+    void *cache_handle;
+    const unsigned char *display_buffer = IMB_display_buffer_acquire(
+        ibuf, &view_settings, &display_settings, &cache_handle);
+    ASSERT_NE(nullptr, display_buffer);
+
+    for (size_t i = 0; i < (size_t)WIDTH * HEIGHT; i++) {
+      float pixel[4];
+      unsigned char expected[4];
+      reference_display_pixel(ibuf->rect_float + i * 4, !is_straight, pixel);
+      if (is_straight) {
+        rgba_float_to_uchar(expected, pixel);
+      }
+      else {
+        premul_float_to_straight_uchar(expected, pixel);
+      }
+      for (int c = 0; c < 4; c++) {
+        EXPECT_EQ(expected[c], display_buffer[i * 4 + c]) << "at " << i;
+      }
+    }
+
+    IMB_display_buffer_release(cache_handle);
+    IMB_freeImBuf(ibuf);
+  }
+
+  void test_float_to_float(bool is_straight)
+  {
+    ImBuf *ibuf = test_imbuf_float_create(is_straight);
+    ImBuf *ibuf_orig = IMB_dupImBuf(ibuf);
+    IMB_colormanagement_imbuf_make_display_space(ibuf, &view_settings, &display_settings);
+
+    for (size_t i = 0; i < (size_t)WIDTH * HEIGHT; i++) {
+      float expected[4];
+      reference_display_pixel(ibuf_orig->rect_float + i * 4, !is_straight, expected);
+      for (int c = 0; c < 4; c++) {
+        EXPECT_FLOAT_EQ(expected[c], ibuf->rect_float[i * 4 + c]) << "at " << i;
+      }
+    }
+
+    IMB_freeImBuf(ibuf_orig);
+    IMB_freeImBuf(ibuf);
+  }
+};
+
+TEST_F(ImbufColormanagementTest, DisplayFloatPremultipliedToByte)
+{
+  test_float_to_byte(false);
+}
+
+TEST_F(ImbufColormanagementTest, DisplayFloatStraightToByte)
+{
+  test_float_to_byte(true);
+}
+
+TEST_F(ImbufColormanagementTest, DisplayFloatPremultipliedToFloat)
+{
+  test_float_to_float(false);
+}
+
+TEST_F(ImbufColormanagementTest, DisplayFloatStraightToFloat)
+{
+  test_float_to_float(true);
+}
+
+/* Byte buffers have straight alpha and are made linear before the display transform. */
+TEST_F(ImbufColormanagementTest, DisplayByteToByte)
+{
+  ImBuf *ibuf = test_imbuf_byte_create();
+  ImBuf *ibuf_orig = IMB_dupImBuf(ibuf);
+  IMB_colormanagement_imbuf_make_display_space(ibuf, &view_settings, &display_settings);
+
+  const unsigned char *rect = (const unsigned char *)ibuf->rect;
+  const unsigned char *rect_orig = (const unsigned char *)ibuf_orig->rect;
+  for (size_t i = 0; i < (size_t)WIDTH * HEIGHT; i++) {
+    float pixel[4];
+    unsigned char expected[4];
+    rgba_uchar_to_float(pixel, rect_orig + i * 4);
+    IMB_colormanagement_colorspace_to_scene_linear_v3(pixel, ibuf_orig->rect_colorspace);
+    reference_display_pixel(pixel, false, pixel);
+    rgba_float_to_uchar(expected, pixel);
+    for (int c = 0; c < 4; c++) {
+      EXPECT_EQ(expected[c], rect[i * 4 + c]) << "at " << i;
+    }
+  }
+
+  IMB_freeImBuf(ibuf_orig);
+  IMB_freeImBuf(ibuf);
+}
+
+/* Processors with the same settings are shared, and kept by the cache after they're freed. */
+TEST_F(ImbufColormanagementTest, DisplayProcessorCacheReuse)
+{
+  view_settings.exposure = 1.25f;
+  const unsigned int blocks_init = MEM_get_memory_blocks_in_use();
+
+  ColormanageProcessor *processor_a = IMB_colormanagement_display_processor_new(
+      &view_settings, &display_settings);
+  const unsigned int blocks_processor = MEM_get_memory_blocks_in_use() - blocks_init;
+  EXPECT_LT(0u, blocks_processor);
+
+  ColormanageProcessor *processor_b = IMB_colormanagement_display_processor_new(
+      &view_settings, &display_settings);
+  EXPECT_EQ(processor_a, processor_b);
+  EXPECT_EQ(blocks_init + blocks_processor, MEM_get_memory_blocks_in_use());
+
+  view_settings.exposure = 2.25f;
+  ColormanageProcessor *processor_c = IMB_colormanagement_display_processor_new(
+      &view_settings, &display_settings);
+  EXPECT_NE(processor_a, processor_c);
+  EXPECT_EQ(blocks_init + 2 * blocks_processor, MEM_get_memory_blocks_in_use());
+
+  IMB_colormanagement_processor_free(processor_a);
+  IMB_colormanagement_processor_free(processor_b);
+  IMB_colormanagement_processor_free(processor_c);
+  EXPECT_EQ(blocks_init + 2 * blocks_processor, MEM_get_memory_blocks_in_use());
+
+  /* Still cached. */
+  view_settings.exposure = 1.25f;
+  processor_b = IMB_colormanagement_display_processor_new(&view_settings, &display_settings);
+  EXPECT_EQ(processor_a, processor_b);
+  IMB_colormanagement_processor_free(processor_b);
+  EXPECT_EQ(blocks_init + 2 * blocks_processor, MEM_get_memory_blocks_in_use());
+}
+
+/* A processor removed from the cache stays valid for its users, and is freed by the last one. */
+TEST_F(ImbufColormanagementTest, DisplayProcessorCacheRelease)
+{
+  const float pixel_init[4] = {0.2f, 0.5f, 0.8f, 1.0f};
+  float pixel_a[4], pixel_b[4];
+
+  view_settings.exposure = 3.0f;
+  ColormanageProcessor *processor_a = IMB_colormanagement_display_processor_new(
+      &view_settings, &display_settings);
+  copy_v4_v4(pixel_a, pixel_init);
+  IMB_colormanagement_processor_apply_v4(processor_a, pixel_a);
+
+  /* Fill the cache with other settings, freeing them right away. */
+  for (int i = 0; i < 32; i++) {
+    view_settings.exposure = 4.0f + i;
+    IMB_colormanagement_processor_free(
+        IMB_colormanagement_display_processor_new(&view_settings, &display_settings));
+  }
+
+  const unsigned int blocks_init = MEM_get_memory_blocks_in_use();
+
+  copy_v4_v4(pixel_b, pixel_init);
+  IMB_colormanagement_processor_apply_v4(processor_a, pixel_b);
+  EXPECT_V4_NEAR(pixel_a, pixel_b, 0.0f);
+
+  IMB_colormanagement_processor_free(processor_a);
+  const unsigned int blocks_released = MEM_get_memory_blocks_in_use();
+  EXPECT_GT(blocks_init, blocks_released);
+
+  /* Processors which are only used by the cache are freed when replaced. */
+  for (int i = 0; i < 32; i++) {
+    view_settings.exposure = 40.0f + i;
+    IMB_colormanagement_processor_free(
+        IMB_colormanagement_display_processor_new(&view_settings, &display_settings));
+  }
+  EXPECT_EQ(blocks_released, MEM_get_memory_blocks_in_use());
+}
@@ -0,0 +1,314 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+extern "C" {
+#include "BLI_utildefines.h"
+
+#include "IMB_imbuf.h"
+#include "IMB_imbuf_types.h"
+}
+
+/* Reference of the scaling code #IMB_scaleImBuf used before the separable filters: average of
+ * the covered pixels along x when scaling down, linear interpolation between the first and last
+ * pixels when scaling up. Like it, rows of 4 channels are rounded to bytes after every pass.
+ * Columns are scaled by transposing. */
+
+template<typename T> static T legacy_store(float value);
+
+template<> unsigned char legacy_store<unsigned char>(float value)
+{
+  return (unsigned char)value;
+}
+
+template<> float legacy_store<float>(float value)
+{
+  return value;
+}
+
+template<typename T> static bool legacy_is_byte()
+{
+  return sizeof(T) == 1;
+}
+
+template<typename T>
+static std::vector<T> legacy_scaledownx(const std::vector<T> &src, int width, int height, int newx)
+{
+  std::vector<T> dst((size_t)newx * height * 4);
+  const float add = (width - 0.01) / newx;
+  const float round = legacy_is_byte<T>() ? 0.5f : 0.0f;
+
+  for (int y = 0; y < height; y++) {
+    for (int c = 0; c < 4; c++) {
+      const T *rect = &src[(size_t)y * width * 4 + c];
+      T *newrect = &dst[(size_t)y * newx * 4 + c];
+      float sample = 0.0f, val = 0.0f;
+
+      for (int x = newx; x > 0; x--) {
+        float nval = -val * sample;
+        sample += add;
+        while (sample >= 1.0f) {
+          sample -= 1.0f;
+          nval += rect[0];
+          rect += 4;
+        }
+        val = rect[0];
+        rect += 4;
+        newrect[0] = legacy_store<T>((nval + sample * val) / add + round);
+        newrect += 4;
+        sample -= 1.0f;
+      }
+    }
+  }
+  return dst;
+}
+
+template<typename T>
+static std::vector<T> legacy_scaleupx(const std::vector<T> &src, int width, int height, int newx)
+{
+  std::vector<T> dst((size_t)newx * height * 4);
+  const float add = (width - 1.001) / (newx - 1.0);
+  const float round = legacy_is_byte<T>() ? 0.5f : 0.0f;
+
+  for (int y = 0; y < height; y++) {
+    for (int c = 0; c < 4; c++) {
+      const T *rect = &src[(size_t)y * width * 4 + c];
+      T *newrect = &dst[(size_t)y * newx * 4 + c];
+      float sample = 0.0f;
+      float val = rect[0];
+      float nval = rect[4];
+      float diff = nval - val;
+      val += round;
+      rect += 8;
+
+      for (int x = newx; x > 0; x--) {
+        if (sample >= 1.0f) {
+          sample -= 1.0f;
+          val = nval;
+          nval = rect[0];
+          diff = nval - val;
+          val += round;
+          rect += 4;
+        }
+        newrect[0] = legacy_store<T>(val + sample * diff);
+        newrect += 4;
+        sample += add;
+      }
+    }
+  }
+  return dst;
+}
+
+template<typename T>
+static std::vector<T> legacy_transpose(const std::vector<T> &src, int width, int height)
+{
+  std::vector<T> dst(src.size());
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width; x++) {
+      memcpy(&dst[((size_t)x * height + y) * 4], &src[((size_t)y * width + x) * 4], sizeof(T) * 4);
+    }
+  }
+  return dst;
+}
+
+template<typename T>
+static std::vector<T> legacy_scale(
+    std::vector<T> pixels, int width, int height, int newx, int newy)
+{
+  if (newx < width) {
+    pixels = legacy_scaledownx(pixels, width, height, newx);
+    width = newx;
+  }
+  if (newy < height) {
+    pixels = legacy_transpose(legacy_scaledownx(legacy_transpose(pixels, width, height),
+                                                height,
+                                                width,
+                                                newy),
+                              newy,
+                              width);
+    height = newy;
+  }
+  if (newx > width) {
+    pixels = legacy_scaleupx(pixels, width, height, newx);
+    width = newx;
+  }
+  if (newy > height) {
+    pixels = legacy_transpose(
+        legacy_scaleupx(legacy_transpose(pixels, width, height), height, width, newy),
+        newy,
+        width);
+  }
+  return pixels;
+}
+
+/* Smooth gradients with some noise, and an alpha which is zero in the top right corner. */
+static float test_pixel_value(int x, int y, int width, int height, int c)
+{
+  if (c == 3) {
+    return (x > width / 2 && y > height / 2) ? 0.0f : 1.0f - 0.5f * x / width;
+  }
+  const unsigned int hash = (unsigned int)(x * 73856093) ^ (unsigned int)(y * 19349663) ^
+                            (unsigned int)(c * 83492791);
+  const float noise = (float)(hash % 1000) / 1000.0f;
+  return 0.15f + 0.5f * (float)(x + c) / width + 0.2f * (float)y / height + 0.15f * noise;
+}
+
+static ImBuf *test_imbuf_create(int width, int height, bool is_float)
+{
+  ImBuf *ibuf = IMB_allocImBuf(width, height, 32, is_float ? IB_rectfloat : IB_rect);
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width; x++) {
+      for (int c = 0; c < 4; c++) {
+        const float value = test_pixel_value(x, y, width, height, c);
+        const size_t index = ((size_t)y * width + x) * 4 + c;
+        if (is_float) {
+          ibuf->rect_float[index] = value;
+        }
+        else {
+          ((unsigned char *)ibuf->rect)[index] = (unsigned char)(value * 255.0f + 0.5f);
+        }
+      }
+    }
+  }
+  return ibuf;
+}
+
+/* Scale with #IMB_scaleImBuf and the reference, and compare. Bytes can differ by one from
+ * rounding, the previous code also rounded between passes. Floats differ at sharp edges because
+ * the previous code shrank the covered and interpolated ranges by 0.01 and 0.001 pixel. */
+static void test_scale_compare(int width, int height, int newx, int newy, bool is_float)
+{
+  ImBuf *ibuf = test_imbuf_create(width, height, is_float);
+  const size_t size = (size_t)width * height * 4;
+
+  if (is_float) {
+    const std::vector<float> expected = legacy_scale(
+        std::vector<float>(ibuf->rect_float, ibuf->rect_float + size), width, height, newx, newy);
+    EXPECT_TRUE(IMB_scaleImBuf(ibuf, newx, newy));
+    ASSERT_EQ(newx, ibuf->x);
+    ASSERT_EQ(newy, ibuf->y);
+    for (size_t i = 0; i < expected.size(); i++) {
+      EXPECT_NEAR(expected[i], ibuf->rect_float[i], 5e-3f) << "at " << i;
+    }
+  }
+  else {
+    const unsigned char *rect = (const unsigned char *)ibuf->rect;
+    const std::vector<unsigned char> expected = legacy_scale(
+        std::vector<unsigned char>(rect, rect + size), width, height, newx, newy);
+    EXPECT_TRUE(IMB_scaleImBuf(ibuf, newx, newy));
+    ASSERT_EQ(newx, ibuf->x);
+    ASSERT_EQ(newy, ibuf->y);
+    rect = (const unsigned char *)ibuf->rect;
+    for (size_t i = 0; i < expected.size(); i++) {
+      EXPECT_NEAR(expected[i], rect[i], 1) << "at " << i;
+    }
+  }
+
+  IMB_freeImBuf(ibuf);
+}
+
+class ImbufScalingTest : public testing::Test {
+ protected:
+  static void SetUpTestCase()
+  {
+    IMB_init();
+  }
+
+  static void TearDownTestCase()
+  {
+    IMB_exit();
+  }
+};
+
+TEST_F(ImbufScalingTest, DownByte)
+{
+  test_scale_compare(17, 13, 7, 5, false);
+  test_scale_compare(16, 12, 8, 4, false);
+}
+
+TEST_F(ImbufScalingTest, DownFloat)
+{
+  test_scale_compare(17, 13, 7, 5, true);
+  test_scale_compare(16, 12, 8, 4, true);
+}
+
+TEST_F(ImbufScalingTest, UpByte)
+{
+  test_scale_compare(7, 5, 17, 13, false);
+  test_scale_compare(8, 4, 16, 12, false);
+}
+
+TEST_F(ImbufScalingTest, UpFloat)
+{
+  test_scale_compare(7, 5, 17, 13, true);
+  test_scale_compare(8, 4, 16, 12, true);
+}
+
+TEST_F(ImbufScalingTest, DownUpMixed)
+{
+  test_scale_compare(17, 13, 7, 29, false);
+  test_scale_compare(17, 13, 31, 6, true);
+}
+
+/* Only the changed axis is filtered, the other one is copied exactly. */
+TEST_F(ImbufScalingTest, OneAxisUnchanged)
+{
+  test_scale_compare(17, 13, 7, 13, false);
+  test_scale_compare(17, 13, 17, 5, true);
+  test_scale_compare(7, 13, 17, 13, true);
+  test_scale_compare(17, 5, 17, 13, false);
+
+  /* Rows which are constant along x stay identical when scaling along x. */
+  ImBuf *ibuf = IMB_allocImBuf(17, 13, 32, IB_rect | IB_rectfloat);
+  for (int y = 0; y < 13; y++) {
+    for (int i = 0; i < 17 * 4; i++) {
+      ((unsigned char *)ibuf->rect)[y * 17 * 4 + i] = (unsigned char)(y * 19);
+      ibuf->rect_float[y * 17 * 4 + i] = y / 13.0f;
+    }
+  }
+  EXPECT_TRUE(IMB_scaleImBuf(ibuf, 7, 13));
+  for (int y = 0; y < 13; y++) {
+    for (int i = 0; i < 7 * 4; i++) {
+      EXPECT_EQ((unsigned char)(y * 19), ((unsigned char *)ibuf->rect)[y * 7 * 4 + i]);
+      EXPECT_FLOAT_EQ(y / 13.0f, ibuf->rect_float[y * 7 * 4 + i]);
+    }
+  }
+  IMB_freeImBuf(ibuf);
+}
+
+/* Byte images are filtered with straight alpha: the color of transparent pixels is kept and
+ * isn't darkened by them, like the previous code. */
+TEST_F(ImbufScalingTest, StraightAlphaByte)
+{
+  ImBuf *ibuf = IMB_allocImBuf(16, 16, 32, IB_rect);
+  unsigned char *rect = (unsigned char *)ibuf->rect;
+  for (int i = 0; i < 16 * 16; i++) {
+    const unsigned char color[4] = {200, 100, 50, (unsigned char)((i % 2) ? 0 : 255)};
+    memcpy(rect + i * 4, color, sizeof(color));
+  }
+  EXPECT_TRUE(IMB_scaleImBuf(ibuf, 4, 4));
+  rect = (unsigned char *)ibuf->rect;
+  for (int i = 0; i < 4 * 4; i++) {
+    EXPECT_EQ(200, rect[i * 4 + 0]);
+    EXPECT_EQ(100, rect[i * 4 + 1]);
+    EXPECT_EQ(50, rect[i * 4 + 2]);
+    EXPECT_NEAR(128, rect[i * 4 + 3], 1);
+  }
+  IMB_freeImBuf(ibuf);
+}
+
+/* The box filter of #IMB_scaleImBuf_filter averages the covered area like #IMB_scaleImBuf. */
+TEST_F(ImbufScalingTest, FilterBoxMatchesDown)
+{
+  ImBuf *ibuf_a = test_imbuf_create(17, 13, true);
+  ImBuf *ibuf_b = test_imbuf_create(17, 13, true);
+  EXPECT_TRUE(IMB_scaleImBuf(ibuf_a, 7, 5));
+  EXPECT_TRUE(IMB_scaleImBuf_filter(ibuf_b, 7, 5, IMB_SCALE_FILTER_BOX));
+  EXPECT_EQ(0, memcmp(ibuf_a->rect_float, ibuf_b->rect_float, sizeof(float) * 7 * 5 * 4));
+  IMB_freeImBuf(ibuf_a);
+  IMB_freeImBuf(ibuf_b);
+}